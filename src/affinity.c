@@ -0,0 +1,221 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE  // sched_setaffinity, CPU_*
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>   // fopen, snprintf
+#include <stdlib.h>  // strtol
+#include <string.h>
+#include <dirent.h>  // opendir
+
+#include "affinity.h"
+#include "m_error.h"
+
+#define SYS_NET "/sys/class/net"
+#define SYS_NODE "/sys/devices/system/node"
+
+// CPUs reserved to capture and the others, to threads of resolver
+static cpu_set_t capture_cpus;
+static cpu_set_t other_cpus;
+static cpu_set_t all_cpus;
+static unsigned int total_capture;
+
+/* list of CPUs as "0-3,8,10-11", as in sysfs, added to 'set'.
+   return false if invalid */
+static bool
+parse_cpulist ( const char *list, cpu_set_t *set )
+{
+  const char *p = list;
+
+  while ( *p && *p != '\n' )
+    {
+      char *end;
+      long first = strtol ( p, &end, 10 );
+      long last = first;
+
+      if ( end == p || first < 0 )
+        return false;
+
+      p = end;
+      if ( *p == '-' )
+        {
+          last = strtol ( p + 1, &end, 10 );
+          if ( end == p + 1 || last < first )
+            return false;
+
+          p = end;
+        }
+
+      if ( last >= CPU_SETSIZE )
+        return false;
+
+      for ( long cpu = first; cpu <= last; cpu++ )
+        CPU_SET ( cpu, set );
+
+      if ( *p == ',' )
+        p++;
+      else if ( *p && *p != '\n' )
+        return false;
+    }
+
+  return true;
+}
+
+static int
+read_number ( const char *path )
+{
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    return -1;
+
+  int value;
+  if ( 1 != fscanf ( file, "%d", &value ) )
+    value = -1;
+
+  fclose ( file );
+  return value;
+}
+
+// add CPUs of NUMA node of device of interface, false if not has node
+static bool
+add_node_of_iface ( const char *iface, cpu_set_t *set )
+{
+  char path[512];
+
+  snprintf ( path, sizeof path, SYS_NET "/%s/device/numa_node", iface );
+  int node = read_number ( path );
+  if ( node < 0 )
+    return false;
+
+  snprintf ( path, sizeof path, SYS_NODE "/node%d/cpulist", node );
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    return false;
+
+  char list[1024];
+  bool ok = fgets ( list, sizeof list, file ) && parse_cpulist ( list, set );
+
+  fclose ( file );
+  return ok;
+}
+
+static void
+add_nodes_of_all_ifaces ( cpu_set_t *set )
+{
+  DIR *dir = opendir ( SYS_NET );
+  if ( !dir )
+    return;
+
+  struct dirent *ent;
+  while ( ( ent = readdir ( dir ) ) )
+    {
+      if ( *ent->d_name != '.' )
+        add_node_of_iface ( ent->d_name, set );
+    }
+
+  closedir ( dir );
+}
+
+bool
+affinity_capture_init ( const char *spec,
+                        char *const *ifaces,
+                        unsigned int total_ifaces )
+{
+  CPU_ZERO ( &capture_cpus );
+
+  if ( sched_getaffinity ( 0, sizeof all_cpus, &all_cpus ) == -1 )
+    {
+      ERROR_DEBUG ( "%s", "sched_getaffinity" );
+      return true;
+    }
+
+  if ( !strcmp ( spec, "auto" ) )
+    {
+      // NULL is all interfaces
+      for ( unsigned int i = 0; i < total_ifaces; i++ )
+        {
+          if ( ifaces[i] )
+            add_node_of_iface ( ifaces[i], &capture_cpus );
+          else
+            add_nodes_of_all_ifaces ( &capture_cpus );
+        }
+    }
+  else if ( !parse_cpulist ( spec, &capture_cpus ) ||
+            !CPU_COUNT ( &capture_cpus ) )
+    return false;
+
+  // only CPUs that process can run
+  CPU_AND ( &capture_cpus, &capture_cpus, &all_cpus );
+
+  // device without NUMA node (virtual or single node), affinity not used
+  if ( !( total_capture = CPU_COUNT ( &capture_cpus ) ) )
+    {
+      ERROR_DEBUG ( "%s", "CPUs of capture not found, affinity not used" );
+      return true;
+    }
+
+  CPU_XOR ( &other_cpus, &all_cpus, &capture_cpus );
+
+  return true;
+}
+
+unsigned int
+affinity_capture_count ( void )
+{
+  return total_capture;
+}
+
+bool
+affinity_pin_capture ( unsigned int n )
+{
+  if ( !total_capture )
+    return false;
+
+  n %= total_capture;
+
+  for ( int cpu = 0; cpu < CPU_SETSIZE; cpu++ )
+    {
+      if ( !CPU_ISSET ( cpu, &capture_cpus ) || n-- )
+        continue;
+
+      cpu_set_t set;
+      CPU_ZERO ( &set );
+      CPU_SET ( cpu, &set );
+
+      return !sched_setaffinity ( 0, sizeof set, &set );
+    }
+
+  return false;
+}
+
+void
+affinity_unpin ( void )
+{
+  if ( total_capture )
+    sched_setaffinity ( 0, sizeof all_cpus, &all_cpus );
+}
+
+void
+affinity_avoid_capture ( void )
+{
+  if ( total_capture && CPU_COUNT ( &other_cpus ) )
+    sched_setaffinity ( 0, sizeof other_cpus, &other_cpus );
+}
@@ -0,0 +1,53 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdbool.h>
+
+/* CPUs of capture, of list as "0-3,8" or "auto" to CPUs local to NUMA
+   nodes of devices of interfaces 'ifaces' (all interfaces if NULL), read of
+   sysfs. the CPUs are reserved to capture, see affinity_avoid_capture.
+   return false if list is invalid */
+bool
+affinity_capture_init ( const char *spec,
+                        char *const *ifaces,
+                        unsigned int total_ifaces );
+
+// total of CPUs of capture, 0 if affinity is not used
+unsigned int
+affinity_capture_count ( void );
+
+/* pin the calling thread to CPU of capture 'n' (round robin),
+   memory touched after it is allocated in the NUMA node of CPU */
+bool
+affinity_pin_capture ( unsigned int n );
+
+// restore affinity of calling thread to all CPUs, after affinity_pin_capture
+void
+affinity_unpin ( void );
+
+/* calling thread run out of CPUs of capture (threads of resolver),
+   without effect if capture has all CPUs */
+void
+affinity_avoid_capture ( void );
+
+#endif  // AFFINITY_H
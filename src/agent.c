@@ -0,0 +1,657 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>   // variable errno
+#include <limits.h>  // HOST_NAME_MAX
+#include <stdlib.h>  // malloc
+#include <string.h>  // strerror, memcpy
+#include <time.h>    // time
+#include <unistd.h>  // close, gethostname
+#include <sys/socket.h>
+
+#include "agent.h"
+#include "sock.h"  // socket_resolve
+#include "aggregate.h"  // aggregate_cgroup
+#include "hashtable.h"
+#include "hash.h"
+#include "intern.h"
+#include "vector.h"
+#include "m_error.h"
+#include "macro_util.h"
+
+// initial size of buffer of records, grows if a refresh not fit
+#define AGENT_BUFFER ( 64 * 1024 )
+
+// above it the connection is closed, the collector not read it for long
+#define AGENT_BUFFER_MAX ( 16 * 1024 * 1024 )
+
+// space of a record, without strings and remotes
+#define RECORD_SPACE 64
+
+// process with traffic sent, by address of process_t
+struct agent_process
+{
+  const process_t *proc;
+  const char *name;    // interned, name when seen first, changed by exec
+  const char *cgroup;  // interned or NULL
+  nstats_t rx, tx, pps_rx, pps_tx;  // traffic not sent yet
+  uint32_t id;
+  uint32_t seen;  // last tick of process in list of processes
+  pid_t pid;
+  bool sent;   // AGT_PROCESS already sent in connection
+  bool dirty;  // there is traffic not sent
+};
+
+// string of dictionary of connection
+struct agent_string
+{
+  const char *str;  // interned, key of table
+  uint32_t id;
+};
+
+// records not sent, 'sent' is less than 'len' while not written all
+static struct
+{
+  uint8_t *data;
+  size_t len;
+  size_t sent;
+  size_t size;
+} buf;
+
+static struct sockaddr_storage addr;
+static socklen_t addr_len;
+static char host[HOST_NAME_MAX + 1];
+static unsigned int refresh;
+
+static hashtable_t *ht_rec;
+static struct agent_process **recorded;  // to find processes closed
+static uint32_t *free_ids;               // ids of processes closed
+static uint32_t next_id;
+
+static hashtable_t *ht_dict;
+static uint32_t next_string;
+
+static uint32_t last_tick;
+static bool tick_written;
+
+static unsigned long late;            // refreshes summed with the next
+static unsigned int retry = 1;        // seconds to next connection
+static time_t retry_at;
+static int fd = -1;
+
+static bool
+ht_cb_compare ( const void *key1, const void *key2 )
+{
+  return key1 == key2;
+}
+
+static hash_t
+ht_cb_hash ( const void *key )
+{
+  return hash_u64 ( ( uintptr_t ) key );
+}
+
+static void
+free_string ( void *arg )
+{
+  struct agent_string *s = arg;
+
+  intern_put ( s->str );
+  free ( s );
+}
+
+static void
+free_process ( struct agent_process *rec )
+{
+  intern_put ( rec->name );
+  intern_put ( rec->cgroup );
+  free ( rec );
+}
+
+// space to 'len' bytes more in buffer
+static bool
+reserve ( size_t len )
+{
+  if ( buf.len + len <= buf.size )
+    return true;
+
+  size_t size = MAX ( buf.size * 2, buf.len + len );
+  if ( size > AGENT_BUFFER_MAX )
+    return false;
+
+  uint8_t *data = realloc ( buf.data, size );
+  if ( !data )
+    return false;
+
+  buf.data = data;
+  buf.size = size;
+
+  return true;
+}
+
+// caller reserve the space
+static void
+put_varint ( uint64_t value )
+{
+  while ( value >= 0x80 )
+    {
+      buf.data[buf.len++] = ( value & 0x7f ) | 0x80;
+      value >>= 7;
+    }
+
+  buf.data[buf.len++] = value;
+}
+
+static void
+put_raw ( const void *data, size_t len )
+{
+  memcpy ( buf.data + buf.len, data, len );
+  buf.len += len;
+}
+
+// record of tick only before of first record in it
+static void
+put_tick ( uint32_t tick )
+{
+  if ( tick_written )
+    return;
+
+  buf.data[buf.len++] = AGT_TICK;
+  put_varint ( tick - last_tick );
+  last_tick = tick;
+  tick_written = true;
+}
+
+/* id of 'str' in dictionary, the string is sent in first use. return
+   false without memory */
+static bool
+string_id ( const char *str, uint32_t *id, uint32_t tick )
+{
+  struct agent_string *s = hashtable_get ( ht_dict, str );
+
+  if ( s )
+    {
+      *id = s->id;
+      return true;
+    }
+
+  size_t len = intern_len ( str );
+  if ( !reserve ( RECORD_SPACE + len ) )
+    return false;
+
+  s = malloc ( sizeof *s );
+  if ( !s )
+    return false;
+
+  *s = ( struct agent_string ){ .str = intern_ref ( str ), .id = next_string };
+  if ( !hashtable_set ( ht_dict, s->str, s ) )
+    {
+      free_string ( s );
+      return false;
+    }
+
+  next_string++;
+  *id = s->id;
+
+  put_tick ( tick );
+  buf.data[buf.len++] = AGT_STRING;
+  put_varint ( s->id );
+  put_varint ( len );
+  put_raw ( str, len );
+
+  return true;
+}
+
+static bool
+dict_reset ( void )
+{
+  if ( ht_dict )
+    hashtable_destroy ( ht_dict );
+
+  next_string = 0;
+  ht_dict = hashtable_new ( ht_cb_hash, ht_cb_compare, free_string );
+
+  return ht_dict != NULL;
+}
+
+// processes and dictionary are of connection
+static void
+state_reset ( void )
+{
+  size_t n = vector_size ( recorded );
+  for ( size_t i = 0; i < n; i++ )
+    {
+      if ( recorded[i]->seen )
+        hashtable_remove ( ht_rec, recorded[i]->proc );
+
+      free_process ( recorded[i] );
+    }
+
+  vector_clear ( recorded );
+  vector_clear ( free_ids );
+  next_id = 0;
+  last_tick = 0;
+}
+
+static void
+agent_close ( void )
+{
+  if ( fd != -1 )
+    close ( fd );
+
+  fd = -1;
+  buf.len = buf.sent = 0;
+
+  state_reset ();
+  dict_reset ();
+
+  // collector down or overloaded, not tried in each refresh
+  retry_at = time ( NULL ) + retry;
+  retry = MIN ( retry * 2, AGENT_RETRY_MAX );
+}
+
+static bool
+agent_connect ( void )
+{
+  if ( time ( NULL ) < retry_at )
+    return false;
+
+  fd = socket ( addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  if ( fd == -1 )
+    return false;
+
+  // connection is completed in background, data are sent after it
+  if ( connect ( fd, ( struct sockaddr * ) &addr, addr_len ) == -1 &&
+       errno != EINPROGRESS )
+    {
+      agent_close ();
+      return false;
+    }
+
+  size_t len = strlen ( host );
+  if ( !reserve ( AGENT_MAGIC_SIZE + RECORD_SPACE + len ) )
+    {
+      agent_close ();
+      return false;
+    }
+
+  put_raw ( AGENT_MAGIC, AGENT_MAGIC_SIZE );
+  put_varint ( refresh );
+  put_varint ( len );
+  put_raw ( host, len );
+
+  return true;
+}
+
+// write what is pending of buffer, false on error of socket
+static bool
+agent_flush ( void )
+{
+  while ( buf.sent < buf.len )
+    {
+      // collector closed not kill the process with SIGPIPE
+      ssize_t n = send (
+              fd, buf.data + buf.sent, buf.len - buf.sent, MSG_NOSIGNAL );
+
+      if ( n == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          // connecting yet or buffer of socket full
+          if ( errno == EAGAIN || errno == EWOULDBLOCK ||
+               errno == ENOTCONN )
+            return true;
+
+          return false;
+        }
+
+      buf.sent += n;
+    }
+
+  // all read by collector
+  buf.len = buf.sent = 0;
+  retry = 1;
+
+  return true;
+}
+
+static struct agent_process *
+get_rec ( const process_t *proc )
+{
+  struct agent_process *rec = hashtable_get ( ht_rec, proc );
+
+  // process_t reused by other process, or exec
+  if ( rec && ( rec->pid != proc->pid || rec->name != proc->name ) )
+    {
+      rec->seen = 0;
+      rec = NULL;
+      hashtable_remove ( ht_rec, proc );
+    }
+
+  if ( rec )
+    return rec;
+
+  rec = calloc ( 1, sizeof *rec );
+  if ( !rec )
+    return NULL;
+
+  // ids of processes closed are reused, so the collector not grow
+  size_t n = vector_size ( free_ids );
+  if ( n )
+    {
+      rec->id = free_ids[n - 1];
+      vector_pop ( free_ids );
+    }
+  else
+    rec->id = next_id++;
+
+  rec->proc = proc;
+  rec->pid = proc->pid;
+  rec->name = intern_ref ( proc->name );
+
+  // read once by process, 'unattributed' has not cgroup
+  if ( proc->pid )
+    rec->cgroup = aggregate_cgroup ( proc );
+
+  if ( !hashtable_set ( ht_rec, proc, rec ) )
+    goto ERROR;
+
+  if ( !vector_push ( recorded, &rec ) )
+    {
+      hashtable_remove ( ht_rec, proc );
+      goto ERROR;
+    }
+
+  return rec;
+
+ERROR:
+  vector_push ( free_ids, &rec->id );
+  free_process ( rec );
+  return NULL;
+}
+
+static bool
+put_remotes ( const struct agent_process *rec )
+{
+  struct topk *tk = rec->proc->remotes;
+
+  if ( !tk || !tk->total )
+    return true;
+
+  if ( !reserve ( RECORD_SPACE + TOPK_ENTRIES * RECORD_SPACE ) )
+    return false;
+
+  topk_sort ( tk );
+
+  buf.data[buf.len++] = AGT_REMOTES;
+  put_varint ( rec->id );
+  put_varint ( tk->total );
+
+  for ( unsigned int i = 0; i < tk->total; i++ )
+    {
+      const struct topk_key *key = &tk->entries[i].key;
+
+      put_varint ( key->family );
+      put_varint ( key->port );
+      put_raw ( &key->addr,
+                ( key->family == AF_INET ) ? sizeof ( key->addr.ip )
+                                           : sizeof ( key->addr.in6 ) );
+      put_varint ( tk->entries[i].bytes );
+    }
+
+  return true;
+}
+
+static bool
+put_traffic ( struct agent_process *rec, uint32_t tick )
+{
+  if ( !rec->sent )
+    {
+      uint32_t name, cgroup = 0;
+
+      if ( !string_id ( rec->name, &name, tick ) ||
+           ( rec->cgroup && !string_id ( rec->cgroup, &cgroup, tick ) ) ||
+           !reserve ( RECORD_SPACE ) )
+        return false;
+
+      put_tick ( tick );
+      buf.data[buf.len++] = AGT_PROCESS;
+      put_varint ( rec->id );
+      put_varint ( ( uint32_t ) rec->pid );
+      put_varint ( name );
+      put_varint ( ( rec->cgroup ) ? cgroup + 1 : 0 );
+      rec->sent = true;
+    }
+
+  if ( !reserve ( RECORD_SPACE ) )
+    return false;
+
+  put_tick ( tick );
+  buf.data[buf.len++] = AGT_TRAFFIC;
+  put_varint ( rec->id );
+  put_varint ( rec->rx );
+  put_varint ( rec->tx );
+  put_varint ( rec->pps_rx );
+  put_varint ( rec->pps_tx );
+
+  rec->rx = rec->tx = rec->pps_rx = rec->pps_tx = 0;
+  rec->dirty = false;
+
+  // remotes of process still in list, the sketch is of process_t
+  return rec->seen != tick || put_remotes ( rec );
+}
+
+// records of traffic not sent and of processes closed
+static bool
+put_records ( uint32_t tick )
+{
+  tick_written = false;
+
+  if ( next_string >= AGENT_DICT_MAX )
+    {
+      if ( !reserve ( RECORD_SPACE ) || !dict_reset () )
+        return false;
+
+      buf.data[buf.len++] = AGT_RESET;
+    }
+
+  size_t n = vector_size ( recorded );
+  for ( size_t i = 0; i < n; i++ )
+    {
+      if ( recorded[i]->dirty && !put_traffic ( recorded[i], tick ) )
+        return false;
+    }
+
+  // processes not more in list
+  for ( size_t i = 0; i < n; )
+    {
+      struct agent_process *rec = recorded[i];
+
+      if ( rec->seen == tick )
+        {
+          i++;
+          continue;
+        }
+
+      if ( rec->sent )
+        {
+          if ( !reserve ( RECORD_SPACE ) )
+            return false;
+
+          put_tick ( tick );
+          buf.data[buf.len++] = AGT_EXIT;
+          put_varint ( rec->id );
+        }
+
+      recorded[i] = recorded[--n];
+      vector_pop ( recorded );
+
+      // already removed of table by get_rec if process_t was reused
+      if ( rec->seen )
+        hashtable_remove ( ht_rec, rec->proc );
+
+      if ( !vector_push ( free_ids, &rec->id ) )
+        return false;
+
+      free_process ( rec );
+    }
+
+  return true;
+}
+
+bool
+agent_init ( const struct config_op *co )
+{
+  if ( !socket_resolve ( co->agent, SOCK_STREAM, &addr, &addr_len ) )
+    return false;
+
+  if ( gethostname ( host, sizeof host ) == -1 )
+    strcpy ( host, "unknown" );
+
+  host[sizeof host - 1] = '\0';
+  refresh = co->refresh;
+
+  buf.data = malloc ( AGENT_BUFFER );
+  ht_rec = hashtable_new ( ht_cb_hash, ht_cb_compare, NULL );
+  recorded = vector_new ( sizeof ( struct agent_process * ) );
+  free_ids = vector_new ( sizeof ( uint32_t ) );
+  if ( !buf.data || !ht_rec || !recorded || !free_ids || !dict_reset () )
+    {
+      agent_free ();
+      return false;
+    }
+
+  buf.size = AGENT_BUFFER;
+
+  // collector not started yet is not a error, tried again in refreshes
+  agent_connect ();
+
+  return true;
+}
+
+void
+agent_tick ( process_t **processes, size_t total, uint32_t tick )
+{
+  if ( !ht_rec )
+    return;
+
+  // without collector the traffic is dropped
+  if ( fd == -1 && !agent_connect () )
+    return;
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      process_t *proc = processes[i];
+      struct net_stat *ns = &proc->net_stat;
+
+      // bytes since last refresh, packets of tick closed
+      nstats_t rx = ns->tot_Bps_rx - ns->tot_Bps_rx_prev;
+      nstats_t tx = ns->tot_Bps_tx - ns->tot_Bps_tx_prev;
+
+      struct agent_process *rec;
+      if ( !rx && !tx )
+        {
+          // only processes already seen not are closed
+          if ( ( rec = hashtable_get ( ht_rec, proc ) ) &&
+               rec->pid == proc->pid && rec->name == proc->name )
+            rec->seen = tick;
+
+          continue;
+        }
+
+      if ( !( rec = get_rec ( proc ) ) )
+        continue;
+
+      rec->seen = tick;
+
+      struct rate_counters c;
+      rate_tick_counters ( ns, tick, &c );
+
+      rec->rx += rx;
+      rec->tx += tx;
+      rec->pps_rx += c.pps_rx;
+      rec->pps_tx += c.pps_tx;
+      rec->dirty = true;
+    }
+
+  // collector not read the previous refresh, traffic is sent with the next
+  if ( buf.sent < buf.len )
+    {
+      if ( !agent_flush () )
+        goto ERROR;
+
+      if ( buf.sent < buf.len )
+        {
+          late++;
+          return;
+        }
+    }
+
+  if ( !put_records ( tick ) )
+    {
+      ERROR_DEBUG ( "%s", "Error alloc buffer of agent" );
+      agent_close ();
+      return;
+    }
+
+  if ( agent_flush () )
+    return;
+
+ERROR:
+  ERROR_DEBUG ( "Error send to collector: %s", strerror ( errno ) );
+  agent_close ();
+}
+
+void
+agent_free ( void )
+{
+  if ( late )
+    {
+      ERROR_DEBUG ( "Refreshes sent late to collector: %lu", late );
+    }
+
+  if ( fd != -1 )
+    close ( fd );
+  fd = -1;
+
+  if ( recorded && ht_rec )
+    state_reset ();
+
+  if ( recorded )
+    vector_free ( recorded );
+  recorded = NULL;
+
+  if ( free_ids )
+    vector_free ( free_ids );
+  free_ids = NULL;
+
+  if ( ht_rec )
+    hashtable_destroy ( ht_rec );
+  ht_rec = NULL;
+
+  if ( ht_dict )
+    hashtable_destroy ( ht_dict );
+  ht_dict = NULL;
+
+  free ( buf.data );
+  buf.data = NULL;
+  buf.len = buf.sent = buf.size = 0;
+}
@@ -0,0 +1,82 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>  // size_t
+
+#include "processes.h"
+#include "config.h"
+
+/* traffic of processes of each refresh sent to a collector (see collector.h)
+   in one TCP connection, as records of record.h: a byte of type and fields
+   unsigned as varint. names of processes, cgroups and remotes are in a
+   dictionary of the connection, each string is sent once and referred by
+   id after. the connection start with AGENT_MAGIC, the interval of refresh
+   and the name of host.
+   the records of a refresh are written in a buffer and sent by a socket non
+   blocking, while the collector not read the previous the traffic of
+   processes is summed and sent with the next (no refresh is lost, only
+   late). without connection the traffic is dropped and the connection is
+   tried again, with intervals doubled up to AGENT_RETRY_MAX seconds */
+
+#define AGENT_MAGIC "NPAGT\0\0\1"
+#define AGENT_MAGIC_SIZE 8
+
+#define AGENT_RETRY_MAX 32
+
+// strings in dictionary, above it dictionary is cleared (AGT_RESET)
+#define AGENT_DICT_MAX 65536
+
+enum agent_type
+{
+  // ticks since previous record of tick, the first is the tick of agent
+  AGT_TICK = 1,
+  // string of dictionary: id, length, bytes. ids are sequential from 0
+  AGT_STRING,
+  // new process: id, pid, id of name, id of cgroup + 1 (0 is unknown)
+  AGT_PROCESS,
+  // traffic of process: id, bytes rx, bytes tx, packets rx, packets tx
+  AGT_TRAFFIC,
+  // top remotes of process: id, total, and of each one the family, the
+  // port, 4 or 16 bytes of address and bytes (estimate, see topk.h)
+  AGT_REMOTES,
+  // process closed: id, reused by other process after
+  AGT_EXIT,
+  // dictionary cleared, ids of strings start again from 0
+  AGT_RESET
+};
+
+// address of collector of co->agent, as "host:port" or "[ipv6]:port"
+bool
+agent_init ( const struct config_op *co );
+
+/* send traffic of processes in tick 'tick', closed by rate_calc and
+   before of rate_update, and the processes closed since last call */
+void
+agent_tick ( process_t **processes, size_t total, uint32_t tick );
+
+void
+agent_free ( void );
+
+#endif  // AGENT_H
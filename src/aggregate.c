@@ -0,0 +1,287 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>      // snprintf
+#include <stdlib.h>     // calloc
+#include <string.h>     // strlen
+#include <fcntl.h>      // open
+#include <unistd.h>     // close
+#include <pwd.h>        // getpwuid_r
+#include <sys/stat.h>   // stat
+
+#include "aggregate.h"
+#include "hashtable.h"
+#include "vector.h"
+#include "full_read.h"
+#include "directory.h"  // proc_root
+#include "intern.h"
+#include "networks.h"
+#include "m_error.h"
+
+// <root>/<pid>/cgroup
+#define MAX_PATH_PROC PROC_ROOT_MAX + 20
+
+// size of buffer to getpwuid_r
+#define PASSWD_BUFF 1024
+
+static enum aggregate_mode mode = AGG_NONE;
+
+// rows by name
+static hashtable_t *ht_rows;
+
+static struct processes view;
+
+static void
+free_row ( void *arg )
+{
+  process_t *row = arg;
+
+  intern_put ( row->name );
+  rate_net_stat_free ( &row->net_stat );
+  topk_free ( row->remotes );
+  pktsize_free ( row->sizes );
+  free ( row );
+}
+
+// keys are interned, equal keys are the same pointer
+static bool
+ht_cb_compare ( const void *key1, const void *key2 )
+{
+  return key1 == key2;
+}
+
+static hash_t
+ht_cb_hash ( const void *key )
+{
+  return intern_hash ( key );
+}
+
+// "/usr/bin/program" of "/usr/bin/program --args"
+static const char *
+key_program ( const process_t *proc )
+{
+  return intern ( proc->name, intern_prog_len ( proc->name ) );
+}
+
+// owner of /proc/<pid>/, name of user or uid if user unknown
+static const char *
+key_user ( const process_t *proc )
+{
+  char path[MAX_PATH_PROC];
+  struct stat st;
+
+  snprintf ( path, sizeof path, "%s/%d", proc_root (), proc->pid );
+  if ( stat ( path, &st ) == -1 )
+    return NULL;
+
+  char buff[PASSWD_BUFF];
+  struct passwd pwd, *result;
+  if ( !getpwuid_r ( st.st_uid, &pwd, buff, sizeof buff, &result ) &&
+       result )
+    return intern ( pwd.pw_name, strlen ( pwd.pw_name ) );
+
+  int len = snprintf ( buff, sizeof buff, "uid %u", st.st_uid );
+  return intern ( buff, len );
+}
+
+/* path of cgroup of process, of line "0::/path" of cgroup v2 or of first
+   hierarchy of cgroup v1 "id:controllers:/path" */
+const char *
+aggregate_cgroup ( const process_t *proc )
+{
+  char path[MAX_PATH_PROC];
+
+  snprintf ( path, sizeof path, "%s/%d/cgroup", proc_root (), proc->pid );
+  int fd = open ( path, O_RDONLY | O_CLOEXEC );
+  if ( fd == -1 )
+    return NULL;
+
+  char *buff = NULL;
+  ssize_t len = full_read ( fd, &buff );
+  close ( fd );
+
+  if ( len <= 0 )
+    {
+      if ( len == 0 )
+        free ( buff );
+
+      return NULL;
+    }
+
+  char *line = strstr ( buff, "0::" );
+  if ( !line || ( line != buff && line[-1] != '\n' ) )
+    line = buff;
+
+  char *start = strchr ( line, ':' );
+  if ( start )
+    start = strchr ( start + 1, ':' );
+
+  const char *key = NULL;
+  if ( start )
+    {
+      start++;
+      key = intern ( start, strcspn ( start, "\n" ) );
+    }
+
+  free ( buff );
+  return key;
+}
+
+enum aggregate_mode
+aggregate_mode ( void )
+{
+  return mode;
+}
+
+bool
+aggregate_reset ( enum aggregate_mode new_mode )
+{
+  aggregate_free ();
+
+  if ( new_mode == AGG_NONE )
+    return true;
+
+  // rows always accounted, by connection
+  if ( new_mode == AGG_NETWORK )
+    {
+      if ( !networks_view ()->total )
+        return false;
+
+      mode = new_mode;
+      return true;
+    }
+
+  ht_rows = hashtable_new ( ht_cb_hash, ht_cb_compare, free_row );
+  view.proc = vector_new ( sizeof ( process_t * ) );
+  if ( !ht_rows || !view.proc )
+    {
+      aggregate_free ();
+      return false;
+    }
+
+  mode = new_mode;
+
+  return true;
+}
+
+process_t *
+aggregate_join ( process_t *proc )
+{
+  if ( mode == AGG_NONE || mode == AGG_NETWORK )
+    return NULL;
+
+  const char *key;
+
+  // row 'unattributed' is always alone
+  if ( !proc->pid )
+    key = intern_ref ( proc->name );
+  else if ( mode == AGG_PROGRAM )
+    key = key_program ( proc );
+  else if ( mode == AGG_USER )
+    key = key_user ( proc );
+  else
+    key = aggregate_cgroup ( proc );
+
+  if ( !key )
+    return NULL;
+
+  process_t *row = hashtable_get ( ht_rows, key );
+  if ( row )
+    intern_put ( key );
+  else
+    {
+      row = calloc ( 1, sizeof *row );
+      if ( !row )
+        goto ERROR_KEY;
+
+      row->name = key;
+      row->active = true;
+
+      if ( !hashtable_set ( ht_rows, row->name, row ) )
+        goto ERROR_ROW;
+
+      if ( !vector_push ( view.proc, &row ) )
+        {
+          hashtable_remove ( ht_rows, row->name );
+          goto ERROR_ROW;
+        }
+
+      view.total = vector_size ( view.proc );
+    }
+
+  // pid of row is the total of processes
+  row->pid++;
+
+  return row;
+
+ERROR_ROW:
+  free ( row );
+ERROR_KEY:
+  intern_put ( key );
+  return NULL;
+}
+
+void
+aggregate_leave ( process_t *proc )
+{
+  process_t *row = proc->group;
+
+  proc->group = NULL;
+  if ( !row || --row->pid )
+    return;
+
+  for ( size_t i = 0; i < view.total; i++ )
+    {
+      if ( view.proc[i] != row )
+        continue;
+
+      view.proc[i] = view.proc[view.total - 1];
+      vector_pop ( view.proc );
+      break;
+    }
+
+  view.total = vector_size ( view.proc );
+  hashtable_remove ( ht_rows, row->name );
+  free_row ( row );
+}
+
+struct processes *
+aggregate_view ( void )
+{
+  if ( mode == AGG_NETWORK )
+    return networks_view ();
+
+  return &view;
+}
+
+void
+aggregate_free ( void )
+{
+  if ( ht_rows )
+    hashtable_destroy ( ht_rows );
+
+  if ( view.proc )
+    vector_free ( view.proc );
+
+  ht_rows = NULL;
+  view.proc = NULL;
+  view.total = 0;
+  mode = AGG_NONE;
+}
@@ -0,0 +1,73 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include "processes.h"
+
+/* views with a row by program, user or cgroup instead of by process.
+   each row is a process_t (so is sorted and showed as a process) with the
+   sum of traffic of your processes, pid is the total of processes.
+   rows are updated with the traffic of processes when it is accounted
+   (see statistics.c), not recalculated of processes in each refresh.
+   view by network of remotes is not of processes, your rows are of
+   networks.h and processes not join to them */
+
+enum aggregate_mode
+{
+  AGG_NONE = 0,
+  AGG_PROGRAM,
+  AGG_USER,
+  AGG_CGROUP,
+  AGG_NETWORK,  // rows of networks.h, only with option --networks
+  AGG_MODES     // total elements in enum
+};
+
+enum aggregate_mode
+aggregate_mode ( void );
+
+/* remove all rows and start a new view, the processes must join after it.
+   return false on error */
+bool
+aggregate_reset ( enum aggregate_mode mode );
+
+/* add 'proc' to your row, only the traffic accounted after it is in row.
+   return the row or NULL if view is disabled or on error */
+process_t *
+aggregate_join ( process_t *proc );
+
+// remove 'proc' of your row, row without processes is removed
+void
+aggregate_leave ( process_t *proc );
+
+/* path of cgroup of process, as key of rows by cgroup, interned (see
+   intern.h). return NULL if unknown */
+const char *
+aggregate_cgroup ( const process_t *proc );
+
+// rows of current view
+struct processes *
+aggregate_view ( void );
+
+void
+aggregate_free ( void );
+
+#endif  // AGGREGATE_H
@@ -0,0 +1,145 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdalign.h>  // alignof
+#include <stdlib.h>    // malloc
+#include <string.h>    // memcpy
+
+#include "arena.h"
+#include "macro_util.h"
+
+// size of first chunk, to few processes
+#define ARENA_CHUNK_MIN ( 16 * 1024 )
+
+#define ALIGN_UP( n, a ) ( ( ( n ) + ( a ) - 1 ) & ~( ( a ) - 1 ) )
+
+struct arena_chunk
+{
+  struct arena_chunk *next;
+  char *bump;
+  char *end;
+  alignas ( max_align_t ) char mem[];
+};
+
+static struct arena_chunk *
+chunk_new ( size_t size )
+{
+  struct arena_chunk *chunk = malloc ( sizeof ( *chunk ) + size );
+
+  if ( chunk )
+    {
+      chunk->bump = chunk->mem;
+      chunk->end = chunk->mem + size;
+    }
+
+  return chunk;
+}
+
+void *
+arena_alloc ( struct arena *arena, size_t size )
+{
+  size = ALIGN_UP ( size, alignof ( max_align_t ) );
+
+  struct arena_chunk *chunk = arena->chunks;
+  if ( !chunk || ( size_t ) ( chunk->end - chunk->bump ) < size )
+    {
+      // chunks grow geometrically, few chunks to big scans
+      size_t chunk_size = chunk ? ( size_t ) ( chunk->end - chunk->mem ) * 2
+                                : ARENA_CHUNK_MIN;
+
+      if ( !( chunk = chunk_new ( MAX ( chunk_size, size ) ) ) )
+        return NULL;
+
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+    }
+
+  arena->last = chunk->bump;
+  chunk->bump += size;
+  arena->used += size;
+
+  return arena->last;
+}
+
+void *
+arena_realloc ( struct arena *arena, void *ptr, size_t old_size, size_t size )
+{
+  if ( !ptr )
+    return arena_alloc ( arena, size );
+
+  struct arena_chunk *chunk = arena->chunks;
+  if ( ptr == arena->last )
+    {
+      size_t old = ALIGN_UP ( old_size, alignof ( max_align_t ) );
+      size_t new = ALIGN_UP ( size, alignof ( max_align_t ) );
+
+      if ( new <= old || ( size_t ) ( chunk->end - arena->last ) >= new )
+        {
+          chunk->bump = arena->last + MAX ( new, old );
+          arena->used += MAX ( new, old ) - old;
+          return ptr;
+        }
+    }
+
+  void *new_ptr = arena_alloc ( arena, size );
+  if ( new_ptr )
+    memcpy ( new_ptr, ptr, MIN ( old_size, size ) );
+
+  return new_ptr;
+}
+
+void
+arena_reset ( struct arena *arena )
+{
+  struct arena_chunk *chunk = arena->chunks;
+
+  // one chunk to all memory used in this scan
+  if ( chunk && chunk->next )
+    {
+      size_t size = arena->used;
+      arena_free ( arena );
+
+      // without memory now, try again in next allocation
+      if ( ( chunk = chunk_new ( MAX ( size, ARENA_CHUNK_MIN ) ) ) )
+        chunk->next = NULL;
+
+      arena->chunks = chunk;
+    }
+
+  if ( chunk )
+    chunk->bump = chunk->mem;
+
+  arena->last = NULL;
+  arena->used = 0;
+}
+
+void
+arena_free ( struct arena *arena )
+{
+  struct arena_chunk *chunk = arena->chunks;
+  while ( chunk )
+    {
+      struct arena_chunk *next = chunk->next;
+      free ( chunk );
+      chunk = next;
+    }
+
+  *arena = ( struct arena ) ARENA_INITIALIZER;
+}
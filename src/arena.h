@@ -0,0 +1,60 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* bump allocator to temporary buffers of a scan (of /proc/), the memory is
+   not freed by object but all at once by arena_reset at end of scan.
+   after a reset the arena keeps a chunk of size of all memory used, so
+   next scans of same size not call malloc.
+   an arena is not thread safe */
+
+struct arena_chunk;
+
+struct arena
+{
+  struct arena_chunk *chunks;  // current chunk is the first
+  char *last;                  // last allocation, can grow in place
+  size_t used;                 // bytes used since last reset
+};
+
+#define ARENA_INITIALIZER { 0 }
+
+// return NULL if no memory, memory aligned to max_align_t
+void *
+arena_alloc ( struct arena *arena, size_t size );
+
+/* resize 'ptr' of 'old_size' to 'size', the last allocation grow in place
+   if fit in chunk, others are copied. 'ptr' NULL is as arena_alloc.
+   on failure 'ptr' keep valid */
+void *
+arena_realloc ( struct arena *arena, void *ptr, size_t old_size, size_t size );
+
+// all memory allocated is released to next allocations
+void
+arena_reset ( struct arena *arena );
+
+void
+arena_free ( struct arena *arena );
+
+#endif  // ARENA_H
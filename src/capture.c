@@ -0,0 +1,354 @@
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdalign.h>  // alignof
+#include <stdlib.h>    // calloc, aligned_alloc
+#include <stdbool.h>
+#include <string.h>  // memset
+#include <poll.h>    // poll
+#include <pthread.h>
+#include <signal.h>  // sigfillset
+#include <unistd.h>  // getpid
+
+#include "capture.h"
+#include "sock.h"
+#include "ring.h"
+#include "filter.h"
+#include "packet.h"
+#include "flow_acc.h"
+#include "profile.h"
+#include "affinity.h"
+#include "probe.h"
+#include "lag.h"
+#include "m_error.h"
+
+// time in milliseconds that a worker wait for packets before check
+// if need stop
+#define WORKER_TIMEOUT 250
+
+struct worker
+{
+  // tables of counters by flow, in cache lines of your own
+  struct flow_counters counters;
+
+  struct capture *cap;
+  pthread_t tid;
+
+  struct tap *taps;  // one by interface
+  unsigned int total_taps;
+  bool started;
+};
+
+struct capture
+{
+  struct worker *workers;
+  unsigned int total_workers;
+  unsigned int max_fragments;  // capacity of table of fragments of workers
+  volatile bool stop;
+};
+
+bool
+tap_open ( struct tap *tap,
+           const struct config_op *co,
+           unsigned int iface,
+           const struct filters *filters )
+{
+  tap->block_num = 0;
+
+  if ( -1 == ( tap->sock = socket_init ( co->ifaces[iface], &tap->link ) ) )
+    return false;
+
+  tap->parse = packet_parser ( tap->link );
+
+  if ( !( tap->ring = ring_init ( tap->sock, co, iface ) ) )
+    return false;
+
+  if ( !filter_attach ( tap->sock, &filters->links[tap->link] ) )
+    return false;
+
+  if ( co->busy_poll && !socket_busy_poll ( tap->sock, co->busy_poll ) )
+    return false;
+
+  return true;
+}
+
+void
+tap_close ( struct tap *tap )
+{
+  ring_free ( tap->ring );
+  socket_free ( tap->sock );
+  tap->ring = NULL;
+  tap->sock = -1;
+}
+
+bool
+tap_read_block ( struct tap *tap, struct flow_acc *acc )
+{
+  struct tpacket_block_desc *pbd = tap_block ( tap );
+
+  if ( !( pbd->hdr.bh1.block_status & TP_STATUS_USER ) )
+    return false;
+
+  struct tpacket3_hdr *ppd;
+
+  ppd = ( struct tpacket3_hdr * ) ( ( uint8_t * ) pbd +
+                                    pbd->hdr.bh1.offset_to_first_pkt );
+
+  PROBE2 ( block_acquire, tap->block_num, pbd->hdr.bh1.num_pkts );
+
+  lag_block ( pbd->hdr.bh1.ts_last_pkt.ts_sec,
+              pbd->hdr.bh1.ts_last_pkt.ts_nsec );
+
+  // expire old fragments with time of capture, without syscall
+  packet_tick ( pbd->hdr.bh1.ts_last_pkt.ts_sec );
+
+  uint64_t cycles = profile_cycles_start ();
+
+  for ( size_t i = 0; i < pbd->hdr.bh1.num_pkts; i++,
+               ppd = ( struct tpacket3_hdr * ) ( ( uint8_t * ) ppd +
+                                                 ppd->tp_next_offset ) )
+    {
+      struct packet packet = { 0 };
+      if ( tap->parse ( &packet, ppd ) )
+        flow_acc_add ( acc, &packet, packet.lenght, packet.segments );
+    }
+
+  profile_packets ( cycles, pbd->hdr.bh1.num_pkts );
+
+  PROBE1 ( block_release, tap->block_num );
+  tap_release ( tap, pbd );
+
+  return true;
+}
+
+// read all blocks availables of ring of interface
+static void
+worker_read ( struct worker *w, struct tap *tap )
+{
+  bool read;
+
+  // table is entered by block, so the merge not wait a burst of blocks
+  do
+    {
+      struct flow_acc *acc = flow_counters_enter ( &w->counters );
+      read = tap_read_block ( tap, acc );
+      flow_counters_leave ( &w->counters );
+    }
+  while ( read );
+}
+
+static void *
+capture_worker ( void *arg )
+{
+  struct worker *w = arg;
+  struct pollfd pfds[MAX_IFACES];
+
+  // rings of all interfaces are waited together
+  for ( unsigned int i = 0; i < w->total_taps; i++ )
+    pfds[i] = ( struct pollfd ){ .fd = w->taps[i].sock,
+                                 .events = POLLIN | POLLPRI };
+
+  // without table, fragments are not computed
+  if ( !packet_init ( w->cap->max_fragments ) )
+    {
+      ERROR_DEBUG ( "%s", "Error alloc table of fragments" );
+    }
+
+  while ( !w->cap->stop )
+    {
+      for ( unsigned int i = 0; i < w->total_taps; i++ )
+        worker_read ( w, &w->taps[i] );
+
+      poll ( pfds, w->total_taps, WORKER_TIMEOUT );
+    }
+
+  packet_free ();
+
+  return NULL;
+}
+
+static bool
+worker_init ( struct worker *w,
+              struct capture *cap,
+              const struct config_op *co,
+              const struct filters *filters,
+              const uint16_t group_id )
+{
+  w->cap = cap;
+
+  w->taps = calloc ( co->total_ifaces, sizeof ( *w->taps ) );
+  if ( !w->taps )
+    return false;
+
+  for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+    {
+      // increment first, tap partially opened is cleaned up
+      w->total_taps++;
+      if ( !tap_open ( &w->taps[i], co, i, filters ) )
+        return false;
+
+      // a fanout group can have only sockets of same interface
+      if ( !socket_fanout ( w->taps[i].sock, group_id + i ) )
+        return false;
+    }
+
+  return flow_counters_init ( &w->counters );
+}
+
+struct capture *
+capture_init ( const struct config_op *co, const struct filters *filters )
+{
+  struct capture *cap = calloc ( 1, sizeof *cap );
+  if ( !cap )
+    return NULL;
+
+  // workers not share cache lines, size of struct is multiple of alignment
+  size_t size = co->capture_threads * sizeof ( *cap->workers );
+  cap->workers = aligned_alloc ( alignof ( struct worker ), size );
+  if ( !cap->workers )
+    goto ERROR_EXIT;
+
+  memset ( cap->workers, 0, size );
+
+  cap->max_fragments = co->max_fragments;
+
+  uint16_t group_id = getpid () & 0xffff;
+
+  for ( unsigned int i = 0; i < co->capture_threads; i++ )
+    {
+      struct worker *w = &cap->workers[i];
+
+      /* ring and tables are allocated in the NUMA node of CPU of worker,
+         by kernel and by first touch */
+      affinity_pin_capture ( i );
+
+      // increment first, worker partially initialized is cleaned up
+      cap->total_workers++;
+      if ( !worker_init ( w, cap, co, filters, group_id ) )
+        {
+          ERROR_DEBUG ( "Error init capture worker %u", i );
+          goto ERROR_EXIT;
+        }
+    }
+
+  // signals must be delivered only to main thread
+  sigset_t set, old_set;
+  sigfillset ( &set );
+  pthread_sigmask ( SIG_SETMASK, &set, &old_set );
+
+  for ( unsigned int i = 0; i < cap->total_workers; i++ )
+    {
+      struct worker *w = &cap->workers[i];
+
+      // worker inherit the affinity
+      affinity_pin_capture ( i );
+
+      if ( pthread_create ( &w->tid, NULL, capture_worker, w ) )
+        {
+          ERROR_DEBUG ( "Error create capture worker %u", i );
+          pthread_sigmask ( SIG_SETMASK, &old_set, NULL );
+          goto ERROR_EXIT;
+        }
+
+      w->started = true;
+    }
+
+  pthread_sigmask ( SIG_SETMASK, &old_set, NULL );
+  affinity_unpin ();
+
+  return cap;
+
+ERROR_EXIT:
+  affinity_unpin ();
+  capture_free ( cap );
+  return NULL;
+}
+
+bool
+capture_merge ( struct capture *cap, bool view_conections )
+{
+  bool miss = false;
+
+  // worker follow accumulating in other table
+  for ( unsigned int i = 0; i < cap->total_workers; i++ )
+    {
+      if ( flow_counters_merge ( &cap->workers[i].counters, view_conections ) )
+        miss = true;
+    }
+
+  return miss;
+}
+
+bool
+capture_filter ( struct capture *cap, const struct filters *filters )
+{
+  for ( unsigned int i = 0; i < cap->total_workers; i++ )
+    {
+      struct worker *w = &cap->workers[i];
+
+      for ( unsigned int t = 0; t < w->total_taps; t++ )
+        {
+          struct tap *tap = &w->taps[t];
+
+          if ( !filter_attach ( tap->sock, &filters->links[tap->link] ) )
+            return false;
+        }
+    }
+
+  return true;
+}
+
+void
+capture_stats ( struct capture *cap, struct sock_stats *stats )
+{
+  for ( unsigned int i = 0; i < cap->total_workers; i++ )
+    {
+      struct worker *w = &cap->workers[i];
+
+      for ( unsigned int t = 0; t < w->total_taps; t++ )
+        socket_stats ( w->taps[t].sock, stats );
+    }
+}
+
+void
+capture_free ( struct capture *cap )
+{
+  if ( !cap )
+    return;
+
+  cap->stop = true;
+
+  for ( unsigned int i = 0; i < cap->total_workers; i++ )
+    {
+      struct worker *w = &cap->workers[i];
+
+      if ( w->started )
+        pthread_join ( w->tid, NULL );
+
+      flow_counters_free ( &w->counters );
+
+      for ( unsigned int t = 0; t < w->total_taps; t++ )
+        tap_close ( &w->taps[t] );
+
+      free ( w->taps );
+    }
+
+  free ( cap->workers );
+  free ( cap );
+}
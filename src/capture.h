@@ -0,0 +1,105 @@
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+
+#include "config.h"
+#include "sock.h"
+#include "ring.h"
+#include "filter.h"
+#include "flow_acc.h"
+#include "packet.h"  // parse_func
+
+/* socket of capture of an interface with your ring, read by a worker or,
+   without workers, by main thread */
+struct tap
+{
+  struct ring *ring;
+  parse_func parse;  // parser of link of interface
+  unsigned int block_num;  // next block to read
+  enum link_type link;
+  int sock;
+};
+
+/* bind socket to interface co->ifaces[iface], with ring, filter of link of
+   interface and busy poll of options. return false on error, tap partially
+   opened is closed by tap_close */
+bool
+tap_open ( struct tap *tap,
+           const struct config_op *co,
+           unsigned int iface,
+           const struct filters *filters );
+
+// next block of ring, of user only with TP_STATUS_USER
+static inline struct tpacket_block_desc *
+tap_block ( const struct tap *tap )
+{
+  return ( struct tpacket_block_desc * ) tap->ring->rd[tap->block_num]
+          .iov_base;
+}
+
+// pass block controller to kernel and rotate block
+static inline void
+tap_release ( struct tap *tap, struct tpacket_block_desc *pbd )
+{
+  pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+  tap->block_num = ( tap->block_num + 1 ) % tap->ring->req.tp_block_nr;
+}
+
+/* parse packets of next block of ring to counters of flows 'acc' and
+   release the block. return false if block still is of kernel */
+bool
+tap_read_block ( struct tap *tap, struct flow_acc *acc );
+
+void
+tap_close ( struct tap *tap );
+
+/* multi-thread capture, each worker has your own socket and ring by
+   interface, the sockets of an interface are in the same PACKET_FANOUT group,
+   so the kernel distributes the traffic between workers by hash of flow.
+   workers only parse packets and accumulate counters per flow, the counters
+   are merged in statistics of processes by main thread in each refresh */
+
+struct capture;
+
+/* filter of link of interface is attached to socket of each worker */
+struct capture *
+capture_init ( const struct config_op *co, const struct filters *filters );
+
+/* merge counters of all workers in statistics of processes/connections,
+   return true if any flow not was found (need update of processes) */
+bool
+capture_merge ( struct capture *cap, bool view_conections );
+
+/* replace filter of sockets of all workers, of link of each socket */
+bool
+capture_filter ( struct capture *cap, const struct filters *filters );
+
+/* add to 'stats' the counters of kernel of sockets of all workers
+   since last call */
+void
+capture_stats ( struct capture *cap, struct sock_stats *stats );
+
+void
+capture_free ( struct capture *cap );
+
+#endif  // CAPTURE_H
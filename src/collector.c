@@ -0,0 +1,755 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE  // accept4
+
+#include <errno.h>   // variable errno
+#include <stdio.h>   // snprintf
+#include <stdlib.h>  // malloc
+#include <string.h>  // strerror, memcmp
+#include <unistd.h>  // close
+#include <netinet/in.h>
+#include <arpa/inet.h>  // htonl
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "collector.h"
+#include "agent.h"
+#include "rate.h"
+#include "topk.h"
+#include "intern.h"
+#include "sock.h"  // socket_resolve
+#include "vector.h"
+#include "m_error.h"
+#include "macro_util.h"
+
+// agents simultaneous, others are closed on accept
+#define MAX_AGENTS 8192
+
+// events by epoll_wait, agents with more data are read in next call
+#define MAX_EVENTS 256
+
+// bytes received of each agent, buffer grows if a record not fit
+#define AGENT_BUFFER_MIN ( 16 * 1024 )
+#define AGENT_BUFFER_MAX ( 4 * 1024 * 1024 )
+
+// max of processes by agent and length of strings
+#define MAX_IDS ( 1024 * 1024 )
+#define MAX_STRING ( 64 * 1024 )
+
+// ids of agent are sequential, an id only can be a few after the last
+#define ID_SLACK 64
+
+/* memory of all agents, buffers, strings and processes. agent that pass it
+   is closed */
+#define MAX_AGENTS_MEMORY ( 256 * 1024 * 1024 )
+
+// result of parse of a record
+enum
+{
+  PARSE_INVALID = -1,
+  PARSE_MORE,  // record not received entire
+  PARSE_DONE
+};
+
+struct agent
+{
+  uint8_t *data;  // bytes received, not parsed
+  size_t len;
+  size_t size;
+  const char *host;      // interned, NULL while header not received
+  const char **strings;  // dictionary, by id
+  process_t **by_id;     // processes by id, NULL if closed
+  size_t memory;         // of agent in total_memory
+  int fd;
+};
+
+struct reader
+{
+  const uint8_t *pos;
+  const uint8_t *end;
+};
+
+static struct agent **agents;
+static process_t **closed;  // removed of view in collector_update
+static size_t total_memory;  // of all agents, up to MAX_AGENTS_MEMORY
+static bool remotes;        // option --top-remotes
+static int listen_fd = -1;
+static int epfd = -1;
+
+static bool
+get_varint ( struct reader *r, uint64_t *value )
+{
+  *value = 0;
+
+  for ( unsigned int shift = 0; shift < 64 && r->pos < r->end; shift += 7 )
+    {
+      uint8_t c = *r->pos++;
+
+      *value |= ( uint64_t ) ( c & 0x7f ) << shift;
+      if ( !( c & 0x80 ) )
+        return true;
+    }
+
+  return false;
+}
+
+static const uint8_t *
+get_raw ( struct reader *r, size_t len )
+{
+  if ( ( size_t ) ( r->end - r->pos ) < len )
+    return NULL;
+
+  const uint8_t *data = r->pos;
+  r->pos += len;
+
+  return data;
+}
+
+static bool
+memory_add ( struct agent *ag, size_t size )
+{
+  if ( size > MAX_AGENTS_MEMORY - total_memory )
+    {
+      ERROR_DEBUG ( "Memory of agents full, agent '%s' is closed",
+                    ( ag->host ) ? ag->host : "unknown" );
+      return false;
+    }
+
+  ag->memory += size;
+  total_memory += size;
+
+  return true;
+}
+
+static void
+memory_sub ( struct agent *ag, size_t size )
+{
+  ag->memory -= size;
+  total_memory -= size;
+}
+
+// memory of a process of agent, with your name and sketch of remotes
+static size_t
+process_memory ( const process_t *proc )
+{
+  return sizeof *proc + intern_len ( proc->name ) +
+         ( ( proc->remotes ) ? sizeof *proc->remotes : 0 );
+}
+
+static void
+free_process ( process_t *proc )
+{
+  rate_net_stat_free ( &proc->net_stat );
+  topk_free ( proc->remotes );
+  intern_put ( proc->name );
+  free ( proc );
+}
+
+// process stay in view until collector_update
+static void
+close_process ( struct agent *ag, uint64_t id )
+{
+  process_t *proc = ag->by_id[id];
+
+  ag->by_id[id] = NULL;
+  proc->active = false;
+
+  memory_sub ( ag, process_memory ( proc ) );
+
+  if ( !vector_push ( closed, &proc ) )
+    {
+      // without memory, the row stay in view without traffic
+      ERROR_DEBUG ( "%s", "Error alloc processes closed of collector" );
+    }
+}
+
+static void
+reset_strings ( struct agent *ag )
+{
+  size_t n = vector_size ( ag->strings );
+
+  for ( size_t i = 0; i < n; i++ )
+    {
+      memory_sub ( ag, intern_len ( ag->strings[i] ) + sizeof ( char * ) );
+      intern_put ( ag->strings[i] );
+    }
+
+  vector_clear ( ag->strings );
+}
+
+static void
+agent_close ( struct agent *ag )
+{
+  size_t n = vector_size ( ag->by_id );
+
+  for ( size_t i = 0; i < n; i++ )
+    {
+      if ( ag->by_id[i] )
+        close_process ( ag, i );
+    }
+
+  reset_strings ( ag );
+  vector_free ( ag->strings );
+  vector_free ( ag->by_id );
+  intern_put ( ag->host );
+  close ( ag->fd );
+  free ( ag->data );
+
+  // buffer and ids
+  memory_sub ( ag, ag->memory );
+
+  n = vector_size ( agents );
+  for ( size_t i = 0; i < n; i++ )
+    {
+      if ( agents[i] != ag )
+        continue;
+
+      agents[i] = agents[n - 1];
+      vector_pop ( agents );
+      break;
+    }
+
+  free ( ag );
+}
+
+static int
+parse_header ( struct agent *ag, struct reader *r )
+{
+  uint64_t refresh, len;
+  const uint8_t *magic = get_raw ( r, AGENT_MAGIC_SIZE );
+
+  if ( magic && memcmp ( magic, AGENT_MAGIC, AGENT_MAGIC_SIZE ) )
+    return PARSE_INVALID;
+
+  if ( !magic || !get_varint ( r, &refresh ) || !get_varint ( r, &len ) )
+    return PARSE_MORE;
+
+  if ( !len || len > MAX_STRING )
+    return PARSE_INVALID;
+
+  const uint8_t *host = get_raw ( r, len );
+  if ( !host )
+    return PARSE_MORE;
+
+  ag->host = intern ( ( const char * ) host, len );
+
+  return ( ag->host ) ? PARSE_DONE : PARSE_INVALID;
+}
+
+static int
+parse_string ( struct agent *ag, struct reader *r )
+{
+  uint64_t id, len;
+
+  if ( !get_varint ( r, &id ) || !get_varint ( r, &len ) )
+    return PARSE_MORE;
+
+  // ids of dictionary are sequential
+  if ( id != vector_size ( ag->strings ) || len > MAX_STRING )
+    return PARSE_INVALID;
+
+  const uint8_t *str = get_raw ( r, len );
+  if ( !str )
+    return PARSE_MORE;
+
+  if ( !memory_add ( ag, len + sizeof ( char * ) ) )
+    return PARSE_INVALID;
+
+  const char *istr = intern ( ( const char * ) str, len );
+  if ( !istr || !vector_push ( ag->strings, &istr ) )
+    {
+      memory_sub ( ag, len + sizeof ( char * ) );
+      intern_put ( istr );
+      return PARSE_INVALID;
+    }
+
+  return PARSE_DONE;
+}
+
+static int
+parse_process ( struct agent *ag, struct reader *r, struct processes *view )
+{
+  uint64_t id, pid, name, cgroup;
+  size_t total_strings = vector_size ( ag->strings );
+
+  if ( !get_varint ( r, &id ) || !get_varint ( r, &pid ) ||
+       !get_varint ( r, &name ) || !get_varint ( r, &cgroup ) )
+    return PARSE_MORE;
+
+  // ids not are alloced to any value of agent
+  size_t total_ids = vector_size ( ag->by_id );
+  if ( id >= MAX_IDS || id > total_ids + ID_SLACK || name >= total_strings ||
+       cgroup > total_strings )
+    return PARSE_INVALID;
+
+  if ( id >= total_ids &&
+       !memory_add ( ag, ( id + 1 - total_ids ) * sizeof ( process_t * ) ) )
+    return PARSE_INVALID;
+
+  while ( vector_size ( ag->by_id ) <= id )
+    {
+      process_t *null = NULL;
+      if ( !vector_push ( ag->by_id, &null ) )
+        return PARSE_INVALID;
+    }
+
+  // id reused without exit
+  if ( ag->by_id[id] )
+    close_process ( ag, id );
+
+  // rows of all hosts in same view, name with host and cgroup
+  const char *pname = ag->strings[name];
+  char *buff = malloc ( intern_len ( ag->host ) + intern_len ( pname ) +
+                        ( ( cgroup ) ? intern_len ( ag->strings[cgroup - 1] )
+                                     : 0 ) +
+                        sizeof ( "  [] " ) );
+  if ( !buff )
+    return PARSE_INVALID;
+
+  int len;
+  if ( cgroup && strcmp ( ag->strings[cgroup - 1], "/" ) )
+    len = sprintf ( buff,
+                    "%s [%s] %s",
+                    ag->host,
+                    ag->strings[cgroup - 1],
+                    pname );
+  else
+    len = sprintf ( buff, "%s %s", ag->host, pname );
+
+  // as process_memory
+  if ( !memory_add ( ag, sizeof ( process_t ) + len ) )
+    {
+      free ( buff );
+      return PARSE_INVALID;
+    }
+
+  process_t *proc = calloc ( 1, sizeof *proc );
+  if ( !proc || !( proc->name = intern ( buff, len ) ) ||
+       !vector_push ( view->proc, &proc ) )
+    {
+      memory_sub ( ag, sizeof ( process_t ) + len );
+      free ( buff );
+      if ( proc )
+        intern_put ( proc->name );
+      free ( proc );
+      return PARSE_INVALID;
+    }
+
+  free ( buff );
+  proc->pid = pid;
+  proc->active = true;
+  ag->by_id[id] = proc;
+  view->total++;
+
+  return PARSE_DONE;
+}
+
+// process of id read, NULL if invalid or closed
+static process_t *
+get_process ( struct agent *ag, uint64_t id )
+{
+  if ( id >= vector_size ( ag->by_id ) )
+    return NULL;
+
+  return ag->by_id[id];
+}
+
+static int
+parse_traffic ( struct agent *ag, struct reader *r, uint32_t tick )
+{
+  uint64_t id, rx, tx, pps_rx, pps_tx;
+
+  if ( !get_varint ( r, &id ) || !get_varint ( r, &rx ) ||
+       !get_varint ( r, &tx ) || !get_varint ( r, &pps_rx ) ||
+       !get_varint ( r, &pps_tx ) )
+    return PARSE_MORE;
+
+  process_t *proc = get_process ( ag, id );
+  if ( !proc )
+    return PARSE_INVALID;
+
+  if ( rx )
+    rate_add_rx_n ( &proc->net_stat, rx, pps_rx, tick );
+  if ( tx )
+    rate_add_tx_n ( &proc->net_stat, tx, pps_tx, tick );
+
+  return PARSE_DONE;
+}
+
+// sketch of agent replace the previous
+static int
+parse_remotes ( struct agent *ag, struct reader *r )
+{
+  uint64_t id, total;
+
+  if ( !get_varint ( r, &id ) || !get_varint ( r, &total ) )
+    return PARSE_MORE;
+
+  process_t *proc = get_process ( ag, id );
+  if ( !proc || total > TOPK_ENTRIES )
+    return PARSE_INVALID;
+
+  struct topk tk = { .total = total };
+
+  for ( unsigned int i = 0; i < total; i++ )
+    {
+      struct topk_entry *e = &tk.entries[i];
+      uint64_t family, port;
+      const uint8_t *addr;
+
+      if ( !get_varint ( r, &family ) || !get_varint ( r, &port ) )
+        return PARSE_MORE;
+
+      if ( ( family != AF_INET && family != AF_INET6 ) || port > UINT16_MAX )
+        return PARSE_INVALID;
+
+      size_t len =
+              ( family == AF_INET ) ? sizeof e->key.addr.ip : sizeof e->key.addr;
+      if ( !( addr = get_raw ( r, len ) ) || !get_varint ( r, &e->bytes ) )
+        return PARSE_MORE;
+
+      memcpy ( &e->key.addr, addr, len );
+      e->key.port = port;
+      e->key.family = family;
+    }
+
+  if ( !remotes )
+    return PARSE_DONE;
+
+  if ( !proc->remotes )
+    {
+      if ( !memory_add ( ag, sizeof *proc->remotes ) )
+        return PARSE_INVALID;
+
+      if ( !( proc->remotes = topk_new () ) )
+        {
+          memory_sub ( ag, sizeof *proc->remotes );
+          return PARSE_DONE;
+        }
+    }
+
+  *proc->remotes = tk;
+
+  return PARSE_DONE;
+}
+
+static int
+parse_exit ( struct agent *ag, struct reader *r )
+{
+  uint64_t id;
+
+  if ( !get_varint ( r, &id ) )
+    return PARSE_MORE;
+
+  if ( !get_process ( ag, id ) )
+    return PARSE_INVALID;
+
+  close_process ( ag, id );
+
+  return PARSE_DONE;
+}
+
+static int
+parse_record ( struct agent *ag,
+               struct reader *r,
+               struct processes *view,
+               uint32_t tick )
+{
+  uint64_t value;
+
+  if ( !ag->host )
+    return parse_header ( ag, r );
+
+  if ( r->pos == r->end )
+    return PARSE_MORE;
+
+  switch ( *r->pos++ )
+    {
+      case AGT_TICK:
+        return ( get_varint ( r, &value ) ) ? PARSE_DONE : PARSE_MORE;
+      case AGT_STRING:
+        return parse_string ( ag, r );
+      case AGT_PROCESS:
+        return parse_process ( ag, r, view );
+      case AGT_TRAFFIC:
+        return parse_traffic ( ag, r, tick );
+      case AGT_REMOTES:
+        return parse_remotes ( ag, r );
+      case AGT_EXIT:
+        return parse_exit ( ag, r );
+      case AGT_RESET:
+        reset_strings ( ag );
+        return PARSE_DONE;
+      default:
+        return PARSE_INVALID;
+    }
+}
+
+/* read all available of agent and parse the records entire, the last
+   record can be incomplete, it stay in buffer. return false to close */
+static bool
+agent_read ( struct agent *ag, struct processes *view, uint32_t tick )
+{
+  while ( true )
+    {
+      if ( ag->len == ag->size )
+        {
+          size_t size = ag->size * 2;
+          uint8_t *data;
+
+          if ( size > AGENT_BUFFER_MAX || !memory_add ( ag, ag->size ) )
+            return false;
+
+          if ( !( data = realloc ( ag->data, size ) ) )
+            {
+              memory_sub ( ag, ag->size );
+              return false;
+            }
+
+          ag->data = data;
+          ag->size = size;
+        }
+
+      ssize_t n = recv ( ag->fd, ag->data + ag->len, ag->size - ag->len, 0 );
+      if ( n == -1 )
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+      if ( !n )
+        return false;
+
+      ag->len += n;
+
+      struct reader r = { .pos = ag->data, .end = ag->data + ag->len };
+      const uint8_t *start = r.pos;
+      int ret;
+
+      while ( ( ret = parse_record ( ag, &r, view, tick ) ) == PARSE_DONE )
+        start = r.pos;
+
+      if ( ret == PARSE_INVALID )
+        {
+          ERROR_DEBUG ( "Record invalid of agent '%s'",
+                        ( ag->host ) ? ag->host : "unknown" );
+          return false;
+        }
+
+      // records received entire are applied, only the tail is kept
+      ag->len -= start - ag->data;
+      memmove ( ag->data, start, ag->len );
+    }
+}
+
+static void
+agent_accept ( void )
+{
+  int fd;
+
+  while ( ( fd = accept4 (
+                    listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC ) ) !=
+          -1 )
+    {
+      struct agent *ag = NULL;
+
+      if ( vector_size ( agents ) >= MAX_AGENTS ||
+           !( ag = calloc ( 1, sizeof *ag ) ) )
+        goto ERROR;
+
+      ag->fd = fd;
+      ag->size = AGENT_BUFFER_MIN;
+      if ( !memory_add ( ag, ag->size ) )
+        goto ERROR;
+
+      ag->data = malloc ( ag->size );
+      ag->strings = vector_new ( sizeof ( const char * ) );
+      ag->by_id = vector_new ( sizeof ( process_t * ) );
+      if ( !ag->data || !ag->strings || !ag->by_id )
+        goto ERROR;
+
+      struct epoll_event ev = { .events = EPOLLIN, .data.ptr = ag };
+      if ( epoll_ctl ( epfd, EPOLL_CTL_ADD, fd, &ev ) == -1 ||
+           !vector_push ( agents, &ag ) )
+        goto ERROR;
+
+      continue;
+
+    ERROR:
+      if ( ag )
+        {
+          memory_sub ( ag, ag->memory );
+          free ( ag->data );
+          if ( ag->strings )
+            vector_free ( ag->strings );
+          if ( ag->by_id )
+            vector_free ( ag->by_id );
+          free ( ag );
+        }
+
+      close ( fd );
+    }
+}
+
+bool
+collector_init ( const struct config_op *co )
+{
+  remotes = co->top_remotes;
+
+  agents = vector_new ( sizeof ( struct agent * ) );
+  closed = vector_new ( sizeof ( process_t * ) );
+  if ( !agents || !closed )
+    goto ERROR;
+
+  /* agents are not authenticated, so without address only of loopback.
+     address '::' is of ipv4 and ipv6 */
+  struct sockaddr_storage addr = { 0 };
+  struct sockaddr_in *loopback = ( struct sockaddr_in * ) &addr;
+  socklen_t addr_len = sizeof *loopback;
+
+  loopback->sin_family = AF_INET;
+  loopback->sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+  loopback->sin_port = htons ( co->collector );
+
+  if ( co->collector_addr &&
+       !socket_resolve ( co->collector_addr, SOCK_STREAM, &addr, &addr_len ) )
+    {
+      ERROR_DEBUG ( "Error address of collector '%s'", co->collector_addr );
+      goto ERROR;
+    }
+
+  listen_fd = socket (
+          addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  if ( listen_fd == -1 )
+    {
+      ERROR_DEBUG ( "Error create socket of collector: %s",
+                    strerror ( errno ) );
+      goto ERROR;
+    }
+
+  int opt = 0;
+  if ( addr.ss_family == AF_INET6 )
+    setsockopt ( listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof opt );
+  opt = 1;
+  setsockopt ( listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt );
+
+  if ( bind ( listen_fd, ( struct sockaddr * ) &addr, addr_len ) == -1 ||
+       listen ( listen_fd, SOMAXCONN ) == -1 )
+    {
+      ERROR_DEBUG ( "Error listen port %u: %s",
+                    co->collector,
+                    strerror ( errno ) );
+      goto ERROR;
+    }
+
+  epfd = epoll_create1 ( EPOLL_CLOEXEC );
+  if ( epfd == -1 )
+    goto ERROR;
+
+  struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+  if ( epoll_ctl ( epfd, EPOLL_CTL_ADD, listen_fd, &ev ) == -1 )
+    goto ERROR;
+
+  return true;
+
+ERROR:
+  collector_free ( NULL );
+  return false;
+}
+
+int
+collector_fd ( void )
+{
+  return epfd;
+}
+
+void
+collector_handle ( struct processes *view, uint32_t tick )
+{
+  struct epoll_event events[MAX_EVENTS];
+
+  int ne = epoll_wait ( epfd, events, ARRAY_SIZE ( events ), 0 );
+
+  for ( int i = 0; i < ne; i++ )
+    {
+      struct agent *ag = events[i].data.ptr;
+
+      // listen socket
+      if ( !ag )
+        {
+          agent_accept ();
+          continue;
+        }
+
+      if ( !agent_read ( ag, view, tick ) )
+        agent_close ( ag );
+    }
+}
+
+void
+collector_update ( struct processes *view )
+{
+  size_t n = vector_size ( closed );
+  if ( !n )
+    return;
+
+  // one pass in view to all processes closed
+  size_t total = 0;
+  for ( size_t i = 0; i < view->total; i++ )
+    {
+      if ( view->proc[i]->active )
+        view->proc[total++] = view->proc[i];
+    }
+
+  while ( view->total > total )
+    {
+      vector_pop ( view->proc );
+      view->total--;
+    }
+
+  for ( size_t i = 0; i < n; i++ )
+    free_process ( closed[i] );
+
+  vector_clear ( closed );
+}
+
+void
+collector_free ( struct processes *view )
+{
+  while ( agents && vector_size ( agents ) )
+    agent_close ( agents[0] );
+
+  if ( view )
+    collector_update ( view );
+
+  if ( agents )
+    vector_free ( agents );
+  agents = NULL;
+
+  if ( closed )
+    vector_free ( closed );
+  closed = NULL;
+
+  if ( listen_fd != -1 )
+    close ( listen_fd );
+  listen_fd = -1;
+
+  if ( epfd != -1 )
+    close ( epfd );
+  epfd = -1;
+}
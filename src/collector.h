@@ -0,0 +1,57 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLLECTOR_H
+#define COLLECTOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "processes.h"
+#include "config.h"
+
+/* receive the traffic of agents (see agent.h) in TCP port co->collector and
+   merge it in one view, each process of each host is a row, with name
+   "host name" or "host [cgroup] name". the traffic is accounted in tick of
+   arrival, the clocks of hosts are not used. processes of a agent are
+   removed when it disconnect.
+   agents are not authenticated, the address is of co->collector_addr or of
+   loopback, and the memory of all agents is limited */
+
+bool
+collector_init ( const struct config_op *co );
+
+// file descriptor (epoll) readable when there are agents to handle
+int
+collector_fd ( void );
+
+/* accept agents and add to processes of 'view', with rate_add_*, the
+   traffic received in tick 'tick' */
+void
+collector_handle ( struct processes *view, uint32_t tick );
+
+// remove of 'view' the processes closed, before of rate_calc
+void
+collector_update ( struct processes *view );
+
+void
+collector_free ( struct processes *view );
+
+#endif  // COLLECTOR_H
@@ -22,25 +22,76 @@
 #include <stdbool.h>
 #include <stdlib.h>  // exit
 #include <string.h>  // strncmp
+#include <errno.h>
 #include <unistd.h>  // EXIT_*
 
 #include "config.h"
 #include "connection.h"
+#include "packet.h"  // FRAGMENTS_DEFAULT
+#include "rate.h"    // RATE_WINDOW_DEFAULT
 #include "usage.h"
 #include "macro_util.h"
 
 // default options
-static struct config_op co = { .iface = NULL,  // all interfaces
+static struct config_op co = { .ifaces = { NULL },  // all interfaces
+                               .total_ifaces = 0,
                                .path_log = PROG_NAME_LOG,
+                               .exclude_file = NULL,
                                .log = false,
+                               .log_summary = LOG_SUMMARY_DEFAULT,
+                               .metrics_port = 0,
+                               .record = NULL,
+                               .agent = NULL,
+                               .collector = 0,
+                               .collector_addr = NULL,
+                               .flow_export = NULL,
+                               .flow_file = NULL,
+                               .stream = 0,
+                               .stream_socket = NULL,
+                               .top_remotes = 0,
+                               .networks = NULL,
+                               .shm = NULL,
+                               .control = NULL,
+                               .read_file = NULL,
+                               .sample = 1,
+                               .dns_cache = DNS_CACHE_DEFAULT,
+                               .dns_cache_file = NULL,
+                               .replay = NULL,
+                               .replay_speed = 1,
                                .proto = TCP | UDP,
                                .color_scheme = 0,
+                               .capture_threads = 1,
+                               .capture_cpus = NULL,
+                               .ring_blocks = 0,
+                               .ring_block_size = 0,
+                               .ring_timeout = 0,
+                               .ring_auto = false,
+                               .ring_lock = false,
+                               .busy_poll = 0,
+                               .snaplen = 0,
+                               .max_fragments = FRAGMENTS_DEFAULT,
+                               .max_memory = 0,
+                               .max_subflows = 0,
+                               .refresh = REFRESH_DEFAULT,
+                               .rate_windows = { RATE_WINDOW_DEFAULT },
+                               .total_rate_windows = 1,
+                               .hugepages = false,
+                               .loopback = false,
+                               .ebpf = false,
+                               .ebpf_sockets = false,
+                               .ebpf_files = false,
+                               .xdp = false,
                                .view_si = false,
                                .view_bytes = false,
                                .view_conections = false,
                                .translate_host = true,
                                .translate_service = true,
                                .verbose = false,
+                               .self_stats = false,
+                               .headless = false,
+                               .read_fast = false,
+                               .sample_auto = false,
+                               .overload_auto = false,
                                .running = 0 };
 
 static void
@@ -92,15 +143,6 @@ show_help ( UNUSED char *arg )
   exit ( EXIT_SUCCESS );
 }
 
-static void
-iface ( char *arg )
-{
-  if ( !arg )
-    fatal_config ( "Argument '-i' requere interface name" );
-
-  co.iface = arg;
-}
-
 static void
 show_numeric_host ( UNUSED char *arg )
 {
@@ -134,6 +176,479 @@ set_proto ( char *arg )
     fatal_config ( "Invalid protocol in argument '-p'" );
 }
 
+// return value of arg if is a number between min and max, otherwise
+// finish program with msg
+static long
+number_arg ( const char *arg, long min, long max, const char *msg )
+{
+  char *end;
+  long value;
+
+  if ( !arg )
+    fatal_config ( msg );
+
+  errno = 0;
+  value = strtol ( arg, &end, 10 );
+  if ( errno || end == arg || *end != '\0' || value < min || value > max )
+    fatal_config ( msg );
+
+  return value;
+}
+
+static void
+iface ( char *arg )
+{
+  static const char msg[] = "Argument '-i' requires up to 16 interfaces, "
+                            "as 'eth0,eth1:64', ':N' are blocks of ring "
+                            "(2 to 4096) of interface";
+
+  if ( !arg )
+    fatal_config ( "Argument '-i' requere interface name" );
+
+  for ( char *save, *tok = strtok_r ( arg, ",", &save ); tok;
+        tok = strtok_r ( NULL, ",", &save ) )
+    {
+      if ( co.total_ifaces == MAX_IFACES )
+        fatal_config ( msg );
+
+      // size of ring of your own, in place of '--ring-blocks'
+      char *blocks = strchr ( tok, ':' );
+      if ( blocks )
+        {
+          *blocks++ = '\0';
+          co.iface_blocks[co.total_ifaces] =
+                  number_arg ( blocks, 2, MAX_RING_BLOCKS, msg );
+        }
+
+      if ( !*tok )
+        fatal_config ( msg );
+
+      // same packets would be read by two sockets
+      for ( unsigned int i = 0; i < co.total_ifaces; i++ )
+        {
+          if ( !strcmp ( co.ifaces[i], tok ) )
+            fatal_config ( "Interface repeated in argument '-i'" );
+        }
+
+      co.ifaces[co.total_ifaces++] = tok;
+    }
+}
+
+static void
+capture_threads ( char *arg )
+{
+  co.capture_threads = number_arg (
+          arg,
+          0,
+          MAX_CAPTURE_THREADS,
+          "Argument '--capture-threads' requires a number between 0 and 64" );
+}
+
+static void
+capture_cpus ( char *arg )
+{
+  co.capture_cpus = arg;
+}
+
+static void
+control ( char *arg )
+{
+  co.control = arg;
+}
+
+static void
+ring_blocks ( char *arg )
+{
+  co.ring_blocks = number_arg (
+          arg,
+          2,
+          MAX_RING_BLOCKS,
+          "Argument '--ring-blocks' requires a number between 2 and 4096" );
+}
+
+static void
+ring_block_size ( char *arg )
+{
+  co.ring_block_size =
+          number_arg ( arg,
+                       4,
+                       MAX_RING_BLOCK_SIZE,
+                       "Argument '--ring-block-size' requires a size in KiB "
+                       "between 4 and 65536" ) *
+          1024;
+}
+
+static void
+ring_timeout ( char *arg )
+{
+  co.ring_timeout = number_arg ( arg,
+                                 0,
+                                 MAX_RING_TIMEOUT,
+                                 "Argument '--ring-timeout' requires a time "
+                                 "in milliseconds between 0 and 10000" );
+}
+
+static void
+ring_auto ( UNUSED char *arg )
+{
+  co.ring_auto = true;
+}
+
+static void
+ring_lock ( UNUSED char *arg )
+{
+  co.ring_lock = true;
+}
+
+static void
+hugepages ( UNUSED char *arg )
+{
+  co.hugepages = true;
+}
+
+static void
+loopback ( UNUSED char *arg )
+{
+  co.loopback = true;
+}
+
+static void
+busy_poll ( char *arg )
+{
+  co.busy_poll = number_arg ( arg,
+                              0,
+                              MAX_BUSY_POLL,
+                              "Argument '--busy-poll' requires a time "
+                              "in microseconds between 0 and 1000000" );
+}
+
+static void
+max_subflows ( char *arg )
+{
+  co.max_subflows = number_arg ( arg,
+                                 MIN_SUBFLOWS,
+                                 MAX_SUBFLOWS,
+                                 "Argument '--max-subflows' requires a "
+                                 "number between 1024 and 16777216" );
+}
+
+static void
+max_fragments ( char *arg )
+{
+  co.max_fragments = number_arg ( arg,
+                                  1,
+                                  MAX_FRAGMENTS,
+                                  "Argument '--max-fragments' requires a "
+                                  "number between 1 and 65536" );
+}
+
+static void
+max_memory ( char *arg )
+{
+  co.max_memory = ( size_t ) number_arg ( arg,
+                                          1,
+                                          MAX_MEMORY,
+                                          "Argument '--max-memory' requires a "
+                                          "size in MiB between 1 and 1048576" )
+                  << 20;
+}
+
+static void
+log_summary ( char *arg )
+{
+  co.log_summary = number_arg ( arg,
+                                0,
+                                MAX_LOG_SUMMARY,
+                                "Argument '--log-summary' requires a number "
+                                "of seconds between 0 and 86400" );
+}
+
+static void
+replay_speed ( char *arg )
+{
+  co.replay_speed = number_arg (
+          arg,
+          1,
+          MAX_REPLAY_SPEED,
+          "Argument '--replay-speed' requires a number between 1 and 1000" );
+}
+
+static void
+sample ( char *arg )
+{
+  co.sample = number_arg (
+          arg,
+          1,
+          MAX_SAMPLE,
+          "Argument '--sample' requires a number between 1 and 65536" );
+}
+
+static void
+sample_auto ( UNUSED char *arg )
+{
+  co.sample_auto = true;
+}
+
+static void
+overload_auto ( UNUSED char *arg )
+{
+  co.overload_auto = true;
+}
+
+static void
+metrics_port ( char *arg )
+{
+  co.metrics_port = number_arg (
+          arg,
+          1,
+          65535,
+          "Argument '--metrics-port' requires a port between 1 and 65535" );
+}
+
+static void
+dns_cache ( char *arg )
+{
+  co.dns_cache = number_arg ( arg,
+                              MIN_DNS_CACHE,
+                              MAX_DNS_CACHE,
+                              "Argument '--dns-cache' requires a size in KiB "
+                              "between 64 and 1048576" );
+}
+
+static void
+dns_cache_file ( char *arg )
+{
+  co.dns_cache_file = arg;
+}
+
+static void
+refresh ( char *arg )
+{
+  co.refresh = number_arg ( arg,
+                            MIN_REFRESH,
+                            MAX_REFRESH,
+                            "Argument '--refresh' requires a interval in "
+                            "milliseconds between 50 and 10000" );
+}
+
+// list of seconds, as "1,10,60,300"
+static void
+set_rate_windows ( char *arg )
+{
+  static const char msg[] = "Argument '--rate-windows' requires up to 4 "
+                            "seconds between 1 and 3600, as '1,10,60'";
+
+  if ( !arg )
+    fatal_config ( msg );
+
+  co.total_rate_windows = 0;
+  for ( char *save, *tok = strtok_r ( arg, ",", &save ); tok;
+        tok = strtok_r ( NULL, ",", &save ) )
+    {
+      if ( co.total_rate_windows == MAX_RATE_WINDOWS )
+        fatal_config ( msg );
+
+      co.rate_windows[co.total_rate_windows++] =
+              number_arg ( tok, 1, MAX_RATE_WINDOW, msg );
+    }
+
+  if ( !co.total_rate_windows )
+    fatal_config ( msg );
+}
+
+static void
+ebpf ( UNUSED char *arg )
+{
+  co.ebpf = true;
+}
+
+static void
+ebpf_files ( UNUSED char *arg )
+{
+  co.ebpf_files = true;
+}
+
+static void
+ebpf_sockets ( UNUSED char *arg )
+{
+  co.ebpf_sockets = true;
+}
+
+static void
+set_agent ( char *arg )
+{
+  if ( !arg || !strchr ( arg, ':' ) )
+    fatal_config ( "Argument '--agent' requires a collector as 'host:port'" );
+
+  co.agent = arg;
+}
+
+// '[addr:]port', the address is resolved by collector
+static void
+collector ( char *arg )
+{
+  char *port = ( arg ) ? strrchr ( arg, ':' ) : NULL;
+
+  if ( port )
+    co.collector_addr = arg;
+
+  co.collector = number_arg ( ( port ) ? port + 1 : arg,
+                              1,
+                              65535,
+                              "Argument '--collector' requires a port between "
+                              "1 and 65535, as '[addr:]port'" );
+}
+
+static void
+flow_export ( char *arg )
+{
+  if ( !arg || !strchr ( arg, ':' ) )
+    fatal_config ( "Argument '--flow-export' requires a collector as "
+                   "'host:port'" );
+
+  co.flow_export = arg;
+}
+
+static void
+flow_file ( char *arg )
+{
+  co.flow_file = arg;
+}
+
+static void
+xdp ( UNUSED char *arg )
+{
+  co.xdp = true;
+}
+
+static void
+exclude_net ( char *arg )
+{
+  if ( !filter_exclude_add ( &co.excludes, EXCLUDE_NET, arg ) )
+    fatal_config ( "Argument '--exclude-net' requires a network ipv4 or ipv6 "
+                   "(e.g 10.0.0.0/8), at most 32" );
+}
+
+static void
+exclude_port ( char *arg )
+{
+  if ( !filter_exclude_add ( &co.excludes, EXCLUDE_PORT, arg ) )
+    fatal_config ( "Argument '--exclude-port' requires a port between 1 and "
+                   "65535, at most 32" );
+}
+
+static void
+exclude_iface ( char *arg )
+{
+  if ( !filter_exclude_add ( &co.excludes, EXCLUDE_IFACE, arg ) )
+    fatal_config ( "Argument '--exclude-iface' requires a name of interface "
+                   "existent, at most 32" );
+}
+
+static void
+exclude_file ( char *arg )
+{
+  if ( !arg )
+    fatal_config ( "Argument '--exclude-file' requires a file name" );
+
+  co.exclude_file = arg;
+}
+
+static void
+read_file ( char *arg )
+{
+  if ( !arg )
+    fatal_config ( "Argument '--read' requires a file pcap or pcapng" );
+
+  co.read_file = arg;
+}
+
+static void
+read_fast ( UNUSED char *arg )
+{
+  co.read_fast = true;
+}
+
+static void
+set_record ( char *arg )
+{
+  co.record = arg;
+}
+
+static void
+set_replay ( char *arg )
+{
+  co.replay = arg;
+}
+
+static void
+set_stream ( char *arg )
+{
+  if ( arg && !strcmp ( arg, "ndjson" ) )
+    co.stream = STREAM_NDJSON;
+  else if ( arg && !strcmp ( arg, "csv" ) )
+    co.stream = STREAM_CSV;
+  else
+    fatal_config ( "Argument '--stream' requires 'ndjson' or 'csv'" );
+}
+
+static void
+stream_socket ( char *arg )
+{
+  if ( !arg )
+    fatal_config ( "Argument '--stream-socket' requires a path of socket" );
+
+  co.stream_socket = arg;
+}
+
+static void
+networks ( char *arg )
+{
+  if ( !arg )
+    fatal_config ( "Argument '--networks' requires a file of prefixes" );
+
+  co.networks = arg;
+}
+
+static void
+top_remotes ( char *arg )
+{
+  if ( arg && !strcmp ( arg, "host" ) )
+    co.top_remotes = TOP_REMOTES_HOST;
+  else if ( arg && !strcmp ( arg, "port" ) )
+    co.top_remotes = TOP_REMOTES_PORT;
+  else
+    fatal_config ( "Argument '--top-remotes' requires 'host' or 'port'" );
+}
+
+// name of POSIX shared memory, as "/netproc"
+static void
+set_shm ( char *arg )
+{
+  if ( !arg || *arg != '/' || !arg[1] || strchr ( arg + 1, '/' ) )
+    fatal_config ( "Argument '--shm' requires a name as '/netproc'" );
+
+  co.shm = arg;
+}
+
+static void
+headless ( UNUSED char *arg )
+{
+  co.headless = true;
+}
+
+static void
+header_only ( UNUSED char *arg )
+{
+  co.snaplen = SNAPLEN_HEADER;
+}
+
+static void
+self_stats ( UNUSED char *arg )
+{
+  co.self_stats = true;
+}
+
 static void
 view_si ( UNUSED char *arg )
 {
@@ -172,22 +687,151 @@ check_cmd ( char *arg, const struct cmd *cmd )
   return !strcmp ( arg, cmd->cur_opt ) || !strcmp ( arg, cmd->long_opt );
 }
 
+void
+config_default ( struct config_op *op )
+{
+  *op = co;
+}
+
 struct config_op *
 parse_options ( int argc, char **argv )
 {
-  static const struct cmd cmd[] = { { "-B", "--bytes", view_bytes, NO_ARG },
+  static const struct cmd cmd[] = { { "", "--agent", set_agent, REQ_ARG },
+                                    { "-B", "--bytes", view_bytes, NO_ARG },
+                                    { "", "--busy-poll", busy_poll, REQ_ARG },
                                     { "-c", "", view_conections, NO_ARG },
                                     { "", "--color", color_scheme, REQ_ARG },
+                                    { "",
+                                      "--capture-cpus",
+                                      capture_cpus,
+                                      REQ_ARG },
+                                    { "",
+                                      "--capture-threads",
+                                      capture_threads,
+                                      REQ_ARG },
+                                    { "", "--collector", collector, REQ_ARG },
+                                    { "", "--control", control, REQ_ARG },
+                                    { "", "--dns-cache", dns_cache, REQ_ARG },
+                                    { "",
+                                      "--dns-cache-file",
+                                      dns_cache_file,
+                                      REQ_ARG },
+                                    { "", "--ebpf", ebpf, NO_ARG },
+                                    { "",
+                                      "--ebpf-files",
+                                      ebpf_files,
+                                      NO_ARG },
+                                    { "",
+                                      "--ebpf-sockets",
+                                      ebpf_sockets,
+                                      NO_ARG },
+                                    { "",
+                                      "--exclude-file",
+                                      exclude_file,
+                                      REQ_ARG },
+                                    { "",
+                                      "--exclude-iface",
+                                      exclude_iface,
+                                      REQ_ARG },
+                                    { "",
+                                      "--exclude-net",
+                                      exclude_net,
+                                      REQ_ARG },
+                                    { "",
+                                      "--exclude-port",
+                                      exclude_port,
+                                      REQ_ARG },
                                     { "-f", "--file", log_file, OPT_ARG },
+                                    { "",
+                                      "--flow-export",
+                                      flow_export,
+                                      REQ_ARG },
+                                    { "", "--flow-file", flow_file, REQ_ARG },
                                     { "-h", "--help", show_help, NO_ARG },
+                                    { "",
+                                      "--header-only",
+                                      header_only,
+                                      NO_ARG },
+                                    { "", "--headless", headless, NO_ARG },
+                                    { "", "--hugepages", hugepages, NO_ARG },
                                     { "-i", "--interface", iface, REQ_ARG },
+                                    { "",
+                                      "--log-summary",
+                                      log_summary,
+                                      REQ_ARG },
+                                    { "", "--loopback", loopback, NO_ARG },
+                                    { "",
+                                      "--max-fragments",
+                                      max_fragments,
+                                      REQ_ARG },
+                                    { "", "--max-memory", max_memory, REQ_ARG },
+                                    { "",
+                                      "--max-subflows",
+                                      max_subflows,
+                                      REQ_ARG },
+                                    { "",
+                                      "--metrics-port",
+                                      metrics_port,
+                                      REQ_ARG },
+                                    { "", "--networks", networks, REQ_ARG },
                                     { "-n", "", show_numeric, NO_ARG },
                                     { "-nh", "", show_numeric_host, NO_ARG },
                                     { "-np", "", show_numeric_port, NO_ARG },
+                                    { "",
+                                      "--overload-auto",
+                                      overload_auto,
+                                      NO_ARG },
                                     { "-p", "--protocol", set_proto, REQ_ARG },
+                                    { "",
+                                      "--rate-windows",
+                                      set_rate_windows,
+                                      REQ_ARG },
+                                    { "", "--read", read_file, REQ_ARG },
+                                    { "", "--read-fast", read_fast, NO_ARG },
+                                    { "", "--record", set_record, REQ_ARG },
+                                    { "", "--refresh", refresh, REQ_ARG },
+                                    { "", "--replay", set_replay, REQ_ARG },
+                                    { "",
+                                      "--replay-speed",
+                                      replay_speed,
+                                      REQ_ARG },
+                                    { "", "--ring-auto", ring_auto, NO_ARG },
+                                    { "",
+                                      "--ring-blocks",
+                                      ring_blocks,
+                                      REQ_ARG },
+                                    { "",
+                                      "--ring-block-size",
+                                      ring_block_size,
+                                      REQ_ARG },
+                                    { "", "--ring-lock", ring_lock, NO_ARG },
+                                    { "",
+                                      "--ring-timeout",
+                                      ring_timeout,
+                                      REQ_ARG },
+                                    { "", "--sample", sample, REQ_ARG },
+                                    { "",
+                                      "--sample-auto",
+                                      sample_auto,
+                                      NO_ARG },
+                                    { "",
+                                      "--self-stats",
+                                      self_stats,
+                                      NO_ARG },
+                                    { "", "--shm", set_shm, REQ_ARG },
                                     { "", "--si", view_si, NO_ARG },
+                                    { "", "--stream", set_stream, REQ_ARG },
+                                    { "",
+                                      "--stream-socket",
+                                      stream_socket,
+                                      REQ_ARG },
+                                    { "",
+                                      "--top-remotes",
+                                      top_remotes,
+                                      REQ_ARG },
                                     { "-v", "--verbose", verbose, NO_ARG },
-                                    { "-V", "--version", version, NO_ARG } };
+                                    { "-V", "--version", version, NO_ARG },
+                                    { "", "--xdp", xdp, NO_ARG } };
 
   while ( --argc )
     {
@@ -235,5 +879,92 @@ parse_options ( int argc, char **argv )
         }
     }
 
+  // samples of windows depend of interval of refresh
+  for ( unsigned int i = 0; i < co.total_rate_windows; i++ )
+    {
+      if ( ( uint64_t ) co.rate_windows[i] * 1000 / co.refresh >
+           MAX_RATE_SAMPLES )
+        fatal_config ( "Windows of '--rate-windows' can have up to 3600 "
+                       "intervals of '--refresh'" );
+    }
+
+  // without '-i', a socket bound to all interfaces
+  if ( !co.total_ifaces )
+    co.total_ifaces = 1;
+
+  // duplicates are dropped by filter of sockets of ring
+  if ( co.loopback && ( co.ebpf || co.read_file ) )
+    fatal_config ( "Option '--loopback' can not be used with '--ebpf' or "
+                   "'--read'" );
+
+  if ( co.read_fast && !co.read_file )
+    fatal_config ( "Option '--read-fast' requires '--read'" );
+
+  // sample is done by filter of sockets of ring
+  if ( ( co.sample > 1 || co.sample_auto ) && ( co.ebpf || co.read_file ) )
+    fatal_config ( "Options '--sample' and '--sample-auto' can not be used "
+                   "with '--ebpf' or '--read'" );
+
+  if ( co.ring_lock && ( co.ebpf || co.read_file || co.replay ) )
+    fatal_config ( "Option '--ring-lock' can not be used with '--ebpf', "
+                   "'--read' or '--replay'" );
+
+  // without ring there is nothing to pin
+  if ( co.capture_cpus && ( co.ebpf || co.read_file || co.replay ) )
+    fatal_config ( "Option '--capture-cpus' can not be used with '--ebpf', "
+                   "'--read' or '--replay'" );
+
+  if ( co.read_file && ( co.ebpf || co.replay ) )
+    fatal_config ( "Option '--read' can not be used with '--ebpf' or "
+                   "'--replay'" );
+
+  // program of XDP is attached to each interface, only in ingress
+  if ( co.xdp && ( co.ebpf || co.read_file || co.replay || co.sample > 1 ||
+                   co.sample_auto || co.loopback ) )
+    fatal_config ( "Option '--xdp' can not be used with '--ebpf', '--read', "
+                   "'--replay', '--sample', '--sample-auto' or '--loopback'" );
+
+  if ( co.xdp && !co.ifaces[0] )
+    fatal_config ( "Option '--xdp' requires interfaces of '-i'" );
+
+  if ( co.stream_socket && !co.stream )
+    fatal_config ( "Option '--stream-socket' requires '--stream'" );
+
+  // records in stdout, so without terminal
+  if ( co.stream && !co.stream_socket )
+    co.headless = true;
+
+  if ( co.replay && ( co.record || co.headless || co.stream || co.shm ) )
+    fatal_config ( "Option '--replay' can not be used with '--record', "
+                   "'--headless', '--stream' or '--shm'" );
+
+  // configuration of capture, without capture in replay
+  if ( co.replay && co.control )
+    fatal_config ( "Option '--control' can not be used with '--replay'" );
+
+  // collector is a view of agents, without capture
+  if ( co.collector && ( co.replay || co.agent || co.record || co.headless ||
+                         co.stream || co.shm || co.read_file || co.control ) )
+    fatal_config ( "Option '--collector' can not be used with '--replay', "
+                   "'--agent', '--record', '--headless', '--stream', "
+                   "'--shm', '--read' or '--control'" );
+
+  if ( co.agent && co.replay )
+    fatal_config ( "Option '--agent' can not be used with '--replay'" );
+
+  // connections are not in record and are not sent by agents
+  if ( ( co.flow_export || co.flow_file ) && ( co.replay || co.collector ) )
+    fatal_config ( "Options '--flow-export' and '--flow-file' can not be "
+                   "used with '--replay' or '--collector'" );
+
+  // remotes and connections are not in record
+  if ( co.replay && ( co.top_remotes || co.networks ) )
+    fatal_config ( "Option '--top-remotes' or '--networks' can not be used "
+                   "with '--replay'" );
+
+  // without terminal, statistics are only in file or in stream
+  if ( co.headless && !co.stream )
+    co.log = true;
+
   return &co;
 }
@@ -25,6 +25,9 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+#include "sock.h"    // struct sock_stats
+#include "filter.h"  // struct filter_excludes
+
 #define PROG_NAME "netproc"
 #define PROG_NAME_LOG PROG_NAME ".log"
 
@@ -34,13 +37,124 @@
 #define TCP ( 1 << 0 )
 #define UDP ( 1 << 1 )
 
+// values struct config_op.stream, 0 is off
+#define STREAM_NDJSON 1
+#define STREAM_CSV 2
+
+// values struct config_op.top_remotes, 0 is off
+#define TOP_REMOTES_HOST 1
+#define TOP_REMOTES_PORT 2
+
+// max value to config_op.capture_threads
+#define MAX_CAPTURE_THREADS 64
+
+// limits to geometry of ring buffer
+#define MAX_RING_BLOCKS 4096
+#define MAX_RING_BLOCK_SIZE ( 64 * 1024 )  // KiB
+#define MAX_RING_TIMEOUT 10000             // milliseconds
+
+// max value to config_op.busy_poll, microseconds
+#define MAX_BUSY_POLL 1000000
+
+// max value to config_op.max_fragments
+#define MAX_FRAGMENTS 65536
+
+// limit of sub-flows of '-c', config_op.max_subflows
+#define MIN_SUBFLOWS 1024
+#define MAX_SUBFLOWS ( 16 * 1024 * 1024 )
+
+// interval of refresh, config_op.refresh, in milliseconds
+#define REFRESH_DEFAULT 1000
+#define MIN_REFRESH 50
+#define MAX_REFRESH 10000
+
+// seconds between summaries in log, config_op.log_summary
+#define LOG_SUMMARY_DEFAULT 60
+#define MAX_LOG_SUMMARY 86400
+
+// max value to config_op.sample, 1 in N packets captured
+#define MAX_SAMPLE 65536
+
+// size of cache of names of hosts, config_op.dns_cache, in KiB
+#define DNS_CACHE_DEFAULT 2048
+#define MIN_DNS_CACHE 64
+#define MAX_DNS_CACHE ( 1024 * 1024 )
+
+// budget of memory, config_op.max_memory, in MiB
+#define MAX_MEMORY ( 1024 * 1024 )
+
+// max value to config_op.replay_speed
+#define MAX_REPLAY_SPEED 1000
+
+// max of samples of a window, the window in intervals of refresh
+#define MAX_RATE_SAMPLES 3600
+
+// windows of rates, config_op.rate_windows, in seconds
+#define MAX_RATE_WINDOWS 4
+#define MAX_RATE_WINDOW 3600
+
+// max of interfaces of '-i', each one with socket and ring of your own
+#define MAX_IFACES 16
+
+// bytes copied of each packet in header-only mode, enough to
+// ethernet with tags of QinQ + ipv4 with options + ports of layer 4
+#define SNAPLEN_HEADER 128
+
 struct config_op
 {
-  char *iface;       // bind interface
+  char *ifaces[MAX_IFACES];  // interfaces of capture, NULL is all
+  unsigned int iface_blocks[MAX_IFACES];  // blocks of ring of each interface
+  unsigned int total_ifaces;              // at least 1, after parse
   char *path_log;    // path to log in file
+  char *exclude_file;  // file with exclusions, re-read on SIGHUP
+  struct filter_excludes excludes;  // exclusions of command line
   uint64_t running;  // time the program is running
+  struct sock_stats stats_last;   // counters of kernel in last refresh
+  struct sock_stats stats_total;  // counters of kernel since start
   int proto;         // tcp or udp
   int color_scheme;
+  unsigned int capture_threads;  // total threads reading packets, 0 is main
+  char *capture_cpus;            // CPUs of capture, list or "auto", or NULL
+  unsigned int ring_blocks;      // amount of blocks in ring, 0 is default
+  unsigned int ring_block_size;  // size of block in bytes, 0 is default
+  unsigned int ring_timeout;     // timeout of block (ms), 0 is the kernel
+                                 // that calculates
+  bool ring_auto;                // size ring based in speed of link
+  bool ring_lock;                // pre-fault and lock ring in memory
+  unsigned int busy_poll;        // time of busy poll in socket (us), 0 is off
+  unsigned int snaplen;          // bytes copied of each packet, 0 is all
+  unsigned int max_fragments;    // IP packets fragmented simultaneously
+  size_t max_memory;             // budget of memory in bytes, 0 is none
+  size_t max_subflows;           // sub-flows of '-c', 0 is without limit
+  unsigned int refresh;          // interval of refresh (ms)
+  unsigned int log_summary;      // seconds between summaries, 0 only on exit
+  unsigned int metrics_port;     // port of endpoint of metrics, 0 is off
+  char *record;                  // file to record traffic, see record.h
+  char *agent;                   // collector of traffic, see agent.h
+  unsigned int collector;        // port of agents, see collector.h
+  char *collector_addr;          // address and port of agents, NULL is loopback
+  char *flow_export;             // collector of flows, see flow_export.h
+  char *flow_file;               // file of records of flows
+  char *replay;                  // file of record to show
+  unsigned int replay_speed;     // ticks of record by interval of refresh
+  int stream;                    // format of records, see stream.h
+  char *stream_socket;           // unix socket of records, NULL is stdout
+  int top_remotes;               // key of remotes by process, see topk.h
+  char *networks;                // file of prefixes of view by network
+  char *shm;                     // segment of snapshots, see snapshot.h
+  char *control;                 // unix socket of commands, see control.h
+  char *read_file;               // file pcap to read in place of capture
+  unsigned int sample;           // 1 in 'sample' packets captured, 1 is all
+  unsigned int dns_cache;        // KiB of memory of cache of names of hosts
+  char *dns_cache_file;          // file to persist cache of names, or NULL
+  unsigned int rate_windows[MAX_RATE_WINDOWS];  // seconds of each window
+  unsigned int total_rate_windows;
+  bool hugepages;                // tables and pools in huge pages
+  bool loopback;                 // count traffic of loopback, once by packet
+  bool ebpf;                     // count traffic in kernel with eBPF
+  bool ebpf_sockets;             // get owners of new sockets with eBPF
+  bool ebpf_files;               // get sockets of all processes with eBPF
+  bool xdp;                      // read ingress with XDP, see ebpf_xdp.h
   bool log;                // log in file
   bool view_si;            // SI or IEC prefix
   bool view_bytes;         // view in bytes or bits
@@ -48,9 +162,19 @@ struct config_op
   bool translate_host;     // translate ip to name using DNS
   bool translate_service;  // translate port to service
   bool verbose;            // show process without traffic alse
+  bool self_stats;         // profile the cost of netproc itself
+  bool headless;           // without terminal user interface, only log
+  bool read_fast;          // read packets of file without wait time of them
+  bool sample_auto;        // rate of sample changed by drops of ring
+  bool overload_auto;      // optional work shed by load, see overload.h
 };
 
 struct config_op *
 parse_options ( int argc, char **argv );
 
+/* copy of default options in 'co', to users without command line (as
+   libnetproc, see netproc.h), so parse_options must not be called before */
+void
+config_default ( struct config_op *co );
+
 #endif  // CONFIG_H
@@ -0,0 +1,488 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// references
+// https://programming.guide/robin-hood-hashing.html
+
+#include <stdlib.h>     // calloc
+#include <string.h>     // memcmp
+#include <sys/types.h>  // ssize_t
+
+#include "conn_index.h"
+#include "connection.h"
+#include "hash.h"
+#include "hugemem.h"
+
+// initial size of indexes, power-of-two
+#define INDEX_INIT_SIZE 1024
+
+// grow with load factor above of 3/4
+#define NEED_GROW( used, mask ) ( ( ( used ) + 1 ) * 4 > ( ( mask ) + 1 ) * 3 )
+
+// distance of slot 'idx' to ideal slot of 'hash'
+#define DIST( idx, hash, mask ) ( ( ( idx ) - ( hash ) ) & ( mask ) )
+
+/* slots of old array visited on each insert while the index is growing.
+   the old array is empty before of the new array reach the load of grow */
+#define MIGRATE_STEP 4
+
+static inline bool
+tuple_equal ( const struct tuple *t1, const struct tuple *t2 )
+{
+  // size known in compilation, memcmp is inlined
+  return 0 == memcmp ( t1, t2, sizeof ( struct tuple ) );
+}
+
+static void
+tuple_slots_insert ( struct tuple_slot *slots,
+                     size_t mask,
+                     struct tuple_slot slot )
+{
+  size_t idx = slot.hash & mask;
+  size_t dist = 0;
+
+  while ( slots[idx].conn )
+    {
+      // steal of the rich, slot nearest of your ideal slot
+      size_t cur = DIST ( idx, slots[idx].hash, mask );
+      if ( cur < dist )
+        {
+          struct tuple_slot tmp = slots[idx];
+          slots[idx] = slot;
+          slot = tmp;
+          dist = cur;
+        }
+
+      idx = ( idx + 1 ) & mask;
+      dist++;
+    }
+
+  slots[idx] = slot;
+}
+
+/* find slot of 'conn', or of 'tuple' if 'conn' is NULL.
+   return index of slot or -1 */
+static ssize_t
+tuple_slots_find ( const struct tuple_slot *slots,
+                   size_t mask,
+                   const struct tuple *tuple,
+                   const connection_t *conn,
+                   hash_t hash )
+{
+  size_t idx = hash & mask;
+
+  // key not exist when the distance of slot is less than of key
+  for ( size_t dist = 0;; dist++ )
+    {
+      const struct tuple_slot *slot = &slots[idx];
+
+      if ( !slot->conn || DIST ( idx, slot->hash, mask ) < dist )
+        return -1;
+
+      if ( conn ? slot->conn == conn
+                : slot->hash == hash && tuple_equal ( &slot->tuple, tuple ) )
+        return idx;
+
+      idx = ( idx + 1 ) & mask;
+    }
+}
+
+static void
+tuple_slots_del_at ( struct tuple_slot *slots, size_t mask, size_t idx )
+{
+  // shift back the next slots until a free slot or a slot in your ideal slot
+  while ( 1 )
+    {
+      size_t next = ( idx + 1 ) & mask;
+      struct tuple_slot *slot = &slots[next];
+
+      if ( !slot->conn || !DIST ( next, slot->hash, mask ) )
+        break;
+
+      slots[idx] = *slot;
+      idx = next;
+    }
+
+  slots[idx].conn = NULL;
+}
+
+/* move up to 'steps' slots of old array to new array. the slots before of
+   'migrate' are free, the deletion only move slots to back, so a slot of old
+   array never is before of 'migrate' */
+static void
+tuple_index_migrate ( struct tuple_index *ti, size_t steps )
+{
+  while ( ti->old_slots && steps-- )
+    {
+      struct tuple_slot *slot = &ti->old_slots[ti->migrate];
+
+      if ( slot->conn )
+        {
+          tuple_slots_insert ( ti->slots, ti->mask, *slot );
+          tuple_slots_del_at ( ti->old_slots, ti->old_mask, ti->migrate );
+          ti->old_used--;
+        }
+      else
+        ti->migrate++;
+
+      if ( !ti->old_used )
+        {
+          hugemem_free ( ti->old_slots,
+                         ti->old_mask + 1,
+                         sizeof ( *ti->old_slots ) );
+          ti->old_slots = NULL;
+        }
+    }
+}
+
+/* the new array has double of size, the slots of current array are moved
+   later by tuple_index_migrate, so a insert not copy the whole index */
+static bool
+tuple_index_grow ( struct tuple_index *ti )
+{
+  // only one grow at a time
+  tuple_index_migrate ( ti, SIZE_MAX );
+
+  size_t size = ( ti->mask + 1 ) << 1;
+  struct tuple_slot *slots = hugemem_calloc ( size, sizeof ( *slots ) );
+  if ( !slots )
+    return false;
+
+  ti->old_slots = ti->slots;
+  ti->old_mask = ti->mask;
+  ti->old_used = ti->used;
+  ti->migrate = 0;
+
+  ti->slots = slots;
+  ti->mask = size - 1;
+
+  return true;
+}
+
+bool
+tuple_index_init ( struct tuple_index *ti )
+{
+  *ti = ( struct tuple_index ){ 0 };
+
+  ti->slots = hugemem_calloc ( INDEX_INIT_SIZE, sizeof ( *ti->slots ) );
+  if ( !ti->slots )
+    return false;
+
+  ti->mask = INDEX_INIT_SIZE - 1;
+
+  return true;
+}
+
+bool
+tuple_index_set ( struct tuple_index *ti, connection_t *conn, hash_t hash )
+{
+  tuple_index_migrate ( ti, MIGRATE_STEP );
+
+  if ( NEED_GROW ( ti->used, ti->mask ) && !tuple_index_grow ( ti ) )
+    return false;
+
+  tuple_slots_insert ( ti->slots,
+                       ti->mask,
+                       ( struct tuple_slot ){ .tuple = conn->tuple,
+                                              .hash = hash,
+                                              .conn = conn } );
+  ti->used++;
+
+  return true;
+}
+
+connection_t *
+tuple_index_get ( const struct tuple_index *ti,
+                  const struct tuple *tuple,
+                  hash_t hash )
+{
+  ssize_t idx = tuple_slots_find ( ti->slots, ti->mask, tuple, NULL, hash );
+  if ( idx != -1 )
+    return ti->slots[idx].conn;
+
+  if ( ti->old_slots )
+    {
+      idx = tuple_slots_find (
+              ti->old_slots, ti->old_mask, tuple, NULL, hash );
+      if ( idx != -1 )
+        return ti->old_slots[idx].conn;
+    }
+
+  return NULL;
+}
+
+void
+tuple_index_del_at ( struct tuple_index *ti, size_t idx )
+{
+  if ( idx <= ti->mask )
+    tuple_slots_del_at ( ti->slots, ti->mask, idx );
+  else
+    {
+      tuple_slots_del_at ( ti->old_slots, ti->old_mask, idx - ti->mask - 1 );
+      ti->old_used--;
+    }
+
+  ti->used--;
+}
+
+void
+tuple_index_del ( struct tuple_index *ti,
+                  const connection_t *conn,
+                  hash_t hash )
+{
+  ssize_t idx = tuple_slots_find ( ti->slots, ti->mask, NULL, conn, hash );
+  if ( idx != -1 )
+    {
+      tuple_index_del_at ( ti, idx );
+      return;
+    }
+
+  if ( ti->old_slots )
+    {
+      idx = tuple_slots_find ( ti->old_slots, ti->old_mask, NULL, conn, hash );
+      if ( idx != -1 )
+        tuple_index_del_at ( ti, ti->mask + 1 + idx );
+    }
+}
+
+void
+tuple_index_prefetch ( const struct tuple_index *ti, hash_t hash )
+{
+  __builtin_prefetch ( &ti->slots[hash & ti->mask] );
+}
+
+void
+tuple_index_prefetch_conn ( const struct tuple_index *ti, hash_t hash )
+{
+  const connection_t *conn = ti->slots[hash & ti->mask].conn;
+
+  if ( conn )
+    __builtin_prefetch ( conn );
+}
+
+void
+tuple_index_free ( struct tuple_index *ti )
+{
+  hugemem_free ( ti->slots, ti->mask + 1, sizeof ( *ti->slots ) );
+  hugemem_free (
+          ti->old_slots, ti->old_mask + 1, sizeof ( *ti->old_slots ) );
+  *ti = ( struct tuple_index ){ 0 };
+}
+
+// the inodes are sequential, both implementations of hash spread them
+static inline size_t
+hash_inode ( unsigned long inode )
+{
+  return hash_u64 ( inode );
+}
+
+static void
+inode_slots_insert ( struct inode_slot *slots,
+                     size_t mask,
+                     struct inode_slot slot )
+{
+  size_t idx = hash_inode ( slot.inode ) & mask;
+  size_t dist = 0;
+
+  while ( slots[idx].conn )
+    {
+      size_t cur = DIST ( idx, hash_inode ( slots[idx].inode ), mask );
+      if ( cur < dist )
+        {
+          struct inode_slot tmp = slots[idx];
+          slots[idx] = slot;
+          slot = tmp;
+          dist = cur;
+        }
+
+      idx = ( idx + 1 ) & mask;
+      dist++;
+    }
+
+  slots[idx] = slot;
+}
+
+/* find slot of 'inode', and of 'conn' if not NULL.
+   return index of slot or -1 */
+static ssize_t
+inode_slots_find ( const struct inode_slot *slots,
+                   size_t mask,
+                   unsigned long inode,
+                   const connection_t *conn )
+{
+  size_t idx = hash_inode ( inode ) & mask;
+
+  for ( size_t dist = 0;; dist++ )
+    {
+      const struct inode_slot *slot = &slots[idx];
+
+      if ( !slot->conn ||
+           DIST ( idx, hash_inode ( slot->inode ), mask ) < dist )
+        return -1;
+
+      if ( slot->inode == inode && ( !conn || slot->conn == conn ) )
+        return idx;
+
+      idx = ( idx + 1 ) & mask;
+    }
+}
+
+static void
+inode_slots_del_at ( struct inode_slot *slots, size_t mask, size_t idx )
+{
+  while ( 1 )
+    {
+      size_t next = ( idx + 1 ) & mask;
+      struct inode_slot *slot = &slots[next];
+
+      if ( !slot->conn || !DIST ( next, hash_inode ( slot->inode ), mask ) )
+        break;
+
+      slots[idx] = *slot;
+      idx = next;
+    }
+
+  slots[idx].conn = NULL;
+}
+
+// same of tuple_index_migrate
+static void
+inode_index_migrate ( struct inode_index *ii, size_t steps )
+{
+  while ( ii->old_slots && steps-- )
+    {
+      struct inode_slot *slot = &ii->old_slots[ii->migrate];
+
+      if ( slot->conn )
+        {
+          inode_slots_insert ( ii->slots, ii->mask, *slot );
+          inode_slots_del_at ( ii->old_slots, ii->old_mask, ii->migrate );
+          ii->old_used--;
+        }
+      else
+        ii->migrate++;
+
+      if ( !ii->old_used )
+        {
+          free ( ii->old_slots );
+          ii->old_slots = NULL;
+        }
+    }
+}
+
+static bool
+inode_index_grow ( struct inode_index *ii )
+{
+  inode_index_migrate ( ii, SIZE_MAX );
+
+  size_t size = ( ii->mask + 1 ) << 1;
+  struct inode_slot *slots = calloc ( size, sizeof ( *slots ) );
+  if ( !slots )
+    return false;
+
+  ii->old_slots = ii->slots;
+  ii->old_mask = ii->mask;
+  ii->old_used = ii->used;
+  ii->migrate = 0;
+
+  ii->slots = slots;
+  ii->mask = size - 1;
+
+  return true;
+}
+
+bool
+inode_index_init ( struct inode_index *ii )
+{
+  *ii = ( struct inode_index ){ 0 };
+
+  ii->slots = calloc ( INDEX_INIT_SIZE, sizeof ( *ii->slots ) );
+  if ( !ii->slots )
+    return false;
+
+  ii->mask = INDEX_INIT_SIZE - 1;
+
+  return true;
+}
+
+bool
+inode_index_set ( struct inode_index *ii, connection_t *conn )
+{
+  inode_index_migrate ( ii, MIGRATE_STEP );
+
+  if ( NEED_GROW ( ii->used, ii->mask ) && !inode_index_grow ( ii ) )
+    return false;
+
+  inode_slots_insert ( ii->slots,
+                       ii->mask,
+                       ( struct inode_slot ){ .inode = conn->inode,
+                                              .conn = conn } );
+  ii->used++;
+
+  return true;
+}
+
+connection_t *
+inode_index_get ( const struct inode_index *ii, unsigned long inode )
+{
+  ssize_t idx = inode_slots_find ( ii->slots, ii->mask, inode, NULL );
+  if ( idx != -1 )
+    return ii->slots[idx].conn;
+
+  if ( ii->old_slots )
+    {
+      idx = inode_slots_find ( ii->old_slots, ii->old_mask, inode, NULL );
+      if ( idx != -1 )
+        return ii->old_slots[idx].conn;
+    }
+
+  return NULL;
+}
+
+void
+inode_index_del ( struct inode_index *ii, const connection_t *conn )
+{
+  ssize_t idx = inode_slots_find ( ii->slots, ii->mask, conn->inode, conn );
+  if ( idx != -1 )
+    {
+      inode_slots_del_at ( ii->slots, ii->mask, idx );
+      ii->used--;
+      return;
+    }
+
+  if ( !ii->old_slots )
+    return;
+
+  idx = inode_slots_find ( ii->old_slots, ii->old_mask, conn->inode, conn );
+  if ( idx != -1 )
+    {
+      inode_slots_del_at ( ii->old_slots, ii->old_mask, idx );
+      ii->old_used--;
+      ii->used--;
+    }
+}
+
+void
+inode_index_free ( struct inode_index *ii )
+{
+  free ( ii->slots );
+  free ( ii->old_slots );
+  *ii = ( struct inode_index ){ 0 };
+}
@@ -0,0 +1,153 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONN_INDEX_H
+#define CONN_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sockaddr.h"   // struct tuple
+#include "hashtable.h"  // hash_t
+
+/* indexes of connections by tuple and by inode, open addressing with
+   Robin Hood hashing and deletion by backward shift (no tombstones).
+   the key is copied in slot, so a lookup read one or two cache lines and
+   compare the key without call by pointer. the same key can be more than
+   one time in index, the deletion is by value (connection) */
+
+typedef struct conection connection_t;
+
+/* the distance of slot to ideal slot is calculated of hash, so is not
+   stored. slot with 'conn' NULL is free */
+struct tuple_slot
+{
+  struct tuple tuple;  // copy of key
+  hash_t hash;
+  connection_t *conn;
+};
+
+struct inode_slot
+{
+  unsigned long inode;
+  connection_t *conn;
+};
+
+/* the grow is incremental, while 'old_slots' is not NULL the slots of old
+   array are moved to new array a few in each insert. the lookups search in
+   both arrays */
+struct tuple_index
+{
+  struct tuple_slot *slots;
+  size_t mask;  // size - 1, size is power-of-two
+  size_t used;  // entries in both arrays
+
+  struct tuple_slot *old_slots;
+  size_t old_mask;
+  size_t old_used;
+  size_t migrate;  // next slot of old array to move
+};
+
+struct inode_index
+{
+  struct inode_slot *slots;
+  size_t mask;
+  size_t used;
+
+  struct inode_slot *old_slots;
+  size_t old_mask;
+  size_t old_used;
+  size_t migrate;
+};
+
+bool
+tuple_index_init ( struct tuple_index *ti );
+
+// key is conn->tuple with 'hash' (connection_hash_tuple)
+bool
+tuple_index_set ( struct tuple_index *ti, connection_t *conn, hash_t hash );
+
+connection_t *
+tuple_index_get ( const struct tuple_index *ti,
+                  const struct tuple *tuple,
+                  hash_t hash );
+
+void
+tuple_index_del ( struct tuple_index *ti,
+                  const connection_t *conn,
+                  hash_t hash );
+
+// remove the slot 'idx', the next slots can be moved to it
+void
+tuple_index_del_at ( struct tuple_index *ti, size_t idx );
+
+// bring to cache the ideal slot of 'hash' and, after, the connection of it
+void
+tuple_index_prefetch ( const struct tuple_index *ti, hash_t hash );
+
+void
+tuple_index_prefetch_conn ( const struct tuple_index *ti, hash_t hash );
+
+/* slots of new array followed by slots of old array, while growing.
+   tuple_index_del_at not change the size, so a loop can remove slots */
+static inline size_t
+tuple_index_size ( const struct tuple_index *ti )
+{
+  return ( ti->slots ? ti->mask + 1 : 0 ) +
+         ( ti->old_slots ? ti->old_mask + 1 : 0 );
+}
+
+// connection of slot 'idx' or NULL if slot is free
+static inline connection_t *
+tuple_index_at ( const struct tuple_index *ti, size_t idx )
+{
+  return ( idx <= ti->mask ) ? ti->slots[idx].conn
+                             : ti->old_slots[idx - ti->mask - 1].conn;
+}
+
+void
+tuple_index_free ( struct tuple_index *ti );
+
+bool
+inode_index_init ( struct inode_index *ii );
+
+// key is conn->inode
+bool
+inode_index_set ( struct inode_index *ii, connection_t *conn );
+
+connection_t *
+inode_index_get ( const struct inode_index *ii, unsigned long inode );
+
+void
+inode_index_del ( struct inode_index *ii, const connection_t *conn );
+
+// slots of new and old arrays
+static inline size_t
+inode_index_size ( const struct inode_index *ii )
+{
+  return ( ii->slots ? ii->mask + 1 : 0 ) +
+         ( ii->old_slots ? ii->old_mask + 1 : 0 );
+}
+
+void
+inode_index_free ( struct inode_index *ii );
+
+#endif  // CONN_INDEX_H
@@ -20,284 +20,1090 @@
 
 // references
 // https://www.kernel.org/doc/Documentation/networking/proc_net_tcp.txt
+// man 7 sock_diag
 
 #include <errno.h>  // variable errno
 #include <stdbool.h>
-#include <stdio.h>        // FILE *
+#include <fcntl.h>        // open
+#include <stdio.h>        // snprintf
+#include <stdlib.h>       // free
 #include <string.h>       // strlen, strerror
+#include <unistd.h>       // close
+#include <arpa/inet.h>    // htonl
 #include <netinet/tcp.h>  // TCP_ESTABLISHED, TCP_TIME_WAIT...
 
 #include "connection.h"
-#include "hashtable.h"
-#include "jhash.h"
+#include "sock_diag.h"
+#include "netns.h"
+#include "conn_index.h"
+#include "pool.h"
+#include "hash.h"
+#include "full_read.h"
+#include "directory.h"  // proc_root
+#include "arena.h"
 #include "config.h"  // define TCP | UDP
 #include "m_error.h"
 #include "macro_util.h"
+#include "networks.h"
+#include "intern.h"
+#include "processes.h"  // process_t
+#include "flow_export.h"
+#include "vector.h"
 
-static hashtable_t *ht_connections = NULL;
+// all connections are in both indexes, the tuple index is the owner
+static struct tuple_index by_tuple;
+static struct inode_index by_inode;
 
-static hash_t
-hash ( const void *key, size_t size )
+/* sockets udp without remote (unconnected), the packets of them never
+   match the tuple exported by kernel, so are also indexed only by local
+   address and port (remote zeroed) */
+static struct tuple_index by_local;
+
+// all connections are allocated of it
+static struct pool conn_pool;
+
+/* connections of sockets closed whose inode or tuple was reused by a new
+   socket, already out of indexes, freed in next update (processes can
+   point to them until there) */
+static connection_t **retired;
+
+// socket netlink of sock_diag, -1 read only files of /proc
+static int diag_sock = -1;
+
+// mask of (family, protocol) that the kernel not support dump by sock_diag
+static unsigned int diag_unsupported = 0;
+
+// content of a file of /proc/net/ while it is parsed
+static struct arena file_arena = ARENA_INITIALIZER;
+
+// connection not seen in two updates is removed
+#define MARK_ACTIVE_CON( conn ) ( ( conn )->refs_active = 2 )
+
+// seconds without traffic until a sub-flow is removed
+#define SUBFLOW_IDLE 30
+
+// sub-flows without traffic in last second removed in next update
+static bool trim_subflows = false;
+
+// max of sub-flows, 0 is without limit, see connection_limit_subflows
+static size_t max_subflows = 0;
+static size_t total_subflows = 0;
+
+// connections removed are exported, see connection_export
+static bool export_flows = false;
+
+// slot of index by tuple where the clock of evictions stopped
+static size_t clock_hand = 0;
+
+// evictions leave space to new sub-flows until next update, 1/8 of limit
+#define EVICT_SLACK( max ) ( ( max ) / 8 )
+
+// total of digits hex of a word of address in /proc/net/{tcp,udp}{,6}
+#define DIGITS_WORD 8
+
+// digits hex of port and of state
+#define DIGITS_PORT 4
+#define DIGITS_STATE 2
+
+// value + 1 of each digit hex, 0 if not is a digit
+static const uint8_t hex_table[256] = {
+  ['0'] = 1,  ['1'] = 2,  ['2'] = 3,  ['3'] = 4,  ['4'] = 5,  ['5'] = 6,
+  ['6'] = 7,  ['7'] = 8,  ['8'] = 9,  ['9'] = 10, ['A'] = 11, ['B'] = 12,
+  ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16, ['a'] = 11, ['b'] = 12,
+  ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
+
+// 'digits' hex of 'p' (up to 8), false if any not is a digit
+static inline bool
+hex_decode ( const char *p, unsigned int digits, uint32_t *value )
 {
-  return jhash8 ( key, size, 0 );
+  uint32_t v = 0;
+
+  for ( unsigned int i = 0; i < digits; i++ )
+    {
+      unsigned int d = hex_table[( unsigned char ) p[i]];
+      if ( !d )
+        return false;
+
+      v = ( v << 4 ) | ( d - 1 );
+    }
+
+  *value = v;
+  return true;
 }
 
-static bool
-ht_cb_compare_inode ( const void *key1, const void *key2 )
+/* the kernel export each word (32 bits) of address in hex, without
+   conversion of byte order, 'words' are 1 (ipv4) or 4 (ipv6) */
+static inline bool
+parse_address ( const char *hex, unsigned int words, union inet_all *addr )
 {
-  if ( key1 == key2 )
-    return true;
+  for ( unsigned int i = 0; i < words; i++ )
+    {
+      if ( !hex_decode ( hex + i * DIGITS_WORD, DIGITS_WORD, &addr->all[i] ) )
+        return false;
+    }
 
-  return ( *( unsigned long * ) key1 == *( unsigned long * ) key2 );
+  return true;
 }
 
-static bool
-ht_cb_compare_tuple ( const void *key1, const void *key2 )
+static inline const char *
+skip_spaces ( const char *p, const char *end )
 {
-  if ( key1 == key2 )
-    return true;
+  while ( p < end && *p == ' ' )
+    p++;
+
+  return p;
+}
+
+static inline const char *
+skip_field ( const char *p, const char *end )
+{
+  while ( p < end && *p != ' ' )
+    p++;
+
+  return skip_spaces ( p, end );
+}
 
-  return ( 0 == memcmp ( key1, key2, sizeof ( struct tuple ) ) );
+static inline bool
+is_v4_mapped ( const union inet_all *addr )
+{
+  return !addr->ip6[0] && !addr->ip6[1] && addr->ip6[2] == htonl ( 0xffff );
+}
+
+static inline bool
+is_unspecified ( const union inet_all *addr )
+{
+  return !addr->ip6[0] && !addr->ip6[1] && !addr->ip6[2] && !addr->ip6[3];
+}
+
+static inline bool
+is_unconnected ( const struct tuple *tuple )
+{
+  return tuple->l4.protocol == IPPROTO_UDP && !tuple->l4.remote_port &&
+         is_unspecified ( &tuple->l3.remote );
 }
 
-#define MARK_ACTIVE_CON( conn ) ( ( conn )->refs_active = 3 )
+/* sockets ipv6 (dual stack) with traffic ipv4 are exported with address
+   ipv4-mapped (::ffff:a.b.c.d), the packets are ipv4, so tuple should be */
+static void
+unmap_v4 ( struct tuple *tuple )
+{
+  union inet_all *local = &tuple->l3.local;
+  union inet_all *remote = &tuple->l3.remote;
+
+  if ( tuple->family != AF_INET6 || !is_v4_mapped ( local ) ||
+       !( is_v4_mapped ( remote ) || is_unspecified ( remote ) ) )
+    return;
+
+  local->ip = local->ip6[3];
+  remote->ip = remote->ip6[3];
+  local->ip6[1] = local->ip6[2] = local->ip6[3] = 0;
+  remote->ip6[1] = remote->ip6[2] = remote->ip6[3] = 0;
+  tuple->family = AF_INET;
+}
 
+/* 'tuple' must be clean (zeroed) beyond of the address of family,
+   necessary to lookups by memcmp */
 static connection_t *
 create_new_conn ( unsigned long inode,
-                  char *local_addr,
-                  char *remote_addr,
-                  uint16_t local_port,
-                  uint16_t rem_port,
-                  uint8_t state,
-                  int protocol )
-{
-  /* using calloc to ensure that struct tuple is clean
-     necessary to struct net_stat */
-  connection_t *conn = calloc ( 1, sizeof *conn );
+                  uint64_t cookie,
+                  const struct tuple *tuple,
+                  uint8_t state )
+{
+  /* zeroed to ensure that struct net_stat is clean */
+  connection_t *conn = pool_calloc ( &conn_pool );
   if ( !conn )
     {
       ERROR_DEBUG ( "\"%s\"", strerror ( errno ) );
       return NULL;
     }
 
-  int rs = sscanf ( local_addr, "%x", &conn->tuple.l3.local.ip );
-
-  if ( 1 != rs )
-    goto EXIT_ERROR;
-
-  rs = sscanf ( remote_addr, "%x", &conn->tuple.l3.remote.ip );
-
-  if ( 1 != rs )
-    goto EXIT_ERROR;
-
-  conn->tuple.l4.local_port = local_port;
-  conn->tuple.l4.remote_port = rem_port;
-  conn->tuple.l4.protocol = protocol;
+  conn->tuple = *tuple;
+  unmap_v4 ( &conn->tuple );
   conn->state = state;
   conn->inode = inode;
+  conn->cookie = cookie;
+  conn->start = rate_now ();
+
+  // remote is classified once, traffic is only added to row
+  conn->network = networks_join ( &conn->tuple );
 
-  /* each conn has two entries on hashtable,
-   this is used to remove inactives conns and free only one time a conn */
   MARK_ACTIVE_CON ( conn );
 
   return conn;
+}
+
+static bool
+connection_insert ( connection_t *conn )
+{
+  hash_t hash = connection_hash_tuple ( &conn->tuple );
+
+  if ( !tuple_index_set ( &by_tuple, conn, hash ) )
+    return false;
+
+  if ( !inode_index_set ( &by_inode, conn ) )
+    goto ERROR_TUPLE;
 
-EXIT_ERROR:
-  ERROR_DEBUG ( "\"%s\"", strerror ( errno ) );
-  free ( conn );
-  return NULL;
+  if ( is_unconnected ( &conn->tuple ) &&
+       !tuple_index_set ( &by_local, conn, hash ) )
+    {
+      inode_index_del ( &by_inode, conn );
+      goto ERROR_TUPLE;
+    }
+
+  return true;
+
+ERROR_TUPLE:
+  tuple_index_del ( &by_tuple, conn, hash );
+  return false;
 }
 
 static void
-connection_insert ( connection_t *conn )
+release_conn ( connection_t *conn )
 {
-  // make one entries in hashtable to same connection
-  hashtable_min_set (
-          ht_connections,
-          conn,
-          &conn->inode,
-          hash ( &conn->inode, SIZEOF_MEMBER ( connection_t, inode ) ) );
+  processes_remove_connection ( conn );
 
-  hashtable_min_set (
-          ht_connections,
-          conn,
-          &conn->tuple,
-          hash ( &conn->tuple, SIZEOF_MEMBER ( connection_t, tuple ) ) );
+  if ( conn->subflow )
+    total_subflows--;
+
+  rate_net_stat_free ( &conn->net_stat );
+  intern_put ( conn->owner_name );
+  networks_leave ( conn->network );
+  free ( conn->display );
+  pool_free ( &conn_pool, conn );
 }
 
+/* socket 'conn' was closed and a new socket has its inode or its tuple,
+   so 'conn' is removed of indexes now, to not receive the traffic
+   of new socket */
+static bool
+retire_conn ( connection_t *conn )
+{
+  if ( !vector_push ( retired, &conn ) )
+    return false;
+
+  hash_t hash = connection_hash_tuple ( &conn->tuple );
+
+  if ( is_unconnected ( &conn->tuple ) )
+    tuple_index_del ( &by_local, conn, hash );
+
+  if ( export_flows )
+    flow_export_add ( conn );
+
+  inode_index_del ( &by_inode, conn );
+  tuple_index_del ( &by_tuple, conn, hash );
+  conn->refs_active = 0;
+
+  return true;
+}
+
+/* same socket while the kernel export the same cookie and tuple, the inode
+   of a socket closed is reused by kernel. without cookie (read of /proc),
+   only the tuple is compared */
+static bool
+same_socket ( const connection_t *conn,
+              uint64_t cookie,
+              const struct tuple *tuple )
+{
+  if ( cookie && conn->cookie && cookie != conn->cookie )
+    return false;
+
+  struct tuple key = *tuple;
+  unmap_v4 ( &key );
+
+  return 0 == memcmp ( &key, &conn->tuple, sizeof ( key ) );
+}
+
+/* a tuple of tcp is of a single socket, a connection with the tuple of new
+   socket 'conn' is of a socket closed and not yet removed */
+static bool
+retire_same_tuple ( const connection_t *conn )
+{
+  if ( conn->tuple.l4.protocol != IPPROTO_TCP )
+    return true;
+
+  connection_t *old = connection_get_by_tuple_hash (
+          &conn->tuple, connection_hash_tuple ( &conn->tuple ) );
+
+  return !old || old->subflow || retire_conn ( old );
+}
+
+/* the same conn is exported while the socket exist, only mark it active.
+   'cookie' is 0 if unknown. return 0 on error */
 static int
-connection_update_ ( const char *path_file, const int protocol )
+connection_seen ( unsigned long inode,
+                  uint64_t cookie,
+                  const struct tuple *tuple,
+                  uint8_t state )
 {
-  FILE *arq = fopen ( path_file, "r" );
-  if ( !arq )
+  connection_t *conn = connection_get_by_inode ( inode );
+
+  if ( conn )
     {
+      if ( same_socket ( conn, cookie, tuple ) )
+        {
+          MARK_ACTIVE_CON ( conn );
+          return 1;
+        }
+
+      if ( !retire_conn ( conn ) )
+        return 0;
+    }
+
+  if ( !( conn = create_new_conn ( inode, cookie, tuple, state ) ) )
+    return 0;
+
+  if ( !retire_same_tuple ( conn ) || !connection_insert ( conn ) )
+    {
+      networks_leave ( conn->network );
+      pool_free ( &conn_pool, conn );
+      return 0;
+    }
+
+  return 1;
+}
+
+/* 'optional' is to files of ipv6, that not exist if kernel is without
+   support to ipv6 */
+static int
+connection_update_ ( const char *path_file,
+                     const int protocol,
+                     const bool optional )
+{
+  int fd = open ( path_file, O_RDONLY | O_CLOEXEC );
+  if ( fd == -1 )
+    {
+      if ( optional && errno == ENOENT )
+        return 1;
+
       ERROR_DEBUG ( "\"%s\"", strerror ( errno ) );
       return 0;
     }
 
   int ret = 1;
-  char *line = NULL;
-  size_t len = 0;
+  char *buff;
+  ssize_t len = full_read_arena ( fd, &buff, &file_arena );
+  close ( fd );
 
-  // ignore header in first line
-  if ( ( getline ( &line, &len, arq ) ) == -1 )
+  if ( len == -1 )
     {
       ERROR_DEBUG ( "\"%s\"", strerror ( errno ) );
       ret = 0;
       goto EXIT;
     }
 
-  while ( ( getline ( &line, &len, arq ) ) != -1 )
+  const char *end = buff + len;
+
+  // ignore header in first line
+  const char *line = memchr ( buff, '\n', len );
+  if ( !line )
+    {
+      ERROR_DEBUG ( "\"%s\"", "File of connections without header" );
+      ret = 0;
+      goto EXIT;
+    }
+
+  /* clang-format off
+  sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode
+  0: 3500007F:0035 00000000:0000 0A 00000000:00000000 00:00000000 00000000   101        0 20911 1 0000000000000000 100 0 0 10 0
+  1: 0100007F:0277 00000000:0000 0A 00000000:00000000 00:00000000 00000000     0        0 44385 1 0000000000000000 100 0 0 10 0
+  2: 0100007F:1733 00000000:0000 0A 00000000:00000000 00:00000000 00000000     0        0 27996 1 0000000000000000 100 0 0 10 0
+  clang-format on */
+
+  /* after 'sl' the addresses, ports and state are of width fixed, the
+     state is read first and lines ignored are not decoded. words of
+     address are of family of file, 0 until first line */
+  unsigned int words = 0;
+  const char *next = end;
+
+  for ( ; ++line < end; line = next )
     {
-      /* clang-format off
-      sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode
-      0: 3500007F:0035 00000000:0000 0A 00000000:00000000 00:00000000 00000000   101        0 20911 1 0000000000000000 100 0 0 10 0
-      1: 0100007F:0277 00000000:0000 0A 00000000:00000000 00:00000000 00000000     0        0 44385 1 0000000000000000 100 0 0 10 0
-      2: 0100007F:1733 00000000:0000 0A 00000000:00000000 00:00000000 00000000     0        0 27996 1 0000000000000000 100 0 0 10 0
-      clang-format on */
-
-      char local_addr[10], rem_addr[10];  // enough for ipv4
-      unsigned long inode;
-      uint16_t local_port, rem_port;
-      uint8_t state;
-      int rs = sscanf ( line,
-                        "%*d: %9[0-9A-Fa-f]:%hX %9[0-9A-Fa-f]:%hX %hhX"
-                        " %*X:%*X %*X:%*X %*X %*d %*d %lu %*512s\n",
-                        local_addr,
-                        &local_port,
-                        rem_addr,
-                        &rem_port,
-                        &state,
-                        &inode );
-
-      if ( rs != 6 )
+      if ( !( next = memchr ( line, '\n', end - line ) ) )
+        next = end;  // last line without newline
+
+      const char *p = memchr ( line, ':', next - line );
+      if ( !p )
+        goto ERROR_LINE;
+
+      p = skip_spaces ( p + 1, next );
+
+      if ( !words )
         {
-          ERROR_DEBUG ( "Error read file conections\"%s\"",
-                        strerror ( errno ) );
-          ret = 0;
-          goto EXIT;
+          const char *colon = memchr ( p, ':', next - p );
+          words = ( colon ) ? ( colon - p ) / DIGITS_WORD : 0;
+
+          if ( words != 1 && words != 4 )
+            goto ERROR_LINE;
         }
 
+      // "address:port address:port st "
+      size_t width = words * DIGITS_WORD + 1 + DIGITS_PORT;
+      const char *hex_state = p + 2 * ( width + 1 );
+
+      uint32_t state;
+      if ( hex_state + DIGITS_STATE >= next ||
+           !hex_decode ( hex_state, DIGITS_STATE, &state ) )
+        goto ERROR_LINE;
+
       // ignore this conections
       if ( state == TCP_TIME_WAIT || state == TCP_LISTEN )
         continue;
 
-      // TODO: need check to tuple here? linux recycling inode?
-      connection_t *conn = connection_get_by_inode ( inode );
+      struct tuple tuple = { 0 };
+      uint32_t local_port, rem_port;
+      const char *remote = p + width + 1;
 
-      if ( conn )
-        {
-          MARK_ACTIVE_CON ( conn );
-          continue;
-        }
+      if ( !parse_address ( p, words, &tuple.l3.local ) ||
+           !hex_decode ( remote - 1 - DIGITS_PORT, DIGITS_PORT, &local_port ) ||
+           !parse_address ( remote, words, &tuple.l3.remote ) ||
+           !hex_decode ( hex_state - 1 - DIGITS_PORT, DIGITS_PORT, &rem_port ) )
+        goto ERROR_LINE;
 
-      conn = create_new_conn ( inode,
-                               local_addr,
-                               rem_addr,
-                               local_port,
-                               rem_port,
-                               state,
-                               protocol );
-      if ( !conn )
+      // tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode
+      p = skip_spaces ( hex_state + DIGITS_STATE, next );
+      for ( int i = 0; i < 5; i++ )
+        p = skip_field ( p, next );
+
+      unsigned long inode = 0;
+      if ( p == next || *p < '0' || *p > '9' )
+        goto ERROR_LINE;
+
+      for ( ; p < next && *p >= '0' && *p <= '9'; p++ )
+        inode = inode * 10 + ( *p - '0' );
+
+      tuple.family = ( words == 1 ) ? AF_INET : AF_INET6;
+      tuple.l4.local_port = local_port;
+      tuple.l4.remote_port = rem_port;
+      tuple.l4.protocol = protocol;
+
+      if ( !connection_seen ( inode, 0, &tuple, state ) )
         {
           ret = 0;
           goto EXIT;
         }
-
-      connection_insert ( conn );
     }
 
+  goto EXIT;
+
+ERROR_LINE:
+  ERROR_DEBUG ( "Error parse line of connections \"%.*s\"",
+                ( int ) ( next - line ),
+                line );
+  ret = 0;
+
 EXIT:
-  free ( line );
-  fclose ( arq );
+  arena_reset ( &file_arena );
 
   return ret;
 }
 
+// all states except the ignored, filtered by kernel
+#define DIAG_STATES                                                    \
+  ( ~( SOCK_DIAG_STATE ( TCP_TIME_WAIT ) | SOCK_DIAG_STATE ( TCP_LISTEN ) ) )
+
+static bool
+diag_conn ( const struct inet_diag_msg *msg, void *user_data )
+{
+  struct tuple tuple = { .family = msg->idiag_family,
+                         .l4.local_port = ntohs ( msg->id.idiag_sport ),
+                         .l4.remote_port = ntohs ( msg->id.idiag_dport ),
+                         .l4.protocol = *( int * ) user_data };
+
+  // same order of bytes of address in packet
+  if ( tuple.family == AF_INET6 )
+    {
+      memcpy ( tuple.l3.local.ip6, msg->id.idiag_src, 16 );
+      memcpy ( tuple.l3.remote.ip6, msg->id.idiag_dst, 16 );
+    }
+  else
+    {
+      tuple.l3.local.ip = msg->id.idiag_src[0];
+      tuple.l3.remote.ip = msg->id.idiag_dst[0];
+    }
+
+  uint64_t cookie = ( uint64_t ) msg->id.idiag_cookie[1] << 32 |
+                    msg->id.idiag_cookie[0];
+
+  return connection_seen (
+          msg->idiag_inode, cookie, &tuple, msg->idiag_state );
+}
+
+/* read sockets by sock_diag, fallback to file of /proc if kernel not
+   support sock_diag to this family/protocol */
+static unsigned int
+diag_id ( const int family, const int protocol )
+{
+  return 1U << ( ( family == AF_INET6 ) | ( protocol == IPPROTO_UDP ) << 1 );
+}
+
 static int
-remove_inactives_conns ( UNUSED hashtable_t *ht,
-                         void *value,
-                         UNUSED void *user_data )
+connection_update_diag ( const int family,
+                         const int protocol,
+                         const char *file )
 {
-  connection_t *conn = value;
+  unsigned int id = diag_id ( family, protocol );
 
-  switch ( conn->refs_active-- )
+  if ( diag_sock != -1 && !( diag_unsupported & id ) )
     {
-      case 1:
-        return 1;
+      int proto = protocol;
 
-      case 0:
-        free ( conn );
+      if ( sock_diag_dump ( diag_sock,
+                            family,
+                            protocol,
+                            DIAG_STATES,
+                            diag_conn,
+                            &proto ) )
         return 1;
 
-      default:
+      if ( errno != ENOENT && errno != EPROTONOSUPPORT )
         return 0;
+
+      diag_unsupported |= id;
+    }
+
+  // file relative to root of procfs, see proc_root_set
+  char path[PROC_ROOT_MAX + sizeof ( "/net/tcp6" )];
+  snprintf ( path, sizeof path, "%s/%s", proc_root (), file );
+
+  return connection_update_ ( path, protocol, family == AF_INET6 );
+}
+
+/* traffic of loopback of others namespaces never is captured, and the
+   tuples are the same of loopback of netproc */
+static bool
+diag_conn_netns ( const struct inet_diag_msg *msg, void *user_data )
+{
+  static const uint8_t loopback6[16] = { [15] = 1 };
+
+  if ( msg->idiag_family == AF_INET )
+    {
+      if ( ( ntohl ( msg->id.idiag_src[0] ) >> 24 ) == 127 )
+        return true;
+    }
+  else if ( !memcmp ( msg->id.idiag_src, loopback6, sizeof loopback6 ) )
+    return true;
+
+  return diag_conn ( msg, user_data );
+}
+
+/* sockets of a namespace of containers, without fallback to /proc,
+   the families/protocols not supported are ignored */
+static bool
+update_netns ( int sock, void *user_data )
+{
+  static const int families[] = { AF_INET, AF_INET6 };
+  const int proto = *( int * ) user_data;
+
+  for ( size_t i = 0; i < ARRAY_SIZE ( families ); i++ )
+    {
+      int protocols[] = { ( proto & TCP ) ? IPPROTO_TCP : 0,
+                          ( proto & UDP ) ? IPPROTO_UDP : 0 };
+
+      for ( size_t j = 0; j < ARRAY_SIZE ( protocols ); j++ )
+        {
+          if ( !protocols[j] )
+            continue;
+
+          if ( !sock_diag_dump ( sock,
+                                 families[i],
+                                 protocols[j],
+                                 DIAG_STATES,
+                                 diag_conn_netns,
+                                 &protocols[j] ) &&
+               errno != ENOENT && errno != EPROTONOSUPPORT )
+            return false;
+        }
+    }
+
+  return true;
+}
+
+connection_t *
+connection_get_by_local ( const struct tuple *tuple )
+{
+  if ( tuple->l4.protocol != IPPROTO_UDP || !by_local.used )
+    return NULL;
+
+  struct tuple key = *tuple;
+  memset ( &key.l3.remote, 0, sizeof ( key.l3.remote ) );
+  key.l4.remote_port = 0;
+
+  // socket bound to address of packet
+  connection_t *conn =
+          tuple_index_get ( &by_local, &key, connection_hash_tuple ( &key ) );
+  if ( conn )
+    return conn;
+
+  // bound to any address, and ipv6 socket (dual stack) with traffic ipv4
+  memset ( &key.l3.local, 0, sizeof ( key.l3.local ) );
+  conn = tuple_index_get ( &by_local, &key, connection_hash_tuple ( &key ) );
+
+  if ( !conn && key.family == AF_INET )
+    {
+      key.family = AF_INET6;
+      conn = tuple_index_get (
+              &by_local, &key, connection_hash_tuple ( &key ) );
+    }
+
+  return conn;
+}
+
+connection_t *
+connection_new_subflow ( connection_t *parent, const struct tuple *tuple )
+{
+  if ( max_subflows && total_subflows >= max_subflows )
+    return NULL;
+
+  connection_t *conn = create_new_conn ( 0, 0, tuple, parent->state );
+  if ( !conn )
+    return NULL;
+
+  conn->subflow = true;
+
+  if ( !tuple_index_set (
+               &by_tuple, conn, connection_hash_tuple ( &conn->tuple ) ) )
+    {
+      networks_leave ( conn->network );
+      pool_free ( &conn_pool, conn );
+      return NULL;
+    }
+
+  total_subflows++;
+
+  return conn;
+}
+
+connection_t *
+connection_parent ( const connection_t *conn )
+{
+  return conn->subflow ? connection_get_by_local ( &conn->tuple ) : NULL;
+}
+
+/* sub-flow is kept while the socket (parent) exist and it has traffic,
+   the traffic only is accounted in sub-flows with view of connections */
+static bool
+subflow_alive ( const connection_t *conn, uint32_t now )
+{
+  unsigned int idle = ( trim_subflows ) ? 1 : SUBFLOW_IDLE;
+
+  return connection_parent ( conn ) &&
+         now - conn->net_stat.sec <= rate_ticks ( idle );
+}
+
+/* counters of sub-flow evicted are kept in its socket, exported flows
+   already have its counters in its own record */
+static void
+fold_subflow ( connection_t *conn )
+{
+  if ( export_flows )
+    return;
+
+  connection_t *parent = connection_parent ( conn );
+
+  if ( parent )
+    rate_net_stat_merge ( &parent->net_stat, &conn->net_stat );
+}
+
+/* CLOCK, the hand visits the sub-flows and evicts those without traffic
+   since last visit, the others has the reference cleared (second chance).
+   evicted are marked to removal, at most 'excess' */
+static void
+evict_subflows ( size_t excess )
+{
+  size_t size = tuple_index_size ( &by_tuple );
+
+  // two turns, in second all sub-flows were already cleared
+  for ( size_t n = 0; excess && n < 2 * size; n++ )
+    {
+      connection_t *conn = tuple_index_at ( &by_tuple, clock_hand );
+
+      clock_hand = ( clock_hand + 1 ) % size;
+
+      if ( !conn || !conn->subflow || !conn->refs_active )
+        continue;
+
+      if ( conn->referenced )
+        {
+          conn->referenced = false;
+          continue;
+        }
+
+      fold_subflow ( conn );
+      conn->refs_active = 0;
+      excess--;
+    }
+}
+
+static void
+remove_inactives_conns ( void )
+{
+  size_t size = tuple_index_size ( &by_tuple );
+
+  // tick of capture of packets is of the time of system
+  uint32_t now = rate_now ();
+
+  for ( size_t i = 0; i < vector_size ( retired ); i++ )
+    release_conn ( retired[i] );
+
+  vector_clear ( retired );
+
+  for ( size_t i = 0; i < size; i++ )
+    {
+      connection_t *conn = tuple_index_at ( &by_tuple, i );
+
+      if ( !conn )
+        continue;
+
+      if ( conn->subflow )
+        conn->refs_active = subflow_alive ( conn, now );
+      else
+        conn->refs_active--;
+    }
+
+  trim_subflows = false;
+
+  if ( max_subflows &&
+       total_subflows > max_subflows - EVICT_SLACK ( max_subflows ) )
+    evict_subflows ( total_subflows - max_subflows +
+                     EVICT_SLACK ( max_subflows ) );
+
+  /* the deletion move the next slots to back, so the same slot is checked
+     again. a slot moved of begin to end is only checked again */
+  for ( size_t i = 0; i < size; )
+    {
+      connection_t *conn = tuple_index_at ( &by_tuple, i );
+
+      if ( !conn || conn->refs_active )
+        {
+          i++;
+          continue;
+        }
+
+      if ( is_unconnected ( &conn->tuple ) )
+        tuple_index_del (
+                &by_local, conn, connection_hash_tuple ( &conn->tuple ) );
+
+      if ( export_flows )
+        flow_export_add ( conn );
+
+      inode_index_del ( &by_inode, conn );
+      tuple_index_del_at ( &by_tuple, i );
+      release_conn ( conn );
     }
 }
 
 bool
 connection_init ( void )
 {
-  ht_connections = hashtable_min_new ();
+  if ( !tuple_index_init ( &by_tuple ) )
+    return false;
+
+  if ( !inode_index_init ( &by_inode ) )
+    goto ERROR_TUPLE;
+
+  if ( !tuple_index_init ( &by_local ) )
+    goto ERROR_INODE;
+
+  if ( !( retired = vector_new ( sizeof ( *retired ) ) ) )
+    {
+      tuple_index_free ( &by_local );
+      goto ERROR_INODE;
+    }
+
+  pool_init ( &conn_pool, "connections", sizeof ( connection_t ), 0 );
+
+  // without sock_diag the connections are read of /proc
+  diag_sock = sock_diag_init ();
+
+  // without namespaces, only sockets of namespace of netproc are read
+  netns_init ();
+
+  return true;
+
+ERROR_INODE:
+  inode_index_free ( &by_inode );
+ERROR_TUPLE:
+  tuple_index_free ( &by_tuple );
+  return false;
+}
+
+void
+connection_limit_subflows ( size_t max )
+{
+  max_subflows = max;
+}
+
+void
+connection_export ( bool enable )
+{
+  export_flows = enable;
+}
+
+void
+connection_keep_owner ( connection_t *conn )
+{
+  process_t *proc = conn->proc;
 
-  return !!ht_connections;
+  if ( !export_flows || !proc ||
+       ( conn->owner_name == proc->name && conn->owner_pid == proc->pid ) )
+    return;
+
+  intern_put ( conn->owner_name );
+  conn->owner_name = intern_ref ( proc->name );
+  conn->owner_pid = proc->pid;
 }
 
-#define PATH_TCP "/proc/net/tcp"
-#define PATH_UDP "/proc/net/udp"
+#define PATH_TCP "net/tcp"
+#define PATH_UDP "net/udp"
+#define PATH_TCP6 "net/tcp6"
+#define PATH_UDP6 "net/udp6"
 
 bool
 connection_update ( const int proto )
 {
-  hashtable_foreach_remove ( ht_connections, remove_inactives_conns, NULL );
+  remove_inactives_conns ();
 
   if ( proto & TCP )
     {
-      if ( !connection_update_ ( PATH_TCP, IPPROTO_TCP ) )
+      if ( !connection_update_diag ( AF_INET, IPPROTO_TCP, PATH_TCP ) ||
+           !connection_update_diag ( AF_INET6, IPPROTO_TCP, PATH_TCP6 ) )
         return false;
     }
 
   if ( proto & UDP )
     {
-      if ( !connection_update_ ( PATH_UDP, IPPROTO_UDP ) )
+      if ( !connection_update_diag ( AF_INET, IPPROTO_UDP, PATH_UDP ) ||
+           !connection_update_diag ( AF_INET6, IPPROTO_UDP, PATH_UDP6 ) )
         return false;
     }
 
-  return true;
+  bool ret = netns_foreach ( false, update_netns, ( void * ) &proto );
+  netns_read ();
+
+  return ret;
+}
+
+bool
+connection_update_netns ( const int proto )
+{
+  bool ret = netns_foreach ( true, update_netns, ( void * ) &proto );
+  netns_read ();
+
+  return ret;
+}
+
+bool
+connection_can_lookup ( const struct tuple *tuple )
+{
+  return diag_sock != -1 &&
+         !( diag_unsupported & diag_id ( tuple->family, tuple->l4.protocol ) );
+}
+
+struct netns_find
+{
+  const struct tuple *tuple;
+  struct inet_diag_msg *msg;
+};
+
+// stop in first namespace with socket of tuple
+static bool
+find_netns ( int sock, void *user_data )
+{
+  struct netns_find *find = user_data;
+
+  return !sock_diag_find ( sock, find->tuple, find->msg );
+}
+
+bool
+connection_tcp_info ( const connection_t *const *conns,
+                      size_t total,
+                      struct sock_diag_tcp_info *info )
+{
+  const struct tuple *tuples[SOCK_DIAG_BATCH];
+  uint64_t cookies[SOCK_DIAG_BATCH];
+
+  if ( diag_sock == -1 )
+    return false;
+
+  total = MIN ( total, SOCK_DIAG_BATCH );
+  for ( size_t i = 0; i < total; i++ )
+    {
+      tuples[i] = &conns[i]->tuple;
+      cookies[i] = conns[i]->cookie;
+    }
+
+  return sock_diag_tcp_info ( diag_sock, tuples, cookies, total, info );
+}
+
+connection_t *
+connection_lookup ( const struct tuple *tuple )
+{
+  struct inet_diag_msg msg;
+  struct netns_find find = { .tuple = tuple, .msg = &msg };
+
+  if ( !connection_can_lookup ( tuple ) )
+    return NULL;
+
+  // socket of a container, of other namespace
+  if ( !sock_diag_find ( diag_sock, tuple, &msg ) &&
+       netns_foreach ( false, find_netns, &find ) )
+    return NULL;
+
+  // same states ignored in update
+  if ( !( DIAG_STATES & SOCK_DIAG_STATE ( msg.idiag_state ) ) )
+    return NULL;
+
+  int protocol = tuple->l4.protocol;
+  if ( !diag_conn ( &msg, &protocol ) )
+    return NULL;
+
+  return connection_get_by_inode ( msg.idiag_inode );
 }
 
 connection_t *
 connection_get_by_inode ( const unsigned long inode )
 {
-  return hashtable_min_get ( ht_connections,
-                             &inode,
-                             hash ( &inode, sizeof ( inode ) ),
-                             ht_cb_compare_inode );
+  return inode_index_get ( &by_inode, inode );
+}
+
+bool
+connection_active ( const connection_t *conn )
+{
+  return conn->subflow || conn->refs_active == 2;
 }
 
 connection_t *
 connection_get_by_tuple ( struct tuple *tuple )
 {
-  return hashtable_min_get (
-          ht_connections,
-          tuple,
-          hash ( tuple, SIZEOF_MEMBER ( connection_t, tuple ) ),
-          ht_cb_compare_tuple );
+  return connection_get_by_tuple_hash ( tuple,
+                                        connection_hash_tuple ( tuple ) );
 }
 
-static void
-conn_free ( void *data )
+/* hash only the words used of tuple, ipv4 (the most common) is a key of
+   two words, addresses in first and ports, family and protocol in second */
+hash_t
+connection_hash_tuple ( const struct tuple *tuple )
 {
-  connection_t *conn = data;
+  uint64_t l4 = ( ( uint64_t ) tuple->l4.local_port << 48 ) |
+                ( ( uint64_t ) tuple->l4.remote_port << 32 ) |
+                ( ( uint64_t ) tuple->family << 8 ) | tuple->l4.protocol;
+
+  if ( tuple->family == AF_INET6 )
+    {
+      uint64_t words[5];
 
-  /* first entry go be 0, not free, remove second entry */
-  if ( conn->refs_exit++ == 1 )
-    free ( conn );
+      memcpy ( words, tuple->l3.local.ip6, 16 );
+      memcpy ( &words[2], tuple->l3.remote.ip6, 16 );
+      words[4] = l4;
+
+      return hash_words ( words, ARRAY_SIZE ( words ) );
+    }
+
+  const uint64_t words[] = {
+    ( ( uint64_t ) tuple->l3.local.ip << 32 ) | tuple->l3.remote.ip, l4
+  };
+
+  return hash_words ( words, ARRAY_SIZE ( words ) );
+}
+
+void
+connection_prefetch_bucket ( hash_t hash )
+{
+  tuple_index_prefetch ( &by_tuple, hash );
+}
+
+void
+connection_prefetch_entry ( hash_t hash )
+{
+  tuple_index_prefetch_conn ( &by_tuple, hash );
+}
+
+connection_t *
+connection_get_by_tuple_hash ( const struct tuple *tuple, hash_t hash )
+{
+  return tuple_index_get ( &by_tuple, tuple, hash );
+}
+
+void
+connection_foreach ( void ( *func ) ( connection_t *conn, void *user_data ),
+                     void *user_data )
+{
+  size_t size = tuple_index_size ( &by_tuple );
+
+  for ( size_t i = 0; i < size; i++ )
+    {
+      connection_t *conn = tuple_index_at ( &by_tuple, i );
+
+      if ( conn )
+        func ( conn, user_data );
+    }
+}
+
+size_t
+connection_memory ( void )
+{
+  return conn_pool.used * conn_pool.obj_size +
+         ( tuple_index_size ( &by_tuple ) + tuple_index_size ( &by_local ) ) *
+                 sizeof ( struct tuple_slot ) +
+         inode_index_size ( &by_inode ) * sizeof ( struct inode_slot );
+}
+
+void
+connection_trim ( void )
+{
+  size_t size = tuple_index_size ( &by_tuple );
+
+  // text is formatted again if the connection is showed
+  for ( size_t i = 0; i < size; i++ )
+    {
+      connection_t *conn = tuple_index_at ( &by_tuple, i );
+
+      if ( conn && conn->display && !conn->net_stat.active )
+        {
+          free ( conn->display );
+          conn->display = NULL;
+        }
+    }
+
+  trim_subflows = true;
 }
 
 void
 connection_free ( void )
 {
-  if ( ht_connections )
-    hashtable_min_detroy ( ht_connections, conn_free );
+  // release all connections
+  size_t size = tuple_index_size ( &by_tuple );
+  for ( size_t i = 0; i < size; i++ )
+    {
+      connection_t *conn = tuple_index_at ( &by_tuple, i );
+
+      if ( conn )
+        {
+          free ( conn->display );
+          intern_put ( conn->owner_name );
+        }
+    }
+
+  for ( size_t i = 0; i < vector_size ( retired ); i++ )
+    {
+      free ( retired[i]->display );
+      intern_put ( retired[i]->owner_name );
+    }
+
+  vector_free ( retired );
+  retired = NULL;
+
+  pool_destroy ( &conn_pool );
+  total_subflows = 0;
+
+  tuple_index_free ( &by_tuple );
+  inode_index_free ( &by_inode );
+  tuple_index_free ( &by_local );
+
+  sock_diag_free ( diag_sock );
+  diag_sock = -1;
+
+  arena_free ( &file_arena );
+
+  netns_free ();
 }
@@ -23,43 +23,156 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/types.h>  // pid_t
 
-#include "rate.h"  // struct net_stat
+#include "rate.h"       // struct net_stat
+#include "hashtable.h"  // hash_t
 #include "sockaddr.h"
 
 // forward declaration
 typedef struct process process_t;
 
 /* stores the information exported by the kernel in /proc/net/tcp | udp.
-   each conn has two entries in hashtable, one with key inode and other with key
-   tuple */
+   each conn is in two indexes, one with key inode and other with key
+   tuple (see conn_index.h). the socket is identified by cookie and tuple,
+   a inode reused by a new socket is a new conn */
 typedef struct conection
 {
   struct net_stat net_stat;  // assign in statistics.c
   struct tuple tuple;        // layer 3 and 4 info
   process_t *proc;           // process the connection belongs to
+  struct conection *proc_prev, *proc_next;  // in connections of 'proc'
   unsigned long inode;       // kernel linux usage this type to inode
+  uint64_t cookie;           // of socket by sock_diag, 0 if unknown
   int if_index;              // assign in statistics.c
+  uint32_t network;          // row of remote, see networks.h
+  uint32_t start;            // tick of creation, start of flow record
   uint8_t state;             // status tcp connection
 
+  char *display;         // tuple formatted by translate, NULL if never showed
+  uint32_t display_gen;  // generation of resolver of 'display'
+
+  // last process of connection, to flow record after process closed
+  const char *owner_name;  // interned (see intern.h), or NULL
+  pid_t owner_pid;
+
   // internal state
-  uint8_t refs_active;  // if 1 connection is removed from ht, if 0 connection
-                        // is removed from ht and free
-  uint8_t refs_exit;    // usage to cleanup hashtable
+  uint8_t refs_active;  // updates until removed, if 0 connection is removed
+                        // from indexes and free
+  bool subflow;         // traffic of a peer of unconnected socket udp
+  bool unowned;         // socket not found in fds of processes in last scan
+  uint32_t scan_gen;    // last scan of processes that found the socket
+  bool referenced;      // traffic since last turn of clock of evictions
 } connection_t;
 
 bool
 connection_init ( void );
 
+/* at most 'max' sub-flows, 0 is without limit. above it, in
+   connection_update, the sub-flows without traffic since last turn of clock
+   are evicted and its counters are added to socket (parent), and new
+   sub-flows are not created, its traffic is of socket. sockets exported by
+   kernel not are limited, they are read again in each update */
+void
+connection_limit_subflows ( size_t max );
+
+/* with 'enable', the connections are exported as flow records when
+   removed, see flow_export.h. sub-flows evicted are exported and not
+   added to parent */
+void
+connection_export ( bool enable );
+
+/* keep the process of 'conn' as owner of flow record, before the process
+   be cleared of connection */
+void
+connection_keep_owner ( connection_t *conn );
+
 bool
 connection_update ( const int proto );
 
+/* read only sockets of network namespaces found since last update (see
+   netns.h), without remove connections closed */
+bool
+connection_update_netns ( const int proto );
+
+/* true if the connection of 'tuple' can be looked up in kernel
+   by connection_lookup */
+bool
+connection_can_lookup ( const struct tuple *tuple );
+
+struct sock_diag_tcp_info;
+
+/* TCP_INFO of 'total' tcp connections (up to SOCK_DIAG_BATCH), by tuple
+   and cookie in a single batch of sock_diag (see sock_diag_tcp_info).
+   only sockets of namespace of netproc are found, return false on error */
+bool
+connection_tcp_info ( const connection_t *const *conns,
+                      size_t total,
+                      struct sock_diag_tcp_info *info );
+
+/* look up in kernel only the socket of 'tuple' (sock_diag), the connection
+   is added without update of all connections.
+   return NULL if socket not exist or can't be looked up */
+connection_t *
+connection_lookup ( const struct tuple *tuple );
+
 connection_t *
 connection_get_by_inode ( const unsigned long inode );
 
+// false if socket of 'conn' was not in last update, it is closed
+bool
+connection_active ( const connection_t *conn );
+
 connection_t *
 connection_get_by_tuple ( struct tuple *tuple );
 
+/* unconnected udp sockets are exported with remote 0.0.0.0:0, so the
+   packets of them never match by tuple. return the connection of socket
+   bound to local address and port of 'tuple', used only after a miss */
+connection_t *
+connection_get_by_local ( const struct tuple *tuple );
+
+/* to view of connections, each peer of a unconnected socket ('parent') is
+   a sub-flow with the tuple of packets, it is added to process of parent
+   by caller (see processes_add_connection).
+   sub-flow is only in index by tuple and is removed when parent is closed
+   or after some seconds without traffic */
+connection_t *
+connection_new_subflow ( connection_t *parent, const struct tuple *tuple );
+
+// socket of sub-flow or NULL if it not is a sub-flow or parent closed
+connection_t *
+connection_parent ( const connection_t *conn );
+
+/* to lookups in batch, the hash of tuple is calculated once and used to
+   prefetch (see tuple_index_prefetch) and to get the connection */
+hash_t
+connection_hash_tuple ( const struct tuple *tuple );
+
+void
+connection_prefetch_bucket ( hash_t hash );
+
+void
+connection_prefetch_entry ( hash_t hash );
+
+connection_t *
+connection_get_by_tuple_hash ( const struct tuple *tuple, hash_t hash );
+
+/* call 'func' one time to each connection */
+void
+connection_foreach ( void ( *func ) ( connection_t *conn, void *user_data ),
+                     void *user_data );
+
+// bytes in use of connections and its indexes
+size_t
+connection_memory ( void );
+
+/* release the text (see translate) of connections without traffic in
+   windows, and in next connection_update remove sub-flows without traffic
+   in last second */
+void
+connection_trim ( void );
+
 void
 connection_free ( void );
 
@@ -0,0 +1,437 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE  // accept4
+
+#include <errno.h>   // variable errno
+#include <stdio.h>   // snprintf
+#include <stdlib.h>  // strtoul
+#include <string.h>  // strerror, strcmp
+#include <unistd.h>  // close, unlink
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "control.h"
+#include "config.h"  // TCP, UDP, MIN_REFRESH
+#include "m_error.h"
+#include "macro_util.h"
+
+// clients simultaneous, others are closed on accept
+#define MAX_CLIENTS 4
+
+// commands waiting the next refresh, others are answered with error
+#define MAX_PENDING 32
+
+// longest command, lines longer are discarded
+#define LINE_SIZE 128
+
+struct client
+{
+  char line[LINE_SIZE];
+  size_t len;
+  unsigned int pending;  // commands in queue, client is kept until answered
+  bool eof;              // closed by peer after last command
+  bool discard;          // rest of long line
+  bool used;             // slot with client or with commands pending
+  int fd;                // -1 after closed
+};
+
+struct pending
+{
+  struct control_cmd cmd;
+  struct client *cl;
+};
+
+static struct client clients[MAX_CLIENTS];
+
+static struct pending queue[MAX_PENDING];
+static unsigned int queue_head, queue_len;
+
+// client of last command of control_next
+static struct client *replying;
+
+static const char *path_socket;
+static int listen_fd = -1;
+static int epfd = -1;
+
+// slot is released after answers of commands pending
+static void
+client_close ( struct client *cl )
+{
+  if ( cl->fd != -1 )
+    {
+      epoll_ctl ( epfd, EPOLL_CTL_DEL, cl->fd, NULL );
+      close ( cl->fd );
+      cl->fd = -1;
+    }
+
+  cl->used = cl->pending;
+}
+
+// answers are small, a client that not read them lose the answer
+static void
+client_send ( struct client *cl, const char *error )
+{
+  char buf[LINE_SIZE + 16];
+  int len = ( error ) ? snprintf ( buf, sizeof buf, "error: %s\n", error )
+                      : snprintf ( buf, sizeof buf, "ok\n" );
+
+  send ( cl->fd, buf, MIN ( ( size_t ) len, sizeof buf - 1 ), MSG_NOSIGNAL );
+}
+
+static bool
+parse_switch ( const char *arg, unsigned int *value )
+{
+  if ( !strcmp ( arg, "on" ) )
+    *value = 1;
+  else if ( !strcmp ( arg, "off" ) )
+    *value = 0;
+  else
+    return false;
+
+  return true;
+}
+
+static bool
+parse_number ( const char *arg,
+               unsigned int min,
+               unsigned int max,
+               unsigned int *value )
+{
+  char *end;
+
+  errno = 0;
+  unsigned long n = strtoul ( arg, &end, 10 );
+  if ( errno || end == arg || *end || n < min || n > max )
+    return false;
+
+  *value = n;
+  return true;
+}
+
+static bool
+parse_protocol ( const char *arg, unsigned int *value )
+{
+  if ( !strcmp ( arg, "tcp" ) )
+    *value = TCP;
+  else if ( !strcmp ( arg, "udp" ) )
+    *value = UDP;
+  else if ( !strcmp ( arg, "all" ) )
+    *value = TCP | UDP;
+  else
+    return false;
+
+  return true;
+}
+
+// command of 'line' in 'cmd', return error to client or NULL
+static const char *
+parse_line ( char *line, struct control_cmd *cmd )
+{
+  static const struct
+  {
+    const char *name;
+    const char *usage;  // NULL if command is without argument
+  } commands[] = { [CONTROL_PROTOCOL] = { "protocol", "protocol tcp|udp|all" },
+                   [CONTROL_CONNECTIONS] = { "connections",
+                                             "connections on|off" },
+                   [CONTROL_RESOLVE] = { "resolve", "resolve on|off" },
+                   [CONTROL_REFRESH] = { "refresh",
+                                         "refresh ms (50 to 10000)" },
+                   [CONTROL_SAMPLE] = { "sample", "sample N (1 to 65536)" },
+                   [CONTROL_SNAPSHOT] = { "snapshot", NULL } };
+
+  char *save;
+  char *name = strtok_r ( line, " \t\r", &save );
+  char *arg = strtok_r ( NULL, " \t\r", &save );
+
+  if ( !name )
+    return "empty command";
+
+  unsigned int op;
+  for ( op = 0; op < TOTAL_CONTROL_OPS; op++ )
+    {
+      if ( !strcmp ( name, commands[op].name ) )
+        break;
+    }
+
+  if ( op == TOTAL_CONTROL_OPS )
+    return "unknown command";
+
+  if ( strtok_r ( NULL, " \t\r", &save ) || !arg != !commands[op].usage )
+    return ( commands[op].usage ) ? commands[op].usage : "without argument";
+
+  bool valid = true;
+  cmd->op = op;
+  cmd->value = 0;
+
+  switch ( op )
+    {
+      case CONTROL_PROTOCOL:
+        valid = parse_protocol ( arg, &cmd->value );
+        break;
+      case CONTROL_CONNECTIONS:
+      case CONTROL_RESOLVE:
+        valid = parse_switch ( arg, &cmd->value );
+        break;
+      case CONTROL_REFRESH:
+        valid = parse_number ( arg, MIN_REFRESH, MAX_REFRESH, &cmd->value );
+        break;
+      case CONTROL_SAMPLE:
+        valid = parse_number ( arg, 1, MAX_SAMPLE, &cmd->value );
+        break;
+    }
+
+  return ( valid ) ? NULL : commands[op].usage;
+}
+
+static void
+client_command ( struct client *cl, char *line )
+{
+  struct control_cmd cmd;
+  const char *error = parse_line ( line, &cmd );
+
+  if ( !error && queue_len == MAX_PENDING )
+    error = "too many commands pending";
+
+  if ( error )
+    {
+      client_send ( cl, error );
+      return;
+    }
+
+  queue[( queue_head + queue_len++ ) % MAX_PENDING] =
+          ( struct pending ){ .cmd = cmd, .cl = cl };
+  cl->pending++;
+}
+
+// commands of lines received, false if client must be closed
+static bool
+client_read ( struct client *cl )
+{
+  while ( 1 )
+    {
+      ssize_t len = recv (
+              cl->fd, cl->line + cl->len, sizeof cl->line - cl->len - 1, 0 );
+
+      if ( len == -1 )
+        return errno == EAGAIN || errno == EINTR;
+
+      if ( !len )
+        {
+          // answers of commands pending are still sent
+          cl->eof = true;
+          epoll_ctl ( epfd, EPOLL_CTL_DEL, cl->fd, NULL );
+          return cl->pending;
+        }
+
+      cl->len += len;
+      cl->line[cl->len] = '\0';
+
+      char *line = cl->line, *nl;
+      while ( ( nl = strchr ( line, '\n' ) ) )
+        {
+          *nl = '\0';
+          if ( !cl->discard )
+            client_command ( cl, line );
+
+          cl->discard = false;
+          line = nl + 1;
+        }
+
+      cl->len -= line - cl->line;
+      memmove ( cl->line, line, cl->len );
+
+      // line too long, the rest until newline is discarded
+      if ( cl->len == sizeof cl->line - 1 )
+        {
+          if ( !cl->discard )
+            client_send ( cl, "command too long" );
+
+          cl->discard = true;
+          cl->len = 0;
+        }
+    }
+}
+
+static void
+client_accept ( void )
+{
+  int fd;
+
+  while ( ( fd = accept4 (
+                    listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC ) ) !=
+          -1 )
+    {
+      struct client *cl = NULL;
+      for ( size_t i = 0; i < ARRAY_SIZE ( clients ); i++ )
+        {
+          if ( !clients[i].used )
+            {
+              cl = &clients[i];
+              break;
+            }
+        }
+
+      struct epoll_event ev = { .events = EPOLLIN, .data.ptr = cl };
+      if ( !cl || epoll_ctl ( epfd, EPOLL_CTL_ADD, fd, &ev ) == -1 )
+        {
+          close ( fd );
+          continue;
+        }
+
+      *cl = ( struct client ){ .fd = fd, .used = true };
+    }
+}
+
+bool
+control_init ( const char *path )
+{
+  for ( size_t i = 0; i < ARRAY_SIZE ( clients ); i++ )
+    clients[i] = ( struct client ){ .fd = -1 };
+
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  if ( strlen ( path ) >= sizeof addr.sun_path )
+    {
+      ERROR_DEBUG ( "Path of control socket too long \"%s\"", path );
+      return false;
+    }
+
+  strcpy ( addr.sun_path, path );
+
+  listen_fd = socket ( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  if ( listen_fd == -1 )
+    goto ERROR;
+
+  // socket of a previous run that not exited cleanly
+  unlink ( path );
+
+  if ( bind ( listen_fd, ( struct sockaddr * ) &addr, sizeof addr ) == -1 )
+    goto ERROR;
+
+  path_socket = path;
+
+  if ( listen ( listen_fd, MAX_CLIENTS ) == -1 )
+    goto ERROR;
+
+  epfd = epoll_create1 ( EPOLL_CLOEXEC );
+  if ( epfd == -1 )
+    goto ERROR;
+
+  struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+  if ( epoll_ctl ( epfd, EPOLL_CTL_ADD, listen_fd, &ev ) == -1 )
+    goto ERROR;
+
+  return true;
+
+ERROR:
+  ERROR_DEBUG ( "Error control socket \"%s\": %s", path, strerror ( errno ) );
+  control_free ();
+  return false;
+}
+
+int
+control_fd ( void )
+{
+  return epfd;
+}
+
+void
+control_handle ( void )
+{
+  struct epoll_event events[MAX_CLIENTS + 1];
+
+  int ne = epoll_wait ( epfd, events, ARRAY_SIZE ( events ), 0 );
+
+  for ( int i = 0; i < ne; i++ )
+    {
+      struct client *cl = events[i].data.ptr;
+
+      // listen socket
+      if ( !cl )
+        {
+          client_accept ();
+          continue;
+        }
+
+      if ( !client_read ( cl ) )
+        client_close ( cl );
+    }
+}
+
+bool
+control_next ( struct control_cmd *cmd )
+{
+  if ( !queue_len )
+    return false;
+
+  struct pending *p = &queue[queue_head];
+  queue_head = ( queue_head + 1 ) % MAX_PENDING;
+  queue_len--;
+
+  *cmd = p->cmd;
+  replying = p->cl;
+
+  return true;
+}
+
+void
+control_reply ( const char *error )
+{
+  struct client *cl = replying;
+  if ( !cl )
+    return;
+
+  replying = NULL;
+
+  if ( cl->fd != -1 )
+    client_send ( cl, error );
+
+  // closed by peer, the last answer was sent
+  if ( !--cl->pending && ( cl->eof || cl->fd == -1 ) )
+    client_close ( cl );
+}
+
+void
+control_free ( void )
+{
+  for ( size_t i = 0; i < ARRAY_SIZE ( clients ); i++ )
+    {
+      if ( clients[i].fd != -1 )
+        close ( clients[i].fd );
+
+      clients[i].fd = -1;
+      clients[i].used = false;
+    }
+
+  if ( epfd != -1 )
+    close ( epfd );
+
+  if ( listen_fd != -1 )
+    close ( listen_fd );
+
+  if ( path_socket )
+    unlink ( path_socket );
+
+  epfd = listen_fd = -1;
+  path_socket = NULL;
+  queue_len = 0;
+}
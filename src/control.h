@@ -0,0 +1,78 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+
+/* unix socket of control, to change the configuration without restart.
+   a command by line, as "protocol tcp", each one is answered with "ok" or
+   "error: <reason>" after it is applied, in the next refresh (invalid
+   commands are answered at once):
+
+     protocol tcp|udp|all  protocols captured, filter swapped in kernel
+     connections on|off    traffic and rows of connections, as '-c'
+     resolve on|off        names of hosts and services, as '-n'
+     refresh ms            interval of refresh, rates keep the tick of start
+     sample N              capture 1 in N packets, as '--sample'
+     snapshot              write totals in file of '-f' now */
+
+enum control_op
+{
+  CONTROL_PROTOCOL,
+  CONTROL_CONNECTIONS,
+  CONTROL_RESOLVE,
+  CONTROL_REFRESH,
+  CONTROL_SAMPLE,
+  CONTROL_SNAPSHOT,
+  TOTAL_CONTROL_OPS
+};
+
+struct control_cmd
+{
+  enum control_op op;
+  unsigned int value;  // TCP | UDP, 0 or 1 (off or on), milliseconds or N
+};
+
+bool
+control_init ( const char *path );
+
+/* file descriptor (epoll) readable when there are clients to handle, -1
+   if control is not started */
+int
+control_fd ( void );
+
+// accept clients and read commands, queued until control_next
+void
+control_handle ( void );
+
+// next command received, false without commands
+bool
+control_next ( struct control_cmd *cmd );
+
+// answer to client of last command of control_next, 'error' NULL is ok
+void
+control_reply ( const char *error );
+
+void
+control_free ( void );
+
+#endif  // CONTROL_H
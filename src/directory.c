@@ -18,69 +18,157 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdio.h>
 #include <errno.h>
-#include <ctype.h>      // isdigit
-#include <dirent.h>     // *dir
-#include <stdbool.h>    // type boolean
-#include <stdint.h>     // type uint*
-#include <stdlib.h>     // malloc
-#include <string.h>     // memset
-#include <sys/types.h>  // *dir
+#include <fcntl.h>        // open
+#include <stdbool.h>      // type boolean
+#include <stdint.h>       // type uint*
+#include <stdlib.h>       // realloc
+#include <string.h>       // strerror, memcpy
+#include <sys/syscall.h>  // SYS_getdents64
+#include <unistd.h>       // syscall
 
+#include "directory.h"
 #include "m_error.h"
 
 #define ENTRY_SIZE_BUF 128
 
+// size of buffer to getdents64, ~1000 entries of /proc/ by syscall
+#define DENTS_SIZE ( 32 * 1024 )
+
+static char root[PROC_ROOT_MAX + 1] = "/proc";
+
+// not exported by all versions of libc
+struct linux_dirent64
+{
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+// false if 'name' not is a number of 32 bits
+static bool
+parse_number ( const char *name, uint32_t *value )
+{
+  uint64_t n = 0;
+
+  if ( !*name )
+    return false;
+
+  for ( ; *name; name++ )
+    {
+      unsigned int digit = ( unsigned char ) *name - '0';
+      if ( digit > 9 )
+        return false;
+
+      n = n * 10 + digit;
+      if ( n > UINT32_MAX )
+        return false;
+    }
+
+  *value = n;
+
+  return true;
+}
+
+static bool
+push_number ( struct numeric_dir *nd, size_t count, uint32_t value )
+{
+  if ( count == nd->size )
+    {
+      size_t size = nd->size ? nd->size * 2 : ENTRY_SIZE_BUF;
+      void *temp = realloc ( nd->values, size * sizeof ( *nd->values ) );
+
+      if ( !temp )
+        return false;
+
+      nd->values = temp;
+      nd->size = size;
+    }
+
+  nd->values[count] = value;
+
+  return true;
+}
+
 // -1 failure
 int
-get_numeric_directory ( uint32_t **buffer, const char *path_dir )
+get_numeric_directory ( struct numeric_dir *nd, const char *path_dir )
 {
-  DIR *dir;
-  if ( ( dir = opendir ( path_dir ) ) == NULL )
+  if ( !nd->dents && !( nd->dents = malloc ( DENTS_SIZE ) ) )
+    return -1;
+
+  int fd = open ( path_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+  if ( fd == -1 )
     {
       ERROR_DEBUG ( "%s - %s", path_dir, strerror ( errno ) );
       return -1;
     }
 
-  errno = 0;
   int count = 0;
-  int len_buffer = 0;
-  struct dirent *directory;
-  while ( ( directory = readdir ( dir ) ) )
+  long nread;
+  while ( ( nread = syscall ( SYS_getdents64, fd, nd->dents, DENTS_SIZE ) ) >
+          0 )
     {
-      if ( count == len_buffer )
+      for ( long pos = 0; pos < nread; )
         {
-          len_buffer += ENTRY_SIZE_BUF;
-          void *temp;
-          temp = realloc ( *buffer, len_buffer * sizeof ( **buffer ) );
-
-          if ( !temp )
-            {
-              errno = 0;
-              goto END;
-            }
-
-          *buffer = temp;
-        }
+          struct linux_dirent64 *d =
+                  ( struct linux_dirent64 * ) ( ( char * ) nd->dents + pos );
+          pos += d->d_reclen;
 
-      char crap;
-      int rs = sscanf ( directory->d_name, "%u%c", &( *buffer )[count], &crap );
+          uint32_t value;
+          if ( !parse_number ( d->d_name, &value ) )
+            continue;
 
-      if ( rs != 1 )
-        continue;
+          // without memory, return what was read
+          if ( !push_number ( nd, count, value ) )
+            goto END;
 
-      count++;
+          count++;
+        }
     }
 
-  if ( errno )
+  if ( nread == -1 )
     {
       ERROR_DEBUG ( "%s", strerror ( errno ) );
       count = -1;
     }
 
 END:
-  closedir ( dir );
+  close ( fd );
 
   return count;
 }
+
+void
+numeric_dir_free ( struct numeric_dir *nd )
+{
+  free ( nd->values );
+  free ( nd->dents );
+  *nd = ( struct numeric_dir ){ 0 };
+}
+
+bool
+proc_root_set ( const char *path )
+{
+  size_t len = strlen ( path );
+
+  // "/" at end is removed, paths of scans are "<root>/<pid>/..."
+  while ( len > 1 && path[len - 1] == '/' )
+    len--;
+
+  if ( !len || len > PROC_ROOT_MAX )
+    return false;
+
+  memcpy ( root, path, len );
+  root[len] = '\0';
+
+  return true;
+}
+
+const char *
+proc_root ( void )
+{
+  return root;
+}
@@ -21,11 +21,39 @@
 #ifndef DIRECTORY_H
 #define DIRECTORY_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
-// return -1 on failure or number of found directories
+// max length of root of procfs, see proc_root_set
+#define PROC_ROOT_MAX 64
+
+/* entries with numeric name of a directory (as /proc/ and /proc/<pid>/fd/).
+   the buffers are kept between reads, so a reader used in each scan only
+   allocate memory when the directory grows */
+struct numeric_dir
+{
+  uint32_t *values;  // numbers of last read
+  size_t size;       // allocated in values
+  void *dents;       // buffer to getdents64
+};
+
+// return -1 on failure or number of found directories, in nd->values
 int
-get_numeric_directory ( uint32_t **buffer, const char *path_dir );
+get_numeric_directory ( struct numeric_dir *nd, const char *path_dir );
+
+void
+numeric_dir_free ( struct numeric_dir *nd );
+
+/* root of procfs used by scans of processes and connections, "/proc" by
+   default. other root is a tree of same layout (<pid>/fd/, <pid>/cmdline,
+   net/tcp...), as the synthetic tree of tests/bench.c.
+   return false if 'root' is longer than PROC_ROOT_MAX */
+bool
+proc_root_set ( const char *root );
+
+// without '/' at end
+const char *
+proc_root ( void );
 
 #endif  // DIRECTORY_H
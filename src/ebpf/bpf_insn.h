@@ -0,0 +1,93 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BPF_INSN_H
+#define BPF_INSN_H
+
+#include <linux/bpf.h>  // struct bpf_insn, BPF_*
+
+/* helpers to write eBPF programs instruction by instruction, without need
+   of clang/libbpf in build */
+
+#define EBPF_INSN( CODE, DST, SRC, OFF, IMM )                    \
+  ( ( struct bpf_insn ){ .code = ( CODE ),                       \
+                         .dst_reg = ( DST ),                     \
+                         .src_reg = ( SRC ),                     \
+                         .off = ( OFF ),                         \
+                         .imm = ( IMM ) } )
+
+// dst = src
+#define EBPF_MOV64_REG( DST, SRC ) \
+  EBPF_INSN ( BPF_ALU64 | BPF_MOV | BPF_X, DST, SRC, 0, 0 )
+
+// dst = imm
+#define EBPF_MOV64_IMM( DST, IMM ) \
+  EBPF_INSN ( BPF_ALU64 | BPF_MOV | BPF_K, DST, 0, 0, IMM )
+
+// dst op= imm
+#define EBPF_ALU64_IMM( OP, DST, IMM ) \
+  EBPF_INSN ( BPF_ALU64 | BPF_OP ( OP ) | BPF_K, DST, 0, 0, IMM )
+
+// dst op= src
+#define EBPF_ALU64_REG( OP, DST, SRC ) \
+  EBPF_INSN ( BPF_ALU64 | BPF_OP ( OP ) | BPF_X, DST, SRC, 0, 0 )
+
+// dst = *(size *) (src + off)
+#define EBPF_LDX_MEM( SIZE, DST, SRC, OFF ) \
+  EBPF_INSN ( BPF_LDX | BPF_SIZE ( SIZE ) | BPF_MEM, DST, SRC, OFF, 0 )
+
+// *(size *) (dst + off) = src
+#define EBPF_STX_MEM( SIZE, DST, SRC, OFF ) \
+  EBPF_INSN ( BPF_STX | BPF_SIZE ( SIZE ) | BPF_MEM, DST, SRC, OFF, 0 )
+
+// *(size *) (dst + off) = imm
+#define EBPF_ST_MEM( SIZE, DST, OFF, IMM ) \
+  EBPF_INSN ( BPF_ST | BPF_SIZE ( SIZE ) | BPF_MEM, DST, 0, OFF, IMM )
+
+// r0 = ntoh(*(size *) (skb->data + imm)), r6 must be the context
+#define EBPF_LD_ABS( SIZE, IMM ) \
+  EBPF_INSN ( BPF_LD | BPF_SIZE ( SIZE ) | BPF_ABS, 0, 0, 0, IMM )
+
+// r0 = ntoh(*(size *) (skb->data + src + imm)), r6 must be the context
+#define EBPF_LD_IND( SIZE, SRC, IMM ) \
+  EBPF_INSN ( BPF_LD | BPF_SIZE ( SIZE ) | BPF_IND, 0, SRC, 0, IMM )
+
+// dst = pointer to map, use two instructions
+#define EBPF_LD_MAP_FD( DST, FD )                                          \
+  EBPF_INSN ( BPF_LD | BPF_DW | BPF_IMM, DST, BPF_PSEUDO_MAP_FD, 0, FD ), \
+          EBPF_INSN ( 0, 0, 0, 0, 0 )
+
+// if (dst op imm) goto pc + off
+#define EBPF_JMP_IMM( OP, DST, IMM, OFF ) \
+  EBPF_INSN ( BPF_JMP | BPF_OP ( OP ) | BPF_K, DST, 0, OFF, IMM )
+
+// if (dst op src) goto pc + off
+#define EBPF_JMP_REG( OP, DST, SRC, OFF ) \
+  EBPF_INSN ( BPF_JMP | BPF_OP ( OP ) | BPF_X, DST, SRC, OFF, 0 )
+
+// goto pc + off
+#define EBPF_JMP_A( OFF ) EBPF_INSN ( BPF_JMP | BPF_JA, 0, 0, OFF, 0 )
+
+// call helper function
+#define EBPF_CALL( FUNC ) EBPF_INSN ( BPF_JMP | BPF_CALL, 0, 0, 0, FUNC )
+
+#define EBPF_EXIT() EBPF_INSN ( BPF_JMP | BPF_EXIT, 0, 0, 0, 0 )
+
+#endif  // BPF_INSN_H
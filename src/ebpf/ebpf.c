@@ -0,0 +1,760 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>         // fopen
+#include <stdlib.h>        // strtol
+#include <string.h>        // memset
+#include <errno.h>
+#include <unistd.h>        // syscall
+#include <sys/syscall.h>   // __NR_bpf
+#include <sys/resource.h>  // setrlimit
+#include <sys/ioctl.h>     // ioctl
+#include <sys/mman.h>      // mmap
+#include <sys/stat.h>      // fstat
+#include <fcntl.h>         // open
+#include <linux/perf_event.h>
+#include <linux/version.h>  // LINUX_VERSION_CODE
+
+#include "ebpf.h"
+#include "../m_error.h"
+
+#define PATH_POSSIBLE_CPUS "/sys/devices/system/cpu/possible"
+
+#define PATH_BTF_VMLINUX "/sys/kernel/btf/vmlinux"
+
+#define PATH_KPROBE_TYPE "/sys/bus/event_source/devices/kprobe/type"
+#define PATH_KPROBE_RETPROBE \
+  "/sys/bus/event_source/devices/kprobe/format/retprobe"
+
+static inline uint64_t
+ptr_to_u64 ( const void *ptr )
+{
+  return ( uint64_t ) ( unsigned long ) ptr;
+}
+
+static inline int
+sys_bpf ( enum bpf_cmd cmd, union bpf_attr *attr )
+{
+  return syscall ( __NR_bpf, cmd, attr, sizeof ( *attr ) );
+}
+
+void
+ebpf_prog_init ( struct ebpf_prog *prog )
+{
+  prog->len = 0;
+  prog->total_fixups = 0;
+  prog->overflow = false;
+
+  for ( size_t i = 0; i < EBPF_MAX_LABELS; i++ )
+    prog->labels[i] = -1;
+}
+
+void
+ebpf_emit ( struct ebpf_prog *prog,
+            const struct bpf_insn *insns,
+            size_t len )
+{
+  if ( prog->len + len > EBPF_MAX_INSNS )
+    {
+      prog->overflow = true;
+      return;
+    }
+
+  memcpy ( &prog->insns[prog->len], insns, len * sizeof ( *insns ) );
+  prog->len += len;
+}
+
+void
+ebpf_emit_jmp ( struct ebpf_prog *prog,
+                struct bpf_insn insn,
+                unsigned int label )
+{
+  if ( prog->total_fixups == EBPF_MAX_FIXUPS || label >= EBPF_MAX_LABELS )
+    {
+      prog->overflow = true;
+      return;
+    }
+
+  prog->fixups[prog->total_fixups].insn = prog->len;
+  prog->fixups[prog->total_fixups].label = label;
+  prog->total_fixups++;
+
+  ebpf_emit ( prog, &insn, 1 );
+}
+
+void
+ebpf_label ( struct ebpf_prog *prog, unsigned int label )
+{
+  if ( label >= EBPF_MAX_LABELS )
+    {
+      prog->overflow = true;
+      return;
+    }
+
+  prog->labels[label] = prog->len;
+}
+
+bool
+ebpf_prog_resolve ( struct ebpf_prog *prog )
+{
+  if ( prog->overflow )
+    return false;
+
+  for ( size_t i = 0; i < prog->total_fixups; i++ )
+    {
+      int target = prog->labels[prog->fixups[i].label];
+      if ( target == -1 )
+        return false;
+
+      // offset is relative to next instruction
+      prog->insns[prog->fixups[i].insn].off =
+              target - ( int ) prog->fixups[i].insn - 1;
+    }
+
+  return true;
+}
+
+int
+ebpf_prog_load ( enum bpf_prog_type type,
+                 const struct ebpf_prog *prog,
+                 uint32_t expected_attach_type )
+{
+  return ebpf_prog_load_btf ( type, prog, expected_attach_type, 0 );
+}
+
+int
+ebpf_prog_load_btf ( enum bpf_prog_type type,
+                     const struct ebpf_prog *prog,
+                     uint32_t expected_attach_type,
+                     uint32_t attach_btf_id )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.prog_type = type;
+  attr.insns = ptr_to_u64 ( prog->insns );
+  attr.insn_cnt = prog->len;
+  attr.license = ptr_to_u64 ( "GPL" );
+  attr.expected_attach_type = expected_attach_type;
+  attr.attach_btf_id = attach_btf_id;
+  attr.kern_version = LINUX_VERSION_CODE;  // required to kprobe in old kernels
+
+#ifndef NDEBUG
+  // log of verifier
+  static char log[1 << 16];
+  log[0] = '\0';
+  attr.log_buf = ptr_to_u64 ( log );
+  attr.log_size = sizeof ( log );
+  attr.log_level = 1;
+#endif
+
+  int fd = sys_bpf ( BPF_PROG_LOAD, &attr );
+
+#ifndef NDEBUG
+  if ( fd == -1 )
+    ERROR_DEBUG ( "Error load program ebpf: %s\n%s", strerror ( errno ), log );
+#endif
+
+  return fd;
+}
+
+int
+ebpf_map_create ( enum bpf_map_type type,
+                  uint32_t key_size,
+                  uint32_t value_size,
+                  uint32_t max_entries )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.map_type = type;
+  attr.key_size = key_size;
+  attr.value_size = value_size;
+  attr.max_entries = max_entries;
+
+  int fd = sys_bpf ( BPF_MAP_CREATE, &attr );
+  if ( fd == -1 )
+    {
+      ERROR_DEBUG ( "Error create map ebpf: %s", strerror ( errno ) );
+    }
+
+  return fd;
+}
+
+int
+ebpf_map_lookup ( int fd, const void *key, void *value )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.map_fd = fd;
+  attr.key = ptr_to_u64 ( key );
+  attr.value = ptr_to_u64 ( value );
+
+  return sys_bpf ( BPF_MAP_LOOKUP_ELEM, &attr );
+}
+
+int
+ebpf_map_update ( int fd, const void *key, const void *value, uint64_t flags )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.map_fd = fd;
+  attr.key = ptr_to_u64 ( key );
+  attr.value = ptr_to_u64 ( value );
+  attr.flags = flags;
+
+  return sys_bpf ( BPF_MAP_UPDATE_ELEM, &attr );
+}
+
+int
+ebpf_map_delete ( int fd, const void *key )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.map_fd = fd;
+  attr.key = ptr_to_u64 ( key );
+
+  return sys_bpf ( BPF_MAP_DELETE_ELEM, &attr );
+}
+
+int
+ebpf_map_next_key ( int fd, const void *key, void *next_key )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.map_fd = fd;
+  attr.key = ptr_to_u64 ( key );
+  attr.next_key = ptr_to_u64 ( next_key );
+
+  return sys_bpf ( BPF_MAP_GET_NEXT_KEY, &attr );
+}
+
+// file has format "0-3" or "0,2-5,7"
+unsigned int
+ebpf_possible_cpus ( void )
+{
+  FILE *file = fopen ( PATH_POSSIBLE_CPUS, "r" );
+  if ( !file )
+    {
+      ERROR_DEBUG ( "Error open " PATH_POSSIBLE_CPUS ": %s",
+                    strerror ( errno ) );
+      return 0;
+    }
+
+  unsigned int total = 0;
+  unsigned int start, end;
+  int ret;
+  while ( ( ret = fscanf ( file, "%u-%u", &start, &end ) ) >= 1 )
+    {
+      if ( ret == 1 )
+        end = start;
+
+      total += end - start + 1;
+
+      if ( fgetc ( file ) != ',' )
+        break;
+    }
+
+  fclose ( file );
+
+  return total;
+}
+
+void
+ebpf_rlimit ( void )
+{
+  struct rlimit rlim = { .rlim_cur = RLIM_INFINITY, .rlim_max = RLIM_INFINITY };
+
+  // is not fatal, new kernels not use memlock to maps
+  if ( setrlimit ( RLIMIT_MEMLOCK, &rlim ) == -1 )
+    {
+      ERROR_DEBUG ( "Error setrlimit: %s", strerror ( errno ) );
+    }
+}
+
+// read a number of file of sysfs
+static int
+read_sysfs_int ( const char *path, int *value )
+{
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    {
+      ERROR_DEBUG ( "Error open %s: %s", path, strerror ( errno ) );
+      return 0;
+    }
+
+  char buff[64];
+  char *ret = fgets ( buff, sizeof ( buff ), file );
+  fclose ( file );
+
+  if ( !ret )
+    return 0;
+
+  // files of format have prefix, e.g "config:9"
+  char *p = strchr ( buff, ':' );
+  p = ( p ) ? p + 1 : buff;
+
+  char *end;
+  *value = strtol ( p, &end, 10 );
+
+  return end != p;
+}
+
+int
+ebpf_attach_kprobe ( int prog, const char *func, bool retprobe )
+{
+  struct perf_event_attr attr;
+  int type, bit;
+
+  if ( !read_sysfs_int ( PATH_KPROBE_TYPE, &type ) )
+    return -1;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.size = sizeof ( attr );
+  attr.type = type;
+  attr.config1 = ptr_to_u64 ( func );  // kprobe_func
+  attr.config2 = 0;                    // offset in function
+
+  if ( retprobe )
+    {
+      if ( !read_sysfs_int ( PATH_KPROBE_RETPROBE, &bit ) )
+        return -1;
+
+      attr.config |= 1ULL << bit;
+    }
+
+  int fd = syscall ( __NR_perf_event_open,
+                     &attr,
+                     -1,  // all process
+                     0,   // cpu, to kprobe any cpu run the program
+                     -1,  // group
+                     PERF_FLAG_FD_CLOEXEC );
+  if ( fd == -1 )
+    {
+      ERROR_DEBUG ( "Error open kprobe %s: %s", func, strerror ( errno ) );
+      return -1;
+    }
+
+  if ( ioctl ( fd, PERF_EVENT_IOC_SET_BPF, prog ) == -1 ||
+       ioctl ( fd, PERF_EVENT_IOC_ENABLE, 0 ) == -1 )
+    {
+      ERROR_DEBUG ( "Error attach kprobe %s: %s", func, strerror ( errno ) );
+      close ( fd );
+      return -1;
+    }
+
+  return fd;
+}
+
+// reference
+// https://www.kernel.org/doc/html/latest/bpf/btf.html
+
+// kinds newer than headers of some distributions
+#define KIND_DECL_TAG 17
+#define KIND_ENUM64 19
+
+// size of type and of data that follow it, 0 if kind is unknown
+static size_t
+btf_type_size ( const struct btf_type *t )
+{
+  size_t vlen = BTF_INFO_VLEN ( t->info );
+
+  switch ( BTF_INFO_KIND ( t->info ) )
+    {
+      case BTF_KIND_INT:
+      case BTF_KIND_VAR:
+      case KIND_DECL_TAG:
+        return sizeof ( *t ) + sizeof ( uint32_t );
+      case BTF_KIND_ARRAY:
+        return sizeof ( *t ) + sizeof ( struct btf_array );
+      case BTF_KIND_STRUCT:
+      case BTF_KIND_UNION:
+        return sizeof ( *t ) + vlen * sizeof ( struct btf_member );
+      case BTF_KIND_ENUM:
+      case BTF_KIND_FUNC_PROTO:
+        return sizeof ( *t ) + vlen * 2 * sizeof ( uint32_t );
+      case BTF_KIND_DATASEC:
+      case KIND_ENUM64:
+        return sizeof ( *t ) + vlen * 3 * sizeof ( uint32_t );
+      case BTF_KIND_PTR:
+      case BTF_KIND_FWD:
+      case BTF_KIND_TYPEDEF:
+      case BTF_KIND_VOLATILE:
+      case BTF_KIND_CONST:
+      case BTF_KIND_RESTRICT:
+      case BTF_KIND_FUNC:
+      case 16:  // BTF_KIND_FLOAT
+      case 18:  // BTF_KIND_TYPE_TAG
+        return sizeof ( *t );
+      default:
+        return 0;
+    }
+}
+
+static bool
+read_file ( const char *path, uint8_t **data, size_t *size )
+{
+  int fd = open ( path, O_RDONLY | O_CLOEXEC );
+  if ( fd == -1 )
+    {
+      ERROR_DEBUG ( "Error open %s: %s", path, strerror ( errno ) );
+      return false;
+    }
+
+  struct stat st;
+  *data = NULL;
+  if ( fstat ( fd, &st ) == -1 || !( *data = malloc ( st.st_size ) ) )
+    goto ERROR_EXIT;
+
+  // sysfs not report size of file before of read
+  size_t total = 0;
+  while ( total < ( size_t ) st.st_size )
+    {
+      ssize_t ret = read ( fd, *data + total, st.st_size - total );
+      if ( ret <= 0 )
+        goto ERROR_EXIT;
+
+      total += ret;
+    }
+
+  close ( fd );
+  *size = total;
+
+  return true;
+
+ERROR_EXIT:
+  ERROR_DEBUG ( "Error read %s: %s", path, strerror ( errno ) );
+  free ( *data );
+  close ( fd );
+  return false;
+}
+
+bool
+ebpf_btf_load ( struct ebpf_btf *btf )
+{
+  size_t size;
+
+  memset ( btf, 0, sizeof ( *btf ) );
+  if ( !read_file ( PATH_BTF_VMLINUX, &btf->data, &size ) )
+    return false;
+
+  const struct btf_header *hdr = ( const struct btf_header * ) btf->data;
+  if ( size < sizeof ( *hdr ) || hdr->magic != BTF_MAGIC ||
+       ( size_t ) hdr->hdr_len + hdr->str_off + hdr->str_len > size ||
+       ( size_t ) hdr->hdr_len + hdr->type_off + hdr->type_len > size )
+    goto ERROR_EXIT;
+
+  const uint8_t *types = btf->data + hdr->hdr_len + hdr->type_off;
+  btf->strings = ( const char * ) btf->data + hdr->hdr_len + hdr->str_off;
+  btf->str_len = hdr->str_len;
+
+  // count types to index them by id
+  uint32_t total = 1;
+  size_t pos = 0;
+  for ( size_t len; pos < hdr->type_len; pos += len, total++ )
+    {
+      len = btf_type_size ( ( const struct btf_type * ) ( types + pos ) );
+      if ( !len )
+        goto ERROR_EXIT;
+    }
+
+  btf->types = malloc ( total * sizeof ( *btf->types ) );
+  if ( !btf->types )
+    goto ERROR_EXIT;
+
+  btf->types[0] = NULL;
+  btf->total_types = total;
+  pos = 0;
+  for ( uint32_t id = 1; id < total; id++ )
+    {
+      btf->types[id] = ( const struct btf_type * ) ( types + pos );
+      pos += btf_type_size ( btf->types[id] );
+    }
+
+  return true;
+
+ERROR_EXIT:
+  ERROR_DEBUG ( "%s", "Error parse BTF of kernel" );
+  ebpf_btf_free ( btf );
+  return false;
+}
+
+static const char *
+btf_name ( const struct ebpf_btf *btf, uint32_t name_off )
+{
+  return ( name_off < btf->str_len ) ? btf->strings + name_off : "";
+}
+
+uint32_t
+ebpf_btf_find ( const struct ebpf_btf *btf,
+                const char *name,
+                unsigned int kind )
+{
+  for ( uint32_t id = 1; id < btf->total_types; id++ )
+    {
+      const struct btf_type *t = btf->types[id];
+
+      if ( BTF_INFO_KIND ( t->info ) == kind &&
+           !strcmp ( btf_name ( btf, t->name_off ), name ) )
+        return id;
+    }
+
+  return 0;
+}
+
+// skip typedefs and modifiers (const, volatile...)
+static const struct btf_type *
+btf_resolve ( const struct ebpf_btf *btf, uint32_t id )
+{
+  while ( id && id < btf->total_types )
+    {
+      const struct btf_type *t = btf->types[id];
+
+      switch ( BTF_INFO_KIND ( t->info ) )
+        {
+          case BTF_KIND_TYPEDEF:
+          case BTF_KIND_VOLATILE:
+          case BTF_KIND_CONST:
+          case BTF_KIND_RESTRICT:
+          case 18:  // BTF_KIND_TYPE_TAG
+            id = t->type;
+            break;
+          default:
+            return t;
+        }
+    }
+
+  return NULL;
+}
+
+// offset in bits of 'member' in struct or union 't', -1 if not found
+static long
+btf_member_bits ( const struct ebpf_btf *btf,
+                  const struct btf_type *t,
+                  const char *member )
+{
+  const struct btf_member *m = ( const struct btf_member * ) ( t + 1 );
+  bool kflag = BTF_INFO_KFLAG ( t->info );
+
+  for ( size_t i = 0; i < BTF_INFO_VLEN ( t->info ); i++, m++ )
+    {
+      long off = kflag ? BTF_MEMBER_BIT_OFFSET ( m->offset ) : m->offset;
+
+      if ( m->name_off )
+        {
+          if ( strcmp ( btf_name ( btf, m->name_off ), member ) )
+            continue;
+
+          // bitfields can't be read by a load
+          if ( kflag && BTF_MEMBER_BITFIELD_SIZE ( m->offset ) )
+            return -1;
+
+          return off;
+        }
+
+      // members of anonymous structs and unions are in parent
+      const struct btf_type *anon = btf_resolve ( btf, m->type );
+      if ( !anon || ( BTF_INFO_KIND ( anon->info ) != BTF_KIND_STRUCT &&
+                      BTF_INFO_KIND ( anon->info ) != BTF_KIND_UNION ) )
+        continue;
+
+      long ret = btf_member_bits ( btf, anon, member );
+      if ( ret != -1 )
+        return off + ret;
+    }
+
+  return -1;
+}
+
+int
+ebpf_btf_member_offset ( const struct ebpf_btf *btf,
+                         const char *name,
+                         const char *member )
+{
+  uint32_t id = ebpf_btf_find ( btf, name, BTF_KIND_STRUCT );
+  if ( !id )
+    return -1;
+
+  long bits = btf_member_bits ( btf, btf->types[id], member );
+  if ( bits == -1 || bits % 8 )
+    return -1;
+
+  return bits / 8;
+}
+
+void
+ebpf_btf_free ( struct ebpf_btf *btf )
+{
+  free ( btf->types );
+  free ( btf->data );
+  memset ( btf, 0, sizeof ( *btf ) );
+}
+
+int
+ebpf_iter_attach ( int prog )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.link_create.prog_fd = prog;
+  attr.link_create.attach_type = BPF_TRACE_ITER;
+
+  int fd = sys_bpf ( BPF_LINK_CREATE, &attr );
+  if ( fd == -1 )
+    {
+      ERROR_DEBUG ( "Error attach iterator: %s", strerror ( errno ) );
+    }
+
+  return fd;
+}
+
+int
+ebpf_iter_create ( int link )
+{
+  union bpf_attr attr;
+
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.iter_create.link_fd = link;
+
+  int fd = sys_bpf ( BPF_ITER_CREATE, &attr );
+  if ( fd == -1 )
+    {
+      ERROR_DEBUG ( "Error create iterator: %s", strerror ( errno ) );
+    }
+
+  return fd;
+}
+
+int
+ebpf_xdp_attach ( int prog, unsigned int ifindex )
+{
+  union bpf_attr attr;
+
+  // without flags, the kernel choose native mode or generic (skb)
+  memset ( &attr, 0, sizeof ( attr ) );
+  attr.link_create.prog_fd = prog;
+  attr.link_create.target_ifindex = ifindex;
+  attr.link_create.attach_type = BPF_XDP;
+
+  int fd = sys_bpf ( BPF_LINK_CREATE, &attr );
+  if ( fd == -1 )
+    {
+      ERROR_DEBUG ( "Error attach XDP: %s", strerror ( errno ) );
+    }
+
+  return fd;
+}
+
+// reference
+// https://www.kernel.org/doc/html/latest/bpf/ringbuf.html
+bool
+ebpf_ringbuf_init ( struct ebpf_ringbuf *rb, size_t size )
+{
+  long page_size = sysconf ( _SC_PAGESIZE );
+
+  rb->consumer_pos = MAP_FAILED;
+  rb->producer_pos = MAP_FAILED;
+  rb->size = size;
+
+  rb->fd = ebpf_map_create ( BPF_MAP_TYPE_RINGBUF, 0, 0, size );
+  if ( rb->fd == -1 )
+    return false;
+
+  // first page, writable, is position of consumer
+  rb->consumer_pos = mmap (
+          NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, rb->fd, 0 );
+  if ( rb->consumer_pos == MAP_FAILED )
+    goto ERROR_EXIT;
+
+  // second page is position of producer followed by data, the data are
+  // mapped two times in sequence, so a record never wraps
+  rb->producer_pos = mmap ( NULL,
+                            page_size + 2 * size,
+                            PROT_READ,
+                            MAP_SHARED,
+                            rb->fd,
+                            page_size );
+  if ( rb->producer_pos == MAP_FAILED )
+    goto ERROR_EXIT;
+
+  rb->data = ( uint8_t * ) rb->producer_pos + page_size;
+
+  return true;
+
+ERROR_EXIT:
+  ERROR_DEBUG ( "Error map ringbuf: %s", strerror ( errno ) );
+  ebpf_ringbuf_free ( rb );
+  return false;
+}
+
+size_t
+ebpf_ringbuf_consume ( struct ebpf_ringbuf *rb,
+                       ebpf_ringbuf_cb func,
+                       void *user_data )
+{
+  size_t total = 0;
+  unsigned long cons = __atomic_load_n ( rb->consumer_pos, __ATOMIC_ACQUIRE );
+  unsigned long prod = __atomic_load_n ( rb->producer_pos, __ATOMIC_ACQUIRE );
+
+  while ( cons < prod )
+    {
+      uint32_t *hdr = ( uint32_t * ) ( rb->data + ( cons & ( rb->size - 1 ) ) );
+      uint32_t len = __atomic_load_n ( hdr, __ATOMIC_ACQUIRE );
+
+      // record not yet commited
+      if ( len & BPF_RINGBUF_BUSY_BIT )
+        break;
+
+      cons += ( ( len & ~BPF_RINGBUF_DISCARD_BIT ) + BPF_RINGBUF_HDR_SZ + 7 ) &
+              ~7UL;
+
+      if ( !( len & BPF_RINGBUF_DISCARD_BIT ) )
+        {
+          func ( ( uint8_t * ) hdr + BPF_RINGBUF_HDR_SZ, len, user_data );
+          total++;
+        }
+
+      __atomic_store_n ( rb->consumer_pos, cons, __ATOMIC_RELEASE );
+    }
+
+  return total;
+}
+
+void
+ebpf_ringbuf_free ( struct ebpf_ringbuf *rb )
+{
+  long page_size = sysconf ( _SC_PAGESIZE );
+
+  if ( rb->producer_pos != MAP_FAILED )
+    munmap ( rb->producer_pos, page_size + 2 * rb->size );
+
+  if ( rb->consumer_pos != MAP_FAILED )
+    munmap ( rb->consumer_pos, page_size );
+
+  if ( rb->fd != -1 )
+    close ( rb->fd );
+
+  rb->producer_pos = rb->consumer_pos = MAP_FAILED;
+  rb->fd = -1;
+}
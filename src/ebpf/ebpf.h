@@ -0,0 +1,205 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EBPF_H
+#define EBPF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>     // size_t
+#include <linux/bpf.h>  // enum bpf_map_type, struct bpf_insn
+#include <linux/btf.h>  // struct btf_type
+
+#include "bpf_insn.h"
+
+/* minimal wrappers to syscall bpf(2) and a builder to programs eBPF written
+   instruction by instruction, so netproc not depend of libbpf */
+
+#define EBPF_MAX_INSNS 512
+#define EBPF_MAX_LABELS 16
+#define EBPF_MAX_FIXUPS 128
+
+struct ebpf_prog
+{
+  struct bpf_insn insns[EBPF_MAX_INSNS];
+  unsigned int len;
+
+  int labels[EBPF_MAX_LABELS];  // index of instruction, -1 not defined
+  struct
+  {
+    unsigned int insn;
+    unsigned int label;
+  } fixups[EBPF_MAX_FIXUPS];
+  unsigned int total_fixups;
+
+  bool overflow;
+};
+
+// append instructions, ex: EBPF_EMIT ( prog, EBPF_MOV64_IMM ( BPF_REG_0, 0 ) )
+#define EBPF_EMIT( PROG, ... )                                  \
+  ebpf_emit ( PROG,                                             \
+              ( const struct bpf_insn[] ){ __VA_ARGS__ },       \
+              sizeof ( ( const struct bpf_insn[] ){ __VA_ARGS__ } ) / \
+                      sizeof ( struct bpf_insn ) )
+
+void
+ebpf_prog_init ( struct ebpf_prog *prog );
+
+void
+ebpf_emit ( struct ebpf_prog *prog,
+            const struct bpf_insn *insns,
+            size_t len );
+
+// append a jump instruction to 'label', field off is set by ebpf_prog_resolve
+void
+ebpf_emit_jmp ( struct ebpf_prog *prog,
+                struct bpf_insn insn,
+                unsigned int label );
+
+// define 'label' in current position of program
+void
+ebpf_label ( struct ebpf_prog *prog, unsigned int label );
+
+// set offset of all jumps to labels, return false on error
+bool
+ebpf_prog_resolve ( struct ebpf_prog *prog );
+
+// return file descriptor of program or -1 on failure
+int
+ebpf_prog_load ( enum bpf_prog_type type,
+                 const struct ebpf_prog *prog,
+                 uint32_t expected_attach_type );
+
+/* same of ebpf_prog_load, to programs of type BPF_PROG_TYPE_TRACING that
+   are attached to a function of kernel, 'attach_btf_id' is id of function
+   in BTF of kernel (see ebpf_btf_find) */
+int
+ebpf_prog_load_btf ( enum bpf_prog_type type,
+                     const struct ebpf_prog *prog,
+                     uint32_t expected_attach_type,
+                     uint32_t attach_btf_id );
+
+// return file descriptor of map or -1 on failure
+int
+ebpf_map_create ( enum bpf_map_type type,
+                  uint32_t key_size,
+                  uint32_t value_size,
+                  uint32_t max_entries );
+
+// functions below return 0 on success or -1 on failure (errno is set)
+int
+ebpf_map_lookup ( int fd, const void *key, void *value );
+
+int
+ebpf_map_update ( int fd, const void *key, const void *value, uint64_t flags );
+
+int
+ebpf_map_delete ( int fd, const void *key );
+
+// get key next to 'key', if 'key' is NULL get first key
+int
+ebpf_map_next_key ( int fd, const void *key, void *next_key );
+
+// total of possibles CPUs, used to size values of maps per-cpu.
+// return 0 on failure
+unsigned int
+ebpf_possible_cpus ( void );
+
+// raise limit of locked memory, used by maps in kernels older that 5.11
+void
+ebpf_rlimit ( void );
+
+// attach program type BPF_PROG_TYPE_KPROBE in function 'func' of kernel,
+// return file descriptor of perf event or -1 on failure
+int
+ebpf_attach_kprobe ( int prog, const char *func, bool retprobe );
+
+/* types of kernel (/sys/kernel/btf/vmlinux), with ids of functions to
+   programs of tracing and offsets of fields of structs, that change
+   between versions and configs of kernel */
+struct ebpf_btf
+{
+  uint8_t *data;
+  const struct btf_type **types;  // index is id of type, 0 is void
+  const char *strings;
+  uint32_t total_types;
+  uint32_t str_len;
+};
+
+bool
+ebpf_btf_load ( struct ebpf_btf *btf );
+
+// id of type 'name' of 'kind' (BTF_KIND_*), 0 if not found
+uint32_t
+ebpf_btf_find ( const struct ebpf_btf *btf,
+                const char *name,
+                unsigned int kind );
+
+/* offset in bytes of 'member' of struct 'name', also of members in unions
+   and structs anonymous. return -1 if not found or is a bitfield */
+int
+ebpf_btf_member_offset ( const struct ebpf_btf *btf,
+                         const char *name,
+                         const char *member );
+
+void
+ebpf_btf_free ( struct ebpf_btf *btf );
+
+// attach program with attach type BPF_TRACE_ITER, return fd of link or -1
+int
+ebpf_iter_attach ( int prog );
+
+// new instance of iterator, each read of fd run the program until the end,
+// return fd or -1 on failure
+int
+ebpf_iter_create ( int link );
+
+/* attach program of type BPF_PROG_TYPE_XDP to interface, the program is
+   detached when fd of link is closed. return fd of link or -1 */
+int
+ebpf_xdp_attach ( int prog, unsigned int ifindex );
+
+// consumer of map type BPF_MAP_TYPE_RINGBUF
+struct ebpf_ringbuf
+{
+  int fd;
+  unsigned long *consumer_pos;
+  unsigned long *producer_pos;
+  uint8_t *data;
+  size_t size;  // power-of-two multiple of page size
+};
+
+typedef void ( *ebpf_ringbuf_cb ) ( const void *data,
+                                    uint32_t len,
+                                    void *user_data );
+
+bool
+ebpf_ringbuf_init ( struct ebpf_ringbuf *rb, size_t size );
+
+// call 'func' to each record available, return total of records read
+size_t
+ebpf_ringbuf_consume ( struct ebpf_ringbuf *rb,
+                       ebpf_ringbuf_cb func,
+                       void *user_data );
+
+void
+ebpf_ringbuf_free ( struct ebpf_ringbuf *rb );
+
+#endif  // EBPF_H
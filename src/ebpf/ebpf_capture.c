@@ -0,0 +1,516 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>  // calloc
+#include <stddef.h>  // offsetof
+#include <string.h>  // memset
+#include <unistd.h>  // close
+#include <arpa/inet.h>        // htonl
+#include <netinet/in.h>       // IPPROTO_*
+#include <linux/filter.h>     // SKF_NET_OFF
+#include <linux/if_packet.h>  // PACKET_HOST, PACKET_OUTGOING
+#include <sys/socket.h>       // setsockopt
+
+#include "ebpf.h"
+#include "ebpf_capture.h"
+#include "../sock.h"
+#include "../packet.h"
+#include "../flow_acc.h"
+#include "../m_error.h"
+#include "../macro_util.h"
+
+// max flows counted between two refresh, in each map
+#define FLOW_MAP_ENTRIES 65536
+
+// key of maps, filled by program eBPF, fields in host byte order
+struct flow_key
+{
+  uint32_t saddr[4];  // ipv4 use only first word
+  uint32_t daddr[4];
+  uint16_t sport;
+  uint16_t dport;
+  uint32_t ifindex;
+  uint8_t protocol;
+  uint8_t pkt_type;  // PACKET_HOST or PACKET_OUTGOING
+  uint8_t family;    // AF_INET or AF_INET6
+  uint8_t pad[5];    // keep zeroed, is part of key
+};
+
+struct flow_value
+{
+  uint64_t bytes;
+  uint64_t packets;
+};
+
+struct ebpf_capture
+{
+  // two maps of counters (per-cpu), the program write in map selected by
+  // map_sel while netproc read and clear the other
+  int maps[2];
+  int map_sel;
+  uint32_t selector;
+
+  int prog;
+  int socks[MAX_IFACES];  // a socket by interface, same program
+  unsigned int total_socks;
+
+  unsigned int cpus;
+  struct flow_value *values;  // one value by cpu
+
+  // counters of all cpus, folded in statistics as of capture workers
+  struct flow_acc acc;
+};
+
+// offsets in stack of program
+#define KEY_OFF ( -( int ) sizeof ( struct flow_key ) )
+#define VALUE_OFF ( KEY_OFF - ( int ) sizeof ( struct flow_value ) )
+#define SEL_OFF ( VALUE_OFF - ( int ) sizeof ( uint32_t ) )
+#define KEY_FIELD( F ) ( KEY_OFF + ( int ) offsetof ( struct flow_key, F ) )
+
+#define SKB_FIELD( F ) ( ( int ) offsetof ( struct __sk_buff, F ) )
+
+// labels of program
+enum
+{
+  L_DROP,
+  L_PKT_TYPE,
+  L_PROTO,
+  L_IPV6,
+  L_PROTO6,
+  L_SADDR6,
+  L_DADDR6,
+  L_PORTS,
+  L_MAP_B,
+  L_NEW_A,
+  L_NEW_B
+};
+
+// increment counters of flow (key in stack) in map, create if not exist
+static void
+emit_count ( struct ebpf_prog *p, int map, unsigned int label_new )
+{
+  EBPF_EMIT ( p,
+              EBPF_LD_MAP_FD ( BPF_REG_1, map ),
+              EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, KEY_OFF ),
+              EBPF_CALL ( BPF_FUNC_map_lookup_elem ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 0, 0 ), label_new );
+
+  // map per-cpu, not need atomic operations
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_W, BPF_REG_1, BPF_REG_6, SKB_FIELD ( len ) ),
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_2, BPF_REG_0, 0 ),
+              EBPF_ALU64_REG ( BPF_ADD, BPF_REG_2, BPF_REG_1 ),
+              EBPF_STX_MEM ( BPF_DW, BPF_REG_0, BPF_REG_2, 0 ),
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_2, BPF_REG_0, 8 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, 1 ),
+              EBPF_STX_MEM ( BPF_DW, BPF_REG_0, BPF_REG_2, 8 ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_A ( 0 ), L_DROP );
+
+  // new flow
+  ebpf_label ( p, label_new );
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_W, BPF_REG_1, BPF_REG_6, SKB_FIELD ( len ) ),
+              EBPF_STX_MEM ( BPF_DW, BPF_REG_10, BPF_REG_1, VALUE_OFF ),
+              EBPF_ST_MEM ( BPF_DW, BPF_REG_10, VALUE_OFF + 8, 1 ),
+              EBPF_LD_MAP_FD ( BPF_REG_1, map ),
+              EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, KEY_OFF ),
+              EBPF_MOV64_REG ( BPF_REG_3, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_3, VALUE_OFF ),
+              EBPF_MOV64_IMM ( BPF_REG_4, BPF_NOEXIST ),
+              EBPF_CALL ( BPF_FUNC_map_update_elem ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_A ( 0 ), L_DROP );
+}
+
+// same rules of classic filter (filter.c): only tcp/udp, not network
+// 127.0.0.0/8 and not ::1
+
+// protocol in r0, store in key if it's selected
+static void
+emit_proto ( struct ebpf_prog *p, int proto, unsigned int label )
+{
+  switch ( proto )
+    {
+      case TCP:
+        ebpf_emit_jmp (
+                p,
+                EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, IPPROTO_TCP, 0 ),
+                L_DROP );
+        break;
+      case UDP:
+        ebpf_emit_jmp (
+                p,
+                EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, IPPROTO_UDP, 0 ),
+                L_DROP );
+        break;
+      default:
+        ebpf_emit_jmp (
+                p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, IPPROTO_TCP, 0 ), label );
+        ebpf_emit_jmp (
+                p,
+                EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, IPPROTO_UDP, 0 ),
+                L_DROP );
+    }
+
+  ebpf_label ( p, label );
+  EBPF_EMIT ( p,
+              EBPF_STX_MEM (
+                      BPF_B, BPF_REG_10, BPF_REG_0, KEY_FIELD ( protocol ) ) );
+}
+
+static void
+emit_address ( struct ebpf_prog *p, int off_packet, int off_key )
+{
+  EBPF_EMIT ( p,
+              EBPF_LD_ABS ( BPF_W, SKF_NET_OFF + off_packet ),
+              EBPF_STX_MEM ( BPF_W, BPF_REG_10, BPF_REG_0, off_key ),
+              EBPF_ALU64_IMM ( BPF_RSH, BPF_REG_0, 24 ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 127, 0 ), L_DROP );
+}
+
+// r8 = or of three first words, ::1 has this zero and last word is 1
+static void
+emit_address6 ( struct ebpf_prog *p,
+                int off_packet,
+                int off_key,
+                unsigned int label )
+{
+  EBPF_EMIT ( p, EBPF_MOV64_IMM ( BPF_REG_8, 0 ) );
+
+  for ( int i = 0; i < 4; i++ )
+    {
+      EBPF_EMIT ( p,
+                  EBPF_LD_ABS ( BPF_W, SKF_NET_OFF + off_packet + i * 4 ),
+                  EBPF_STX_MEM (
+                          BPF_W, BPF_REG_10, BPF_REG_0, off_key + i * 4 ) );
+
+      if ( i < 3 )
+        EBPF_EMIT ( p, EBPF_ALU64_REG ( BPF_OR, BPF_REG_8, BPF_REG_0 ) );
+    }
+
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_8, 0, 0 ), label );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 1, 0 ), L_DROP );
+  ebpf_label ( p, label );
+}
+
+static bool
+build_prog ( struct ebpf_prog *p, const struct ebpf_capture *ec, int proto )
+{
+  ebpf_prog_init ( p );
+
+  // r6 = skb, required by instructions LD_ABS/LD_IND
+  EBPF_EMIT ( p, EBPF_MOV64_REG ( BPF_REG_6, BPF_REG_1 ) );
+
+  for ( int i = 0; i < ( int ) sizeof ( struct flow_key ); i += 8 )
+    EBPF_EMIT ( p, EBPF_ST_MEM ( BPF_DW, BPF_REG_10, KEY_OFF + i, 0 ) );
+
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM (
+                      BPF_W, BPF_REG_0, BPF_REG_6, SKB_FIELD ( pkt_type ) ) );
+
+  // only packets to this host or sent by this host
+  ebpf_emit_jmp (
+          p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, PACKET_HOST, 0 ), L_PKT_TYPE );
+  ebpf_emit_jmp (
+          p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, PACKET_OUTGOING, 0 ), L_DROP );
+
+  ebpf_label ( p, L_PKT_TYPE );
+  EBPF_EMIT ( p,
+              EBPF_STX_MEM (
+                      BPF_B, BPF_REG_10, BPF_REG_0, KEY_FIELD ( pkt_type ) ),
+              EBPF_LDX_MEM (
+                      BPF_W, BPF_REG_0, BPF_REG_6, SKB_FIELD ( ifindex ) ),
+              EBPF_STX_MEM (
+                      BPF_W, BPF_REG_10, BPF_REG_0, KEY_FIELD ( ifindex ) ),
+              EBPF_LD_ABS ( BPF_B, SKF_NET_OFF ),
+              EBPF_MOV64_REG ( BPF_REG_7, BPF_REG_0 ),
+              EBPF_ALU64_IMM ( BPF_AND, BPF_REG_0, 0xf0 ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 0x60, 0 ), L_IPV6 );
+
+  // ipv4
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, 0x40, 0 ), L_DROP );
+
+  // r7 = size of header ip, offset of layer 4
+  EBPF_EMIT ( p,
+              EBPF_ALU64_IMM ( BPF_AND, BPF_REG_7, 0x0f ),
+              EBPF_ALU64_IMM ( BPF_LSH, BPF_REG_7, 2 ),
+              EBPF_LD_ABS ( BPF_H, SKF_NET_OFF + 6 ),
+              EBPF_ALU64_IMM ( BPF_AND, BPF_REG_0, 0x1fff ) );
+
+  // fragments (with the exception of first) do not have header of layer 4
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, 0, 0 ), L_DROP );
+
+  EBPF_EMIT ( p, EBPF_LD_ABS ( BPF_B, SKF_NET_OFF + 9 ) );
+  emit_proto ( p, proto, L_PROTO );
+
+  EBPF_EMIT (
+          p, EBPF_ST_MEM ( BPF_B, BPF_REG_10, KEY_FIELD ( family ), AF_INET ) );
+
+  emit_address ( p, 12, KEY_FIELD ( saddr ) );
+  emit_address ( p, 16, KEY_FIELD ( daddr ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_A ( 0 ), L_PORTS );
+
+  // ipv6, extension headers are not followed, layer 4 is after header
+  ebpf_label ( p, L_IPV6 );
+  EBPF_EMIT ( p,
+              EBPF_MOV64_IMM ( BPF_REG_7, 40 ),
+              EBPF_LD_ABS ( BPF_B, SKF_NET_OFF + 6 ) );
+  emit_proto ( p, proto, L_PROTO6 );
+
+  EBPF_EMIT (
+          p,
+          EBPF_ST_MEM ( BPF_B, BPF_REG_10, KEY_FIELD ( family ), AF_INET6 ) );
+
+  emit_address6 ( p, 8, KEY_FIELD ( saddr ), L_SADDR6 );
+  emit_address6 ( p, 24, KEY_FIELD ( daddr ), L_DADDR6 );
+
+  ebpf_label ( p, L_PORTS );
+
+  // ports, same offset to tcp and udp
+  EBPF_EMIT ( p,
+              EBPF_LD_IND ( BPF_H, BPF_REG_7, SKF_NET_OFF ),
+              EBPF_STX_MEM (
+                      BPF_H, BPF_REG_10, BPF_REG_0, KEY_FIELD ( sport ) ),
+              EBPF_LD_IND ( BPF_H, BPF_REG_7, SKF_NET_OFF + 2 ),
+              EBPF_STX_MEM (
+                      BPF_H, BPF_REG_10, BPF_REG_0, KEY_FIELD ( dport ) ) );
+
+  // get map selected
+  EBPF_EMIT ( p,
+              EBPF_ST_MEM ( BPF_W, BPF_REG_10, SEL_OFF, 0 ),
+              EBPF_LD_MAP_FD ( BPF_REG_1, ec->map_sel ),
+              EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, SEL_OFF ),
+              EBPF_CALL ( BPF_FUNC_map_lookup_elem ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 0, 0 ), L_DROP );
+  EBPF_EMIT ( p, EBPF_LDX_MEM ( BPF_W, BPF_REG_0, BPF_REG_0, 0 ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, 0, 0 ), L_MAP_B );
+
+  emit_count ( p, ec->maps[0], L_NEW_A );
+
+  ebpf_label ( p, L_MAP_B );
+  emit_count ( p, ec->maps[1], L_NEW_B );
+
+  // packet never is delivered to socket
+  ebpf_label ( p, L_DROP );
+  EBPF_EMIT ( p, EBPF_MOV64_IMM ( BPF_REG_0, 0 ), EBPF_EXIT () );
+
+  return ebpf_prog_resolve ( p );
+}
+
+static void
+flow_to_packet ( struct packet *pkt, const struct flow_key *key )
+{
+  pkt->if_index = key->ifindex;
+  pkt->tuple.l4.protocol = key->protocol;
+  pkt->tuple.family = key->family;
+
+  // words of address are in host byte order, words not used are zero
+  union inet_all *local, *remote;
+  if ( key->pkt_type == PACKET_OUTGOING )
+    {
+      pkt->direction = PKT_UPL;
+      local = &pkt->tuple.l3.local;
+      remote = &pkt->tuple.l3.remote;
+      pkt->tuple.l4.local_port = key->sport;
+      pkt->tuple.l4.remote_port = key->dport;
+    }
+  else
+    {
+      pkt->direction = PKT_DOWN;
+      local = &pkt->tuple.l3.remote;
+      remote = &pkt->tuple.l3.local;
+      pkt->tuple.l4.local_port = key->dport;
+      pkt->tuple.l4.remote_port = key->sport;
+    }
+
+  for ( size_t i = 0; i < ARRAY_SIZE ( key->saddr ); i++ )
+    {
+      local->all[i] = htonl ( key->saddr[i] );
+      remote->all[i] = htonl ( key->daddr[i] );
+    }
+}
+
+struct ebpf_capture *
+ebpf_capture_init ( const struct config_op *co )
+{
+  struct ebpf_capture *ec = malloc ( sizeof *ec );
+  if ( !ec )
+    return NULL;
+
+  ec->maps[0] = ec->maps[1] = ec->map_sel = -1;
+  ec->prog = -1;
+  ec->total_socks = 0;
+  ec->selector = 0;
+  ec->values = NULL;
+  ec->acc.slots = NULL;
+
+  ebpf_rlimit ();
+
+  if ( !( ec->cpus = ebpf_possible_cpus () ) )
+    goto ERROR_EXIT;
+
+  ec->values = calloc ( ec->cpus, sizeof ( *ec->values ) );
+  if ( !ec->values )
+    goto ERROR_EXIT;
+
+  if ( !flow_acc_init ( &ec->acc ) )
+    goto ERROR_EXIT;
+
+  for ( size_t i = 0; i < 2; i++ )
+    {
+      ec->maps[i] = ebpf_map_create ( BPF_MAP_TYPE_PERCPU_HASH,
+                                      sizeof ( struct flow_key ),
+                                      sizeof ( struct flow_value ),
+                                      FLOW_MAP_ENTRIES );
+      if ( ec->maps[i] == -1 )
+        goto ERROR_EXIT;
+    }
+
+  ec->map_sel = ebpf_map_create (
+          BPF_MAP_TYPE_ARRAY, sizeof ( uint32_t ), sizeof ( uint32_t ), 1 );
+  if ( ec->map_sel == -1 )
+    goto ERROR_EXIT;
+
+  struct ebpf_prog *prog = malloc ( sizeof *prog );
+  if ( !prog )
+    goto ERROR_EXIT;
+
+  if ( !build_prog ( prog, ec, co->proto ) )
+    {
+      ERROR_DEBUG ( "%s", "Error build program ebpf" );
+      free ( prog );
+      goto ERROR_EXIT;
+    }
+
+  ec->prog = ebpf_prog_load ( BPF_PROG_TYPE_SOCKET_FILTER, prog, 0 );
+  free ( prog );
+  if ( ec->prog == -1 )
+    goto ERROR_EXIT;
+
+  for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+    {
+      // program find the layer 3 by offset of kernel, of any link
+      enum link_type link;
+      int sock = socket_init ( co->ifaces[i], &link );
+      if ( sock == -1 )
+        goto ERROR_EXIT;
+
+      ec->socks[ec->total_socks++] = sock;
+
+      if ( setsockopt ( sock,
+                        SOL_SOCKET,
+                        SO_ATTACH_BPF,
+                        &ec->prog,
+                        sizeof ( ec->prog ) ) == -1 )
+        {
+          ERROR_DEBUG ( "Error attach program ebpf: %s", strerror ( errno ) );
+          goto ERROR_EXIT;
+        }
+    }
+
+  return ec;
+
+ERROR_EXIT:
+  ebpf_capture_free ( ec );
+  return NULL;
+}
+
+bool
+ebpf_capture_merge ( struct ebpf_capture *ec,
+                     bool view_conections,
+                     uint32_t tstamp )
+{
+  uint32_t key_sel = 0;
+  uint32_t old = ec->selector;
+
+  // program eBPF start to write in other map
+  ec->selector = !old;
+  if ( ebpf_map_update ( ec->map_sel, &key_sel, &ec->selector, BPF_ANY ) == -1 )
+    {
+      ERROR_DEBUG ( "Error update selector: %s", strerror ( errno ) );
+      ec->selector = old;
+      return false;
+    }
+
+  int map = ec->maps[old];
+  struct flow_key key, next_key;
+
+  bool has_key = ( ebpf_map_next_key ( map, NULL, &key ) == 0 );
+  while ( has_key )
+    {
+      // get next key before delete the current
+      has_key = ( ebpf_map_next_key ( map, &key, &next_key ) == 0 );
+
+      if ( ebpf_map_lookup ( map, &key, ec->values ) == 0 )
+        {
+          struct flow_value total = { 0 };
+          for ( size_t i = 0; i < ec->cpus; i++ )
+            {
+              total.bytes += ec->values[i].bytes;
+              total.packets += ec->values[i].packets;
+            }
+
+          struct packet pkt = { .tstamp = tstamp };
+          flow_to_packet ( &pkt, &key );
+
+          if ( total.packets )
+            flow_acc_add ( &ec->acc, &pkt, total.bytes, total.packets );
+        }
+
+      ebpf_map_delete ( map, &key );
+      key = next_key;
+    }
+
+  return flow_acc_merge ( &ec->acc, view_conections );
+}
+
+void
+ebpf_capture_free ( struct ebpf_capture *ec )
+{
+  if ( !ec )
+    return;
+
+  for ( unsigned int i = 0; i < ec->total_socks; i++ )
+    socket_free ( ec->socks[i] );
+
+  if ( ec->prog != -1 )
+    close ( ec->prog );
+
+  if ( ec->map_sel != -1 )
+    close ( ec->map_sel );
+
+  for ( size_t i = 0; i < 2; i++ )
+    {
+      if ( ec->maps[i] != -1 )
+        close ( ec->maps[i] );
+    }
+
+  flow_acc_free ( &ec->acc );
+  free ( ec->values );
+  free ( ec );
+}
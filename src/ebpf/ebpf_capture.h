@@ -0,0 +1,52 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EBPF_CAPTURE_H
+#define EBPF_CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../config.h"
+
+/* capture backend that count bytes and packets by flow in kernel, with
+   a program eBPF attached as filter of a packet socket. the program always
+   return 0, so no packet is copied to user space, and netproc only read the
+   maps of counters in each refresh.
+   requires a kernel with support to eBPF (4.x or newer), if not supported
+   ebpf_capture_init fail and ring buffer must be used */
+
+struct ebpf_capture;
+
+struct ebpf_capture *
+ebpf_capture_init ( const struct config_op *co );
+
+/* merge counters of kernel in statistics of processes/connections, the
+   kernel not report time of packets, so all counters are in tick 'tstamp'.
+   return true if any flow not was found (need update of processes) */
+bool
+ebpf_capture_merge ( struct ebpf_capture *ec,
+                     bool view_conections,
+                     uint32_t tstamp );
+
+void
+ebpf_capture_free ( struct ebpf_capture *ec );
+
+#endif  // EBPF_CAPTURE_H
@@ -0,0 +1,294 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>      // malloc
+#include <string.h>      // memset
+#include <errno.h>
+#include <unistd.h>      // read
+#include <sys/socket.h>  // socket
+#include <sys/stat.h>    // S_IFSOCK
+
+#include "ebpf.h"
+#include "ebpf_fds.h"
+#include "../m_error.h"
+
+// initial size of buffer of sockets, grow as needed
+#define FDS_INIT_SIZE 1024
+
+/* context of program, struct bpf_iter__task_file of kernel, pointers are
+   of 64 bits in all architectures
+   https://elixir.bootlin.com/linux/latest/source/kernel/bpf/task_iter.c */
+#define CTX_META 0
+#define CTX_TASK 8
+#define CTX_FD 16
+#define CTX_FILE 24
+
+// seq_file to bpf_seq_write, first field of struct bpf_iter_meta
+#define META_SEQ 0
+
+struct ebpf_fds
+{
+  struct sock_fd *fds;
+  size_t size;  // capacity of fds
+
+  int prog;
+  int link;
+};
+
+// offsets in kernel of fields used by program
+struct offsets
+{
+  int tgid;     // task_struct.tgid
+  int f_inode;  // file.f_inode
+  int i_mode;   // inode.i_mode
+  int i_ino;    // inode.i_ino
+};
+
+#define REC_OFF ( -( int ) sizeof ( struct sock_fd ) )
+
+enum
+{
+  L_EXIT
+};
+
+static bool
+build_prog ( struct ebpf_prog *p, const struct offsets *off )
+{
+  ebpf_prog_init ( p );
+
+  // task and file are NULL in last call of iterator
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_6, BPF_REG_1, CTX_META ),
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_7, BPF_REG_1, CTX_TASK ),
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_8, BPF_REG_1, CTX_FILE ),
+              EBPF_LDX_MEM ( BPF_W, BPF_REG_9, BPF_REG_1, CTX_FD ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_7, 0, 0 ), L_EXIT );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_8, 0, 0 ), L_EXIT );
+
+  // only sockets
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_8, BPF_REG_8, off->f_inode ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_8, 0, 0 ), L_EXIT );
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_H, BPF_REG_0, BPF_REG_8, off->i_mode ),
+              EBPF_ALU64_IMM ( BPF_AND, BPF_REG_0, S_IFMT ) );
+  ebpf_emit_jmp (
+          p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, S_IFSOCK, 0 ), L_EXIT );
+
+  // record in stack, same layout of struct sock_fd
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_W, BPF_REG_0, BPF_REG_7, off->tgid ),
+              EBPF_STX_MEM ( BPF_W, BPF_REG_10, BPF_REG_0, REC_OFF ),
+              EBPF_STX_MEM ( BPF_W, BPF_REG_10, BPF_REG_9, REC_OFF + 4 ),
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_0, BPF_REG_8, off->i_ino ),
+              EBPF_STX_MEM ( BPF_DW, BPF_REG_10, BPF_REG_0, REC_OFF + 8 ),
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_1, BPF_REG_6, META_SEQ ),
+              EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, REC_OFF ),
+              EBPF_MOV64_IMM ( BPF_REG_3, sizeof ( struct sock_fd ) ),
+              EBPF_CALL ( BPF_FUNC_seq_write ) );
+
+  ebpf_label ( p, L_EXIT );
+  EBPF_EMIT ( p, EBPF_MOV64_IMM ( BPF_REG_0, 0 ), EBPF_EXIT () );
+
+  return ebpf_prog_resolve ( p );
+}
+
+static bool
+get_offsets ( struct offsets *off, uint32_t *btf_id )
+{
+  struct ebpf_btf btf;
+
+  if ( !ebpf_btf_load ( &btf ) )
+    return false;
+
+  *btf_id = ebpf_btf_find ( &btf, "bpf_iter_task_file", BTF_KIND_FUNC );
+  off->tgid = ebpf_btf_member_offset ( &btf, "task_struct", "tgid" );
+  off->f_inode = ebpf_btf_member_offset ( &btf, "file", "f_inode" );
+  off->i_mode = ebpf_btf_member_offset ( &btf, "inode", "i_mode" );
+  off->i_ino = ebpf_btf_member_offset ( &btf, "inode", "i_ino" );
+
+  ebpf_btf_free ( &btf );
+
+  if ( !*btf_id || off->tgid == -1 || off->f_inode == -1 ||
+       off->i_mode == -1 || off->i_ino == -1 )
+    {
+      ERROR_DEBUG ( "%s", "Iterator task_file not found in BTF of kernel" );
+      return false;
+    }
+
+  return true;
+}
+
+/* pid of kernel is of initial namespace of pids, so sockets of netproc
+   must be found with your own pid */
+static bool
+check_self ( struct ebpf_fds *ef )
+{
+  int sock = socket ( AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0 );
+  if ( sock == -1 )
+    return false;
+
+  struct stat st;
+  bool found = false;
+  ssize_t total = -1;
+
+  if ( fstat ( sock, &st ) == 0 )
+    total = ebpf_fds_read ( ef );
+
+  pid_t pid = getpid ();
+  for ( ssize_t i = 0; i < total && !found; i++ )
+    found = ef->fds[i].pid == ( uint32_t ) pid &&
+            ef->fds[i].fd == ( uint32_t ) sock &&
+            ef->fds[i].inode == st.st_ino;
+
+  close ( sock );
+
+  if ( !found )
+    {
+      ERROR_DEBUG ( "%s", "Own socket not found by iterator task_file" );
+    }
+
+  return found;
+}
+
+struct ebpf_fds *
+ebpf_fds_init ( void )
+{
+  struct offsets off;
+  uint32_t btf_id;
+
+  if ( !get_offsets ( &off, &btf_id ) )
+    return NULL;
+
+  struct ebpf_fds *ef = malloc ( sizeof *ef );
+  if ( !ef )
+    return NULL;
+
+  ef->prog = ef->link = -1;
+  ef->size = FDS_INIT_SIZE;
+  ef->fds = malloc ( ef->size * sizeof ( *ef->fds ) );
+  if ( !ef->fds )
+    goto ERROR_EXIT;
+
+  struct ebpf_prog *prog = malloc ( sizeof *prog );
+  if ( !prog )
+    goto ERROR_EXIT;
+
+  if ( !build_prog ( prog, &off ) )
+    {
+      ERROR_DEBUG ( "%s", "Error build program to iterator task_file" );
+      free ( prog );
+      goto ERROR_EXIT;
+    }
+
+  ebpf_rlimit ();
+
+  ef->prog = ebpf_prog_load_btf (
+          BPF_PROG_TYPE_TRACING, prog, BPF_TRACE_ITER, btf_id );
+  free ( prog );
+
+  if ( ef->prog == -1 )
+    goto ERROR_EXIT;
+
+  ef->link = ebpf_iter_attach ( ef->prog );
+  if ( ef->link == -1 )
+    goto ERROR_EXIT;
+
+  if ( !check_self ( ef ) )
+    goto ERROR_EXIT;
+
+  return ef;
+
+ERROR_EXIT:
+  ebpf_fds_free ( ef );
+  return NULL;
+}
+
+ssize_t
+ebpf_fds_read ( struct ebpf_fds *ef )
+{
+  int fd = ebpf_iter_create ( ef->link );
+  if ( fd == -1 )
+    return -1;
+
+  // kernel write only whole records
+  size_t total = 0;
+  while ( 1 )
+    {
+      if ( total == ef->size )
+        {
+          struct sock_fd *new_fds;
+          new_fds = realloc ( ef->fds,
+                              ( ef->size << 1 ) * sizeof ( *new_fds ) );
+          if ( !new_fds )
+            goto ERROR_EXIT;
+
+          ef->fds = new_fds;
+          ef->size <<= 1;
+        }
+
+      ssize_t ret = read ( fd,
+                           ef->fds + total,
+                           ( ef->size - total ) * sizeof ( *ef->fds ) );
+      if ( ret == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "Error read iterator: %s", strerror ( errno ) );
+          goto ERROR_EXIT;
+        }
+
+      if ( !ret )
+        break;
+
+      total += ret / sizeof ( *ef->fds );
+    }
+
+  close ( fd );
+  return total;
+
+ERROR_EXIT:
+  close ( fd );
+  return -1;
+}
+
+const struct sock_fd *
+ebpf_fds_get ( struct ebpf_fds *ef )
+{
+  return ef->fds;
+}
+
+void
+ebpf_fds_free ( struct ebpf_fds *ef )
+{
+  if ( !ef )
+    return;
+
+  if ( ef->link != -1 )
+    close ( ef->link );
+
+  if ( ef->prog != -1 )
+    close ( ef->prog );
+
+  free ( ef->fds );
+  free ( ef );
+}
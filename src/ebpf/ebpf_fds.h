@@ -0,0 +1,50 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EBPF_FDS_H
+#define EBPF_FDS_H
+
+#include <stddef.h>  // size_t
+
+#include "../processes.h"  // struct sock_fd
+
+/* source of sockets of all processes in a single pass, a program eBPF of
+   iterator task_file write the pid, fd and inode of each socket opened,
+   so processes_update_fds not need read /proc/<pid>/fd/ of all processes.
+   offsets of fields of kernel are read of BTF, requires kernel 5.8 or newer
+   with CONFIG_DEBUG_INFO_BTF */
+
+struct ebpf_fds;
+
+struct ebpf_fds *
+ebpf_fds_init ( void );
+
+/* run iterator, return total of sockets or -1 on failure.
+   sockets read are valid until next call */
+ssize_t
+ebpf_fds_read ( struct ebpf_fds *ef );
+
+const struct sock_fd *
+ebpf_fds_get ( struct ebpf_fds *ef );
+
+void
+ebpf_fds_free ( struct ebpf_fds *ef );
+
+#endif  // EBPF_FDS_H
@@ -0,0 +1,334 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>      // malloc
+#include <stddef.h>      // offsetof
+#include <string.h>      // memset
+#include <unistd.h>      // close
+#include <sys/socket.h>  // AF_INET
+#include <netinet/in.h>  // IPPROTO_*
+#include <arpa/inet.h>   // ntohs
+#include <asm/ptrace.h>  // struct pt_regs
+
+#include "ebpf.h"
+#include "ebpf_sock.h"
+#include "../vector.h"
+#include "../m_error.h"
+#include "../macro_util.h"
+
+// arguments of functions in kernel, user api of struct pt_regs has the
+// same layout of kernel
+#if defined( __x86_64__ )
+#define PT_REGS_PARM1 offsetof ( struct pt_regs, rdi )
+#define PT_REGS_RC offsetof ( struct pt_regs, rax )
+#elif defined( __aarch64__ )
+#define PT_REGS_PARM1 offsetof ( struct user_pt_regs, regs[0] )
+#define PT_REGS_RC offsetof ( struct user_pt_regs, regs[0] )
+#endif
+
+// size of ring buffer of events in bytes
+#define RINGBUF_SIZE ( 256 * 1024 )
+
+// max owners pending, others are discarded and found by scan of /proc
+#define MAX_OWNERS 4096
+
+// sockets udp already reported, udp_sendmsg is called in each packet sent
+#define UDP_SEEN_ENTRIES 8192
+
+/* event sent by kernel, first 18 bytes are copied of struct sock_common,
+   are stable offsets since linux 4.x
+   https://elixir.bootlin.com/linux/latest/source/include/net/sock.h */
+struct sock_event
+{
+  uint32_t daddr;     // skc_daddr, network byte order
+  uint32_t saddr;     // skc_rcv_saddr, network byte order
+  uint32_t hash;      // skc_hash, not used
+  uint16_t dport;     // skc_dport, network byte order
+  uint16_t sport;     // skc_num, host byte order
+  uint16_t family;    // skc_family
+  uint8_t protocol;   // IPPROTO_TCP or IPPROTO_UDP, set by program
+  uint8_t pad;
+  uint32_t pid;       // tgid
+  char comm[16];      // not used yet
+};
+
+#define SIZE_SOCK_COMMON 18
+
+struct ebpf_sock
+{
+  struct ebpf_ringbuf rb;
+  int udp_seen;
+
+  int progs[3];
+  int links[3];  // perf events of kprobes
+
+  struct sock_owner *owners;  // vector
+};
+
+// offsets in stack of program
+#define EV_OFF ( -( int ) sizeof ( struct sock_event ) )
+#define EV_FIELD( F ) ( EV_OFF + ( int ) offsetof ( struct sock_event, F ) )
+#define SK_OFF ( EV_OFF - 8 )     // pointer to struct sock, key of udp_seen
+#define SEEN_OFF ( SK_OFF - 8 )  // value to udp_seen
+
+enum
+{
+  L_EXIT
+};
+
+/* program to kprobe, 'regs_off' is offset in struct pt_regs of
+   pointer to struct sock ( argument or return of function ) */
+static bool
+build_prog ( struct ebpf_prog *p,
+             const struct ebpf_sock *es,
+             int regs_off,
+             int protocol )
+{
+  ebpf_prog_init ( p );
+
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_7, BPF_REG_1, regs_off ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_7, 0, 0 ), L_EXIT );
+
+  if ( protocol == IPPROTO_UDP )
+    {
+      // report only first packet sent by socket
+      EBPF_EMIT ( p,
+                  EBPF_STX_MEM ( BPF_DW, BPF_REG_10, BPF_REG_7, SK_OFF ),
+                  EBPF_LD_MAP_FD ( BPF_REG_1, es->udp_seen ),
+                  EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+                  EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, SK_OFF ),
+                  EBPF_CALL ( BPF_FUNC_map_lookup_elem ) );
+      ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, 0, 0 ), L_EXIT );
+    }
+
+  // zero event, all bytes are sent to user space
+  for ( int off = EV_OFF; off < 0; off += 8 )
+    EBPF_EMIT ( p, EBPF_ST_MEM ( BPF_DW, BPF_REG_10, off, 0 ) );
+
+  EBPF_EMIT ( p,
+              EBPF_MOV64_REG ( BPF_REG_1, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_1, EV_OFF ),
+              EBPF_MOV64_IMM ( BPF_REG_2, SIZE_SOCK_COMMON ),
+              EBPF_MOV64_REG ( BPF_REG_3, BPF_REG_7 ),
+              EBPF_CALL ( BPF_FUNC_probe_read_kernel ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, 0, 0 ), L_EXIT );
+
+  // only ipv4 and port already defined, owners of sockets ipv6 are found
+  // by scan of /proc
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM (
+                      BPF_H, BPF_REG_0, BPF_REG_10, EV_FIELD ( family ) ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JNE, BPF_REG_0, AF_INET, 0 ), L_EXIT );
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM (
+                      BPF_H, BPF_REG_0, BPF_REG_10, EV_FIELD ( sport ) ) );
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 0, 0 ), L_EXIT );
+
+  EBPF_EMIT ( p,
+              EBPF_ST_MEM (
+                      BPF_B, BPF_REG_10, EV_FIELD ( protocol ), protocol ),
+              EBPF_CALL ( BPF_FUNC_get_current_pid_tgid ),
+              EBPF_ALU64_IMM ( BPF_RSH, BPF_REG_0, 32 ),
+              EBPF_STX_MEM ( BPF_W, BPF_REG_10, BPF_REG_0, EV_FIELD ( pid ) ),
+              EBPF_MOV64_REG ( BPF_REG_1, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_1, EV_FIELD ( comm ) ),
+              EBPF_MOV64_IMM ( BPF_REG_2,
+                               SIZEOF_MEMBER ( struct sock_event, comm ) ),
+              EBPF_CALL ( BPF_FUNC_get_current_comm ) );
+
+  if ( protocol == IPPROTO_UDP )
+    {
+      EBPF_EMIT ( p,
+                  EBPF_ST_MEM ( BPF_DW, BPF_REG_10, SEEN_OFF, 1 ),
+                  EBPF_LD_MAP_FD ( BPF_REG_1, es->udp_seen ),
+                  EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+                  EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, SK_OFF ),
+                  EBPF_MOV64_REG ( BPF_REG_3, BPF_REG_10 ),
+                  EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_3, SEEN_OFF ),
+                  EBPF_MOV64_IMM ( BPF_REG_4, BPF_ANY ),
+                  EBPF_CALL ( BPF_FUNC_map_update_elem ) );
+    }
+
+  EBPF_EMIT ( p,
+              EBPF_LD_MAP_FD ( BPF_REG_1, es->rb.fd ),
+              EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, EV_OFF ),
+              EBPF_MOV64_IMM ( BPF_REG_3, sizeof ( struct sock_event ) ),
+              EBPF_MOV64_IMM ( BPF_REG_4, 0 ),
+              EBPF_CALL ( BPF_FUNC_ringbuf_output ) );
+
+  ebpf_label ( p, L_EXIT );
+  EBPF_EMIT ( p, EBPF_MOV64_IMM ( BPF_REG_0, 0 ), EBPF_EXIT () );
+
+  return ebpf_prog_resolve ( p );
+}
+
+static void
+handle_event ( const void *data, uint32_t len, void *user_data )
+{
+  struct ebpf_sock *es = user_data;
+  const struct sock_event *ev = data;
+
+  if ( len < sizeof ( *ev ) || vector_size ( es->owners ) >= MAX_OWNERS )
+    return;
+
+  struct sock_owner owner;
+  memset ( &owner, 0, sizeof ( owner ) );
+
+  // same format of struct tuple of connections and packets
+  owner.tuple.l3.local.ip = ev->saddr;
+  owner.tuple.l3.remote.ip = ev->daddr;
+  owner.tuple.l4.local_port = ev->sport;
+  owner.tuple.l4.remote_port = ntohs ( ev->dport );
+  owner.tuple.l4.protocol = ev->protocol;
+  owner.tuple.family = AF_INET;
+  owner.pid = ev->pid;
+
+  vector_push ( es->owners, &owner );
+}
+
+struct ebpf_sock *
+ebpf_sock_init ( void )
+{
+#ifndef PT_REGS_PARM1
+  ERROR_DEBUG ( "%s", "Architecture not supported" );
+  return NULL;
+#else
+  static const struct
+  {
+    const char *func;
+    bool retprobe;
+    int protocol;
+  } probes[] = { { "tcp_connect", false, IPPROTO_TCP },
+                 { "inet_csk_accept", true, IPPROTO_TCP },
+                 { "udp_sendmsg", false, IPPROTO_UDP } };
+
+  struct ebpf_sock *es = malloc ( sizeof *es );
+  if ( !es )
+    return NULL;
+
+  es->rb.fd = es->udp_seen = -1;
+  for ( size_t i = 0; i < ARRAY_SIZE ( probes ); i++ )
+    es->progs[i] = es->links[i] = -1;
+
+  es->owners = vector_new ( sizeof ( struct sock_owner ) );
+  if ( !es->owners )
+    goto ERROR_EXIT;
+
+  ebpf_rlimit ();
+
+  if ( !ebpf_ringbuf_init ( &es->rb, RINGBUF_SIZE ) )
+    goto ERROR_EXIT;
+
+  es->udp_seen = ebpf_map_create ( BPF_MAP_TYPE_LRU_HASH,
+                                   sizeof ( uint64_t ),
+                                   sizeof ( uint64_t ),
+                                   UDP_SEEN_ENTRIES );
+  if ( es->udp_seen == -1 )
+    goto ERROR_EXIT;
+
+  struct ebpf_prog *prog = malloc ( sizeof *prog );
+  if ( !prog )
+    goto ERROR_EXIT;
+
+  for ( size_t i = 0; i < ARRAY_SIZE ( probes ); i++ )
+    {
+      int regs_off = probes[i].retprobe ? PT_REGS_RC : PT_REGS_PARM1;
+
+      if ( !build_prog ( prog, es, regs_off, probes[i].protocol ) )
+        {
+          ERROR_DEBUG ( "Error build program to %s", probes[i].func );
+          free ( prog );
+          goto ERROR_EXIT;
+        }
+
+      es->progs[i] = ebpf_prog_load ( BPF_PROG_TYPE_KPROBE, prog, 0 );
+      if ( es->progs[i] == -1 )
+        {
+          free ( prog );
+          goto ERROR_EXIT;
+        }
+
+      es->links[i] = ebpf_attach_kprobe (
+              es->progs[i], probes[i].func, probes[i].retprobe );
+      if ( es->links[i] == -1 )
+        {
+          free ( prog );
+          goto ERROR_EXIT;
+        }
+    }
+
+  free ( prog );
+
+  return es;
+
+ERROR_EXIT:
+  ebpf_sock_free ( es );
+  return NULL;
+#endif
+}
+
+size_t
+ebpf_sock_read ( struct ebpf_sock *es )
+{
+  ebpf_ringbuf_consume ( &es->rb, handle_event, es );
+
+  return vector_size ( es->owners );
+}
+
+const struct sock_owner *
+ebpf_sock_owners ( struct ebpf_sock *es )
+{
+  return es->owners;
+}
+
+void
+ebpf_sock_clear ( struct ebpf_sock *es )
+{
+  vector_clear ( es->owners );
+}
+
+void
+ebpf_sock_free ( struct ebpf_sock *es )
+{
+  if ( !es )
+    return;
+
+  for ( size_t i = 0; i < ARRAY_SIZE ( es->links ); i++ )
+    {
+      if ( es->links[i] != -1 )
+        close ( es->links[i] );
+
+      if ( es->progs[i] != -1 )
+        close ( es->progs[i] );
+    }
+
+  if ( es->udp_seen != -1 )
+    close ( es->udp_seen );
+
+  if ( es->rb.fd != -1 )
+    ebpf_ringbuf_free ( &es->rb );
+
+  if ( es->owners )
+    vector_free ( es->owners );
+
+  free ( es );
+}
@@ -0,0 +1,54 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EBPF_SOCK_H
+#define EBPF_SOCK_H
+
+#include <stddef.h>  // size_t
+
+#include "../processes.h"  // struct sock_owner
+
+/* source of owners of sockets, programs eBPF in kprobes of tcp_connect,
+   udp_sendmsg and inet_csk_accept (kretprobe) report the tuple and pid of
+   each new socket by a ring buffer, so processes_update_owners can
+   associate new connections to processes without scan /proc/<pid>/fd/.
+   requires kernel 5.8 or newer (ring buffer of eBPF) */
+
+struct ebpf_sock;
+
+struct ebpf_sock *
+ebpf_sock_init ( void );
+
+/* read events of kernel, return total of owners pending */
+size_t
+ebpf_sock_read ( struct ebpf_sock *es );
+
+/* owners read and not yet consumed */
+const struct sock_owner *
+ebpf_sock_owners ( struct ebpf_sock *es );
+
+/* discard owners pending, called after update of processes */
+void
+ebpf_sock_clear ( struct ebpf_sock *es );
+
+void
+ebpf_sock_free ( struct ebpf_sock *es );
+
+#endif  // EBPF_SOCK_H
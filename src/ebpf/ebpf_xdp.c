@@ -0,0 +1,472 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdalign.h>  // alignas
+#include <stdlib.h>    // calloc
+#include <stddef.h>    // offsetof
+#include <string.h>    // memcpy
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // close
+#include <net/if.h>           // if_nametoindex
+#include <net/if_arp.h>       // ARPHRD_ETHER
+#include <netinet/in.h>       // IPPROTO_*
+#include <linux/if_ether.h>   // ETH_HLEN
+#include <linux/if_packet.h>  // struct tpacket3_hdr
+
+#include "ebpf.h"
+#include "ebpf_xdp.h"
+#include "../packet.h"
+#include "../statistics.h"  // statistics_add_batch
+#include "../filter.h"
+#include "../m_error.h"
+#include "../macro_util.h"
+
+// bytes of frame copied by program, in words of 8 bytes
+#define XDP_HEADERS 128
+
+// ring buffer to all interfaces, ~58k records
+#define XDP_RINGBUF_SIZE ( 8 * 1024 * 1024 )
+
+// record of each packet received, written by program
+struct xdp_record
+{
+  uint32_t len;     // lenght of frame in wire
+  uint32_t ifindex;
+  uint32_t caplen;  // bytes of data, multiple of 8
+  uint32_t pad;
+  uint8_t data[XDP_HEADERS];
+};
+
+// records are parsed as frames of ring
+#define FRAME_MAC TPACKET_ALIGN ( TPACKET3_HDRLEN )
+
+struct xdp_iface
+{
+  unsigned int ifindex;
+  enum link_type link;
+  parse_func parse;
+  int link_fd;  // link of program to interface, detached on close
+};
+
+struct ebpf_xdp
+{
+  struct ebpf_ringbuf rb;
+  int drops_map;  // records lost by ring buffer full, per-cpu
+  int prog;
+
+  struct xdp_iface ifaces[MAX_IFACES];
+  unsigned int total_ifaces;
+
+  const struct config_op *co;  // protocol can change by control socket
+  struct filter_excludes excludes;
+
+  unsigned int cpus;
+  uint64_t *drops;  // one value by cpu
+  uint64_t last_drops;
+  uint64_t records;
+
+  // read in batches, or to counters of flows while scan (see drain)
+  struct packet batch[STATISTICS_BATCH];
+  size_t total_batch;
+  struct flow_acc *acc;
+  bool view_conections;
+  bool miss;
+
+  struct timespec now;  // time of read, kernel not set it in records
+  alignas ( 8 ) uint8_t frame[FRAME_MAC + XDP_HEADERS];
+};
+
+#define REC_FIELD( F ) ( ( int ) offsetof ( struct xdp_record, F ) )
+#define XDP_FIELD( F ) ( ( int ) offsetof ( struct xdp_md, F ) )
+
+// offset in stack of program
+#define KEY_OFF ( -( int ) sizeof ( uint32_t ) )
+
+// labels of program
+enum
+{
+  L_SUBMIT,
+  L_FULL,
+  L_PASS
+};
+
+/* r6 = ctx, r7 = data, r8 = data_end and r0 the record. each word copied
+   is checked against end of packet, the verifier not accept loops. the last
+   bytes of frames not multiple of 8 are not copied, the parser read only
+   up to ports */
+static bool
+build_prog ( struct ebpf_prog *p, const struct ebpf_xdp *ex )
+{
+  ebpf_prog_init ( p );
+
+  EBPF_EMIT ( p,
+              EBPF_MOV64_REG ( BPF_REG_6, BPF_REG_1 ),
+              EBPF_LDX_MEM ( BPF_W, BPF_REG_7, BPF_REG_6, XDP_FIELD ( data ) ),
+              EBPF_LDX_MEM (
+                      BPF_W, BPF_REG_8, BPF_REG_6, XDP_FIELD ( data_end ) ),
+              EBPF_LD_MAP_FD ( BPF_REG_1, ex->rb.fd ),
+              EBPF_MOV64_IMM ( BPF_REG_2, sizeof ( struct xdp_record ) ),
+              EBPF_MOV64_IMM ( BPF_REG_3, 0 ),
+              EBPF_CALL ( BPF_FUNC_ringbuf_reserve ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 0, 0 ), L_FULL );
+
+  // lenght of frame, only of linear data (without fragments of XDP)
+  EBPF_EMIT ( p,
+              EBPF_MOV64_REG ( BPF_REG_1, BPF_REG_8 ),
+              EBPF_ALU64_REG ( BPF_SUB, BPF_REG_1, BPF_REG_7 ),
+              EBPF_STX_MEM ( BPF_W, BPF_REG_0, BPF_REG_1, REC_FIELD ( len ) ),
+              EBPF_LDX_MEM ( BPF_W,
+                             BPF_REG_1,
+                             BPF_REG_6,
+                             XDP_FIELD ( ingress_ifindex ) ),
+              EBPF_STX_MEM (
+                      BPF_W, BPF_REG_0, BPF_REG_1, REC_FIELD ( ifindex ) ),
+              EBPF_MOV64_IMM ( BPF_REG_9, 0 ) );
+
+  for ( int off = 0; off < XDP_HEADERS; off += 8 )
+    {
+      EBPF_EMIT ( p,
+                  EBPF_MOV64_REG ( BPF_REG_1, BPF_REG_7 ),
+                  EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_1, off + 8 ) );
+
+      ebpf_emit_jmp ( p,
+                      EBPF_JMP_REG ( BPF_JGT, BPF_REG_1, BPF_REG_8, 0 ),
+                      L_SUBMIT );
+
+      EBPF_EMIT ( p,
+                  EBPF_LDX_MEM ( BPF_DW, BPF_REG_1, BPF_REG_7, off ),
+                  EBPF_STX_MEM ( BPF_DW,
+                                 BPF_REG_0,
+                                 BPF_REG_1,
+                                 REC_FIELD ( data ) + off ),
+                  EBPF_MOV64_IMM ( BPF_REG_9, off + 8 ) );
+    }
+
+  // consumer is waked up only if it already read all records
+  ebpf_label ( p, L_SUBMIT );
+  EBPF_EMIT ( p,
+              EBPF_STX_MEM (
+                      BPF_W, BPF_REG_0, BPF_REG_9, REC_FIELD ( caplen ) ),
+              EBPF_MOV64_REG ( BPF_REG_1, BPF_REG_0 ),
+              EBPF_MOV64_IMM ( BPF_REG_2, 0 ),
+              EBPF_CALL ( BPF_FUNC_ringbuf_submit ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_A ( 0 ), L_PASS );
+
+  // map per-cpu, not need atomic operations
+  ebpf_label ( p, L_FULL );
+  EBPF_EMIT ( p,
+              EBPF_ST_MEM ( BPF_W, BPF_REG_10, KEY_OFF, 0 ),
+              EBPF_LD_MAP_FD ( BPF_REG_1, ex->drops_map ),
+              EBPF_MOV64_REG ( BPF_REG_2, BPF_REG_10 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_2, KEY_OFF ),
+              EBPF_CALL ( BPF_FUNC_map_lookup_elem ) );
+
+  ebpf_emit_jmp ( p, EBPF_JMP_IMM ( BPF_JEQ, BPF_REG_0, 0, 0 ), L_PASS );
+
+  EBPF_EMIT ( p,
+              EBPF_LDX_MEM ( BPF_DW, BPF_REG_1, BPF_REG_0, 0 ),
+              EBPF_ALU64_IMM ( BPF_ADD, BPF_REG_1, 1 ),
+              EBPF_STX_MEM ( BPF_DW, BPF_REG_0, BPF_REG_1, 0 ) );
+
+  // packet always follow to stack
+  ebpf_label ( p, L_PASS );
+  EBPF_EMIT ( p, EBPF_MOV64_IMM ( BPF_REG_0, XDP_PASS ), EBPF_EXIT () );
+
+  return ebpf_prog_resolve ( p );
+}
+
+static const struct xdp_iface *
+find_iface ( const struct ebpf_xdp *ex, unsigned int ifindex )
+{
+  for ( unsigned int i = 0; i < ex->total_ifaces; i++ )
+    {
+      if ( ex->ifaces[i].ifindex == ifindex )
+        return &ex->ifaces[i];
+    }
+
+  return NULL;
+}
+
+static bool
+proto_selected ( int proto, uint8_t protocol )
+{
+  return ( protocol == IPPROTO_TCP && ( proto & TCP ) ) ||
+         ( protocol == IPPROTO_UDP && ( proto & UDP ) );
+}
+
+static void
+flush_batch ( struct ebpf_xdp *ex )
+{
+  if ( ex->total_batch &&
+       !statistics_add_batch (
+               ex->batch, ex->total_batch, ex->view_conections ) )
+    ex->miss = true;
+
+  ex->total_batch = 0;
+}
+
+// record as a frame received of ring, parsed by the parser of link
+static void
+handle_record ( const void *data, uint32_t len, void *user_data )
+{
+  struct ebpf_xdp *ex = user_data;
+  const struct xdp_record *rec = data;
+
+  if ( len < sizeof ( *rec ) )
+    return;
+
+  ex->records++;
+
+  const struct xdp_iface *iface = find_iface ( ex, rec->ifindex );
+  if ( !iface )
+    return;
+
+  struct tpacket3_hdr *ppd = ( struct tpacket3_hdr * ) ex->frame;
+  struct sockaddr_ll *ll =
+          ( struct sockaddr_ll * ) ( ex->frame + TPACKET3_HDRLEN -
+                                     sizeof ( struct sockaddr_ll ) );
+
+  uint32_t caplen = MIN ( rec->caplen, XDP_HEADERS );
+
+  ppd->tp_len = rec->len;
+  ppd->tp_snaplen = caplen;
+  ppd->tp_sec = ex->now.tv_sec;
+  ppd->tp_nsec = ex->now.tv_nsec;
+  ppd->tp_net = FRAME_MAC + ( ( iface->link == LINK_ETHER ) ? ETH_HLEN : 0 );
+  ll->sll_ifindex = rec->ifindex;
+
+  // bytes after end of headers are zero, as not copied
+  memcpy ( ex->frame + FRAME_MAC, rec->data, caplen );
+  memset ( ex->frame + FRAME_MAC + caplen, 0, XDP_HEADERS - caplen );
+
+  struct packet *pkt = &ex->batch[ex->total_batch];
+  memset ( pkt, 0, sizeof ( *pkt ) );
+
+  // same rules of filter of sockets of ring
+  if ( !iface->parse ( pkt, ppd ) ||
+       !proto_selected ( ex->co->proto, pkt->tuple.l4.protocol ) ||
+       filter_excluded ( &ex->excludes, &pkt->tuple, pkt->if_index ) )
+    return;
+
+  if ( ex->acc )
+    {
+      flow_acc_add ( ex->acc, pkt, pkt->lenght, pkt->segments );
+      return;
+    }
+
+  if ( ++ex->total_batch == ARRAY_SIZE ( ex->batch ) )
+    flush_batch ( ex );
+}
+
+static void
+read_records ( struct ebpf_xdp *ex )
+{
+  clock_gettime ( CLOCK_REALTIME, &ex->now );
+
+  // expire old fragments, as in read of blocks of ring
+  packet_tick ( ex->now.tv_sec );
+
+  ebpf_ringbuf_consume ( &ex->rb, handle_record, ex );
+}
+
+struct ebpf_xdp *
+ebpf_xdp_init ( const struct config_op *co )
+{
+  struct ebpf_xdp *ex = calloc ( 1, sizeof *ex );
+  if ( !ex )
+    return NULL;
+
+  ex->rb.fd = ex->drops_map = ex->prog = -1;
+  ex->co = co;
+
+  ebpf_rlimit ();
+
+  if ( !( ex->cpus = ebpf_possible_cpus () ) )
+    goto ERROR_EXIT;
+
+  ex->drops = calloc ( ex->cpus, sizeof ( *ex->drops ) );
+  if ( !ex->drops )
+    goto ERROR_EXIT;
+
+  ex->excludes = co->excludes;
+  if ( co->exclude_file &&
+       !filter_exclude_load ( &ex->excludes, co->exclude_file ) )
+    goto ERROR_EXIT;
+
+  if ( !ebpf_ringbuf_init ( &ex->rb, XDP_RINGBUF_SIZE ) )
+    goto ERROR_EXIT;
+
+  ex->drops_map = ebpf_map_create ( BPF_MAP_TYPE_PERCPU_ARRAY,
+                                    sizeof ( uint32_t ),
+                                    sizeof ( uint64_t ),
+                                    1 );
+  if ( ex->drops_map == -1 )
+    goto ERROR_EXIT;
+
+  struct ebpf_prog *prog = malloc ( sizeof *prog );
+  if ( !prog )
+    goto ERROR_EXIT;
+
+  if ( !build_prog ( prog, ex ) )
+    {
+      ERROR_DEBUG ( "%s", "Error build program XDP" );
+      free ( prog );
+      goto ERROR_EXIT;
+    }
+
+  ex->prog = ebpf_prog_load ( BPF_PROG_TYPE_XDP, prog, BPF_XDP );
+  free ( prog );
+  if ( ex->prog == -1 )
+    goto ERROR_EXIT;
+
+  // fields of frame equal to all records
+  struct tpacket3_hdr *ppd = ( struct tpacket3_hdr * ) ex->frame;
+  struct sockaddr_ll *ll =
+          ( struct sockaddr_ll * ) ( ex->frame + TPACKET3_HDRLEN -
+                                     sizeof ( struct sockaddr_ll ) );
+  ppd->tp_mac = FRAME_MAC;
+  ll->sll_pkttype = PACKET_HOST;
+  ll->sll_hatype = ARPHRD_ETHER;
+
+  for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+    {
+      struct xdp_iface *iface = &ex->ifaces[i];
+
+      iface->link_fd = -1;
+      ex->total_ifaces++;
+
+      if ( !co->ifaces[i] ||
+           !( iface->ifindex = if_nametoindex ( co->ifaces[i] ) ) )
+        {
+          ERROR_DEBUG ( "%s", "XDP requires interfaces of '-i'" );
+          goto ERROR_EXIT;
+        }
+
+      // frames of XDP start in header of link, as in ring
+      iface->link = socket_link ( co->ifaces[i] );
+      if ( iface->link == LINK_ANY )
+        {
+          ERROR_DEBUG ( "Link of '%s' not supported by XDP", co->ifaces[i] );
+          goto ERROR_EXIT;
+        }
+
+      iface->parse = packet_parser ( iface->link );
+
+      // native mode if supported by driver, generic otherwise
+      iface->link_fd = ebpf_xdp_attach ( ex->prog, iface->ifindex );
+      if ( iface->link_fd == -1 )
+        goto ERROR_EXIT;
+    }
+
+  return ex;
+
+ERROR_EXIT:
+  ebpf_xdp_free ( ex );
+  return NULL;
+}
+
+int
+ebpf_xdp_fd ( struct ebpf_xdp *ex )
+{
+  return ex->rb.fd;
+}
+
+bool
+ebpf_xdp_read ( struct ebpf_xdp *ex, bool view_conections )
+{
+  ex->view_conections = view_conections;
+  ex->miss = false;
+
+  read_records ( ex );
+  flush_batch ( ex );
+
+  return ex->miss;
+}
+
+void
+ebpf_xdp_drain ( struct ebpf_xdp *ex, struct flow_acc *acc )
+{
+  ex->acc = acc;
+  read_records ( ex );
+  ex->acc = NULL;
+}
+
+void
+ebpf_xdp_stats ( struct ebpf_xdp *ex, struct sock_stats *stats )
+{
+  uint32_t key = 0;
+  uint64_t drops = 0;
+
+  if ( ebpf_map_lookup ( ex->drops_map, &key, ex->drops ) == 0 )
+    {
+      for ( unsigned int i = 0; i < ex->cpus; i++ )
+        drops += ex->drops[i];
+    }
+
+  // counters of kernel are never reset
+  if ( drops < ex->last_drops )
+    drops = ex->last_drops;
+
+  stats->drops += drops - ex->last_drops;
+  stats->packets += ex->records + drops - ex->last_drops;
+
+  ex->last_drops = drops;
+  ex->records = 0;
+}
+
+void
+ebpf_xdp_reload ( struct ebpf_xdp *ex, const struct config_op *co )
+{
+  struct filter_excludes excludes = co->excludes;
+
+  if ( co->exclude_file &&
+       !filter_exclude_load ( &excludes, co->exclude_file ) )
+    return;
+
+  ex->excludes = excludes;
+}
+
+void
+ebpf_xdp_free ( struct ebpf_xdp *ex )
+{
+  if ( !ex )
+    return;
+
+  // program is detached of interface with last reference to link
+  for ( unsigned int i = 0; i < ex->total_ifaces; i++ )
+    {
+      if ( ex->ifaces[i].link_fd != -1 )
+        close ( ex->ifaces[i].link_fd );
+    }
+
+  if ( ex->prog != -1 )
+    close ( ex->prog );
+
+  if ( ex->drops_map != -1 )
+    close ( ex->drops_map );
+
+  if ( ex->rb.fd != -1 )
+    ebpf_ringbuf_free ( &ex->rb );
+
+  free ( ex->drops );
+  free ( ex );
+}
@@ -0,0 +1,70 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EBPF_XDP_H
+#define EBPF_XDP_H
+
+#include <stdbool.h>
+
+#include "../config.h"
+#include "../sock.h"      // struct sock_stats
+#include "../flow_acc.h"  // struct flow_acc
+
+/* ingress of interfaces by a program XDP, that copy to a ring buffer of
+   eBPF only the headers (up to 128 bytes) and the lenght in wire of each
+   packet received and pass the packet to stack (XDP_PASS), so frames are
+   not cloned to a packet socket. records are parsed by the parser of link
+   of interface, as frames of ring, in batches to statistics.
+   XDP not see packets sent, they keep being read by ring, with a filter
+   that pass only PACKET_OUTGOING (see filter.h).
+   requires kernel 5.9 or newer (link of XDP) and interfaces of '-i' */
+
+struct ebpf_xdp;
+
+struct ebpf_xdp *
+ebpf_xdp_init ( const struct config_op *co );
+
+// ring buffer of records, readable when there are records to read
+int
+ebpf_xdp_fd ( struct ebpf_xdp *ex );
+
+/* parse records of ring buffer and add them to statistics of processes.
+   return true if any packet not was associated with a process */
+bool
+ebpf_xdp_read ( struct ebpf_xdp *ex, bool view_conections );
+
+// records of ring buffer to counters of flows, while tables are of scan
+void
+ebpf_xdp_drain ( struct ebpf_xdp *ex, struct flow_acc *acc );
+
+/* add to 'stats' the records read and the packets lost (ring buffer
+   full) since the last call */
+void
+ebpf_xdp_stats ( struct ebpf_xdp *ex, struct sock_stats *stats );
+
+/* exclusions of command line and of exclusions file, re-read. if the file is
+   invalid the current exclusions are kept */
+void
+ebpf_xdp_reload ( struct ebpf_xdp *ex, const struct config_op *co );
+
+void
+ebpf_xdp_free ( struct ebpf_xdp *ex );
+
+#endif  // EBPF_XDP_H
@@ -0,0 +1,797 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// references
+// https://prometheus.io/docs/instrumenting/exposition_formats/
+
+#define _GNU_SOURCE  // accept4
+
+#include <errno.h>   // variable errno
+#include <stdarg.h>  // va_list
+#include <stddef.h>  // offsetof
+#include <stdio.h>   // vsnprintf
+#include <stdlib.h>  // malloc
+#include <string.h>  // strerror, memcpy
+#include <unistd.h>  // close
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#include "exporter.h"
+#include "m_error.h"
+#include "macro_util.h"
+#include "memory.h"
+#include "topk.h"
+#include "pktsize.h"
+#include "statistics.h"  // statistics_ifaces
+#include "iface.h"
+#include "lag.h"
+
+// clients simultaneous, others are closed on accept
+#define MAX_CLIENTS 16
+
+// processes with labels, the traffic of others is in a series 'other'
+#define MAX_SERIES 256
+
+// milliseconds a client can stay without finish the request
+#define CLIENT_TIMEOUT 10000
+
+// space reserved before of body to header of HTTP
+#define HEADER_SPACE 128
+
+/* response of a refresh, kept until the last client writing it finish.
+   the buffer is reused by next refresh if no client is using it */
+struct response
+{
+  char *data;    // header + body
+  size_t start;  // offset of header
+  size_t end;
+  size_t size;
+  unsigned int refs;
+};
+
+struct client
+{
+  struct response *resp;  // NULL while reading request
+  uint64_t since;         // time running that was accepted
+  size_t sent;
+  int fd;
+};
+
+static struct client clients[MAX_CLIENTS];
+static struct response *cur_resp;
+static uint64_t running;
+static int listen_fd = -1;
+static int epfd = -1;
+
+static void
+response_put ( struct response *resp )
+{
+  if ( resp && !--resp->refs )
+    {
+      free ( resp->data );
+      free ( resp );
+    }
+}
+
+static bool
+ensure_space ( struct response *resp, size_t len )
+{
+  if ( resp->end + len <= resp->size )
+    return true;
+
+  size_t size = MAX ( resp->size * 2, resp->end + len );
+  char *data = realloc ( resp->data, size );
+  if ( !data )
+    return false;
+
+  resp->data = data;
+  resp->size = size;
+  return true;
+}
+
+static bool
+append ( struct response *resp, const char *fmt, ... )
+{
+  va_list args;
+
+  while ( 1 )
+    {
+      size_t space = resp->size - resp->end;
+
+      va_start ( args, fmt );
+      int len = vsnprintf ( resp->data + resp->end, space, fmt, args );
+      va_end ( args );
+
+      if ( len < 0 )
+        return false;
+
+      if ( ( size_t ) len < space )
+        {
+          resp->end += len;
+          return true;
+        }
+
+      if ( !ensure_space ( resp, len + 1 ) )
+        return false;
+    }
+}
+
+// value of label, with \ " and newline escaped
+static bool
+append_label ( struct response *resp, const char *value )
+{
+  size_t len = strlen ( value );
+
+  if ( !ensure_space ( resp, len * 2 + 1 ) )
+    return false;
+
+  for ( ; *value; value++ )
+    {
+      switch ( *value )
+        {
+          case '\\':
+          case '"':
+            resp->data[resp->end++] = '\\';
+            resp->data[resp->end++] = *value;
+            break;
+          case '\n':
+            resp->data[resp->end++] = '\\';
+            resp->data[resp->end++] = 'n';
+            break;
+          default:
+            resp->data[resp->end++] = *value;
+        }
+    }
+
+  resp->data[resp->end] = '\0';
+  return true;
+}
+
+static void
+client_close ( struct client *cl )
+{
+  close ( cl->fd );
+  response_put ( cl->resp );
+  cl->resp = NULL;
+  cl->fd = -1;
+}
+
+// write until socket buffer is full, true while not finished
+static bool
+client_write ( struct client *cl )
+{
+  struct response *resp = cl->resp;
+  size_t total = resp->end - resp->start;
+
+  while ( cl->sent < total )
+    {
+      ssize_t len = send ( cl->fd,
+                           resp->data + resp->start + cl->sent,
+                           total - cl->sent,
+                           MSG_NOSIGNAL );
+      if ( len == -1 )
+        return errno == EAGAIN || errno == EINTR;
+
+      cl->sent += len;
+    }
+
+  return false;
+}
+
+// content of request is not used, any request is of metrics
+static bool
+client_read ( struct client *cl )
+{
+  char buf[1024];
+  ssize_t len = recv ( cl->fd, buf, sizeof buf, 0 );
+
+  if ( len == -1 )
+    return errno == EAGAIN || errno == EINTR;
+
+  if ( !len || !cur_resp )
+    return false;
+
+  cl->resp = cur_resp;
+  cl->resp->refs++;
+  cl->sent = 0;
+
+  struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = cl };
+  if ( epoll_ctl ( epfd, EPOLL_CTL_MOD, cl->fd, &ev ) == -1 )
+    return false;
+
+  return client_write ( cl );
+}
+
+static void
+client_accept ( void )
+{
+  int fd;
+
+  while ( ( fd = accept4 (
+                    listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC ) ) !=
+          -1 )
+    {
+      struct client *cl = NULL;
+      for ( size_t i = 0; i < ARRAY_SIZE ( clients ); i++ )
+        {
+          if ( clients[i].fd == -1 )
+            {
+              cl = &clients[i];
+              break;
+            }
+        }
+
+      struct epoll_event ev = { .events = EPOLLIN, .data.ptr = cl };
+      if ( !cl || epoll_ctl ( epfd, EPOLL_CTL_ADD, fd, &ev ) == -1 )
+        {
+          close ( fd );
+          continue;
+        }
+
+      cl->fd = fd;
+      cl->since = running;
+    }
+}
+
+bool
+exporter_init ( const struct config_op *co )
+{
+  for ( size_t i = 0; i < ARRAY_SIZE ( clients ); i++ )
+    clients[i].fd = -1;
+
+  listen_fd =
+          socket ( AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  if ( listen_fd == -1 )
+    {
+      ERROR_DEBUG ( "Error create socket of metrics: %s", strerror ( errno ) );
+      goto ERROR;
+    }
+
+  // ipv4 and ipv6
+  int opt = 0;
+  setsockopt ( listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &opt, sizeof opt );
+  opt = 1;
+  setsockopt ( listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof opt );
+
+  struct sockaddr_in6 addr = { .sin6_family = AF_INET6,
+                               .sin6_addr = in6addr_any,
+                               .sin6_port = htons ( co->metrics_port ) };
+
+  if ( bind ( listen_fd, ( struct sockaddr * ) &addr, sizeof addr ) == -1 ||
+       listen ( listen_fd, MAX_CLIENTS ) == -1 )
+    {
+      ERROR_DEBUG ( "Error listen port %u: %s",
+                    co->metrics_port,
+                    strerror ( errno ) );
+      goto ERROR;
+    }
+
+  epfd = epoll_create1 ( EPOLL_CLOEXEC );
+  if ( epfd == -1 )
+    goto ERROR;
+
+  struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+  if ( epoll_ctl ( epfd, EPOLL_CTL_ADD, listen_fd, &ev ) == -1 )
+    goto ERROR;
+
+  return true;
+
+ERROR:
+  exporter_free ();
+  return false;
+}
+
+int
+exporter_fd ( void )
+{
+  return epfd;
+}
+
+void
+exporter_handle ( void )
+{
+  struct epoll_event events[MAX_CLIENTS + 1];
+
+  int ne = epoll_wait ( epfd, events, ARRAY_SIZE ( events ), 0 );
+
+  for ( int i = 0; i < ne; i++ )
+    {
+      struct client *cl = events[i].data.ptr;
+
+      // listen socket
+      if ( !cl )
+        {
+          client_accept ();
+          continue;
+        }
+
+      bool open = ( cl->resp ) ? client_write ( cl ) : client_read ( cl );
+      if ( !open )
+        client_close ( cl );
+    }
+}
+
+#define METRIC( name, type, help ) \
+  "# HELP netproc_" name " " help "\n# TYPE netproc_" name " " type "\n"
+
+static const struct metric
+{
+  const char *header;
+  const char *name;
+  size_t offset;  // in struct net_stat
+  bool bits;      // rate in bits without option '-B'
+} metrics[] = {
+  { METRIC ( "transmit_bytes_total",
+             "counter",
+             "Bytes sent by process." ),
+    "transmit_bytes_total",
+    offsetof ( struct net_stat, tot_Bps_tx ),
+    false },
+  { METRIC ( "receive_bytes_total",
+             "counter",
+             "Bytes received by process." ),
+    "receive_bytes_total",
+    offsetof ( struct net_stat, tot_Bps_rx ),
+    false },
+  { METRIC ( "transmit_bytes_rate",
+             "gauge",
+             "Bytes by second sent in window of rate." ),
+    "transmit_bytes_rate",
+    offsetof ( struct net_stat, avg_Bps_tx ),
+    true },
+  { METRIC ( "receive_bytes_rate",
+             "gauge",
+             "Bytes by second received in window of rate." ),
+    "receive_bytes_rate",
+    offsetof ( struct net_stat, avg_Bps_rx ),
+    true },
+  { METRIC ( "transmit_packets_rate",
+             "gauge",
+             "Packets by second sent in window of rate." ),
+    "transmit_packets_rate",
+    offsetof ( struct net_stat, avg_pps_tx ),
+    false },
+  { METRIC ( "receive_packets_rate",
+             "gauge",
+             "Packets by second received in window of rate." ),
+    "receive_packets_rate",
+    offsetof ( struct net_stat, avg_pps_rx ),
+    false },
+};
+
+static inline nstats_t
+stat_value ( const struct net_stat *ns, size_t offset )
+{
+  return *( const nstats_t * ) ( ( const char * ) ns + offset );
+}
+
+// totals of traffic of interfaces, of all packets captured
+static bool
+write_ifaces ( struct response *resp )
+{
+  static const struct
+  {
+    const char *header;
+    const char *name;
+    int direction;
+  } iface_metrics[] = {
+    { METRIC ( "interface_transmit_bytes_total",
+               "counter",
+               "Bytes sent by interface." ),
+      "interface_transmit_bytes_total",
+      PKT_UPL },
+    { METRIC ( "interface_receive_bytes_total",
+               "counter",
+               "Bytes received by interface." ),
+      "interface_receive_bytes_total",
+      PKT_DOWN },
+  };
+
+  size_t total;
+  const struct iface_total *ifaces = statistics_ifaces ( &total );
+
+  for ( size_t m = 0; m < ARRAY_SIZE ( iface_metrics ); m++ )
+    {
+      if ( !append ( resp, "%s", iface_metrics[m].header ) )
+        return false;
+
+      for ( size_t i = 0; i < total; i++ )
+        {
+          char index[16];
+          const char *name = iface_name ( ifaces[i].if_index );
+
+          if ( !name )
+            {
+              snprintf ( index, sizeof index, "%d", ifaces[i].if_index );
+              name = index;
+            }
+
+          if ( !append ( resp,
+                         "netproc_%s{interface=\"",
+                         iface_metrics[m].name ) ||
+               !append_label ( resp, name ) ||
+               !append ( resp,
+                         "\"} %lu\n",
+                         ifaces[i].bytes[iface_metrics[m].direction - 1] ) )
+            return false;
+        }
+    }
+
+  return true;
+}
+
+// lag of capture and time of refresh, histograms since start
+static bool
+write_lags ( struct response *resp )
+{
+  static const char *const headers[TOTAL_LAGS] = {
+    [LAG_CAPTURE] = METRIC ( "capture_lag_seconds",
+                             "histogram",
+                             "Time from last packet of a block of ring to "
+                             "read of block." ),
+    [LAG_TICK] = METRIC ( "tick_seconds",
+                          "histogram",
+                          "Time of processing of a refresh." ),
+  };
+  static const char *const names[TOTAL_LAGS] = {
+    [LAG_CAPTURE] = "capture_lag_seconds",
+    [LAG_TICK] = "tick_seconds",
+  };
+
+  for ( int k = 0; k < TOTAL_LAGS; k++ )
+    {
+      struct lag_histogram hist;
+      lag_histogram ( k, &hist );
+
+      if ( !append ( resp, "%s", headers[k] ) )
+        return false;
+
+      // buckets of prometheus are cumulative
+      uint64_t count = 0;
+      for ( unsigned int i = 0; i < LAG_BUCKETS - 1; i++ )
+        {
+          count += hist.counts[i];
+          if ( !append ( resp,
+                         "netproc_%s_bucket{le=\"%.6f\"} %lu\n",
+                         names[k],
+                         lag_bucket_bound ( i ) / 1e6,
+                         count ) )
+            return false;
+        }
+
+      // count of buckets, read while capture threads add values
+      count += hist.counts[LAG_BUCKETS - 1];
+      if ( !append ( resp,
+                     "netproc_%s_bucket{le=\"+Inf\"} %lu\n"
+                     "netproc_%s_sum %g\n"
+                     "netproc_%s_count %lu\n",
+                     names[k],
+                     count,
+                     names[k],
+                     hist.sum_us / 1e6,
+                     names[k],
+                     count ) )
+        return false;
+    }
+
+  return true;
+}
+
+/* remotes with most traffic of processes (option --top-remotes), at most
+   of MAX_SERIES processes, as the others metrics */
+static bool
+write_remotes ( struct response *resp, process_t **processes, size_t total )
+{
+  if ( !append ( resp,
+                 "%s",
+                 METRIC ( "remote_bytes_total",
+                          "counter",
+                          "Bytes of process with remote, estimated by "
+                          "sketch of top remotes." ) ) )
+    return false;
+
+  size_t series = 0;
+
+  for ( size_t i = 0; i < total && series < MAX_SERIES; i++ )
+    {
+      struct topk *tk = processes[i]->remotes;
+      const struct net_stat *ns = &processes[i]->net_stat;
+
+      if ( !tk || ( !ns->tot_Bps_rx && !ns->tot_Bps_tx ) )
+        continue;
+
+      series++;
+      topk_sort ( tk );
+
+      for ( unsigned int r = 0; r < tk->total; r++ )
+        {
+          char remote[TOPK_KEY_STRLEN];
+          topk_key_str ( &tk->entries[r].key, remote, sizeof remote );
+
+          if ( !append ( resp,
+                         "netproc_remote_bytes_total{pid=\"%d\",program=\"",
+                         processes[i]->pid ) ||
+               !append_label ( resp, processes[i]->name ) ||
+               !append ( resp,
+                         "\",remote=\"%s\"} %lu\n",
+                         remote,
+                         tk->entries[r].bytes ) )
+            return false;
+        }
+    }
+
+  return true;
+}
+
+// labels of series of sizes, without '}'
+static bool
+append_size_labels ( struct response *resp,
+                     const char *series,
+                     const process_t *proc,
+                     const char *dir )
+{
+  return append ( resp,
+                  "netproc_packet_size_bytes_%s{pid=\"%d\",program=\"",
+                  series,
+                  proc->pid ) &&
+         append_label ( resp, proc->name ) &&
+         append ( resp, "\",direction=\"%s\"", dir );
+}
+
+/* histograms of sizes of packets of processes by direction, at most of
+   MAX_SERIES processes, the sum is the total of bytes of process */
+static bool
+write_sizes ( struct response *resp, process_t **processes, size_t total )
+{
+  if ( !append ( resp,
+                 "%s",
+                 METRIC ( "packet_size_bytes",
+                          "histogram",
+                          "Sizes of packets of process, by power of two." ) ) )
+    return false;
+
+  static const char *const dirs[PKTSIZE_DIRS] = { [PKTSIZE_RX] = "receive",
+                                                  [PKTSIZE_TX] = "transmit" };
+  size_t series = 0;
+
+  for ( size_t i = 0; i < total && series < MAX_SERIES; i++ )
+    {
+      const process_t *proc = processes[i];
+      const struct net_stat *ns = &proc->net_stat;
+
+      if ( !proc->sizes || ( !ns->tot_Bps_rx && !ns->tot_Bps_tx ) )
+        continue;
+
+      series++;
+
+      for ( int d = 0; d < PKTSIZE_DIRS; d++ )
+        {
+          // buckets of prometheus are cumulative, bucket b has sizes
+          // until 2^(b+1) - 1 and the last one all sizes
+          uint64_t count = 0;
+          for ( unsigned int b = 0; b < PKTSIZE_BUCKETS - 1; b++ )
+            {
+              count += proc->sizes->packets[d][b];
+              if ( !append_size_labels ( resp, "bucket", proc, dirs[d] ) ||
+                   !append ( resp,
+                             ",le=\"%u\"} %lu\n",
+                             ( 2U << b ) - 1,
+                             count ) )
+                return false;
+            }
+
+          count += proc->sizes->packets[d][PKTSIZE_BUCKETS - 1];
+          nstats_t sum = ( d == PKTSIZE_TX ) ? ns->tot_Bps_tx : ns->tot_Bps_rx;
+
+          if ( !append_size_labels ( resp, "bucket", proc, dirs[d] ) ||
+               !append ( resp, ",le=\"+Inf\"} %lu\n", count ) ||
+               !append_size_labels ( resp, "sum", proc, dirs[d] ) ||
+               !append ( resp, "} %lu\n", sum ) ||
+               !append_size_labels ( resp, "count", proc, dirs[d] ) ||
+               !append ( resp, "} %lu\n", count ) )
+            return false;
+        }
+    }
+
+  return true;
+}
+
+static bool
+write_metrics ( struct response *resp,
+                process_t **processes,
+                size_t total,
+                const struct config_op *co )
+{
+  for ( size_t m = 0; m < ARRAY_SIZE ( metrics ); m++ )
+    {
+      if ( !append ( resp, "%s", metrics[m].header ) )
+        return false;
+
+      nstats_t other = 0;
+      size_t series = 0;
+
+      for ( size_t i = 0; i < total; i++ )
+        {
+          const struct net_stat *ns = &processes[i]->net_stat;
+
+          if ( !ns->tot_Bps_rx && !ns->tot_Bps_tx )
+            continue;
+
+          nstats_t value = stat_value ( ns, metrics[m].offset );
+          if ( metrics[m].bits && !co->view_bytes )
+            value /= 8;
+
+          if ( series++ >= MAX_SERIES )
+            {
+              other += value;
+              continue;
+            }
+
+          if ( !append ( resp,
+                         "netproc_%s{pid=\"%d\",program=\"",
+                         metrics[m].name,
+                         processes[i]->pid ) ||
+               !append_label ( resp, processes[i]->name ) ||
+               !append ( resp, "\"} %lu\n", value ) )
+            return false;
+        }
+
+      if ( series > MAX_SERIES &&
+           !append ( resp,
+                     "netproc_%s{pid=\"\",program=\"other\"} %lu\n",
+                     metrics[m].name,
+                     other ) )
+        return false;
+    }
+
+  if ( co->top_remotes && !write_remotes ( resp, processes, total ) )
+    return false;
+
+  if ( !write_sizes ( resp, processes, total ) )
+    return false;
+
+  const struct sock_stats *st = &co->stats_total;
+
+  if ( !append ( resp,
+                 METRIC ( "packets_total",
+                          "counter",
+                          "Packets read by sockets of capture." )
+                 "netproc_packets_total %lu\n"
+                 METRIC ( "drops_total",
+                          "counter",
+                          "Packets dropped by kernel." )
+                 "netproc_drops_total %lu\n"
+                 METRIC ( "sample_rate",
+                          "gauge",
+                          "1 in N packets captured, above 1 values are "
+                          "estimates." )
+                 "netproc_sample_rate %u\n",
+                 st->packets,
+                 st->drops,
+                 co->sample ) )
+    return false;
+
+  if ( !write_ifaces ( resp ) || !write_lags ( resp ) )
+    return false;
+
+  struct memory_usage mu;
+  memory_usage ( &mu );
+
+  if ( !append ( resp,
+                 "%s",
+                 METRIC ( "memory_bytes",
+                          "gauge",
+                          "Bytes in use by tables of netproc." ) ) )
+    return false;
+
+  for ( int i = 0; i < TOTAL_MEMORY_TABLES; i++ )
+    {
+      if ( !append ( resp,
+                     "netproc_memory_bytes{table=\"%s\"} %zu\n",
+                     memory_table_name ( i ),
+                     mu.bytes[i] ) )
+        return false;
+    }
+
+  return true;
+}
+
+void
+exporter_update ( process_t **processes,
+                  size_t total,
+                  const struct config_op *co )
+{
+  if ( epfd == -1 )
+    return;
+
+  running = co->running;
+
+  // clients that not finished the request in time
+  for ( size_t i = 0; i < ARRAY_SIZE ( clients ); i++ )
+    {
+      if ( clients[i].fd != -1 &&
+           running - clients[i].since > CLIENT_TIMEOUT )
+        client_close ( &clients[i] );
+    }
+
+  // buffer in use by client, this refresh has a new
+  if ( cur_resp && cur_resp->refs > 1 )
+    {
+      response_put ( cur_resp );
+      cur_resp = NULL;
+    }
+
+  if ( !cur_resp )
+    {
+      cur_resp = calloc ( 1, sizeof *cur_resp );
+      if ( !cur_resp )
+        return;
+
+      cur_resp->refs = 1;
+    }
+
+  cur_resp->end = HEADER_SPACE;
+  if ( !ensure_space ( cur_resp, 1 ) ||
+       !write_metrics ( cur_resp, processes, total, co ) )
+    {
+      ERROR_DEBUG ( "%s", "Error write metrics" );
+      response_put ( cur_resp );
+      cur_resp = NULL;
+      return;
+    }
+
+  // header just before of body
+  char header[HEADER_SPACE];
+  int len = snprintf ( header,
+                       sizeof header,
+                       "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: %zu\r\n"
+                       "Connection: close\r\n\r\n",
+                       cur_resp->end - HEADER_SPACE );
+
+  cur_resp->start = HEADER_SPACE - len;
+  memcpy ( cur_resp->data + cur_resp->start, header, len );
+}
+
+void
+exporter_free ( void )
+{
+  // clients only exist with listen socket
+  if ( listen_fd != -1 )
+    {
+      for ( size_t i = 0; i < ARRAY_SIZE ( clients ); i++ )
+        {
+          if ( clients[i].fd != -1 )
+            client_close ( &clients[i] );
+        }
+
+      close ( listen_fd );
+      listen_fd = -1;
+    }
+
+  response_put ( cur_resp );
+  cur_resp = NULL;
+
+  if ( epfd != -1 )
+    close ( epfd );
+  epfd = -1;
+}
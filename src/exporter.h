@@ -0,0 +1,56 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+
+#include "processes.h"
+#include "config.h"
+
+/* endpoint HTTP to Prometheus, any request is answered with the metrics of
+   processes in text format. the response is written once by refresh in a
+   buffer, so requests not read the tables of processes and not block the
+   main loop, clients are sockets non blocking */
+
+bool
+exporter_init ( const struct config_op *co );
+
+/* file descriptor (epoll) readable when there are clients to handle, -1
+   if exporter is not started */
+int
+exporter_fd ( void );
+
+// accept clients, read requests and write responses ready
+void
+exporter_handle ( void );
+
+// write metrics of this refresh in buffer of responses
+void
+exporter_update ( process_t **processes,
+                  size_t total,
+                  const struct config_op *co );
+
+void
+exporter_free ( void );
+
+#endif  // EXPORTER_H
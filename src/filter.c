@@ -19,106 +19,780 @@
  */
 
 #include <stdbool.h>
+#include <stdio.h>         // fopen
+#include <stdlib.h>        // calloc, strtol
+#include <string.h>        // memcpy
+#include <errno.h>
+#include <net/if.h>        // if_nametoindex
+#include <arpa/inet.h>     // inet_pton
 #include <linux/filter.h>  // struct sock_filter, sock_fprog
+#include <linux/if_ether.h>   // ETH_P_8021Q, ETH_P_8021AD
+#include <linux/if_packet.h>  // PACKET_OUTGOING
 #include <sys/socket.h>    // setsockopt
 
-#include "connection.h"
+#include "config.h"
+#include "filter.h"
 #include "m_error.h"
 #include "macro_util.h"
 
+/* a program is built to each link type, of sections of frames of link:
+   started by ip (tun and cooked, that has not header of link), ethernet and
+   ethernet with tags of vlan. sockets of all interfaces (LINK_ANY) have all
+   sections. each section test the version of ip or the ethertype and run the
+   checks of ipv4 or ipv6, in order: protocol, networks (loopback and
+   exclusions of user) of source and destination and ports.
+   frames with tags have the offset of layer 3 in register X, the loads of
+   its sections are relative to X (BPF_IND), so the depth of tags not
+   multiply the sections.
+   a match is dropped with a 'ret #0' just after the test, so the conditional
+   jumps are always short and only 'ja' (offset of 32 bits) cross sections */
+
+// return of accepted packets without snaplen, the entire packet
+#define SNAPLEN_ALL 0x40000
+
+// offset of layer 3 in frame of each link type
+#define OFF_TUN 0
+#define OFF_ETH 14
+
+#define OFF_ETHERTYPE 12
+#define VLAN_HLEN 4
+
+// offsets of fields in header ipv4 and ipv6
+#define IPV4_FRAG 6
+#define IPV4_PROTO 9
+#define IPV4_SADDR 12
+#define IPV4_DADDR 16
+#define IPV6_NEXTHDR 6
+#define IPV6_SADDR 8
+#define IPV6_DADDR 24
+#define IPV6_L4 40
+
+#define P_TCP 0x06
+#define P_UDP 0x11
+
+// jump of instruction is to a label (not resolved yet)
+#define NO_LABEL -1
+
+struct builder
+{
+  struct sock_filter insns[BPF_MAXINSNS];
+  int16_t target[BPF_MAXINSNS];  // label of 'ja' (k) or jump false (jf)
+  int16_t labels[BPF_MAXINSNS];  // instruction of each label
+  unsigned int len;
+  unsigned int total_labels;
+  uint32_t pass;    // return of packets accepted
+  uint32_t sample;  // accept 1 in 'sample' packets, 1 accept all
+  uint32_t loopback;  // ifindex of loopback, 0 drop networks of loopback
+  int proto;
+  bool outgoing;  // only packets sent, the received are read by XDP
+  uint16_t mode;  // loads of layer 3, BPF_ABS or BPF_IND (offset in X)
+  bool overflow;
+};
+
+static void
+emit_jump ( struct builder *b,
+            uint16_t code,
+            uint32_t k,
+            uint8_t jt,
+            uint8_t jf )
+{
+  if ( b->len == BPF_MAXINSNS )
+    {
+      b->overflow = true;
+      return;
+    }
+
+  b->insns[b->len] = ( struct sock_filter ) BPF_JUMP ( code, k, jt, jf );
+  b->target[b->len] = NO_LABEL;
+  b->len++;
+}
+
+static void
+emit ( struct builder *b, uint16_t code, uint32_t k )
+{
+  emit_jump ( b, code, k, 0, 0 );
+}
+
+static int16_t
+label_new ( struct builder *b )
+{
+  if ( b->total_labels == BPF_MAXINSNS )
+    {
+      b->overflow = true;
+      return 0;
+    }
+
+  b->labels[b->total_labels] = NO_LABEL;
+  return b->total_labels++;
+}
+
+static void
+label_bind ( struct builder *b, int16_t label )
+{
+  b->labels[label] = b->len;
+}
+
+// jump always to label
+static void
+emit_goto ( struct builder *b, int16_t label )
+{
+  emit ( b, BPF_JMP | BPF_JA, 0 );
+  if ( !b->overflow )
+    b->target[b->len - 1] = label;
+}
+
+// if A == k next instruction, otherwise jump to label (that must be near)
+static void
+emit_jeq_label ( struct builder *b, uint32_t k, int16_t label )
+{
+  emit ( b, BPF_JMP | BPF_JEQ | BPF_K, k );
+  if ( !b->overflow )
+    b->target[b->len - 1] = label;
+}
+
+// if A & k next instruction, otherwise jump to label (that must be near)
+static void
+emit_jset_label ( struct builder *b, uint32_t k, int16_t label )
+{
+  emit ( b, BPF_JMP | BPF_JSET | BPF_K, k );
+  if ( !b->overflow )
+    b->target[b->len - 1] = label;
+}
+
+static void
+emit_drop ( struct builder *b )
+{
+  emit ( b, BPF_RET | BPF_K, 0 );
+}
+
+/* accept the packet, in sample mode only if random % sample == 0, so the
+   packets not sampled are never copied to ring */
+static void
+emit_pass ( struct builder *b )
+{
+  if ( b->sample > 1 )
+    {
+      emit ( b, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_RANDOM );
+      emit ( b, BPF_ALU | BPF_MOD | BPF_K, b->sample );
+      emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, 0, 0, 1 );
+    }
+
+  emit ( b, BPF_RET | BPF_K, b->pass );
+
+  if ( b->sample > 1 )
+    emit_drop ( b );
+}
+
+// if A == k drop the packet
+static void
+emit_drop_if ( struct builder *b, uint32_t k )
+{
+  emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, k, 0, 1 );
+  emit_drop ( b );
+}
+
+// if A == k jump to label
+static void
+emit_goto_if ( struct builder *b, uint32_t k, int16_t label )
+{
+  emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, k, 0, 1 );
+  emit_goto ( b, label );
+}
+
 static bool
-filter_get ( struct sock_fprog *fprog, const int flags_proto )
-{
-  // pass only tcp or udp, block net address 127.*
-  // suport interface ethernet and tun
-  // bpfc -i bpf/program.bpf -f C -p
-  static const struct sock_filter ip_tcp_udp[] = {
-    { 0x30, 0, 0, 0x00000000 },  { 0x54, 0, 0, 0x000000f0 },
-    { 0x15, 0, 9, 0x00000040 },  { 0x20, 0, 0, 0x0000000c },
-    { 0x54, 0, 0, 0xff000000 },  { 0x15, 18, 0, 0x7f000000 },
-    { 0x20, 0, 0, 0x00000010 },  { 0x54, 0, 0, 0xff000000 },
-    { 0x15, 15, 0, 0x7f000000 }, { 0x30, 0, 0, 0x00000009 },
-    { 0x15, 12, 0, 0x00000006 }, { 0x15, 11, 0, 0x00000011 },
-    { 0x28, 0, 0, 0x0000000c },  { 0x15, 0, 10, 0x00000800 },
-    { 0x20, 0, 0, 0x0000001a },  { 0x54, 0, 0, 0xff000000 },
-    { 0x15, 7, 0, 0x7f000000 },  { 0x20, 0, 0, 0x0000001e },
-    { 0x54, 0, 0, 0xff000000 },  { 0x15, 4, 0, 0x7f000000 },
-    { 0x30, 0, 0, 0x00000017 },  { 0x15, 1, 0, 0x00000006 },
-    { 0x15, 0, 1, 0x00000011 },  { 0x6, 0, 0, 0x00040000 },
-    { 0x6, 0, 0, 0x00000000 },
-  };
-
-  // pass only tcp, block net address 127.*
-  // suport interface ethernet and tun
-  // bpfc -i bpf/program.bpf -f C -p -D TCP
-  static const struct sock_filter ip_tcp[] = {
-    { 0x30, 0, 0, 0x00000000 },  { 0x54, 0, 0, 0x000000f0 },
-    { 0x15, 0, 8, 0x00000040 },  { 0x20, 0, 0, 0x0000000c },
-    { 0x54, 0, 0, 0xff000000 },  { 0x15, 16, 0, 0x7f000000 },
-    { 0x20, 0, 0, 0x00000010 },  { 0x54, 0, 0, 0xff000000 },
-    { 0x15, 13, 0, 0x7f000000 }, { 0x30, 0, 0, 0x00000009 },
-    { 0x15, 10, 0, 0x00000006 }, { 0x28, 0, 0, 0x0000000c },
-    { 0x15, 0, 9, 0x00000800 },  { 0x20, 0, 0, 0x0000001a },
-    { 0x54, 0, 0, 0xff000000 },  { 0x15, 6, 0, 0x7f000000 },
-    { 0x20, 0, 0, 0x0000001e },  { 0x54, 0, 0, 0xff000000 },
-    { 0x15, 3, 0, 0x7f000000 },  { 0x30, 0, 0, 0x00000017 },
-    { 0x15, 0, 1, 0x00000006 },  { 0x6, 0, 0, 0x00040000 },
-    { 0x6, 0, 0, 0x00000000 },
-  };
-
-  // pass only udp, block net address 127.*
-  // suport interface ethernet and tun
-  // bpfc -i bpf/program.bpf -f C -p -D UDP
-  static const struct sock_filter ip_udp[] = {
-    { 0x30, 0, 0, 0x00000000 },  { 0x54, 0, 0, 0x000000f0 },
-    { 0x15, 0, 8, 0x00000040 },  { 0x20, 0, 0, 0x0000000c },
-    { 0x54, 0, 0, 0xff000000 },  { 0x15, 16, 0, 0x7f000000 },
-    { 0x20, 0, 0, 0x00000010 },  { 0x54, 0, 0, 0xff000000 },
-    { 0x15, 13, 0, 0x7f000000 }, { 0x30, 0, 0, 0x00000009 },
-    { 0x15, 10, 0, 0x00000011 }, { 0x28, 0, 0, 0x0000000c },
-    { 0x15, 0, 9, 0x00000800 },  { 0x20, 0, 0, 0x0000001a },
-    { 0x54, 0, 0, 0xff000000 },  { 0x15, 6, 0, 0x7f000000 },
-    { 0x20, 0, 0, 0x0000001e },  { 0x54, 0, 0, 0xff000000 },
-    { 0x15, 3, 0, 0x7f000000 },  { 0x30, 0, 0, 0x00000017 },
-    { 0x15, 0, 1, 0x00000011 },  { 0x6, 0, 0, 0x00040000 },
-    { 0x6, 0, 0, 0x00000000 },
-  };
-
-  switch ( flags_proto )
-    {
-      case ( TCP | UDP ):
-        fprog->len = ARRAY_SIZE ( ip_tcp_udp );
-        fprog->filter = ( struct sock_filter * ) ip_tcp_udp;
-        break;
+resolve_labels ( struct builder *b )
+{
+  for ( unsigned int i = 0; i < b->len; i++ )
+    {
+      if ( b->target[i] == NO_LABEL )
+        continue;
+
+      int dest = b->labels[b->target[i]];
+      if ( dest == NO_LABEL || dest <= ( int ) i )
+        return false;
+
+      unsigned int offset = dest - i - 1;
+      if ( BPF_OP ( b->insns[i].code ) == BPF_JA )
+        b->insns[i].k = offset;
+      else if ( offset <= UINT8_MAX )
+        b->insns[i].jf = offset;
+      else
+        return false;
+    }
+
+  return true;
+}
+
+// load protocol of layer 4 and drop if not is the protocol selected
+static void
+emit_proto ( struct builder *b, uint32_t offset )
+{
+  emit ( b, BPF_LD | BPF_B | b->mode, offset );
+
+  switch ( b->proto )
+    {
       case TCP:
-        fprog->len = ARRAY_SIZE ( ip_tcp );
-        fprog->filter = ( struct sock_filter * ) ip_tcp;
+        emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, P_TCP, 1, 0 );
         break;
       case UDP:
-        fprog->len = ARRAY_SIZE ( ip_udp );
-        fprog->filter = ( struct sock_filter * ) ip_udp;
+        emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, P_UDP, 1, 0 );
         break;
       default:
-        ERROR_DEBUG ( "%s", "Protocol filter bpf invalid" );
+        emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, P_TCP, 2, 0 );
+        emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, P_UDP, 1, 0 );
+    }
+
+  emit_drop ( b );
+}
+
+static uint32_t
+prefix_mask ( unsigned int bits )
+{
+  return ( bits ) ? UINT32_MAX << ( 32 - bits ) : 0;
+}
+
+// drop packet if address in offset is in network
+static void
+emit_net ( struct builder *b, const struct exclude_net *net, uint32_t offset )
+{
+  unsigned int words = ( net->prefix + 31 ) / 32;
+
+  // prefix 0, all addresses
+  if ( !words )
+    {
+      emit_drop ( b );
+      return;
+    }
+
+  int16_t no_match = label_new ( b );
+
+  for ( unsigned int i = 0; i < words; i++ )
+    {
+      unsigned int bits = net->prefix - i * 32;
+
+      emit ( b, BPF_LD | BPF_W | b->mode, offset + i * 4 );
+      if ( bits < 32 )
+        emit ( b, BPF_ALU | BPF_AND | BPF_K, prefix_mask ( bits ) );
+
+      if ( i + 1 < words )
+        emit_jeq_label ( b, ntohl ( net->addr.all[i] ), no_match );
+      else
+        emit_drop_if ( b, ntohl ( net->addr.all[i] ) );
+    }
+
+  label_bind ( b, no_match );
+}
+
+static void
+emit_nets ( struct builder *b,
+            const struct filter_excludes *ex,
+            int family,
+            uint32_t off_saddr,
+            uint32_t off_daddr )
+{
+  // loopback is dropped, unless counted
+  struct exclude_net loopback = { .family = family };
+  if ( family == AF_INET )
+    {
+      loopback.addr.ip = htonl ( 0x7f000000 );
+      loopback.prefix = 8;
+    }
+  else
+    {
+      loopback.addr.in6 = in6addr_loopback;
+      loopback.prefix = 128;
+    }
+
+  if ( !b->loopback )
+    {
+      emit_net ( b, &loopback, off_saddr );
+      emit_net ( b, &loopback, off_daddr );
+    }
+
+  for ( unsigned int i = 0; i < ex->total_nets; i++ )
+    {
+      if ( ex->nets[i].family != family )
+        continue;
+
+      emit_net ( b, &ex->nets[i], off_saddr );
+      emit_net ( b, &ex->nets[i], off_daddr );
+    }
+}
+
+// mode is BPF_ABS or BPF_IND (offset relative to register X)
+static void
+emit_ports ( struct builder *b,
+             const struct filter_excludes *ex,
+             uint16_t mode,
+             uint32_t offset )
+{
+  // source and destination port
+  for ( uint32_t off = offset; off <= offset + 2; off += 2 )
+    {
+      emit ( b, BPF_LD | BPF_H | mode, off );
+      for ( unsigned int i = 0; i < ex->total_ports; i++ )
+        emit_drop_if ( b, ex->ports[i] );
+    }
+}
+
+static void
+emit_ipv4 ( struct builder *b, const struct filter_excludes *ex, uint32_t net )
+{
+  emit_proto ( b, net + IPV4_PROTO );
+  emit_nets ( b, ex, AF_INET, net + IPV4_SADDR, net + IPV4_DADDR );
+
+  if ( ex->total_ports )
+    {
+      // fragment that not is the first has not header of layer 4.
+      // pass can be more than one instruction (sample), so a label
+      int16_t ports = label_new ( b );
+      emit ( b, BPF_LD | BPF_H | b->mode, net + IPV4_FRAG );
+      emit_jset_label ( b, 0x1fff, ports );
+      emit_pass ( b );
+      label_bind ( b, ports );
+
+      if ( b->mode == BPF_ABS )
+        {
+          // X = size of header ipv4
+          emit ( b, BPF_LDX | BPF_B | BPF_MSH, net );
+        }
+      else
+        {
+          // X = offset of layer 3 + size of header ipv4
+          emit ( b, BPF_LD | BPF_B | BPF_IND, net );
+          emit ( b, BPF_ALU | BPF_AND | BPF_K, 0x0f );
+          emit ( b, BPF_ALU | BPF_LSH | BPF_K, 2 );
+          emit ( b, BPF_ALU | BPF_ADD | BPF_X, 0 );
+          emit ( b, BPF_MISC | BPF_TAX, 0 );
+        }
+
+      emit_ports ( b, ex, BPF_IND, net );
+    }
+
+  emit_pass ( b );
+}
+
+// extension headers are not followed
+static void
+emit_ipv6 ( struct builder *b, const struct filter_excludes *ex, uint32_t net )
+{
+  emit_proto ( b, net + IPV6_NEXTHDR );
+  emit_nets ( b, ex, AF_INET6, net + IPV6_SADDR, net + IPV6_DADDR );
+
+  if ( ex->total_ports )
+    emit_ports ( b, ex, b->mode, net + IPV6_L4 );
+
+  emit_pass ( b );
+}
+
+// frames started by ip, version of ip in first byte
+static void
+emit_tun ( struct builder *b, const struct filter_excludes *ex, int16_t next )
+{
+  int16_t tun4 = label_new ( b );
+  int16_t tun6 = label_new ( b );
+
+  emit ( b, BPF_LD | BPF_B | BPF_ABS, OFF_TUN );
+  emit ( b, BPF_ALU | BPF_AND | BPF_K, 0xf0 );
+  emit_goto_if ( b, 0x40, tun4 );
+  emit_goto_if ( b, 0x60, tun6 );
+  if ( next != NO_LABEL )
+    emit_goto ( b, next );
+  else
+    emit_drop ( b );
+
+  label_bind ( b, tun4 );
+  emit_ipv4 ( b, ex, OFF_TUN );
+  label_bind ( b, tun6 );
+  emit_ipv6 ( b, ex, OFF_TUN );
+}
+
+// ethernet, test ethertype after each tag of vlan of frame
+static void
+emit_eth ( struct builder *b, const struct filter_excludes *ex )
+{
+  int16_t eth4 = label_new ( b );
+  int16_t eth6 = label_new ( b );
+  int16_t vlan4 = label_new ( b );
+  int16_t vlan6 = label_new ( b );
+
+  for ( unsigned int tags = 0; tags <= MAX_VLAN_TAGS; tags++ )
+    {
+      uint32_t off = OFF_ETHERTYPE + tags * VLAN_HLEN;
+
+      if ( tags )
+        emit ( b, BPF_LDX | BPF_W | BPF_IMM, off + 2 );
+
+      emit ( b, BPF_LD | BPF_H | BPF_ABS, off );
+      emit_goto_if ( b, 0x0800, ( tags ) ? vlan4 : eth4 );
+      emit_goto_if ( b, 0x86dd, ( tags ) ? vlan6 : eth6 );
+
+      // next tag, of 802.1Q or 802.1ad (QinQ)
+      if ( tags < MAX_VLAN_TAGS )
+        {
+          emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, ETH_P_8021Q, 2, 0 );
+          emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, ETH_P_8021AD, 1, 0 );
+        }
+
+      emit_drop ( b );
+    }
+
+  label_bind ( b, eth4 );
+  emit_ipv4 ( b, ex, OFF_ETH );
+  label_bind ( b, eth6 );
+  emit_ipv6 ( b, ex, OFF_ETH );
+
+  b->mode = BPF_IND;
+  label_bind ( b, vlan4 );
+  emit_ipv4 ( b, ex, 0 );
+  label_bind ( b, vlan6 );
+  emit_ipv6 ( b, ex, 0 );
+  b->mode = BPF_ABS;
+}
+
+static void
+emit_program ( struct builder *b,
+               const struct filter_excludes *ex,
+               enum link_type link )
+{
+  if ( b->outgoing )
+    {
+      emit ( b, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE );
+      emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 1, 0 );
+      emit_drop ( b );
+    }
+
+  if ( ex->total_ifaces )
+    {
+      emit ( b, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_IFINDEX );
+      for ( unsigned int i = 0; i < ex->total_ifaces; i++ )
+        emit_drop_if ( b, ex->ifindex[i] );
+    }
+
+  // in loopback the copy received is dropped, so each packet is read once
+  if ( b->loopback )
+    {
+      emit ( b, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_IFINDEX );
+      emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, b->loopback, 0, 3 );
+      emit ( b, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_PKTTYPE );
+      emit_jump ( b, BPF_JMP | BPF_JEQ | BPF_K, PACKET_OUTGOING, 1, 0 );
+      emit_drop ( b );
+    }
+
+  switch ( link )
+    {
+      case LINK_ETHER:
+        emit_eth ( b, ex );
+        break;
+      case LINK_RAW:
+        emit_tun ( b, ex, NO_LABEL );
+        break;
+      default:
+        {
+          int16_t eth = label_new ( b );
+
+          emit_tun ( b, ex, eth );
+          label_bind ( b, eth );
+          emit_eth ( b, ex );
+        }
+    }
+}
+
+bool
+filter_parse_net ( struct exclude_net *net, const char *value )
+{
+  char buff[INET6_ADDRSTRLEN + sizeof ( "/128" )];
+  char *prefix;
+
+  if ( strlen ( value ) >= sizeof ( buff ) )
+    return false;
+
+  strcpy ( buff, value );
+  prefix = strchr ( buff, '/' );
+  if ( prefix )
+    *prefix++ = '\0';
+
+  net->family = ( strchr ( buff, ':' ) ) ? AF_INET6 : AF_INET;
+  memset ( &net->addr, 0, sizeof ( net->addr ) );
+  if ( inet_pton ( net->family, buff, &net->addr ) != 1 )
+    return false;
+
+  long max = ( net->family == AF_INET ) ? 32 : 128;
+  long bits = max;
+  if ( prefix )
+    {
+      char *end;
+
+      errno = 0;
+      bits = strtol ( prefix, &end, 10 );
+      if ( errno || end == prefix || *end != '\0' || bits < 0 || bits > max )
+        return false;
+    }
+
+  net->prefix = bits;
+
+  // clear bits of host
+  for ( unsigned int i = 0; i < 4; i++, bits -= 32 )
+    {
+      if ( bits >= 32 )
+        continue;
+
+      net->addr.all[i] &=
+              htonl ( prefix_mask ( ( bits > 0 ) ? ( unsigned int ) bits : 0 ) );
+    }
+
+  return true;
+}
+
+static bool
+parse_port ( uint16_t *port, const char *value )
+{
+  char *end;
+  long number;
+
+  errno = 0;
+  number = strtol ( value, &end, 10 );
+  if ( errno || end == value || *end != '\0' || number < 1 ||
+       number > UINT16_MAX )
+    return false;
+
+  *port = number;
+  return true;
+}
+
+bool
+filter_exclude_add ( struct filter_excludes *ex,
+                     enum exclude_type type,
+                     const char *value )
+{
+  if ( !value )
+    return false;
+
+  switch ( type )
+    {
+      case EXCLUDE_NET:
+        if ( ex->total_nets == MAX_EXCLUDES ||
+             !filter_parse_net ( &ex->nets[ex->total_nets], value ) )
+          return false;
+
+        ex->total_nets++;
+        break;
+      case EXCLUDE_PORT:
+        if ( ex->total_ports == MAX_EXCLUDES ||
+             !parse_port ( &ex->ports[ex->total_ports], value ) )
+          return false;
+
+        ex->total_ports++;
+        break;
+      case EXCLUDE_IFACE:
+        if ( ex->total_ifaces == MAX_EXCLUDES ||
+             !( ex->ifindex[ex->total_ifaces] = if_nametoindex ( value ) ) )
+          return false;
+
+        ex->total_ifaces++;
+        break;
+      default:
+        return false;
+    }
+
+  return true;
+}
+
+bool
+filter_exclude_load ( struct filter_excludes *ex, const char *path )
+{
+  static const struct
+  {
+    const char *name;
+    enum exclude_type type;
+  } types[] = { { "net", EXCLUDE_NET },
+                { "port", EXCLUDE_PORT },
+                { "iface", EXCLUDE_IFACE } };
+
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    {
+      ERROR_DEBUG ( "\"%s\": %s", path, strerror ( errno ) );
+      return false;
+    }
+
+  char line[256];
+  unsigned int num_line = 0;
+  bool ret = true;
+
+  while ( fgets ( line, sizeof line, file ) )
+    {
+      char name[16], value[128];
+      int total;
+
+      num_line++;
+      total = sscanf ( line, " %15s %127s", name, value );
+      if ( total < 1 || name[0] == '#' )
+        continue;
+
+      unsigned int i;
+      for ( i = 0; i < ARRAY_SIZE ( types ); i++ )
+        {
+          if ( !strcmp ( name, types[i].name ) )
+            break;
+        }
+
+      if ( total != 2 || i == ARRAY_SIZE ( types ) ||
+           !filter_exclude_add ( ex, types[i].type, value ) )
+        {
+          ERROR_DEBUG ( "\"%s\": invalid exclusion in line %u", path, num_line );
+          ret = false;
+          break;
+        }
+    }
+
+  fclose ( file );
+
+  return ret;
+}
+
+static bool
+net_match ( const struct exclude_net *net, const union inet_all *addr )
+{
+  unsigned int bits = net->prefix;
+
+  for ( unsigned int i = 0; i < 4 && bits; i++ )
+    {
+      uint32_t mask = htonl ( prefix_mask ( MIN ( bits, 32U ) ) );
+
+      if ( ( addr->all[i] & mask ) != net->addr.all[i] )
         return false;
+
+      bits -= MIN ( bits, 32U );
+    }
+
+  return true;
+}
+
+bool
+filter_excluded ( const struct filter_excludes *ex,
+                  const struct tuple *tuple,
+                  unsigned int ifindex )
+{
+  for ( unsigned int i = 0; i < ex->total_ifaces; i++ )
+    {
+      if ( ex->ifindex[i] == ifindex )
+        return true;
+    }
+
+  for ( unsigned int i = 0; i < ex->total_ports; i++ )
+    {
+      if ( ex->ports[i] == tuple->l4.local_port ||
+           ex->ports[i] == tuple->l4.remote_port )
+        return true;
+    }
+
+  for ( unsigned int i = 0; i < ex->total_nets; i++ )
+    {
+      const struct exclude_net *net = &ex->nets[i];
+
+      if ( net->family == tuple->family &&
+           ( net_match ( net, &tuple->l3.local ) ||
+             net_match ( net, &tuple->l3.remote ) ) )
+        return true;
+    }
+
+  return false;
+}
+
+static bool
+build_link ( struct sock_fprog *fprog,
+             const struct config_op *co,
+             const struct filter_excludes *ex,
+             enum link_type link )
+{
+  if ( !( co->proto & ( TCP | UDP ) ) )
+    {
+      ERROR_DEBUG ( "%s", "Protocol filter bpf invalid" );
+      return false;
+    }
+
+  struct builder *b = calloc ( 1, sizeof ( *b ) );
+  if ( !b )
+    return false;
+
+  // with snaplen, kernel copy only the headers to ring
+  b->pass = ( co->snaplen ) ? co->snaplen : SNAPLEN_ALL;
+  b->proto = co->proto;
+  b->sample = co->sample;
+  b->outgoing = co->xdp;
+  b->mode = BPF_ABS;
+
+  if ( co->loopback && !( b->loopback = if_nametoindex ( "lo" ) ) )
+    {
+      ERROR_DEBUG ( "%s", "Interface loopback not found" );
+      goto ERROR_EXIT;
+    }
+
+  emit_program ( b, ex, link );
+
+  if ( b->overflow || !resolve_labels ( b ) )
+    {
+      ERROR_DEBUG ( "%s", "Error build filter bpf" );
+      goto ERROR_EXIT;
     }
 
+  fprog->filter = malloc ( b->len * sizeof ( *fprog->filter ) );
+  if ( !fprog->filter )
+    goto ERROR_EXIT;
+
+  memcpy ( fprog->filter, b->insns, b->len * sizeof ( *fprog->filter ) );
+  fprog->len = b->len;
+
+  free ( b );
   return true;
+
+ERROR_EXIT:
+  free ( b );
+  return false;
 }
 
 bool
-filter_set ( int sock, const int flags_proto )
+filter_build ( struct sock_fprog *fprog,
+               const struct config_op *co,
+               enum link_type link )
 {
-  struct sock_fprog fprog;
+  struct filter_excludes ex = co->excludes;
+  if ( co->exclude_file && !filter_exclude_load ( &ex, co->exclude_file ) )
+    return false;
+
+  return build_link ( fprog, co, &ex, link );
+}
 
-  if ( !filter_get ( &fprog, flags_proto ) )
+bool
+filters_build ( struct filters *filters, const struct config_op *co )
+{
+  *filters = ( struct filters ){ 0 };
+
+  struct filter_excludes ex = co->excludes;
+  if ( co->exclude_file && !filter_exclude_load ( &ex, co->exclude_file ) )
     return false;
 
+  for ( unsigned int i = 0; i < TOTAL_LINKS; i++ )
+    {
+      if ( !build_link ( &filters->links[i], co, &ex, i ) )
+        {
+          filters_free ( filters );
+          return false;
+        }
+    }
+
+  return true;
+}
+
+bool
+filter_attach ( int sock, const struct sock_fprog *fprog )
+{
   if ( setsockopt ( sock,
                     SOL_SOCKET,
                     SO_ATTACH_FILTER,
-                    &fprog,
-                    sizeof ( fprog ) ) == -1 )
+                    fprog,
+                    sizeof ( *fprog ) ) == -1 )
     {
       ERROR_DEBUG ( "\"%s\"", strerror ( errno ) );
       return false;
@@ -126,3 +800,18 @@ filter_set ( int sock, const int flags_proto )
 
   return true;
 }
+
+void
+filter_free ( struct sock_fprog *fprog )
+{
+  free ( fprog->filter );
+  fprog->filter = NULL;
+  fprog->len = 0;
+}
+
+void
+filters_free ( struct filters *filters )
+{
+  for ( unsigned int i = 0; i < TOTAL_LINKS; i++ )
+    filter_free ( &filters->links[i] );
+}
@@ -1,4 +1,3 @@
-
 /*
  *  Copyright (C) 2020-2021 Mayco S. Berghetti
  *
@@ -22,8 +21,101 @@
 #define FILTER_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <linux/filter.h>  // struct sock_fprog
+
+#include "sockaddr.h"  // union inet_all
+#include "sock.h"      // enum link_type
+
+/* the classic BPF program attached to sockets is built at runtime, it pass
+   only tcp and/or udp over ipv4 and ipv6 and drop, still in kernel, the
+   traffic of loopback and of the exclusions (networks, ports and
+   interfaces) configured by user.
+   with co->loopback the traffic of interface loopback is passed, but each
+   packet is seen twice (sent and received), so only the copy sent
+   (PACKET_OUTGOING) is passed and the received is never copied to ring */
+
+// max of exclusions of each type
+#define MAX_EXCLUDES 32
+
+enum exclude_type
+{
+  EXCLUDE_NET,    // ipv4 or ipv6 network in notation CIDR, as 10.0.0.0/8
+  EXCLUDE_PORT,   // local or remote port of tcp/udp
+  EXCLUDE_IFACE,  // name of interface
+};
+
+struct exclude_net
+{
+  union inet_all addr;  // already masked by prefix
+  uint8_t prefix;
+  uint8_t family;
+};
+
+struct filter_excludes
+{
+  struct exclude_net nets[MAX_EXCLUDES];
+  uint16_t ports[MAX_EXCLUDES];
+  unsigned int ifindex[MAX_EXCLUDES];
+  unsigned int total_nets;
+  unsigned int total_ports;
+  unsigned int total_ifaces;
+};
+
+struct config_op;
+
+/* network of 'value', as "10.0.0.0/8", "fd00::/8" or "10.0.0.1" (a host),
+   bits of host are cleared. return false if value is invalid */
+bool
+filter_parse_net ( struct exclude_net *net, const char *value );
+
+/* parse value and add the exclusion, return false if value is invalid
+   or if the limit of exclusions of type was reached */
+bool
+filter_exclude_add ( struct filter_excludes *ex,
+                     enum exclude_type type,
+                     const char *value );
 
+/* add exclusions of file, one by line as "net 10.0.0.0/8", "port 873" or
+   "iface eth1", lines empty or started by '#' are ignored */
 bool
-filter_set ( int sock, const int flags_proto );
+filter_exclude_load ( struct filter_excludes *ex, const char *path );
+
+/* same test of exclusions of program of socket, to packets read out of ring
+   (see ebpf_xdp.c), addresses of tuple are in network order */
+bool
+filter_excluded ( const struct filter_excludes *ex,
+                  const struct tuple *tuple,
+                  unsigned int ifindex );
+
+// a program by link type, each socket has the program of its link
+struct filters
+{
+  struct sock_fprog links[TOTAL_LINKS];
+};
+
+/* build the program of frames of 'link' with options of user, exclusions of
+   command line and of exclusions file (re-read on each call). on success
+   fprog->filter must be freed by filter_free */
+bool
+filter_build ( struct sock_fprog *fprog,
+               const struct config_op *co,
+               enum link_type link );
+
+/* build the programs of all link types, as filter_build. on success must be
+   freed by filters_free */
+bool
+filters_build ( struct filters *filters, const struct config_op *co );
+
+/* attach the program to socket, if the socket already has a filter it is
+   replaced atomically */
+bool
+filter_attach ( int sock, const struct sock_fprog *fprog );
+
+void
+filter_free ( struct sock_fprog *fprog );
+
+void
+filters_free ( struct filters *filters );
 
 #endif  // FILTER_H
@@ -0,0 +1,214 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>  // memcmp
+#include <sched.h>   // sched_yield
+
+#include "flow_acc.h"
+#include "hugemem.h"
+#include "connection.h"  // connection_hash_tuple
+#include "pktsize.h"     // pktsize_bucket
+#include "statistics.h"
+
+// initial size of table, keep it as power-of-two
+#define FLOW_ACC_INIT_SIZE 1024
+
+static inline size_t
+flow_acc_index ( const struct flow_acc *acc, const struct packet *pkt )
+{
+  // same flow in both directions, or in two ticks, are two entries
+  return ( connection_hash_tuple ( &pkt->tuple ) ^ pkt->direction ^
+           pkt->tstamp ) &
+         ( acc->size - 1 );
+}
+
+static inline bool
+flow_acc_match ( const struct flow_delta *fd,
+                 const struct packet *pkt,
+                 unsigned int size_bucket )
+{
+  return fd->size_bucket == size_bucket &&
+         fd->pkt.direction == pkt->direction &&
+         fd->pkt.tstamp == pkt->tstamp &&
+         0 == memcmp ( &fd->pkt.tuple, &pkt->tuple, sizeof ( pkt->tuple ) );
+}
+
+bool
+flow_acc_init ( struct flow_acc *acc )
+{
+  acc->slots =
+          hugemem_calloc ( FLOW_ACC_INIT_SIZE, sizeof ( *acc->slots ) );
+  if ( !acc->slots )
+    return false;
+
+  acc->size = FLOW_ACC_INIT_SIZE;
+  acc->used = 0;
+
+  return true;
+}
+
+static bool
+flow_acc_grow ( struct flow_acc *acc )
+{
+  struct flow_acc new_acc = { .size = acc->size << 1, .used = acc->used };
+
+  new_acc.slots =
+          hugemem_calloc ( new_acc.size, sizeof ( *new_acc.slots ) );
+  if ( !new_acc.slots )
+    return false;
+
+  for ( size_t i = 0; i < acc->size; i++ )
+    {
+      if ( !acc->slots[i].packets )
+        continue;
+
+      size_t idx = flow_acc_index ( &new_acc, &acc->slots[i].pkt );
+      while ( new_acc.slots[idx].packets )
+        idx = ( idx + 1 ) & ( new_acc.size - 1 );
+
+      new_acc.slots[idx] = acc->slots[i];
+    }
+
+  hugemem_free ( acc->slots, acc->size, sizeof ( *acc->slots ) );
+  *acc = new_acc;
+
+  return true;
+}
+
+void
+flow_acc_add ( struct flow_acc *acc,
+               const struct packet *pkt,
+               uint64_t bytes,
+               size_t packets )
+{
+  // keep load factor below of 0.5
+  if ( ( acc->used + 1 ) * 2 > acc->size && !flow_acc_grow ( acc ) &&
+       acc->used + 1 == acc->size )
+    return;  // no memory and table full, packet is lost
+
+  unsigned int size_bucket = pktsize_bucket ( bytes, packets );
+
+  size_t idx = flow_acc_index ( acc, pkt );
+  while ( acc->slots[idx].packets )
+    {
+      if ( flow_acc_match ( &acc->slots[idx], pkt, size_bucket ) )
+        {
+          acc->slots[idx].bytes += bytes;
+          acc->slots[idx].pkt.if_index = pkt->if_index;
+          acc->slots[idx].packets += packets;
+          return;
+        }
+
+      idx = ( idx + 1 ) & ( acc->size - 1 );
+    }
+
+  acc->slots[idx].pkt = *pkt;
+  acc->slots[idx].bytes = bytes;
+  acc->slots[idx].packets = packets;
+  acc->slots[idx].size_bucket = size_bucket;
+  acc->used++;
+}
+
+bool
+flow_acc_merge ( struct flow_acc *acc, bool view_conections )
+{
+  bool miss = false;
+
+  for ( size_t i = 0; acc->used && i < acc->size; i++ )
+    {
+      struct flow_delta *fd = &acc->slots[i];
+
+      if ( !fd->packets )
+        continue;
+
+      if ( !statistics_add_n (
+                   &fd->pkt, fd->bytes, fd->packets, view_conections ) )
+        miss = true;
+
+      fd->packets = 0;
+      acc->used--;
+    }
+
+  return miss;
+}
+
+void
+flow_acc_free ( struct flow_acc *acc )
+{
+  hugemem_free ( acc->slots, acc->size, sizeof ( *acc->slots ) );
+  acc->slots = NULL;
+}
+
+bool
+flow_counters_init ( struct flow_counters *fc )
+{
+  if ( !flow_acc_init ( &fc->acc[0] ) || !flow_acc_init ( &fc->acc[1] ) )
+    return false;
+
+  fc->active = &fc->acc[0];
+  fc->in_use = NULL;
+
+  return true;
+}
+
+struct flow_acc *
+flow_counters_enter ( struct flow_counters *fc )
+{
+  /* publish the table in use and check again that it still is the active,
+     so the main thread, that swap before of check 'in_use', always
+     see the table while the writer use it */
+  for ( ;; )
+    {
+      struct flow_acc *acc = __atomic_load_n ( &fc->active, __ATOMIC_ACQUIRE );
+
+      __atomic_store_n ( &fc->in_use, acc, __ATOMIC_SEQ_CST );
+      if ( __atomic_load_n ( &fc->active, __ATOMIC_SEQ_CST ) == acc )
+        return acc;
+    }
+}
+
+void
+flow_counters_leave ( struct flow_counters *fc )
+{
+  __atomic_store_n ( &fc->in_use, NULL, __ATOMIC_RELEASE );
+}
+
+bool
+flow_counters_merge ( struct flow_counters *fc, bool view_conections )
+{
+  struct flow_acc *acc = fc->active;
+
+  __atomic_store_n ( &fc->active,
+                     ( acc == &fc->acc[0] ) ? &fc->acc[1] : &fc->acc[0],
+                     __ATOMIC_SEQ_CST );
+
+  // writer is in a batch with the old table, wait the end of batch
+  while ( __atomic_load_n ( &fc->in_use, __ATOMIC_SEQ_CST ) == acc )
+    sched_yield ();
+
+  return flow_acc_merge ( acc, view_conections );
+}
+
+void
+flow_counters_free ( struct flow_counters *fc )
+{
+  flow_acc_free ( &fc->acc[0] );
+  flow_acc_free ( &fc->acc[1] );
+}
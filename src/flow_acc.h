@@ -0,0 +1,106 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOW_ACC_H
+#define FLOW_ACC_H
+
+#include <stdalign.h>  // alignas
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+#include <stdint.h>
+
+#include "packet.h"
+#include "macro_util.h"  // CACHE_LINE_SIZE
+
+/* counters of flows accumulated by a single writer, as a capture worker or
+   the reader of per-cpu maps of eBPF, and folded in statistics of processes
+   by main thread in each refresh. a packet only touch the table of your
+   writer, without locks or atomics */
+
+/* counters of one flow (tuple + direction + tick + bucket of size), the
+   packets of a flow by bucket of size, so the average size of entry is
+   also of your bucket (see pktsize.h) */
+struct flow_delta
+{
+  struct packet pkt;
+  uint64_t bytes;       // sum of lenght of all packets
+  size_t packets;       // 0 means slot free
+  uint8_t size_bucket;  // of pktsize_bucket
+};
+
+// open addressing table, linear probing
+struct flow_acc
+{
+  struct flow_delta *slots;
+  size_t size;
+  size_t used;
+};
+
+/* double buffer of a writer in other thread, the writer accumulates in
+   table 'active' while the main thread merges the other.
+   each pointer is in your own cache line, 'active' is written only by main
+   thread and 'in_use' only by writer */
+struct flow_counters
+{
+  alignas ( CACHE_LINE_SIZE ) struct flow_acc *active;
+  alignas ( CACHE_LINE_SIZE ) struct flow_acc *in_use;
+  struct flow_acc acc[2];
+};
+
+bool
+flow_acc_init ( struct flow_acc *acc );
+
+/* add 'packets' with total of 'bytes' to flow of 'pkt', without memory
+   and table full the traffic is lost */
+void
+flow_acc_add ( struct flow_acc *acc,
+               const struct packet *pkt,
+               uint64_t bytes,
+               size_t packets );
+
+/* add counters of table in statistics of processes/connections and
+   clear it, return true if any flow not was found (need update of
+   processes) */
+bool
+flow_acc_merge ( struct flow_acc *acc, bool view_conections );
+
+void
+flow_acc_free ( struct flow_acc *acc );
+
+bool
+flow_counters_init ( struct flow_counters *fc );
+
+/* by writer, return the table to accumulate a batch of packets, as a block
+   of ring, until flow_counters_leave */
+struct flow_acc *
+flow_counters_enter ( struct flow_counters *fc );
+
+void
+flow_counters_leave ( struct flow_counters *fc );
+
+/* by main thread, swap tables and merge the table that writer was using,
+   after the writer leave it */
+bool
+flow_counters_merge ( struct flow_counters *fc, bool view_conections );
+
+void
+flow_counters_free ( struct flow_counters *fc );
+
+#endif  // FLOW_ACC_H
@@ -0,0 +1,222 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>      // variable errno
+#include <stdio.h>      // FILE
+#include <string.h>     // memcpy, strerror
+#include <unistd.h>     // close
+#include <arpa/inet.h>  // htonl
+#include <sys/socket.h>
+
+#include "flow_export.h"
+#include "processes.h"  // process_t
+#include "intern.h"
+#include "sock.h"  // socket_resolve
+#include "m_error.h"
+#include "macro_util.h"  // MIN
+
+// bytes of buffer of socket, bursts of connections closed are not lost
+#define SOCK_BUFFER ( 1024 * 1024 )
+
+// largest record, addresses of ipv6, name and counters of 10 bytes
+#define RECORD_MAX ( 2 + 2 * ( 16 + 2 ) + 3 * 5 + FLOW_NAME_MAX + 6 * 10 )
+
+static int sock = -1;
+static FILE *file;
+
+// interval of refresh, milliseconds of each tick
+static unsigned int refresh;
+
+// message in construction, header is written when sent
+static uint8_t msg[FLOW_MESSAGE_MAX];
+static size_t msg_len = FLOW_HEADER_SIZE;
+static uint16_t msg_records;
+static uint32_t seq;
+
+static uint8_t *
+put_varint ( uint8_t *p, uint64_t value )
+{
+  while ( value >= 0x80 )
+    {
+      *p++ = ( value & 0x7f ) | 0x80;
+      value >>= 7;
+    }
+
+  *p++ = value;
+  return p;
+}
+
+static uint8_t *
+put_raw ( uint8_t *p, const void *data, size_t len )
+{
+  memcpy ( p, data, len );
+  return p + len;
+}
+
+static void
+send_message ( void )
+{
+  if ( !msg_records )
+    return;
+
+  uint32_t n_seq = htonl ( seq++ );
+  uint16_t n_records = htons ( msg_records );
+
+  memcpy ( msg, FLOW_MAGIC, FLOW_MAGIC_SIZE );
+  memcpy ( msg + FLOW_MAGIC_SIZE, &n_seq, sizeof n_seq );
+  memcpy ( msg + FLOW_MAGIC_SIZE + sizeof n_seq, &n_records, sizeof n_records );
+
+  // without collector or with buffer full the message is lost
+  if ( sock != -1 && send ( sock, msg, msg_len, MSG_DONTWAIT ) == -1 &&
+       errno != ECONNREFUSED && errno != EAGAIN )
+    {
+      ERROR_DEBUG ( "Error send flows: %s", strerror ( errno ) );
+    }
+
+  if ( file )
+    fwrite ( msg, 1, msg_len, file );
+
+  msg_len = FLOW_HEADER_SIZE;
+  msg_records = 0;
+}
+
+static bool
+open_socket ( const char *value )
+{
+  struct sockaddr_storage addr;
+  socklen_t addr_len;
+
+  if ( !socket_resolve ( value, SOCK_DGRAM, &addr, &addr_len ) )
+    return false;
+
+  sock = socket ( addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0 );
+  if ( sock == -1 )
+    return false;
+
+  int size = SOCK_BUFFER;
+  setsockopt ( sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof size );
+
+  return connect ( sock, ( struct sockaddr * ) &addr, addr_len ) == 0;
+}
+
+bool
+flow_export_init ( const struct config_op *co )
+{
+  refresh = co->refresh;
+
+  if ( co->flow_export && !open_socket ( co->flow_export ) )
+    {
+      ERROR_DEBUG ( "Error open socket to '%s'", co->flow_export );
+      goto ERROR_EXIT;
+    }
+
+  if ( co->flow_file && !( file = fopen ( co->flow_file, "w" ) ) )
+    {
+      ERROR_DEBUG ( "Error open/create file '%s': %s",
+                    co->flow_file,
+                    strerror ( errno ) );
+      goto ERROR_EXIT;
+    }
+
+  return true;
+
+ERROR_EXIT:
+  flow_export_free ();
+  return false;
+}
+
+void
+flow_export_add ( const connection_t *conn )
+{
+  const struct net_stat *ns = &conn->net_stat;
+
+  if ( ( sock == -1 && !file ) || ( !ns->tot_Bps_rx && !ns->tot_Bps_tx ) )
+    return;
+
+  // process still open or the last process of connection
+  const process_t *proc = conn->proc;
+  const char *name = ( proc ) ? proc->name : conn->owner_name;
+  pid_t pid = ( proc ) ? proc->pid : conn->owner_pid;
+  size_t len = ( name ) ? MIN ( intern_len ( name ), FLOW_NAME_MAX ) : 0;
+
+  const struct tuple *t = &conn->tuple;
+  size_t addr_len = ( t->family == AF_INET ) ? 4 : 16;
+  uint16_t local_port = htons ( t->l4.local_port );
+  uint16_t remote_port = htons ( t->l4.remote_port );
+
+  // traffic of packets before of connection be found in update
+  uint32_t start = MIN ( conn->start, ns->sec );
+
+  nstats_t pps_rx, pps_tx;
+  rate_packets ( ns, &pps_rx, &pps_tx );
+
+  uint8_t rec[RECORD_MAX];
+  uint8_t *p = rec;
+
+  *p++ = ( t->family == AF_INET ) ? 4 : 6;
+  *p++ = t->l4.protocol;
+  p = put_raw ( p, &t->l3.local, addr_len );
+  p = put_raw ( p, &local_port, sizeof local_port );
+  p = put_raw ( p, &t->l3.remote, addr_len );
+  p = put_raw ( p, &remote_port, sizeof remote_port );
+  p = put_varint ( p, ( uint32_t ) conn->if_index );
+  p = put_varint ( p, ( uint32_t ) pid );
+  p = put_varint ( p, len );
+  if ( len )
+    p = put_raw ( p, name, len );
+  p = put_varint ( p, ( uint64_t ) start * refresh );
+  p = put_varint ( p, ( uint64_t ) ns->sec * refresh );
+  p = put_varint ( p, ns->tot_Bps_rx );
+  p = put_varint ( p, ns->tot_Bps_tx );
+  p = put_varint ( p, pps_rx );
+  p = put_varint ( p, pps_tx );
+
+  size_t size = p - rec;
+  if ( msg_len + size > sizeof msg || msg_records == UINT16_MAX )
+    send_message ();
+
+  memcpy ( msg + msg_len, rec, size );
+  msg_len += size;
+  msg_records++;
+}
+
+void
+flow_export_flush ( void )
+{
+  send_message ();
+
+  // records of a refresh are not lost if netproc crash
+  if ( file )
+    fflush ( file );
+}
+
+void
+flow_export_free ( void )
+{
+  flow_export_flush ();
+
+  if ( sock != -1 )
+    close ( sock );
+  sock = -1;
+
+  if ( file )
+    fclose ( file );
+  file = NULL;
+}
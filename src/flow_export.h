@@ -0,0 +1,73 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOW_EXPORT_H
+#define FLOW_EXPORT_H
+
+#include <stdbool.h>
+
+#include "connection.h"
+#include "config.h"
+
+/* records of flows of connections closed, with the process of connection,
+   to collectors of flows (as NetFlow) that not know the processes.
+   records are batched in messages of at most FLOW_MESSAGE_MAX bytes, each
+   message is the header (FLOW_MAGIC, sequence of message in 4 bytes and
+   total of records in 2 bytes, in network order) and the records.
+   each record has the fields, unsigned as varint (LEB128, see record.h),
+   except addresses and ports, in network order:
+     family (4 or 6), protocol (6 or 17), local address (4 or 16 bytes),
+     local port (2 bytes), remote address, remote port, index of interface,
+     pid, length of name, name, start and end in milliseconds since epoch,
+     bytes rx, bytes tx, packets rx, packets tx
+   rx is traffic of remote to local. start is the creation of connection
+   and end the last traffic, both rounded to interval of refresh.
+   messages are sent in datagrams UDP (and lost datagrams are seen by
+   sequence) or written in a file, one after other */
+
+#define FLOW_MAGIC "NPFLW\0\0\1"
+#define FLOW_MAGIC_SIZE 8
+
+#define FLOW_HEADER_SIZE ( FLOW_MAGIC_SIZE + 4 + 2 )
+
+// datagrams fit in MTU of 1500 with headers of IPv6 and UDP
+#define FLOW_MESSAGE_MAX 1400
+
+// names of processes longer are truncated
+#define FLOW_NAME_MAX 255
+
+// datagrams to co->flow_export, as "host:port", and/or file co->flow_file
+bool
+flow_export_init ( const struct config_op *co );
+
+/* record of 'conn', removed or still open on exit, sent in next
+   flow_export_flush. connections without traffic are not exported */
+void
+flow_export_add ( const connection_t *conn );
+
+// send messages of records added since last call, once by refresh
+void
+flow_export_flush ( void );
+
+// flush and close
+void
+flow_export_free ( void );
+
+#endif  // FLOW_EXPORT_H
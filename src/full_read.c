@@ -22,32 +22,37 @@
 #include <stdlib.h>  // realloc
 #include <unistd.h>  // read
 
-#define ENTRY_SIZE_BUFF 64
+#include "full_read.h"
 
-ssize_t
-full_read ( const int fd, char **buffer )
+// first size of buffer, enough to most of files of /proc/<pid>/,
+// the buffer double when full, reads of long cmdlines are linear
+#define BUFF_SIZE_INIT 512
+
+// with 'arena' the buffer is of arena, else of malloc
+static ssize_t
+read_all ( const int fd, char **buffer, struct arena *arena )
 {
-  size_t count = 0;
   size_t buff_size = 0;
-  ssize_t total_read = 0;
-  char *p_buf;
+  size_t total_read = 0;
 
   *buffer = NULL;
   while ( 1 )
     {
-      if ( !count )
+      // keep a byte to null terminator
+      if ( total_read + 1 >= buff_size )
         {
-          count = ENTRY_SIZE_BUFF;
-          buff_size += ENTRY_SIZE_BUFF;
-          char *t = realloc ( *buffer, buff_size );
+          size_t size = buff_size ? buff_size * 2 : BUFF_SIZE_INIT;
+          char *t = arena ? arena_realloc ( arena, *buffer, buff_size, size )
+                          : realloc ( *buffer, size );
           if ( !t )
             goto ERROR_EXIT;
 
           *buffer = t;
-          p_buf = t + total_read;
+          buff_size = size;
         }
 
-      ssize_t bytes_read = read ( fd, p_buf, count );
+      ssize_t bytes_read =
+              read ( fd, *buffer + total_read, buff_size - total_read - 1 );
 
       if ( bytes_read == -1 )
         {
@@ -57,19 +62,33 @@ full_read ( const int fd, char **buffer )
           continue;
         }
       else if ( bytes_read )
-        {
-          p_buf += bytes_read;
-          count -= bytes_read;
-          total_read += bytes_read;
-        }
+        total_read += bytes_read;
       else
         break;  // EOF
     }
 
+  ( *buffer )[total_read] = '\0';
+
   return total_read;
 
 ERROR_EXIT:
 
-  free ( *buffer );
+  // memory of arena is released in reset
+  if ( !arena )
+    free ( *buffer );
+
+  *buffer = NULL;
   return -1;
 }
+
+ssize_t
+full_read ( const int fd, char **buffer )
+{
+  return read_all ( fd, buffer, NULL );
+}
+
+ssize_t
+full_read_arena ( const int fd, char **buffer, struct arena *arena )
+{
+  return read_all ( fd, buffer, arena );
+}
@@ -21,10 +21,19 @@
 #ifndef FULL_READ_H
 #define FULL_READ_H
 
+#include <sys/types.h>  // ssize_t
+
+#include "arena.h"
+
 /* read all data from file descriptor fd and alloc memory necessary
    return total bytes read or -1 on failure,
-   if failure is not necessary free the buffer */
+   if failure is not necessary free the buffer.
+   the buffer is null terminated, the terminator not is counted */
 ssize_t
 full_read ( const int fd, char **buffer );
 
+// as full_read, but buffer is of 'arena', not freed by user
+ssize_t
+full_read_arena ( const int fd, char **buffer, struct arena *arena );
+
 #endif  // FULL_READ_H
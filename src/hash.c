@@ -0,0 +1,38 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if defined( __aarch64__ )
+#include <sys/auxv.h>  // getauxval
+#include <asm/hwcap.h>  // HWCAP_CRC32
+#endif
+
+#include "hash.h"
+
+bool hash_crc32c = false;
+
+void
+hash_init ( void )
+{
+#if defined( __x86_64__ )
+  hash_crc32c = __builtin_cpu_supports ( "sse4.2" );
+#elif defined( __aarch64__ )
+  hash_crc32c = !!( getauxval ( AT_HWCAP ) & HWCAP_CRC32 );
+#endif
+}
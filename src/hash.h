@@ -0,0 +1,111 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* hash of keys of fixed size, a key is an array of words of 64 bits and the
+   number of words is known in compilation, so the loop is unrolled.
+   with CRC32C in hardware (SSE4.2 or ARMv8 CRC) each word cost one
+   instruction, without it the words are mixed by multiplication.
+   the implementation is selected in runtime by hash_init, the two give
+   different values, so hash_init must be called before of insert keys */
+
+#if defined( __x86_64__ ) || defined( __aarch64__ )
+#define HASH_HAVE_CRC32C 1
+#endif
+
+// true if hash use instructions of CRC32C, set by hash_init
+extern bool hash_crc32c;
+
+void
+hash_init ( void );
+
+#define HASH_SEED 0x9e3779b9U
+
+static inline uint32_t
+hash_crc32c_u64 ( uint32_t crc, uint64_t word )
+{
+#if defined( __x86_64__ )
+  uint64_t c = crc;
+  __asm__ ( "crc32q %1, %0" : "+r"( c ) : "rm"( word ) );
+  return c;
+#elif defined( __aarch64__ )
+  __asm__ ( ".arch_extension crc\n\t"
+            "crc32cx %w0, %w0, %x1"
+            : "+r"( crc )
+            : "r"( word ) );
+  return crc;
+#else
+  ( void ) word;
+  return crc;
+#endif
+}
+
+// final mix of murmur3 (fmix64)
+static inline uint64_t
+hash_fmix64 ( uint64_t h )
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+
+  return h;
+}
+
+static inline uint32_t
+hash_words ( const uint64_t *words, size_t total )
+{
+#ifdef HASH_HAVE_CRC32C
+  if ( hash_crc32c )
+    {
+      uint32_t crc = HASH_SEED;
+
+      for ( size_t i = 0; i < total; i++ )
+        crc = hash_crc32c_u64 ( crc, words[i] );
+
+      return crc;
+    }
+#endif
+
+  uint64_t h = HASH_SEED;
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      h ^= words[i] * 0x87c37b91114253d5ULL;
+      h = ( ( h << 31 ) | ( h >> 33 ) ) * 0x4cf5ad432745937fULL;
+    }
+
+  return hash_fmix64 ( h ^ total );
+}
+
+static inline uint32_t
+hash_u64 ( uint64_t key )
+{
+  return hash_words ( &key, 1 );
+}
+
+#endif  // HASH_H
@@ -21,8 +21,10 @@
 /* based implementation python
  https://github.com/python/cpython/blob/main/Python/hashtable.c */
 
+#include <stdint.h>  // SIZE_MAX
 #include <stdlib.h>
 #include "slist.h"
+#include "pool.h"
 #include "hashtable.h"
 
 #define HASHTABLE_MIN_SIZE 16
@@ -30,12 +32,55 @@
 #define HASHTABLE_LOW 0.10
 #define HASHTABLE_REHASH_FACTOR 2.0 / ( HASHTABLE_LOW + HASHTABLE_HIGH )
 
+// buckets moved to new array on each insert or remove while resizing
+#define HASHTABLE_REHASH_STEP 4
+
+// entries allocated at once by pool of table
+#define HASHTABLE_SLAB_ENTRIES 128
+
+// bytes of arrays of buckets of all tables, to hashtable_memory
+static size_t buckets_memory = 0;
+
+static slist_t *
+buckets_alloc ( size_t nbuckets )
+{
+  slist_t *buckets = calloc ( nbuckets, sizeof ( *buckets ) );
+
+  if ( buckets )
+    __atomic_add_fetch (
+            &buckets_memory, nbuckets * sizeof ( *buckets ), __ATOMIC_RELAXED );
+
+  return buckets;
+}
+
+static void
+buckets_free ( slist_t *buckets, size_t nbuckets )
+{
+  if ( !buckets )
+    return;
+
+  __atomic_sub_fetch (
+          &buckets_memory, nbuckets * sizeof ( *buckets ), __ATOMIC_RELAXED );
+  free ( buckets );
+}
+
 typedef struct hashtable
 {
   size_t nentries;  // Total number of entries in the table
   size_t nbuckets;
   slist_t *buckets;
 
+  /* while resizing, the entries of old buckets from 'rehash_idx' not were
+     moved to 'buckets' yet. the resize is incremental, so the cost of a
+     insert or remove is bounded */
+  slist_t *old_buckets;
+  size_t old_nbuckets;
+  size_t rehash_idx;
+
+  size_t min_buckets;  // not shrink below of it
+
+  struct pool entries;  // entries allocated of table
+
   func_hash fhash;        // callback hash function
   func_compare fcompare;  // callback compare keys
   func_clear fclear;      // callback clear data from user
@@ -86,34 +131,75 @@ get_index ( hash_t hash, size_t size )
   return ( hash & ( size - 1 ) );
 }
 
-static bool
-hashtable_rehash ( hashtable_t *ht )
+/* the bucket of 'hash', old bucket if still not moved. all operations use
+   the same bucket, so the entry is only in one place */
+static inline slist_t *
+get_bucket ( const hashtable_t *ht, hash_t hash )
 {
-  size_t num_buckets =
-          next_power2 ( ( size_t ) ( ht->nentries * HASHTABLE_REHASH_FACTOR ) );
+  if ( ht->old_buckets )
+    {
+      size_t index = get_index ( hash, ht->old_nbuckets );
 
-  if ( num_buckets == ht->nbuckets )
-    return true;
+      if ( index >= ht->rehash_idx )
+        return &ht->old_buckets[index];
+    }
 
-  slist_t *new_buckets = calloc ( num_buckets, sizeof ( ht->buckets[0] ) );
-  if ( !new_buckets )
-    return false;
+  return &ht->buckets[get_index ( hash, ht->nbuckets )];
+}
 
-  for ( size_t i = 0; i < ht->nbuckets; i++ )
+// move entries of up 'steps' old buckets to new buckets
+static void
+rehash_step ( hashtable_t *ht, size_t steps )
+{
+  while ( ht->old_buckets && steps-- )
     {
-      hashtable_entry_t *entry = TABLE_HEAD ( ht, i );
+      slist_t *bucket = &ht->old_buckets[ht->rehash_idx];
+      hashtable_entry_t *entry = ( hashtable_entry_t * ) bucket->head;
+
       while ( entry )
         {
           hashtable_entry_t *next = ENTRY_NEXT ( entry );
 
-          size_t index = get_index ( entry->key_hash, num_buckets );
-          slist_preprend ( &new_buckets[index], ( slist_item_t * ) entry );
+          size_t index = get_index ( entry->key_hash, ht->nbuckets );
+          slist_preprend ( &ht->buckets[index], ( slist_item_t * ) entry );
 
           entry = next;
         }
+
+      bucket->head = NULL;
+
+      if ( ++ht->rehash_idx == ht->old_nbuckets )
+        {
+          buckets_free ( ht->old_buckets, ht->old_nbuckets );
+          ht->old_buckets = NULL;
+        }
     }
+}
+
+// start a resize, the entries are moved by rehash_step
+static bool
+hashtable_rehash ( hashtable_t *ht )
+{
+  size_t num_buckets =
+          next_power2 ( ( size_t ) ( ht->nentries * HASHTABLE_REHASH_FACTOR ) );
+
+  if ( num_buckets < ht->min_buckets )
+    num_buckets = ht->min_buckets;
+
+  if ( num_buckets == ht->nbuckets )
+    return true;
+
+  slist_t *new_buckets = buckets_alloc ( num_buckets );
+  if ( !new_buckets )
+    return false;
+
+  // only one resize at a time, rare with HASHTABLE_REHASH_STEP
+  rehash_step ( ht, SIZE_MAX );
+
+  ht->old_buckets = ht->buckets;
+  ht->old_nbuckets = ht->nbuckets;
+  ht->rehash_idx = 0;
 
-  free ( ht->buckets );
   ht->nbuckets = num_buckets;
   ht->buckets = new_buckets;
 
@@ -130,14 +216,21 @@ hashtable_min_new ( void )
 
   ht->nentries = 0;
   ht->nbuckets = HASHTABLE_MIN_SIZE;
+  ht->min_buckets = HASHTABLE_MIN_SIZE;
+  ht->old_buckets = NULL;
 
-  ht->buckets = calloc ( ht->nbuckets, sizeof ( ht->buckets[0] ) );
+  ht->buckets = buckets_alloc ( ht->nbuckets );
   if ( !ht->buckets )
     {
       free ( ht );
       return NULL;
     }
 
+  pool_init ( &ht->entries,
+              "hashtable entries",
+              sizeof ( hashtable_entry_t ),
+              HASHTABLE_SLAB_ENTRIES );
+
   return ht;
 }
 
@@ -162,7 +255,7 @@ hashtable_min_set ( hashtable_t *ht,
                     const void *key,
                     const hash_t hash )
 {
-  hashtable_entry_t *entry = malloc ( sizeof *entry );
+  hashtable_entry_t *entry = pool_alloc ( &ht->entries );
 
   if ( !entry )
     return NULL;
@@ -171,19 +264,20 @@ hashtable_min_set ( hashtable_t *ht,
   entry->key = ( void * ) key;
   entry->value = value;
 
+  rehash_step ( ht, HASHTABLE_REHASH_STEP );
+
   ht->nentries++;
   if ( ( float ) ht->nentries / ( float ) ht->nbuckets > HASHTABLE_HIGH )
     {
       if ( !hashtable_rehash ( ( hashtable_t * ) ht ) )
         {
           ht->nentries--;
-          free ( entry );
+          pool_free ( &ht->entries, entry );
           return NULL;
         }
     }
 
-  size_t index = get_index ( entry->key_hash, ht->nbuckets );
-  slist_preprend ( &ht->buckets[index], ( slist_item_t * ) entry );
+  slist_preprend ( get_bucket ( ht, hash ), ( slist_item_t * ) entry );
 
   return value;
 }
@@ -200,9 +294,9 @@ get_entry ( hashtable_t *restrict ht,
             hash_t hash,
             func_compare cmp )
 {
-  size_t index = get_index ( hash, ht->nbuckets );
+  hashtable_entry_t *entry =
+          ( hashtable_entry_t * ) get_bucket ( ht, hash )->head;
 
-  hashtable_entry_t *entry = TABLE_HEAD ( ht, index );
   while ( entry )
     {
       if ( entry->key_hash == hash && cmp ( entry->key, key ) )
@@ -239,6 +333,25 @@ hashtable_get ( hashtable_t *restrict ht, const void *restrict key )
   return entry;
 }
 
+void
+hashtable_min_prefetch_bucket ( hashtable_t *ht, hash_t hash )
+{
+  __builtin_prefetch ( get_bucket ( ht, hash ) );
+}
+
+void
+hashtable_min_prefetch_entry ( hashtable_t *ht, hash_t hash )
+{
+  hashtable_entry_t *entry =
+          ( hashtable_entry_t * ) get_bucket ( ht, hash )->head;
+
+  if ( entry )
+    {
+      __builtin_prefetch ( entry );
+      __builtin_prefetch ( entry->value );
+    }
+}
+
 size_t
 hashtable_get_nentries ( hashtable_t *ht )
 {
@@ -251,14 +364,25 @@ hashtable_get_size ( hashtable_t *ht )
   return ht->nbuckets;
 }
 
-int
-hashtable_foreach ( hashtable_t *restrict ht,
-                    hashtable_foreach_func func,
-                    void *user_data )
+void
+hashtable_set_min_size ( hashtable_t *ht, size_t nbuckets )
 {
-  for ( size_t i = 0; i < ht->nbuckets; i++ )
+  nbuckets = next_power2 ( nbuckets );
+
+  ht->min_buckets =
+          ( nbuckets > HASHTABLE_MIN_SIZE ) ? nbuckets : HASHTABLE_MIN_SIZE;
+}
+
+static int
+foreach_buckets ( hashtable_t *restrict ht,
+                  slist_t *buckets,
+                  size_t nbuckets,
+                  hashtable_foreach_func func,
+                  void *user_data )
+{
+  for ( size_t i = 0; i < nbuckets; i++ )
     {
-      hashtable_entry_t *entry = TABLE_HEAD ( ht, i );
+      hashtable_entry_t *entry = ( hashtable_entry_t * ) buckets[i].head;
       while ( entry )
         {
           hashtable_entry_t *entry_next = ENTRY_NEXT ( entry );
@@ -274,14 +398,33 @@ hashtable_foreach ( hashtable_t *restrict ht,
   return 0;
 }
 
-void
-hashtable_foreach_remove ( hashtable_t *restrict ht,
-                           hashtable_foreach_func to_remove,
-                           void *user_data )
+int
+hashtable_foreach ( hashtable_t *restrict ht,
+                    hashtable_foreach_func func,
+                    void *user_data )
 {
-  for ( size_t i = 0; i < ht->nbuckets; i++ )
+  // old buckets already moved are empty
+  if ( ht->old_buckets )
     {
-      hashtable_entry_t *entry = TABLE_HEAD ( ht, i );
+      int ret = foreach_buckets (
+              ht, ht->old_buckets, ht->old_nbuckets, func, user_data );
+      if ( ret )
+        return ret;
+    }
+
+  return foreach_buckets ( ht, ht->buckets, ht->nbuckets, func, user_data );
+}
+
+static void
+foreach_remove_buckets ( hashtable_t *restrict ht,
+                         slist_t *buckets,
+                         size_t nbuckets,
+                         hashtable_foreach_func to_remove,
+                         void *user_data )
+{
+  for ( size_t i = 0; i < nbuckets; i++ )
+    {
+      hashtable_entry_t *entry = ( hashtable_entry_t * ) buckets[i].head;
       hashtable_entry_t *prev = NULL;
       while ( entry )
         {
@@ -289,10 +432,10 @@ hashtable_foreach_remove ( hashtable_t *restrict ht,
 
           if ( to_remove ( ( hashtable_t * ) ht, entry->value, user_data ) )
             {
-              slist_remove ( &ht->buckets[i],
+              slist_remove ( &buckets[i],
                              ( slist_item_t * ) prev,
                              ( slist_item_t * ) entry );
-              free ( entry );
+              pool_free ( &ht->entries, entry );
               ht->nentries--;
             }
           else
@@ -305,15 +448,30 @@ hashtable_foreach_remove ( hashtable_t *restrict ht,
     }
 }
 
+void
+hashtable_foreach_remove ( hashtable_t *restrict ht,
+                           hashtable_foreach_func to_remove,
+                           void *user_data )
+{
+  if ( ht->old_buckets )
+    foreach_remove_buckets (
+            ht, ht->old_buckets, ht->old_nbuckets, to_remove, user_data );
+
+  foreach_remove_buckets (
+          ht, ht->buckets, ht->nbuckets, to_remove, user_data );
+}
+
 void *
 hashtable_min_remove ( hashtable_t *restrict ht,
                        const void *key,
                        hash_t hash,
                        func_compare cmp )
 {
-  size_t index = get_index ( hash, ht->nbuckets );
+  rehash_step ( ht, HASHTABLE_REHASH_STEP );
+
+  slist_t *bucket = get_bucket ( ht, hash );
 
-  hashtable_entry_t *entry = TABLE_HEAD ( ht, index );
+  hashtable_entry_t *entry = ( hashtable_entry_t * ) bucket->head;
   hashtable_entry_t *prev = NULL;
   while ( entry )
     {
@@ -327,16 +485,15 @@ hashtable_min_remove ( hashtable_t *restrict ht,
   if ( entry == NULL )
     return NULL;
 
-  slist_remove ( &ht->buckets[index],
-                 ( slist_item_t * ) prev,
-                 ( slist_item_t * ) entry );
+  slist_remove ( bucket, ( slist_item_t * ) prev, ( slist_item_t * ) entry );
 
   void *value = entry->value;
-  free ( entry );
+  pool_free ( &ht->entries, entry );
 
   ht->nentries--;
 
-  if ( ( float ) ht->nentries / ( float ) ht->nbuckets < HASHTABLE_LOW )
+  if ( ht->nbuckets > ht->min_buckets &&
+       ( float ) ht->nentries / ( float ) ht->nbuckets < HASHTABLE_LOW )
     hashtable_rehash ( ht );
 
   return value;
@@ -348,19 +505,14 @@ hashtable_remove ( hashtable_t *restrict ht, const void *key )
   return hashtable_min_remove ( ht, key, ht->fhash ( key ), ht->fcompare );
 }
 
-static inline void
-destroy_entry ( func_clear fclear, hashtable_entry_t *entry )
-{
-  if ( fclear )
-    fclear ( entry->value );
-
-  free ( entry );
-}
-
 void
 hashtable_min_detroy ( hashtable_t *ht, func_clear fclear )
 {
-  for ( size_t i = 0; i < ht->nbuckets; i++ )
+  // all entries in new buckets
+  rehash_step ( ht, SIZE_MAX );
+
+  // entries are released with pool, only the values need be cleared
+  for ( size_t i = 0; fclear && i < ht->nbuckets; i++ )
     {
       if ( !ht->nentries )
         break;
@@ -368,17 +520,24 @@ hashtable_min_detroy ( hashtable_t *ht, func_clear fclear )
       hashtable_entry_t *entry = TABLE_HEAD ( ht, i );
       while ( entry )
         {
-          hashtable_entry_t *entry_next = ENTRY_NEXT ( entry );
-          destroy_entry ( fclear, entry );
+          fclear ( entry->value );
           ht->nentries--;
-          entry = entry_next;
+          entry = ENTRY_NEXT ( entry );
         }
     }
 
-  free ( ht->buckets );
+  pool_destroy ( &ht->entries );
+  buckets_free ( ht->buckets, ht->nbuckets );
   free ( ht );
 }
 
+size_t
+hashtable_memory ( void )
+{
+  return __atomic_load_n ( &buckets_memory, __ATOMIC_RELAXED ) +
+         pool_memory_used ( "hashtable entries" );
+}
+
 void
 hashtable_destroy ( hashtable_t *ht )
 {
@@ -64,12 +64,27 @@ hashtable_min_get ( hashtable_t *ht,
 void *
 hashtable_get ( hashtable_t *ht, const void *key );
 
+/* hints to lookups in batch, first prefetch the buckets of all keys, after
+   that the buckets are in cache, prefetch the first entry of each bucket.
+   only hints, no effect in the content of hashtable */
+void
+hashtable_min_prefetch_bucket ( hashtable_t *ht, hash_t hash );
+
+void
+hashtable_min_prefetch_entry ( hashtable_t *ht, hash_t hash );
+
 size_t
 hashtable_get_nentries ( hashtable_t *ht );
 
 size_t
 hashtable_get_size ( hashtable_t *ht );
 
+/* the resize of hashtable is incremental, some buckets are moved in each
+   insert or remove. the hashtable is not shrunk below of 'nbuckets'
+   (rounded up to power of 2), applied in next resize */
+void
+hashtable_set_min_size ( hashtable_t *ht, size_t nbuckets );
+
 /* to each entries in hashtable, the function 'func' is called
     and passes as argument the entrie and 'user_data',
     if 'func' return different of zero hashtable_foreach stop
@@ -106,4 +121,8 @@ hashtable_min_detroy ( hashtable_t *ht, func_clear fclear );
 void
 hashtable_destroy ( hashtable_t *ht );
 
+// bytes of buckets and entries in use of all tables
+size_t
+hashtable_memory ( void );
+
 #endif  // HASHTABLE_H
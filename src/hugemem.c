@@ -0,0 +1,139 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>    // uintptr_t
+#include <stdlib.h>    // calloc
+#include <sys/mman.h>  // mmap
+
+#include "hugemem.h"
+#include "m_error.h"
+
+// less than half page not worth a huge page
+#define HUGEMEM_MIN ( HUGEMEM_PAGE / 2 )
+
+#define ALIGN_UP( n, a ) ( ( ( n ) + ( a ) - 1 ) & ~( ( size_t ) ( a ) - 1 ) )
+
+static bool enabled = false;
+
+// used by threads of capture and of resolver
+static size_t bytes_huge = 0;
+
+void
+hugemem_init ( bool enable )
+{
+  enabled = enable;
+}
+
+bool
+hugemem_enabled ( void )
+{
+  return enabled;
+}
+
+bool
+hugemem_is_huge ( size_t size )
+{
+  return enabled && size >= HUGEMEM_MIN;
+}
+
+// mapping aligned to huge page, the kernel can use transparent huge pages
+static void *
+map_aligned ( size_t len )
+{
+  uint8_t *p = mmap ( NULL,
+                      len + HUGEMEM_PAGE,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1,
+                      0 );
+
+  if ( p == MAP_FAILED )
+    return NULL;
+
+  // unmap the excess before and after of aligned block
+  uint8_t *start = ( uint8_t * ) ALIGN_UP ( ( uintptr_t ) p, HUGEMEM_PAGE );
+  size_t head = start - p;
+
+  if ( head )
+    munmap ( p, head );
+
+  munmap ( start + len, HUGEMEM_PAGE - head );
+
+#ifdef MADV_HUGEPAGE
+  if ( -1 == madvise ( start, len, MADV_HUGEPAGE ) )
+    {
+      ERROR_DEBUG ( "madvise: %s", strerror ( errno ) );
+    }
+#endif
+
+  return start;
+}
+
+void *
+hugemem_calloc ( size_t nmemb, size_t size )
+{
+  if ( size && nmemb > SIZE_MAX / size )
+    return NULL;
+
+  if ( !hugemem_is_huge ( nmemb * size ) )
+    return calloc ( nmemb, size );
+
+  size_t len = ALIGN_UP ( nmemb * size, HUGEMEM_PAGE );
+
+  // anonymous mappings are zeroed
+  void *p = mmap ( NULL,
+                   len,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                   -1,
+                   0 );
+
+  if ( p == MAP_FAILED )
+    p = map_aligned ( len );
+
+  if ( p )
+    __atomic_add_fetch ( &bytes_huge, len, __ATOMIC_RELAXED );
+
+  return p;
+}
+
+void
+hugemem_free ( void *ptr, size_t nmemb, size_t size )
+{
+  if ( !ptr )
+    return;
+
+  if ( !hugemem_is_huge ( nmemb * size ) )
+    {
+      free ( ptr );
+      return;
+    }
+
+  size_t len = ALIGN_UP ( nmemb * size, HUGEMEM_PAGE );
+
+  munmap ( ptr, len );
+  __atomic_sub_fetch ( &bytes_huge, len, __ATOMIC_RELAXED );
+}
+
+size_t
+hugemem_bytes ( void )
+{
+  return __atomic_load_n ( &bytes_huge, __ATOMIC_RELAXED );
+}
@@ -0,0 +1,60 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HUGEMEM_H
+#define HUGEMEM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* memory of large tables (flow tables, slabs of pools) in huge pages of
+   2 MiB, less misses of TLB with many flows.
+   first try pages reserved in hugetlbfs (vm.nr_hugepages), without them
+   a mapping aligned to 2 MiB is advised to transparent huge pages.
+   small blocks, or with huge pages disabled, are of malloc.
+   blocks in huge pages are aligned to HUGEMEM_PAGE */
+
+// size of a huge page
+#define HUGEMEM_PAGE ( 2U << 20 )
+
+// enable (or disable) huge pages to allocations of now on
+void
+hugemem_init ( bool enable );
+
+bool
+hugemem_enabled ( void );
+
+// true if a block of 'size' bytes is mapped in huge pages
+bool
+hugemem_is_huge ( size_t size );
+
+// memory zeroed, as calloc, 'size' is needed in hugemem_free
+void *
+hugemem_calloc ( size_t nmemb, size_t size );
+
+// 'nmemb' and 'size' are the same of hugemem_calloc
+void
+hugemem_free ( void *ptr, size_t nmemb, size_t size );
+
+// bytes mapped in huge pages, reserved or transparent
+size_t
+hugemem_bytes ( void );
+
+#endif  // HUGEMEM_H
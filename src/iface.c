@@ -0,0 +1,279 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// references
+// linux/rtnetlink.h, linux/if_link.h, man 7 rtnetlink
+
+#include <errno.h>   // variable errno
+#include <poll.h>    // poll
+#include <stdint.h>  // uint32_t
+#include <stdlib.h>  // malloc
+#include <string.h>  // strerror, memcpy
+#include <unistd.h>  // close
+#include <net/if.h>  // if_indextoname, IF_NAMESIZE
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "iface.h"
+#include "hashtable.h"
+#include "hash.h"
+#include "macro_util.h"
+#include "m_error.h"
+
+// time in milliseconds to wait each message of dump of links
+#define DUMP_TIMEOUT 1000
+
+struct iface
+{
+  int index;
+  char name[IF_NAMESIZE];
+};
+
+static hashtable_t *ht_iface;
+static int sock = -1;
+
+// aligned to struct nlmsghdr
+static uint32_t buf[8192 / sizeof ( uint32_t )];
+
+static bool
+ht_cb_compare ( const void *key1, const void *key2 )
+{
+  return ( *( const int * ) key1 == *( const int * ) key2 );
+}
+
+static hash_t
+ht_cb_hash ( const void *key )
+{
+  return hash_u64 ( ( uint32_t ) * ( const int * ) key );
+}
+
+static void
+link_new ( int index, const char *name, size_t len )
+{
+  struct iface *iface = hashtable_get ( ht_iface, &index );
+
+  if ( !iface )
+    {
+      iface = malloc ( sizeof *iface );
+      if ( !iface )
+        return;
+
+      iface->index = index;
+      if ( !hashtable_set ( ht_iface, &iface->index, iface ) )
+        {
+          free ( iface );
+          return;
+        }
+    }
+
+  // interface can be renamed
+  if ( len >= sizeof iface->name )
+    len = sizeof iface->name - 1;
+
+  memcpy ( iface->name, name, len );
+  iface->name[len] = '\0';
+}
+
+static void
+link_del ( int index )
+{
+  free ( hashtable_remove ( ht_iface, &index ) );
+}
+
+static int
+link_remove ( UNUSED hashtable_t *ht, void *value, UNUSED void *user_data )
+{
+  free ( value );
+  return 1;
+}
+
+/* handle messages of links, of dump or notifications.
+   return true if the dump finished */
+static bool
+handle_msg ( const struct nlmsghdr *nlh, ssize_t len )
+{
+  bool done = false;
+
+  for ( ; NLMSG_OK ( nlh, len ); nlh = NLMSG_NEXT ( nlh, len ) )
+    {
+      if ( nlh->nlmsg_type == NLMSG_DONE || nlh->nlmsg_type == NLMSG_ERROR )
+        {
+          done = true;
+          continue;
+        }
+
+      if ( nlh->nlmsg_type != RTM_NEWLINK && nlh->nlmsg_type != RTM_DELLINK )
+        continue;
+
+      const struct ifinfomsg *ifi = NLMSG_DATA ( nlh );
+      if ( nlh->nlmsg_len < NLMSG_LENGTH ( sizeof ( *ifi ) ) )
+        continue;
+
+      if ( nlh->nlmsg_type == RTM_DELLINK )
+        {
+          link_del ( ifi->ifi_index );
+          continue;
+        }
+
+      int attr_len = nlh->nlmsg_len - NLMSG_LENGTH ( sizeof ( *ifi ) );
+      const struct rtattr *rta = IFLA_RTA ( ifi );
+
+      for ( ; RTA_OK ( rta, attr_len ); rta = RTA_NEXT ( rta, attr_len ) )
+        {
+          if ( rta->rta_type != IFLA_IFNAME )
+            continue;
+
+          // name already with null byte
+          link_new ( ifi->ifi_index, RTA_DATA ( rta ), RTA_PAYLOAD ( rta ) );
+          break;
+        }
+    }
+
+  return done;
+}
+
+// request all links of kernel, notifications in middle are also handled
+static bool
+dump_links ( void )
+{
+  struct
+  {
+    struct nlmsghdr nlh;
+    struct ifinfomsg ifi;
+  } req = { .nlh = { .nlmsg_len = sizeof ( req ),
+                     .nlmsg_type = RTM_GETLINK,
+                     .nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+                     .nlmsg_seq = 1 },
+            .ifi = { .ifi_family = AF_UNSPEC } };
+
+  if ( send ( sock, &req, sizeof ( req ), 0 ) == -1 )
+    {
+      ERROR_DEBUG ( "Error send dump of links: %s", strerror ( errno ) );
+      return false;
+    }
+
+  struct pollfd pfd = { .fd = sock, .events = POLLIN };
+
+  while ( poll ( &pfd, 1, DUMP_TIMEOUT ) > 0 )
+    {
+      ssize_t len = recv ( sock, buf, sizeof ( buf ), 0 );
+      if ( len <= 0 )
+        break;
+
+      if ( handle_msg ( ( struct nlmsghdr * ) buf, len ) )
+        return true;
+    }
+
+  ERROR_DEBUG ( "%s", "dump of links not finished" );
+  return false;
+}
+
+bool
+iface_init ( void )
+{
+  ht_iface = hashtable_new ( ht_cb_hash, ht_cb_compare, free );
+  if ( !ht_iface )
+    return false;
+
+  sock = socket ( AF_NETLINK,
+                  SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                  NETLINK_ROUTE );
+  if ( sock == -1 )
+    {
+      ERROR_DEBUG ( "Error create socket rtnetlink: %s", strerror ( errno ) );
+      goto ERROR;
+    }
+
+  struct sockaddr_nl addr = { .nl_family = AF_NETLINK,
+                              .nl_groups = RTMGRP_LINK };
+
+  if ( bind ( sock, ( struct sockaddr * ) &addr, sizeof ( addr ) ) == -1 )
+    {
+      ERROR_DEBUG ( "Error bind rtnetlink: %s", strerror ( errno ) );
+      goto ERROR;
+    }
+
+  if ( !dump_links () )
+    goto ERROR;
+
+  return true;
+
+ERROR:
+  iface_free ();
+  return false;
+}
+
+void
+iface_update ( void )
+{
+  if ( sock == -1 )
+    return;
+
+  while ( 1 )
+    {
+      ssize_t len = recv ( sock, buf, sizeof ( buf ), 0 );
+
+      if ( len > 0 )
+        {
+          handle_msg ( ( struct nlmsghdr * ) buf, len );
+          continue;
+        }
+
+      // notifications lost, table is read again
+      if ( len == -1 && errno == ENOBUFS )
+        {
+          hashtable_foreach_remove ( ht_iface, link_remove, NULL );
+          if ( !dump_links () )
+            {
+              ERROR_DEBUG ( "%s", "Error read links again" );
+            }
+          continue;
+        }
+
+      break;
+    }
+}
+
+const char *
+iface_name ( int index )
+{
+  if ( sock == -1 )
+    {
+      static char name[IF_NAMESIZE];
+      return if_indextoname ( index, name );
+    }
+
+  struct iface *iface = hashtable_get ( ht_iface, &index );
+
+  return ( iface ) ? iface->name : NULL;
+}
+
+void
+iface_free ( void )
+{
+  if ( sock != -1 )
+    close ( sock );
+  sock = -1;
+
+  if ( ht_iface )
+    hashtable_destroy ( ht_iface );
+  ht_iface = NULL;
+}
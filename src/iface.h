@@ -0,0 +1,46 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IFACE_H
+#define IFACE_H
+
+#include <stdbool.h>
+
+/* names of interfaces by index, read of kernel (rtnetlink) once in start
+   and kept updated with notifications of links created, renamed and
+   removed, so the name of interface of each connection not costs a
+   syscall by row in each refresh */
+
+bool
+iface_init ( void );
+
+// read the pending notifications of links, called in each refresh
+void
+iface_update ( void );
+
+/* name of interface 'index', NULL if unknown. without iface_init the
+   name is read of kernel in each call */
+const char *
+iface_name ( int index );
+
+void
+iface_free ( void );
+
+#endif  // IFACE_H
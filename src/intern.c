@@ -0,0 +1,187 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>  // malloc
+#include <string.h>  // memcpy
+
+#include "intern.h"
+#include "hash.h"
+
+struct istr
+{
+  hash_t hash;
+  unsigned int refs;
+  unsigned int len;
+  unsigned int prog_len;
+  unsigned int base;
+  char str[];
+};
+
+// string to search in table, not null terminated
+struct key
+{
+  const char *str;
+  size_t len;
+};
+
+#define ISTR( s ) \
+  ( ( struct istr * ) ( ( char * ) ( s ) - offsetof ( struct istr, str ) ) )
+
+// key is the string of struct istr, created with first string
+static hashtable_t *ht_strings = NULL;
+
+static hash_t
+hash_str ( const char *str, size_t len )
+{
+  uint64_t h = 0;
+
+  for ( size_t i = 0; i < len; i++ )
+    h = h * 31 + ( unsigned char ) str[i];
+
+  return hash_u64 ( h );
+}
+
+static bool
+cb_compare ( const void *key1, const void *key2 )
+{
+  const struct istr *is = ISTR ( key1 );
+  const struct key *key = key2;
+
+  return is->len == key->len && !memcmp ( is->str, key->str, key->len );
+}
+
+static bool
+cb_same ( const void *key1, const void *key2 )
+{
+  return key1 == key2;
+}
+
+static struct istr *
+istr_new ( const char *str, size_t len, hash_t hash )
+{
+  struct istr *is = malloc ( sizeof *is + len + 1 );
+  if ( !is )
+    return NULL;
+
+  memcpy ( is->str, str, len );
+  is->str[len] = '\0';
+  is->hash = hash;
+  is->refs = 1;
+  is->len = len;
+
+  const char *space = memchr ( str, ' ', len );
+  is->prog_len = space ? ( size_t ) ( space - str ) : len;
+
+  is->base = 0;
+  for ( size_t i = 0; i < is->prog_len; i++ )
+    {
+      if ( str[i] == '/' )
+        is->base = i + 1;
+    }
+
+  return is;
+}
+
+const char *
+intern ( const char *str, size_t len )
+{
+  if ( !ht_strings && !( ht_strings = hashtable_min_new () ) )
+    return NULL;
+
+  hash_t hash = hash_str ( str, len );
+  struct key key = { .str = str, .len = len };
+
+  struct istr *is = hashtable_min_get ( ht_strings, &key, hash, cb_compare );
+  if ( is )
+    {
+      is->refs++;
+      return is->str;
+    }
+
+  if ( !( is = istr_new ( str, len, hash ) ) )
+    return NULL;
+
+  if ( !hashtable_min_set ( ht_strings, is, is->str, hash ) )
+    {
+      free ( is );
+      return NULL;
+    }
+
+  return is->str;
+}
+
+const char *
+intern_ref ( const char *istr )
+{
+  ISTR ( istr )->refs++;
+
+  return istr;
+}
+
+void
+intern_put ( const char *istr )
+{
+  if ( !istr )
+    return;
+
+  struct istr *is = ISTR ( istr );
+  if ( --is->refs )
+    return;
+
+  hashtable_min_remove ( ht_strings, is->str, is->hash, cb_same );
+  free ( is );
+
+  // without strings, as on exit
+  if ( !hashtable_get_nentries ( ht_strings ) )
+    {
+      hashtable_min_detroy ( ht_strings, NULL );
+      ht_strings = NULL;
+    }
+}
+
+size_t
+intern_len ( const char *istr )
+{
+  return ISTR ( istr )->len;
+}
+
+size_t
+intern_prog_len ( const char *istr )
+{
+  return ISTR ( istr )->prog_len;
+}
+
+size_t
+intern_base ( const char *istr )
+{
+  return ISTR ( istr )->base;
+}
+
+hash_t
+intern_hash ( const char *istr )
+{
+  return ISTR ( istr )->hash;
+}
+
+size_t
+intern_total ( void )
+{
+  return ht_strings ? hashtable_get_nentries ( ht_strings ) : 0;
+}
@@ -0,0 +1,66 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+#include "hashtable.h"  // hash_t
+
+/* table of strings interned, each distinct string is stored only once and
+   shared with count of references, so strings equal are the same pointer
+   and are compared as pointers.
+   the strings are immutable, with length, length of program (until first
+   space), offset of basename of program and hash precomputed.
+   only functions of this module can receive strings interned.
+   not is thread safe, used only by main thread */
+
+// intern 'len' bytes of 'str', return NULL if no memory
+const char *
+intern ( const char *str, size_t len );
+
+// other reference to 'istr'
+const char *
+intern_ref ( const char *istr );
+
+// release a reference, the last frees the string, NULL is ignored
+void
+intern_put ( const char *istr );
+
+size_t
+intern_len ( const char *istr );
+
+// "/usr/bin/program" of "/usr/bin/program --args"
+size_t
+intern_prog_len ( const char *istr );
+
+// offset of "program" in "/usr/bin/program --args"
+size_t
+intern_base ( const char *istr );
+
+hash_t
+intern_hash ( const char *istr );
+
+// total of strings distinct in table
+size_t
+intern_total ( void );
+
+#endif  // INTERN_H
@@ -0,0 +1,179 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <time.h>  // clock_gettime
+
+#include "lag.h"
+#include "macro_util.h"
+
+// updated by capture threads also
+static struct lag_histogram totals[TOTAL_LAGS];
+
+// max since last refresh
+static uint64_t interval_max[TOTAL_LAGS];
+
+// counters at last refresh
+static struct lag_histogram marks[TOTAL_LAGS];
+
+static struct lag_stats last[TOTAL_LAGS];
+
+static const char *const names[TOTAL_LAGS] = {
+  [LAG_CAPTURE] = "capture",
+  [LAG_TICK] = "tick",
+};
+
+static uint64_t
+clock_us ( clockid_t clock )
+{
+  struct timespec ts;
+
+  clock_gettime ( clock, &ts );
+
+  return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void
+atomic_max ( uint64_t *max, uint64_t value )
+{
+  uint64_t cur = __atomic_load_n ( max, __ATOMIC_RELAXED );
+
+  while ( value > cur && !__atomic_compare_exchange_n ( max,
+                                                       &cur,
+                                                       value,
+                                                       true,
+                                                       __ATOMIC_RELAXED,
+                                                       __ATOMIC_RELAXED ) )
+    ;
+}
+
+static void
+lag_add ( enum lag_kind kind, uint64_t us )
+{
+  struct lag_histogram *hist = &totals[kind];
+
+  // bits of value, 0 to values below 1 us
+  unsigned int bucket = ( us ) ? 64 - __builtin_clzll ( us ) : 0;
+  bucket = MIN ( bucket, LAG_BUCKETS - 1 );
+
+  __atomic_fetch_add ( &hist->counts[bucket], 1, __ATOMIC_RELAXED );
+  __atomic_fetch_add ( &hist->count, 1, __ATOMIC_RELAXED );
+  __atomic_fetch_add ( &hist->sum_us, us, __ATOMIC_RELAXED );
+  atomic_max ( &hist->max_us, us );
+  atomic_max ( &interval_max[kind], us );
+}
+
+void
+lag_block ( uint32_t sec, uint32_t nsec )
+{
+  uint64_t now = clock_us ( CLOCK_REALTIME );
+  uint64_t ts = sec * 1000000ULL + nsec / 1000;
+
+  // clock of system changed back
+  lag_add ( LAG_CAPTURE, ( now > ts ) ? now - ts : 0 );
+}
+
+uint64_t
+lag_tick_start ( void )
+{
+  return clock_us ( CLOCK_MONOTONIC );
+}
+
+void
+lag_tick_end ( uint64_t start )
+{
+  lag_add ( LAG_TICK, clock_us ( CLOCK_MONOTONIC ) - start );
+}
+
+void
+lag_histogram ( enum lag_kind kind, struct lag_histogram *hist )
+{
+  const struct lag_histogram *src = &totals[kind];
+
+  for ( unsigned int i = 0; i < LAG_BUCKETS; i++ )
+    hist->counts[i] = __atomic_load_n ( &src->counts[i], __ATOMIC_RELAXED );
+
+  hist->count = __atomic_load_n ( &src->count, __ATOMIC_RELAXED );
+  hist->sum_us = __atomic_load_n ( &src->sum_us, __ATOMIC_RELAXED );
+  hist->max_us = __atomic_load_n ( &src->max_us, __ATOMIC_RELAXED );
+}
+
+uint64_t
+lag_percentile ( const struct lag_histogram *hist, unsigned int percent )
+{
+  uint64_t total = 0;
+
+  for ( unsigned int i = 0; i < LAG_BUCKETS; i++ )
+    total += hist->counts[i];
+
+  if ( !total )
+    return 0;
+
+  // rank of value, rounded up
+  uint64_t rank = ( total * percent + 99 ) / 100;
+  uint64_t seen = 0;
+
+  for ( unsigned int i = 0; i < LAG_BUCKETS - 1; i++ )
+    {
+      seen += hist->counts[i];
+      if ( seen >= rank )
+        return MIN ( lag_bucket_bound ( i ), hist->max_us );
+    }
+
+  return hist->max_us;
+}
+
+void
+lag_refresh ( void )
+{
+  for ( int k = 0; k < TOTAL_LAGS; k++ )
+    {
+      struct lag_histogram now, interval;
+
+      lag_histogram ( k, &now );
+
+      for ( unsigned int i = 0; i < LAG_BUCKETS; i++ )
+        interval.counts[i] = now.counts[i] - marks[k].counts[i];
+
+      interval.max_us =
+              __atomic_exchange_n ( &interval_max[k], 0, __ATOMIC_RELAXED );
+
+      last[k] = ( struct lag_stats ){
+        .p50_us = lag_percentile ( &interval, 50 ),
+        .p99_us = lag_percentile ( &interval, 99 ),
+        .max_us = interval.max_us,
+        .count = now.count - marks[k].count
+      };
+
+      marks[k] = now;
+    }
+}
+
+const struct lag_stats *
+lag_last ( enum lag_kind kind )
+{
+  return &last[kind];
+}
+
+const char *
+lag_name ( enum lag_kind kind )
+{
+  return names[kind];
+}
@@ -0,0 +1,98 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LAG_H
+#define LAG_H
+
+#include <stdint.h>
+
+/* how far behind of real time netproc is running. the lag of capture is
+   the time between the timestamp of last packet of a block of ring and
+   the read of block, the lag of tick is the time of processing of a
+   refresh. values are in histograms of buckets by powers of two of
+   microseconds, always counted (not only with --self-stats) */
+
+enum lag_kind
+{
+  LAG_CAPTURE,
+  LAG_TICK,
+  TOTAL_LAGS
+};
+
+/* bucket 'i' has the values below of 2^i us (see lag_bucket_bound), the
+   last bucket also the values above, 2^25 us are about 33 seconds */
+#define LAG_BUCKETS 26
+
+struct lag_histogram
+{
+  uint64_t counts[LAG_BUCKETS];
+  uint64_t count;
+  uint64_t sum_us;
+  uint64_t max_us;
+};
+
+// of the last interval between two lag_refresh
+struct lag_stats
+{
+  uint64_t p50_us;
+  uint64_t p99_us;
+  uint64_t max_us;
+  uint64_t count;
+};
+
+/* account the lag of a block read now with last packet in 'sec' and
+   'nsec' of realtime clock, can be called by capture threads */
+void
+lag_block ( uint32_t sec, uint32_t nsec );
+
+// return time to lag_tick_end, at start of processing of a refresh
+uint64_t
+lag_tick_start ( void );
+
+void
+lag_tick_end ( uint64_t start );
+
+// close the interval, stats of it are available by lag_last
+void
+lag_refresh ( void );
+
+const struct lag_stats *
+lag_last ( enum lag_kind kind );
+
+// copy of counters of 'kind' since start
+void
+lag_histogram ( enum lag_kind kind, struct lag_histogram *hist );
+
+/* upper bound of bucket with 'percent' of values, limited by max of
+   histogram. 0 without values */
+uint64_t
+lag_percentile ( const struct lag_histogram *hist, unsigned int percent );
+
+// exclusive upper bound in us of bucket 'i', except the last
+static inline uint64_t
+lag_bucket_bound ( unsigned int i )
+{
+  return 1ULL << i;
+}
+
+const char *
+lag_name ( enum lag_kind kind );
+
+#endif  // LAG_H
@@ -18,6 +18,8 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>   // variable errno
+#include <inttypes.h>  // PRIu64
 #include <stdio.h>   // FILE
 #include <stdlib.h>  // free
 #include <stdbool.h>
@@ -25,119 +27,252 @@
 
 #include "log.h"
 #include "vector.h"
+#include "hashtable.h"
+#include "intern.h"
+#include "timer.h"  // msec2clock
 #include "human_readable.h"
+#include "statistics.h"  // statistics_ifaces
+#include "lag.h"
+#include "iface.h"
 #include "m_error.h"
 
-struct log_processes
+/* the file only grows, in each write a record with traffic of the
+   programs since last write is appended. all programs with total of
+   traffic are appended in summary, periodically and on exit */
+
+// traffic of all processes with same name (program)
+struct log_process
 {
-  char *name;
+  const char *name;  // interned, as name of processes
   nstats_t tot_Bps_rx;  // trafego total
   nstats_t tot_Bps_tx;
+  nstats_t rec_Bps_rx;  // since last record
+  nstats_t rec_Bps_tx;
+  bool changed;  // in list of changed
 };
 
-static struct log_processes *log_processes = NULL;
-static size_t len_log_processes = 0;
+// names are keys, each process is looked up only if had traffic
+static hashtable_t *ht_names;
+
+static struct log_process **log_processes;  // order of first traffic
+static struct log_process **changed;        // with traffic since last record
 static FILE *file = NULL;
 
 // space justify column
 #define TAXA 14
 
-// TAXA + TAXA + PROGRAM + '\n'
-#define LEN_HEADER TAXA * 2 + 7 + 1
+// hh:mm:ss
+#define CLOCK 10
+
+// milliseconds between writes of file, with refresh is smaller
+#define LOG_INTERVAL 1000
+
+// time running in last write and of last summary
+static uint64_t written_at, summary_at;
+
+// names are interned, equal names are the same pointer
+static bool
+ht_cb_compare ( const void *key1, const void *key2 )
+{
+  return key1 == key2;
+}
+
+static hash_t
+ht_cb_hash ( const void *key )
+{
+  return intern_hash ( key );
+}
 
 static void
-write_process_to_file ( struct log_processes *processes,
-                        const size_t tot_process,
-                        FILE *file )
+free_log_process ( void *data )
 {
-  char rx_tot[LEN_STR_TOTAL];
-  char tx_tot[LEN_STR_TOTAL];
+  struct log_process *log = data;
+
+  intern_put ( log->name );
+  free ( log );
+}
+
+static struct log_process *
+get_log_process ( const char *name )
+{
+  struct log_process *log = hashtable_get ( ht_names, name );
+  if ( log )
+    return log;
 
-  for ( size_t i = 0; i < tot_process; i++ )
+  log = calloc ( 1, sizeof *log );
+  if ( !log )
+    return NULL;
+
+  log->name = intern_ref ( name );
+  if ( !hashtable_set ( ht_names, log->name, log ) )
     {
-      // not log process whitout traffic
-      if ( !processes[i].tot_Bps_rx && !processes[i].tot_Bps_tx )
+      intern_put ( log->name );
+      free ( log );
+      return NULL;
+    }
+
+  // table is owner, removed only on exit
+  if ( !vector_push ( log_processes, &log ) )
+    return NULL;
+
+  return log;
+}
+
+/* processes with same name are accounted together, so the file has the
+   traffic of a program, not only of a execution of program */
+static bool
+update_log_process ( process_t **procs, size_t total )
+{
+  for ( size_t i = 0; i < total; i++ )
+    {
+      process_t *proc = procs[i];
+
+      // bytes since last refresh
+      nstats_t rx = proc->net_stat.tot_Bps_rx - proc->net_stat.tot_Bps_rx_prev;
+      nstats_t tx = proc->net_stat.tot_Bps_tx - proc->net_stat.tot_Bps_tx_prev;
+
+      if ( !rx && !tx )
         continue;
 
-      human_readable ( tx_tot, sizeof tx_tot, processes[i].tot_Bps_tx, TOTAL );
+      struct log_process *log = get_log_process ( proc->name );
+      if ( !log )
+        return false;
 
-      human_readable ( rx_tot, sizeof rx_tot, processes[i].tot_Bps_rx, TOTAL );
+      log->tot_Bps_rx += rx;
+      log->tot_Bps_tx += tx;
+      log->rec_Bps_rx += rx;
+      log->rec_Bps_tx += tx;
 
-      fprintf ( file,
-                "%*s%*s%s\n",
-                -TAXA,
-                tx_tot,
-                -TAXA,
-                rx_tot,
-                processes[i].name );
+      if ( !log->changed )
+        {
+          log->changed = true;
+          if ( !vector_push ( changed, &log ) )
+            return false;
+        }
     }
+
+  return true;
 }
 
-static char *
-copy_name ( const char *name, size_t size )
+static void
+write_traffic ( const char *clock, nstats_t tx, nstats_t rx, const char *name )
 {
-  char *p = malloc ( size + 1 );
+  char rx_tot[LEN_STR_TOTAL];
+  char tx_tot[LEN_STR_TOTAL];
+
+  human_readable ( tx_tot, sizeof tx_tot, tx, TOTAL );
+  human_readable ( rx_tot, sizeof rx_tot, rx, TOTAL );
+
+  fprintf ( file,
+            "%*s%*s%*s%s\n",
+            -CLOCK,
+            clock,
+            -TAXA,
+            tx_tot,
+            -TAXA,
+            rx_tot,
+            name );
+}
 
-  if ( p )
+// only programs with traffic since last record
+static void
+write_record ( const struct config_op *co )
+{
+  const char *clock = msec2clock ( co->running );
+  size_t total = vector_size ( changed );
+
+  for ( size_t i = 0; i < total; i++ )
     {
-      memcpy ( p, name, size );
-      p[size] = '\0';
+      struct log_process *log = changed[i];
+
+      write_traffic ( clock, log->rec_Bps_tx, log->rec_Bps_rx, log->name );
+
+      log->rec_Bps_rx = log->rec_Bps_tx = 0;
+      log->changed = false;
     }
 
-  return p;
+  vector_clear ( changed );
 }
 
-// percorre todos os processos e busca se um processo ( ou outro com mesmo nome,
-// assim podemos ter no arquivo de log, os dados total sobre um programa,
-// não apenas sobre uma execução do programa),
-// ja esta presente no buffer espelho do arquivo de log
-// se estiver present incrementa as estaticias de rede desse processo, caso não
-// adiciona ao buffer ( e consequentement sera exibido no arquivo de log)
-static bool
-update_log_process ( process_t **new_procs )
+static void
+write_summary ( const struct config_op *co )
 {
-  while ( *new_procs )
-    {
-      process_t *proc = *new_procs++;
+  const char *clock = msec2clock ( co->running );
+  size_t total = vector_size ( log_processes );
 
-      struct log_processes *log = log_processes;
+  fprintf ( file, "\nSUMMARY %s\n", clock );
 
-      size_t j;
-      for ( j = 0; j < len_log_processes; j++, log++ )
-        {
-          if ( strcmp ( proc->name, log->name ) )
-            continue;
+  for ( size_t i = 0; i < total; i++ )
+    write_traffic ( "",
+                    log_processes[i]->tot_Bps_tx,
+                    log_processes[i]->tot_Bps_rx,
+                    log_processes[i]->name );
 
-          log->tot_Bps_rx += proc->net_stat.bytes_last_sec_rx;
-          log->tot_Bps_tx += proc->net_stat.bytes_last_sec_tx;
+  // all traffic of each interface, also without process
+  size_t total_ifaces;
+  const struct iface_total *ifaces = statistics_ifaces ( &total_ifaces );
 
-          // only one process with same name exist in this buffer
-          break;
-        }
+  for ( size_t i = 0; i < total_ifaces; i++ )
+    {
+      char tx[LEN_STR_TOTAL], rx[LEN_STR_TOTAL];
+      const char *name = iface_name ( ifaces[i].if_index );
+
+      human_readable ( tx, sizeof tx, ifaces[i].bytes[PKT_UPL - 1], TOTAL );
+      human_readable ( rx, sizeof rx, ifaces[i].bytes[PKT_DOWN - 1], TOTAL );
+
+      if ( name )
+        fprintf ( file, "IFACE %s TX %s RX %s\n", name, tx, rx );
+      else
+        fprintf ( file,
+                  "IFACE %d TX %s RX %s\n",
+                  ifaces[i].if_index,
+                  tx,
+                  rx );
+    }
 
-      // not found, add new process in buffer
-      if ( j == len_log_processes )
-        {
-          log->name = copy_name ( proc->name, strlen ( proc->name ) );
-          if ( !log->name )
-            return false;
+  // eBPF not drop packets in socket
+  if ( !co->ebpf )
+    {
+      const struct sock_stats *st = &co->stats_total;
+      double rate = st->packets ? st->drops * 100.0 / st->packets : 0.0;
+
+      fprintf ( file,
+                "PACKETS %" PRIu64 " DROPS %" PRIu64 " (%.2f%%) FREEZE %" PRIu64
+                "\n",
+                st->packets,
+                st->drops,
+                rate,
+                st->freeze_q );
+    }
 
-          log->tot_Bps_rx = proc->net_stat.tot_Bps_rx;
-          log->tot_Bps_tx = proc->net_stat.tot_Bps_tx;
-          len_log_processes++;
+  // totals of sample mode are estimates
+  if ( co->sample > 1 )
+    fprintf ( file, "SAMPLE 1/%u ESTIMATED\n", co->sample );
 
-          if ( !vector_push ( log_processes, log ) )
-            return false;
-        }
+  // since start, lag of capture and time of refresh
+  for ( int i = 0; i < TOTAL_LAGS; i++ )
+    {
+      struct lag_histogram hist;
+      lag_histogram ( i, &hist );
+
+      if ( !hist.count )
+        continue;
+
+      fprintf ( file,
+                "LAG %s P50 %.1f ms P99 %.1f ms MAX %.1f ms\n",
+                lag_name ( i ),
+                lag_percentile ( &hist, 50 ) / 1e3,
+                lag_percentile ( &hist, 99 ) / 1e3,
+                hist.max_us / 1e3 );
     }
 
-  return true;
+  fputc ( '\n', file );
 }
 
 int
 log_init ( const char *path_log )
 {
-  file = fopen ( path_log, "w+" );
+  file = fopen ( path_log, "w" );
 
   if ( !file )
     {
@@ -147,51 +282,87 @@ log_init ( const char *path_log )
       return 0;
     }
 
-  log_processes = vector_new ( sizeof ( struct log_processes ) );
+  ht_names = hashtable_new ( ht_cb_hash, ht_cb_compare, free_log_process );
+  log_processes = vector_new ( sizeof ( struct log_process * ) );
+  changed = vector_new ( sizeof ( struct log_process * ) );
 
-  if ( !log_processes )
+  if ( !ht_names || !log_processes || !changed )
     {
-      fclose ( file );
-      ERROR_DEBUG ( "%s", "Error create vector log processes" );
+      ERROR_DEBUG ( "%s", "Error create tables of log" );
+      log_free ();
 
       return 0;
     }
 
   fprintf ( file,
-            "%*s%*s%s\n",
+            "%*s%*s%*s%s\n",
+            -CLOCK,
+            "TIME",
             -TAXA,
-            "TOTAL TX",
+            "TX",
             -TAXA,
-            "TOTAL RX",
+            "RX",
             "PROGRAM" );
 
   return 1;
 }
 
+static void
+write_file ( const struct config_op *co, bool summary )
+{
+  written_at = co->running;
+
+  write_record ( co );
+
+  if ( summary )
+    {
+      summary_at = co->running;
+      write_summary ( co );
+    }
+
+  // written in kernel, not lost if netproc crash
+  fflush ( file );
+}
+
 int
-log_file ( process_t **processes )
+log_file ( process_t **processes, size_t total, const struct config_op *co )
 {
-  if ( !update_log_process ( processes ) )
+  if ( !update_log_process ( processes, total ) )
     return 0;
 
-  // set file one line below header
-  fseek ( file, LEN_HEADER, SEEK_SET );
-  write_process_to_file ( log_processes, len_log_processes, file );
+  // with refresh of less of a second, the file is not written in all
+  if ( !written_at || co->running - written_at >= LOG_INTERVAL )
+    write_file ( co,
+                 co->log_summary &&
+                         co->running - summary_at >=
+                                 co->log_summary * 1000ULL );
 
   return 1;
 }
 
+void
+log_flush ( const struct config_op *co )
+{
+  // last summary can be of now
+  if ( file )
+    write_file ( co, !co->running || summary_at != co->running );
+}
+
 void
 log_free ( void )
 {
   if ( file )
     fclose ( file );
+  file = NULL;
 
+  // entries are of the table
+  if ( changed )
+    vector_free ( changed );
   if ( log_processes )
-    {
-      for ( size_t i = 0; i < len_log_processes; i++ )
-        free ( log_processes[i].name );
+    vector_free ( log_processes );
+  changed = log_processes = NULL;
 
-      vector_free ( log_processes );
-    }
+  if ( ht_names )
+    hashtable_destroy ( ht_names );
+  ht_names = NULL;
 }
@@ -23,12 +23,21 @@
 
 #include "processes.h"
 #include "rate.h"
+#include "config.h"
 
 int
 log_init ( const char *path_log );
 
+/* append a record with traffic of programs since last record, at most once
+   by second. the statistics are accounted in each refresh. a summary with
+   totals and counters of packets dropped by kernel, so is possible know if
+   the statistics are complete, is appended each '--log-summary' seconds */
 int
-log_file ( process_t **processes );
+log_file ( process_t **processes, size_t total, const struct config_op *co );
+
+// write statistics still not written in file and the summary
+void
+log_flush ( const struct config_op *co );
 
 void
 log_free ( void );
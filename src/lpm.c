@@ -0,0 +1,142 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>  // realloc
+#include <string.h>  // memset
+
+#include "lpm.h"
+
+#define NODE_ENTRIES 256
+
+// entry with index of a node, others entries are values
+#define ENTRY_NODE 0x80000000
+
+// new node with all entries with 'value', of entry that it replace
+static bool
+node_new ( struct lpm *lpm, uint32_t value, size_t *node )
+{
+  if ( lpm->total_nodes == lpm->max_nodes )
+    {
+      size_t max = ( lpm->max_nodes ) ? lpm->max_nodes * 2 : 16;
+      uint32_t *nodes =
+              realloc ( lpm->nodes, max * NODE_ENTRIES * sizeof ( *nodes ) );
+      if ( !nodes )
+        return false;
+
+      lpm->nodes = nodes;
+      lpm->max_nodes = max;
+    }
+
+  *node = lpm->total_nodes++;
+
+  uint32_t *entries = &lpm->nodes[*node * NODE_ENTRIES];
+  for ( size_t i = 0; i < NODE_ENTRIES; i++ )
+    entries[i] = value;
+
+  return true;
+}
+
+bool
+lpm_init ( struct lpm *lpm )
+{
+  size_t root;
+
+  memset ( lpm, 0, sizeof ( *lpm ) );
+
+  return node_new ( lpm, 0, &root );
+}
+
+bool
+lpm_add ( struct lpm *lpm,
+          const uint8_t *addr,
+          unsigned int bits,
+          uint32_t value )
+{
+  size_t node = 0;
+  unsigned int level = 0;
+
+  // nodes of bytes full of prefix
+  for ( ; bits > ( level + 1 ) * 8; level++ )
+    {
+      uint32_t entry = lpm->nodes[node * NODE_ENTRIES + addr[level]];
+
+      if ( !( entry & ENTRY_NODE ) )
+        {
+          size_t child;
+
+          // addresses of node are of prefix shorter, of entry
+          if ( !node_new ( lpm, entry, &child ) )
+            return false;
+
+          entry = ENTRY_NODE | child;
+          lpm->nodes[node * NODE_ENTRIES + addr[level]] = entry;
+        }
+
+      node = entry & ~ENTRY_NODE;
+    }
+
+  // last byte of prefix is expanded in entries of all your addresses
+  unsigned int span = 1U << ( ( level + 1 ) * 8 - bits );
+  unsigned int first = addr[level] & ~( span - 1 );
+  uint32_t *entries = &lpm->nodes[node * NODE_ENTRIES + first];
+
+  for ( unsigned int i = 0; i < span; i++ )
+    {
+      // node only of prefix longer, added before out of order
+      if ( !( entries[i] & ENTRY_NODE ) )
+        entries[i] = value;
+    }
+
+  return true;
+}
+
+uint32_t
+lpm_lookup ( const struct lpm *lpm, const uint8_t *addr, size_t len )
+{
+  const uint32_t *node = lpm->nodes;
+
+  if ( !node )
+    return 0;
+
+  for ( size_t i = 0; i < len; i++ )
+    {
+      uint32_t entry = node[addr[i]];
+
+      if ( !( entry & ENTRY_NODE ) )
+        return entry;
+
+      node = &lpm->nodes[( entry & ~ENTRY_NODE ) * NODE_ENTRIES];
+    }
+
+  return 0;
+}
+
+size_t
+lpm_memory ( const struct lpm *lpm )
+{
+  return lpm->max_nodes * NODE_ENTRIES * sizeof ( *lpm->nodes );
+}
+
+void
+lpm_free ( struct lpm *lpm )
+{
+  free ( lpm->nodes );
+  memset ( lpm, 0, sizeof ( *lpm ) );
+}
@@ -0,0 +1,69 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LPM_H
+#define LPM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* longest prefix match by multibit trie with stride of 8 bits and prefixes
+   expanded in nodes (as DIR-24-8, but with nodes of 256 entries, so a table
+   of few prefixes is small). a lookup read one entry by byte of address and
+   stop in first entry that is not a node, at most 4 reads to ipv4 and 16 to
+   ipv6, without compare of prefixes */
+
+// max of value of a prefix
+#define LPM_MAX_VALUE 0x7fffffff
+
+struct lpm
+{
+  uint32_t *nodes;  // nodes of 256 entries, node 0 is root
+  size_t total_nodes;
+  size_t max_nodes;
+};
+
+// return false if no memory
+bool
+lpm_init ( struct lpm *lpm );
+
+/* 'value' (1 to LPM_MAX_VALUE) to addresses of prefix 'addr'/'bits', address
+   in network order. the prefixes must be added from shortest to longest,
+   so a longer prefix replace the shorter one only in your addresses.
+   return false if no memory */
+bool
+lpm_add ( struct lpm *lpm,
+          const uint8_t *addr,
+          unsigned int bits,
+          uint32_t value );
+
+// value of longest prefix with 'addr' of 'len' bytes, 0 if none
+uint32_t
+lpm_lookup ( const struct lpm *lpm, const uint8_t *addr, size_t len );
+
+// bytes of nodes
+size_t
+lpm_memory ( const struct lpm *lpm );
+
+void
+lpm_free ( struct lpm *lpm );
+
+#endif  // LPM_H
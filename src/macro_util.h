@@ -23,16 +23,22 @@
 
 #define MAX( a, b ) ( ( a ) > ( b ) ? ( a ) : ( b ) )
 
+#define MIN( a, b ) ( ( a ) < ( b ) ? ( a ) : ( b ) )
+
 #define ARRAY_SIZE( x ) ( sizeof ( x ) / sizeof ( x[0] ) )
 
 #define SIZEOF_MEMBER( type, member ) ( sizeof ( ( ( type * ) 0 )->member ) )
 
+#define CACHE_LINE_SIZE 64
+
 #ifdef __GNUC__
 #define UNUSED __attribute__ ( ( __unused__ ) )
 #define FALLTHROUGH __attribute__ ( ( __fallthrough__ ) )
+#define ALWAYS_INLINE inline __attribute__ ( ( __always_inline__ ) )
 #else
 #define UNUSED( x )
 #define FALLTHROUGH
+#define ALWAYS_INLINE inline
 #endif
 
 #endif  // MACRO_UTIL_H
@@ -18,78 +18,354 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <signal.h>  // sigaction
-#include <unistd.h>  // STDIN_FILENO
-#include <poll.h>    // poll
+#include <signal.h>     // sigaction
+#include <string.h>     // memset
+#include <unistd.h>     // STDIN_FILENO
+#include <sys/epoll.h>  // epoll_wait
+#include <sys/eventfd.h>
+#include <pthread.h>
 #include <locale.h>
+#include <time.h>       // time
+#include <net/if.h>     // if_nametoindex
 
 #include "config.h"
 #include "packet.h"
 #include "rate.h"
 #include "processes.h"
+#include "proc_events.h"
+#include "iface.h"
+#include "aggregate.h"
+#include "networks.h"
 #include "sock.h"
 #include "ring.h"
 #include "filter.h"
 #include "statistics.h"
+#include "capture.h"
+#include "pcap_file.h"
+#include "ebpf/ebpf_capture.h"
+#include "ebpf/ebpf_sock.h"
+#include "ebpf/ebpf_fds.h"
+#include "ebpf/ebpf_xdp.h"
 #include "human_readable.h"
 #include "timer.h"
+#include "hash.h"
+#include "profile.h"
+#include "lag.h"
+#include "pool.h"
+#include "hugemem.h"
 #include "tui.h"
 #include "log.h"
+#include "exporter.h"
+#include "record.h"
+#include "stream.h"
+#include "snapshot.h"
+#include "replay.h"
+#include "agent.h"
+#include "collector.h"
+#include "flow_export.h"
+#include "vector.h"
+#include "memory.h"
 #include "usage.h"
 #include "m_error.h"
 #include "resolver/resolver.h"
+#include "affinity.h"
+#include "probe.h"
 #include "macro_util.h"
+#include "overload.h"
+#include "translate.h"  // translate_pause
+#include "control.h"
 
-// time to refresh in milliseconds
-#define T_REFRESH 1000
+// stdin, timer, socket, exporter, control and initial scan
+#define MAX_EVENTS 6
+
+// interval in seconds between updates of all processes, in meantime
+// only the tuples of packets without process are looked up
+#define T_RECONCILE 10
+
+static void
+config_sig_handler ( const struct config_op *co );
+
+static int
+replay_main ( struct config_op *co );
+
+static int
+collector_main ( struct config_op *co );
+
+static int
+event_add ( int epfd, int fd );
+
+static void
+reload_filter ( const struct config_op *co,
+                const struct tap *taps,
+                unsigned int total_taps,
+                struct capture *capture );
+
+static void
+adapt_sample ( struct config_op *co,
+               const struct tap *taps,
+               unsigned int total_taps,
+               struct capture *capture,
+               bool pressure );
+
+static bool
+view_conns ( const struct config_op *co );
+
+static void
+export_flow ( connection_t *conn, void *user_data );
+
+static const char *
+apply_control ( struct config_op *co,
+                const struct control_cmd *cmd,
+                const struct tap *taps,
+                unsigned int total_taps,
+                struct capture *capture,
+                int tfd );
+
+static bool
+read_tap ( struct tap *tap, bool view_conections );
+
+static int
+update_processes ( struct processes *processes,
+                   struct config_op *co,
+                   struct ebpf_fds *ebpf_fds );
+
+/* first update of processes, in a thread of its own while the main thread
+   drain the rings, that for hosts with many processes can take seconds */
+struct scan
+{
+  struct processes *processes;
+  struct config_op *co;
+  struct ebpf_fds *ebpf_fds;
+  pthread_t tid;
+  int efd;  // readable at end of scan
+  int ret;  // of update_processes
+  bool running;
+};
+
+static bool
+scan_start ( struct scan *scan );
+
+static int
+scan_wait ( struct scan *scan );
 
 static void
-config_sig_handler ( void );
+drain_tap ( struct tap *tap, struct flow_acc *acc );
 
 // handled by function sig_handler
 static volatile sig_atomic_t prog_exit = 0;
 
+// handled by function sighup_handler
+static volatile sig_atomic_t need_reload = 0;
+
+// rate of sample of user, the auto sample not go below it
+static unsigned int sample_user;
+
+// interval of timer, changed by control socket. rates keep the tick of
+// '--refresh' (co->refresh)
+static unsigned int refresh_timer;
+
 int
 main ( int argc, char **argv )
 {
   setlocale ( LC_CTYPE, "" );  // needle to ncursesw
 
-  struct ring *ring = NULL;
+  struct tap taps[MAX_IFACES];
+  unsigned int total_taps = 0;
+  struct capture *capture = NULL;
+  struct pcap_file *pcap = NULL;
+  struct ebpf_capture *ebpf = NULL;
+  struct ebpf_sock *ebpf_sock = NULL;
+  struct ebpf_fds *ebpf_fds = NULL;
+  struct ebpf_xdp *xdp = NULL;
+  struct proc_events *proc_events = NULL;
   struct processes *processes = NULL;
+  struct filters filters = { 0 };
+  struct scan scan = { .efd = -1 };
+  struct flow_acc early = { 0 };  // packets of main thread while scan
+  int epfd = -1;
+  int tfd = -1;
 
   struct config_op *co = parse_options ( argc, argv );
 
-  int sock = socket_init ( co->iface );
-  if ( sock == -1 )
+  profile_init ( co->self_stats );
+
+  // before of any table or pool allocated
+  hugemem_init ( co->hugepages );
+
+  // traffic of a record, without capture
+  if ( co->replay )
+    return replay_main ( co );
+
+  // traffic of agents, without capture
+  if ( co->collector )
+    return collector_main ( co );
+
+  // before of any traffic accounted
+  rate_init ( co );
+
+  // before of any key in tables
+  hash_init ();
+
+  // packets sampled by filter are accounted as 'sample' packets
+  statistics_sample ( co->sample );
+
+  // packets of loopback are read once and credited to both ends
+  if ( co->loopback )
+    statistics_loopback ( if_nametoindex ( "lo" ) );
+
+  statistics_top_remotes ( co->top_remotes );
+
+  // before of first connection, each one is classified when created
+  if ( co->networks && !networks_load ( co->networks ) )
     {
-      if ( getuid () )
-        fatal_error ( "Root is needed to running" );
-      else
-        fatal_error ( "Error create socket: %s", strerror ( errno ) );
+      fatal_error ( "Error read networks of '%s'", co->networks );
+      goto EXIT;
+    }
+
+  if ( !ring_geometry ( co ) )
+    {
+      fatal_error ( "Error define geometry of ring" );
+      goto EXIT;
+    }
 
+  // without support to eBPF in kernel, use ring buffer
+  if ( co->ebpf && !( ebpf = ebpf_capture_init ( co ) ) )
+    co->ebpf = false;
+
+  // ingress by XDP, before of filters, that then pass only egress
+  if ( co->xdp && !( xdp = ebpf_xdp_init ( co ) ) )
+    co->xdp = false;
+
+  // CPUs local to NUMA node of interface are reserved to capture
+  if ( co->capture_cpus &&
+       !affinity_capture_init (
+               co->capture_cpus, co->ifaces, co->total_ifaces ) )
+    {
+      fatal_error ( "Invalid list of CPUs '%s'", co->capture_cpus );
       goto EXIT;
     }
 
-  ring = ring_init ( sock );
-  if ( !ring )
+  if ( co->read_file )
+    {
+      // packets of file in place of capture, root is not needed
+      pcap = pcap_file_open ( co->read_file, co );
+      if ( !pcap || !packet_init ( co->max_fragments ) )
+        {
+          fatal_error ( "Error read packets of '%s'", co->read_file );
+          goto EXIT;
+        }
+    }
+  else if ( ebpf )
     {
-      fatal_error ( "Error ring_init" );
+      // traffic is counted in kernel, nothing to read in each packet
+    }
+  else if ( !filters_build ( &filters, co ) )
+    {
+      fatal_error ( "Error build filter network" );
       goto EXIT;
     }
+  else if ( co->capture_threads )
+    {
+      // packets are read by workers, main thread only merge statistics,
+      // so a slow render or update of processes not cause drops in ring
+      capture = capture_init ( co, &filters );
+      if ( !capture )
+        {
+          if ( getuid () )
+            fatal_error ( "Root is needed to running" );
+          else
+            fatal_error ( "Error capture_init" );
+
+          goto EXIT;
+        }
+    }
+  else
+    {
+      // main thread read packets, it is pinned as a worker of capture
+      affinity_pin_capture ( 0 );
+
+      // a socket and ring by interface, read together
+      for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+        {
+          total_taps++;
+          if ( !tap_open ( &taps[i], co, i, &filters ) )
+            {
+              if ( getuid () )
+                fatal_error ( "Root is needed to running" );
+              else
+                fatal_error ( "Error capture interface '%s': %s",
+                              co->ifaces[i] ? co->ifaces[i] : "all",
+                              strerror ( errno ) );
+
+              goto EXIT;
+            }
+        }
+
+      if ( !packet_init ( co->max_fragments ) )
+        {
+          fatal_error ( "Error packet_init" );
+          goto EXIT;
+        }
+    }
 
-  // filter BPF
-  if ( !filter_set ( sock, co->proto ) )
+  // records of XDP are parsed in main thread
+  if ( xdp && !total_taps && !packet_init ( co->max_fragments ) )
     {
-      fatal_error ( "Error set filter network" );
+      fatal_error ( "Error packet_init" );
       goto EXIT;
     }
 
+  // once attached, kernel has a copy of program
+  filters_free ( &filters );
+
   if ( co->log && !log_init ( co->path_log ) )
     {
       fatal_error ( "Error log_init" );
       goto EXIT;
     }
 
+  if ( co->record && !record_init ( co->record, co ) )
+    {
+      fatal_error ( "Error create record '%s'", co->record );
+      goto EXIT;
+    }
+
+  if ( co->agent && !agent_init ( co ) )
+    {
+      fatal_error ( "Error start agent to collector '%s'", co->agent );
+      goto EXIT;
+    }
+
+  if ( ( co->flow_export || co->flow_file ) && !flow_export_init ( co ) )
+    {
+      fatal_error ( "Error start export of flows" );
+      goto EXIT;
+    }
+
+  if ( co->stream && !stream_init ( co ) )
+    {
+      fatal_error ( "Error start stream of records" );
+      goto EXIT;
+    }
+
+  if ( co->shm && !snapshot_init ( co ) )
+    {
+      fatal_error ( "Error create shared memory '%s'", co->shm );
+      goto EXIT;
+    }
+
+  if ( co->metrics_port && !exporter_init ( co ) )
+    {
+      fatal_error ( "Error listen port %u of metrics", co->metrics_port );
+      goto EXIT;
+    }
+
+  if ( co->control && !control_init ( co->control ) )
+    {
+      fatal_error ( "Error create control socket '%s'", co->control );
+      goto EXIT;
+    }
+
   processes = processes_init ();
   if ( !processes )
     {
@@ -103,175 +379,455 @@ main ( int argc, char **argv )
       goto EXIT;
     }
 
-  if ( co->view_conections && co->translate_host && !resolver_init ( 0, 0 ) )
+  connection_limit_subflows ( co->max_subflows );
+  connection_export ( co->flow_export || co->flow_file );
+
+  // started before first update of processes, so no new socket is lost.
+  // without support in kernel, only scan of /proc is used
+  if ( co->ebpf_sockets && !( ebpf_sock = ebpf_sock_init () ) )
+    co->ebpf_sockets = false;
+
+  // without support in kernel, fds of processes are read of /proc
+  if ( co->ebpf_files && !( ebpf_fds = ebpf_fds_init () ) )
+    co->ebpf_files = false;
+
+  // without proc connector, processes closed are found only by scan of /proc
+  proc_events = proc_events_init ();
+
+  // names of interfaces and hosts, and the terminal, are only to show
+  // connections in screen, not started without it
+  bool show_conections = co->view_conections && !co->headless;
+
+  // without rtnetlink, names of interfaces are read of kernel in each row
+  if ( show_conections && !iface_init () )
     {
-      fatal_error ( "Error resolver_init" );
-      goto EXIT;
+      ERROR_DEBUG ( "%s", "Error init table of interfaces" );
+    }
+
+  // without table, services are read by getservbyport
+  if ( show_conections && co->translate_service && !service_init ( NULL ) )
+    {
+      ERROR_DEBUG ( "%s", "Error init table of services" );
     }
 
+  // resolver of names of hosts is started in first connection shown
+  // (see translate.c), so it not delay the first screen
+
   define_sufix ( co->view_si, co->view_bytes );
-  if ( !tui_init ( co ) )
+  if ( !co->headless && !tui_init ( co ) )
     {
       fatal_error ( "Error setup terminal user interface" );
       goto EXIT;
     }
 
-  config_sig_handler ();
+  config_sig_handler ( co );
 
-  if ( !processes_update ( processes, co ) )
+  // with rings, packets are read since now and credited to processes at
+  // end of scan. packets of file and counters of eBPF are only read after
+  if ( capture || total_taps )
+    {
+      if ( ( total_taps || xdp ) && !flow_acc_init ( &early ) )
+        {
+          fatal_error ( "Error alloc counters of packets" );
+          goto EXIT;
+        }
+
+      scan = ( struct scan ){ .processes = processes,
+                              .co = co,
+                              .ebpf_fds = ebpf_fds };
+      if ( !scan_start ( &scan ) )
+        {
+          fatal_error ( "Error start scan of processes" );
+          goto EXIT;
+        }
+    }
+  else if ( !update_processes ( processes, co, ebpf_fds ) )
     {
       fatal_error ( "Error get processes" );
       goto EXIT;
     }
 
-  uint32_t diff_time = 0;
-  uint64_t cur_time = get_time ();
-  if ( !cur_time )
+  uint32_t last_full_update = time ( NULL );
+  unsigned int refreshes_eof = 0;
+
+  sample_user = co->sample;
+
+  // without ring the sample is not possible, ingress of XDP is not sampled
+  if ( ( !capture && !total_taps ) || xdp )
+    overload_limit ( OVERLOAD_NAMES );
+
+  // ticks of refresh are scheduled by kernel, so are exact even while
+  // packets keep arriving
+  refresh_timer = co->refresh;
+  tfd = timer_periodic ( refresh_timer );
+  if ( tfd == -1 )
     {
       fatal_error ( "Error start timer" );
       goto EXIT;
     }
 
-  struct pollfd poll_set[2] = {
-    { .fd = STDIN_FILENO, .events = POLLIN, .revents = 0 },
-    { .fd = sock, .events = POLLIN | POLLPRI, .revents = 0 }
-  };
+  // without rings in main thread (packets read by capture workers or
+  // counted by eBPF), there are no taps to watch. in headless stdin is
+  // not read. clients of metrics and of control are watched by epoll of
+  // exporter and of control
+  epfd = epoll_create1 ( EPOLL_CLOEXEC );
+  if ( epfd == -1 ||
+       ( !co->headless && !event_add ( epfd, STDIN_FILENO ) ) ||
+       !event_add ( epfd, tfd ) ||
+       ( scan.running && !event_add ( epfd, scan.efd ) ) ||
+       ( exporter_fd () != -1 && !event_add ( epfd, exporter_fd () ) ) ||
+       ( control_fd () != -1 && !event_add ( epfd, control_fd () ) ) ||
+       ( xdp && !event_add ( epfd, ebpf_xdp_fd ( xdp ) ) ) )
+    {
+      fatal_error ( "Error create event loop" );
+      goto EXIT;
+    }
 
-  int block_num = 0;
-  struct tpacket_block_desc *pbd;
-  pbd = ( struct tpacket_block_desc * ) ring->rd[block_num].iov_base;
+  for ( unsigned int i = 0; i < total_taps; i++ )
+    {
+      if ( !event_add ( epfd, taps[i].sock ) )
+        {
+          fatal_error ( "Error create event loop" );
+          goto EXIT;
+        }
+    }
 
   bool need_update_processes = false;
 
   // main loop
   while ( !prog_exit )
     {
-      bool packtes_reads = false;
+      struct epoll_event events[MAX_EVENTS];
+
+      // exclusions file and services
+      if ( need_reload )
+        {
+          need_reload = 0;
+
+          if ( co->exclude_file && !co->ebpf )
+            reload_filter ( co, taps, total_taps, capture );
+
+          if ( co->exclude_file && xdp )
+            ebpf_xdp_reload ( xdp, co );
+
+          service_reload ();
+        }
+
+      int ne = epoll_wait ( epfd, events, ARRAY_SIZE ( events ), -1 );
+      if ( ne == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "epoll_wait: \"%s\"", strerror ( errno ) );
+          goto EXIT;
+        }
 
-      // read all blocks availables
-      while ( pbd->hdr.bh1.block_status & TP_STATUS_USER )
+      for ( int i = 0; i < ne; i++ )
         {
-          struct tpacket3_hdr *ppd;
+          if ( events[i].data.fd == STDIN_FILENO &&
+               tui_handle_input ( co ) == P_EXIT )
+            goto EXIT;
+
+          if ( events[i].data.fd == exporter_fd () )
+            exporter_handle ();
 
-          ppd = ( struct tpacket3_hdr * ) ( ( uint8_t * ) pbd +
-                                            pbd->hdr.bh1.offset_to_first_pkt );
+          if ( events[i].data.fd == control_fd () )
+            control_handle ();
 
-          // read all frames of block
-          for ( size_t i = 0; i < pbd->hdr.bh1.num_pkts; i++,
-                       ppd = ( struct tpacket3_hdr * ) ( ( uint8_t * ) ppd +
-                                                         ppd->tp_next_offset ) )
+          // tables of processes and connections are of main thread again
+          if ( events[i].data.fd == scan.efd )
             {
-              // se houver dados porem não foi possivel identificar o trafego,
-              // não tem estatisticas para ser adicionada aos processos.
-              // deve ser trafego de protocolo não suportado
-              struct packet packet = { 0 };
-              if ( !parse_packet ( &packet, ppd ) )
-                continue;
-
-              // se não for possivel identificar de qual processo o trafego
-              // pertence é sinal que existe um novo processo, ou nova conexão
-              // de um processo existente, que ainda não foi mapeado, então
-              // anotamos que sera necessario atualizar a lista de processos
-              // com conexões ativas.
-              if ( !statistics_add ( &packet, co->view_conections ) )
+              uint64_t start = profile_start ();
+              if ( !scan_wait ( &scan ) )
                 {
-                  need_update_processes = true;
-                  continue;
+                  fatal_error ( "Error get processes" );
+                  goto EXIT;
                 }
+              profile_end ( PHASE_PROCESSES_UPDATE, start );
 
-              packtes_reads = true;
-            }
+              last_full_update = time ( NULL );
 
-          // pass block controller to kernel
-          pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+              // traffic not found is kept as unknown until next update
+              if ( early.slots &&
+                   flow_acc_merge ( &early, view_conns ( co ) ) )
+                need_update_processes = true;
+            }
+        }
 
-          // rotate block
-          block_num = ( block_num + 1 ) % ring->req.tp_block_nr;
-          pbd = ( struct tpacket_block_desc * ) ring->rd[block_num].iov_base;
+      // rings of all interfaces, busy and quiet interfaces not share a ring
+      for ( unsigned int i = 0; i < total_taps; i++ )
+        {
+          if ( scan.running )
+            drain_tap ( &taps[i], &early );
+          else if ( read_tap ( &taps[i], view_conns ( co ) ) )
+            need_update_processes = true;
         }
 
-      if ( packtes_reads )
+      // ingress of XDP, as the rings
+      if ( xdp && scan.running )
+        ebpf_xdp_drain ( xdp, &early );
+      else if ( xdp && ebpf_xdp_read ( xdp, view_conns ( co ) ) )
+        need_update_processes = true;
+
+      // packets of file captured until now, read in each wakeup
+      if ( pcap && pcap_file_read ( pcap, view_conns ( co ) ) )
+        need_update_processes = true;
+
+      // more than one expiration only if the processing of a refresh
+      // take longer than interval of refresh
+      uint64_t expirations = timer_expirations ( tfd );
+      if ( !expirations )
+        continue;
+
+      co->running += expirations * refresh_timer;
+
+      // tables are being filled by scan, workers keep the traffic
+      if ( scan.running )
         continue;
 
-      int stop = 0;
-      while ( !stop )
+      uint64_t tick_start = lag_tick_start ();
+
+      // same clock of timestamps of packets, read once by refresh.
+      // rates are by tick (interval of refresh), updates of processes
+      // are by second
+      uint32_t now = time ( NULL );
+      uint32_t tick = rate_now ();
+
+      if ( capture && capture_merge ( capture, view_conns ( co ) ) )
+        need_update_processes = true;
+
+      // counters of kernel are of the second just closed
+      if ( ebpf && ebpf_capture_merge ( ebpf, view_conns ( co ), tick - 1 ) )
+        need_update_processes = true;
+
+      // packets lost by kernel (ring full) in this refresh
+      co->stats_last = ( struct sock_stats ){ 0 };
+      if ( capture )
+        capture_stats ( capture, &co->stats_last );
+      else if ( pcap )
+        pcap_file_stats ( pcap, &co->stats_last );
+      else
         {
-          int rp;
-          do
-            {
-              errno = 0;
-              rp = poll ( poll_set,
-                          ARRAY_SIZE ( poll_set ),
-                          T_REFRESH - diff_time );
-            }
-          while ( errno == EINTR );
+          for ( unsigned int i = 0; i < total_taps; i++ )
+            socket_stats ( taps[i].sock, &co->stats_last );
+        }
+
+      if ( xdp )
+        ebpf_xdp_stats ( xdp, &co->stats_last );
+
+      co->stats_total.packets += co->stats_last.packets;
+      co->stats_total.drops += co->stats_last.drops;
+      co->stats_total.freeze_q += co->stats_last.freeze_q;
+
+      // commands of control socket, between two refreshes
+      struct control_cmd cmd;
+      while ( control_next ( &cmd ) )
+        control_reply ( apply_control (
+                co, &cmd, taps, total_taps, capture, tfd ) );
+
+      // refresh late, the processing took longer than interval
+      bool late = expirations > 1;
 
-          if ( rp == -1 )
+      if ( co->overload_auto )
+        {
+          overload_update (
+                  co->stats_last.drops, late, co->sample > sample_user );
+          translate_pause ( overload_level () >= OVERLOAD_NAMES );
+        }
+
+      // in level of sample, refresh late is pressure also
+      if ( co->sample_auto || co->sample > sample_user ||
+           overload_level () == OVERLOAD_SAMPLE )
+        adapt_sample ( co,
+                       taps,
+                       total_taps,
+                       capture,
+                       co->stats_last.drops ||
+                               ( late &&
+                                 overload_level () == OVERLOAD_SAMPLE ) );
+
+      // rows chosen by user, by process or aggregated. aggregated rows
+      // already have the traffic of processes
+      if ( tui_aggregate () != ( int ) aggregate_mode () &&
+           !processes_aggregate ( tui_aggregate () ) )
+        {
+          ERROR_DEBUG ( "%s", "Error create aggregated view" );
+        }
+
+      struct processes *view =
+              aggregate_mode () ? aggregate_view () : processes;
+
+      uint64_t start = profile_start ();
+      rate_calc ( co, tick );
+      profile_end ( PHASE_RATE_CALC, start );
+
+      profile_refresh ();
+      lag_refresh ();
+
+      if ( !co->headless )
+        {
+          iface_update ();
+
+          if ( overload_redraw () )
             {
-              ERROR_DEBUG ( "poll: \"%s\"", strerror ( errno ) );
-              goto EXIT;
+              start = profile_start ();
+              tui_show ( view, co );
+              profile_end ( PHASE_TUI_SHOW, start );
             }
-          else if ( rp > 0 )
-            {
-              for ( size_t i = 0; i < ARRAY_SIZE ( poll_set ); i++ )
-                {
-                  if ( !poll_set[i].revents )
-                    continue;
+        }
 
-                  if ( poll_set[i].fd == STDIN_FILENO &&
-                       tui_handle_input ( co ) == P_EXIT )
-                    goto EXIT;
+      if ( co->log && !log_file ( processes->proc, processes->total, co ) )
+        {
+          goto EXIT;
+        }
 
-                  if ( poll_set[i].fd == sock )
-                    stop = 1;
-                }
-            }
+      exporter_update ( processes->proc, processes->total, co );
 
-          uint64_t new_time = get_time ();
+      stream_tick ( processes->proc, processes->total, co );
 
-          if ( new_time < cur_time )
-            continue;
+      snapshot_update ( processes->proc, processes->total, co );
 
-          diff_time = new_time - cur_time;
+      // tick closed by rate_calc
+      record_tick ( processes->proc, processes->total, tick - 1 );
 
-          if ( diff_time >= T_REFRESH )
-            {
-              co->running += diff_time;
-              diff_time -= T_REFRESH;
-              cur_time = new_time + diff_time;
+      agent_tick ( processes->proc, processes->total, tick - 1 );
 
-              rate_calc ( processes, co );
+      // flows of connections closed in update of this refresh
+      flow_export_flush ();
 
-              tui_show ( processes, co );
+      profile_first_frame ();
 
-              if ( co->log && !log_file ( processes->proc ) )
-                {
-                  goto EXIT;
-                }
+      rate_update ();
+
+      // processes created and closed in this refresh. if kernel lost
+      // events, a full update is done now
+      if ( proc_events )
+        {
+          size_t total_events = proc_events_read ( proc_events );
+          processes_update_events (
+                  processes, proc_events_get ( proc_events ), total_events );
 
-              rate_update ( processes, co );
+          if ( proc_events_lost ( proc_events ) )
+            {
+              need_update_processes = true;
+              last_full_update = now - T_RECONCILE;
+            }
 
-              if ( need_update_processes )
-                {
-                  if ( !processes_update ( processes, co ) )
-                    goto EXIT;
+          proc_events_clear ( proc_events );
+        }
 
-                  need_update_processes = false;
-                }
+      if ( need_update_processes )
+        {
+          // with owners of new sockets reported by kernel, avoid
+          // scan of all processes. if connections without owner
+          // remain, next update scan all processes
+          size_t owners = 0;
+          if ( ebpf_sock )
+            owners = ebpf_sock_read ( ebpf_sock );
+
+          size_t total_unknown;
+          const struct tuple *unknown = statistics_unknown ( &total_unknown );
+
+          int ret = 1;
+          start = profile_start ();
+          if ( owners )
+            ret = processes_update_owners ( processes,
+                                            co,
+                                            ebpf_sock_owners ( ebpf_sock ),
+                                            owners );
+          else if ( !total_unknown ||
+                    now - last_full_update >= T_RECONCILE ||
+                    !processes_update_tuples (
+                            processes, unknown, total_unknown ) )
+            {
+              ret = update_processes ( processes, co, ebpf_fds );
+              last_full_update = now;
             }
+          profile_end ( PHASE_PROCESSES_UPDATE, start );
+
+          statistics_unknown_done ( tick, view_conns ( co ) );
+
+          if ( !ret )
+            goto EXIT;
+
+          if ( ebpf_sock )
+            ebpf_sock_clear ( ebpf_sock );
+
+          need_update_processes = false;
+        }
+      else if ( ebpf_sock )
+        {
+          // sockets of last refresh already has traffic associated,
+          // keep only the owners reported since then
+          ebpf_sock_clear ( ebpf_sock );
+          ebpf_sock_read ( ebpf_sock );
         }
 
+      lag_tick_end ( tick_start );
+
+      // above of budget, caches are trimmed and sub-flows idle are
+      // removed in next update of processes
+      if ( co->max_memory && memory_enforce ( processes, co->max_memory ) )
+        need_update_processes = true;
+
+      // without terminal, nothing more to show after the end of file.
+      // the tick of last packets is closed only in next refresh
+      if ( pcap && co->headless && pcap_file_eof ( pcap ) &&
+           ++refreshes_eof == 2 )
+        goto EXIT;
     }  // main loop
 
 EXIT:
 
-  socket_free ( sock );
-  ring_free ( ring );
+  // tables are released below
+  scan_wait ( &scan );
+  if ( early.slots )
+    flow_acc_free ( &early );
+
+  if ( epfd != -1 )
+    close ( epfd );
+  if ( tfd != -1 )
+    close ( tfd );
+  filters_free ( &filters );
+  capture_free ( capture );
+  pcap_file_close ( pcap );
+  ebpf_capture_free ( ebpf );
+  ebpf_sock_free ( ebpf_sock );
+  ebpf_fds_free ( ebpf_fds );
+  ebpf_xdp_free ( xdp );
+  proc_events_free ( proc_events );
+  iface_free ();
+  for ( unsigned int i = 0; i < total_taps; i++ )
+    tap_close ( &taps[i] );
+  packet_free ();
+  log_flush ( co );
   log_free ();
+  exporter_free ();
+  control_free ();
+  stream_free ();
+  snapshot_free ();
+  record_free ();
+  agent_free ();
+  if ( !co->headless )
+    tui_free ();
+
+  // after restore of terminal, before of release the pools
+  profile_dump ( stderr );
+  if ( profile_enabled () )
+    pool_dump ( stderr );
+
+  // flows still open, while processes of connections exist
+  if ( co->flow_export || co->flow_file )
+    connection_foreach ( export_flow, NULL );
+  flow_export_free ();
+
   processes_free ( processes );
   connection_free ();
+  networks_free ();
+  rate_free ();
   resolver_free ();
-  tui_free ();
+  service_free ();
 
   return prog_exit;
 }
@@ -286,10 +842,526 @@ sig_handler ( int sig )
 }
 
 static void
-config_sig_handler ( void )
+sighup_handler ( UNUSED int sig )
+{
+  need_reload = 1;
+}
+
+static void
+config_sig_handler ( const struct config_op *co )
 {
   struct sigaction sigact = { .sa_handler = sig_handler };
 
   sigaction ( SIGINT, &sigact, NULL );
   sigaction ( SIGTERM, &sigact, NULL );
+
+  // only with file of exclusions or services, otherwise keep default action
+  if ( ( co->exclude_file && !co->ebpf ) ||
+       ( co->view_conections && !co->headless && co->translate_service ) )
+    {
+      struct sigaction sighup = { .sa_handler = sighup_handler };
+      sigaction ( SIGHUP, &sighup, NULL );
+    }
+}
+
+// rebuild filter with exclusions file, if the file is invalid the current
+// filter is kept
+static void
+reload_filter ( const struct config_op *co,
+                const struct tap *taps,
+                unsigned int total_taps,
+                struct capture *capture )
+{
+  struct filters filters;
+
+  if ( !filters_build ( &filters, co ) )
+    return;
+
+  if ( capture )
+    capture_filter ( capture, &filters );
+
+  for ( unsigned int i = 0; i < total_taps; i++ )
+    filter_attach ( taps[i].sock, &filters.links[taps[i].link] );
+
+  filters_free ( &filters );
+}
+
+// refreshes without drops until rate of sample is halved
+#define SAMPLE_CALM 10
+
+/* with pressure (drops in ring) in last refresh the rate of sample is
+   doubled, after some refreshes without it is halved until the rate of user */
+static void
+adapt_sample ( struct config_op *co,
+               const struct tap *taps,
+               unsigned int total_taps,
+               struct capture *capture,
+               bool pressure )
+{
+  static unsigned int calm;
+
+  unsigned int sample = co->sample;
+
+  if ( pressure )
+    {
+      calm = 0;
+      sample = MIN ( sample * 2, MAX_SAMPLE );
+    }
+  else if ( ++calm >= SAMPLE_CALM && sample > sample_user )
+    {
+      calm = 0;
+      sample = MAX ( sample / 2, sample_user );
+    }
+
+  if ( sample == co->sample )
+    return;
+
+  co->sample = sample;
+  reload_filter ( co, taps, total_taps, capture );
+  statistics_sample ( sample );
+}
+
+/* command of control socket, applied between two refreshes. return the
+   error to client or NULL */
+static const char *
+apply_control ( struct config_op *co,
+                const struct control_cmd *cmd,
+                const struct tap *taps,
+                unsigned int total_taps,
+                struct capture *capture,
+                int tfd )
+{
+  // filters in kernel are only of rings
+  bool ring = capture || total_taps;
+
+  switch ( cmd->op )
+    {
+      case CONTROL_PROTOCOL:
+        if ( !ring )
+          return "protocol is fixed with '--ebpf' or '--read'";
+
+        co->proto = cmd->value;
+        reload_filter ( co, taps, total_taps, capture );
+        break;
+      case CONTROL_CONNECTIONS:
+        co->view_conections = cmd->value;
+        break;
+      case CONTROL_RESOLVE:
+        co->translate_host = co->translate_service = cmd->value;
+        break;
+      case CONTROL_REFRESH:
+        // traffic of eBPF and records are by refresh
+        if ( co->ebpf || co->record )
+          return "refresh is fixed with '--ebpf' or '--record'";
+
+        if ( !timer_set ( tfd, cmd->value ) )
+          return "timer not changed";
+
+        refresh_timer = cmd->value;
+        break;
+      case CONTROL_SAMPLE:
+        if ( !ring || co->xdp )
+          return "sample is only of capture by ring";
+
+        co->sample = sample_user = cmd->value;
+        reload_filter ( co, taps, total_taps, capture );
+        statistics_sample ( co->sample );
+        break;
+      case CONTROL_SNAPSHOT:
+        if ( !co->log )
+          return "without file of '-f'";
+
+        log_flush ( co );
+        break;
+      default:
+        break;
+    }
+
+  return NULL;
+}
+
+/* traffic of connections, also to flows, not accounted in level
+   OVERLOAD_CONNECTIONS */
+static bool
+view_conns ( const struct config_op *co )
+{
+  return ( co->view_conections || co->flow_export || co->flow_file ) &&
+         overload_level () < OVERLOAD_CONNECTIONS;
+}
+
+static void
+export_flow ( connection_t *conn, UNUSED void *user_data )
+{
+  flow_export_add ( conn );
+}
+
+/* read blocks availables of ring of tap, at most the size of ring on each
+   wakeup, so the timer is checked even if blocks never stop of arriving.
+   return true if any packet not was associated with a process */
+static bool
+read_tap ( struct tap *tap, bool view_conections )
+{
+  struct tpacket_block_desc *pbd = tap_block ( tap );
+  bool need_update_processes = false;
+
+  for ( unsigned int nb = 0; nb < tap->ring->req.tp_block_nr &&
+                             pbd->hdr.bh1.block_status & TP_STATUS_USER;
+        nb++, pbd = tap_block ( tap ) )
+    {
+      struct tpacket3_hdr *ppd;
+
+      ppd = ( struct tpacket3_hdr * ) ( ( uint8_t * ) pbd +
+                                        pbd->hdr.bh1.offset_to_first_pkt );
+
+      PROBE2 ( block_acquire, tap->block_num, pbd->hdr.bh1.num_pkts );
+
+      lag_block ( pbd->hdr.bh1.ts_last_pkt.ts_sec,
+                  pbd->hdr.bh1.ts_last_pkt.ts_nsec );
+
+      // expire old fragments with time of capture, without syscall
+      packet_tick ( pbd->hdr.bh1.ts_last_pkt.ts_sec );
+
+      uint64_t cycles = profile_cycles_start ();
+
+      // read all frames of block, parsed in batches so the lookups
+      // of connections can be prefetched
+      struct packet batch[STATISTICS_BATCH];
+      size_t total_batch = 0;
+
+      for ( size_t i = 0; i < pbd->hdr.bh1.num_pkts; i++,
+                   ppd = ( struct tpacket3_hdr * ) ( ( uint8_t * ) ppd +
+                                                     ppd->tp_next_offset ) )
+        {
+          // se houver dados porem não foi possivel identificar o trafego,
+          // não tem estatisticas para ser adicionada aos processos.
+          // deve ser trafego de protocolo não suportado
+          struct packet *packet = &batch[total_batch];
+          memset ( packet, 0, sizeof ( *packet ) );
+          if ( !tap->parse ( packet, ppd ) )
+            continue;
+
+          if ( ++total_batch < ARRAY_SIZE ( batch ) )
+            continue;
+
+          // se não for possivel identificar de qual processo o trafego
+          // pertence é sinal que existe um novo processo, ou nova conexão
+          // de um processo existente, que ainda não foi mapeado, então
+          // anotamos que sera necessario atualizar a lista de processos
+          // com conexões ativas.
+          if ( !statistics_add_batch ( batch, total_batch, view_conections ) )
+            need_update_processes = true;
+
+          total_batch = 0;
+        }
+
+      // remaining packets of block
+      if ( total_batch &&
+           !statistics_add_batch ( batch, total_batch, view_conections ) )
+        need_update_processes = true;
+
+      profile_packets ( cycles, pbd->hdr.bh1.num_pkts );
+
+      PROBE1 ( block_release, tap->block_num );
+      tap_release ( tap, pbd );
+    }
+
+  return need_update_processes;
+}
+
+// blocks of ring to counters of flows, at most the size of ring
+static void
+drain_tap ( struct tap *tap, struct flow_acc *acc )
+{
+  for ( unsigned int nb = 0;
+        nb < tap->ring->req.tp_block_nr && tap_read_block ( tap, acc );
+        nb++ )
+    ;
+}
+
+/* show traffic of a record in terminal, each tick of record is a
+   expiration of timer, of interval of refresh of record divided by speed */
+static int
+replay_main ( struct config_op *co )
+{
+  struct processes view = { 0 };
+  int epfd = -1;
+  int tfd = -1;
+  uint32_t tick;
+
+  if ( !replay_init ( co->replay, &co->refresh, &tick ) )
+    {
+      fatal_error ( "Error read record '%s'", co->replay );
+      return EXIT_FAILURE;
+    }
+
+  // samples of windows depend of interval of record
+  for ( unsigned int i = 0; i < co->total_rate_windows; i++ )
+    {
+      if ( ( uint64_t ) co->rate_windows[i] * 1000 / co->refresh >
+           MAX_RATE_SAMPLES )
+        {
+          fatal_error ( "Windows of '--rate-windows' too large to record" );
+          goto EXIT;
+        }
+    }
+
+  rate_init ( co );
+
+  // connections are not recorded
+  co->view_conections = false;
+
+  view.proc = vector_new ( sizeof ( process_t * ) );
+  if ( !view.proc )
+    {
+      fatal_error ( "Error alloc processes of record" );
+      goto EXIT;
+    }
+
+  define_sufix ( co->view_si, co->view_bytes );
+  if ( !tui_init ( co ) )
+    {
+      fatal_error ( "Error setup terminal user interface" );
+      goto EXIT;
+    }
+
+  config_sig_handler ( co );
+
+  tfd = timer_periodic ( MAX ( co->refresh / co->replay_speed, 1U ) );
+  epfd = epoll_create1 ( EPOLL_CLOEXEC );
+  if ( tfd == -1 || epfd == -1 || !event_add ( epfd, STDIN_FILENO ) ||
+       !event_add ( epfd, tfd ) )
+    {
+      fatal_error ( "Error create event loop" );
+      goto EXIT;
+    }
+
+  while ( !prog_exit )
+    {
+      struct epoll_event events[MAX_EVENTS];
+
+      int ne = epoll_wait ( epfd, events, ARRAY_SIZE ( events ), -1 );
+      if ( ne == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "epoll_wait: \"%s\"", strerror ( errno ) );
+          goto EXIT;
+        }
+
+      for ( int i = 0; i < ne; i++ )
+        {
+          if ( events[i].data.fd == STDIN_FILENO &&
+               tui_handle_input ( co ) == P_EXIT )
+            goto EXIT;
+        }
+
+      // after of end of file the rates go to zero
+      for ( uint64_t exp = timer_expirations ( tfd ); exp; exp--, tick++ )
+        {
+          replay_tick ( &view, tick );
+          co->running += co->refresh;
+
+          rate_calc ( co, tick + 1 );
+          if ( exp == 1 )
+            tui_show ( &view, co );
+          rate_update ();
+        }
+    }
+
+EXIT:
+  if ( epfd != -1 )
+    close ( epfd );
+  if ( tfd != -1 )
+    close ( tfd );
+  tui_free ();
+  replay_free ( &view );
+  if ( view.proc )
+    vector_free ( view.proc );
+  rate_free ();
+
+  return prog_exit;
+}
+
+static int
+collector_main ( struct config_op *co )
+{
+  struct processes view = { 0 };
+  int epfd = -1;
+  int tfd = -1;
+
+  rate_init ( co );
+
+  // connections are not sent by agents
+  co->view_conections = false;
+
+  view.proc = vector_new ( sizeof ( process_t * ) );
+  if ( !view.proc )
+    {
+      fatal_error ( "Error alloc processes of agents" );
+      goto EXIT;
+    }
+
+  if ( !collector_init ( co ) )
+    {
+      fatal_error ( "Error listen agents in port %u", co->collector );
+      goto EXIT;
+    }
+
+  define_sufix ( co->view_si, co->view_bytes );
+  if ( !tui_init ( co ) )
+    {
+      fatal_error ( "Error setup terminal user interface" );
+      goto EXIT;
+    }
+
+  config_sig_handler ( co );
+
+  tfd = timer_periodic ( co->refresh );
+  epfd = epoll_create1 ( EPOLL_CLOEXEC );
+  if ( tfd == -1 || epfd == -1 || !event_add ( epfd, STDIN_FILENO ) ||
+       !event_add ( epfd, tfd ) || !event_add ( epfd, collector_fd () ) )
+    {
+      fatal_error ( "Error create event loop" );
+      goto EXIT;
+    }
+
+  while ( !prog_exit )
+    {
+      struct epoll_event events[MAX_EVENTS];
+
+      int ne = epoll_wait ( epfd, events, ARRAY_SIZE ( events ), -1 );
+      if ( ne == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "epoll_wait: \"%s\"", strerror ( errno ) );
+          goto EXIT;
+        }
+
+      for ( int i = 0; i < ne; i++ )
+        {
+          if ( events[i].data.fd == STDIN_FILENO &&
+               tui_handle_input ( co ) == P_EXIT )
+            goto EXIT;
+
+          // traffic is of tick of arrival
+          if ( events[i].data.fd == collector_fd () )
+            collector_handle ( &view, rate_now () );
+        }
+
+      uint64_t expirations = timer_expirations ( tfd );
+      if ( !expirations )
+        continue;
+
+      co->running += expirations * co->refresh;
+
+      collector_update ( &view );
+      rate_calc ( co, rate_now () );
+      tui_show ( &view, co );
+      rate_update ();
+    }
+
+EXIT:
+  if ( epfd != -1 )
+    close ( epfd );
+  if ( tfd != -1 )
+    close ( tfd );
+  tui_free ();
+  collector_free ( &view );
+  if ( view.proc )
+    vector_free ( view.proc );
+  rate_free ();
+
+  return prog_exit;
+}
+
+static int
+event_add ( int epfd, int fd )
+{
+  struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+
+  if ( epoll_ctl ( epfd, EPOLL_CTL_ADD, fd, &ev ) == -1 )
+    {
+      ERROR_DEBUG ( "epoll_ctl: \"%s\"", strerror ( errno ) );
+      return 0;
+    }
+
+  return 1;
+}
+
+// update of all processes, with sockets read by eBPF if available
+static int
+update_processes ( struct processes *processes,
+                   struct config_op *co,
+                   struct ebpf_fds *ebpf_fds )
+{
+  if ( ebpf_fds )
+    {
+      ssize_t total = ebpf_fds_read ( ebpf_fds );
+
+      if ( total != -1 )
+        return processes_update_fds (
+                processes, co, ebpf_fds_get ( ebpf_fds ), total );
+    }
+
+  return processes_update ( processes, co );
+}
+
+static void *
+scan_thread ( void *arg )
+{
+  struct scan *scan = arg;
+  uint64_t one = 1;
+
+  scan->ret =
+          update_processes ( scan->processes, scan->co, scan->ebpf_fds );
+
+  if ( write ( scan->efd, &one, sizeof ( one ) ) == -1 )
+    {
+      ERROR_DEBUG ( "write eventfd: \"%s\"", strerror ( errno ) );
+    }
+
+  return NULL;
+}
+
+static bool
+scan_start ( struct scan *scan )
+{
+  scan->efd = eventfd ( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+  if ( scan->efd == -1 )
+    return false;
+
+  // signals must be delivered only to main thread
+  sigset_t set, old_set;
+  sigfillset ( &set );
+  pthread_sigmask ( SIG_SETMASK, &set, &old_set );
+
+  scan->running = !pthread_create ( &scan->tid, NULL, scan_thread, scan );
+
+  pthread_sigmask ( SIG_SETMASK, &old_set, NULL );
+
+  return scan->running;
+}
+
+// wait end of scan, return value of update_processes, 1 if not running
+static int
+scan_wait ( struct scan *scan )
+{
+  if ( scan->running )
+    {
+      pthread_join ( scan->tid, NULL );
+      scan->running = false;
+    }
+  else
+    scan->ret = 1;
+
+  if ( scan->efd != -1 )
+    {
+      close ( scan->efd );
+      scan->efd = -1;
+    }
+
+  return scan->ret;
 }
@@ -0,0 +1,103 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memory.h"
+#include "connection.h"
+#include "hashtable.h"
+#include "vector.h"
+#include "ring.h"
+#include "networks.h"
+#include "m_error.h"
+#include "resolver/domain.h"
+
+// trimmed until this percent of budget, so not trimmed in each refresh
+#define MEMORY_LOW_MARK 90
+
+static const char *const names[TOTAL_MEMORY_TABLES] = {
+  [MEMORY_CONNECTIONS] = "connections", [MEMORY_PROCESSES] = "processes",
+  [MEMORY_HASHTABLES] = "hashtables",   [MEMORY_DOMAINS] = "domains",
+  [MEMORY_VECTORS] = "vectors",         [MEMORY_NETWORKS] = "networks",
+  [MEMORY_RING] = "ring",
+};
+
+void
+memory_usage ( struct memory_usage *mu )
+{
+  mu->bytes[MEMORY_CONNECTIONS] = connection_memory ();
+  mu->bytes[MEMORY_PROCESSES] = processes_memory ();
+  mu->bytes[MEMORY_HASHTABLES] = hashtable_memory ();
+  mu->bytes[MEMORY_DOMAINS] = cache_domain_memory ();
+  mu->bytes[MEMORY_VECTORS] = vector_memory ();
+  mu->bytes[MEMORY_NETWORKS] = networks_memory ();
+  mu->bytes[MEMORY_RING] = ring_memory ();
+
+  mu->total = 0;
+  for ( int i = 0; i < TOTAL_MEMORY_TABLES; i++ )
+    mu->total += mu->bytes[i];
+}
+
+const char *
+memory_table_name ( enum memory_table table )
+{
+  return names[table];
+}
+
+// the ring is of fixed size, by options '--ring-*', out of budget
+static size_t
+tables_memory ( struct memory_usage *mu )
+{
+  memory_usage ( mu );
+
+  return mu->total - mu->bytes[MEMORY_RING];
+}
+
+bool
+memory_enforce ( struct processes *procs, size_t budget )
+{
+  struct memory_usage mu;
+
+  if ( tables_memory ( &mu ) <= budget )
+    return false;
+
+  size_t low = budget / 100 * MEMORY_LOW_MARK;
+
+  connection_trim ();
+  processes_trim ( procs );
+
+  // names are the only cache that can be smaller without lost of data
+  size_t used = tables_memory ( &mu );
+  if ( used > low )
+    {
+      size_t excess = used - low;
+      size_t domains = mu.bytes[MEMORY_DOMAINS];
+
+      cache_domain_shrink ( ( domains > excess ) ? domains - excess : 0 );
+    }
+
+  used = tables_memory ( &mu );
+  if ( used > budget )
+    {
+      ERROR_DEBUG ( "memory %zu KiB above of budget %zu KiB",
+                    used >> 10,
+                    budget >> 10 );
+    }
+
+  return true;
+}
@@ -0,0 +1,67 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "processes.h"
+
+/* accounting of memory in use by tables of netproc, of counters kept by
+   each module, so is cheap to read in each refresh.
+   the pools keep the slabs of objects freed (see pool.h), so the memory of
+   pools here is of objects in use, the memory reserved is in pool_dump */
+
+enum memory_table
+{
+  MEMORY_CONNECTIONS,  // connections and indexes by tuple and inode
+  MEMORY_PROCESSES,    // processes and scans of /proc/<pid>/
+  MEMORY_HASHTABLES,   // buckets and entries of all hashtables
+  MEMORY_DOMAINS,      // cache of names of hosts
+  MEMORY_VECTORS,      // vectors, as of connections of processes
+  MEMORY_NETWORKS,     // tables of prefixes of networks.h
+  MEMORY_RING,         // ring buffers of capture
+  TOTAL_MEMORY_TABLES
+};
+
+struct memory_usage
+{
+  size_t bytes[TOTAL_MEMORY_TABLES];
+  size_t total;
+};
+
+void
+memory_usage ( struct memory_usage *mu );
+
+const char *
+memory_table_name ( enum memory_table table );
+
+/* with usage of tables (all except ring) above of 'budget' (bytes), the
+   caches are trimmed until 90% of budget: text of connections without
+   traffic, sub-flows idle, space not used of vectors and buffers of scans
+   and names of hosts, least recently used first. the connections and
+   processes of kernel are not removed. return true if trimmed, sub-flows
+   are removed only in next update of processes */
+bool
+memory_enforce ( struct processes *procs, size_t budget );
+
+#endif  // MEMORY_H
@@ -0,0 +1,224 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE  // setns
+#include <errno.h>
+#include <fcntl.h>     // open
+#include <sched.h>     // setns
+#include <stdio.h>     // snprintf
+#include <string.h>    // strerror
+#include <unistd.h>    // close
+#include <sys/stat.h>  // stat
+
+#include "netns.h"
+#include "sock_diag.h"
+#include "vector.h"
+#include "directory.h"  // proc_root
+#include "m_error.h"
+
+// <root>/<pid>/ns/net
+#define MAX_PATH_NS PROC_ROOT_MAX + 20
+
+struct netns
+{
+  unsigned long inode;
+  int diag_sock;      // -1 if can't be created, namespace is ignored
+  unsigned int refs;  // processes in namespace
+  bool pending;       // not yet read
+};
+
+static struct netns *namespaces;  // vector
+
+// namespace of netproc, to return after create socket in other
+static unsigned long self_inode;
+static int self_fd = -1;
+
+// without permission to setns, others namespaces not are read
+static bool disabled = true;
+
+bool
+netns_init ( void )
+{
+  struct stat st;
+
+  self_fd = open ( "/proc/self/ns/net", O_RDONLY | O_CLOEXEC );
+  if ( self_fd == -1 || fstat ( self_fd, &st ) == -1 )
+    {
+      ERROR_DEBUG ( "Error open namespace: %s", strerror ( errno ) );
+      return false;
+    }
+
+  namespaces = vector_new ( sizeof ( struct netns ) );
+  if ( !namespaces )
+    return false;
+
+  self_inode = st.st_ino;
+  disabled = false;
+
+  return true;
+}
+
+static struct netns *
+find_netns ( unsigned long inode )
+{
+  for ( size_t i = 0; i < vector_size ( namespaces ); i++ )
+    {
+      if ( namespaces[i].inode == inode )
+        return &namespaces[i];
+    }
+
+  return NULL;
+}
+
+// socket sock_diag in namespace of 'fd', -1 on error
+static int
+create_diag_sock ( int fd )
+{
+  if ( setns ( fd, CLONE_NEWNET ) == -1 )
+    {
+      ERROR_DEBUG ( "Error setns: %s", strerror ( errno ) );
+      if ( errno == EPERM )
+        disabled = true;
+
+      return -1;
+    }
+
+  int sock = sock_diag_init ();
+
+  // only this thread changed of namespace
+  if ( setns ( self_fd, CLONE_NEWNET ) == -1 )
+    {
+      ERROR_DEBUG ( "Error setns to netproc: %s", strerror ( errno ) );
+      disabled = true;
+    }
+
+  return sock;
+}
+
+unsigned long
+netns_get ( pid_t pid )
+{
+  if ( disabled )
+    return 0;
+
+  char path[MAX_PATH_NS];
+  struct stat st;
+
+  snprintf ( path, sizeof path, "%s/%d/ns/net", proc_root (), pid );
+
+  // process closed or of same namespace
+  if ( stat ( path, &st ) == -1 || st.st_ino == self_inode )
+    return 0;
+
+  struct netns *ns = find_netns ( st.st_ino );
+  if ( ns )
+    {
+      ns->refs++;
+      return ns->inode;
+    }
+
+  int fd = open ( path, O_RDONLY | O_CLOEXEC );
+  if ( fd == -1 )
+    return 0;
+
+  struct netns new_ns = { .inode = st.st_ino, .refs = 1, .pending = true };
+  new_ns.diag_sock = create_diag_sock ( fd );
+  close ( fd );
+
+  if ( disabled || !vector_push ( namespaces, &new_ns ) )
+    {
+      sock_diag_free ( new_ns.diag_sock );
+      return 0;
+    }
+
+  return new_ns.inode;
+}
+
+void
+netns_put ( unsigned long inode )
+{
+  struct netns *ns;
+
+  // namespaces already freed, at exit
+  if ( !inode || !namespaces || !( ns = find_netns ( inode ) ) ||
+       --ns->refs )
+    return;
+
+  sock_diag_free ( ns->diag_sock );
+
+  // order not matter, last take the place
+  *ns = namespaces[vector_size ( namespaces ) - 1];
+  vector_pop ( namespaces );
+}
+
+bool
+netns_pending ( void )
+{
+  for ( size_t i = 0; namespaces && i < vector_size ( namespaces ); i++ )
+    {
+      if ( namespaces[i].pending )
+        return true;
+    }
+
+  return false;
+}
+
+bool
+netns_foreach ( bool only_pending,
+                bool ( *func ) ( int sock, void *user_data ),
+                void *user_data )
+{
+  for ( size_t i = 0; namespaces && i < vector_size ( namespaces ); i++ )
+    {
+      struct netns *ns = &namespaces[i];
+
+      if ( only_pending && !ns->pending )
+        continue;
+
+      if ( ns->diag_sock != -1 && !func ( ns->diag_sock, user_data ) )
+        return false;
+    }
+
+  return true;
+}
+
+void
+netns_read ( void )
+{
+  for ( size_t i = 0; namespaces && i < vector_size ( namespaces ); i++ )
+    namespaces[i].pending = false;
+}
+
+void
+netns_free ( void )
+{
+  for ( size_t i = 0; namespaces && i < vector_size ( namespaces ); i++ )
+    sock_diag_free ( namespaces[i].diag_sock );
+
+  if ( namespaces )
+    vector_free ( namespaces );
+
+  if ( self_fd != -1 )
+    close ( self_fd );
+
+  namespaces = NULL;
+  self_fd = -1;
+  disabled = true;
+}
@@ -0,0 +1,63 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETNS_H
+#define NETNS_H
+
+#include <stdbool.h>
+#include <sys/types.h>  // pid_t
+
+/* network namespaces of processes (containers), others than of netproc.
+   sockets of a namespace only are exported to sockets sock_diag created in
+   it, so for each namespace a socket is created once (setns), shared by
+   all processes of namespace. requires CAP_SYS_ADMIN, if not allowed
+   only the namespace of netproc is read */
+
+bool
+netns_init ( void );
+
+/* reference to namespace of process 'pid', return inode of namespace or 0
+   if it is the same of netproc (or on error) */
+unsigned long
+netns_get ( pid_t pid );
+
+// release reference of netns_get, namespace is closed by last reference
+void
+netns_put ( unsigned long inode );
+
+// true if there are namespaces not yet read, see netns_read
+bool
+netns_pending ( void );
+
+/* call 'func' with socket sock_diag of each namespace, if 'only_pending'
+   only of new namespaces. return false if 'func' returned false */
+bool
+netns_foreach ( bool only_pending,
+                bool ( *func ) ( int sock, void *user_data ),
+                void *user_data );
+
+// mark all namespaces as read, after update of connections
+void
+netns_read ( void );
+
+void
+netns_free ( void );
+
+#endif  // NETNS_H
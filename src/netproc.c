@@ -0,0 +1,398 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>  // uintptr_t
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>  // calloc
+#include <string.h>  // strdup
+#include <time.h>    // time
+
+#include "netproc.h"
+#include "config.h"
+#include "capture.h"
+#include "connection.h"
+#include "processes.h"
+#include "filter.h"
+#include "flow_acc.h"
+#include "packet.h"
+#include "ring.h"
+#include "rate.h"
+#include "hash.h"
+#include "hashtable.h"
+#include "vector.h"
+#include "intern.h"
+#include "macro_util.h"  // UNUSED
+#include "m_error.h"
+
+/* the module state of netproc (table of processes of processes.c, indexes
+   of sockets of connection.c, ring of rate.c and fragments of packet.c) is
+   file-scope, so the library is a singleton of process, as the program: one
+   capture, opened by netproc_init and closed by netproc_close. values of
+   NETPROC_* are same of TCP and UDP */
+
+static struct
+{
+  bool open;
+  struct config_op co;
+  struct tap taps[MAX_IFACES];
+  unsigned int total_taps;
+  char *interfaces;  // copy of options, tokens are in co.ifaces
+
+  struct flow_acc acc;  // flows read since last tick
+
+  struct netproc_record *records;  // vector, of last tick
+  hashtable_t *ht_records;         // pid to index + 1 in records
+
+  struct config_op co_procs;  // to updates of processes, all protocols
+  struct processes *procs;
+  uint32_t last_update;  // updates by miss, at most one by second
+} np;
+
+static bool
+ht_cb_compare ( const void *key1, const void *key2 )
+{
+  return ( *( const pid_t * ) key1 == *( const pid_t * ) key2 );
+}
+
+static hash_t
+ht_cb_hash ( const void *key )
+{
+  return hash_u64 ( ( uint32_t ) * ( const pid_t * ) key );
+}
+
+static int
+record_remove ( UNUSED hashtable_t *ht,
+                UNUSED void *value,
+                UNUSED void *user_data )
+{
+  return 1;
+}
+
+// records of last tick, with the references to names
+static void
+records_clear ( void )
+{
+  for ( size_t i = 0; i < vector_size ( np.records ); i++ )
+    intern_put ( np.records[i].name );
+
+  hashtable_foreach_remove ( np.ht_records, record_remove, NULL );
+  vector_clear ( np.records );
+}
+
+static bool
+tables_init ( void )
+{
+  config_default ( &np.co_procs );
+  np.co_procs.proto = TCP | UDP;
+
+  rate_init ( &np.co_procs );
+  hash_init ();
+
+  if ( !packet_init ( np.co_procs.max_fragments ) ||
+       !( np.procs = processes_init () ) || !connection_init () ||
+       !processes_update ( np.procs, &np.co_procs ) )
+    {
+      ERROR_DEBUG ( "%s", "Error init tables of processes" );
+      return false;
+    }
+
+  np.last_update = time ( NULL );
+
+  return true;
+}
+
+// interfaces by comma, without blocks of ring (':N') of command line
+static bool
+set_interfaces ( const char *interfaces )
+{
+  np.co.total_ifaces = 1;
+
+  if ( !interfaces )
+    return true;
+
+  if ( !( np.interfaces = strdup ( interfaces ) ) )
+    return false;
+
+  np.co.total_ifaces = 0;
+
+  char *save;
+  for ( char *tok = strtok_r ( np.interfaces, ",", &save ); tok;
+        tok = strtok_r ( NULL, ",", &save ) )
+    {
+      if ( np.co.total_ifaces == MAX_IFACES )
+        return false;
+
+      np.co.ifaces[np.co.total_ifaces++] = tok;
+    }
+
+  return np.co.total_ifaces > 0;
+}
+
+int
+netproc_init ( const struct netproc_options *op )
+{
+  struct filters filters = { 0 };
+
+  if ( np.open )
+    {
+      ERROR_DEBUG ( "%s", "Error netproc already initialized" );
+      return -1;
+    }
+
+  // from here, all is released by netproc_close
+  np.open = true;
+
+  config_default ( &np.co );
+  if ( op->protocols )
+    np.co.proto = op->protocols & ( TCP | UDP );
+
+  if ( !set_interfaces ( op->interfaces ) )
+    {
+      ERROR_DEBUG ( "Error interfaces '%s'", op->interfaces );
+      goto ERROR_CLOSE;
+    }
+
+  if ( !tables_init () )
+    goto ERROR_CLOSE;
+
+  np.records = vector_new ( sizeof ( struct netproc_record ) );
+  np.ht_records = hashtable_new ( ht_cb_hash, ht_cb_compare, NULL );
+  if ( !np.records || !np.ht_records || !flow_acc_init ( &np.acc ) )
+    goto ERROR_CLOSE;
+
+  if ( !ring_geometry ( &np.co ) || !filters_build ( &filters, &np.co ) )
+    goto ERROR_CLOSE;
+
+  for ( unsigned int i = 0; i < np.co.total_ifaces; i++ )
+    {
+      // increment first, tap partially opened is closed
+      np.total_taps++;
+      if ( !tap_open ( &np.taps[i], &np.co, i, &filters ) )
+        {
+          ERROR_DEBUG ( "Error open interface '%s'",
+                        np.co.ifaces[i] ? np.co.ifaces[i] : "all" );
+          goto ERROR_CLOSE;
+        }
+    }
+
+  filters_free ( &filters );
+
+  return 0;
+
+ERROR_CLOSE:
+  filters_free ( &filters );
+  netproc_close ();
+  return -1;
+}
+
+int
+netproc_read ( int timeout )
+{
+  struct pollfd pfds[MAX_IFACES];
+  int blocks = 0;
+
+  if ( !np.open )
+    return -1;
+
+  for ( unsigned int i = 0; i < np.total_taps; i++ )
+    pfds[i] = ( struct pollfd ){ .fd = np.taps[i].sock,
+                                 .events = POLLIN | POLLPRI };
+
+  // with timeout 0, only blocks already of user
+  if ( timeout && poll ( pfds, np.total_taps, timeout ) == -1 &&
+       errno != EINTR )
+    return -1;
+
+  for ( unsigned int i = 0; i < np.total_taps; i++ )
+    {
+      while ( tap_read_block ( &np.taps[i], &np.acc ) )
+        blocks++;
+    }
+
+  return blocks;
+}
+
+static process_t *
+owner ( const struct tuple *tuple )
+{
+  hash_t hash = connection_hash_tuple ( tuple );
+  connection_t *conn = connection_get_by_tuple_hash ( tuple, hash );
+
+  if ( !conn )
+    conn = connection_get_by_local ( tuple );
+
+  return ( conn && conn->proc ) ? conn->proc : NULL;
+}
+
+// a socket not found, maybe new, update processes
+static void
+update_by_miss ( void )
+{
+  uint32_t now = time ( NULL );
+
+  if ( now == np.last_update )
+    return;
+
+  np.last_update = now;
+  if ( !processes_update ( np.procs, &np.co_procs ) )
+    {
+      ERROR_DEBUG ( "%s", "Error update processes" );
+    }
+}
+
+static bool
+add_record ( const struct flow_delta *fd )
+{
+  process_t *proc = owner ( &fd->pkt.tuple );
+  if ( !proc )
+    proc = processes_unattributed ();
+
+  struct netproc_record *rec;
+  uintptr_t idx = ( uintptr_t ) hashtable_get ( np.ht_records, &proc->pid );
+
+  if ( idx )
+    rec = &np.records[idx - 1];
+  else
+    {
+      struct netproc_record new = { .name = intern_ref ( proc->name ),
+                                    .pid = proc->pid };
+
+      if ( !vector_push ( np.records, &new ) )
+        {
+          intern_put ( new.name );
+          return false;
+        }
+
+      idx = vector_size ( np.records );
+      if ( !hashtable_set ( np.ht_records, &proc->pid, ( void * ) idx ) )
+        {
+          vector_pop ( np.records );
+          intern_put ( new.name );
+          return false;
+        }
+
+      rec = &np.records[idx - 1];
+    }
+
+  if ( fd->pkt.direction == PKT_UPL )
+    {
+      rec->tx_bytes += fd->bytes;
+      rec->tx_packets += fd->packets;
+    }
+  else
+    {
+      rec->rx_bytes += fd->bytes;
+      rec->rx_packets += fd->packets;
+    }
+
+  return true;
+}
+
+int
+netproc_tick ( netproc_callback cb, void *user_data )
+{
+  struct flow_acc *acc = &np.acc;
+  bool ret = true;
+
+  if ( !np.open )
+    return -1;
+
+  netproc_read ( 0 );
+
+  records_clear ();
+
+  // processes are updated before of records
+  for ( size_t i = 0; acc->used && i < acc->size; i++ )
+    {
+      if ( acc->slots[i].packets && !owner ( &acc->slots[i].pkt.tuple ) )
+        {
+          update_by_miss ();
+          break;
+        }
+    }
+
+  for ( size_t i = 0; acc->used && i < acc->size; i++ )
+    {
+      struct flow_delta *fd = &acc->slots[i];
+
+      if ( !fd->packets )
+        continue;
+
+      // without memory traffic is lost, but table is cleared
+      if ( !add_record ( fd ) )
+        ret = false;
+
+      fd->packets = 0;
+      acc->used--;
+    }
+
+  if ( !ret )
+    {
+      ERROR_DEBUG ( "%s", "Error alloc records" );
+    }
+
+  size_t total = vector_size ( np.records );
+  if ( cb && total )
+    cb ( np.records, total, user_data );
+
+  return ( ret ) ? ( int ) total : -1;
+}
+
+const struct netproc_record *
+netproc_records ( size_t *total )
+{
+  *total = ( np.records ) ? vector_size ( np.records ) : 0;
+
+  return np.records;
+}
+
+void
+netproc_close ( void )
+{
+  if ( !np.open )
+    return;
+
+  for ( unsigned int i = 0; i < np.total_taps; i++ )
+    tap_close ( &np.taps[i] );
+
+  if ( np.acc.slots )
+    flow_acc_free ( &np.acc );
+
+  if ( np.ht_records && np.records )
+    records_clear ();
+
+  if ( np.ht_records )
+    hashtable_destroy ( np.ht_records );
+
+  if ( np.records )
+    vector_free ( np.records );
+
+  processes_free ( np.procs );
+  connection_free ();
+  packet_free ();
+  rate_free ();
+
+  free ( np.interfaces );
+
+  // a new netproc_init start of zero
+  memset ( &np, 0, sizeof np );
+}
@@ -0,0 +1,102 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETPROC_H
+#define NETPROC_H
+
+#include <stddef.h>  // size_t
+#include <stdint.h>
+#include <sys/types.h>  // pid_t
+
+/* libnetproc, traffic of processes to programs that embed netproc, without
+   terminal user interface (make lib, bin/libnetproc.a, link with -lpthread
+   -lrt). only the symbols netproc_* are global in library.
+   the library is a singleton of process: tables of sockets and processes of
+   netproc are global, so there is only one capture by process, opened by
+   netproc_init and closed by netproc_close, after it can be opened again.
+   the packets are only parsed and accumulated by flow, as in capture of
+   netproc. in each tick the flows are credited to owners of sockets and
+   given in one batch, a record by process.
+   not is thread safe, all functions must be called by same thread.
+
+   usage:
+     if ( netproc_init ( &( struct netproc_options ){
+                  .interfaces = "eth0", .protocols = NETPROC_TCP } ) == -1 )
+       return;
+     while ( running )
+       {
+         netproc_read ( 100 );
+         if ( second_elapsed )
+           netproc_tick ( callback, user_data );
+       }
+     netproc_close (); */
+
+// netproc_options.protocols
+#define NETPROC_TCP ( 1 << 0 )
+#define NETPROC_UDP ( 1 << 1 )
+
+struct netproc_options
+{
+  const char *interfaces;  // as "eth0,eth1", NULL is all
+  int protocols;           // NETPROC_TCP | NETPROC_UDP, 0 is both
+};
+
+// traffic of a process since last tick
+struct netproc_record
+{
+  const char *name;  // valid until next tick
+  pid_t pid;         // 0 is traffic without process found
+  uint64_t tx_bytes;
+  uint64_t rx_bytes;
+  uint64_t tx_packets;
+  uint64_t rx_packets;
+};
+
+typedef void ( *netproc_callback ) ( const struct netproc_record *records,
+                                     size_t total,
+                                     void *user_data );
+
+/* start capture, return 0 or -1 on error, also if already started (needs
+   CAP_NET_RAW and CAP_NET_ADMIN) */
+int
+netproc_init ( const struct netproc_options *op );
+
+/* wait up to 'timeout' milliseconds (-1 is forever, 0 not wait) for packets
+   in rings and read them. blocks of ring are given to kernel only here, so
+   it must be called again soon, as in a loop, or the kernel drop packets.
+   return the number of blocks read or -1 on error */
+int
+netproc_read ( int timeout );
+
+/* read the rings, credit traffic to processes and pass the records of
+   processes with traffic since last tick to 'cb', if not NULL, in one call.
+   return the number of records or -1 on error */
+int
+netproc_tick ( netproc_callback cb, void *user_data );
+
+// records of last tick, valid until next tick
+const struct netproc_record *
+netproc_records ( size_t *total );
+
+// stop capture and free all
+void
+netproc_close ( void );
+
+#endif  // NETPROC_H
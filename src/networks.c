@@ -0,0 +1,296 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdio.h>   // fopen
+#include <stdlib.h>  // calloc, qsort
+#include <string.h>  // strerror
+
+#include "networks.h"
+#include "filter.h"  // filter_parse_net
+#include "lpm.h"
+#include "hashtable.h"
+#include "intern.h"
+#include "vector.h"
+#include "m_error.h"
+
+// row of connections out of prefixes
+#define NAME_OTHER "other"
+
+struct prefix
+{
+  struct exclude_net net;
+  uint32_t row;
+};
+
+static struct lpm lpm4, lpm6;
+
+// rows by index of networks_join, 0 is "other". fixed after load
+static process_t **rows;
+static size_t total_rows;
+
+// copy of pointers of rows, view is sorted by user of it
+static struct processes view;
+
+static bool
+ht_cb_compare ( const void *key1, const void *key2 )
+{
+  return key1 == key2;
+}
+
+static hash_t
+ht_cb_hash ( const void *key )
+{
+  return intern_hash ( key );
+}
+
+static int
+cmp_prefix ( const void *p1, const void *p2 )
+{
+  const struct prefix *a = p1, *b = p2;
+
+  return ( int ) a->net.prefix - ( int ) b->net.prefix;
+}
+
+// row of name 'name' (already interned), created if new
+static uint32_t
+get_row ( hashtable_t *ht, const char *name )
+{
+  // index of row is the value in table, rows are never 0
+  uintptr_t row = ( uintptr_t ) hashtable_get ( ht, name );
+  if ( row )
+    {
+      intern_put ( name );
+      return row;
+    }
+
+  if ( total_rows > LPM_MAX_VALUE )
+    goto ERROR_NAME;
+
+  process_t *proc = calloc ( 1, sizeof *proc );
+  if ( !proc )
+    goto ERROR_NAME;
+
+  proc->name = name;
+  proc->active = true;
+
+  if ( !vector_push ( rows, &proc ) )
+    {
+      free ( proc );
+      goto ERROR_NAME;
+    }
+
+  row = total_rows++;
+  if ( !hashtable_set ( ht, name, ( void * ) row ) )
+    return 0;
+
+  return row;
+
+ERROR_NAME:
+  intern_put ( name );
+  return 0;
+}
+
+// "10.0.0.0/8 name of network", line of file
+static bool
+parse_line ( hashtable_t *ht, struct prefix *prefix, char *line )
+{
+  char net[128];
+  int start_name = 0;
+
+  if ( sscanf ( line, " %127s %n", net, &start_name ) < 1 || !start_name )
+    return false;
+
+  if ( !filter_parse_net ( &prefix->net, net ) )
+    return false;
+
+  char *name = line + start_name;
+  size_t len = strcspn ( name, "\r\n" );
+
+  // trailing spaces
+  while ( len && ( name[len - 1] == ' ' || name[len - 1] == '\t' ) )
+    len--;
+
+  if ( !len )
+    {
+      name = net;
+      len = strlen ( net );
+    }
+
+  const char *key = intern ( name, len );
+  if ( !key )
+    return false;
+
+  return ( prefix->row = get_row ( ht, key ) ) != 0;
+}
+
+bool
+networks_load ( const char *path )
+{
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    {
+      ERROR_DEBUG ( "\"%s\": %s", path, strerror ( errno ) );
+      return false;
+    }
+
+  bool ret = false;
+  struct prefix *prefixes = vector_new ( sizeof ( struct prefix ) );
+  hashtable_t *ht = hashtable_new ( ht_cb_hash, ht_cb_compare, NULL );
+  rows = vector_new ( sizeof ( process_t * ) );
+
+  if ( !prefixes || !ht || !rows || !lpm_init ( &lpm4 ) ||
+       !lpm_init ( &lpm6 ) )
+    goto EXIT;
+
+  // row 0
+  const char *other = intern ( NAME_OTHER, sizeof ( NAME_OTHER ) - 1 );
+  process_t *proc = ( other ) ? calloc ( 1, sizeof *proc ) : NULL;
+  if ( !proc )
+    goto EXIT;
+
+  proc->name = other;
+  proc->active = true;
+  if ( !vector_push ( rows, &proc ) )
+    {
+      free ( proc );
+      goto EXIT;
+    }
+
+  total_rows = 1;
+
+  char line[256];
+  unsigned int num_line = 0;
+
+  while ( fgets ( line, sizeof line, file ) )
+    {
+      char first[2];
+      struct prefix prefix;
+
+      num_line++;
+      if ( sscanf ( line, " %1s", first ) < 1 || first[0] == '#' )
+        continue;
+
+      if ( !parse_line ( ht, &prefix, line ) ||
+           !vector_push ( prefixes, &prefix ) )
+        {
+          ERROR_DEBUG ( "\"%s\": invalid network in line %u", path, num_line );
+          goto EXIT;
+        }
+    }
+
+  // a longer prefix replace the shorter only in your addresses
+  size_t total = vector_size ( prefixes );
+  qsort ( prefixes, total, sizeof ( *prefixes ), cmp_prefix );
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      struct lpm *lpm = ( prefixes[i].net.family == AF_INET ) ? &lpm4 : &lpm6;
+
+      if ( !lpm_add ( lpm,
+                      ( const uint8_t * ) &prefixes[i].net.addr,
+                      prefixes[i].net.prefix,
+                      prefixes[i].row ) )
+        goto EXIT;
+    }
+
+  view.proc = vector_new ( sizeof ( process_t * ) );
+  if ( !view.proc || !vector_push_n ( view.proc, rows, total_rows ) )
+    goto EXIT;
+
+  view.total = total_rows;
+  ret = true;
+
+EXIT:
+  fclose ( file );
+  if ( ht )
+    hashtable_destroy ( ht );
+  if ( prefixes )
+    vector_free ( prefixes );
+  if ( !ret )
+    networks_free ();
+
+  return ret;
+}
+
+uint32_t
+networks_join ( const struct tuple *tuple )
+{
+  if ( !total_rows )
+    return 0;
+
+  const uint8_t *addr = ( const uint8_t * ) &tuple->l3.remote;
+  uint32_t row = ( tuple->family == AF_INET ) ? lpm_lookup ( &lpm4, addr, 4 )
+                                              : lpm_lookup ( &lpm6, addr, 16 );
+
+  rows[row]->pid++;
+
+  return row;
+}
+
+void
+networks_leave ( uint32_t network )
+{
+  if ( total_rows )
+    rows[network]->pid--;
+}
+
+process_t *
+networks_row ( uint32_t network )
+{
+  return ( total_rows ) ? rows[network] : NULL;
+}
+
+struct processes *
+networks_view ( void )
+{
+  return &view;
+}
+
+size_t
+networks_memory ( void )
+{
+  return lpm_memory ( &lpm4 ) + lpm_memory ( &lpm6 ) +
+         total_rows * sizeof ( process_t );
+}
+
+void
+networks_free ( void )
+{
+  for ( size_t i = 0; i < total_rows; i++ )
+    {
+      intern_put ( rows[i]->name );
+      rate_net_stat_free ( &rows[i]->net_stat );
+      free ( rows[i] );
+    }
+
+  if ( rows )
+    vector_free ( rows );
+
+  if ( view.proc )
+    vector_free ( view.proc );
+
+  lpm_free ( &lpm4 );
+  lpm_free ( &lpm6 );
+  rows = NULL;
+  total_rows = 0;
+  view.proc = NULL;
+  view.total = 0;
+}
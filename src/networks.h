@@ -0,0 +1,65 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETWORKS_H
+#define NETWORKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "processes.h"
+#include "sockaddr.h"  // struct tuple
+
+/* view with a row by network of remotes (option --networks), of a file of
+   prefixes, one by line as "10.0.0.0/8 internal" or "192.0.2.0/24", without
+   name the prefix is the name. prefixes with same name are of same row (as
+   of a ASN or region of cloud), the longest prefix of remote is used.
+   each connection is classified once, when created, so traffic of a packet
+   is only added to row. connections out of prefixes are of row "other".
+   rows are process_t as of aggregate.h, pid is the total of connections */
+
+// return false on error of file or of memory
+bool
+networks_load ( const char *path );
+
+/* row of remote of 'tuple' (longest prefix), the connection is counted in
+   row until networks_leave. 0 if without networks or out of prefixes */
+uint32_t
+networks_join ( const struct tuple *tuple );
+
+void
+networks_leave ( uint32_t network );
+
+// row of networks_join, NULL without networks
+process_t *
+networks_row ( uint32_t network );
+
+// rows of all networks, to show as a view
+struct processes *
+networks_view ( void );
+
+// bytes of tables of prefixes and of rows
+size_t
+networks_memory ( void );
+
+void
+networks_free ( void );
+
+#endif  // NETWORKS_H
@@ -0,0 +1,89 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "overload.h"
+#include "macro_util.h"
+
+static enum overload_level current = OVERLOAD_NONE;
+static enum overload_level highest = OVERLOAD_SAMPLE;
+
+// refreshes without pressure in current level
+static unsigned int calm;
+
+// refreshes since last redraw of screen
+static unsigned int skipped;
+
+enum overload_level
+overload_update ( uint64_t drops, bool late, bool hold )
+{
+  if ( drops || late )
+    {
+      calm = 0;
+      if ( current < highest )
+        current++;
+    }
+  else if ( current == OVERLOAD_SAMPLE && hold )
+    calm = 0;  // sample is restored first, by caller
+  else if ( ++calm >= OVERLOAD_CALM && current != OVERLOAD_NONE )
+    {
+      calm = 0;
+      current--;
+    }
+
+  return current;
+}
+
+enum overload_level
+overload_level ( void )
+{
+  return current;
+}
+
+void
+overload_limit ( enum overload_level max )
+{
+  highest = MIN ( max, OVERLOAD_SAMPLE );
+  if ( current > highest )
+    current = highest;
+}
+
+bool
+overload_redraw ( void )
+{
+  if ( current < OVERLOAD_REDRAW || ++skipped >= OVERLOAD_REDRAW_EVERY )
+    {
+      skipped = 0;
+      return true;
+    }
+
+  return false;
+}
+
+const char *
+overload_name ( enum overload_level level )
+{
+  static const char *const names[] = { [OVERLOAD_NONE] = "",
+                                       [OVERLOAD_CONNECTIONS] = "connections",
+                                       [OVERLOAD_REDRAW] = "redraw",
+                                       [OVERLOAD_NAMES] = "names",
+                                       [OVERLOAD_SAMPLE] = "sample" };
+
+  return ( level < TOTAL_OVERLOAD_LEVELS ) ? names[level] : "";
+}
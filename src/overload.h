@@ -0,0 +1,68 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OVERLOAD_H
+#define OVERLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* degradation by load, with drops in ring or refresh late the optional
+   work is shed in stages, a level by refresh with pressure, and restored
+   a level after OVERLOAD_CALM refreshes without pressure. the levels are
+   cumulative, each one keep the shedding of levels below */
+enum overload_level
+{
+  OVERLOAD_NONE,
+  OVERLOAD_CONNECTIONS,  // traffic not accounted in connections (of '-c')
+  OVERLOAD_REDRAW,       // screen redrawn once in OVERLOAD_REDRAW_EVERY
+  OVERLOAD_NAMES,        // names not resolved, only of cache of connection
+  OVERLOAD_SAMPLE,       // capture in sample mode, doubled while drops
+  TOTAL_OVERLOAD_LEVELS
+};
+
+// refreshes without pressure until a level is restored
+#define OVERLOAD_CALM 10
+
+// refreshes between redraws of screen in level OVERLOAD_REDRAW
+#define OVERLOAD_REDRAW_EVERY 4
+
+/* update level with pressure of last refresh, 'drops' of ring and 'late'
+   (refresh took longer than interval). with 'hold' the level OVERLOAD_SAMPLE
+   is not restored, the sample is still above of user. return the level */
+enum overload_level
+overload_update ( uint64_t drops, bool late, bool hold );
+
+enum overload_level
+overload_level ( void );
+
+// highest level reached, without ring the sample is not possible
+void
+overload_limit ( enum overload_level max );
+
+// false in refreshes that the screen is not redrawn
+bool
+overload_redraw ( void );
+
+// name of level to header, "" to OVERLOAD_NONE
+const char *
+overload_name ( enum overload_level level );
+
+#endif  // OVERLOAD_H
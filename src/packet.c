@@ -21,39 +21,43 @@
 #include <arpa/inet.h>        // htons
 #include <linux/if_packet.h>  // struct tpacket3_hdr
 #include <linux/if_packet.h>  // struct sockaddr_ll
+#include <net/if_arp.h>       // ARPHRD_ETHER
+#include <linux/if_ether.h>   // ETH_P_*, ETH_HLEN
 #include <linux/ip.h>         // struct iphdr
-#include <time.h>             // time
+#include <net/if.h>           // if_indextoname, struct ifreq
+#include <sys/ioctl.h>        // SIOCGIFMTU
+#include <unistd.h>           // close
+#include <netinet/ip6.h>      // struct ip6_hdr
+#include <netinet/in.h>       // IPPROTO_TCP, IPPROTO_UDP
+#include <sys/socket.h>       // AF_INET, AF_INET6
+#include <stdlib.h>           // calloc
+#include <string.h>           // memcpy
 
 #include "packet.h"
+#include "hash.h"
+#include "rate.h"  // rate_tick
+#include "probe.h"
+#include "macro_util.h"
 
 // masks header IP
 #define IP_DF 0x4000       // dont fragment
 #define IP_MF 0x2000       // more fragments
 #define IP_OFFMASK 0x1FFF  // offset do fragmento
 
-/* máximo de pacotes IP que podem estar fragmentados simultaneamente,
- os pacotes que chegarem alem desse limite não serão calculados
- e um log sera enviado na saida de erro padrão.
- reference cisco default value: 16 */
-#define MAX_REASSEMBLIES 32
-
-/* maximo de fragmentos que um pacote IP pode ter,
-acima disso um erro sera emitido, e os demais fragmentos desse pacote
-não serão computados e um log sera enviado na saida de erro padrão
-reference cisco default value: 32 */
-// #define MAX_FRAGMENTS 64
+#define VLAN_HLEN 4  // size of a tag of vlan in frame
 
 /* tempo de vida maximo de um pacote fragmentado em segundos,
 caso não chegue todos os fragmentos do pacote nesse periodo,
 o fragmento é descartado, cada pacote possui um contador unico
-reference cisco default value: 3 seconds*/
+reference cisco default value: 3 seconds.
+also is the number of slots of timer wheel, one slot by second */
 #define LIFETIME_FRAG 3
 
 // codigo de erro para buffer de fragmentos cheio ou fragmento não encontrado
 #define ERR_FRAGMENT -2
 
-// decrementa o total de pacotes fragmentados
-#define DEC_REASSEMBLE( var ) ( ( var ) -= ( ( var ) != 0 ) )
+// end of list (hash chain, free list or slot of wheel)
+#define FRAG_NIL -1
 
 /* Aproveitamos do fato dos cabeçalhos TCP e UDP
 receberem as portas de origem e destino na mesma ordem,
@@ -68,250 +72,553 @@ struct layer_4
 };
 
 /* utilzado para identificar a camada de transporte (TCP, UDP)
-dos fragmentos de um pacote e tambem ter controle de tempo de vida
-do pacote e numero de fragmentos do pacote */
+dos fragmentos de um pacote, the entry is in a chain of hash
+(key saddr, daddr, id and protocol) and in a slot of timer wheel */
 struct pkt_ip_fragment
 {
-  time_t ttl;  // lifetime of packet
   uint32_t saddr;
   uint32_t daddr;
   uint16_t id;           // IP header ID value
   uint16_t source_port;  // transport header source port
   uint16_t dest_port;    // transport header dest port
+  uint8_t protocol;
+  uint8_t slot;          // slot of wheel
+  int32_t next;          // next in chain of hash or in free list
+  int32_t wheel_prev;
+  int32_t wheel_next;
 };
 
-// armazena os dados da camada de transporte dos pacotes fragmentados
-static struct pkt_ip_fragment pkt_ip_frag[MAX_REASSEMBLIES] = { 0 };
+struct fragments
+{
+  struct pkt_ip_fragment *entries;
+  int32_t *buckets;  // first entry of each chain
+  int32_t wheel[LIFETIME_FRAG];
+  int32_t free;      // first entry free
+  uint32_t mask;     // total buckets - 1
+  uint32_t used;
+  uint32_t now;      // time of wheel, seconds of capture
+};
 
-// contador de pacotes IP que estão fragmentados
-static uint8_t count_reassemblies = 0;
+/* armazena os dados da camada de transporte dos pacotes fragmentados,
+   each capture thread has own table of fragments, a same fragmented packet
+   always is delivered to same thread (fanout hash with defrag) */
+static _Thread_local struct fragments frags = { 0 };
 
-/* store fragment if has slot available
-return index in array of fragments or -1 if not slot free */
-static inline int
-store_fragment ( const struct iphdr *l3, const struct layer_4 *l4 )
+// MTU of interfaces, by thread, direct mapped by ifindex, power-of-two
+#define MTU_CACHE 16
+
+// MTU of interface is read again after this seconds of capture
+#define MTU_LIFETIME 60
+
+// to interface not found, as of packets of file (see pcap_file.c)
+#define MTU_DEFAULT 1500
+
+// packets up to minimum MTU of IPv4 are not of GRO/GSO, not need MTU
+#define MTU_MIN 576
+
+struct mtu_entry
 {
-  if ( count_reassemblies == MAX_REASSEMBLIES )
-    return -1;
+  int if_index;
+  uint32_t mtu;  // 0 is free
+};
+
+static _Thread_local struct mtu_entry mtus[MTU_CACHE];
 
-  count_reassemblies++;
+bool
+packet_init ( unsigned int capacity )
+{
+  uint32_t total_buckets = 1;
+  while ( total_buckets < capacity )
+    total_buckets <<= 1;
 
-  // busca posição livre para adicionar dados do pacote fragmentado
-  for ( int i = 0; i < MAX_REASSEMBLIES; i++ )
+  frags.entries = calloc ( capacity, sizeof ( *frags.entries ) );
+  frags.buckets = malloc ( total_buckets * sizeof ( *frags.buckets ) );
+  if ( !frags.entries || !frags.buckets )
     {
-      if ( pkt_ip_frag[i].ttl == 0 )  // posição livre no array
-        {
-          pkt_ip_frag[i].saddr = l3->saddr;
-          pkt_ip_frag[i].daddr = l3->daddr;
-          pkt_ip_frag[i].id = l3->id;
-          pkt_ip_frag[i].source_port = l4->source;
-          pkt_ip_frag[i].dest_port = l4->dest;
-          pkt_ip_frag[i].ttl = time ( NULL );
-
-          return i;
-        }
+      packet_free ();
+      return false;
     }
 
-  return -1;
+  for ( uint32_t i = 0; i < total_buckets; i++ )
+    frags.buckets[i] = FRAG_NIL;
+
+  for ( int i = 0; i < LIFETIME_FRAG; i++ )
+    frags.wheel[i] = FRAG_NIL;
+
+  // all entries in free list
+  for ( uint32_t i = 0; i < capacity; i++ )
+    frags.entries[i].next = ( i + 1 < capacity ) ? ( int32_t ) i + 1 : FRAG_NIL;
+
+  frags.free = ( capacity ) ? 0 : FRAG_NIL;
+  frags.mask = total_buckets - 1;
+  frags.used = 0;
+  frags.now = 0;
+
+  return true;
+}
+
+void
+packet_free ( void )
+{
+  free ( frags.entries );
+  free ( frags.buckets );
+  frags = ( struct fragments ){ 0 };
+}
+
+static inline uint32_t
+fragment_bucket ( uint32_t saddr, uint32_t daddr, uint16_t id, uint8_t proto )
+{
+  const uint64_t key[] = { ( ( uint64_t ) saddr << 32 ) | daddr,
+                           ( uint64_t ) id << 8 | proto };
+
+  return hash_words ( key, ARRAY_SIZE ( key ) ) & frags.mask;
+}
+
+static void
+wheel_unlink ( int32_t idx )
+{
+  struct pkt_ip_fragment *frag = &frags.entries[idx];
+
+  if ( frag->wheel_prev != FRAG_NIL )
+    frags.entries[frag->wheel_prev].wheel_next = frag->wheel_next;
+  else
+    frags.wheel[frag->slot] = frag->wheel_next;
+
+  if ( frag->wheel_next != FRAG_NIL )
+    frags.entries[frag->wheel_next].wheel_prev = frag->wheel_prev;
+}
+
+// remove of chain of hash and of wheel, back to free list
+static void
+remove_fragment ( int32_t idx )
+{
+  struct pkt_ip_fragment *frag = &frags.entries[idx];
+  int32_t *link = &frags.buckets[fragment_bucket (
+          frag->saddr, frag->daddr, frag->id, frag->protocol )];
+
+  while ( *link != idx )
+    link = &frags.entries[*link].next;
+
+  *link = frag->next;
+
+  wheel_unlink ( idx );
+
+  frag->next = frags.free;
+  frags.free = idx;
+  frags.used--;
+}
+
+/* store fragment if has entry available
+return index of entry or -1 if table is full */
+static inline int
+store_fragment ( const struct iphdr *l3, const struct layer_4 *l4 )
+{
+  int32_t idx = frags.free;
+  if ( idx == FRAG_NIL )
+    return -1;
+
+  struct pkt_ip_fragment *frag = &frags.entries[idx];
+  frags.free = frag->next;
+  frags.used++;
+
+  frag->saddr = l3->saddr;
+  frag->daddr = l3->daddr;
+  frag->id = l3->id;
+  frag->protocol = l3->protocol;
+  frag->source_port = l4->source;
+  frag->dest_port = l4->dest;
+
+  uint32_t bucket =
+          fragment_bucket ( l3->saddr, l3->daddr, l3->id, l3->protocol );
+  frag->next = frags.buckets[bucket];
+  frags.buckets[bucket] = idx;
+
+  // expired when wheel back to this slot
+  frag->slot = frags.now % LIFETIME_FRAG;
+  frag->wheel_prev = FRAG_NIL;
+  frag->wheel_next = frags.wheel[frag->slot];
+  if ( frag->wheel_next != FRAG_NIL )
+    frags.entries[frag->wheel_next].wheel_prev = idx;
+  frags.wheel[frag->slot] = idx;
+
+  return idx;
 }
 
-// return index in array of fragments or -1 if not found
+// return index of entry or -1 if not found
 static inline int
 search_fragment ( const struct iphdr *l3 )
 {
-  // percorre todo array de pacotes fragmentados...
-  for ( int i = 0; i < MAX_REASSEMBLIES; i++ )
+  if ( !frags.used )
+    return -1;
+
+  int32_t idx = frags.buckets[fragment_bucket (
+          l3->saddr, l3->daddr, l3->id, l3->protocol )];
+
+  while ( idx != FRAG_NIL )
     {
-      if ( !pkt_ip_frag[i].ttl || l3->id != pkt_ip_frag[i].id ||
-           l3->saddr != pkt_ip_frag[i].saddr ||
-           l3->daddr != pkt_ip_frag[i].daddr )
-        continue;
-
-      // se for o  ultimo fragmento
-      // libera a posição do array de fragmentos
-      if ( ( ntohs ( l3->frag_off ) & IP_MF ) == 0 )
-        {
-          pkt_ip_frag[i].ttl = 0;
-          DEC_REASSEMBLE ( count_reassemblies );
-        }
-
-      return i;
+      const struct pkt_ip_fragment *frag = &frags.entries[idx];
+
+      if ( l3->id == frag->id && l3->saddr == frag->saddr &&
+           l3->daddr == frag->daddr && l3->protocol == frag->protocol )
+        return idx;
+
+      idx = frag->next;
     }
 
   return -1;
 }
 
-/* verifica se é um fragmento,
+/* verifica se é um fragmento, se for as portas da camada de transporte
+sao copiadas para source e dest.
 retorna
-  o id do array de fragmentos se for um fragmento
-  -1 se não for um fragmento
-  ERR_FRAGMENT se for um fragmento mas não esta no buffer */
+  1 se for um fragmento
+  0 se não for um fragmento
+  ERR_FRAGMENT se for um fragmento mas não esta na tabela ou tabela cheia */
 static int
-get_fragment ( const struct iphdr *l3, const struct layer_4 *l4 )
+get_fragment ( const struct iphdr *l3,
+               const struct layer_4 *l4,
+               uint16_t *source,
+               uint16_t *dest )
 {
   uint16_t frag_off = ntohs ( l3->frag_off );
 
   // bit não fragmente ligado, logo não pode ser um fragmento
   if ( frag_off & IP_DF )
-    return -1;
+    return 0;
 
-  int ret = -1;
+  int idx;
   // bit MF ligado e offset igual a 0,
   // it's first fragment
   if ( ( frag_off & IP_MF ) && ( frag_off & IP_OFFMASK ) == 0 )
     {
-      ret = store_fragment ( l3, l4 );
-      if ( ret == -1 )
+      idx = store_fragment ( l3, l4 );
+      if ( idx == -1 )
         return ERR_FRAGMENT;
     }
   else if ( frag_off & IP_OFFMASK )
     {
-      ret = search_fragment ( l3 );
-      if ( ret == -1 )
+      idx = search_fragment ( l3 );
+      if ( idx == -1 )
         return ERR_FRAGMENT;
     }
+  else
+    return 0;
 
-  // it's not first fragment
-  return ret;
+  *source = frags.entries[idx].source_port;
+  *dest = frags.entries[idx].dest_port;
+
+  // se for o ultimo fragmento libera a entrada
+  if ( !( frag_off & IP_MF ) )
+    remove_fragment ( idx );
+
+  return 1;
 }
 
-// remove fragments with expired lifetime
-static void
-clear_frag ( void )
+void
+packet_tick ( uint32_t now )
 {
-  time_t now = time ( NULL );
+  // first tick or time of capture back (clock changed)
+  if ( !frags.now || now < frags.now )
+    {
+      frags.now = now;
+      return;
+    }
+
+  // MTU of interfaces can change
+  if ( now / MTU_LIFETIME != frags.now / MTU_LIFETIME )
+    memset ( mtus, 0, sizeof ( mtus ) );
 
-  for ( size_t i = 0; count_reassemblies && i < MAX_REASSEMBLIES; i++ )
+  // each slot expire the fragments stored LIFETIME_FRAG seconds ago,
+  // after a full turn all slots are already clean
+  for ( unsigned int turn = 0; frags.now < now && turn < LIFETIME_FRAG;
+        turn++ )
     {
-      if ( !pkt_ip_frag[i].ttl )
-        continue;
-
-      if ( ( now - pkt_ip_frag[i].ttl ) >= LIFETIME_FRAG )
-        {
-          pkt_ip_frag[i].ttl = 0;
-          DEC_REASSEMBLE ( count_reassemblies );
-        }
+      frags.now++;
+
+      int32_t *slot = &frags.wheel[frags.now % LIFETIME_FRAG];
+      while ( *slot != FRAG_NIL )
+        remove_fragment ( *slot );
     }
+
+  frags.now = now;
 }
 
-static void
+/* fill 'pkt' with data of packet, local and remote are defined by direction
+   of packet. return 1 on sucess or 0 if packet is not to/from this host */
+static inline int
 insert_data_packet ( struct packet *pkt,
-                     const uint32_t if_index,
-                     const uint8_t direction,
+                     const struct sockaddr_ll *ll,
                      const uint8_t protocol,
-                     const uint32_t local_address,
-                     const uint32_t remote_address,
-                     const uint16_t local_port,
-                     const uint16_t remote_port,
+                     const uint8_t family,
+                     const void *saddr,
+                     const void *daddr,
+                     const size_t len_addr,
+                     const uint16_t source,
+                     const uint16_t dest,
                      const uint32_t len )
 {
-  pkt->if_index = if_index;
-  pkt->direction = direction;
-  pkt->tuple.l3.local.ip = local_address;
-  pkt->tuple.l3.remote.ip = remote_address;
+  switch ( ll->sll_pkttype )
+    {
+      case PACKET_OUTGOING:  // upload
+        pkt->direction = PKT_UPL;
+        memcpy ( &pkt->tuple.l3.local, saddr, len_addr );
+        memcpy ( &pkt->tuple.l3.remote, daddr, len_addr );
+        pkt->tuple.l4.local_port = ntohs ( source );
+        pkt->tuple.l4.remote_port = ntohs ( dest );
+        break;
+      case PACKET_HOST:  // download
+        pkt->direction = PKT_DOWN;
+        memcpy ( &pkt->tuple.l3.local, daddr, len_addr );
+        memcpy ( &pkt->tuple.l3.remote, saddr, len_addr );
+        pkt->tuple.l4.local_port = ntohs ( dest );
+        pkt->tuple.l4.remote_port = ntohs ( source );
+        break;
+      default:
+        return 0;  // fail parse
+    }
+
+  pkt->if_index = ll->sll_ifindex;
   pkt->tuple.l4.protocol = protocol;
-  pkt->tuple.l4.local_port = ntohs ( local_port );
-  pkt->tuple.l4.remote_port = ntohs ( remote_port );
+  pkt->tuple.family = family;
   pkt->lenght = len;
+  pkt->segments = 1;
+
+  return 1;
 }
 
-/* parse ppd in layers 3 and 4, store in 'struct packet',
-return 1 on sucess or 0 */
-int
-parse_packet ( struct packet *pkt, struct tpacket3_hdr *ppd )
+static uint32_t
+iface_mtu ( int if_index )
 {
-  struct sockaddr_ll *ll;
-  // struct ethhdr *l2;
-  struct iphdr *l3;
-  struct layer_4 *l4;
+  struct mtu_entry *entry = &mtus[( unsigned int ) if_index % MTU_CACHE];
+
+  if ( entry->mtu && entry->if_index == if_index )
+    return entry->mtu;
+
+  struct ifreq ifr = { 0 };
+  int sock = socket ( AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0 );
+
+  entry->if_index = if_index;
+  entry->mtu = MTU_DEFAULT;
+
+  if ( sock != -1 && if_indextoname ( if_index, ifr.ifr_name ) &&
+       ioctl ( sock, SIOCGIFMTU, &ifr ) != -1 && ifr.ifr_mtu > 0 )
+    entry->mtu = ifr.ifr_mtu;
+
+  if ( sock != -1 )
+    close ( sock );
+
+  return entry->mtu;
+}
+
+/* split a frame larger than MTU in segments of payload of MTU, as in wire.
+   'l3' is the header IP of 'l3_hdr' bytes, 'l3_len' bytes of IP packet
+   and 'l2_len' of header of frame. the header of transport is in snap of
+   frame, in mode header-only also. fragments are never larger than MTU */
+static void
+set_segments ( struct packet *pkt,
+               const uint8_t *l3,
+               uint32_t l3_hdr,
+               uint32_t l3_len,
+               uint32_t l2_len )
+{
+  if ( l3_len <= MTU_MIN )
+    return;
+
+  uint32_t mtu = iface_mtu ( pkt->if_index );
+  if ( l3_len <= mtu )
+    return;
+
+  // data offset of tcp, in 32 bits words
+  uint32_t hdr = l3_hdr + ( ( pkt->tuple.l4.protocol == IPPROTO_TCP )
+                                    ? ( l3[l3_hdr + 12] >> 4 ) * 4
+                                    : 8 );
+  if ( hdr >= mtu || hdr >= l3_len )
+    return;
+
+  uint32_t mss = mtu - hdr;
+  uint32_t segments = ( l3_len - hdr + mss - 1 ) / mss;
+
+  pkt->segments = MIN ( segments, UINT16_MAX );
+  pkt->lenght += ( pkt->segments - 1 ) * ( l2_len + hdr );
+}
+
+static int
+parse_ipv4 ( struct packet *pkt,
+             const struct sockaddr_ll *ll,
+             const struct iphdr *l3,
+             const uint32_t len )
+{
+  const struct layer_4 *l4;
+
+  l4 = ( const struct layer_4 * ) ( ( const uint8_t * ) l3 + ( l3->ihl * 4 ) );
+
+  // não é um fragmento, assume que isso é maioria dos casos
+  uint16_t source = l4->source;
+  uint16_t dest = l4->dest;
+
+  // é um fragmento, pega dados da camada de transporte
+  // na tabela de pacotes fragmentados
+  if ( get_fragment ( l3, l4, &source, &dest ) == ERR_FRAGMENT )
+    return 0;
+
+  return insert_data_packet ( pkt,
+                              ll,
+                              l3->protocol,
+                              AF_INET,
+                              &l3->saddr,
+                              &l3->daddr,
+                              sizeof ( l3->saddr ),
+                              source,
+                              dest,
+                              len );
+}
+
+/* extension headers are not followed, the filter (filter.c) pass only
+   packets ipv6 with tcp or udp as next header */
+static int
+parse_ipv6 ( struct packet *pkt,
+             const struct sockaddr_ll *ll,
+             const struct ip6_hdr *l3,
+             const uint32_t len )
+{
+  const uint8_t protocol = l3->ip6_nxt;
+
+  if ( protocol != IPPROTO_TCP && protocol != IPPROTO_UDP )
+    return 0;
+
+  const struct layer_4 *l4 = ( const struct layer_4 * ) ( l3 + 1 );
+
+  return insert_data_packet ( pkt,
+                              ll,
+                              protocol,
+                              AF_INET6,
+                              &l3->ip6_src,
+                              &l3->ip6_dst,
+                              sizeof ( l3->ip6_src ),
+                              l4->source,
+                              l4->dest,
+                              len );
+}
+
+/* parse layers 3 and 4 of frame, 'l3' is the header ip after 'l2_len' bytes
+   of header of link. return 1 on sucess or 0.
+   lenght of packet is ppd->tp_len (lenght in wire), ppd->tp_snaplen is only
+   the bytes copied to ring, that is less in header-only mode */
+static inline int
+parse_l3 ( struct packet *pkt,
+           struct tpacket3_hdr *ppd,
+           const uint8_t *l3,
+           uint32_t l2_len )
+{
+  const struct sockaddr_ll *ll;
 
   ll = ( struct sockaddr_ll * ) ( ( uint8_t * ) ppd + TPACKET3_HDRLEN -
                                   sizeof ( struct sockaddr_ll ) );
-  // l2 = ( struct ethhdr * ) ( ( uint8_t * ) ppd + ppd->tp_mac );
-  l3 = ( struct iphdr * ) ( ( uint8_t * ) ppd + ppd->tp_net );
-  l4 = ( struct layer_4 * ) ( ( uint8_t * ) ppd + ppd->tp_net +
-                              ( l3->ihl * 4 ) );
-
-  // ERROR_DEBUG( "ll->sll_pkttype - %d\n", ll->sll_pkttype );
-  // ERROR_DEBUG( "ll->sll_hatype - %d\n", ll->sll_hatype );
-  // ERROR_DEBUG( "l2->h_proto - %x\n", ntohs(l2->h_proto) );
-  // ERROR_DEBUG( "l3->proto - %d\n", l3->protocol  );
-  // ERROR_DEBUG( "l4->dest - %x\n", ntohs(l4->dest) );
-
-  int ret = 1;
-  int id_frag = get_fragment ( l3, l4 );
-  if ( id_frag == ERR_FRAGMENT )
-    {
-      ret = 0;
-      goto END;
-    }
 
-  switch ( ll->sll_pkttype )
+  // time of capture by kernel, packets read late of ring keep your tick
+  pkt->tstamp = rate_tick ( ppd->tp_sec, ppd->tp_nsec );
+
+  // version is in the same position in both headers, so the header is
+  // parsed only once by the function of your version
+  int ret;
+  switch ( *l3 >> 4 )
     {
-      case PACKET_OUTGOING:  // upload
-        if ( id_frag == -1 )
-          {
-            // não é um fragmento, assume que isso é maioria dos casos
-            insert_data_packet ( pkt,
-                                 ll->sll_ifindex,
-                                 PKT_UPL,
-                                 l3->protocol,
-                                 l3->saddr,
-                                 l3->daddr,
-                                 l4->source,
-                                 l4->dest,
-                                 ppd->tp_snaplen );
-          }
-        else
-          {
-            // é um fragmento, pega dados da camada de transporte
-            // no array de pacotes fragmentados
-            insert_data_packet ( pkt,
-                                 ll->sll_ifindex,
-                                 PKT_UPL,
-                                 l3->protocol,
-                                 l3->saddr,
-                                 l3->daddr,
-                                 pkt_ip_frag[id_frag].source_port,
-                                 pkt_ip_frag[id_frag].dest_port,
-                                 ppd->tp_snaplen );
-          }
+      case 4:
+        ret = parse_ipv4 ( pkt, ll, ( const struct iphdr * ) l3, ppd->tp_len );
         break;
-      case PACKET_HOST:  // download
-        if ( id_frag == -1 )
-          {
-            // não é um fragmento, assumi que isso é maioria dos casos
-            insert_data_packet ( pkt,
-                                 ll->sll_ifindex,
-                                 PKT_DOWN,
-                                 l3->protocol,
-                                 l3->daddr,
-                                 l3->saddr,
-                                 l4->dest,
-                                 l4->source,
-                                 ppd->tp_snaplen );
-          }
-        else
-          {
-            // é um fragmento, pega dados da camada de transporte
-            // no array de pacotes fragmentados
-            insert_data_packet ( pkt,
-                                 ll->sll_ifindex,
-                                 PKT_DOWN,
-                                 l3->protocol,
-                                 l3->daddr,
-                                 l3->saddr,
-                                 pkt_ip_frag[id_frag].dest_port,
-                                 pkt_ip_frag[id_frag].source_port,
-                                 ppd->tp_snaplen );
-          }
+      case 6:
+        ret = parse_ipv6 (
+                pkt, ll, ( const struct ip6_hdr * ) l3, ppd->tp_len );
         break;
       default:
-        ret = 0;  // fail parse
+        ret = 0;
+    }
+
+  if ( !ret )
+    {
+      PROBE1 ( parse_failure, *l3 >> 4 );
+      return ret;
     }
 
-END:
-  clear_frag ();
+  if ( ppd->tp_len <= l2_len )
+    return ret;
+
+  uint32_t l3_hdr = ( pkt->tuple.family == AF_INET )
+                            ? ( ( const struct iphdr * ) l3 )->ihl * 4
+                            : sizeof ( struct ip6_hdr );
+
+  set_segments ( pkt, l3, l3_hdr, ppd->tp_len - l2_len, l2_len );
 
   return ret;
 }
+
+static inline bool
+is_vlan ( uint16_t type )
+{
+  return type == ETH_P_8021Q || type == ETH_P_8021AD;
+}
+
+int
+parse_packet_ether ( struct packet *pkt, struct tpacket3_hdr *ppd )
+{
+  const uint8_t *l2 = ( uint8_t * ) ppd + ppd->tp_mac;
+  uint32_t l2_len = ETH_HLEN;
+  uint16_t type = l2[12] << 8 | l2[13];
+
+  // tags not removed by device are in frame, ethertype is after them
+  for ( unsigned int i = 0; i < MAX_VLAN_TAGS && is_vlan ( type ); i++ )
+    {
+      type = l2[l2_len + 2] << 8 | l2[l2_len + 3];
+      l2_len += VLAN_HLEN;
+    }
+
+  if ( type != ETH_P_IP && type != ETH_P_IPV6 )
+    {
+      PROBE1 ( parse_failure, 0 );
+      return 0;
+    }
+
+  return parse_l3 ( pkt, ppd, l2 + l2_len, l2_len );
+}
+
+int
+parse_packet_raw ( struct packet *pkt, struct tpacket3_hdr *ppd )
+{
+  return parse_l3 ( pkt, ppd, ( uint8_t * ) ppd + ppd->tp_net, 0 );
+}
+
+/* parse ppd in layers 3 and 4, store in 'struct packet',
+return 1 on sucess or 0.
+the kernel set tp_net after the header of link, with exception of frames with
+tags of vlan in frame, where tp_net is in tag */
+int
+parse_packet ( struct packet *pkt, struct tpacket3_hdr *ppd )
+{
+  const struct sockaddr_ll *ll;
+
+  ll = ( struct sockaddr_ll * ) ( ( uint8_t * ) ppd + TPACKET3_HDRLEN -
+                                  sizeof ( struct sockaddr_ll ) );
+
+  if ( ll->sll_hatype == ARPHRD_ETHER &&
+       is_vlan ( ntohs ( ll->sll_protocol ) ) )
+    return parse_packet_ether ( pkt, ppd );
+
+  return parse_l3 ( pkt,
+                    ppd,
+                    ( uint8_t * ) ppd + ppd->tp_net,
+                    ppd->tp_net - ppd->tp_mac );
+}
+
+parse_func
+packet_parser ( enum link_type link )
+{
+  switch ( link )
+    {
+      case LINK_ETHER:
+        return parse_packet_ether;
+      case LINK_RAW:
+        return parse_packet_raw;
+      default:
+        return parse_packet;
+    }
+}
@@ -22,26 +22,66 @@
 #define NETWORK_H
 
 #include <stdint.h>           // types uint*_t
+#include <stdbool.h>
 #include <sys/socket.h>       // setsockopt
 #include <linux/if_packet.h>  // struct tpacket3_hdr
 
 #include "sockaddr.h"
+#include "sock.h"  // enum link_type
 
 // used for function parse_packet e statistics
 struct packet
 {
   struct tuple tuple;  // source and dest ip/port
-  uint32_t lenght;     // lenght of packet
+  uint32_t lenght;     // lenght of packet, of all segments
+  uint32_t tstamp;     // tick of capture (see rate_tick)
   int if_index;        // interface index
   uint8_t direction;   // tx or rx
+  uint16_t segments;   // packets in wire, above 1 in GRO/GSO, by estimate
 };
 
 // packet.direction
 #define PKT_DOWN 1
 #define PKT_UPL 2
 
-// preenche a struct packet com os dados do pacote recebido
+// default of max of IP packets fragmented simultaneously by thread
+#define FRAGMENTS_DEFAULT 256
+
+/* table of fragments is by thread, so each thread that parse packets must
+   call packet_init before and packet_free at end. capacity is the max of IP
+   packets fragmented simultaneously, fragments beyond it are not computed */
+bool
+packet_init ( unsigned int capacity );
+
+void
+packet_free ( void );
+
+/* advance the timer wheel of fragments to 'now', time of capture in seconds
+   (timestamp of block of ring), fragments older than lifetime are removed */
+void
+packet_tick ( uint32_t now );
+
+/* preenche a struct packet com os dados do pacote recebido.
+   frames larger than MTU of interface (merged by GRO or not yet segmented by
+   GSO) are counted as the segments of MTU sent in wire, each one with
+   headers of frame */
 int
 parse_packet ( struct packet *pkt, struct tpacket3_hdr *ppd );
 
+/* as parse_packet, to frames of ethernet, the layer 3 is after the
+   ethertype and of up to MAX_VLAN_TAGS tags of vlan */
+int
+parse_packet_ether ( struct packet *pkt, struct tpacket3_hdr *ppd );
+
+// as parse_packet, to frames started by the header ip (tun and cooked)
+int
+parse_packet_raw ( struct packet *pkt, struct tpacket3_hdr *ppd );
+
+typedef int ( *parse_func ) ( struct packet *pkt, struct tpacket3_hdr *ppd );
+
+/* parser of frames of link, chosen once on bind of socket, parse_packet
+   to LINK_ANY, where each frame can be of a link */
+parse_func
+packet_parser ( enum link_type link );
+
 #endif  // NETWORK_H
@@ -0,0 +1,648 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// references
+// https://wiki.wireshark.org/Development/LibpcapFileFormat
+// https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-02.html
+// https://www.tcpdump.org/linktypes.html
+
+#include <fcntl.h>     // open
+#include <stdalign.h>  // alignas
+#include <stdint.h>
+#include <stdlib.h>    // calloc
+#include <string.h>    // memcpy, memset
+#include <time.h>      // clock_gettime
+#include <unistd.h>    // close
+#include <ifaddrs.h>   // getifaddrs
+#include <netinet/in.h>        // IPPROTO_TCP, IPPROTO_UDP
+#include <linux/if_ether.h>    // ETH_P_IP, ETH_P_IPV6
+#include <linux/if_packet.h>   // struct tpacket3_hdr, struct sockaddr_ll
+#include <sys/mman.h>          // mmap
+#include <sys/stat.h>          // fstat
+
+#include "pcap_file.h"
+#include "packet.h"
+#include "statistics.h"
+#include "profile.h"
+#include "m_error.h"
+#include "macro_util.h"
+
+// magic of pcap, timestamps in microseconds or in nanoseconds
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+#define PCAP_HEADER 24
+#define PCAP_RECORD 16
+
+// blocks of pcapng
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 1
+#define PCAPNG_EPB 6
+#define PCAPNG_BYTE_ORDER 0x1a2b3c4d
+#define PCAPNG_OPT_TSRESOL 9
+
+// link types
+#define LINK_ETHERNET 1
+#define LINK_RAW_BSD 12
+#define LINK_RAW 101
+#define LINK_SLL 113
+#define LINK_IPV4 228
+#define LINK_IPV6 229
+#define LINK_SLL2 276
+
+// interfaces in a section of pcapng
+#define MAX_INTERFACES 64
+
+// addresses of interfaces of host, to direction of packets
+#define MAX_LOCALS 64
+
+// direction of packet unknown, by addresses
+#define PKTTYPE_UNKNOWN 0xff
+
+// bytes of packet copied to frame, enough to headers ip and ports
+#define FRAME_SNAP 256
+#define FRAME_NET TPACKET_ALIGN ( TPACKET3_HDRLEN )
+
+#define NSEC_PER_SEC 1000000000ULL
+
+struct interface
+{
+  uint32_t link;
+  uint8_t resol;  // timestamp in units of 10^-resol (or 2^-resol)
+  bool pow2;
+};
+
+// a packet of file
+struct raw_packet
+{
+  const uint8_t *data;
+  uint64_t ts;  // nanoseconds
+  uint32_t caplen;
+  uint32_t len;
+  uint32_t link;
+};
+
+struct pcap_file
+{
+  const uint8_t *data;
+  size_t size;
+  size_t off;
+
+  struct interface ifaces[MAX_INTERFACES];
+  unsigned int total_ifaces;
+  uint32_t link;  // of pcap, pcapng has by interface
+  bool nanosecond;
+  bool ng;
+  bool swap;  // byte order of file is not of host
+
+  union inet_all locals[MAX_LOCALS];
+  uint8_t locals_family[MAX_LOCALS];
+  unsigned int total_locals;
+
+  struct raw_packet next;  // read of file but still not time
+  bool pending;
+  bool eof;
+  bool fast;
+  int proto;
+
+  uint64_t first;  // time of capture of first packet
+  uint64_t start;  // time that the first packet was read
+  uint64_t packets;
+
+  alignas ( TPACKET_ALIGNMENT ) uint8_t frame[FRAME_NET + FRAME_SNAP];
+};
+
+static inline uint16_t
+rd16 ( const struct pcap_file *pf, const uint8_t *p )
+{
+  uint16_t v;
+  memcpy ( &v, p, sizeof v );
+  return ( pf->swap ) ? __builtin_bswap16 ( v ) : v;
+}
+
+static inline uint32_t
+rd32 ( const struct pcap_file *pf, const uint8_t *p )
+{
+  uint32_t v;
+  memcpy ( &v, p, sizeof v );
+  return ( pf->swap ) ? __builtin_bswap32 ( v ) : v;
+}
+
+// fields of headers of link, always big endian
+static inline uint16_t
+be16 ( const uint8_t *p )
+{
+  return ( uint16_t ) ( p[0] << 8 | p[1] );
+}
+
+static inline uint32_t
+be32 ( const uint8_t *p )
+{
+  return ( uint32_t ) p[0] << 24 | ( uint32_t ) p[1] << 16 |
+         ( uint32_t ) p[2] << 8 | p[3];
+}
+
+static uint64_t
+ts_nsec ( uint64_t ts, const struct interface *iface )
+{
+  static const uint64_t pow10[] = { 1,
+                                    10,
+                                    100,
+                                    1000,
+                                    10000,
+                                    100000,
+                                    1000000,
+                                    10000000,
+                                    100000000,
+                                    1000000000 };
+
+  if ( iface->pow2 )
+    {
+      if ( iface->resol > 32 )
+        return 0;
+
+      uint64_t mask = ( 1ULL << iface->resol ) - 1;
+      return ( ts >> iface->resol ) * NSEC_PER_SEC +
+             ( ( ts & mask ) * NSEC_PER_SEC >> iface->resol );
+    }
+
+  if ( iface->resol <= 9 )
+    return ts * pow10[9 - iface->resol];
+
+  if ( iface->resol <= 18 )
+    return ts / pow10[iface->resol - 9];
+
+  return 0;
+}
+
+static void
+read_idb ( struct pcap_file *pf, const uint8_t *body, size_t len )
+{
+  if ( len < 8 || pf->total_ifaces == MAX_INTERFACES )
+    return;
+
+  struct interface *iface = &pf->ifaces[pf->total_ifaces++];
+
+  // default is microseconds
+  *iface = ( struct interface ){ .link = rd16 ( pf, body ), .resol = 6 };
+
+  // options, code, length and value padded to 32 bits
+  for ( size_t off = 8; off + 4 <= len; )
+    {
+      uint16_t code = rd16 ( pf, body + off );
+      uint16_t optlen = rd16 ( pf, body + off + 2 );
+
+      if ( !code || off + 4 + optlen > len )
+        break;
+
+      if ( code == PCAPNG_OPT_TSRESOL && optlen >= 1 )
+        {
+          iface->pow2 = body[off + 4] & 0x80;
+          iface->resol = body[off + 4] & 0x7f;
+        }
+
+      off += 4 + ( ( optlen + 3u ) & ~3u );
+    }
+}
+
+static bool
+next_pcapng ( struct pcap_file *pf, struct raw_packet *pkt )
+{
+  while ( pf->off + 12 <= pf->size )
+    {
+      const uint8_t *block = pf->data + pf->off;
+
+      // type of section header is same in both byte orders
+      uint32_t type = rd32 ( pf, block );
+      if ( type == PCAPNG_SHB )
+        {
+          uint32_t bom;
+          memcpy ( &bom, block + 8, sizeof bom );
+
+          if ( bom == PCAPNG_BYTE_ORDER )
+            pf->swap = false;
+          else if ( bom == __builtin_bswap32 ( PCAPNG_BYTE_ORDER ) )
+            pf->swap = true;
+          else
+            return false;
+
+          // interfaces are by section
+          pf->total_ifaces = 0;
+        }
+
+      uint32_t len = rd32 ( pf, block + 4 );
+      if ( len < 12 || len % 4 || len > pf->size - pf->off )
+        return false;
+
+      pf->off += len;
+
+      const uint8_t *body = block + 8;
+      size_t body_len = len - 12;
+
+      if ( type == PCAPNG_IDB )
+        read_idb ( pf, body, body_len );
+
+      if ( type != PCAPNG_EPB || body_len < 20 )
+        continue;
+
+      uint32_t id = rd32 ( pf, body );
+      uint32_t caplen = rd32 ( pf, body + 12 );
+      if ( id >= pf->total_ifaces || caplen > body_len - 20 )
+        continue;
+
+      uint64_t ts = ( uint64_t ) rd32 ( pf, body + 4 ) << 32 |
+                    rd32 ( pf, body + 8 );
+
+      *pkt = ( struct raw_packet ){ .data = body + 20,
+                                    .ts = ts_nsec ( ts, &pf->ifaces[id] ),
+                                    .caplen = caplen,
+                                    .len = rd32 ( pf, body + 16 ),
+                                    .link = pf->ifaces[id].link };
+      return true;
+    }
+
+  return false;
+}
+
+static bool
+next_pcap ( struct pcap_file *pf, struct raw_packet *pkt )
+{
+  if ( pf->size - pf->off < PCAP_RECORD )
+    return false;
+
+  const uint8_t *rec = pf->data + pf->off;
+  uint32_t caplen = rd32 ( pf, rec + 8 );
+
+  // truncated file
+  if ( caplen > pf->size - pf->off - PCAP_RECORD )
+    return false;
+
+  pf->off += PCAP_RECORD + caplen;
+
+  uint64_t frac = rd32 ( pf, rec + 4 );
+  *pkt = ( struct raw_packet ){
+    .data = rec + PCAP_RECORD,
+    .ts = rd32 ( pf, rec ) * NSEC_PER_SEC +
+          ( ( pf->nanosecond ) ? frac : frac * 1000 ),
+    .caplen = caplen,
+    .len = rd32 ( pf, rec + 12 ),
+    .link = pf->link
+  };
+
+  return true;
+}
+
+// direction of packet by addresses of host, PKTTYPE_UNKNOWN if not of host
+static uint8_t
+direction ( const struct pcap_file *pf,
+            uint8_t family,
+            const uint8_t *saddr,
+            const uint8_t *daddr )
+{
+  size_t len = ( family == AF_INET ) ? 4 : 16;
+
+  for ( unsigned int i = 0; i < pf->total_locals; i++ )
+    {
+      if ( pf->locals_family[i] != family )
+        continue;
+
+      if ( !memcmp ( &pf->locals[i], saddr, len ) )
+        return PACKET_OUTGOING;
+
+      if ( !memcmp ( &pf->locals[i], daddr, len ) )
+        return PACKET_HOST;
+    }
+
+  return PKTTYPE_UNKNOWN;
+}
+
+/* copy headers of packet to frame as of ring, false if the packet is not
+   tcp or udp (filter of ring) or of a link not supported */
+static bool
+to_frame ( struct pcap_file *pf, const struct raw_packet *pkt, uint64_t ts )
+{
+  const uint8_t *p = pkt->data;
+  uint32_t caplen = pkt->caplen;
+  uint32_t len = pkt->len;
+  uint8_t pkttype = PKTTYPE_UNKNOWN;
+  uint16_t type = 0;
+  int if_index = 0;
+  size_t off = 0;
+
+  switch ( pkt->link )
+    {
+      case LINK_ETHERNET:
+        if ( caplen < 14 )
+          return false;
+
+        type = be16 ( p + 12 );
+        off = 14;
+
+        // tags of vlan
+        while ( ( type == ETH_P_8021Q || type == ETH_P_8021AD ) &&
+                caplen >= off + 4 )
+          {
+            type = be16 ( p + off + 2 );
+            off += 4;
+          }
+        break;
+      case LINK_SLL:
+        if ( caplen < 16 )
+          return false;
+
+        pkttype = be16 ( p );
+        type = be16 ( p + 14 );
+        off = 16;
+        len -= MIN ( len, off );
+        break;
+      case LINK_SLL2:
+        if ( caplen < 20 )
+          return false;
+
+        type = be16 ( p );
+        if_index = be32 ( p + 4 );
+        pkttype = p[10];
+        off = 20;
+        len -= MIN ( len, off );
+        break;
+      case LINK_RAW:
+      case LINK_RAW_BSD:
+      case LINK_IPV4:
+      case LINK_IPV6:
+        if ( !caplen )
+          return false;
+
+        type = ( *p >> 4 == 6 ) ? ETH_P_IPV6 : ETH_P_IP;
+        break;
+      default:
+        return false;
+    }
+
+  const uint8_t *l3 = p + off;
+  uint32_t l3_len = caplen - off;
+  uint8_t family, protocol;
+
+  if ( type == ETH_P_IP && l3_len >= 20 && *l3 >> 4 == 4 )
+    {
+      family = AF_INET;
+      protocol = l3[9];
+      if ( pkttype == PKTTYPE_UNKNOWN )
+        pkttype = direction ( pf, family, l3 + 12, l3 + 16 );
+    }
+  else if ( type == ETH_P_IPV6 && l3_len >= 40 && *l3 >> 4 == 6 )
+    {
+      family = AF_INET6;
+      protocol = l3[6];
+      if ( pkttype == PKTTYPE_UNKNOWN )
+        pkttype = direction ( pf, family, l3 + 8, l3 + 24 );
+    }
+  else
+    return false;
+
+  if ( !( protocol == IPPROTO_TCP && pf->proto & TCP ) &&
+       !( protocol == IPPROTO_UDP && pf->proto & UDP ) )
+    return false;
+
+  if ( pkttype != PACKET_HOST && pkttype != PACKET_OUTGOING )
+    return false;
+
+  struct tpacket3_hdr *ppd = ( struct tpacket3_hdr * ) pf->frame;
+  struct sockaddr_ll *ll =
+          ( struct sockaddr_ll * ) ( pf->frame + TPACKET3_HDRLEN -
+                                     sizeof ( struct sockaddr_ll ) );
+
+  // truncated packets are completed with zeros
+  uint32_t snap = MIN ( l3_len, FRAME_SNAP );
+  memset ( pf->frame, 0, FRAME_NET );
+  memcpy ( pf->frame + FRAME_NET, l3, snap );
+  memset ( pf->frame + FRAME_NET + snap, 0, FRAME_SNAP - snap );
+
+  ppd->tp_sec = ts / NSEC_PER_SEC;
+  ppd->tp_nsec = ts % NSEC_PER_SEC;
+  ppd->tp_len = len;
+  ppd->tp_snaplen = snap;
+  ppd->tp_mac = FRAME_NET;
+  ppd->tp_net = FRAME_NET;
+
+  ll->sll_family = AF_PACKET;
+  ll->sll_pkttype = pkttype;
+  ll->sll_ifindex = if_index;
+
+  return true;
+}
+
+static void
+read_locals ( struct pcap_file *pf )
+{
+  struct ifaddrs *ifs;
+
+  if ( getifaddrs ( &ifs ) == -1 )
+    {
+      ERROR_DEBUG ( "%s", "Error read addresses of interfaces" );
+      return;
+    }
+
+  for ( struct ifaddrs *ifa = ifs; ifa && pf->total_locals < MAX_LOCALS;
+        ifa = ifa->ifa_next )
+    {
+      if ( !ifa->ifa_addr )
+        continue;
+
+      unsigned int i = pf->total_locals;
+      union sockaddr_all *sa = ( union sockaddr_all * ) ifa->ifa_addr;
+
+      if ( sa->sa.sa_family == AF_INET )
+        pf->locals[i].ip = sa->in.sin_addr.s_addr;
+      else if ( sa->sa.sa_family == AF_INET6 )
+        pf->locals[i].in6 = sa->in6.sin6_addr;
+      else
+        continue;
+
+      pf->locals_family[i] = sa->sa.sa_family;
+      pf->total_locals++;
+    }
+
+  freeifaddrs ( ifs );
+}
+
+struct pcap_file *
+pcap_file_open ( const char *path, const struct config_op *co )
+{
+  struct pcap_file *pf = calloc ( 1, sizeof *pf );
+  if ( !pf )
+    return NULL;
+
+  pf->data = MAP_FAILED;
+  pf->fast = co->read_fast;
+  pf->proto = co->proto;
+
+  int fd = open ( path, O_RDONLY | O_CLOEXEC );
+  if ( fd == -1 )
+    goto ERROR;
+
+  struct stat st;
+  if ( fstat ( fd, &st ) == -1 || st.st_size < PCAP_HEADER )
+    {
+      close ( fd );
+      goto ERROR;
+    }
+
+  pf->size = st.st_size;
+  pf->data = mmap ( NULL, pf->size, PROT_READ, MAP_PRIVATE, fd, 0 );
+  close ( fd );
+
+  if ( pf->data == MAP_FAILED )
+    goto ERROR;
+
+  // packets are read in sequence
+  madvise ( ( void * ) pf->data, pf->size, MADV_SEQUENTIAL );
+
+  uint32_t magic;
+  memcpy ( &magic, pf->data, sizeof magic );
+
+  if ( magic == PCAPNG_SHB )
+    pf->ng = true;
+  else if ( magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS )
+    pf->nanosecond = magic == PCAP_MAGIC_NS;
+  else if ( magic == __builtin_bswap32 ( PCAP_MAGIC_US ) ||
+            magic == __builtin_bswap32 ( PCAP_MAGIC_NS ) )
+    {
+      pf->swap = true;
+      pf->nanosecond = magic == __builtin_bswap32 ( PCAP_MAGIC_NS );
+    }
+  else
+    {
+      ERROR_DEBUG ( "File '%s' is not pcap or pcapng", path );
+      goto ERROR;
+    }
+
+  if ( !pf->ng )
+    {
+      // high bits are of FCS
+      pf->link = rd32 ( pf, pf->data + 20 ) & 0x0fffffff;
+      pf->off = PCAP_HEADER;
+    }
+
+  read_locals ( pf );
+
+  return pf;
+
+ERROR:
+  pcap_file_close ( pf );
+  return NULL;
+}
+
+bool
+pcap_file_read ( struct pcap_file *pf, bool view_conections )
+{
+  struct timespec tp;
+  clock_gettime ( CLOCK_REALTIME, &tp );
+  uint64_t now = tp.tv_sec * NSEC_PER_SEC + tp.tv_nsec;
+
+  if ( !pf->start )
+    pf->start = now;
+
+  struct packet batch[STATISTICS_BATCH];
+  size_t total_batch = 0;
+  uint64_t total = 0;
+  bool miss = false;
+
+  uint64_t cycles = profile_cycles_start ();
+
+  while ( !pf->eof )
+    {
+      if ( !pf->pending )
+        {
+          pf->pending = ( pf->ng ) ? next_pcapng ( pf, &pf->next )
+                                   : next_pcap ( pf, &pf->next );
+          if ( !pf->pending )
+            {
+              pf->eof = true;
+              break;
+            }
+
+          if ( !pf->first )
+            pf->first = pf->next.ts;
+        }
+
+      // time of capture relative to first packet, moved to now
+      uint64_t ts = pf->start;
+      if ( pf->next.ts > pf->first )
+        ts += pf->next.ts - pf->first;
+
+      if ( pf->fast )
+        ts = now;
+      else if ( ts > now )
+        break;
+
+      pf->pending = false;
+      total++;
+
+      if ( !to_frame ( pf, &pf->next, ts ) )
+        continue;
+
+      packet_tick ( ts / NSEC_PER_SEC );
+
+      struct packet *packet = &batch[total_batch];
+      memset ( packet, 0, sizeof ( *packet ) );
+      if ( !parse_packet ( packet, ( struct tpacket3_hdr * ) pf->frame ) )
+        continue;
+
+      if ( ++total_batch < ARRAY_SIZE ( batch ) )
+        continue;
+
+      if ( !statistics_add_batch ( batch, total_batch, view_conections ) )
+        miss = true;
+
+      total_batch = 0;
+    }
+
+  if ( total_batch &&
+       !statistics_add_batch ( batch, total_batch, view_conections ) )
+    miss = true;
+
+  profile_packets ( cycles, total );
+  pf->packets += total;
+
+  return miss;
+}
+
+bool
+pcap_file_eof ( const struct pcap_file *pf )
+{
+  return pf->eof;
+}
+
+void
+pcap_file_stats ( struct pcap_file *pf, struct sock_stats *stats )
+{
+  stats->packets += pf->packets;
+  pf->packets = 0;
+}
+
+void
+pcap_file_close ( struct pcap_file *pf )
+{
+  if ( !pf )
+    return;
+
+  if ( pf->data != MAP_FAILED )
+    munmap ( ( void * ) pf->data, pf->size );
+
+  free ( pf );
+}
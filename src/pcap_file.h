@@ -0,0 +1,61 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PCAP_FILE_H
+#define PCAP_FILE_H
+
+#include <stdbool.h>
+
+#include "config.h"
+#include "sock.h"  // struct sock_stats
+
+/* packets of a file pcap or pcapng, in place of capture, passed by same
+   parse (packet.h) and accounting (statistics.h) of packets of ring.
+   the file is mapped in memory and each packet is copied (only headers)
+   to a frame as of ring, with the time of capture moved to now.
+   link types supported are ethernet, raw ip and linux cooked (SLL and
+   SLL2, of 'tcpdump -i any'), only the last has the direction of packet,
+   in the others the direction is by addresses of interfaces of this host.
+   processes are of this host, so the traffic is attributed only to
+   sockets that exist here */
+
+struct pcap_file;
+
+// read packets at speed of capture, or all at once with co->read_fast
+struct pcap_file *
+pcap_file_open ( const char *path, const struct config_op *co );
+
+/* account packets captured since start of reading until now, or all the
+   file if fast. return true if any packet not was associated with a
+   process (need update of processes) */
+bool
+pcap_file_read ( struct pcap_file *pf, bool view_conections );
+
+// true after the last packet of file
+bool
+pcap_file_eof ( const struct pcap_file *pf );
+
+// add to 'stats' the packets read since last call
+void
+pcap_file_stats ( struct pcap_file *pf, struct sock_stats *stats );
+
+void
+pcap_file_close ( struct pcap_file *pf );
+
+#endif  // PCAP_FILE_H
@@ -0,0 +1,78 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>  // snprintf
+
+#include "pktsize.h"
+#include "pool.h"
+
+static struct pool pktsize_pool;
+
+struct pktsize *
+pktsize_new ( void )
+{
+  if ( !pktsize_pool.obj_size )
+    pool_init ( &pktsize_pool, "sizes", sizeof ( struct pktsize ), 0 );
+
+  return pool_calloc ( &pktsize_pool );
+}
+
+void
+pktsize_free ( struct pktsize *ps )
+{
+  if ( ps )
+    pool_free ( &pktsize_pool, ps );
+}
+
+void
+pktsize_merge ( struct pktsize *dst, const struct pktsize *src )
+{
+  for ( unsigned int d = 0; d < PKTSIZE_DIRS; d++ )
+    for ( unsigned int i = 0; i < PKTSIZE_BUCKETS; i++ )
+      dst->packets[d][i] += src->packets[d][i];
+}
+
+uint64_t
+pktsize_total ( const struct pktsize *ps, enum pktsize_dir dir )
+{
+  uint64_t total = 0;
+
+  for ( unsigned int i = 0; i < PKTSIZE_BUCKETS; i++ )
+    total += ps->packets[dir][i];
+
+  return total;
+}
+
+void
+pktsize_label ( unsigned int bucket, char *buf, size_t len )
+{
+  const char *more = ( bucket == PKTSIZE_BUCKETS - 1 ) ? "+" : "";
+
+  if ( bucket < 10 )
+    snprintf ( buf, len, "%u%s", 1U << bucket, more );
+  else
+    snprintf ( buf, len, "%uK%s", 1U << ( bucket - 10 ), more );
+}
+
+size_t
+pktsize_memory ( void )
+{
+  return pktsize_pool.used * pktsize_pool.obj_size;
+}
@@ -0,0 +1,96 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PKTSIZE_H
+#define PKTSIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* histogram of sizes of packets by log2, the bucket i has the sizes of
+   2^i to 2^(i+1) - 1 bytes, the last one also all sizes above. small sizes
+   are of RPC and ACKs, sizes of MTU are of bulk transfers (and sizes above
+   of MTU are of GRO/TSO) */
+
+#define PKTSIZE_BUCKETS 16
+
+// "32K+"
+#define PKTSIZE_LABEL_STRLEN 8
+
+enum pktsize_dir
+{
+  PKTSIZE_RX,
+  PKTSIZE_TX,
+  PKTSIZE_DIRS
+};
+
+// kept out of struct net_stat, so the hot struct don't grow
+struct pktsize
+{
+  uint64_t packets[PKTSIZE_DIRS][PKTSIZE_BUCKETS];
+};
+
+/* bucket of 'packets' with 'bytes' in total, by your average size. the
+   average of sizes of a same bucket is in this bucket, so is exact to
+   packets already grouped by bucket */
+static inline unsigned int
+pktsize_bucket ( uint64_t bytes, uint64_t packets )
+{
+  uint64_t size = ( packets > 1 ) ? bytes / packets : bytes;
+
+  // sizes 0 and 1 are of bucket 0
+  unsigned int bucket = 63 - __builtin_clzll ( size | 1 );
+
+  return ( bucket < PKTSIZE_BUCKETS ) ? bucket : PKTSIZE_BUCKETS - 1;
+}
+
+static inline void
+pktsize_add ( struct pktsize *ps,
+              enum pktsize_dir dir,
+              unsigned int bucket,
+              uint64_t packets )
+{
+  ps->packets[dir][bucket] += packets;
+}
+
+// return NULL if no memory, objects are of a pool (not thread safe)
+struct pktsize *
+pktsize_new ( void );
+
+void
+pktsize_free ( struct pktsize *ps );
+
+// add counters of 'src' to 'dst', as aggregated rows
+void
+pktsize_merge ( struct pktsize *dst, const struct pktsize *src );
+
+// sum of packets of all buckets of direction
+uint64_t
+pktsize_total ( const struct pktsize *ps, enum pktsize_dir dir );
+
+// lower bound of bucket as text, as "64", "1K" or "32K+" to the last one
+void
+pktsize_label ( unsigned int bucket, char *buf, size_t len );
+
+// bytes in use by histograms
+size_t
+pktsize_memory ( void );
+
+#endif  // PKTSIZE_H
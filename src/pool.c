@@ -0,0 +1,272 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdalign.h>  // alignof
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>  // memset, strcmp
+
+#include "pool.h"
+#include "hugemem.h"
+#include "macro_util.h"
+
+// objects by slab when not specified by user
+#define SLAB_OBJS_DEFAULT 256
+
+#define ALIGN_UP( n, a ) ( ( ( n ) + ( a ) - 1 ) & ~( ( a ) - 1 ) )
+
+// objects of size of a cache line or more are aligned to cache line
+struct slab
+{
+  struct slab *next;
+  size_t size;
+  alignas ( CACHE_LINE_SIZE ) char objs[];
+};
+
+// object free, the first bytes of object are the link
+struct free_obj
+{
+  struct free_obj *next;
+};
+
+// list of pools, changed only in init/destroy
+static pthread_mutex_t pools_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pool *pools = NULL;
+
+void
+pool_init ( struct pool *pool,
+            const char *name,
+            size_t obj_size,
+            size_t slab_objs )
+{
+  if ( obj_size < sizeof ( struct free_obj ) )
+    obj_size = sizeof ( struct free_obj );
+
+  size_t align = ( obj_size >= CACHE_LINE_SIZE ) ? CACHE_LINE_SIZE
+                                                 : alignof ( max_align_t );
+
+  *pool = ( struct pool ){
+    .name = name,
+    .obj_size = ALIGN_UP ( obj_size, align ),
+    .slab_objs = slab_objs ? slab_objs : SLAB_OBJS_DEFAULT
+  };
+
+  pthread_mutex_lock ( &pools_lock );
+  pool->next = pools;
+  pools = pool;
+  pthread_mutex_unlock ( &pools_lock );
+}
+
+// size of a slab, multiple of alignment as required by aligned_alloc
+static inline size_t
+pool_memory_slab ( const struct pool *pool )
+{
+  return ALIGN_UP ( sizeof ( struct slab ) + pool->slab_objs * pool->obj_size,
+                    CACHE_LINE_SIZE );
+}
+
+static bool
+pool_grow ( struct pool *pool )
+{
+  // less slabs, and less misses of TLB, with many objects
+  if ( hugemem_enabled () && pool->slabs )
+    {
+      size_t max = ( HUGEMEM_PAGE - sizeof ( struct slab ) ) / pool->obj_size;
+      if ( pool->slab_objs < max )
+        pool->slab_objs = MIN ( pool->slab_objs * 2, max );
+    }
+
+  size_t size = pool_memory_slab ( pool );
+  struct slab *slab = hugemem_is_huge ( size )
+                              ? hugemem_calloc ( 1, size )
+                              : aligned_alloc ( CACHE_LINE_SIZE, size );
+
+  if ( !slab )
+    return false;
+
+  slab->next = pool->slabs;
+  slab->size = size;
+  pool->slabs = slab;
+  pool->total_slabs++;
+  pool->memory += size;
+
+  // objects are used in order of address, the slab is touched on demand
+  pool->bump = slab->objs;
+  pool->bump_end = slab->objs + pool->slab_objs * pool->obj_size;
+
+  return true;
+}
+
+void *
+pool_alloc ( struct pool *pool )
+{
+  void *obj;
+
+  if ( pool->free_list )
+    {
+      struct free_obj *fo = pool->free_list;
+      pool->free_list = fo->next;
+      obj = fo;
+    }
+  else
+    {
+      if ( pool->bump == pool->bump_end && !pool_grow ( pool ) )
+        return NULL;
+
+      obj = pool->bump;
+      pool->bump += pool->obj_size;
+    }
+
+  pool->used++;
+
+  return obj;
+}
+
+void *
+pool_calloc ( struct pool *pool )
+{
+  void *obj = pool_alloc ( pool );
+
+  if ( obj )
+    memset ( obj, 0, pool->obj_size );
+
+  return obj;
+}
+
+void
+pool_free ( struct pool *pool, void *obj )
+{
+  if ( !obj )
+    return;
+
+  struct free_obj *fo = obj;
+  fo->next = pool->free_list;
+  pool->free_list = fo;
+
+  pool->used--;
+}
+
+size_t
+pool_memory ( const struct pool *pool )
+{
+  return pool->memory;
+}
+
+size_t
+pool_memory_total ( void )
+{
+  size_t total = 0;
+
+  pthread_mutex_lock ( &pools_lock );
+  for ( struct pool *pool = pools; pool; pool = pool->next )
+    total += pool_memory ( pool );
+  pthread_mutex_unlock ( &pools_lock );
+
+  return total;
+}
+
+size_t
+pool_memory_used ( const char *name )
+{
+  size_t total = 0;
+
+  pthread_mutex_lock ( &pools_lock );
+  for ( struct pool *pool = pools; pool; pool = pool->next )
+    {
+      if ( !strcmp ( pool->name, name ) )
+        total += pool->used * pool->obj_size;
+    }
+  pthread_mutex_unlock ( &pools_lock );
+
+  return total;
+}
+
+void
+pool_destroy ( struct pool *pool )
+{
+  pthread_mutex_lock ( &pools_lock );
+  struct pool **p = &pools;
+  while ( *p && *p != pool )
+    p = &( *p )->next;
+
+  if ( *p )
+    *p = pool->next;
+  pthread_mutex_unlock ( &pools_lock );
+
+  struct slab *slab = pool->slabs;
+  while ( slab )
+    {
+      struct slab *next = slab->next;
+      hugemem_free ( slab, 1, slab->size );
+      slab = next;
+    }
+
+  pool->slabs = NULL;
+  pool->free_list = NULL;
+  pool->bump = pool->bump_end = NULL;
+  pool->total_slabs = pool->used = pool->memory = 0;
+}
+
+/* the counters of pools of other threads (resolver) are read without lock
+   of user, the values can be a bit outdated */
+void
+pool_dump ( FILE *file )
+{
+  pthread_mutex_lock ( &pools_lock );
+
+  fprintf ( file,
+            "%-18s %10s %12s %12s\n",
+            "pool",
+            "pools",
+            "objects",
+            "memory (KiB)" );
+
+  for ( struct pool *pool = pools; pool; pool = pool->next )
+    {
+      // pools with same name are written in the first of them
+      struct pool *first = pools;
+      while ( strcmp ( first->name, pool->name ) )
+        first = first->next;
+
+      if ( first != pool )
+        continue;
+
+      size_t total = 0, used = 0, memory = 0;
+      for ( struct pool *p = pool; p; p = p->next )
+        {
+          if ( strcmp ( p->name, pool->name ) )
+            continue;
+
+          total++;
+          used += p->used;
+          memory += pool_memory ( p );
+        }
+
+      fprintf ( file,
+                "%-18s %10zu %12zu %12.1f\n",
+                pool->name,
+                total,
+                used,
+                memory / 1024.0 );
+    }
+
+  pthread_mutex_unlock ( &pools_lock );
+}
@@ -0,0 +1,94 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdio.h>  // FILE
+
+/* pool of objects of fixed size, the objects are carved from slabs (large
+   blocks) and the freed objects are kept in a free list inside of the
+   objects, so alloc and free are O(1) and not call malloc.
+   objects of size of a cache line or bigger start in a cache line.
+   the slabs are only returned to system by pool_destroy.
+   with huge pages (hugemem.h) the slabs double of size in each grow up to
+   a huge page.
+   a pool is not thread safe, each pool must be used by only one thread or
+   protected by lock of user (as of hashtable that use it) */
+
+struct slab;
+
+struct pool
+{
+  const char *name;   // name in pool_dump, pools with same name are summed
+  size_t obj_size;    // size of object, aligned
+  size_t slab_objs;   // objects by slab
+  void *free_list;    // objects freed
+  char *bump;         // next object never used of last slab
+  char *bump_end;
+  struct slab *slabs;
+  size_t total_slabs;
+  size_t memory;      // bytes of all slabs
+  size_t used;        // objects allocated
+
+  struct pool *next;  // list of pools to pool_dump
+};
+
+/* 'obj_size' is size of object and 'slab_objs' the number of objects
+   allocated at once, 0 to default */
+void
+pool_init ( struct pool *pool,
+            const char *name,
+            size_t obj_size,
+            size_t slab_objs );
+
+// return NULL if no memory
+void *
+pool_alloc ( struct pool *pool );
+
+// object with memory zeroed
+void *
+pool_calloc ( struct pool *pool );
+
+void
+pool_free ( struct pool *pool, void *obj );
+
+// bytes allocated of system by pool
+size_t
+pool_memory ( const struct pool *pool );
+
+// bytes allocated by all pools
+size_t
+pool_memory_total ( void );
+
+// bytes of objects in use of pools with name 'name'
+size_t
+pool_memory_used ( const char *name );
+
+// free all slabs, objects not freed are released too
+void
+pool_destroy ( struct pool *pool );
+
+// write memory usage of all pools
+void
+pool_dump ( FILE *file );
+
+#endif  // POOL_H
@@ -0,0 +1,66 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+/* static tracepoints (USDT) of provider 'netproc', to trace in production
+   without debugger, as:
+     bpftrace -e 'usdt:./bin/netproc:netproc:attribution_miss { @[arg1]++ }'
+   a probe disabled is a nop instruction, the arguments are only evaluated
+   when a tracer is attached.
+   without sys/sdt.h (package systemtap-sdt-dev) or with NO_PROBES the probes
+   are compiled out.
+
+   probes and arguments:
+     block_acquire (block, packets)  block of ring read by main or worker
+     block_release (block)           block returned to kernel
+     parse_failure (version)         packet not parsed, version of ip
+     attribution_miss (family, protocol, local_port)
+                                     packet without connection of a process
+     processes_update_start ()
+     processes_update_end (ok, processes)
+     connection_update_start ()
+     connection_update_end (ok)
+     task_enqueue (func)             task added to threads of resolver
+     task_complete (func) */
+
+#if !defined( NO_PROBES ) && defined( __has_include )
+#if __has_include( <sys/sdt.h> )
+#include <sys/sdt.h>
+#define PROBES_ENABLED 1
+#endif
+#endif
+
+#ifdef PROBES_ENABLED
+#define PROBE( name ) DTRACE_PROBE ( netproc, name )
+#define PROBE1( name, a ) DTRACE_PROBE1 ( netproc, name, a )
+#define PROBE2( name, a, b ) DTRACE_PROBE2 ( netproc, name, a, b )
+#define PROBE3( name, a, b, c ) DTRACE_PROBE3 ( netproc, name, a, b, c )
+#else
+// arguments not evaluated, but used to not warn of unused variables
+#define PROBE( name ) ( ( void ) 0 )
+#define PROBE1( name, a ) ( ( void ) sizeof ( a ) )
+#define PROBE2( name, a, b ) ( PROBE1 ( name, a ), PROBE1 ( name, b ) )
+#define PROBE3( name, a, b, c ) \
+  ( PROBE2 ( name, a, b ), PROBE1 ( name, c ) )
+#endif
+
+#endif  // PROBE_H
@@ -0,0 +1,276 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// references
+// linux/cn_proc.h, linux/connector.h
+
+#include <errno.h>   // variable errno
+#include <poll.h>    // poll
+#include <stdlib.h>  // calloc
+#include <string.h>  // strerror
+#include <unistd.h>  // close
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+
+#include "proc_events.h"
+#include "vector.h"
+#include "m_error.h"
+
+// buffer of socket in kernel, events of bursts of forks are not lost
+#define RCVBUF_SIZE ( 1024 * 1024 )
+
+// time in milliseconds to wait confirmation of subscription
+#define ACK_TIMEOUT 100
+
+struct proc_events
+{
+  struct process_event *events;  // vector
+  int sock;
+  bool lost;
+};
+
+// aligned to struct nlmsghdr
+static uint32_t buf[4096 / sizeof ( uint32_t )];
+
+static bool
+send_op ( int sock, enum proc_cn_mcast_op op )
+{
+  // aligned to struct nlmsghdr
+  uint32_t msg[NLMSG_SPACE ( sizeof ( struct cn_msg ) + sizeof ( op ) ) /
+               sizeof ( uint32_t )];
+  memset ( msg, 0, sizeof ( msg ) );
+
+  struct nlmsghdr *nlh = ( struct nlmsghdr * ) msg;
+  nlh->nlmsg_len = NLMSG_LENGTH ( sizeof ( struct cn_msg ) + sizeof ( op ) );
+  nlh->nlmsg_type = NLMSG_DONE;
+
+  struct cn_msg *cn = NLMSG_DATA ( nlh );
+  cn->id.idx = CN_IDX_PROC;
+  cn->id.val = CN_VAL_PROC;
+  cn->len = sizeof ( op );
+  memcpy ( cn->data, &op, sizeof ( op ) );
+
+  if ( send ( sock, msg, nlh->nlmsg_len, 0 ) == -1 )
+    {
+      ERROR_DEBUG ( "Error send to proc connector: %s", strerror ( errno ) );
+      return false;
+    }
+
+  return true;
+}
+
+static void
+push_event ( struct proc_events *pe, pid_t pid, uint8_t type )
+{
+  struct process_event event = { .pid = pid, .type = type };
+
+  if ( !vector_push ( pe->events, &event ) )
+    pe->lost = true;
+}
+
+/* only events of processes are kept, of threads are ignored.
+   return the error of confirmation of subscription, -1 if there is not */
+static int
+handle_msg ( struct proc_events *pe, const struct nlmsghdr *nlh, ssize_t len )
+{
+  int ack = -1;
+
+  for ( ; NLMSG_OK ( nlh, len ); nlh = NLMSG_NEXT ( nlh, len ) )
+    {
+      if ( nlh->nlmsg_type != NLMSG_DONE )
+        continue;
+
+      const struct cn_msg *cn = NLMSG_DATA ( nlh );
+      if ( cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC ||
+           cn->len < sizeof ( struct proc_event ) )
+        continue;
+
+      const struct proc_event *ev = ( const struct proc_event * ) cn->data;
+
+      switch ( ev->what )
+        {
+          case PROC_EVENT_NONE:
+            ack = ev->event_data.ack.err;
+            break;
+          case PROC_EVENT_FORK:
+            if ( ev->event_data.fork.child_pid ==
+                 ev->event_data.fork.child_tgid )
+              push_event ( pe, ev->event_data.fork.child_tgid, PROCESS_NEW );
+            break;
+          case PROC_EVENT_EXEC:
+            if ( ev->event_data.exec.process_pid ==
+                 ev->event_data.exec.process_tgid )
+              push_event (
+                      pe, ev->event_data.exec.process_tgid, PROCESS_EXEC );
+            break;
+          case PROC_EVENT_EXIT:
+            if ( ev->event_data.exit.process_pid ==
+                 ev->event_data.exit.process_tgid )
+              push_event (
+                      pe, ev->event_data.exit.process_tgid, PROCESS_EXIT );
+            break;
+          default:
+            break;
+        }
+    }
+
+  return ack;
+}
+
+// kernel confirm the subscription, without permission the error is EPERM
+static bool
+wait_ack ( struct proc_events *pe )
+{
+  struct pollfd pfd = { .fd = pe->sock, .events = POLLIN };
+
+  while ( poll ( &pfd, 1, ACK_TIMEOUT ) > 0 )
+    {
+      ssize_t len = recv ( pe->sock, buf, sizeof ( buf ), 0 );
+      if ( len <= 0 )
+        break;
+
+      int ack = handle_msg ( pe, ( struct nlmsghdr * ) buf, len );
+      if ( ack != -1 )
+        return ack == 0;
+    }
+
+  ERROR_DEBUG ( "%s", "proc connector not confirmed subscription" );
+  return false;
+}
+
+struct proc_events *
+proc_events_init ( void )
+{
+  struct proc_events *pe = calloc ( 1, sizeof ( *pe ) );
+  if ( !pe )
+    return NULL;
+
+  pe->sock = -1;
+  pe->events = vector_new ( sizeof ( struct process_event ) );
+  if ( !pe->events )
+    goto ERROR;
+
+  pe->sock = socket ( AF_NETLINK,
+                      SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                      NETLINK_CONNECTOR );
+  if ( pe->sock == -1 )
+    {
+      ERROR_DEBUG ( "Error create socket netlink: %s", strerror ( errno ) );
+      goto ERROR;
+    }
+
+  // a buffer greater than limit of system only with CAP_NET_ADMIN
+  int size = RCVBUF_SIZE;
+  if ( setsockopt ( pe->sock,
+                    SOL_SOCKET,
+                    SO_RCVBUFFORCE,
+                    &size,
+                    sizeof ( size ) ) == -1 )
+    setsockopt ( pe->sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof ( size ) );
+
+  struct sockaddr_nl addr = { .nl_family = AF_NETLINK,
+                              .nl_groups = CN_IDX_PROC };
+
+  if ( bind ( pe->sock, ( struct sockaddr * ) &addr, sizeof ( addr ) ) == -1 )
+    {
+      ERROR_DEBUG ( "Error bind proc connector: %s", strerror ( errno ) );
+      goto ERROR;
+    }
+
+  if ( !send_op ( pe->sock, PROC_CN_MCAST_LISTEN ) || !wait_ack ( pe ) )
+    goto ERROR;
+
+  // events before of first update of processes are not needed
+  vector_clear ( pe->events );
+
+  return pe;
+
+ERROR:
+  proc_events_free ( pe );
+  return NULL;
+}
+
+size_t
+proc_events_read ( struct proc_events *pe )
+{
+  while ( 1 )
+    {
+      ssize_t len = recv ( pe->sock, buf, sizeof ( buf ), 0 );
+
+      if ( len > 0 )
+        {
+          handle_msg ( pe, ( struct nlmsghdr * ) buf, len );
+          continue;
+        }
+
+      // events discarded by kernel, socket keep working
+      if ( len == -1 && errno == ENOBUFS )
+        {
+          pe->lost = true;
+          continue;
+        }
+
+      if ( len == -1 && errno == EINTR )
+        continue;
+
+      break;
+    }
+
+  return vector_size ( pe->events );
+}
+
+const struct process_event *
+proc_events_get ( struct proc_events *pe )
+{
+  return pe->events;
+}
+
+bool
+proc_events_lost ( struct proc_events *pe )
+{
+  return pe->lost;
+}
+
+void
+proc_events_clear ( struct proc_events *pe )
+{
+  vector_clear ( pe->events );
+  pe->lost = false;
+}
+
+void
+proc_events_free ( struct proc_events *pe )
+{
+  if ( !pe )
+    return;
+
+  if ( pe->sock != -1 )
+    {
+      send_op ( pe->sock, PROC_CN_MCAST_IGNORE );
+      close ( pe->sock );
+    }
+
+  if ( pe->events )
+    vector_free ( pe->events );
+
+  free ( pe );
+}
@@ -0,0 +1,59 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROC_EVENTS_H
+#define PROC_EVENTS_H
+
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+
+#include "processes.h"  // struct process_event
+
+/* source of changes of processes, the netlink proc connector report each
+   fork, exec and exit of processes, so processes_update_events keep the
+   processes without scan of /proc/. requires CAP_NET_ADMIN and is only
+   available in initial namespace of pid */
+
+struct proc_events;
+
+struct proc_events *
+proc_events_init ( void );
+
+/* read events of kernel, return total of events pending */
+size_t
+proc_events_read ( struct proc_events *pe );
+
+/* events read and not yet consumed */
+const struct process_event *
+proc_events_get ( struct proc_events *pe );
+
+/* true if kernel discarded events (buffer of socket full) since last
+   clear, so is need a full update of processes */
+bool
+proc_events_lost ( struct proc_events *pe );
+
+/* discard events pending, called after update of processes */
+void
+proc_events_clear ( struct proc_events *pe );
+
+void
+proc_events_free ( struct proc_events *pe );
+
+#endif  // PROC_EVENTS_H
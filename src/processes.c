@@ -21,35 +21,136 @@
 #include <errno.h>      // variable errno
 #include <stdbool.h>    // type boolean
 #include <stdio.h>      // snprintf
+#include <stdlib.h>     // qsort
 #include <string.h>     // memset
 #include <unistd.h>     // readliink
 #include <sys/types.h>  // open
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include "processes.h"  // process_t
-#include "jhash.h"
+#include "hash.h"
 #include "hashtable.h"
+#include "pool.h"
 #include "vector.h"
 #include "full_read.h"
+#include "arena.h"
+#include "intern.h"
+#include "netns.h"
+#include "aggregate.h"
 #include "config.h"
 #include "m_error.h"  // ERROR_DEBUG
+#include "profile.h"
+#include "probe.h"
 #include "macro_util.h"
+#include "uring.h"
+#include "resolver/get_cpu.h"
+#include "resolver/thread_pool.h"
 
 // 4294967295
 #define LEN_MAX_INT 10
 
-// /proc/%d/cmdline
-#define MAX_CMDLINE 14 + LEN_MAX_INT
+// <root>/%d/cmdline
+#define MAX_CMDLINE PROC_ROOT_MAX + 10 + LEN_MAX_INT
 
-// /proc/<pid>/fd/<id-fd> + 2 align
-#define MAX_PATH_FD 10 + LEN_MAX_INT + LEN_MAX_INT + 2
+// <root>/<pid>/fd/<id-fd> + 2 align
+#define MAX_PATH_FD PROC_ROOT_MAX + 5 + LEN_MAX_INT + LEN_MAX_INT + 2
 
 // strlen ("socket:[4294967295]") + 5 align
 #define MAX_NAME_SOCKET 9 + LEN_MAX_INT + 5
 
+// with many processes, the fds are read by thread pool and main thread,
+// each one take blocks of SCAN_BLOCK processes until all are read
+#define SCAN_PARALLEL_MIN 512
+#define SCAN_BLOCK 64
+#define SCAN_MAX_THREADS 31
+
+// names of new processes are read in batch by io_uring, up to SIZE_CMDLINE
+// bytes of each one (longer are read again), with at least NAMES_MIN
+// new processes in scan. NAMES_BATCH files by syscall
+#define NAMES_MIN 16
+#define NAMES_BATCH 256
+#define SIZE_CMDLINE 1024
+
+// space of connections of a process is released when it uses less than
+// 1 / SHRINK_FACTOR
+#define SHRINK_FACTOR 4
+
+// fd of a process and inode of socket pointed by it, 0 if not is a socket
+struct fd_inode
+{
+  unsigned long inode;
+  uint32_t fd;
+  bool conn;  // socket was a connection in last scan
+};
+
+/* last scan of /proc/<pid>/fd/ of a process, also of processes without
+   sockets. the inodes are kept to next scan, so readlink is done only in
+   new fds, a process without new fds not is read again */
+struct proc_scan
+{
+  struct fd_inode *fds;  // sorted by fd
+  pid_t pid;
+  uint32_t total_fds;
+  uint32_t sockets;     // fds that point to a socket
+  unsigned long netns;  // network namespace, 0 is of netproc
+  bool active;
+  bool read;  // fds were read in this scan
+};
+
+/* scan of fds of processes shared with thread pool, it is freed by the
+   last reference, a task can run after all processes were read */
+struct scan_job
+{
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;  // signaled when all processes were read
+  struct proc_scan **scans;
+  size_t reused;         // atomic
+  unsigned int total;    // total of scans
+  unsigned int next;     // first scan of next block, atomic
+  unsigned int done;     // scans already read, under mutex
+  unsigned int threads;  // tasks already running, atomic
+  unsigned int refs;     // atomic
+  bool full;
+};
+
 static hashtable_t *ht_process;
 
+// all process_t in ht_process are allocated of it
+static struct pool proc_pool;
+
+// scans of all processes on /proc/, key pid
+static hashtable_t *ht_scan;
+static struct pool scan_pool;
+
+// scans of processes of /proc/ in the last update
+static struct proc_scan **scan_list;
+
+// readers of /proc/ and /proc/<pid>/fd/, buffers are kept between scans.
+// 'dir_fds[0]' is of main thread, others of tasks of thread pool
+static struct numeric_dir dir_pids;
+static struct numeric_dir dir_fds[SCAN_MAX_THREADS + 1];
+
+// temporary buffers of main thread in a update, reset at end of update
+static struct arena scan_arena = ARENA_INITIALIZER;
+
+// ring of reads of names, started in first scan with many new processes
+static struct uring names_ring = URING_INITIALIZER;
+static int names_ring_state;  // 0 not started, 1 started, -1 failed
+
+// tasks in each parallel scan, 0 if thread pool not is used
+static unsigned int scan_threads;
+static bool scan_threads_started;
+
+// row of traffic without process, always in list of processes,
+// name is interned in processes_init
+#define NAME_UNATTRIBUTED "unattributed"
+static process_t unattributed = { .active = true, .listed = true };
+
+// scans of processes, a connection found in scan is of first process found
+static uint32_t scan_gen;
+
 static void
 handle_cmdline ( char *buff, size_t len )
 {
@@ -65,14 +166,38 @@ handle_cmdline ( char *buff, size_t len )
   *buff = '\0';
 }
 
+// name interned of 'total_read' bytes of /proc/<pid>/cmdline
+static ssize_t
+set_name_process ( const char **buffer, char *cmdline, ssize_t total_read )
+{
+  if ( total_read <= 0 )
+    {
+      ERROR_DEBUG ( "%s", "error read process name" );
+      return -1;
+    }
+
+  handle_cmdline ( cmdline, ( size_t ) total_read );
+
+  // last bytes is null
+  if ( !( *buffer = intern ( cmdline, total_read - 1 ) ) )
+    return -1;
+
+  return total_read - 1;
+}
+
 // armazena o nome do processo no buffer e retorna
 // o tamanho do nome do processo ou -1 em caso de erro,
-// função cuida da alocação de memoria para o nome do processo
+// função cuida da alocação de memoria para o nome do processo,
+// o nome é interned, processos com mesmo nome compartilham a string
 static ssize_t
-get_name_process ( char **buffer, const pid_t pid )
+get_name_process ( const char **buffer, const pid_t pid )
 {
   char path_cmdline[MAX_CMDLINE];
-  snprintf ( path_cmdline, sizeof ( path_cmdline ), "/proc/%d/cmdline", pid );
+  snprintf ( path_cmdline,
+             sizeof ( path_cmdline ),
+             "%s/%d/cmdline",
+             proc_root (),
+             pid );
 
   int fd = open ( path_cmdline, O_RDONLY );
   if ( fd == -1 )
@@ -81,25 +206,18 @@ get_name_process ( char **buffer, const pid_t pid )
       return -1;
     }
 
-  ssize_t total_read = full_read ( fd, buffer );
+  char *cmdline;
+  ssize_t total_read = full_read_arena ( fd, &cmdline, &scan_arena );
   close ( fd );
 
-  if ( total_read <= 0 )
-    {
-      ERROR_DEBUG ( "%s", "error read process name" );
-      return -1;
-    }
-
-  handle_cmdline ( *buffer, ( size_t ) total_read );
-
-  // last bytes is null
-  return total_read - 1;
+  return set_name_process ( buffer, cmdline, total_read );
 }
 
+// 'name' already read (see read_new_names) or NULL to read it now
 static process_t *
-create_new_process ( pid_t pid )
+create_new_process ( pid_t pid, const char *name )
 {
-  process_t *proc = malloc ( sizeof *proc );
+  process_t *proc = pool_alloc ( &proc_pool );
 
   if ( proc )
     {
@@ -111,26 +229,59 @@ create_new_process ( pid_t pid )
         goto ERROR;
 
       proc->total_conections = 0;
-      if ( -1 == get_name_process ( &proc->name, pid ) )
+      proc->conns = NULL;
+      proc->total_members = 0;
+      proc->scan_gen = 0;
+      proc->seen = 0;
+      proc->listed = false;
+      proc->conns_changed = false;
+
+      if ( name )
+        proc->name = intern_ref ( name );
+      else if ( -1 == get_name_process ( &proc->name, pid ) )
         goto ERROR;
 
+      proc->group = aggregate_join ( proc );
+      proc->remotes = NULL;
+      proc->sizes = NULL;
+
       memset ( &proc->net_stat, 0, sizeof ( struct net_stat ) );
     }
 
   return proc;
 
 ERROR:
-  free ( proc );
+  pool_free ( &proc_pool, proc );
   return NULL;
 }
 
+static void
+detach_all ( process_t *proc );
+
 static void
 free_process ( void *arg )
 {
   process_t *process = arg;
-  free ( process->name );
+
+  // connections not can reference process freed
+  detach_all ( process );
+
+  aggregate_leave ( process );
+  intern_put ( process->name );
   vector_free ( process->conections );
-  free ( process );
+  rate_net_stat_free ( &process->net_stat );
+  topk_free ( process->remotes );
+  pktsize_free ( process->sizes );
+  pool_free ( &proc_pool, process );
+}
+
+static void
+free_scan ( void *arg )
+{
+  struct proc_scan *scan = arg;
+  netns_put ( scan->netns );
+  free ( scan->fds );
+  pool_free ( &scan_pool, scan );
 }
 
 static bool
@@ -142,7 +293,7 @@ ht_cb_compare ( const void *key1, const void *key2 )
 static hash_t
 ht_cb_hash ( const void *key )
 {
-  return jhash8 ( key, sizeof ( pid_t ), 0 );
+  return hash_u64 ( ( uint32_t ) * ( const pid_t * ) key );
 }
 
 struct processes *
@@ -153,22 +304,52 @@ processes_init ( void )
     return NULL;
 
   procs->proc = vector_new ( sizeof ( process_t * ) );
+  unattributed.conections = vector_new ( sizeof ( connection_t * ) );
+  unattributed.name =
+          intern ( NAME_UNATTRIBUTED, sizeof ( NAME_UNATTRIBUTED ) - 1 );
+
+  if ( !procs->proc || !unattributed.conections || !unattributed.name )
+    goto ERROR;
 
   ht_process = hashtable_new ( ht_cb_hash, ht_cb_compare, free_process );
   if ( !ht_process )
-    {
-      free ( procs );
-      return NULL;
-    }
+    goto ERROR;
+
+  ht_scan = hashtable_new ( ht_cb_hash, ht_cb_compare, free_scan );
+  scan_list = vector_new ( sizeof ( struct proc_scan * ) );
+  if ( !ht_scan || !scan_list )
+    goto ERROR;
+
+  pool_init ( &proc_pool, "processes", sizeof ( process_t ), 0 );
+  pool_init ( &scan_pool, "scans", sizeof ( struct proc_scan ), 0 );
+
+  process_t *proc = &unattributed;
+  vector_push ( procs->proc, &proc );
+  procs->total = 1;
 
   return procs;
+
+ERROR:
+  if ( procs->proc )
+    vector_free ( procs->proc );
+
+  if ( unattributed.conections )
+    vector_free ( unattributed.conections );
+
+  unattributed.conections = NULL;
+  intern_put ( unattributed.name );
+  unattributed.name = NULL;
+  free ( procs );
+  return NULL;
 }
 
 static int
 remove_dead_proc ( UNUSED hashtable_t *ht, void *value, UNUSED void *user_data )
 {
   process_t *proc = value;
-  if ( !proc->active )
+
+  // process in list leave it in next scan
+  if ( !proc->active && !proc->listed )
     {
       free_process ( proc );
       return 1;
@@ -178,114 +359,1195 @@ remove_dead_proc ( UNUSED hashtable_t *ht, void *value, UNUSED void *user_data )
   return 0;
 }
 
-/*
- percorre todos os processos encontrados no diretório '/proc/',
- em cada processo encontrado armazena todos os file descriptors
- do processo - /proc/$id/fd - no buffer fds
- depois compara o link simbolico apontado pelo FD com 'socket:[inode]',
- sendo inode coletado do arquivo '/proc/net/tcp', caso a comparação seja igual,
- encontramos o processo que corresponde ao inode (conexão).
-*/
-int
-processes_update ( struct processes *procs, struct config_op *co )
+static int
+remove_dead_scan ( UNUSED hashtable_t *ht, void *value, UNUSED void *user_data )
 {
-  if ( !connection_update ( co->proto ) )
-    return 0;
+  struct proc_scan *scan = value;
+  if ( !scan->active )
+    {
+      free_scan ( scan );
+      return 1;
+    }
 
-  // TODO: check if type uint32_t is correct/safe
-  uint32_t *pids = NULL;
-  int total_process = get_numeric_directory ( &pids, "/proc/" );
+  scan->active = false;
+  return 0;
+}
 
-  if ( -1 == total_process )
-    return 0;
+// remove 'conn' of list of your process, without keep the owner
+static void
+unlink_conn ( connection_t *conn )
+{
+  process_t *proc = conn->proc;
 
-  hashtable_foreach_remove ( ht_process, remove_dead_proc, NULL );
-  vector_clear ( procs->proc );
+  if ( conn->proc_prev )
+    conn->proc_prev->proc_next = conn->proc_next;
+  else
+    proc->conns = conn->proc_next;
 
-  uint32_t *fds = NULL;
-  for ( int i = 0; i < total_process; i++ )
+  if ( conn->proc_next )
+    conn->proc_next->proc_prev = conn->proc_prev;
+
+  conn->proc_prev = conn->proc_next = NULL;
+  conn->proc = NULL;
+
+  proc->total_members--;
+
+  // 'conections' has the connection, it is rebuilt (see sync_conections)
+  proc->conns_changed = true;
+}
+
+static void
+detach_conn ( connection_t *conn )
+{
+  connection_keep_owner ( conn );
+  unlink_conn ( conn );
+}
+
+/* connection is of 'proc', leaving the process of last update. only the
+   connections that leave a process rebuild your array of connections */
+static void
+attach_conn ( process_t *proc, connection_t *conn )
+{
+  if ( conn->proc == proc )
+    return;
+
+  if ( conn->proc )
+    detach_conn ( conn );
+
+  conn->proc = proc;
+  conn->proc_prev = NULL;
+  conn->proc_next = proc->conns;
+  if ( proc->conns )
+    proc->conns->proc_prev = conn;
+
+  proc->conns = conn;
+  proc->total_members++;
+
+  if ( !proc->conns_changed && !vector_push ( proc->conections, &conn ) )
+    proc->conns_changed = true;
+
+  proc->total_conections = vector_size ( proc->conections );
+}
+
+static void
+detach_all ( process_t *proc )
+{
+  while ( proc->conns )
+    detach_conn ( proc->conns );
+
+  vector_clear ( proc->conections );
+  proc->total_conections = 0;
+  proc->conns_changed = false;
+}
+
+// process enter in list of processes, at end, if not already in it
+static void
+list_add ( struct processes *procs, process_t *proc )
+{
+  proc->active = true;
+
+  if ( proc->listed || !vector_push ( procs->proc, &proc ) )
+    return;
+
+  proc->listed = true;
+  procs->total = vector_size ( procs->proc );
+}
+
+// process found in actual scan
+static void
+confirm_process ( struct processes *procs, process_t *proc )
+{
+  if ( proc->scan_gen != scan_gen )
     {
-      char path_fd[MAX_PATH_FD];
-      pid_t pid = pids[i];
+      proc->scan_gen = scan_gen;
+      proc->seen = 0;
+    }
 
-      int ret_sn =
-              snprintf ( path_fd, sizeof ( path_fd ), "/proc/%d/fd/", pid );
+  list_add ( procs, proc );
+}
 
-      int total_fd_process = get_numeric_directory ( &fds, path_fd );
+// array of connections of processes that some connection left
+static void
+sync_conections ( struct processes *procs )
+{
+  for ( size_t i = 0; i < vector_size ( procs->proc ); i++ )
+    {
+      process_t *proc = procs->proc[i];
 
-      if ( -1 == total_fd_process )
+      if ( !proc->conns_changed )
         continue;
 
-      process_t *proc = hashtable_get ( ht_process, &pid );
+      vector_clear ( proc->conections );
 
-      if ( proc )
+      // process that closed most of connections
+      if ( vector_capacity ( proc->conections ) >
+           SHRINK_FACTOR * proc->total_members )
+        vector_shrink ( proc->conections );
+
+      bool ok = true;
+      for ( connection_t *conn = proc->conns; ok && conn;
+            conn = conn->proc_next )
+        ok = vector_push ( proc->conections, &conn );
+
+      proc->conns_changed = !ok;
+      proc->total_conections = vector_size ( proc->conections );
+    }
+}
+
+/* after a scan, processes not found leave the list and the connections not
+   found leave your process. the others processes stay in same position, so
+   the sort start of order of last refresh */
+static void
+drop_stale ( struct processes *procs )
+{
+  size_t size = vector_size ( procs->proc );
+  size_t total = 0;
+
+  for ( size_t i = 0; i < size; i++ )
+    {
+      process_t *proc = procs->proc[i];
+
+      if ( proc != &unattributed && proc->scan_gen != scan_gen )
         {
-          proc->active = true;
-          vector_clear ( proc->conections );
+          detach_all ( proc );
+          proc->listed = false;
+          continue;
         }
 
-      for ( int j = 0; j < total_fd_process; j++ )
+      // sockets closed or passed to other process, sub-flows not are in
+      // fds, they follow your socket (see attach_subflow)
+      if ( proc->seen < proc->total_members )
         {
-          // concat "/proc/<pid>/fd/%d"
-          snprintf ( path_fd + ret_sn,
-                     sizeof ( path_fd ) - ret_sn,
-                     "%d",
-                     fds[j] );
+          connection_t *next;
+          for ( connection_t *conn = proc->conns; conn; conn = next )
+            {
+              next = conn->proc_next;
 
-          char data_fd[MAX_NAME_SOCKET];
-          ssize_t len_link =
-                  readlink ( path_fd, data_fd, sizeof ( data_fd ) - 1 );
+              if ( !conn->subflow && conn->scan_gen != scan_gen )
+                detach_conn ( conn );
+            }
+        }
 
-          if ( len_link == -1 )
-            continue;
+      procs->proc[total++] = proc;
+    }
 
-          data_fd[len_link] = '\0';
+  while ( vector_size ( procs->proc ) > total )
+    vector_pop ( procs->proc );
 
-          unsigned long int inode;
-          if ( 1 != sscanf ( data_fd, "socket:[%lu", &inode ) )
-            continue;
+  procs->total = total;
 
-          connection_t *conn = connection_get_by_inode ( inode );
+  sync_conections ( procs );
+}
 
-          if ( !conn )
-            continue;
+// sub-flows not are in /proc/<pid>/fd/, are of process of your socket
+static void
+attach_subflow ( connection_t *conn, UNUSED void *user_data )
+{
+  if ( !conn->subflow )
+    return;
 
-          if ( !proc )
-            {
-              proc = create_new_process ( pid );
-              if ( !proc )
-                break;  // no return error, check others processes
+  connection_t *parent = connection_parent ( conn );
+  process_t *proc = ( parent ) ? parent->proc : NULL;
 
-              hashtable_set ( ht_process, &proc->pid, proc );
-            }
+  if ( proc )
+    attach_conn ( proc, conn );
+  else if ( conn->proc )
+    detach_conn ( conn );
+}
+
+/* connection_update measured by self profiling, the connections freed
+   leave the array of connections of your process */
+static bool
+update_connections ( struct processes *procs, const int proto )
+{
+  PROBE ( connection_update_start );
+
+  uint64_t start = profile_start ();
+  bool ret = connection_update ( proto );
+  profile_end ( PHASE_CONNECTION_UPDATE, start );
+
+  sync_conections ( procs );
+
+  PROBE1 ( connection_update_end, ret );
+
+  return ret;
+}
+
+// inode of socket pointed by fd of "/proc/<pid>/fd/", 0 if not is a socket
+static unsigned long
+read_socket_inode ( char *path_fd, int len_path, size_t size, uint32_t fd )
+{
+  // concat "/proc/<pid>/fd/%d"
+  snprintf ( path_fd + len_path, size - len_path, "%u", fd );
+
+  char data_fd[MAX_NAME_SOCKET];
+  ssize_t len_link = readlink ( path_fd, data_fd, sizeof ( data_fd ) - 1 );
+
+  if ( len_link == -1 )
+    return 0;
+
+  data_fd[len_link] = '\0';
+
+  unsigned long int inode;
+  if ( 1 != sscanf ( data_fd, "socket:[%lu", &inode ) )
+    return 0;
+
+  return inode;
+}
+
+static int
+cmp_fd ( const void *a, const void *b )
+{
+  uint32_t fd1 = *( const uint32_t * ) a;
+  uint32_t fd2 = *( const uint32_t * ) b;
+
+  return ( fd1 > fd2 ) - ( fd1 < fd2 );
+}
+
+static bool
+same_fds ( const struct proc_scan *scan, const uint32_t *fds, uint32_t total )
+{
+  if ( scan->total_fds != total )
+    return false;
+
+  for ( uint32_t i = 0; i < total; i++ )
+    {
+      if ( scan->fds[i].fd != fds[i] )
+        return false;
+    }
+
+  return true;
+}
+
+/* update 'scan' with fds in /proc/<pid>/fd/, with 'full' false readlink is
+   done only in fds new or that were a connection already closed (fd can be
+   reused by a new socket). 'reused' is incremented with the fds that kept
+   the inode of last scan */
+static bool
+scan_fds ( struct proc_scan *scan,
+           struct numeric_dir *fds,
+           bool full,
+           size_t *reused )
+{
+  char path_fd[MAX_PATH_FD];
+  int ret_sn = snprintf (
+          path_fd, sizeof ( path_fd ), "%s/%d/fd/", proc_root (), scan->pid );
 
-          conn->proc = proc;
-          vector_push ( proc->conections, &conn );
+  int total = get_numeric_directory ( fds, path_fd );
+  if ( -1 == total )
+    return false;
+
+  // procfs already list the fds in order
+  for ( int i = 1; i < total; i++ )
+    {
+      if ( fds->values[i - 1] > fds->values[i] )
+        {
+          qsort ( fds->values, total, sizeof ( *fds->values ), cmp_fd );
+          break;
         }
+    }
 
-      if ( proc )
+  // if fds are the same of last scan the inodes are updated in place
+  struct fd_inode *old = scan->fds;
+  struct fd_inode *new = old;
+  if ( !same_fds ( scan, fds->values, total ) )
+    {
+      new = malloc ( total * sizeof ( *new ) );
+      if ( !new && total )
+        return false;
+    }
+
+  scan->sockets = 0;
+  for ( uint32_t i = 0, k = 0; i < ( uint32_t ) total; i++ )
+    {
+      uint32_t fd = fds->values[i];
+
+      while ( k < scan->total_fds && old[k].fd < fd )
+        k++;
+
+      connection_t *conn;
+      if ( !full && k < scan->total_fds && old[k].fd == fd &&
+           ( !old[k].conn ||
+             ( ( conn = connection_get_by_inode ( old[k].inode ) ) &&
+               connection_active ( conn ) ) ) )
+        {
+          new[i] = old[k];
+          ( *reused )++;
+        }
+      else
         {
-          proc->total_conections = vector_size ( proc->conections );
-          vector_push ( procs->proc, &proc );
+          new[i].inode =
+                  read_socket_inode ( path_fd, ret_sn, sizeof ( path_fd ), fd );
+          new[i].fd = fd;
+          new[i].conn = false;
         }
+
+      if ( new[i].inode )
+        scan->sockets++;
     }
 
-  free ( fds );
-  free ( pids );
+  if ( new != old )
+    {
+      free ( old );
+      scan->fds = new;
+    }
 
-  procs->total = vector_size ( procs->proc );
+  scan->total_fds = total;
 
-  return 1;
+  return true;
 }
 
-void
-processes_free ( struct processes *processes )
+static struct proc_scan *
+get_scan ( pid_t pid )
 {
-  if ( !processes )
+  struct proc_scan *scan = hashtable_get ( ht_scan, &pid );
+
+  if ( !scan )
+    {
+      scan = pool_calloc ( &scan_pool );
+      if ( !scan )
+        return NULL;
+
+      scan->pid = pid;
+      if ( !hashtable_set ( ht_scan, &scan->pid, scan ) )
+        {
+          pool_free ( &scan_pool, scan );
+          return NULL;
+        }
+
+      // namespace of process not change, except by setns (rare)
+      scan->netns = netns_get ( pid );
+    }
+
+  scan->active = true;
+
+  return scan;
+}
+
+static void
+scan_job_put ( struct scan_job *job )
+{
+  if ( __atomic_sub_fetch ( &job->refs, 1, __ATOMIC_ACQ_REL ) )
     return;
 
-  // free ( processes->proc );
-  vector_free ( processes->proc );
-  free ( processes );
-  hashtable_destroy ( ht_process );
+  pthread_mutex_destroy ( &job->mutex );
+  pthread_cond_destroy ( &job->cond );
+  free ( job );
+}
+
+// read blocks of processes until all were taken
+static void
+scan_job_run ( struct scan_job *job, struct numeric_dir *reader )
+{
+  size_t reused = 0;
+  unsigned int done = 0;
+  unsigned int first;
+
+  while ( ( first = __atomic_fetch_add (
+                    &job->next, SCAN_BLOCK, __ATOMIC_RELAXED ) ) < job->total )
+    {
+      unsigned int last = MIN ( first + SCAN_BLOCK, job->total );
+
+      for ( unsigned int i = first; i < last; i++ )
+        job->scans[i]->read =
+                scan_fds ( job->scans[i], reader, job->full, &reused );
+
+      done += last - first;
+    }
+
+  if ( !done )
+    return;
+
+  __atomic_add_fetch ( &job->reused, reused, __ATOMIC_RELAXED );
+
+  pthread_mutex_lock ( &job->mutex );
+  job->done += done;
+  if ( job->done == job->total )
+    pthread_cond_signal ( &job->cond );
+  pthread_mutex_unlock ( &job->mutex );
+}
+
+static void
+scan_task ( void *arg )
+{
+  struct scan_job *job = arg;
+
+  unsigned int id = __atomic_add_fetch ( &job->threads, 1, __ATOMIC_RELAXED );
+  scan_job_run ( job, &dir_fds[id] );
+
+  scan_job_put ( job );
+}
+
+// thread pool is started only in the first scan with many processes
+static void
+scan_threads_init ( void )
+{
+  if ( scan_threads_started )
+    return;
+
+  scan_threads_started = true;
+
+  int cpus = get_count_cpu ();
+  if ( cpus > 1 && thpool_init ( 0 ) )
+    scan_threads = MIN ( cpus - 1, SCAN_MAX_THREADS );
+}
+
+/* read fds of all processes of 'scans' (see scan_fds), with many processes
+   the reading is divided between main thread and thread pool */
+static void
+read_scans ( struct proc_scan **scans,
+             unsigned int total,
+             bool full,
+             size_t *reused )
+{
+  if ( total >= SCAN_PARALLEL_MIN )
+    scan_threads_init ();
+
+  unsigned int tasks = MIN ( scan_threads, total / SCAN_BLOCK );
+  struct scan_job *job = NULL;
+
+  if ( total >= SCAN_PARALLEL_MIN && tasks )
+    job = calloc ( 1, sizeof ( *job ) );
+
+  if ( !job )
+    {
+      for ( unsigned int i = 0; i < total; i++ )
+        scans[i]->read = scan_fds ( scans[i], &dir_fds[0], full, reused );
+
+      return;
+    }
+
+  pthread_mutex_init ( &job->mutex, NULL );
+  pthread_cond_init ( &job->cond, NULL );
+  job->scans = scans;
+  job->total = total;
+  job->full = full;
+  job->refs = tasks + 1;
+
+  for ( unsigned int i = 0; i < tasks; i++ )
+    {
+      if ( !add_task ( scan_task, job ) )
+        __atomic_sub_fetch ( &job->refs, 1, __ATOMIC_RELAXED );
+    }
+
+  // main thread also read, so tasks delayed in queue not delay the scan
+  scan_job_run ( job, &dir_fds[0] );
+
+  pthread_mutex_lock ( &job->mutex );
+  while ( job->done < job->total )
+    pthread_cond_wait ( &job->cond, &job->mutex );
+  pthread_mutex_unlock ( &job->mutex );
+
+  *reused += __atomic_load_n ( &job->reused, __ATOMIC_RELAXED );
+
+  scan_job_put ( job );
+}
+
+// process of scan has a socket of a connection known
+static bool
+has_connection ( const struct proc_scan *scan )
+{
+  for ( uint32_t j = 0; scan->sockets && j < scan->total_fds; j++ )
+    {
+      if ( scan->fds[j].inode &&
+           connection_get_by_inode ( scan->fds[j].inode ) )
+        return true;
+    }
+
+  return false;
+}
+
+static bool
+names_ring_start ( void )
+{
+  if ( !names_ring_state )
+    names_ring_state = uring_init ( &names_ring, NAMES_BATCH ) ? 1 : -1;
+
+  return names_ring_state == 1;
+}
+
+/* names of processes that will be created in this scan, by index of
+   'scans', read in batch. NULL without io_uring or with few new processes,
+   so they are read one by one in create_new_process. names not found are
+   NULL, the array is released by names_put */
+static const char **
+read_new_names ( struct proc_scan **scans, unsigned int total )
+{
+  if ( names_ring_state == -1 )
+    return NULL;
+
+  unsigned int *news = arena_alloc ( &scan_arena, total * sizeof ( *news ) );
+  if ( !news )
+    return NULL;
+
+  unsigned int total_news = 0;
+  for ( unsigned int i = 0; i < total; i++ )
+    {
+      if ( scans[i]->read && !hashtable_get ( ht_process, &scans[i]->pid ) &&
+           has_connection ( scans[i] ) )
+        news[total_news++] = i;
+    }
+
+  if ( total_news < NAMES_MIN || !names_ring_start () )
+    return NULL;
+
+  const char **paths =
+          arena_alloc ( &scan_arena, total_news * sizeof ( *paths ) );
+  char **bufs = arena_alloc ( &scan_arena, total_news * sizeof ( *bufs ) );
+  ssize_t *lens = arena_alloc ( &scan_arena, total_news * sizeof ( *lens ) );
+  const char **names = arena_alloc ( &scan_arena, total * sizeof ( *names ) );
+  char *mem = arena_alloc ( &scan_arena,
+                            total_news * ( MAX_CMDLINE + SIZE_CMDLINE ) );
+  if ( !paths || !bufs || !lens || !names || !mem )
+    return NULL;
+
+  for ( unsigned int k = 0; k < total_news; k++ )
+    {
+      char *path = mem + k * ( MAX_CMDLINE + SIZE_CMDLINE );
+
+      snprintf ( path,
+                 MAX_CMDLINE,
+                 "%s/%d/cmdline",
+                 proc_root (),
+                 scans[news[k]]->pid );
+      paths[k] = path;
+      bufs[k] = path + MAX_CMDLINE;
+    }
+
+  if ( !uring_read_files ( &names_ring,
+                          paths,
+                          bufs,
+                          SIZE_CMDLINE,
+                          lens,
+                          total_news ) )
+    {
+      // ring not more used, names are read one by one
+      uring_free ( &names_ring );
+      names_ring_state = -1;
+      return NULL;
+    }
+
+  memset ( names, 0, total * sizeof ( *names ) );
+
+  // long names, maybe truncated, are read again in create_new_process
+  for ( unsigned int k = 0; k < total_news; k++ )
+    {
+      if ( lens[k] > 0 && lens[k] < SIZE_CMDLINE )
+        set_name_process ( &names[news[k]], bufs[k], lens[k] );
+    }
+
+  return names;
+}
+
+// names not used by processes created are freed
+static void
+names_put ( const char **names, unsigned int total )
+{
+  for ( unsigned int i = 0; names && i < total; i++ )
+    intern_put ( names[i] );
+}
+
+/*
+ percorre todos os processos encontrados no diretório '/proc/',
+ em cada processo encontrado armazena todos os file descriptors
+ do processo - /proc/$id/fd - no buffer fds
+ depois compara o link simbolico apontado pelo FD com 'socket:[inode]',
+ sendo inode coletado do arquivo '/proc/net/tcp', caso a comparação seja igual,
+ encontramos o processo que corresponde ao inode (conexão).
+*/
+static void
+scan_processes ( struct processes *procs, bool full, size_t *reused )
+{
+  scan_gen++;
+
+  unsigned int total_scans = vector_size ( scan_list );
+  read_scans ( scan_list, total_scans, full, reused );
+
+  const char **names = read_new_names ( scan_list, total_scans );
+
+  // processes and connections are updated only by main thread
+  for ( unsigned int i = 0; i < total_scans; i++ )
+    {
+      struct proc_scan *scan = scan_list[i];
+      pid_t pid = scan->pid;
+
+      if ( !scan->read )
+        continue;
+
+      process_t *proc = hashtable_get ( ht_process, &pid );
+
+      if ( proc )
+        confirm_process ( procs, proc );
+
+      // processes without sockets not are read
+      for ( uint32_t j = 0; scan->sockets && j < scan->total_fds; j++ )
+        {
+          struct fd_inode *fd = &scan->fds[j];
+
+          if ( !fd->inode )
+            continue;
+
+          connection_t *conn = connection_get_by_inode ( fd->inode );
+          fd->conn = !!conn;
+
+          // socket shared by processes is of first found
+          if ( !conn || conn->scan_gen == scan_gen )
+            continue;
+
+          if ( !proc )
+            {
+              proc = create_new_process ( pid, names ? names[i] : NULL );
+              if ( !proc )
+                break;  // no return error, check others processes
+
+              hashtable_set ( ht_process, &proc->pid, proc );
+
+              // connections are at most the sockets
+              vector_reserve ( proc->conections, scan->sockets );
+              confirm_process ( procs, proc );
+            }
+
+          // connections already of process not change
+          conn->scan_gen = scan_gen;
+          proc->seen++;
+          attach_conn ( proc, conn );
+        }
+    }
+
+  names_put ( names, total_scans );
+
+  drop_stale ( procs );
+}
+
+// new socket without process, can be in a fd reused
+static void
+check_unowned ( connection_t *conn, void *user_data )
+{
+  if ( !conn->proc && conn->inode && !conn->unowned &&
+       connection_active ( conn ) )
+    *( bool * ) user_data = true;
+}
+
+static void
+mark_unowned ( connection_t *conn, UNUSED void *user_data )
+{
+  conn->unowned = !conn->proc;
+}
+
+static int
+update_all_processes ( struct processes *procs, struct config_op *co )
+{
+  if ( !update_connections ( procs, co->proto ) )
+    return 0;
+
+  // TODO: check if type uint32_t is correct/safe
+  int total_process = get_numeric_directory ( &dir_pids, proc_root () );
+
+  if ( -1 == total_process )
+    return 0;
+
+  hashtable_foreach_remove ( ht_process, remove_dead_proc, NULL );
+  hashtable_foreach_remove ( ht_scan, remove_dead_scan, NULL );
+
+  vector_clear ( scan_list );
+  vector_reserve ( scan_list, total_process );
+  for ( int i = 0; i < total_process; i++ )
+    {
+      struct proc_scan *scan = get_scan ( dir_pids.values[i] );
+
+      if ( scan )
+        vector_push ( scan_list, &scan );
+    }
+
+  size_t reused = 0;
+  scan_processes ( procs, false, &reused );
+
+  // sockets of namespaces of new processes (containers) were not in
+  // update of connections, fds already read are reused
+  if ( netns_pending () && connection_update_netns ( co->proto ) )
+    scan_processes ( procs, false, &reused );
+
+  // a fd closed and reopened with a new socket between two scans keeps the
+  // old inode, so if a new connection was not found all fds are read again
+  bool unowned = false;
+  if ( reused )
+    connection_foreach ( check_unowned, &unowned );
+
+  if ( unowned )
+    scan_processes ( procs, true, &reused );
+
+  connection_foreach ( mark_unowned, NULL );
+
+  connection_foreach ( attach_subflow, NULL );
+  sync_conections ( procs );
+
+  arena_reset ( &scan_arena );
+
+  return 1;
+}
+
+int
+processes_update ( struct processes *procs, struct config_op *co )
+{
+  PROBE ( processes_update_start );
+
+  int ret = update_all_processes ( procs, co );
+
+  PROBE2 ( processes_update_end, ret, procs->total );
+
+  return ret;
+}
+
+int
+processes_update_owners ( struct processes *procs,
+                          struct config_op *co,
+                          const struct sock_owner *owners,
+                          size_t total_owners )
+{
+  // connections closed are freed here
+  if ( !update_connections ( procs, co->proto ) )
+    return 0;
+
+  for ( size_t i = 0; i < total_owners; i++ )
+    {
+      connection_t *conn =
+              connection_get_by_tuple ( ( struct tuple * ) &owners[i].tuple );
+
+      if ( !conn || conn->proc )
+        continue;
+
+      pid_t pid = owners[i].pid;
+      process_t *proc = hashtable_get ( ht_process, &pid );
+
+      if ( !proc )
+        {
+          proc = create_new_process ( pid, NULL );
+          if ( !proc )
+            continue;  // process already closed
+
+          hashtable_set ( ht_process, &proc->pid, proc );
+        }
+
+      list_add ( procs, proc );
+      attach_conn ( proc, conn );
+    }
+
+  // connections that left other process
+  sync_conections ( procs );
+
+  arena_reset ( &scan_arena );
+
+  return 1;
+}
+
+int
+processes_update_fds ( struct processes *procs,
+                       struct config_op *co,
+                       const struct sock_fd *fds,
+                       size_t total_fds )
+{
+  if ( !update_connections ( procs, co->proto ) )
+    return 0;
+
+  hashtable_foreach_remove ( ht_process, remove_dead_proc, NULL );
+
+  scan_gen++;
+
+  for ( size_t i = 0; i < total_fds; i++ )
+    {
+      connection_t *conn = connection_get_by_inode ( fds[i].inode );
+
+      // socket shared by processes is of first found, as in scan
+      if ( !conn || conn->scan_gen == scan_gen )
+        continue;
+
+      pid_t pid = fds[i].pid;
+      process_t *proc = hashtable_get ( ht_process, &pid );
+
+      if ( !proc )
+        {
+          proc = create_new_process ( pid, NULL );
+          if ( !proc )
+            continue;  // process already closed
+
+          hashtable_set ( ht_process, &proc->pid, proc );
+        }
+
+      // first socket of process in this update
+      confirm_process ( procs, proc );
+
+      conn->scan_gen = scan_gen;
+      proc->seen++;
+      attach_conn ( proc, conn );
+    }
+
+  drop_stale ( procs );
+
+  connection_foreach ( mark_unowned, NULL );
+
+  connection_foreach ( attach_subflow, NULL );
+  sync_conections ( procs );
+
+  arena_reset ( &scan_arena );
+
+  return 1;
+}
+
+/* search in fds of process 'pid' the sockets of connections 'pending',
+   the found are associated to process and removed of 'pending'.
+   return the process, that is created if 'proc' is NULL and any socket
+   was found */
+static process_t *
+find_pending ( struct processes *procs,
+               process_t *proc,
+               pid_t pid,
+               connection_t **pending,
+               size_t *total_pending,
+               struct numeric_dir *fds )
+{
+  char path_fd[MAX_PATH_FD];
+  int ret_sn = snprintf (
+          path_fd, sizeof ( path_fd ), "%s/%d/fd/", proc_root (), pid );
+
+  int total_fd_process = get_numeric_directory ( fds, path_fd );
+
+  for ( int j = 0; *total_pending && j < total_fd_process; j++ )
+    {
+      unsigned long int inode = read_socket_inode (
+              path_fd, ret_sn, sizeof ( path_fd ), fds->values[j] );
+
+      if ( !inode )
+        continue;
+
+      for ( size_t k = 0; k < *total_pending; k++ )
+        {
+          if ( pending[k]->inode != inode )
+            continue;
+
+          if ( !proc )
+            {
+              proc = create_new_process ( pid, NULL );
+              if ( !proc )
+                return NULL;  // process already closed
+
+              hashtable_set ( ht_process, &proc->pid, proc );
+            }
+
+          list_add ( procs, proc );
+          attach_conn ( proc, pending[k] );
+
+          pending[k] = pending[--*total_pending];
+          break;
+        }
+    }
+
+  return proc;
+}
+
+int
+processes_update_tuples ( struct processes *procs,
+                          const struct tuple *tuples,
+                          size_t total_tuples )
+{
+  connection_t **pending =
+          arena_alloc ( &scan_arena, total_tuples * sizeof ( *pending ) );
+  if ( !pending )
+    return 0;
+
+  int ret = 0;
+  size_t total_pending = 0;
+  for ( size_t i = 0; i < total_tuples; i++ )
+    {
+      if ( !connection_can_lookup ( &tuples[i] ) )
+        goto EXIT;
+
+      connection_t *conn =
+              connection_get_by_tuple ( ( struct tuple * ) &tuples[i] );
+
+      if ( !conn )
+        conn = connection_lookup ( &tuples[i] );
+
+      // same connection can be reached by more than one tuple
+      if ( !conn || conn->proc )
+        continue;
+
+      size_t j;
+      for ( j = 0; j < total_pending && pending[j] != conn; j++ )
+        ;
+
+      if ( j == total_pending )
+        pending[total_pending++] = conn;
+    }
+
+  // new connections are most likely of processes already known
+  for ( size_t i = 0; total_pending && i < procs->total; i++ )
+    find_pending ( procs,
+                   procs->proc[i],
+                   procs->proc[i]->pid,
+                   pending,
+                   &total_pending,
+                   &dir_fds[0] );
+
+  if ( total_pending )
+    {
+      int total_process = get_numeric_directory ( &dir_pids, proc_root () );
+
+      for ( int i = 0; total_pending && i < total_process; i++ )
+        {
+          pid_t pid = dir_pids.values[i];
+
+          if ( !hashtable_get ( ht_process, &pid ) )
+            find_pending (
+                    procs, NULL, pid, pending, &total_pending, &dir_fds[0] );
+        }
+    }
+
+  ret = 1;
+
+EXIT:
+  sync_conections ( procs );
+  arena_reset ( &scan_arena );
+  return ret;
+}
+
+// process closed, removed without wait the next scan of /proc/
+static void
+remove_process ( struct processes *procs, pid_t pid )
+{
+  struct proc_scan *scan = hashtable_remove ( ht_scan, &pid );
+  if ( scan )
+    free_scan ( scan );
+
+  process_t *proc = hashtable_remove ( ht_process, &pid );
+  if ( !proc )
+    return;
+
+  // others processes keep the order of last sort
+  size_t total = vector_size ( procs->proc );
+  for ( size_t i = 0; proc->listed && i < total; i++ )
+    {
+      if ( procs->proc[i] != proc )
+        continue;
+
+      memmove ( &procs->proc[i],
+                &procs->proc[i + 1],
+                ( total - i - 1 ) * sizeof ( *procs->proc ) );
+      vector_pop ( procs->proc );
+      break;
+    }
+
+  procs->total = vector_size ( procs->proc );
+  free_process ( proc );
+}
+
+// after exec the process has other name
+static void
+rename_process ( pid_t pid )
+{
+  process_t *proc = hashtable_get ( ht_process, &pid );
+  if ( !proc )
+    return;
+
+  const char *name;
+  if ( -1 == get_name_process ( &name, pid ) )
+    return;
+
+  intern_put ( proc->name );
+  proc->name = name;
+
+  // traffic before of exec is kept in old row
+  aggregate_leave ( proc );
+  proc->group = aggregate_join ( proc );
+}
+
+/* read fds of new process, sockets already associated are kept in
+   other process (a child share the sockets of parent) */
+static void
+scan_new_process ( struct processes *procs, pid_t pid )
+{
+  struct proc_scan *scan = get_scan ( pid );
+  size_t reused = 0;
+
+  if ( !scan || !scan_fds ( scan, &dir_fds[0], false, &reused ) )
+    return;
+
+  process_t *proc = hashtable_get ( ht_process, &pid );
+
+  for ( uint32_t j = 0; scan->sockets && j < scan->total_fds; j++ )
+    {
+      struct fd_inode *fd = &scan->fds[j];
+
+      if ( !fd->inode )
+        continue;
+
+      connection_t *conn = connection_get_by_inode ( fd->inode );
+      fd->conn = !!conn;
+
+      if ( !conn || conn->proc )
+        continue;
+
+      if ( !proc )
+        {
+          proc = create_new_process ( pid, NULL );
+          if ( !proc )
+            return;  // process already closed
+
+          hashtable_set ( ht_process, &proc->pid, proc );
+        }
+
+      list_add ( procs, proc );
+      attach_conn ( proc, conn );
+    }
+}
+
+void
+processes_update_events ( struct processes *procs,
+                          const struct process_event *events,
+                          size_t total_events )
+{
+  for ( size_t i = 0; i < total_events; i++ )
+    {
+      switch ( events[i].type )
+        {
+          case PROCESS_EXIT:
+            remove_process ( procs, events[i].pid );
+            break;
+          case PROCESS_EXEC:
+            rename_process ( events[i].pid );
+            FALLTHROUGH;
+          case PROCESS_NEW:
+            scan_new_process ( procs, events[i].pid );
+            break;
+        }
+    }
+
+  sync_conections ( procs );
+
+  arena_reset ( &scan_arena );
+}
+
+static int
+leave_row ( UNUSED hashtable_t *ht, void *value, UNUSED void *user_data )
+{
+  process_t *proc = value;
+  proc->group = NULL;
+
+  return 0;
+}
+
+static int
+join_row ( UNUSED hashtable_t *ht, void *value, UNUSED void *user_data )
+{
+  process_t *proc = value;
+
+  proc->group = aggregate_join ( proc );
+  if ( !proc->group )
+    return 0;
+
+  rate_net_stat_merge ( &proc->group->net_stat, &proc->net_stat );
+
+  if ( proc->remotes &&
+       ( proc->group->remotes || ( proc->group->remotes = topk_new () ) ) )
+    topk_merge ( proc->group->remotes, proc->remotes );
+
+  if ( proc->sizes &&
+       ( proc->group->sizes || ( proc->group->sizes = pktsize_new () ) ) )
+    pktsize_merge ( proc->group->sizes, proc->sizes );
+
+  return 0;
+}
+
+bool
+processes_aggregate ( int mode )
+{
+  // rows are freed by reset
+  hashtable_foreach ( ht_process, leave_row, NULL );
+  unattributed.group = NULL;
+
+  if ( !aggregate_reset ( mode ) )
+    return false;
+
+  join_row ( NULL, &unattributed, NULL );
+  hashtable_foreach ( ht_process, join_row, NULL );
+
+  return true;
+}
+
+void
+processes_add_connection ( process_t *proc, connection_t *conn )
+{
+  attach_conn ( proc, conn );
+}
+
+void
+processes_remove_connection ( connection_t *conn )
+{
+  if ( conn->proc )
+    unlink_conn ( conn );
+}
+
+process_t *
+processes_unattributed ( void )
+{
+  return &unattributed;
+}
+
+size_t
+processes_memory ( void )
+{
+  return proc_pool.used * proc_pool.obj_size +
+         scan_pool.used * scan_pool.obj_size + topk_memory () +
+         pktsize_memory ();
+}
+
+void
+processes_trim ( struct processes *procs )
+{
+  for ( size_t i = 0; i < procs->total; i++ )
+    {
+      if ( procs->proc[i]->conections )
+        vector_shrink ( procs->proc[i]->conections );
+    }
+
+  vector_shrink ( procs->proc );
+  arena_free ( &scan_arena );
+}
+
+void
+processes_free ( struct processes *processes )
+{
+  if ( !processes )
+    return;
+
+  // free ( processes->proc );
+  vector_free ( processes->proc );
+  free ( processes );
+  hashtable_destroy ( ht_process );
+  hashtable_destroy ( ht_scan );
+  pool_destroy ( &proc_pool );
+  pool_destroy ( &scan_pool );
+  vector_free ( scan_list );
+  numeric_dir_free ( &dir_pids );
+
+  if ( scan_threads )
+    thpool_free ();
+
+  for ( size_t i = 0; i < ARRAY_SIZE ( dir_fds ); i++ )
+    numeric_dir_free ( &dir_fds[i] );
+
+  arena_free ( &scan_arena );
+  uring_free ( &names_ring );
+  names_ring_state = 0;
+
+  rate_net_stat_free ( &unattributed.net_stat );
+  pktsize_free ( unattributed.sizes );
+  unattributed.sizes = NULL;
+  vector_free ( unattributed.conections );
+  unattributed.conections = NULL;
+
+  aggregate_leave ( &unattributed );
+  aggregate_free ();
+
+  intern_put ( unattributed.name );
+  unattributed.name = NULL;
 }
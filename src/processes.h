@@ -27,18 +27,31 @@
 #include "connection.h"
 #include "directory.h"
 #include "rate.h"
+#include "topk.h"
+#include "pktsize.h"
 
 typedef struct process
 {
   struct net_stat net_stat;   // network statistics
-  connection_t **conections;  // connections of process
-  char *name;                 // process name
+  connection_t **conections;  // connections of process, view of 'conns'
+  connection_t *conns;        // list of connections, linked by proc_next
+  const char *name;           // process name, interned (see intern.h)
+  struct process *group;      // row of aggregated view, see aggregate.h
+  struct topk *remotes;       // remotes with most traffic, or NULL
+  struct pktsize *sizes;      // sizes of packets, or NULL
   pid_t pid;                  // process pid
   uint32_t total_conections;  // total process connections
+  uint32_t total_members;     // connections in 'conns'
+  uint32_t scan_gen;          // last scan that found the process
+  uint32_t seen;              // connections found in scan 'scan_gen'
 
   bool active;  // check if processes is active in update of processes
+  bool listed;  // in list of processes (struct processes)
+  bool conns_changed;  // a connection left 'conns', 'conections' is rebuilt
 } process_t;
 
+/* processes are kept between updates, in the order of last sort, only
+   the processes new and closed enter and leave the list */
 struct processes
 {
   process_t **proc;
@@ -51,6 +64,98 @@ processes_init ( void );
 int
 processes_update ( struct processes *procs, struct config_op *co );
 
+// owner of a socket, reported by eBPF (see ebpf/ebpf_sock.h)
+struct sock_owner
+{
+  struct tuple tuple;
+  pid_t pid;
+};
+
+/* same that processes_update, but the processes of new connections are
+   known, so is not necessary search in /proc/<pid>/fd/ of all processes.
+   connections without owner in 'owners' only are found by processes_update */
+int
+processes_update_owners ( struct processes *procs,
+                          struct config_op *co,
+                          const struct sock_owner *owners,
+                          size_t total_owners );
+
+// socket opened by a process, reported by eBPF (see ebpf/ebpf_fds.h)
+struct sock_fd
+{
+  uint32_t pid;
+  uint32_t fd;
+  uint64_t inode;
+};
+
+/* same that processes_update, with sockets of all processes already read
+   in 'fds', so /proc/<pid>/fd/ not is read */
+int
+processes_update_fds ( struct processes *procs,
+                       struct config_op *co,
+                       const struct sock_fd *fds,
+                       size_t total_fds );
+
+/* associate to processes only the connections of 'tuples' (packets without
+   process), each socket is looked up in kernel and the processes already
+   known are searched first, without update of all connections.
+   return 0 if the tuples can't be looked up, so is need processes_update */
+int
+processes_update_tuples ( struct processes *procs,
+                          const struct tuple *tuples,
+                          size_t total_tuples );
+
+// change of a process, reported by proc connector (see proc_events.h)
+enum process_event_type
+{
+  PROCESS_NEW,
+  PROCESS_EXEC,
+  PROCESS_EXIT
+};
+
+struct process_event
+{
+  pid_t pid;
+  uint8_t type;
+};
+
+/* update processes only by 'events', without scan of /proc/. processes
+   closed are removed, the name is read again after exec and only the fds
+   of new processes (or after exec) are read, to sockets without process.
+   sockets created by processes already known are found by others updates */
+void
+processes_update_events ( struct processes *procs,
+                          const struct process_event *events,
+                          size_t total_events );
+
+/* rows of all processes in view 'mode' (see aggregate.h), the traffic
+   already accounted to processes is added to rows.
+   return false on error, so view is disabled */
+bool
+processes_aggregate ( int mode );
+
+// add 'conn' to connections of 'proc', without update of processes
+void
+processes_add_connection ( process_t *proc, connection_t *conn );
+
+// remove 'conn' of connections of your process, before it is freed
+void
+processes_remove_connection ( connection_t *conn );
+
+/* process (pid 0) that receive the traffic of packets without process,
+   it is in list of processes, so is showed and saved as others */
+process_t *
+processes_unattributed ( void );
+
+// bytes in use of processes, of your remotes and sizes and of scans
+size_t
+processes_memory ( void );
+
+/* release space not used of vectors of connections of processes and the
+   buffers of scans */
+void
+processes_trim ( struct processes *procs );
+
 void
 processes_free ( struct processes *procs );
 
@@ -0,0 +1,223 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>  // clock_gettime
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>  // __rdtsc
+#endif
+
+#include "profile.h"
+#include "macro_util.h"
+
+static bool enabled = false;
+
+static struct phase_stats phases[TOTAL_PHASES];
+
+// updated by capture threads also
+static uint64_t cycles_total, packets_total;
+
+// values of counters at last refresh
+static uint64_t cycles_mark, packets_mark;
+static uint64_t cycles_packet_last;
+
+// start of netproc and time until first frame
+static uint64_t start_ns, first_frame_ns;
+
+static const char *const names[TOTAL_PHASES] = {
+  [PHASE_PROCESSES_UPDATE] = "processes_update",
+  [PHASE_CONNECTION_UPDATE] = "connection_update",
+  [PHASE_RATE_CALC] = "rate_calc",
+  [PHASE_SORT] = "sort",
+  [PHASE_TUI_SHOW] = "tui_show",
+};
+
+static uint64_t
+now_ns ( void )
+{
+  struct timespec ts;
+
+  clock_gettime ( CLOCK_MONOTONIC, &ts );
+
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+#define CYCLES_UNIT "cycles"
+#define read_cycles() __rdtsc ()
+#else
+#define CYCLES_UNIT "ns"
+#define read_cycles() now_ns ()
+#endif
+
+void
+profile_init ( bool enable )
+{
+  enabled = enable;
+
+  if ( enabled )
+    start_ns = now_ns ();
+}
+
+bool
+profile_enabled ( void )
+{
+  return enabled;
+}
+
+uint64_t
+profile_start ( void )
+{
+  return ( enabled ) ? now_ns () : 0;
+}
+
+void
+profile_end ( enum profile_phase phase, uint64_t start )
+{
+  if ( !enabled )
+    return;
+
+  struct phase_stats *ps = &phases[phase];
+  uint64_t elapsed = now_ns () - start;
+
+  ps->calls++;
+  ps->total_ns += elapsed;
+  ps->last_ns = elapsed;
+  ps->max_ns = MAX ( ps->max_ns, elapsed );
+}
+
+uint64_t
+profile_cycles_start ( void )
+{
+  return ( enabled ) ? read_cycles () : 0;
+}
+
+void
+profile_packets ( uint64_t start, uint64_t packets )
+{
+  if ( !enabled || !packets )
+    return;
+
+  uint64_t cycles = read_cycles () - start;
+
+  __atomic_fetch_add ( &cycles_total, cycles, __ATOMIC_RELAXED );
+  __atomic_fetch_add ( &packets_total, packets, __ATOMIC_RELAXED );
+}
+
+void
+profile_refresh ( void )
+{
+  if ( !enabled )
+    return;
+
+  uint64_t cycles = __atomic_load_n ( &cycles_total, __ATOMIC_RELAXED );
+  uint64_t packets = __atomic_load_n ( &packets_total, __ATOMIC_RELAXED );
+
+  cycles_packet_last = ( packets > packets_mark )
+                               ? ( cycles - cycles_mark ) /
+                                         ( packets - packets_mark )
+                               : 0;
+
+  cycles_mark = cycles;
+  packets_mark = packets;
+}
+
+const struct phase_stats *
+profile_phase ( enum profile_phase phase )
+{
+  return &phases[phase];
+}
+
+const char *
+profile_phase_name ( enum profile_phase phase )
+{
+  return names[phase];
+}
+
+uint64_t
+profile_cycles_packet ( bool total )
+{
+  if ( !total )
+    return cycles_packet_last;
+
+  uint64_t packets = __atomic_load_n ( &packets_total, __ATOMIC_RELAXED );
+
+  return ( packets ) ? __atomic_load_n ( &cycles_total, __ATOMIC_RELAXED ) /
+                               packets
+                     : 0;
+}
+
+void
+profile_first_frame ( void )
+{
+  if ( enabled && !first_frame_ns )
+    first_frame_ns = now_ns () - start_ns;
+}
+
+double
+profile_first_frame_ms ( void )
+{
+  return first_frame_ns / 1e6;
+}
+
+const char *
+profile_cycles_unit ( void )
+{
+  return CYCLES_UNIT;
+}
+
+void
+profile_dump ( FILE *file )
+{
+  if ( !enabled )
+    return;
+
+  fprintf ( file,
+            "%-18s %10s %12s %12s %12s\n",
+            "phase",
+            "calls",
+            "avg (us)",
+            "max (us)",
+            "total (ms)" );
+
+  for ( int i = 0; i < TOTAL_PHASES; i++ )
+    {
+      const struct phase_stats *ps = &phases[i];
+
+      fprintf ( file,
+                "%-18s %10lu %12.1f %12.1f %12.1f\n",
+                names[i],
+                ps->calls,
+                ( ps->calls ) ? ps->total_ns / 1e3 / ps->calls : 0.0,
+                ps->max_ns / 1e3,
+                ps->total_ns / 1e6 );
+    }
+
+  fprintf ( file,
+            "packets %lu, %lu %s per packet in parse and attribution\n",
+            __atomic_load_n ( &packets_total, __ATOMIC_RELAXED ),
+            profile_cycles_packet ( true ),
+            CYCLES_UNIT );
+
+  fprintf ( file, "first frame in %.1f ms\n", first_frame_ns / 1e6 );
+}
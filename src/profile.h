@@ -0,0 +1,104 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>  // FILE
+
+/* self profiling (option --self-stats), wall time of each call of main
+   phases of a refresh and cycles per packet spent in parse and attribution
+   of packets. when disabled all functions return without read the clock */
+
+enum profile_phase
+{
+  PHASE_PROCESSES_UPDATE,
+  PHASE_CONNECTION_UPDATE,
+  PHASE_RATE_CALC,
+  PHASE_SORT,
+  PHASE_TUI_SHOW,
+  TOTAL_PHASES
+};
+
+struct phase_stats
+{
+  uint64_t calls;
+  uint64_t total_ns;
+  uint64_t last_ns;  // time of last call
+  uint64_t max_ns;
+};
+
+void
+profile_init ( bool enable );
+
+bool
+profile_enabled ( void );
+
+// return time to profile_end, 0 if profiling is disabled
+uint64_t
+profile_start ( void );
+
+void
+profile_end ( enum profile_phase phase, uint64_t start );
+
+// return counter of cycles to profile_packets, 0 if profiling is disabled
+uint64_t
+profile_cycles_start ( void );
+
+/* account 'packets' processed since 'start', can be called
+   by capture threads */
+void
+profile_packets ( uint64_t start, uint64_t packets );
+
+/* close the interval of a refresh, cycles per packet in the last interval
+   are available by profile_cycles_packet */
+void
+profile_refresh ( void );
+
+const struct phase_stats *
+profile_phase ( enum profile_phase phase );
+
+const char *
+profile_phase_name ( enum profile_phase phase );
+
+// average of cycles per packet of last refresh or since start (total true)
+uint64_t
+profile_cycles_packet ( bool total );
+
+// unit of profile_cycles_packet, "cycles" or "ns" without counter of cycles
+const char *
+profile_cycles_unit ( void );
+
+/* first refresh with traffic of processes, after initial scan of processes.
+   only the first call is accounted, since profile_init */
+void
+profile_first_frame ( void );
+
+// milliseconds from start to first frame, 0 if not shown yet
+double
+profile_first_frame_ms ( void );
+
+// write summary of all phases
+void
+profile_dump ( FILE *file );
+
+#endif  // PROFILE_H
@@ -20,111 +20,661 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
-
-#include "processes.h"
-#include "round.h"
+#include <string.h>  // memset
+#include <time.h>    // clock_gettime
 #include "rate.h"
+#include "pool.h"
+#include "macro_util.h"
+
+// histories of all net_stat, initialized on first use
+static struct pool history_pool;
+
+// interval of refresh in milliseconds, the time of each sample
+static unsigned int interval = REFRESH_DEFAULT;
+
+/* seconds of each window, the same in ticks (samples), and slots of samples
+   in each history */
+static unsigned int windows[MAX_RATE_WINDOWS] = { RATE_WINDOW_DEFAULT };
+static unsigned int ticks[MAX_RATE_WINDOWS] = { RATE_WINDOW_DEFAULT };
+static unsigned int total_windows = 1;
+static unsigned int max_ticks = RATE_WINDOW_DEFAULT;
+static unsigned int slots = SAMPLE_SLOTS;
+
+// window of averages
+static unsigned int selected;
+
+/* net_stat with traffic in windows, each one with a id (index) in columns.
+   the sums of samples of each window and the averages of all actives are
+   columns, arrays by id (structure of arrays), so rate_calc is a linear
+   sweep of ids and the averages are computed by columns, without touch
+   the net_stat. the counters updated by packet stay in net_stat */
+enum field
+{
+  F_BYTES_RX,
+  F_PPS_RX,
+  F_BYTES_TX,
+  F_PPS_TX,
+  TOTAL_FIELDS
+};
+
+#define TOTAL_COLUMNS ( ( MAX_RATE_WINDOWS + 1 ) * TOTAL_FIELDS )
+
+// column of sums of 'window', and of averages of window selected
+#define SUM( window, field ) \
+  ( actives.columns[( window ) * TOTAL_FIELDS + ( field )] )
+#define AVG( field ) \
+  ( actives.columns[MAX_RATE_WINDOWS * TOTAL_FIELDS + ( field )] )
+
+// first size of columns, doubled when full
+#define ACTIVES_MIN 1024
+
+// ids ahead of sweep fetched of memory
+#define PREFETCH_DISTANCE 8
+
+// ids of a block of rate_calc, net_stat of a block fit in cache L2
+#define CALC_BLOCK 256
+
+static struct
+{
+  struct net_stat **owners;  // net_stat of each id
+  nstats_t *columns[TOTAL_COLUMNS];
+  uint32_t total;
+  uint32_t size;
+} actives;
+
+void
+rate_init ( const struct config_op *co )
+{
+  interval = co->refresh;
+  total_windows = co->total_rate_windows;
+  max_ticks = 0;
+
+  for ( unsigned int i = 0; i < total_windows; i++ )
+    {
+      windows[i] = co->rate_windows[i];
+      ticks[i] = rate_ticks ( windows[i] );
+      max_ticks = MAX ( max_ticks, ticks[i] );
+    }
+
+  slots = max_ticks + 2;
+  selected = 0;
+}
+
+uint32_t
+rate_tick ( uint32_t sec, uint32_t nsec )
+{
+  if ( interval == 1000 )
+    return sec;
+
+  return ( ( uint64_t ) sec * 1000 + nsec / 1000000 ) / interval;
+}
+
+uint32_t
+rate_now ( void )
+{
+  struct timespec ts;
+
+  clock_gettime ( CLOCK_REALTIME, &ts );
+
+  return rate_tick ( ts.tv_sec, ts.tv_nsec );
+}
+
+uint32_t
+rate_ticks ( unsigned int seconds )
+{
+  // rounded, at least one tick
+  return MAX ( 1, ( seconds * 1000 + interval / 2 ) / interval );
+}
+
+void
+rate_select_window ( unsigned int window )
+{
+  if ( window < total_windows )
+    selected = window;
+}
+
+unsigned int
+rate_selected_window ( void )
+{
+  return selected;
+}
+
+const unsigned int *
+rate_windows ( unsigned int *total )
+{
+  *total = total_windows;
+
+  return windows;
+}
+
+static inline void
+counters_add ( struct rate_counters *dst, const struct rate_counters *src )
+{
+  dst->Bps_rx += src->Bps_rx;
+  dst->pps_rx += src->pps_rx;
+  dst->Bps_tx += src->Bps_tx;
+  dst->pps_tx += src->pps_tx;
+}
+
+static inline void
+column_add ( unsigned int window, uint32_t id, const struct rate_counters *c )
+{
+  SUM ( window, F_BYTES_RX )[id] += c->Bps_rx;
+  SUM ( window, F_PPS_RX )[id] += c->pps_rx;
+  SUM ( window, F_BYTES_TX )[id] += c->Bps_tx;
+  SUM ( window, F_PPS_TX )[id] += c->pps_tx;
+}
+
+static inline void
+column_sub ( unsigned int window, uint32_t id, const struct rate_counters *c )
+{
+  SUM ( window, F_BYTES_RX )[id] -= c->Bps_rx;
+  SUM ( window, F_PPS_RX )[id] -= c->pps_rx;
+  SUM ( window, F_BYTES_TX )[id] -= c->Bps_tx;
+  SUM ( window, F_PPS_TX )[id] -= c->pps_tx;
+}
 
+/* add (or sub) 'c' to sums of windows that have the tick 'sec', a closed
+   tick of at most window ticks before of 'last'. 'ns' is in actives */
 static void
-rate_net_stat ( struct net_stat *ns, bool view_bytes )
+sums_add ( const struct net_stat *ns,
+           uint32_t sec,
+           const struct rate_counters *c,
+           bool sub )
+{
+  uint32_t age = ns->history->last - sec;
+  uint32_t id = ns->active - 1;
+
+  for ( unsigned int i = 0; i < total_windows; i++ )
+    {
+      if ( age < 1 || age > ticks[i] )
+        continue;
+
+      if ( sub )
+        column_sub ( i, id, c );
+      else
+        column_add ( i, id, c );
+    }
+}
+
+/* sums of all samples, after a long time without rate_calc or when the
+   net_stat enter in actives */
+static void
+sums_reset ( const struct net_stat *ns, uint32_t now )
+{
+  struct net_stat_history *hs = ns->history;
+  uint32_t id = ns->active - 1;
+
+  for ( unsigned int i = 0; i < total_windows; i++ )
+    for ( unsigned int f = 0; f < TOTAL_FIELDS; f++ )
+      SUM ( i, f )[id] = 0;
+
+  hs->last = now;
+
+  for ( unsigned int i = 0; i < slots; i++ )
+    sums_add ( ns, hs->samples[i].sec, &hs->samples[i].c, false );
+}
+
+/* move windows until 'now', in each tick a sample enters in all windows
+   and one leaves each window */
+static void
+sums_advance ( const struct net_stat *ns, uint32_t now )
+{
+  struct net_stat_history *hs = ns->history;
+  uint32_t id = ns->active - 1;
+
+  if ( now - hs->last > max_ticks )
+    {
+      sums_reset ( ns, now );
+      return;
+    }
+
+  while ( hs->last != now )
+    {
+      const struct rate_sample *s = &hs->samples[hs->last % slots];
+      bool enter = s->sec == hs->last;
+
+      hs->last++;
+      if ( enter )
+        sums_add ( ns, s->sec, &s->c, false );
+
+      for ( unsigned int i = 0; i < total_windows; i++ )
+        {
+          uint32_t leave = hs->last - ticks[i] - 1;
+
+          s = &hs->samples[leave % slots];
+          if ( s->sec == leave )
+            column_sub ( i, id, &s->c );
+        }
+    }
+}
+
+// columns with space to 'size' actives, the old are kept without memory
+static bool
+actives_grow ( void )
+{
+  uint32_t size = ( actives.size ) ? actives.size * 2 : ACTIVES_MIN;
+  void *p;
+
+  if ( !( p = realloc ( actives.owners, size * sizeof ( *actives.owners ) ) ) )
+    return false;
+
+  actives.owners = p;
+
+  for ( unsigned int i = 0; i < TOTAL_COLUMNS; i++ )
+    {
+      if ( !( p = realloc ( actives.columns[i], size * sizeof ( nstats_t ) ) ) )
+        return false;
+
+      actives.columns[i] = p;
+    }
+
+  actives.size = size;
+  return true;
+}
+
+// out of line, only when a net_stat start to have traffic
+static void
+active_insert ( struct net_stat *ns )
+{
+  // without memory only the totals are accounted, averages are zero
+  if ( actives.total == actives.size && !actives_grow () )
+    return;
+
+  uint32_t id = actives.total++;
+
+  actives.owners[id] = ns;
+  ns->active = id + 1;
+
+  for ( unsigned int i = 0; i < TOTAL_COLUMNS; i++ )
+    actives.columns[i][id] = 0;
+
+  // samples of history of before of leave actives or merged
+  if ( ns->history )
+    sums_reset ( ns, ns->history->last );
+}
+
+static inline void
+active_add ( struct net_stat *ns )
+{
+  if ( !ns->active )
+    active_insert ( ns );
+}
+
+// the last id is moved to id of 'ns', columns are kept dense
+static void
+active_del ( struct net_stat *ns )
+{
+  if ( !ns->active )
+    return;
+
+  uint32_t id = ns->active - 1;
+  uint32_t last = --actives.total;
+
+  if ( id != last )
+    {
+      actives.owners[id] = actives.owners[last];
+      actives.owners[id]->active = id + 1;
+
+      for ( unsigned int i = 0; i < TOTAL_COLUMNS; i++ )
+        actives.columns[i][id] = actives.columns[i][last];
+    }
+
+  ns->active = 0;
+}
+
+/* without traffic in tick in progress and in all windows, averages are
+   zero until the next traffic */
+static bool
+is_idle ( const struct net_stat *ns )
 {
-  uint64_t sum_bytes_rx = 0, sum_bytes_tx = 0, sum_pps_rx = 0, sum_pps_tx = 0;
+  if ( ns->cur_pps_rx || ns->cur_pps_tx )
+    return false;
+
+  uint32_t id = ns->active - 1;
+  for ( unsigned int i = 0; i < total_windows; i++ )
+    {
+      if ( SUM ( i, F_PPS_RX )[id] || SUM ( i, F_PPS_TX )[id] )
+        return false;
+    }
+
+  return true;
+}
 
-  // sum all bytes and packets received and sent
-  for ( int i = 0; i < SAMPLE_SPACE_SIZE; i++ )
+static struct net_stat_history *
+get_history ( struct net_stat *ns )
+{
+  if ( !ns->history )
     {
-      sum_bytes_rx += ns->Bps_rx[i];
-      sum_bytes_tx += ns->Bps_tx[i];
+      if ( !history_pool.obj_size )
+        pool_init ( &history_pool,
+                    "rate histories",
+                    sizeof ( struct net_stat_history ) +
+                            slots * sizeof ( struct rate_sample ),
+                    0 );
 
-      sum_pps_rx += ns->pps_rx[i];
-      sum_pps_tx += ns->pps_tx[i];
+      ns->history = pool_calloc ( &history_pool );
     }
 
-  // transform bytes to bits
-  if ( !view_bytes )
+  return ns->history;
+}
+
+/* add to sample of tick 'sec', a slot with a tick older is reused.
+   the sums are of actives, a net_stat out of actives has the sums
+   calculated when enter (see active_insert).
+   return false if 'sec' is older than the tick in slot or without
+   memory to history */
+static bool
+add_sample ( struct net_stat *ns,
+             uint32_t sec,
+             const struct rate_counters *c )
+{
+  struct net_stat_history *hs = get_history ( ns );
+  if ( !hs )
+    return false;
+
+  hs->pps_rx += c->pps_rx;
+  hs->pps_tx += c->pps_tx;
+
+  struct rate_sample *s = &hs->samples[sec % slots];
+
+  if ( s->sec != sec )
     {
-      sum_bytes_rx *= 8;
-      sum_bytes_tx *= 8;
+      if ( ( int32_t ) ( sec - s->sec ) < 0 )
+        return false;
+
+      // old tick still can be in a window
+      if ( ns->active )
+        sums_add ( ns, s->sec, &s->c, true );
+
+      s->sec = sec;
+      memset ( &s->c, 0, sizeof ( s->c ) );
     }
 
-  // calc averege of bytes received / sent
-  ns->avg_Bps_rx = m_round ( ( double ) sum_bytes_rx / SAMPLE_SPACE_SIZE );
-  ns->avg_Bps_tx = m_round ( ( double ) sum_bytes_tx / SAMPLE_SPACE_SIZE );
+  counters_add ( &s->c, c );
+
+  if ( ns->active )
+    sums_add ( ns, sec, c, false );
+
+  return true;
+}
+
+// move the counters of tick in progress to history
+static void
+close_tick ( struct net_stat *ns )
+{
+  if ( !ns->cur_pps_rx && !ns->cur_pps_tx )
+    return;
+
+  struct rate_counters c = { .Bps_rx = ns->cur_Bps_rx,
+                              .pps_rx = ns->cur_pps_rx,
+                              .Bps_tx = ns->cur_Bps_tx,
+                              .pps_tx = ns->cur_pps_tx };
 
-  // calc averege of packets received / sent
-  ns->avg_pps_rx = m_round ( ( double ) sum_pps_rx / SAMPLE_SPACE_SIZE );
-  ns->avg_pps_tx = m_round ( ( double ) sum_pps_tx / SAMPLE_SPACE_SIZE );
+  add_sample ( ns, ns->sec, &c );
+
+  ns->cur_Bps_rx = ns->cur_pps_rx = 0;
+  ns->cur_Bps_tx = ns->cur_pps_tx = 0;
 }
 
+// close tick in progress and move windows of a net_stat of actives
+static void
+tick_net_stat ( struct net_stat *ns, uint32_t now )
+{
+  if ( ( int32_t ) ( now - ns->sec ) > 0 )
+    close_tick ( ns );
+
+  if ( ns->history )
+    sums_advance ( ns, now );
+}
+
+/* averages per second of window selected of ids 'first' to 'end', only
+   columns are read and written, without dependency between ids, so the
+   loop is vectorized by compiler (as with AVX2 or NEON) */
+static void
+calc_averages ( uint32_t first, uint32_t end, bool view_bytes )
+{
+  // seconds of samples in window, rates are always per second
+  double window = ticks[selected] * ( interval / 1000.0 );
+
+  for ( unsigned int f = 0; f < TOTAL_FIELDS; f++ )
+    {
+      const nstats_t *restrict sum = SUM ( selected, f );
+      nstats_t *restrict avg = AVG ( f );
+
+      // transform bytes to bits
+      nstats_t mul = ( !view_bytes && ( f == F_BYTES_RX || f == F_BYTES_TX ) )
+                             ? 8
+                             : 1;
+
+      // as m_round, inline to loop be vectorized
+      for ( uint32_t id = first; id < end; id++ )
+        avg[id] = ( nstats_t ) ( ( double ) ( sum[id] * mul ) / window + 0.5 );
+    }
+}
+
+/* the sweep is by blocks of ids, the net_stat of a block are still in
+   cache when receive the averages */
 void
-rate_calc ( struct processes *processes, const struct config_op *co )
+rate_calc ( const struct config_op *co, uint32_t now )
 {
-  for ( size_t i = 0; i < processes->total; i++ )
+  struct net_stat **owners = actives.owners;
+  uint32_t total = actives.total;
+
+  for ( uint32_t first = 0; first < total; first += CALC_BLOCK )
     {
-      process_t *process = processes->proc[i];
+      uint32_t end = MIN ( first + CALC_BLOCK, total );
+
+      // net_stat are far in memory, fetched ahead of sweep
+      for ( uint32_t id = first; id < end; id++ )
+        {
+          if ( id + PREFETCH_DISTANCE < total )
+            __builtin_prefetch ( owners[id + PREFETCH_DISTANCE] );
+
+          if ( id + PREFETCH_DISTANCE / 2 < total )
+            __builtin_prefetch ( owners[id + PREFETCH_DISTANCE / 2]->history );
+
+          tick_net_stat ( owners[id], now );
+        }
 
-      rate_net_stat ( &process->net_stat, co->view_bytes );
+      calc_averages ( first, end, co->view_bytes );
 
-      // calc rate to each connection
-      if ( co->view_conections )
+      // views read the averages of net_stat
+      for ( uint32_t id = first; id < end; id++ )
         {
-          for ( size_t i = 0; i < process->total_conections; i++ )
-            rate_net_stat ( &process->conections[i]->net_stat, co->view_bytes );
+          struct net_stat *ns = owners[id];
+
+          ns->avg_Bps_rx = AVG ( F_BYTES_RX )[id];
+          ns->avg_Bps_tx = AVG ( F_BYTES_TX )[id];
+          ns->avg_pps_rx = AVG ( F_PPS_RX )[id];
+          ns->avg_pps_tx = AVG ( F_PPS_TX )[id];
         }
     }
 }
 
-#define UPDATE_ID_BUFF( id ) ( ( id ) = ( ( id ) + 1 ) % SAMPLE_SPACE_SIZE )
+/* return false if the traffic is of a tick older than the tick in
+   progress, so it must be added to history */
+static inline bool
+in_progress ( struct net_stat *ns, uint32_t sec )
+{
+  if ( sec == ns->sec )
+    return true;
+
+  if ( ( int32_t ) ( sec - ns->sec ) < 0 )
+    return false;
 
-static uint8_t idx_cir = 0;
+  close_tick ( ns );
+  ns->sec = sec;
+
+  return true;
+}
 
 void
-rate_add_rx ( struct net_stat *ns, size_t lenght )
+rate_add_rx_n ( struct net_stat *ns,
+                size_t lenght,
+                size_t packets,
+                uint32_t sec )
 {
-  ns->pps_rx[idx_cir]++;
-  ns->Bps_rx[idx_cir] += lenght;
-
-  ns->bytes_last_sec_rx += lenght;
   ns->tot_Bps_rx += lenght;
+  active_add ( ns );
+
+  if ( in_progress ( ns, sec ) )
+    {
+      ns->cur_Bps_rx += lenght;
+      ns->cur_pps_rx += packets;
+    }
+  else
+    add_sample ( ns,
+                 sec,
+                 &( struct rate_counters ){ .Bps_rx = lenght,
+                                            .pps_rx = packets } );
 }
 
 void
-rate_add_tx ( struct net_stat *ns, size_t lenght )
+rate_add_tx_n ( struct net_stat *ns,
+                size_t lenght,
+                size_t packets,
+                uint32_t sec )
 {
-  ns->pps_tx[idx_cir]++;
-  ns->Bps_tx[idx_cir] += lenght;
-
-  ns->bytes_last_sec_tx += lenght;
   ns->tot_Bps_tx += lenght;
+  active_add ( ns );
+
+  if ( in_progress ( ns, sec ) )
+    {
+      ns->cur_Bps_tx += lenght;
+      ns->cur_pps_tx += packets;
+    }
+  else
+    add_sample ( ns,
+                 sec,
+                 &( struct rate_counters ){ .Bps_tx = lenght,
+                                            .pps_tx = packets } );
 }
 
 void
-rate_update ( struct processes *processes, const struct config_op *co )
+rate_add_rx ( struct net_stat *ns, size_t lenght, uint32_t sec )
 {
-  UPDATE_ID_BUFF ( idx_cir );
+  rate_add_rx_n ( ns, lenght, 1, sec );
+}
 
-  for ( size_t i = 0; i < processes->total; i++ )
+void
+rate_add_tx ( struct net_stat *ns, size_t lenght, uint32_t sec )
+{
+  rate_add_tx_n ( ns, lenght, 1, sec );
+}
+
+/* samples are closed by time of capture, only the counters of log (bytes
+   since last refresh) are updated. the totals of a net_stat only change
+   with traffic, so they are updated before of it leave the list */
+void
+rate_update ( void )
+{
+  // a id removed receive the last, visited next
+  for ( uint32_t id = 0; id < actives.total; )
     {
-      process_t *process = processes->proc[i];
+      struct net_stat *ns = actives.owners[id];
 
-      process->net_stat.Bps_rx[idx_cir] = 0;
-      process->net_stat.Bps_tx[idx_cir] = 0;
-      process->net_stat.pps_rx[idx_cir] = 0;
-      process->net_stat.pps_tx[idx_cir] = 0;
+      ns->tot_Bps_rx_prev = ns->tot_Bps_rx;
+      ns->tot_Bps_tx_prev = ns->tot_Bps_tx;
 
-      process->net_stat.bytes_last_sec_rx = 0;
-      process->net_stat.bytes_last_sec_tx = 0;
+      if ( is_idle ( ns ) )
+        active_del ( ns );
+      else
+        id++;
+    }
+}
+
+void
+rate_net_stat_merge ( struct net_stat *dst, const struct net_stat *src )
+{
+  // traffic of tick in progress is added below
+  dst->tot_Bps_rx += src->tot_Bps_rx - src->cur_Bps_rx;
+  dst->tot_Bps_tx += src->tot_Bps_tx - src->cur_Bps_tx;
+  dst->tot_Bps_rx_prev += src->tot_Bps_rx_prev;
+  dst->tot_Bps_tx_prev += src->tot_Bps_tx_prev;
+
+  if ( src->cur_pps_rx )
+    rate_add_rx_n ( dst, src->cur_Bps_rx, src->cur_pps_rx, src->sec );
+
+  if ( src->cur_pps_tx )
+    rate_add_tx_n ( dst, src->cur_Bps_tx, src->cur_pps_tx, src->sec );
 
-      // clear statistics of each connection alsa
-      if ( co->view_conections )
+  const struct net_stat_history *hs = src->history;
+  nstats_t pps_rx = 0, pps_tx = 0;
+
+  for ( unsigned int i = 0; hs && i < slots; i++ )
+    {
+      const struct rate_sample *s = &hs->samples[i];
+
+      if ( s->c.pps_rx || s->c.pps_tx )
         {
-          for ( size_t c = 0; c < process->total_conections; c++ )
-            {
-              process->conections[c]->net_stat.Bps_rx[idx_cir] = 0;
-              process->conections[c]->net_stat.Bps_tx[idx_cir] = 0;
-              process->conections[c]->net_stat.pps_rx[idx_cir] = 0;
-              process->conections[c]->net_stat.pps_tx[idx_cir] = 0;
-            }
+          add_sample ( dst, s->sec, &s->c );
+          pps_rx += s->c.pps_rx;
+          pps_tx += s->c.pps_tx;
         }
     }
+
+  // packets of ticks already out of samples
+  if ( hs && dst->history )
+    {
+      dst->history->pps_rx += hs->pps_rx - pps_rx;
+      dst->history->pps_tx += hs->pps_tx - pps_tx;
+    }
+
+  // samples still not in windows of 'dst' are counted in next rate_calc
+  if ( hs )
+    active_add ( dst );
+}
+
+bool
+rate_tick_counters ( const struct net_stat *ns,
+                     uint32_t tick,
+                     struct rate_counters *c )
+{
+  const struct net_stat_history *hs = ns->history;
+
+  if ( !hs || hs->samples[tick % slots].sec != tick )
+    {
+      memset ( c, 0, sizeof ( *c ) );
+      return false;
+    }
+
+  *c = hs->samples[tick % slots].c;
+  return true;
+}
+
+void
+rate_packets ( const struct net_stat *ns, nstats_t *rx, nstats_t *tx )
+{
+  const struct net_stat_history *hs = ns->history;
+
+  *rx = ns->cur_pps_rx + ( ( hs ) ? hs->pps_rx : 0 );
+  *tx = ns->cur_pps_tx + ( ( hs ) ? hs->pps_tx : 0 );
+}
+
+void
+rate_net_stat_free ( struct net_stat *ns )
+{
+  active_del ( ns );
+
+  if ( ns->history )
+    {
+      pool_free ( &history_pool, ns->history );
+      ns->history = NULL;
+    }
+}
+
+void
+rate_free ( void )
+{
+  free ( actives.owners );
+  for ( unsigned int i = 0; i < TOTAL_COLUMNS; i++ )
+    free ( actives.columns[i] );
+
+  memset ( &actives, 0, sizeof ( actives ) );
+
+  if ( history_pool.obj_size )
+    pool_destroy ( &history_pool );
+
+  history_pool.obj_size = 0;
 }
@@ -21,13 +21,24 @@
 #ifndef RATE_H
 #define RATE_H
 
-#include <stdlib.h>  // type size_t
-#include <stdint.h>  // uint*_t
+#include <stdalign.h>  // alignas
+#include <stdlib.h>    // type size_t
+#include <stdint.h>    // uint*_t
 
 #include "config.h"
+#include "macro_util.h"  // CACHE_LINE_SIZE
 
-/* amostral space, from last five seconds */
+/* amostral space, from last five seconds, window of rates by default
+   (see rate_init).
+   each sample is a tick, the interval of refresh (config_op.refresh), with
+   the default interval a tick is a second of capture */
 #define SAMPLE_SPACE_SIZE 5
+#define RATE_WINDOW_DEFAULT SAMPLE_SPACE_SIZE
+
+/* each sample is the tick of capture (timestamp of packet) sec % slots,
+   slots are the largest window plus one slot to the tick in progress,
+   not used in average, and one to a tick closed before of rate_calc */
+#define SAMPLE_SLOTS ( SAMPLE_SPACE_SIZE + 2 )
 
 /*
  Considerando que a cada 1024 bits ou bytes (bits por segundo ou bytes por
@@ -45,13 +56,56 @@
 
 typedef uint64_t nstats_t;
 
+struct rate_counters
+{
+  nstats_t Bps_rx;
+  nstats_t pps_rx;
+  nstats_t Bps_tx;
+  nstats_t pps_tx;
+};
+
+struct rate_sample
+{
+  struct rate_counters c;
+  uint32_t sec;  // tick of capture of sample
+};
+
+/* samples of closed ticks, each slot is the tick sec % slots.
+   the sum of samples of each window ending before the tick 'last' is in
+   columns of actives (see rate.c), updated when a sample is added or
+   enters or leaves the window, so the cost of average not depend of size
+   of window */
+struct net_stat_history
+{
+  uint32_t last;
+  nstats_t pps_rx;  // packets of all ticks closed, also out of windows
+  nstats_t pps_tx;
+  struct rate_sample samples[];
+};
+
+/* the first cache line has all that is updated by packet, the traffic of
+   tick in progress is accumulated in it and moved to history when a
+   packet of a newer tick arrives or when rate_calc see the tick closed.
+   the history is allocated only when a tick with traffic is closed, so
+   connections without traffic (or without view of connections) not have it.
+   net_stat with traffic in windows are in actives, with a id in columns
+   of sums and averages, only they are visited by rate_calc and
+   rate_update, the others have averages zero */
 struct net_stat
 {
-  // samples pps and bytes per second rx/tx
-  nstats_t pps_rx[SAMPLE_SPACE_SIZE];
-  nstats_t pps_tx[SAMPLE_SPACE_SIZE];
-  nstats_t Bps_rx[SAMPLE_SPACE_SIZE];
-  nstats_t Bps_tx[SAMPLE_SPACE_SIZE];
+  // tick of capture of counters of tick in progress
+  alignas ( CACHE_LINE_SIZE ) uint32_t sec;
+  uint32_t active;  // id + 1 in columns of actives, 0 if not in actives
+  nstats_t cur_Bps_rx;
+  nstats_t cur_Bps_tx;
+  nstats_t cur_pps_rx;
+  nstats_t cur_pps_tx;
+
+  // total bytes traffic rx/tx
+  nstats_t tot_Bps_rx;
+  nstats_t tot_Bps_tx;
+
+  // updated by rate_calc and rate_update
 
   // averege bytes/second and packets/second rx/tx
   nstats_t avg_Bps_rx;
@@ -59,27 +113,97 @@ struct net_stat
   nstats_t avg_pps_rx;
   nstats_t avg_pps_tx;
 
-  // total bytes traffic rx/tx
-  nstats_t tot_Bps_rx;
-  nstats_t tot_Bps_tx;
+  // totals in last rate_update, used by function log.c/log_file()
+  nstats_t tot_Bps_rx_prev;
+  nstats_t tot_Bps_tx_prev;
 
-  // used by function log.c/log_file()
-  nstats_t bytes_last_sec_rx;  // total bytes in last second
-  nstats_t bytes_last_sec_tx;
+  struct net_stat_history *history;
 };
 
-struct processes;
+/* interval of refresh and windows of rates, in seconds, of config_op.
+   must be called before of traffic be accounted, without it the window is
+   RATE_WINDOW_DEFAULT and the tick is a second */
+void
+rate_init ( const struct config_op *co );
+
+// tick of a time of capture, as tp_sec and tp_nsec of packets
+uint32_t
+rate_tick ( uint32_t sec, uint32_t nsec );
+
+// tick of time of system, same clock of timestamps of packets
+uint32_t
+rate_now ( void );
+
+// ticks in 'seconds', at least one
+uint32_t
+rate_ticks ( unsigned int seconds );
+
+/* window used in averages of net_stat (avg_*), index of windows
+   of rate_init. the averages are updated in next rate_calc */
+void
+rate_select_window ( unsigned int window );
+
+unsigned int
+rate_selected_window ( void );
+
+// size in seconds of each window and total of windows
+const unsigned int *
+rate_windows ( unsigned int *total );
+
+/* 'sec' is the tick of capture of traffic (see rate_tick), traffic
+   older than the samples of net_stat is only added to totals */
+void
+rate_add_tx ( struct net_stat *ns, size_t lenght, uint32_t sec );
+
+// same that rate_add_tx, but account 'packets' with total of 'lenght' bytes
+void
+rate_add_tx_n ( struct net_stat *ns,
+                size_t lenght,
+                size_t packets,
+                uint32_t sec );
 
 void
-rate_add_tx ( struct net_stat *ns, size_t lenght );
+rate_add_rx_n ( struct net_stat *ns,
+                size_t lenght,
+                size_t packets,
+                uint32_t sec );
+
+void
+rate_add_rx ( struct net_stat *ns, size_t lenght, uint32_t sec );
+
+/* calc averages per second, of all net_stat with traffic in windows, with
+   samples of ticks closed before 'now', so traffic read late of ring still
+   is computed in your tick */
+void
+rate_calc ( const struct config_op *co, uint32_t now );
+
+/* save totals to log and drop of actives the net_stat without
+   traffic in windows */
+void
+rate_update ( void );
+
+// add totals and samples of 'src' to 'dst'
+void
+rate_net_stat_merge ( struct net_stat *dst, const struct net_stat *src );
+
+/* counters of tick 'tick' closed by rate_calc, false (and zeros) if
+   'ns' not had traffic in it */
+bool
+rate_tick_counters ( const struct net_stat *ns,
+                     uint32_t tick,
+                     struct rate_counters *c );
 
+// total of packets received and sent, of ticks closed and in progress
 void
-rate_add_rx ( struct net_stat *ns, size_t lenght );
+rate_packets ( const struct net_stat *ns, nstats_t *rx, nstats_t *tx );
 
+/* release the history of 'ns' and remove it of actives, it must be
+   zeroed before of reuse */
 void
-rate_calc ( struct processes *processes, const struct config_op *co );
+rate_net_stat_free ( struct net_stat *ns );
 
+// release memory of histories of all net_stat
 void
-rate_update ( struct processes *processes, const struct config_op *co );
+rate_free ( void );
 
 #endif  // RATE_H
@@ -0,0 +1,249 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>   // variable errno
+#include <stdio.h>   // FILE
+#include <stdlib.h>  // malloc
+#include <string.h>  // strerror
+
+#include "record.h"
+#include "hashtable.h"
+#include "hash.h"
+#include "vector.h"
+#include "m_error.h"
+
+// process with traffic recorded, by address of process_t
+struct rec_process
+{
+  const process_t *proc;
+  const char *name;  // name of process when recorded, changed by exec
+  uint32_t id;
+  uint32_t seen;  // last tick of process in list of processes
+  pid_t pid;
+};
+
+static hashtable_t *ht_rec;
+static struct rec_process **recorded;  // to find processes closed
+static uint32_t next_id;
+static uint32_t last_tick;
+static bool tick_written;
+static FILE *file;
+
+static bool
+ht_cb_compare ( const void *key1, const void *key2 )
+{
+  return key1 == key2;
+}
+
+static hash_t
+ht_cb_hash ( const void *key )
+{
+  return hash_u64 ( ( uintptr_t ) key );
+}
+
+static void
+write_varint ( uint64_t value )
+{
+  while ( value >= 0x80 )
+    {
+      putc ( ( value & 0x7f ) | 0x80, file );
+      value >>= 7;
+    }
+
+  putc ( value, file );
+}
+
+// record of tick only before of first record in it
+static void
+write_tick ( uint32_t tick )
+{
+  if ( tick_written )
+    return;
+
+  putc ( REC_TICK, file );
+  write_varint ( tick - last_tick );
+  last_tick = tick;
+  tick_written = true;
+}
+
+static struct rec_process *
+get_rec ( const process_t *proc, uint32_t tick )
+{
+  struct rec_process *rec = hashtable_get ( ht_rec, proc );
+
+  // process_t reused by other process, or exec
+  if ( rec && ( rec->pid != proc->pid || rec->name != proc->name ) )
+    {
+      rec->seen = 0;
+      rec = NULL;
+      hashtable_remove ( ht_rec, proc );
+    }
+
+  if ( rec )
+    return rec;
+
+  rec = malloc ( sizeof *rec );
+  if ( !rec )
+    return NULL;
+
+  *rec = ( struct rec_process ){
+    .proc = proc, .name = proc->name, .id = next_id++, .pid = proc->pid
+  };
+
+  if ( !hashtable_set ( ht_rec, proc, rec ) )
+    {
+      free ( rec );
+      return NULL;
+    }
+
+  if ( !vector_push ( recorded, &rec ) )
+    {
+      hashtable_remove ( ht_rec, proc );
+      free ( rec );
+      return NULL;
+    }
+
+  size_t len = strlen ( proc->name );
+
+  write_tick ( tick );
+  putc ( REC_PROCESS, file );
+  write_varint ( rec->id );
+  write_varint ( ( uint32_t ) proc->pid );
+  write_varint ( len );
+  fwrite ( proc->name, 1, len, file );
+
+  return rec;
+}
+
+bool
+record_init ( const char *path, const struct config_op *co )
+{
+  file = fopen ( path, "w" );
+  if ( !file )
+    {
+      ERROR_DEBUG (
+              "Error open/create file '%s': %s", path, strerror ( errno ) );
+      return false;
+    }
+
+  ht_rec = hashtable_new ( ht_cb_hash, ht_cb_compare, free );
+  recorded = vector_new ( sizeof ( struct rec_process * ) );
+  if ( !ht_rec || !recorded )
+    {
+      record_free ();
+      return false;
+    }
+
+  fwrite ( RECORD_MAGIC, 1, RECORD_MAGIC_SIZE, file );
+  write_varint ( co->refresh );
+
+  return true;
+}
+
+void
+record_tick ( process_t **processes, size_t total, uint32_t tick )
+{
+  if ( !file )
+    return;
+
+  tick_written = false;
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      process_t *proc = processes[i];
+      struct net_stat *ns = &proc->net_stat;
+
+      // bytes since last refresh, packets of tick closed
+      nstats_t rx = ns->tot_Bps_rx - ns->tot_Bps_rx_prev;
+      nstats_t tx = ns->tot_Bps_tx - ns->tot_Bps_tx_prev;
+
+      struct rec_process *rec;
+      if ( !rx && !tx )
+        {
+          // only processes already recorded not are closed
+          if ( ( rec = hashtable_get ( ht_rec, proc ) ) &&
+               rec->pid == proc->pid && rec->name == proc->name )
+            rec->seen = tick;
+
+          continue;
+        }
+
+      if ( !( rec = get_rec ( proc, tick ) ) )
+        continue;
+
+      rec->seen = tick;
+
+      struct rate_counters c;
+      rate_tick_counters ( ns, tick, &c );
+
+      write_tick ( tick );
+      putc ( REC_TRAFFIC, file );
+      write_varint ( rec->id );
+      write_varint ( rx );
+      write_varint ( tx );
+      write_varint ( c.pps_rx );
+      write_varint ( c.pps_tx );
+    }
+
+  // processes not more in list
+  size_t n = vector_size ( recorded );
+  for ( size_t i = 0; i < n; )
+    {
+      struct rec_process *rec = recorded[i];
+
+      if ( rec->seen == tick )
+        {
+          i++;
+          continue;
+        }
+
+      recorded[i] = recorded[--n];
+      vector_pop ( recorded );
+
+      write_tick ( tick );
+      putc ( REC_EXIT, file );
+      write_varint ( rec->id );
+
+      // already removed of table by get_rec if process_t was reused
+      if ( rec->seen )
+        hashtable_remove ( ht_rec, rec->proc );
+      free ( rec );
+    }
+
+  // records of a tick are not lost if netproc crash
+  if ( tick_written )
+    fflush ( file );
+}
+
+void
+record_free ( void )
+{
+  if ( file )
+    fclose ( file );
+  file = NULL;
+
+  if ( recorded )
+    vector_free ( recorded );
+  recorded = NULL;
+
+  if ( ht_rec )
+    hashtable_destroy ( ht_rec );
+  ht_rec = NULL;
+}
@@ -0,0 +1,64 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>  // size_t
+
+#include "processes.h"
+#include "config.h"
+
+/* history of traffic of processes in a file, read by replay.h.
+   the file is the header (RECORD_MAGIC and interval of refresh) and after
+   a sequence of records, a byte of type and fields unsigned as varint
+   (LEB128, 7 bits by byte). the names of processes are written once, the
+   traffic of a process in a tick refers to it by id. only ticks with
+   traffic have records, in a second without traffic nothing is written */
+
+#define RECORD_MAGIC "NPREC\0\0\1"
+#define RECORD_MAGIC_SIZE 8
+
+enum record_type
+{
+  // ticks since previous record of tick, the first is the tick
+  REC_TICK = 1,
+  // new process: id, pid, length of name, name
+  REC_PROCESS,
+  // traffic of tick: id, bytes rx, bytes tx, packets rx, packets tx
+  REC_TRAFFIC,
+  // process closed: id
+  REC_EXIT
+};
+
+bool
+record_init ( const char *path, const struct config_op *co );
+
+/* write traffic of processes in tick 'tick', closed by rate_calc and
+   before of rate_update, and the processes closed since last call */
+void
+record_tick ( process_t **processes, size_t total, uint32_t tick );
+
+void
+record_free ( void );
+
+#endif  // RECORD_H
@@ -0,0 +1,292 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>   // variable errno
+#include <stdio.h>   // FILE
+#include <stdlib.h>  // calloc
+#include <string.h>  // strerror, memcmp
+
+#include "replay.h"
+#include "record.h"
+#include "rate.h"
+#include "vector.h"
+#include "intern.h"
+#include "m_error.h"
+
+// processes by id of record, NULL if closed
+static process_t **by_id;
+static size_t total_ids;
+
+// tick of next record of file, read in advance
+static uint32_t next_tick;
+static bool eof;
+static FILE *file;
+
+static bool
+read_varint ( uint64_t *value )
+{
+  *value = 0;
+
+  for ( unsigned int shift = 0; shift < 64; shift += 7 )
+    {
+      int c = getc ( file );
+      if ( c == EOF )
+        return false;
+
+      *value |= ( uint64_t ) ( c & 0x7f ) << shift;
+      if ( !( c & 0x80 ) )
+        return true;
+    }
+
+  return false;
+}
+
+static bool
+read_tick ( void )
+{
+  uint64_t delta;
+
+  if ( !read_varint ( &delta ) )
+    return false;
+
+  next_tick += delta;
+  return true;
+}
+
+static bool
+read_process ( struct processes *view )
+{
+  uint64_t id, pid, len;
+
+  if ( !read_varint ( &id ) || !read_varint ( &pid ) ||
+       !read_varint ( &len ) || len > 1024 * 1024 )
+    return false;
+
+  // ids are sequential in record
+  if ( !vector_reserve ( by_id, id + 1 ) )
+    return false;
+
+  while ( total_ids <= id )
+    {
+      process_t *null = NULL;
+      if ( !vector_push ( by_id, &null ) )
+        return false;
+
+      total_ids++;
+    }
+
+  process_t *proc = calloc ( 1, sizeof *proc );
+  if ( !proc )
+    return false;
+
+  proc->pid = pid;
+
+  // name is interned, as names of processes of capture
+  char *name = malloc ( len + 1 );
+  if ( !name || fread ( name, 1, len, file ) != len ||
+       !( proc->name = intern ( name, len ) ) ||
+       !vector_push ( view->proc, &proc ) )
+    {
+      intern_put ( proc->name );
+      free ( name );
+      free ( proc );
+      return false;
+    }
+
+  free ( name );
+  by_id[id] = proc;
+  view->total++;
+
+  return true;
+}
+
+// process of id read of file, NULL if invalid or closed
+static process_t *
+read_id ( uint64_t *id )
+{
+  if ( !read_varint ( id ) || *id >= total_ids )
+    return NULL;
+
+  return by_id[*id];
+}
+
+static bool
+read_traffic ( uint32_t tick )
+{
+  uint64_t id, rx, tx, pps_rx, pps_tx;
+  process_t *proc = read_id ( &id );
+
+  if ( !proc || !read_varint ( &rx ) || !read_varint ( &tx ) ||
+       !read_varint ( &pps_rx ) || !read_varint ( &pps_tx ) )
+    return false;
+
+  if ( rx )
+    rate_add_rx_n ( &proc->net_stat, rx, pps_rx, tick );
+  if ( tx )
+    rate_add_tx_n ( &proc->net_stat, tx, pps_tx, tick );
+
+  return true;
+}
+
+static void
+free_process ( process_t *proc )
+{
+  rate_net_stat_free ( &proc->net_stat );
+  intern_put ( proc->name );
+  free ( proc );
+}
+
+static bool
+read_exit ( struct processes *view )
+{
+  uint64_t id;
+  process_t *proc = read_id ( &id );
+  if ( !proc )
+    return false;
+
+  for ( size_t i = 0; i < view->total; i++ )
+    {
+      if ( view->proc[i] != proc )
+        continue;
+
+      view->proc[i] = view->proc[--view->total];
+      vector_pop ( view->proc );
+      break;
+    }
+
+  by_id[id] = NULL;
+  free_process ( proc );
+
+  return true;
+}
+
+bool
+replay_init ( const char *path, unsigned int *refresh, uint32_t *tick )
+{
+  file = fopen ( path, "r" );
+  if ( !file )
+    {
+      ERROR_DEBUG (
+              "Error open file '%s': %s", path, strerror ( errno ) );
+      return false;
+    }
+
+  by_id = vector_new ( sizeof ( process_t * ) );
+  if ( !by_id )
+    goto ERROR;
+
+  char magic[RECORD_MAGIC_SIZE];
+  uint64_t value;
+
+  if ( fread ( magic, 1, sizeof magic, file ) != sizeof magic ||
+       memcmp ( magic, RECORD_MAGIC, sizeof magic ) ||
+       !read_varint ( &value ) || !value )
+    {
+      ERROR_DEBUG ( "File '%s' is not a record of netproc", path );
+      goto ERROR;
+    }
+
+  *refresh = value;
+
+  // first record is the tick of start
+  if ( getc ( file ) != REC_TICK || !read_tick () )
+    {
+      ERROR_DEBUG ( "Record '%s' without traffic", path );
+      goto ERROR;
+    }
+
+  *tick = next_tick;
+
+  return true;
+
+ERROR:
+  replay_free ( NULL );
+  return false;
+}
+
+bool
+replay_tick ( struct processes *view, uint32_t tick )
+{
+  if ( eof )
+    return false;
+
+  // records of tick, until the record of next tick
+  while ( next_tick == tick )
+    {
+      int type = getc ( file );
+      bool ok;
+
+      switch ( type )
+        {
+          case REC_TICK:
+            ok = read_tick ();
+            break;
+          case REC_PROCESS:
+            ok = read_process ( view );
+            break;
+          case REC_TRAFFIC:
+            ok = read_traffic ( tick );
+            break;
+          case REC_EXIT:
+            ok = read_exit ( view );
+            break;
+          default:
+            ok = false;
+        }
+
+      if ( !ok )
+        {
+          // record in middle of write, of netproc still recording
+          if ( type != EOF )
+            {
+              ERROR_DEBUG ( "Record invalid of type %d", type );
+            }
+
+          eof = true;
+          return false;
+        }
+    }
+
+  return true;
+}
+
+void
+replay_free ( struct processes *view )
+{
+  if ( file )
+    fclose ( file );
+  file = NULL;
+
+  if ( by_id )
+    {
+      for ( size_t i = 0; i < total_ids; i++ )
+        {
+          if ( by_id[i] )
+            free_process ( by_id[i] );
+        }
+
+      vector_free ( by_id );
+    }
+  by_id = NULL;
+  total_ids = 0;
+
+  if ( view )
+    view->total = 0;
+}
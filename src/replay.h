@@ -0,0 +1,45 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "processes.h"
+
+/* read of file written by record.h, the processes are created with
+   traffic of file, to be showed as processes of capture */
+
+/* open file, return interval of refresh of record in 'refresh' and the
+   tick of first record in 'tick' */
+bool
+replay_init ( const char *path, unsigned int *refresh, uint32_t *tick );
+
+/* add to processes of 'view', with rate_add_*, the traffic of 'tick',
+   processes closed in it are removed. return false on end of file */
+bool
+replay_tick ( struct processes *view, uint32_t tick );
+
+void
+replay_free ( struct processes *view );
+
+#endif  // REPLAY_H
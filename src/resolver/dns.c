@@ -0,0 +1,1108 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE  // sendmmsg, recvmmsg
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>   // fopen, getline
+#include <stdlib.h>  // strtoul, free
+#include <string.h>
+#include <netdb.h>  // NI_MAXHOST
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>  // sigfillset
+#include <unistd.h>  // close
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/random.h>  // getrandom
+#include <sys/socket.h>
+
+#include "dns.h"
+#include "sock_util.h"  // check_addr_equal
+#include "../timer.h"   // get_time
+#include "../affinity.h"
+#include "../macro_util.h"
+#include "../m_error.h"
+
+#define RESOLV_CONF "/etc/resolv.conf"
+#define HOSTS "/etc/hosts"
+
+// same defaults of resolver of libc
+#define MAX_SERVERS 3
+#define DEFAULT_TIMEOUT 5    // seconds
+#define DEFAULT_ATTEMPTS 2   // by server
+#define MAX_TIMEOUT 30
+#define MAX_ATTEMPTS 5
+
+// queries in flight
+#define MAX_INFLIGHT 1024
+
+// ids of queries, all the 16 bits are random
+#define TOTAL_IDS ( UINT16_MAX + 1 )
+
+// addresses waiting a slot of query, by priority
+#define MAX_PENDING 1024
+
+// packets sent or received by syscall
+#define BATCH 64
+
+/* the source port is of kernel (random of ephemeral ports), a new socket is
+   opened after a batch of queries. sockets with queries in flight stay
+   open, up to MAX_SOCKETS by family */
+#define MAX_SOCKETS 8
+#define QUERIES_BY_SOCKET BATCH
+
+#define DNS_PORT 53
+#define DNS_HEADER 12
+#define DNS_MAX_PACKET 512  // UDP without EDNS
+#define QUERY_MAX 160      // PTR of ipv6 has 72 bytes of name
+
+#define TYPE_SOA 6
+#define TYPE_PTR 12
+#define CLASS_IN 1
+
+#define FLAG_QR 0x8000
+#define FLAG_TC 0x0200
+#define FLAG_RD 0x0100
+#define RCODE_MASK 0x000f
+#define RCODE_NXDOMAIN 3
+
+struct request
+{
+  union sockaddr_all addr;
+  dns_callback done;
+  void *arg;
+  uint64_t deadline;  // milliseconds
+  uint16_t id;
+  uint8_t len;  // of query
+  uint8_t try;
+  uint8_t sock;  // index in sockets, of last try
+  uint8_t query[QUERY_MAX];
+};
+
+struct pending
+{
+  union sockaddr_all addr;
+  dns_callback done;
+  void *arg;
+};
+
+struct host_name
+{
+  union sockaddr_all addr;
+  char *name;
+};
+
+struct server
+{
+  union sockaddr_all addr;
+  unsigned int family;  // 0 is ipv4, 1 is ipv6
+};
+
+struct dns_socket
+{
+  int fd;
+  unsigned int inflight;  // queries of which the last try was by it
+  unsigned int sent;      // queries sent, to open a new socket
+};
+
+static struct server servers[MAX_SERVERS];
+static unsigned int total_servers;
+static unsigned int timeout;  // milliseconds
+static unsigned int attempts;  // total, of all servers
+
+// MAX_SOCKETS of ipv4 and after MAX_SOCKETS of ipv6
+static struct dns_socket sockets[2 * MAX_SOCKETS];
+static unsigned int current[2];  // socket of new queries, by family
+static bool sockets_ready;       // fds of sockets are valid, -1 is closed
+
+// names of hosts file, only first name of each address
+static struct host_name *host_names;
+static size_t total_host_names;
+
+static struct request requests[MAX_INFLIGHT];
+static bool slot_used[MAX_INFLIGHT];
+static uint16_t slot_of_id[TOTAL_IDS];  // id to slot + 1, 0 is not used
+static uint16_t free_slots[MAX_INFLIGHT];
+static unsigned int total_free;
+
+/* written by main thread, read by thread of resolver. a queue by priority,
+   the queue of priority higher is sent first */
+struct queue_pending
+{
+  struct pending entries[MAX_PENDING];
+  unsigned int head, count;
+};
+
+static struct queue_pending pending[DNS_PRIORITIES];
+static pthread_mutex_t mutex_pending = PTHREAD_MUTEX_INITIALIZER;
+
+static int event_fd = -1;
+static bool stop;
+static pthread_t tid;
+static bool started;
+
+static uint32_t random_state;
+
+// random of kernel, by batch of ids
+static uint16_t random_ids[BATCH];
+static unsigned int random_left;
+
+static uint16_t
+xorshift ( void )
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+
+  return random_state & 0xffff;
+}
+
+static uint16_t
+random_id ( void )
+{
+  if ( !random_left )
+    {
+      // without entropy yet, not is blocked
+      if ( getrandom ( random_ids, sizeof random_ids, GRND_NONBLOCK ) !=
+           sizeof random_ids )
+        {
+          for ( unsigned int i = 0; i < BATCH; i++ )
+            random_ids[i] = xorshift ();
+        }
+
+      random_left = BATCH;
+    }
+
+  return random_ids[--random_left];
+}
+
+// id not used by other query in flight
+static uint16_t
+new_id ( void )
+{
+  uint16_t id;
+
+  while ( slot_of_id[id = random_id ()] )
+    ;
+
+  return id;
+}
+
+static void
+load_resolv_conf ( const char *path )
+{
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    {
+      ERROR_DEBUG ( "\"%s\"", path );
+      return;
+    }
+
+  char *line = NULL;
+  size_t size = 0;
+  char arg[INET6_ADDRSTRLEN + 1];
+
+  while ( getline ( &line, &size, file ) != -1 )
+    {
+      if ( total_servers < MAX_SERVERS &&
+           1 == sscanf ( line, "nameserver %46s", arg ) )
+        {
+          struct server *s = &servers[total_servers];
+
+          memset ( s, 0, sizeof *s );
+          if ( 1 == inet_pton ( AF_INET, arg, &s->addr.in.sin_addr ) )
+            {
+              s->addr.in.sin_family = AF_INET;
+              s->addr.in.sin_port = htons ( DNS_PORT );
+              total_servers++;
+            }
+          else if ( 1 == inet_pton ( AF_INET6, arg, &s->addr.in6.sin6_addr ) )
+            {
+              s->addr.in6.sin6_family = AF_INET6;
+              s->addr.in6.sin6_port = htons ( DNS_PORT );
+              total_servers++;
+            }
+
+          continue;
+        }
+
+      if ( strncmp ( line, "options", 7 ) )
+        continue;
+
+      char *opt;
+      if ( ( opt = strstr ( line, "timeout:" ) ) )
+        timeout = strtoul ( opt + 8, NULL, 10 );
+
+      if ( ( opt = strstr ( line, "attempts:" ) ) )
+        attempts = strtoul ( opt + 9, NULL, 10 );
+    }
+
+  free ( line );
+  fclose ( file );
+}
+
+static void
+load_hosts ( const char *path )
+{
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    return;
+
+  char *line = NULL;
+  size_t size = 0;
+  size_t max = 0;
+  char addr[INET6_ADDRSTRLEN + 1];
+  char name[NI_MAXHOST];
+
+  while ( getline ( &line, &size, file ) != -1 )
+    {
+      if ( 2 != sscanf ( line, "%46s %1024s", addr, name ) || *addr == '#' ||
+           *name == '#' )
+        continue;
+
+      union sockaddr_all sa = { 0 };
+      if ( 1 == inet_pton ( AF_INET, addr, &sa.in.sin_addr ) )
+        sa.sa.sa_family = AF_INET;
+      else if ( 1 == inet_pton ( AF_INET6, addr, &sa.in6.sin6_addr ) )
+        sa.sa.sa_family = AF_INET6;
+      else
+        continue;
+
+      // as libc, the first name of address
+      size_t i;
+      for ( i = 0; i < total_host_names; i++ )
+        {
+          if ( check_addr_equal ( &host_names[i].addr, &sa ) )
+            break;
+        }
+
+      if ( i < total_host_names )
+        continue;
+
+      if ( total_host_names == max )
+        {
+          size_t new_max = max ? max * 2 : 16;
+          void *p = realloc ( host_names, new_max * sizeof ( *host_names ) );
+          if ( !p )
+            break;
+
+          host_names = p;
+          max = new_max;
+        }
+
+      if ( !( host_names[total_host_names].name = strdup ( name ) ) )
+        break;
+
+      host_names[total_host_names++].addr = sa;
+    }
+
+  free ( line );
+  fclose ( file );
+}
+
+static const char *
+find_host_name ( union sockaddr_all *addr )
+{
+  for ( size_t i = 0; i < total_host_names; i++ )
+    {
+      if ( check_addr_equal ( &host_names[i].addr, addr ) )
+        return host_names[i].name;
+    }
+
+  return NULL;
+}
+
+static uint8_t *
+put_label ( uint8_t *p, const char *label )
+{
+  size_t len = strlen ( label );
+
+  *p++ = len;
+  memcpy ( p, label, len );
+
+  return p + len;
+}
+
+/* query of name 4.3.2.1.in-addr.arpa or of nibbles in reverse
+   order in ip6.arpa */
+static void
+build_query ( struct request *req )
+{
+  static const char hex[] = "0123456789abcdef";
+  uint8_t *p = req->query;
+
+  p[0] = req->id >> 8;
+  p[1] = req->id & 0xff;
+  p[2] = FLAG_RD >> 8;
+  p[3] = FLAG_RD & 0xff;
+  p[4] = 0;
+  p[5] = 1;  // qdcount
+  memset ( p + 6, 0, 6 );
+  p += DNS_HEADER;
+
+  const uint8_t *a = ( const uint8_t * ) &req->addr.in.sin_addr;
+  char label[4];
+
+  // as getnameinfo, ipv4 mapped in ipv6 is queried as ipv4
+  if ( req->addr.sa.sa_family == AF_INET6 &&
+       IN6_IS_ADDR_V4MAPPED ( &req->addr.in6.sin6_addr ) )
+    a = ( const uint8_t * ) &req->addr.in6.sin6_addr + 12;
+  else if ( req->addr.sa.sa_family == AF_INET6 )
+    a = NULL;
+
+  if ( a )
+    {
+
+      for ( int i = 3; i >= 0; i-- )
+        {
+          snprintf ( label, sizeof label, "%u", a[i] );
+          p = put_label ( p, label );
+        }
+
+      p = put_label ( p, "in-addr" );
+    }
+  else
+    {
+      a = ( const uint8_t * ) &req->addr.in6.sin6_addr;
+
+      for ( int i = 15; i >= 0; i-- )
+        {
+          *p++ = 1;
+          *p++ = hex[a[i] & 0x0f];
+          *p++ = 1;
+          *p++ = hex[a[i] >> 4];
+        }
+
+      p = put_label ( p, "ip6" );
+    }
+
+  p = put_label ( p, "arpa" );
+  *p++ = 0;
+
+  *p++ = 0;
+  *p++ = TYPE_PTR;
+  *p++ = 0;
+  *p++ = CLASS_IN;
+
+  req->len = p - req->query;
+}
+
+/* expand name (maybe compressed) in 'off' of message to text in 'buff',
+   return offset after name in message or -1 if malformed */
+static int
+read_name ( const uint8_t *msg,
+            size_t len,
+            size_t off,
+            char *buff,
+            size_t len_buff )
+{
+  size_t pos = 0;
+  int next = -1;
+  int jumps = 0;
+
+  while ( 1 )
+    {
+      if ( off >= len )
+        return -1;
+
+      uint8_t label = msg[off];
+
+      if ( ( label & 0xc0 ) == 0xc0 )
+        {
+          if ( off + 1 >= len || ++jumps > 16 )
+            return -1;
+
+          if ( next == -1 )
+            next = off + 2;
+
+          off = ( ( label & 0x3f ) << 8 ) | msg[off + 1];
+          continue;
+        }
+
+      if ( label & 0xc0 )
+        return -1;
+
+      off++;
+      if ( !label )
+        break;
+
+      if ( off + label > len || pos + label + 2 > len_buff )
+        return -1;
+
+      if ( pos )
+        buff[pos++] = '.';
+
+      memcpy ( buff + pos, msg + off, label );
+      pos += label;
+      off += label;
+    }
+
+  buff[pos] = '\0';
+
+  return ( next != -1 ) ? next : ( int ) off;
+}
+
+static int
+open_socket ( int family )
+{
+  int sock = socket ( family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  if ( sock == -1 )
+    {
+      ERROR_DEBUG ( "%s", "socket of dns" );
+    }
+
+  return sock;
+}
+
+static void
+close_socket ( unsigned int i )
+{
+  close ( sockets[i].fd );
+  sockets[i] = ( struct dns_socket ){ .fd = -1 };
+}
+
+/* socket to query of 'family', after QUERIES_BY_SOCKET queries is a new
+   socket (of a new source port), if there is a socket free. without it the
+   current is used */
+static unsigned int
+get_socket ( unsigned int family )
+{
+  unsigned int cur = current[family];
+
+  if ( sockets[cur].sent < QUERIES_BY_SOCKET )
+    return cur;
+
+  unsigned int first = family * MAX_SOCKETS;
+  for ( unsigned int i = first; i < first + MAX_SOCKETS; i++ )
+    {
+      if ( sockets[i].fd != -1 )
+        continue;
+
+      int fd = open_socket ( ( family ) ? AF_INET6 : AF_INET );
+      if ( fd == -1 )
+        break;
+
+      sockets[i] = ( struct dns_socket ){ .fd = fd };
+      current[family] = i;
+
+      // without queries in flight, answers not are expected
+      if ( !sockets[cur].inflight )
+        close_socket ( cur );
+
+      return i;
+    }
+
+  return cur;
+}
+
+// the last try of query not is more by socket 'i'
+static void
+socket_release ( unsigned int i )
+{
+  sockets[i].inflight--;
+
+  if ( !sockets[i].inflight && i != current[i / MAX_SOCKETS] )
+    close_socket ( i );
+}
+
+static void
+finish ( struct request *req, const char *name, unsigned int ttl )
+{
+  // callback can query again, slot is released before
+  dns_callback done = req->done;
+  void *arg = req->arg;
+  uint16_t slot = req - requests;
+
+  socket_release ( req->sock );
+
+  slot_of_id[req->id] = 0;
+  slot_used[slot] = false;
+  free_slots[total_free++] = slot;
+
+  done ( arg, name, ttl );
+}
+
+static uint32_t
+read_u32 ( const uint8_t *p )
+{
+  return ( ( uint32_t ) p[0] << 24 ) | ( p[1] << 16 ) | ( p[2] << 8 ) | p[3];
+}
+
+/* check answer to request and return true if was handled,
+   name of PTR is NULL if address not has name */
+static bool
+parse_answer ( const uint8_t *msg,
+               size_t len,
+               union sockaddr_all *from,
+               unsigned int sock )
+{
+  if ( len < DNS_HEADER )
+    return false;
+
+  uint16_t id = ( msg[0] << 8 ) | msg[1];
+  uint16_t flags = ( msg[2] << 8 ) | msg[3];
+  uint16_t qdcount = ( msg[4] << 8 ) | msg[5];
+  uint16_t ancount = ( msg[6] << 8 ) | msg[7];
+  uint16_t nscount = ( msg[8] << 8 ) | msg[9];
+
+  unsigned int slot = slot_of_id[id];
+  if ( !slot )
+    return false;
+
+  struct request *req = &requests[slot - 1];
+
+  if ( req->sock != sock || !( flags & FLAG_QR ) || qdcount != 1 )
+    return false;
+
+  // answer of server queried in the last try, to port of socket of query
+  struct server *server = &servers[( req->try - 1 ) % total_servers];
+  if ( !check_addr_equal ( &server->addr, from ) ||
+       server->addr.in.sin_port != from->in.sin_port )
+    return false;
+
+  // question must be the same of query
+  size_t qlen = req->len - DNS_HEADER;
+  if ( len < DNS_HEADER + qlen ||
+       memcmp ( msg + DNS_HEADER, req->query + DNS_HEADER, qlen ) )
+    return false;
+
+  // truncated, server failure... address stay without name
+  unsigned int rcode = flags & RCODE_MASK;
+  if ( ( flags & FLAG_TC ) || ( rcode && rcode != RCODE_NXDOMAIN ) )
+    {
+      finish ( req, NULL, 0 );
+      return true;
+    }
+
+  size_t off = DNS_HEADER + qlen;
+  char name[NI_MAXHOST];
+  unsigned int negative_ttl = 0;
+
+  /* first PTR, answers can have CNAME before (RFC 2317). without PTR
+     the TTL of negative answer is of SOA of authority (RFC 2308) */
+  for ( unsigned int i = 0; i < ( unsigned int ) ancount + nscount; i++ )
+    {
+      int r = read_name ( msg, len, off, name, sizeof name );
+      if ( r == -1 || ( size_t ) r + 10 > len )
+        break;
+
+      off = r;
+      uint16_t type = ( msg[off] << 8 ) | msg[off + 1];
+      uint16_t class = ( msg[off + 2] << 8 ) | msg[off + 3];
+      uint32_t ttl = read_u32 ( msg + off + 4 );
+      uint16_t rdlen = ( msg[off + 8] << 8 ) | msg[off + 9];
+      off += 10;
+
+      if ( off + rdlen > len )
+        break;
+
+      if ( i < ancount && !rcode && type == TYPE_PTR && class == CLASS_IN &&
+           -1 != read_name ( msg, len, off, name, sizeof name ) && *name )
+        {
+          finish ( req, name, ttl );
+          return true;
+        }
+
+      if ( i >= ancount && type == TYPE_SOA )
+        {
+          // mname and rname, with serial, refresh, retry, expire and minimum
+          int p = read_name ( msg, len, off, name, sizeof name );
+          if ( p != -1 )
+            p = read_name ( msg, len, p, name, sizeof name );
+
+          if ( p != -1 && ( size_t ) p + 20 <= off + rdlen )
+            negative_ttl = MIN ( ttl, read_u32 ( msg + p + 16 ) );
+        }
+
+      off += rdlen;
+    }
+
+  finish ( req, NULL, negative_ttl );
+  return true;
+}
+
+// queries of a socket, by family
+struct batch
+{
+  struct mmsghdr msgs[BATCH];
+  struct iovec iovs[BATCH];
+  unsigned int count;
+  unsigned int sock;
+};
+
+static void
+batch_flush ( struct batch *batch )
+{
+  unsigned int sent = 0;
+
+  // lost packets are resent in timeout
+  while ( sent < batch->count )
+    {
+      int r = sendmmsg ( sockets[batch->sock].fd,
+                         batch->msgs + sent,
+                         batch->count - sent,
+                         MSG_DONTWAIT );
+      if ( r <= 0 )
+        break;
+
+      sent += r;
+    }
+
+  batch->count = 0;
+}
+
+static void
+send_query ( struct batch *batches, struct request *req, uint64_t now )
+{
+  struct server *server = &servers[req->try % total_servers];
+  struct batch *batch = &batches[server->family];
+
+  // a batch is sent by only one socket
+  unsigned int sock = get_socket ( server->family );
+  if ( batch->count == BATCH || ( batch->count && batch->sock != sock ) )
+    batch_flush ( batch );
+
+  if ( req->try )
+    socket_release ( req->sock );
+
+  req->sock = sock;
+  sockets[sock].inflight++;
+  sockets[sock].sent++;
+
+  req->try++;
+  req->deadline = now + timeout;
+
+  batch->sock = sock;
+
+  unsigned int i = batch->count++;
+  batch->iovs[i] =
+          ( struct iovec ){ .iov_base = req->query, .iov_len = req->len };
+  batch->msgs[i].msg_hdr =
+          ( struct msghdr ){ .msg_name = &server->addr,
+                             .msg_namelen = ( server->family )
+                                                    ? sizeof ( struct
+                                                               sockaddr_in6 )
+                                                    : sizeof ( struct
+                                                               sockaddr_in ),
+                             .msg_iov = &batch->iovs[i],
+                             .msg_iovlen = 1 };
+}
+
+// name of hosts file, its callback is called after the lock of pending
+struct host_hit
+{
+  dns_callback done;
+  void *arg;
+  const char *name;
+};
+
+/* move addresses pending to slots of query, addresses of hosts file go to
+   'hits', up to BATCH. return total of hits */
+static unsigned int
+take_pending ( struct batch *batches, uint64_t now, struct host_hit *hits )
+{
+  unsigned int total_hits = 0;
+  unsigned int prio = 0;
+
+  pthread_mutex_lock ( &mutex_pending );
+
+  while ( total_free && total_hits < BATCH )
+    {
+      struct queue_pending *queue = &pending[prio];
+
+      if ( !queue->count )
+        {
+          if ( ++prio == DNS_PRIORITIES )
+            break;
+
+          continue;
+        }
+
+      struct pending pend = queue->entries[queue->head];
+
+      queue->head = ( queue->head + 1 ) % MAX_PENDING;
+      queue->count--;
+
+      // moved to queue of priority higher
+      if ( !pend.done )
+        continue;
+
+      const char *name = find_host_name ( &pend.addr );
+      if ( name )
+        {
+          hits[total_hits++] = ( struct host_hit ){ .done = pend.done,
+                                                    .arg = pend.arg,
+                                                    .name = name };
+          continue;
+        }
+
+      uint16_t slot = free_slots[--total_free];
+      struct request *req = &requests[slot];
+
+      slot_used[slot] = true;
+      req->addr = pend.addr;
+      req->done = pend.done;
+      req->arg = pend.arg;
+      req->try = 0;
+      req->id = new_id ();
+      slot_of_id[req->id] = slot + 1;
+
+      build_query ( req );
+      send_query ( batches, req, now );
+    }
+
+  pthread_mutex_unlock ( &mutex_pending );
+
+  return total_hits;
+}
+
+static void
+start_pending ( struct batch *batches, uint64_t now )
+{
+  struct host_hit hits[BATCH];
+  unsigned int total;
+
+  // callback can query again, so it is called without lock, as in finish
+  do
+    {
+      total = take_pending ( batches, now, hits );
+
+      for ( unsigned int i = 0; i < total; i++ )
+        hits[i].done ( hits[i].arg, hits[i].name, 0 );
+    }
+  while ( total == BATCH );
+}
+
+// resend queries expired or finish if all attempts failed
+static int
+check_timeouts ( struct batch *batches, uint64_t now )
+{
+  uint64_t next = now + timeout;
+
+  for ( unsigned int i = 0; i < MAX_INFLIGHT; i++ )
+    {
+      if ( !slot_used[i] )
+        continue;
+
+      struct request *req = &requests[i];
+
+      if ( req->deadline <= now )
+        {
+          if ( req->try >= attempts )
+            {
+              finish ( req, NULL, 0 );
+              continue;
+            }
+
+          send_query ( batches, req, now );
+        }
+
+      next = MIN ( next, req->deadline );
+    }
+
+  return next - now;
+}
+
+static void
+read_answers ( unsigned int sock )
+{
+  static uint8_t buffers[BATCH][DNS_MAX_PACKET];
+  static struct mmsghdr msgs[BATCH];
+  static struct iovec iovs[BATCH];
+  static union sockaddr_all from[BATCH];
+
+  while ( 1 )
+    {
+      for ( unsigned int i = 0; i < BATCH; i++ )
+        {
+          iovs[i] = ( struct iovec ){ .iov_base = buffers[i],
+                                      .iov_len = DNS_MAX_PACKET };
+          msgs[i].msg_hdr = ( struct msghdr ){ .msg_name = &from[i],
+                                               .msg_namelen = sizeof from[i],
+                                               .msg_iov = &iovs[i],
+                                               .msg_iovlen = 1 };
+        }
+
+      // the socket is closed by answer of your last query
+      if ( sockets[sock].fd == -1 )
+        break;
+
+      int r = recvmmsg ( sockets[sock].fd, msgs, BATCH, MSG_DONTWAIT, NULL );
+      if ( r <= 0 )
+        break;
+
+      for ( int i = 0; i < r; i++ )
+        parse_answer ( buffers[i], msgs[i].msg_len, &from[i], sock );
+
+      if ( r < BATCH )
+        break;
+    }
+}
+
+static void *
+dns_loop ( __attribute__ ( ( unused ) ) void *arg )
+{
+  struct batch batches[2] = { { .sock = current[0] },
+                               { .sock = current[1] } };
+  struct pollfd pfd[1 + ARRAY_SIZE ( sockets )];
+
+  int wait = -1;
+
+  // not dispute CPUs with capture
+  affinity_avoid_capture ();
+
+  while ( !__atomic_load_n ( &stop, __ATOMIC_ACQUIRE ) )
+    {
+      // sockets change with queries, socket -1 is ignored by poll
+      pfd[0] = ( struct pollfd ){ .fd = event_fd, .events = POLLIN };
+      for ( unsigned int i = 0; i < ARRAY_SIZE ( sockets ); i++ )
+        pfd[i + 1] = ( struct pollfd ){ .fd = sockets[i].fd,
+                                        .events = POLLIN };
+
+      if ( poll ( pfd, ARRAY_SIZE ( pfd ), wait ) == -1 )
+        continue;
+
+      if ( pfd[0].revents & POLLIN )
+        {
+          uint64_t value;
+          if ( read ( event_fd, &value, sizeof value ) == -1 )
+            {
+              ERROR_DEBUG ( "%s", "read eventfd" );
+            }
+        }
+
+      for ( unsigned int i = 0; i < ARRAY_SIZE ( sockets ); i++ )
+        {
+          if ( pfd[i + 1].revents & POLLIN )
+            read_answers ( i );
+        }
+
+      uint64_t now = get_time ();
+
+      // answers released slots to pending
+      start_pending ( batches, now );
+
+      wait = ( total_free < MAX_INFLIGHT ) ? check_timeouts ( batches, now )
+                                           : -1;
+
+      batch_flush ( &batches[0] );
+      batch_flush ( &batches[1] );
+    }
+
+  return NULL;
+}
+
+int
+dns_init ( const char *resolv_conf, const char *hosts )
+{
+  timeout = DEFAULT_TIMEOUT;
+  attempts = DEFAULT_ATTEMPTS;
+  total_servers = 0;
+
+  load_resolv_conf ( resolv_conf ? resolv_conf : RESOLV_CONF );
+  if ( !total_servers )
+    return 0;
+
+  timeout = MIN ( MAX ( timeout, 1 ), MAX_TIMEOUT ) * 1000;
+  attempts = MIN ( MAX ( attempts, 1 ), MAX_ATTEMPTS ) * total_servers;
+
+  for ( unsigned int i = 0; i < ARRAY_SIZE ( sockets ); i++ )
+    sockets[i] = ( struct dns_socket ){ .fd = -1 };
+
+  sockets_ready = true;
+
+  // first socket of each family of servers
+  for ( unsigned int i = 0; i < total_servers; i++ )
+    {
+      unsigned int family = servers[i].addr.sa.sa_family == AF_INET6;
+      struct dns_socket *sock = &sockets[family * MAX_SOCKETS];
+
+      servers[i].family = family;
+      current[family] = family * MAX_SOCKETS;
+
+      if ( sock->fd == -1 &&
+           -1 == ( sock->fd = open_socket ( servers[i].addr.sa.sa_family ) ) )
+        goto ERROR;
+    }
+
+  if ( -1 == ( event_fd = eventfd ( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) )
+    goto ERROR;
+
+  if ( getrandom ( &random_state, sizeof random_state, 0 ) == -1 ||
+       !random_state )
+    random_state = get_time () | 1;
+
+  random_left = 0;
+  memset ( slot_of_id, 0, sizeof slot_of_id );
+
+  total_free = 0;
+  for ( int i = MAX_INFLIGHT - 1; i >= 0; i-- )
+    {
+      slot_used[i] = false;
+      free_slots[total_free++] = i;
+    }
+
+  memset ( pending, 0, sizeof pending );
+
+  load_hosts ( hosts ? hosts : HOSTS );
+
+  // signals must be delivered only to main thread
+  sigset_t set, old_set;
+  sigfillset ( &set );
+  pthread_sigmask ( SIG_SETMASK, &set, &old_set );
+
+  stop = false;
+  started = !pthread_create ( &tid, NULL, dns_loop, NULL );
+
+  pthread_sigmask ( SIG_SETMASK, &old_set, NULL );
+
+  if ( !started )
+    goto ERROR;
+
+  return 1;
+
+ERROR:
+  dns_free ();
+  return 0;
+}
+
+static bool
+pending_push ( unsigned int prio, struct pending *pend )
+{
+  struct queue_pending *queue = &pending[prio];
+
+  if ( queue->count == MAX_PENDING )
+    return false;
+
+  unsigned int i = ( queue->head + queue->count++ ) % MAX_PENDING;
+  queue->entries[i] = *pend;
+
+  return true;
+}
+
+static void
+wake_loop ( void )
+{
+  uint64_t value = 1;
+  if ( write ( event_fd, &value, sizeof value ) == -1 )
+    {
+      ERROR_DEBUG ( "%s", "write eventfd" );
+    }
+}
+
+int
+dns_query ( const union sockaddr_all *addr,
+            unsigned int priority,
+            dns_callback done,
+            void *arg )
+{
+  if ( !started )
+    return 0;
+
+  struct pending pend = { .addr = *addr, .done = done, .arg = arg };
+
+  pthread_mutex_lock ( &mutex_pending );
+  bool ok = pending_push ( MIN ( priority, DNS_PRIORITIES - 1 ), &pend );
+  pthread_mutex_unlock ( &mutex_pending );
+
+  if ( ok )
+    wake_loop ();
+
+  return ok;
+}
+
+int
+dns_promote ( void *arg, unsigned int priority )
+{
+  if ( !started )
+    return 0;
+
+  bool found = false;
+
+  pthread_mutex_lock ( &mutex_pending );
+
+  // the entry of queue lower stay without callback, and is skipped
+  for ( unsigned int p = priority + 1; p < DNS_PRIORITIES && !found; p++ )
+    {
+      struct queue_pending *queue = &pending[p];
+
+      for ( unsigned int i = 0; i < queue->count; i++ )
+        {
+          struct pending *pend =
+                  &queue->entries[( queue->head + i ) % MAX_PENDING];
+
+          if ( pend->arg != arg || !pend->done )
+            continue;
+
+          if ( pending_push ( priority, pend ) )
+            pend->done = NULL;
+
+          found = true;
+          break;
+        }
+    }
+
+  pthread_mutex_unlock ( &mutex_pending );
+
+  if ( found )
+    wake_loop ();
+
+  return found;
+}
+
+void
+dns_free ( void )
+{
+  if ( started )
+    {
+      __atomic_store_n ( &stop, true, __ATOMIC_RELEASE );
+
+      uint64_t value = 1;
+      if ( write ( event_fd, &value, sizeof value ) == -1 )
+        {
+          ERROR_DEBUG ( "%s", "write eventfd" );
+        }
+
+      pthread_join ( tid, NULL );
+      started = false;
+    }
+
+  if ( event_fd != -1 )
+    close ( event_fd );
+
+  event_fd = -1;
+
+  for ( unsigned int i = 0; sockets_ready && i < ARRAY_SIZE ( sockets ); i++ )
+    {
+      if ( sockets[i].fd != -1 )
+        close_socket ( i );
+    }
+
+  sockets_ready = false;
+
+  for ( size_t i = 0; i < total_host_names; i++ )
+    free ( host_names[i].name );
+
+  free ( host_names );
+  host_names = NULL;
+  total_host_names = 0;
+}
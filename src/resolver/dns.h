@@ -0,0 +1,64 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DNS_H
+#define DNS_H
+
+#include "../sockaddr.h"  // union sockaddr_all
+
+/* asynchronous client of DNS to reverse lookups (PTR), one thread with event
+   loop send all queries in same UDP socket (one by family of nameservers),
+   with retries and timeouts of resolv.conf. addresses of hosts file
+   are answered without query */
+
+/* called in thread of resolver with name of address, or NULL if
+   the address not has name (or on timeout). 'ttl' in seconds of answer,
+   of name or of negative answer, 0 if unknown */
+typedef void ( *dns_callback ) ( void *arg,
+                                 const char *name,
+                                 unsigned int ttl );
+
+/* NULL to default paths, return 0 if there are no nameservers or
+   on failure, so lookups should be done otherwise (getnameinfo) */
+int
+dns_init ( const char *resolv_conf, const char *hosts );
+
+// levels of priority of queries, 0 is the highest
+#define DNS_PRIORITIES 3
+
+/* query name of address, 'done' is called when lookup finish. queries
+   pending are sent by 'priority', of 0 to DNS_PRIORITIES - 1.
+   return 0 if not initialized or if there are too many queries pending */
+int
+dns_query ( const union sockaddr_all *addr,
+            unsigned int priority,
+            dns_callback done,
+            void *arg );
+
+/* move query of 'arg' still pending to 'priority' higher,
+   return 0 if query was not found (already sent) */
+int
+dns_promote ( void *arg, unsigned int priority );
+
+/* queries pending are discarded, without call of callback */
+void
+dns_free ( void );
+
+#endif  // DNS_H
@@ -17,24 +17,51 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>  // PRIu64, SCNu64
 #include <stdint.h>
+#include <stdio.h>       // fopen
 #include <stdlib.h>      // malloc, free
 #include <string.h>      // strncpy
+#include <time.h>        // time
+#include <arpa/inet.h>   // inet_pton
+#include <ifaddrs.h>     // getifaddrs
 #include <sys/socket.h>  // getnameinfo
 #include <netdb.h>       // getnameinfo
 
 #include "domain.h"
 #include "thread_pool.h"
+#include "dns.h"
 #include "sock_util.h"  // check_addr_equal
 #include "../jhash.h"
 #include "../hashtable.h"
+#include "../timer.h"  // get_time
+#include "../macro_util.h"
+#include "../m_error.h"
 
-// (2048 * sizeof(struct host)) == ~2.31 MiB cache of domain
-#define DEFAULT_CACHE_SIZE 2048
+// bytes of memory of cache, names included
+#define DEFAULT_CACHE_SIZE ( 2 * 1024 * 1024 )
+
+// estimate of memory of entry in hashtable and of malloc
+#define ENTRY_OVERHEAD 64
+#define ENTRY_SIZE ( sizeof ( struct host ) + ENTRY_OVERHEAD )
+
+// seconds, TTL 0 is unknown (getnameinfo, hosts file or timeout)
+#define DEFAULT_TTL 3600
+#define NEGATIVE_TTL 60
+#define MIN_TTL 30
+#define MAX_TTL 86400
+#define MAX_NEGATIVE_TTL 300
+
+#define CACHE_FILE_HEADER "# netproc cache of domain\n"
 
 static hashtable_t *ht_hosts = NULL;
-static struct host **hosts = NULL;
-static size_t cache_size;
+static struct host *lru_head, *lru_tail;
+static size_t cache_size;   // limit
+static size_t cache_bytes;  // in use
+static const char *cache_file;
+
+// changed when a name is resolved or removed of cache
+static uint32_t generation;
 
 static bool
 cb_ht_compare ( const void *key1, const void *key2 )
@@ -52,12 +79,12 @@ cb_ht_hash ( const void *key )
     {
       case AF_INET:
         return jhash32 ( ( uint32_t * ) &addr->in.sin_addr,
-                         sizeof ( addr->in.sin_addr ),
+                         sizeof ( addr->in.sin_addr ) / sizeof ( uint32_t ),
                          0 );
         break;
       case AF_INET6:
         return jhash32 ( ( uint32_t * ) &addr->in6.sin6_addr,
-                         sizeof ( addr->in6.sin6_addr ),
+                         sizeof ( addr->in6.sin6_addr ) / sizeof ( uint32_t ),
                          0 );
         break;
       default:
@@ -65,24 +92,131 @@ cb_ht_hash ( const void *key )
     }
 }
 
-int
-cache_domain_init ( unsigned int size )
+static void
+host_free ( void *arg )
 {
-  cache_size = ( size ) ? size : DEFAULT_CACHE_SIZE;
-  hosts = calloc ( cache_size, sizeof ( struct host * ) );
+  struct host *host = arg;
 
-  if ( !hosts )
-    return 0;
+  free ( host->name );
+  free ( host->result );
+  free ( host );
+}
 
-  ht_hosts = hashtable_new ( cb_ht_hash, cb_ht_compare, free );
+static size_t
+host_size ( struct host *host )
+{
+  return ENTRY_SIZE + ( ( host->name ) ? strlen ( host->name ) + 1 : 0 );
+}
 
-  if ( !ht_hosts )
+static void
+lru_unlink ( struct host *host )
+{
+  if ( host->prev )
+    host->prev->next = host->next;
+  else
+    lru_head = host->next;
+
+  if ( host->next )
+    host->next->prev = host->prev;
+  else
+    lru_tail = host->prev;
+
+  host->prev = host->next = NULL;
+}
+
+static void
+lru_push_head ( struct host *host )
+{
+  host->prev = NULL;
+  host->next = lru_head;
+
+  if ( lru_head )
+    lru_head->prev = host;
+  else
+    lru_tail = host;
+
+  lru_head = host;
+}
+
+static void
+lru_push_tail ( struct host *host )
+{
+  host->next = NULL;
+  host->prev = lru_tail;
+
+  if ( lru_tail )
+    lru_tail->next = host;
+  else
+    lru_head = host;
+
+  lru_tail = host;
+}
+
+static bool
+cache_insert ( struct host *host, bool recent )
+{
+  if ( !hashtable_set ( ht_hosts, &host->sa_all, host ) )
+    return false;
+
+  if ( recent )
+    lru_push_head ( host );
+  else
+    lru_push_tail ( host );
+
+  cache_bytes += host_size ( host );
+
+  return true;
+}
+
+static void
+cache_remove ( struct host *host )
+{
+  lru_unlink ( host );
+  hashtable_remove ( ht_hosts, &host->sa_all );
+  cache_bytes -= host_size ( host );
+  host_free ( host );
+}
+
+/* remove the least recently used until has 'need' bytes free,
+   entries resolving are in use by threads and stay */
+static bool
+cache_evict ( size_t need )
+{
+  struct host *host = lru_tail;
+  bool evicted = false;
+
+  while ( host && cache_bytes + need > cache_size )
     {
-      free ( hosts );
-      return 0;
+      struct host *prev = host->prev;
+
+      if ( !host->local &&
+           __atomic_load_n ( &host->status, __ATOMIC_ACQUIRE ) != RESOLVING )
+        {
+          cache_remove ( host );
+          evicted = true;
+        }
+
+      host = prev;
     }
 
-  return 1;
+  if ( evicted )
+    __atomic_add_fetch ( &generation, 1, __ATOMIC_RELEASE );
+
+  return cache_bytes + need <= cache_size;
+}
+
+// run on thread, of pool or of dns client
+static void
+ip2domain_done ( void *arg, const char *name, unsigned int ttl )
+{
+  struct host *host = ( struct host * ) arg;
+
+  // without memory address stay without name, until expire
+  host->result = ( name ) ? strdup ( name ) : NULL;
+  host->ttl = ttl;
+
+  __atomic_store_n ( &host->status, DONE, __ATOMIC_RELEASE );
+  __atomic_add_fetch ( &generation, 1, __ATOMIC_RELEASE );
 }
 
 // run on thread
@@ -90,78 +224,342 @@ static void
 ip2domain_exec ( void *arg )
 {
   struct host *host = ( struct host * ) arg;
+  char name[NI_MAXHOST];
 
   // convert ipv4 and ipv6
-  // if error, convert to text ip same
+  // if error, address without name
   if ( getnameinfo ( &host->sa_all.sa,
                      sizeof ( host->sa_all ),
-                     host->fqdn,
-                     sizeof ( host->fqdn ),
+                     name,
+                     sizeof ( name ),
                      NULL,
                      0,
-                     NI_DGRAM ) )
+                     NI_DGRAM | NI_NAMEREQD ) )
     {
-      sockaddr_ntop ( &host->sa_all, host->fqdn, sizeof ( host->fqdn ) );
+      ip2domain_done ( host, NULL, 0 );
+      return;
     }
 
+  ip2domain_done ( host, name, 0 );
+}
+
+/* query in client of dns, without nameservers to client a task to
+   workers (thread pool) with getnameinfo */
+static bool
+resolve ( struct host *host, unsigned int priority )
+{
+  __atomic_store_n ( &host->status, RESOLVING, __ATOMIC_RELAXED );
+  host->priority = priority;
+
+  if ( dns_query ( &host->sa_all, priority, ip2domain_done, host ) ||
+       add_task ( ip2domain_exec, host ) )
+    return true;
+
+  __atomic_store_n ( &host->status, RESOLVED, __ATOMIC_RELAXED );
+  return false;
+}
+
+// name resolved by thread become the name of host
+static void
+adopt_result ( struct host *host, uint64_t now )
+{
+  size_t old_size = host_size ( host );
+  unsigned int ttl = host->ttl;
+
+  free ( host->name );
+  host->name = host->result;
+  host->result = NULL;
+
+  if ( host->name )
+    ttl = ( ttl ) ? MIN ( MAX ( ttl, MIN_TTL ), MAX_TTL ) : DEFAULT_TTL;
+  else
+    ttl = ( ttl ) ? MIN ( MAX ( ttl, MIN_TTL ), MAX_NEGATIVE_TTL )
+                  : NEGATIVE_TTL;
+
+  host->expire = ( host->local ) ? UINT64_MAX : now + ttl * 1000ULL;
+  cache_bytes = cache_bytes - old_size + host_size ( host );
+
   host->status = RESOLVED;
 }
 
+static void
+cache_load ( const char *path, uint64_t now )
+{
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    return;
+
+  char addr[INET6_ADDRSTRLEN + 1];
+  char name[NI_MAXHOST];
+  uint64_t expire;
+  time_t wall = time ( NULL );
+
+  char *line = NULL;
+  size_t size = 0;
+
+  // entries are in order of most recent to least
+  while ( getline ( &line, &size, file ) != -1 )
+    {
+      if ( 3 !=
+           sscanf ( line, "%46s %" SCNu64 " %1024s", addr, &expire, name ) )
+        continue;
+
+      union sockaddr_all sa = { 0 };
+
+      if ( 1 == inet_pton ( AF_INET, addr, &sa.in.sin_addr ) )
+        sa.sa.sa_family = AF_INET;
+      else if ( 1 == inet_pton ( AF_INET6, addr, &sa.in6.sin6_addr ) )
+        sa.sa.sa_family = AF_INET6;
+      else
+        continue;
+
+      if ( expire <= ( uint64_t ) wall || hashtable_get ( ht_hosts, &sa ) )
+        continue;
+
+      struct host *host = calloc ( 1, sizeof *host );
+      if ( !host )
+        break;
+
+      host->sa_all = sa;
+      host->status = RESOLVED;
+      host->expire = now + MIN ( expire - wall, MAX_TTL ) * 1000ULL;
+
+      // '-' is address without name
+      if ( strcmp ( name, "-" ) && !( host->name = strdup ( name ) ) )
+        {
+          free ( host );
+          break;
+        }
+
+      if ( cache_bytes + host_size ( host ) > cache_size ||
+           !cache_insert ( host, false ) )
+        {
+          host_free ( host );
+          break;
+        }
+    }
+
+  free ( line );
+  fclose ( file );
+}
+
+// entries not expired, file is replaced only when all was written
+static void
+cache_save ( const char *path, uint64_t now )
+{
+  char tmp[4096];
+  snprintf ( tmp, sizeof tmp, "%s.tmp", path );
+
+  FILE *file = fopen ( tmp, "w" );
+  if ( !file )
+    {
+      ERROR_DEBUG ( "\"%s\"", tmp );
+      return;
+    }
+
+  fputs ( CACHE_FILE_HEADER, file );
+
+  time_t wall = time ( NULL );
+  char addr[INET6_ADDRSTRLEN];
+
+  for ( struct host *host = lru_head; host; host = host->next )
+    {
+      int status = __atomic_load_n ( &host->status, __ATOMIC_ACQUIRE );
+
+      if ( status == DONE )
+        adopt_result ( host, now );
+      else if ( status == RESOLVING && !host->name )
+        continue;
+
+      // resolved again in each start
+      if ( host->local )
+        continue;
+
+      if ( host->expire <= now )
+        continue;
+
+      sockaddr_ntop ( &host->sa_all, addr, sizeof addr );
+      fprintf ( file,
+                "%s %" PRIu64 " %s\n",
+                addr,
+                ( uint64_t ) wall + ( host->expire - now ) / 1000,
+                ( host->name ) ? host->name : "-" );
+    }
+
+  if ( fclose ( file ) || rename ( tmp, path ) )
+    {
+      ERROR_DEBUG ( "\"%s\"", path );
+      remove ( tmp );
+    }
+}
+
+int
+cache_domain_init ( size_t size, const char *file )
+{
+  cache_size = ( size ) ? size : DEFAULT_CACHE_SIZE;
+  cache_bytes = 0;
+  cache_file = file;
+  lru_head = lru_tail = NULL;
+
+  ht_hosts = hashtable_new ( cb_ht_hash, cb_ht_compare, host_free );
+
+  if ( !ht_hosts )
+    return 0;
+
+  // warm start, names of last run are not queried again
+  if ( cache_file )
+    cache_load ( cache_file, get_time () );
+
+  return 1;
+}
+
 // return:
 //  1 name resolved
 //  0 name no resolved
 // -1 error
 int
-ip2domain ( union sockaddr_all *sa_all, char *buff, const size_t buff_len )
+ip2domain ( union sockaddr_all *sa_all,
+            unsigned int priority,
+            char *buff,
+            const size_t buff_len )
 {
   struct host *host = hashtable_get ( ht_hosts, sa_all );
+  uint64_t now = get_time ();
 
-  if ( host )
+  if ( !host )  // cache miss
     {
-      if ( host->status == RESOLVED )  // cache hit
-        {
-          strncpy ( buff, host->fqdn, buff_len );
-          return 1;
-        }
-      else  // resolving, thread working
+      sockaddr_ntop ( sa_all, buff, buff_len );
+
+      // cache full of names resolving, try again later
+      if ( !cache_evict ( ENTRY_SIZE ) )
+        return 0;
+
+      if ( !( host = calloc ( 1, sizeof ( *host ) ) ) )
+        return -1;
+
+      memcpy ( &host->sa_all, sa_all, sizeof ( *sa_all ) );
+
+      if ( !cache_insert ( host, true ) )
         {
-          sockaddr_ntop ( sa_all, buff, buff_len );
-          return 0;
+          free ( host );
+          return -1;
         }
+
+      // with pool full try again later
+      if ( !resolve ( host, priority ) )
+        cache_remove ( host );
+
+      return 0;
     }
-  else  // cache miss
+
+  int status = __atomic_load_n ( &host->status, __ATOMIC_ACQUIRE );
+
+  if ( status == DONE )
     {
-      sockaddr_ntop ( sa_all, buff, buff_len );
+      adopt_result ( host, now );
+      status = RESOLVED;
+    }
 
-      static size_t index = 0;
+  if ( host != lru_head )
+    {
+      lru_unlink ( host );
+      lru_push_head ( host );
+    }
 
-      if ( hosts[index] )
-        {
-          if ( hosts[index]->status == RESOLVING )
-            return 0;
+  // expired, name old is shown until the new is resolved
+  if ( status == RESOLVED && host->expire <= now &&
+       resolve ( host, priority ) )
+    status = RESOLVING;
 
-          hashtable_remove ( ht_hosts, &hosts[index]->sa_all );
-        }
-      else
-        {
-          hosts[index] = malloc ( sizeof ( struct host ) );
+  // coalesced in lookup pending, that now is more urgent
+  if ( status == RESOLVING && priority < host->priority )
+    {
+      dns_promote ( host, priority );
+      host->priority = priority;
+    }
+
+  if ( host->name )
+    {
+      strncpy ( buff, host->name, buff_len - 1 );
+      buff[buff_len - 1] = '\0';
+      return 1;
+    }
+
+  sockaddr_ntop ( sa_all, buff, buff_len );
 
-          if ( !hosts[index] )
-            return -1;
+  return ( status == RESOLVED );
+}
+
+void
+domain_resolve_locals ( void )
+{
+  struct ifaddrs *ifaddr;
+
+  if ( getifaddrs ( &ifaddr ) == -1 )
+    {
+      ERROR_DEBUG ( "%s", "getifaddrs" );
+      return;
+    }
+
+  for ( struct ifaddrs *ifa = ifaddr; ifa; ifa = ifa->ifa_next )
+    {
+      if ( !ifa->ifa_addr || ( ifa->ifa_addr->sa_family != AF_INET &&
+                               ifa->ifa_addr->sa_family != AF_INET6 ) )
+        continue;
+
+      union sockaddr_all sa = { 0 };
+      memcpy ( &sa,
+               ifa->ifa_addr,
+               ( ifa->ifa_addr->sa_family == AF_INET )
+                       ? sizeof ( sa.in )
+                       : sizeof ( sa.in6 ) );
+
+      struct host *host = hashtable_get ( ht_hosts, &sa );
+      if ( host )
+        {
+          host->local = true;
+          continue;
         }
 
-      memcpy ( &hosts[index]->sa_all, sa_all, sizeof ( *sa_all ) );
-      hosts[index]->status = RESOLVING;
+      if ( !( host = calloc ( 1, sizeof *host ) ) )
+        break;
 
-      // add task to workers (thread pool)
-      add_task ( ip2domain_exec, hosts[index] );
+      host->sa_all = sa;
+      host->local = true;
 
-      hashtable_set ( ht_hosts, &hosts[index]->sa_all, hosts[index] );
+      if ( !cache_insert ( host, false ) )
+        {
+          free ( host );
+          break;
+        }
 
-      index = ( index + 1 ) % cache_size;
+      if ( !resolve ( host, DOMAIN_PRIO_BACKGROUND ) )
+        cache_remove ( host );
     }
 
-  return 0;
+  freeifaddrs ( ifaddr );
+}
+
+uint32_t
+domain_generation ( void )
+{
+  return __atomic_load_n ( &generation, __ATOMIC_ACQUIRE );
+}
+
+size_t
+cache_domain_memory ( void )
+{
+  return cache_bytes;
+}
+
+void
+cache_domain_shrink ( size_t size )
+{
+  if ( !ht_hosts || size >= cache_size )
+    return;
+
+  cache_size = size;
+  cache_evict ( 0 );
 }
 
 void
@@ -170,6 +568,10 @@ cache_domain_free ( void )
   if ( !ht_hosts )
     return;
 
+  if ( cache_file )
+    cache_save ( cache_file, get_time () );
+
   hashtable_destroy ( ht_hosts );
-  free ( hosts );
+  ht_hosts = NULL;
+  lru_head = lru_tail = NULL;
 }
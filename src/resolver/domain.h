@@ -20,29 +20,71 @@
 #ifndef DOMAIN_H
 #define DOMAIN_H
 
-#include <netdb.h>  // NI_MAXHOST
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+#include <stdint.h>  // uint32_t
 
 #include "../sockaddr.h"  // union sockaddr_all
 
 struct host
 {
   union sockaddr_all sa_all;
-  char fqdn[NI_MAXHOST];
+  struct host *prev, *next;  // list LRU, head is the most recent
+  char *name;                // NULL if address not has name
+  char *result;              // name resolved, written by thread
+  uint64_t expire;           // milliseconds, of get_time
+  unsigned int ttl;          // seconds, written by thread
+  unsigned int priority;     // of last query, see DOMAIN_PRIO_*
+  bool local;                // address of interface, not expire
   int status;
 };
 
 // host.status
 #define RESOLVED 1
 #define RESOLVING 2
+#define DONE 3  // thread finished, result not yet in 'name'
 
+/* priorities of lookups, addresses of rows in screen first, after rows
+   near of screen (sorted by rate, so the next top talkers) and after
+   the others, as addresses of interfaces */
+#define DOMAIN_PRIO_VISIBLE 0
+#define DOMAIN_PRIO_NEAR 1
+#define DOMAIN_PRIO_BACKGROUND 2
+
+/* cache limited by memory, 'size' in bytes, 0 is default. if 'file' is not
+   NULL, names not expired are read of file and saved on exit */
 int
-cache_domain_init ( unsigned int size );
+cache_domain_init ( size_t size, const char *file );
 
 // retorna imediatamente o ip em formato de texto, porém na proxima requisição
 // irá retornar o dominio que estará em cache (se tudo der certo).
 // evitando a latencia que uma consulta DNS pode ter.
+// names expired are shown while resolved again. a address already
+// resolving is not queried again, only its 'priority' can be raised
 int
-ip2domain ( union sockaddr_all *sa_all, char *buff, const size_t buff_len );
+ip2domain ( union sockaddr_all *sa_all,
+            unsigned int priority,
+            char *buff,
+            const size_t buff_len );
+
+/* addresses of interfaces are resolved once, in background,
+   and are kept in cache while running */
+void
+domain_resolve_locals ( void );
+
+/* changed each time that the result of ip2domain to a address can change,
+   so names formatted before with a generation different are old */
+uint32_t
+domain_generation ( void );
+
+// bytes in use of cache, names included
+size_t
+cache_domain_memory ( void );
+
+/* reduce the limit of cache to 'size' bytes, the least recently used names
+   are removed until it */
+void
+cache_domain_shrink ( size_t size );
 
 void
 cache_domain_free ( void );
@@ -17,24 +17,35 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stddef.h>  // NULL
+
 #include "thread_pool.h"
 #include "domain.h"
+#include "dns.h"
 
 int
-resolver_init ( unsigned int cache_size, unsigned int num_workers )
+resolver_init ( size_t cache_size,
+                const char *cache_file,
+                unsigned int num_workers )
 {
   if ( !thpool_init ( num_workers ) )
     return 0;
 
-  if ( !cache_domain_init ( cache_size ) )
+  if ( !cache_domain_init ( cache_size, cache_file ) )
     return 0;
 
+  // without nameservers, names are resolved in thread pool
+  dns_init ( NULL, NULL );
+
+  domain_resolve_locals ();
+
   return 1;
 }
 
 void
 resolver_free ( void )
 {
+  dns_free ();
   thpool_free ();
   cache_domain_free ();
 }
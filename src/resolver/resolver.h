@@ -24,8 +24,14 @@
 #include "domain.h"
 #include "service.h"
 
+#include <stddef.h>  // size_t
+
+/* 'cache_size' in bytes and 'cache_file' to persist names,
+   see cache_domain_init */
 int
-resolver_init ( unsigned int cache_size, unsigned int num_workers );
+resolver_init ( size_t cache_size,
+                const char *cache_file,
+                unsigned int num_workers );
 
 void
 resolver_free ( void );
@@ -17,17 +17,176 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdint.h>
+#include <stdio.h>      // fopen, getline
 #include <stdlib.h>
 #include <string.h>     // strncpy
 #include <netdb.h>      // getservbyport
 #include <arpa/inet.h>  // htons
 
+#include "service.h"
+#include "../m_error.h"
+
+#define SERVICES "/etc/services"
+
+#define PROTO_TCP 0
+#define PROTO_UDP 1
+
+/* name of each port of tcp and udp, offset in table of strings,
+   0 is port without name (first byte of strings is not used) */
+struct services
+{
+  uint16_t names[2][65536];
+  char *strings;
+  size_t len_strings;
+};
+
+static struct services *services;
+static const char *path_services;
+
+// changed in each reload, names formatted before are old
+static uint32_t generation;
+
+static struct services *
+services_load ( const char *path )
+{
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    {
+      ERROR_DEBUG ( "\"%s\"", path );
+      return NULL;
+    }
+
+  struct services *svc = calloc ( 1, sizeof *svc );
+  if ( !svc )
+    goto ERROR;
+
+  size_t max = 4096;
+  if ( !( svc->strings = malloc ( max ) ) )
+    goto ERROR;
+
+  svc->len_strings = 1;
+
+  char *line = NULL;
+  size_t size = 0;
+  char name[NI_MAXSERV];
+  char proto[8];
+  unsigned int port;
+
+  while ( getline ( &line, &size, file ) != -1 )
+    {
+      char *comment = strchr ( line, '#' );
+      if ( comment )
+        *comment = '\0';
+
+      // "name port/proto aliases"
+      if ( 3 != sscanf ( line, "%31s %u/%7s", name, &port, proto ) ||
+           port > 65535 )
+        continue;
+
+      int p;
+      if ( !strcmp ( proto, "tcp" ) )
+        p = PROTO_TCP;
+      else if ( !strcmp ( proto, "udp" ) )
+        p = PROTO_UDP;
+      else
+        continue;
+
+      // as getservbyport, first name of port
+      if ( svc->names[p][port] )
+        continue;
+
+      size_t len = strlen ( name ) + 1;
+
+      // offsets of 16 bits, names beyond are not translated
+      if ( svc->len_strings + len > UINT16_MAX )
+        break;
+
+      if ( svc->len_strings + len > max )
+        {
+          char *tmp = realloc ( svc->strings, max * 2 );
+          if ( !tmp )
+            break;
+
+          svc->strings = tmp;
+          max *= 2;
+        }
+
+      memcpy ( svc->strings + svc->len_strings, name, len );
+      svc->names[p][port] = svc->len_strings;
+      svc->len_strings += len;
+    }
+
+  free ( line );
+  fclose ( file );
+
+  return svc;
+
+ERROR:
+  free ( svc );
+  fclose ( file );
+  return NULL;
+}
+
+static void
+services_free ( struct services *svc )
+{
+  if ( !svc )
+    return;
+
+  free ( svc->strings );
+  free ( svc );
+}
+
+int
+service_init ( const char *path )
+{
+  path_services = ( path ) ? path : SERVICES;
+  services = services_load ( path_services );
+
+  return !!services;
+}
+
+void
+service_reload ( void )
+{
+  if ( !services )
+    return;
+
+  // if file is invalid the current table is kept
+  struct services *svc = services_load ( path_services );
+  if ( !svc )
+    return;
+
+  services_free ( services );
+  services = svc;
+  generation++;
+}
+
+uint32_t
+service_generation ( void )
+{
+  return generation;
+}
+
 int
 port2serv ( unsigned short int port,
             const char *restrict proto,
             char *restrict buf,
             const size_t buf_len )
 {
+  if ( services )
+    {
+      uint16_t name = services->names[*proto == 'u'][port];
+
+      if ( !name )
+        return 0;
+
+      strncpy ( buf, services->strings + name, buf_len );
+      return 1;
+    }
+
+  // without table
   struct servent *sve;
 
   sve = getservbyport ( htons ( port ), proto );
@@ -40,3 +199,10 @@ port2serv ( unsigned short int port,
 
   return 0;
 }
+
+void
+service_free ( void )
+{
+  services_free ( services );
+  services = NULL;
+}
@@ -21,11 +21,29 @@
 #define SERVICE_H
 
 #include <stddef.h>  // size_t
+#include <stdint.h>  // uint32_t
 
+/* read services of 'path' (NULL to /etc/services) in a table by protocol
+   and port. return 0 on failure, so port2serv use getservbyport */
+int
+service_init ( const char *path );
+
+// read file again, names changed are seen with service_generation
+void
+service_reload ( void );
+
+uint32_t
+service_generation ( void );
+
+/* name of 'port' of 'proto' ("tcp" or "udp") in 'buf',
+   return 0 if port not has name */
 int
 port2serv ( unsigned short int port,
             const char *proto,
             char *buf,
             const size_t buf_len );
 
+void
+service_free ( void );
+
 #endif  // SERVICE_H
@@ -17,23 +17,27 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdlib.h>  // for malloc
+#include <stdalign.h>  // alignas
 #include <stdbool.h>
-#include <limits.h>  // for PTHREAD_STACK_MIN
-#include <unistd.h>  // sleep
+#include <stdint.h>
+#include <limits.h>  // INT_MAX
+#include <unistd.h>  // syscall
 #include <pthread.h>
+#include <signal.h>  // sigfillset
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
-#include "queue.h"
 #include "get_cpu.h"
+#include "../affinity.h"
+#include "../probe.h"
 
 #define DEFAULT_NUM_WORKERS 3
 
-struct bsem
-{
-  pthread_mutex_t mutex;
-  pthread_cond_t cond;
-  bool value;
-};
+// tasks in ring, power of 2. with ring full, add_task fail
+#define RING_SIZE 1024
+#define RING_MASK ( RING_SIZE - 1 )
+
+#define CACHE_LINE 64
 
 struct task
 {
@@ -41,111 +45,173 @@ struct task
   void *args;                 // arg to function
 };
 
-static struct bsem bsem_jobs = { .mutex = PTHREAD_MUTEX_INITIALIZER,
-                                 .cond = PTHREAD_COND_INITIALIZER,
-                                 .value = false };
+/* slot of ring, 'seq' say the state of slot to position of ring 'pos':
+   seq == pos, free to producer. seq == pos + 1, task ready to consumer */
+struct slot
+{
+  size_t seq;
+  struct task task;
+};
 
-static struct bsem bsem_exit = { .mutex = PTHREAD_MUTEX_INITIALIZER,
-                                 .cond = PTHREAD_COND_INITIALIZER,
-                                 .value = false };
+/* bounded ring multi producer multi consumer, without lock, tasks are
+   stored in slots, so add_task not alloc memory */
+static struct slot ring[RING_SIZE];
 
-static volatile bool worker_stop = false;
+// positions in cache lines of your own, producers and consumers not disputes
+static struct
+{
+  alignas ( CACHE_LINE ) size_t enqueue;
+  alignas ( CACHE_LINE ) size_t dequeue;
+} pos;
 
-static volatile unsigned int workers_alive = 0;
-static pthread_mutex_t mutex_workers_alive = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t mutex_queue = PTHREAD_MUTEX_INITIALIZER;
+/* incremented in each task added, workers sleep in futex with this value,
+   so a task added between the check of ring and the sleep is not lost */
+static alignas ( CACHE_LINE ) uint32_t event = 0;
 
-static struct queue *queue_task = NULL;
+// workers sleeping, without sleeping workers add_task not do syscall
+static unsigned int sleeping = 0;
+
+static bool worker_stop = false;
+
+static uint32_t workers_alive = 0;
+
+// modules that use the pool, the last thpool_free stop the workers
+static unsigned int users = 0;
 
 static void
-bsem_post ( struct bsem *sem )
+futex_wait ( uint32_t *addr, uint32_t value )
 {
-  pthread_mutex_lock ( &( sem->mutex ) );
-  sem->value = true;
-  pthread_cond_signal ( &sem->cond );
-  pthread_mutex_unlock ( &( sem->mutex ) );
+  syscall ( SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0 );
 }
 
 static void
-bsem_post_all ( struct bsem *sem )
+futex_wake ( uint32_t *addr, int count )
 {
-  pthread_mutex_lock ( &( sem->mutex ) );
-  sem->value = true;
-  pthread_cond_broadcast ( &( sem->cond ) );
-  pthread_mutex_unlock ( &( sem->mutex ) );
+  syscall ( SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0 );
 }
 
 static void
-bsem_wait ( struct bsem *sem )
+ring_reset ( void )
 {
-  pthread_mutex_lock ( &( sem->mutex ) );
-  while ( !sem->value )
-    pthread_cond_wait ( &sem->cond, &( sem->mutex ) );
+  for ( size_t i = 0; i < RING_SIZE; i++ )
+    __atomic_store_n ( &ring[i].seq, i, __ATOMIC_RELAXED );
 
-  sem->value = false;
-  pthread_mutex_unlock ( &( sem->mutex ) );
+  __atomic_store_n ( &pos.enqueue, 0, __ATOMIC_RELAXED );
+  __atomic_store_n ( &pos.dequeue, 0, __ATOMIC_RELAXED );
 }
 
-static struct task *
-create_task ( void ( *func ) ( void * ), void *args )
+static bool
+ring_push ( void ( *func ) ( void * ), void *args )
 {
-  struct task *task = malloc ( sizeof ( *task ) );
+  size_t p = __atomic_load_n ( &pos.enqueue, __ATOMIC_RELAXED );
+  struct slot *slot;
 
-  if ( task )
+  while ( 1 )
     {
-      task->func = func;
-      task->args = args;
+      slot = &ring[p & RING_MASK];
+      size_t seq = __atomic_load_n ( &slot->seq, __ATOMIC_ACQUIRE );
+      intptr_t diff = ( intptr_t ) seq - ( intptr_t ) p;
+
+      if ( !diff )
+        {
+          // on failure 'p' is updated with current position
+          if ( __atomic_compare_exchange_n ( &pos.enqueue,
+                                             &p,
+                                             p + 1,
+                                             true,
+                                             __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED ) )
+            break;
+        }
+      else if ( diff < 0 )  // ring full
+        return false;
+      else
+        p = __atomic_load_n ( &pos.enqueue, __ATOMIC_RELAXED );
     }
 
-  return task;
-}
+  slot->task.func = func;
+  slot->task.args = args;
+  __atomic_store_n ( &slot->seq, p + 1, __ATOMIC_RELEASE );
 
-static void
-free_task ( struct task *task )
-{
-  free ( task );
+  return true;
 }
 
-static void
-execute_task ( struct task *task )
+static bool
+ring_pop ( struct task *task )
 {
-  task->func ( task->args );
+  size_t p = __atomic_load_n ( &pos.dequeue, __ATOMIC_RELAXED );
+  struct slot *slot;
+
+  while ( 1 )
+    {
+      slot = &ring[p & RING_MASK];
+      size_t seq = __atomic_load_n ( &slot->seq, __ATOMIC_ACQUIRE );
+      intptr_t diff = ( intptr_t ) seq - ( intptr_t ) ( p + 1 );
+
+      if ( !diff )
+        {
+          if ( __atomic_compare_exchange_n ( &pos.dequeue,
+                                             &p,
+                                             p + 1,
+                                             true,
+                                             __ATOMIC_RELAXED,
+                                             __ATOMIC_RELAXED ) )
+            break;
+        }
+      else if ( diff < 0 )  // ring empty
+        return false;
+      else
+        p = __atomic_load_n ( &pos.dequeue, __ATOMIC_RELAXED );
+    }
+
+  *task = slot->task;
+
+  // free slot to producer of next turn of ring
+  __atomic_store_n ( &slot->seq, p + RING_SIZE, __ATOMIC_RELEASE );
+
+  return true;
 }
 
 static void *
 th_worker ( __attribute__ ( ( unused ) ) void *args )
 {
-  pthread_mutex_lock ( &mutex_workers_alive );
-  workers_alive++;
-  pthread_mutex_unlock ( &mutex_workers_alive );
+  struct task task;
 
-  while ( !worker_stop )
-    {
-      // wait for jobs
-      bsem_wait ( &bsem_jobs );
+  // not dispute CPUs with capture
+  affinity_avoid_capture ();
 
-      if ( worker_stop )
-        break;
+  while ( !__atomic_load_n ( &worker_stop, __ATOMIC_ACQUIRE ) )
+    {
+      if ( ring_pop ( &task ) )
+        {
+          task.func ( task.args );
+          PROBE1 ( task_complete, task.func );
+          continue;
+        }
 
-      pthread_mutex_lock ( &mutex_queue );
-      struct task *task = dequeue ( queue_task );
-      if ( get_queue_size ( queue_task ) )
-        bsem_post ( &bsem_jobs );  // rearm other thread
-      pthread_mutex_unlock ( &mutex_queue );
+      // announce sleep before check ring again, see add_task
+      __atomic_add_fetch ( &sleeping, 1, __ATOMIC_SEQ_CST );
+      uint32_t value = __atomic_load_n ( &event, __ATOMIC_SEQ_CST );
 
-      if ( task )
+      if ( ring_pop ( &task ) )
         {
-          execute_task ( task );
-          free_task ( task );
+          __atomic_sub_fetch ( &sleeping, 1, __ATOMIC_SEQ_CST );
+          task.func ( task.args );
+          PROBE1 ( task_complete, task.func );
+          continue;
         }
+
+      // return immediately if 'event' changed since read
+      if ( !__atomic_load_n ( &worker_stop, __ATOMIC_ACQUIRE ) )
+        futex_wait ( &event, value );
+
+      __atomic_sub_fetch ( &sleeping, 1, __ATOMIC_SEQ_CST );
     }
 
-  pthread_mutex_lock ( &mutex_workers_alive );
-  workers_alive--;
-  pthread_mutex_unlock ( &mutex_workers_alive );
+  __atomic_sub_fetch ( &workers_alive, 1, __ATOMIC_SEQ_CST );
 
   // make up main thread to exit
-  bsem_post ( &bsem_exit );
+  futex_wake ( &workers_alive, INT_MAX );
 
   pthread_exit ( NULL );
 }
@@ -153,9 +219,11 @@ th_worker ( __attribute__ ( ( unused ) ) void *args )
 int
 thpool_init ( unsigned int num_workers )
 {
-  queue_task = queue_new ( free );
-  if ( !queue_task )
-    return 0;
+  if ( users++ )
+    return 1;
+
+  ring_reset ();
+  __atomic_store_n ( &worker_stop, false, __ATOMIC_RELEASE );
 
   if ( !num_workers && !( num_workers = get_count_cpu () - 1 ) )
     num_workers = DEFAULT_NUM_WORKERS;
@@ -166,12 +234,25 @@ thpool_init ( unsigned int num_workers )
   pthread_attr_init ( &attr );
   pthread_attr_setdetachstate ( &attr, PTHREAD_CREATE_DETACHED );
 
+  // signals must be delivered only to main thread
+  sigset_t set, old_set;
+  sigfillset ( &set );
+  pthread_sigmask ( SIG_SETMASK, &set, &old_set );
+
   while ( num_workers-- )
     {
+      // counted before start, thpool_free wait also workers not started
+      __atomic_add_fetch ( &workers_alive, 1, __ATOMIC_SEQ_CST );
       if ( pthread_create ( &tid, &attr, th_worker, NULL ) )
-        return 0;
+        {
+          __atomic_sub_fetch ( &workers_alive, 1, __ATOMIC_SEQ_CST );
+          pthread_sigmask ( SIG_SETMASK, &old_set, NULL );
+          pthread_attr_destroy ( &attr );
+          return 0;
+        }
     }
 
+  pthread_sigmask ( SIG_SETMASK, &old_set, NULL );
   pthread_attr_destroy ( &attr );
 
   return 1;
@@ -180,22 +261,16 @@ thpool_init ( unsigned int num_workers )
 int
 add_task ( void ( *func ) ( void * ), void *args )
 {
-  struct task *task = create_task ( func, args );
-  if ( !task )
+  if ( !ring_push ( func, args ) )
     return 0;
 
-  // push job in queue
-  pthread_mutex_lock ( &mutex_queue );
-  if ( !enqueue ( queue_task, task ) )
-    {
-      free_task ( task );
-      pthread_mutex_unlock ( &mutex_queue );
-      return 0;
-    }
+  PROBE1 ( task_enqueue, func );
 
-  // wake up a thread to work
-  bsem_post ( &bsem_jobs );
-  pthread_mutex_unlock ( &mutex_queue );
+  /* worker announce sleep before read 'event' and check ring again,
+     so or worker see the task or this see the worker sleeping */
+  __atomic_add_fetch ( &event, 1, __ATOMIC_SEQ_CST );
+  if ( __atomic_load_n ( &sleeping, __ATOMIC_SEQ_CST ) )
+    futex_wake ( &event, 1 );
 
   return 1;
 }
@@ -203,19 +278,15 @@ add_task ( void ( *func ) ( void * ), void *args )
 void
 thpool_free ( void )
 {
-  worker_stop = true;
+  if ( !users || --users )
+    return;
 
-  int wait = DEFAULT_NUM_WORKERS;
-  while ( workers_alive && wait-- )
-    {
-      bsem_post_all ( &bsem_jobs );
-      bsem_wait ( &bsem_exit );
-    }
+  __atomic_store_n ( &worker_stop, true, __ATOMIC_RELEASE );
+  __atomic_add_fetch ( &event, 1, __ATOMIC_SEQ_CST );
+  futex_wake ( &event, INT_MAX );
 
-  if ( queue_task )
-    {
-      pthread_mutex_lock ( &mutex_queue );
-      queue_destroy ( queue_task );
-      pthread_mutex_unlock ( &mutex_queue );
-    }
+  // tasks yet in ring are discarded
+  uint32_t alive;
+  while ( ( alive = __atomic_load_n ( &workers_alive, __ATOMIC_SEQ_CST ) ) )
+    futex_wait ( &workers_alive, alive );
 }
@@ -22,9 +22,12 @@
 
 /* all functions that return int, return 0 on failure and 1 on sucess */
 
+/* pool is shared by modules, each one call thpool_init and thpool_free.
+   only first call create the workers */
 int
 thpool_init ( unsigned int num_workers );
 
+/* tasks are stored in a bounded ring, return 0 if ring is full */
 int
 add_task ( void ( *func ) ( void * ), void *args );
 
@@ -19,7 +19,10 @@
  */
 
 #include <stdlib.h>  // calloc
+#include <stdio.h>   // fopen
 #include <inttypes.h>
+#include <dirent.h>  // opendir
+#include <net/if.h>  // IFNAMSIZ
 #include <sys/socket.h>       // setsockopt
 #include <linux/if_packet.h>  // *PACKET*
 #include <linux/if_ether.h>   // ETH_HLEN
@@ -36,6 +39,7 @@
 #error "TPACKET_V3 is necessary, check kernel linux version"
 #endif
 
+// default geometry, used if user not define others values.
 // each block will have at least 256KiB of size, because 128 * 2048 = 256KiB
 // this considering a page size of 4096.
 // this conf influences the use of CPU time and mmemory usage
@@ -49,45 +53,193 @@
 // size small cause more usage CPU
 #define LEN_FRAME 2048
 
+// size of frame in header-only mode, overhead of struct tpacket plus
+// sockaddr_ll plus alignment of mac header, rounded up
+#define LEN_FRAME_HEADER \
+  TPACKET_ALIGN ( TPACKET3_HDRLEN + TPACKET_ALIGN ( 16 + SNAPLEN_HEADER ) )
+
 // timeout in miliseconds
 // zero means that the kernel will calculate the timeout
 // https://github.com/torvalds/linux/blob/master/net/packet/af_packet.c#L596
 #define TIMEOUT_FRAME 0
 
-static int
-create_ring_buff ( struct ring *ring )
+// in auto mode the ring must support the traffic of RING_AUTO_MSEC
+// milliseconds in link speed, limited to RING_AUTO_MIN and RING_AUTO_MAX bytes
+#define RING_AUTO_MSEC 250
+#define RING_AUTO_MIN ( 1U << 20 )    // 1 MiB
+#define RING_AUTO_MAX ( 256U << 20 )  // 256 MiB
+
+// larger blocks to links fast, less wakes of process
+#define RING_AUTO_BLOCK_SMALL ( 256U << 10 )  // 256 KiB
+#define RING_AUTO_BLOCK_LARGE ( 1U << 20 )    // 1 MiB
+
+// link speed used when not is possible get real speed (virtual interfaces)
+#define LINK_SPEED_DEFAULT 1000  // Mb/s
+
+// get speed in Mb/s of interface from sysfs, -1 is unknown
+static long
+link_speed ( const char *iface )
+{
+  char path[sizeof ( "/sys/class/net//speed" ) + IFNAMSIZ];
+  long speed = -1;
+
+  snprintf ( path, sizeof path, "/sys/class/net/%s/speed", iface );
+
+  FILE *file = fopen ( path, "r" );
+  if ( !file )
+    return -1;
+
+  // interfaces down or virtuals return error in read
+  if ( 1 != fscanf ( file, "%ld", &speed ) )
+    speed = -1;
+
+  fclose ( file );
+
+  return speed;
+}
+
+// speed of iface or, if iface is NULL, the greater speed of all interfaces
+static long
+get_link_speed ( const char *iface )
+{
+  if ( iface )
+    return link_speed ( iface );
+
+  DIR *dir = opendir ( "/sys/class/net" );
+  if ( !dir )
+    return -1;
+
+  long max = -1;
+  struct dirent *dirent;
+  while ( ( dirent = readdir ( dir ) ) )
+    {
+      if ( dirent->d_name[0] == '.' )
+        continue;
+
+      long speed = link_speed ( dirent->d_name );
+      if ( speed > max )
+        max = speed;
+    }
+
+  closedir ( dir );
+
+  return max;
+}
+
+// bytes of ring to traffic of RING_AUTO_MSEC in speed of link of iface
+static uint64_t
+ring_auto_size ( const char *iface )
+{
+  long speed = get_link_speed ( iface );
+  if ( speed <= 0 )
+    speed = LINK_SPEED_DEFAULT;
+
+  // Mb/s to bytes in RING_AUTO_MSEC
+  uint64_t ring_size = ( uint64_t ) speed * 1000000 / 8 * RING_AUTO_MSEC / 1000;
+
+  if ( ring_size < RING_AUTO_MIN )
+    ring_size = RING_AUTO_MIN;
+  else if ( ring_size > RING_AUTO_MAX )
+    ring_size = RING_AUTO_MAX;
+
+  return ring_size;
+}
+
+// each ring is sized by link of your interface, blocks are of same size
+static void
+ring_auto_geometry ( struct config_op *co )
+{
+  uint64_t sizes[MAX_IFACES];
+  uint64_t max = 0;
+
+  for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+    {
+      sizes[i] = ring_auto_size ( co->ifaces[i] );
+      if ( sizes[i] > max )
+        max = sizes[i];
+    }
+
+  // values defined by user have priority
+  if ( !co->ring_block_size )
+    co->ring_block_size = ( max >= 16 * RING_AUTO_BLOCK_LARGE )
+                                  ? RING_AUTO_BLOCK_LARGE
+                                  : RING_AUTO_BLOCK_SMALL;
+
+  if ( co->ring_blocks )
+    return;
+
+  for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+    {
+      if ( co->iface_blocks[i] )
+        continue;
+
+      co->iface_blocks[i] = sizes[i] / co->ring_block_size;
+      if ( co->iface_blocks[i] < N_BLOCKS )
+        co->iface_blocks[i] = N_BLOCKS;
+    }
+}
+
+bool
+ring_geometry ( struct config_op *co )
 {
   long page_size;
-  size_t frames_per_block;
 
-  ring->req.tp_frame_size = LEN_FRAME;
-  // TPACKET_ALIGN ( TPACKET3_HDRLEN ) + TPACKET_ALIGN ( LEN_FRAME );
+  if ( co->ring_auto )
+    ring_auto_geometry ( co );
+
+  if ( !co->ring_blocks )
+    co->ring_blocks = N_BLOCKS;
+
+  // blocks of '-i iface:N' have priority
+  for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+    {
+      if ( !co->iface_blocks[i] )
+        co->iface_blocks[i] = co->ring_blocks;
+    }
+
+  if ( !co->ring_block_size )
+    co->ring_block_size = LEN_FRAME * FRAMES_PER_BLOCK;
 
   // tamanho inicial de uma pagina de memoria
   errno = 0;
   if ( -1 == ( page_size = sysconf ( _SC_PAGESIZE ) ) )
     {
       ERROR_DEBUG ( "%s", ( errno ? strerror ( errno ) : "Error sysconf" ) );
-      return 0;
+      return false;
     }
 
   // The block has to be page size aligned
-  // dobra o tamanho do bloco até que caiba a quantidade de frames
-  ring->req.tp_block_size = page_size;
-  while ( ring->req.tp_block_size < ring->req.tp_frame_size * FRAMES_PER_BLOCK )
+  // dobra o tamanho do bloco até que caiba o tamanho solicitado
+  unsigned int block_size = page_size;
+  while ( block_size < co->ring_block_size || block_size < LEN_FRAME )
     {
-      ring->req.tp_block_size <<= 1;
+      block_size <<= 1;
     }
 
-  ring->req.tp_block_nr = N_BLOCKS;
+  co->ring_block_size = block_size;
+
+  return true;
+}
+
+static void
+create_ring_buff ( struct ring *ring,
+                   const struct config_op *co,
+                   unsigned int iface )
+{
+  size_t frames_per_block;
+
+  // in TPACKET_V3 the kernel packs the packets in block, frame size only
+  // define frames counted by block, small frames when only headers are copied
+  ring->req.tp_frame_size = ( co->snaplen ) ? LEN_FRAME_HEADER : LEN_FRAME;
+
+  ring->req.tp_block_size = co->ring_block_size;
+  ring->req.tp_block_nr = co->iface_blocks[iface];
   frames_per_block = ring->req.tp_block_size / ring->req.tp_frame_size;
   ring->req.tp_frame_nr = ring->req.tp_block_nr * frames_per_block;
-  ring->req.tp_retire_blk_tov = TIMEOUT_FRAME;
+  ring->req.tp_retire_blk_tov = co->ring_timeout;
 
   ring->req.tp_feature_req_word = 0;
   ring->req.tp_sizeof_priv = 0;
-
-  return 1;
 }
 
 static int
@@ -118,12 +270,21 @@ config_ring ( int sock, struct ring *ring, int version )
   return 1;
 }
 
+// rings mapped and rings locked in memory, to ring_locked
+static unsigned int rings_total = 0;
+static unsigned int rings_locked = 0;
+
+// bytes of all rings mapped, to ring_memory
+static size_t rings_memory = 0;
+
 static int
-map_buff ( int sock, struct ring *ring )
+map_buff ( int sock, struct ring *ring, bool lock )
 {
   size_t rx_ring_size = ring->req.tp_block_nr * ring->req.tp_block_size;
-  ring->map =
-          mmap ( 0, rx_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0 );
+
+  // page tables filled now, not by faults in first pass of capture
+  int flags = MAP_SHARED | ( lock ? MAP_POPULATE : 0 );
+  ring->map = mmap ( 0, rx_ring_size, PROT_READ | PROT_WRITE, flags, sock, 0 );
 
   if ( ring->map == MAP_FAILED )
     {
@@ -131,6 +292,13 @@ map_buff ( int sock, struct ring *ring )
       return 0;
     }
 
+  // without CAP_IPC_LOCK or above of RLIMIT_MEMLOCK the ring is not locked
+  ring->locked = lock && 0 == mlock ( ring->map, rx_ring_size );
+  if ( lock && !ring->locked )
+    {
+      ERROR_DEBUG ( "mlock ring: %s", strerror ( errno ) );
+    }
+
   ring->rd = calloc ( ring->req.tp_block_nr, sizeof ( *ring->rd ) );
   if ( !ring->rd )
     {
@@ -148,20 +316,25 @@ map_buff ( int sock, struct ring *ring )
 }
 
 struct ring *
-ring_init ( int sock )
+ring_init ( int sock, const struct config_op *co, unsigned int iface )
 {
   struct ring *ring = malloc ( sizeof *ring );
 
   if ( ring )
     {
-      if ( !create_ring_buff ( ring ) )
-        goto ERROR_EXIT;
+      create_ring_buff ( ring, co, iface );
 
       if ( !config_ring ( sock, ring, TPACKET_V3 ) )
         goto ERROR_EXIT;
 
-      if ( !map_buff ( sock, ring ) )
+      if ( !map_buff ( sock, ring, co->ring_lock ) )
         goto ERROR_EXIT;
+
+      rings_total++;
+      rings_locked += ring->locked;
+      __atomic_add_fetch ( &rings_memory,
+                           ring->req.tp_block_nr * ring->req.tp_block_size,
+                           __ATOMIC_RELAXED );
     }
 
   return ring;
@@ -177,7 +350,25 @@ ring_free ( struct ring *ring )
   if ( !ring )
     return;
 
+  rings_total--;
+  rings_locked -= ring->locked;
+  __atomic_sub_fetch ( &rings_memory,
+                       ring->req.tp_block_nr * ring->req.tp_block_size,
+                       __ATOMIC_RELAXED );
+
   munmap ( ring->map, ring->req.tp_block_size * ring->req.tp_block_nr );
   free ( ring->rd );
   free ( ring );
 }
+
+bool
+ring_locked ( void )
+{
+  return rings_total && rings_locked == rings_total;
+}
+
+size_t
+ring_memory ( void )
+{
+  return __atomic_load_n ( &rings_memory, __ATOMIC_RELAXED );
+}
@@ -21,20 +21,42 @@
 #ifndef RING_H
 #define RING_H
 
+#include <stdbool.h>
 #include <sys/uio.h>          // struct iovec
 #include <linux/if_packet.h>  // strct tpacket_req3
 
+#include "config.h"
+
 struct ring
 {
   struct tpacket_req3 req;
   struct iovec *rd;
   uint8_t *map;
+  bool locked;  // ring locked in memory, see co->ring_lock
 };
 
+/* define values of co->ring_blocks, co->iface_blocks and co->ring_block_size
+   not defined by user, based in speed of link of each interface if
+   co->ring_auto is set, or to defaults.
+   block size is rounded up to a power-of-two multiple of page size.
+   must be called before ring_init */
+bool
+ring_geometry ( struct config_op *co );
+
+// ring of socket of interface co->ifaces[iface]
 struct ring *
-ring_init ( int sock );
+ring_init ( int sock, const struct config_op *co, unsigned int iface );
 
 void
 ring_free ( struct ring *ring );
 
+/* true if all rings are locked in memory, with co->ring_lock the rings are
+   pre-faulted and locked, but the lock can fail by RLIMIT_MEMLOCK */
+bool
+ring_locked ( void );
+
+// bytes of all rings mapped
+size_t
+ring_memory ( void );
+
 #endif  // RING_H
@@ -0,0 +1,295 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#define _GNU_SOURCE  // mremap
+
+#include <fcntl.h>     // O_* constants
+#include <stdlib.h>    // free
+#include <string.h>    // memcpy, strlen
+#include <time.h>      // time
+#include <unistd.h>    // ftruncate, close
+#include <sys/mman.h>  // shm_open, mmap
+
+#include "snapshot.h"
+#include "m_error.h"
+#include "macro_util.h"
+
+// initial size of segment, grows when a snapshot not fit
+#define SNAPSHOT_SIZE ( 64 * 1024 )
+
+static struct snapshot_header *seg;
+static size_t seg_size;
+static const char *seg_name;
+static int seg_fd = -1;
+
+bool
+snapshot_init ( const struct config_op *co )
+{
+  seg_fd = shm_open ( co->shm, O_CREAT | O_RDWR | O_CLOEXEC, 0644 );
+  if ( seg_fd == -1 )
+    return false;
+
+  seg_name = co->shm;
+
+  // a segment left by other execution is cleared
+  if ( ftruncate ( seg_fd, 0 ) == -1 ||
+       ftruncate ( seg_fd, SNAPSHOT_SIZE ) == -1 )
+    goto ERROR;
+
+  seg = mmap ( NULL,
+               SNAPSHOT_SIZE,
+               PROT_READ | PROT_WRITE,
+               MAP_SHARED,
+               seg_fd,
+               0 );
+  if ( seg == MAP_FAILED )
+    {
+      seg = NULL;
+      goto ERROR;
+    }
+
+  seg_size = SNAPSHOT_SIZE;
+
+  *seg = ( struct snapshot_header ){ .magic = SNAPSHOT_MAGIC,
+                                     .version = SNAPSHOT_VERSION,
+                                     .size = seg_size,
+                                     .refresh = co->refresh,
+                                     .off_processes = sizeof *seg,
+                                     .off_connections = sizeof *seg,
+                                     .off_strings = sizeof *seg };
+
+  return true;
+
+ERROR:
+  snapshot_free ();
+  return false;
+}
+
+static bool
+grow ( size_t need )
+{
+  size_t size = MAX ( seg_size * 2, need );
+
+  // readers with the old size continue reading the start of segment
+  if ( ftruncate ( seg_fd, size ) == -1 )
+    return false;
+
+  void *p = mremap ( seg, seg_size, size, MREMAP_MAYMOVE );
+  if ( p == MAP_FAILED )
+    return false;
+
+  seg = p;
+  seg_size = size;
+  return true;
+}
+
+static inline bool
+process_listed ( const process_t *proc, const struct config_op *co )
+{
+  return co->verbose || proc->net_stat.tot_Bps_rx || proc->net_stat.tot_Bps_tx;
+}
+
+static inline bool
+connection_listed ( const connection_t *conn, const struct config_op *co )
+{
+  return co->verbose || conn->net_stat.tot_Bps_rx || conn->net_stat.tot_Bps_tx;
+}
+
+static void
+copy_stats ( struct snapshot_stats *st,
+             const struct net_stat *ns,
+             const struct config_op *co )
+{
+  // rates are in bits without option '-B'
+  unsigned int div = ( co->view_bytes ) ? 1 : 8;
+
+  st->rx = ns->avg_Bps_rx / div;
+  st->tx = ns->avg_Bps_tx / div;
+  st->pps_rx = ns->avg_pps_rx;
+  st->pps_tx = ns->avg_pps_tx;
+  st->total_rx = ns->tot_Bps_rx;
+  st->total_tx = ns->tot_Bps_tx;
+}
+
+void
+snapshot_update ( process_t **processes,
+                  size_t total,
+                  const struct config_op *co )
+{
+  if ( !seg )
+    return;
+
+  size_t total_procs = 0, total_conns = 0, len_strings = 0;
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      const process_t *proc = processes[i];
+
+      if ( !process_listed ( proc, co ) )
+        continue;
+
+      total_procs++;
+      len_strings += strlen ( proc->name ) + 1;
+
+      if ( !co->view_conections )
+        continue;
+
+      for ( size_t c = 0; c < proc->total_conections; c++ )
+        total_conns += connection_listed ( proc->conections[c], co );
+    }
+
+  size_t off_conns =
+          sizeof *seg + total_procs * sizeof ( struct snapshot_process );
+  size_t off_strings =
+          off_conns + total_conns * sizeof ( struct snapshot_connection );
+  size_t need = off_strings + len_strings;
+
+  if ( need > seg_size && !grow ( need ) )
+    {
+      ERROR_DEBUG ( "Error grow snapshot to %zu bytes", need );
+      return;
+    }
+
+  // seqlock, readers retry while seq is odd or if it changed
+  uint64_t seq = seg->seq;
+  __atomic_store_n ( &seg->seq, seq + 1, __ATOMIC_RELAXED );
+  __atomic_thread_fence ( __ATOMIC_RELEASE );
+
+  struct snapshot_process *sp =
+          ( struct snapshot_process * ) ( ( char * ) seg + sizeof *seg );
+  struct snapshot_connection *sc =
+          ( struct snapshot_connection * ) ( ( char * ) seg + off_conns );
+  char *strings = ( char * ) seg + off_strings;
+  uint32_t off_name = 0;
+  uint32_t index = 0;
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      const process_t *proc = processes[i];
+
+      if ( !process_listed ( proc, co ) )
+        continue;
+
+      copy_stats ( &sp->stats, &proc->net_stat, co );
+      sp->pid = proc->pid;
+      sp->name = off_name;
+      sp++;
+
+      size_t len = strlen ( proc->name ) + 1;
+      memcpy ( strings + off_name, proc->name, len );
+      off_name += len;
+
+      for ( size_t c = 0; co->view_conections && c < proc->total_conections;
+            c++ )
+        {
+          const connection_t *conn = proc->conections[c];
+          const struct tuple *t = &conn->tuple;
+
+          if ( !connection_listed ( conn, co ) )
+            continue;
+
+          copy_stats ( &sc->stats, &conn->net_stat, co );
+          memcpy ( sc->local, &t->l3.local, sizeof sc->local );
+          memcpy ( sc->remote, &t->l3.remote, sizeof sc->remote );
+          sc->local_port = t->l4.local_port;
+          sc->remote_port = t->l4.remote_port;
+          sc->family = t->family;
+          sc->protocol = t->l4.protocol;
+          sc->state = conn->state;
+          sc->pad = 0;
+          sc->if_index = conn->if_index;
+          sc->process = index;
+          sc++;
+        }
+
+      index++;
+    }
+
+  seg->size = seg_size;
+  seg->time = time ( NULL );
+  seg->running = co->running;
+  seg->packets = co->stats_total.packets;
+  seg->drops = co->stats_total.drops;
+  seg->refresh = co->refresh;
+  seg->sample = co->sample;
+  seg->total_processes = total_procs;
+  seg->total_connections = total_conns;
+  seg->len_strings = len_strings;
+  seg->off_processes = sizeof *seg;
+  seg->off_connections = off_conns;
+  seg->off_strings = off_strings;
+
+  __atomic_store_n ( &seg->seq, seq + 2, __ATOMIC_RELEASE );
+}
+
+void
+snapshot_free ( void )
+{
+  if ( seg )
+    munmap ( seg, seg_size );
+
+  if ( seg_fd != -1 )
+    {
+      close ( seg_fd );
+      shm_unlink ( seg_name );
+    }
+
+  seg = NULL;
+  seg_fd = -1;
+}
+
+size_t
+snapshot_copy ( const void *base,
+                size_t mapped,
+                void *buf,
+                size_t size,
+                unsigned int tries )
+{
+  const struct snapshot_header *src = base;
+  struct snapshot_header *hdr = buf;
+
+  if ( mapped < sizeof *hdr || size < sizeof *hdr )
+    return 0;
+
+  while ( tries-- )
+    {
+      uint64_t seq = __atomic_load_n ( &src->seq, __ATOMIC_ACQUIRE );
+      if ( seq & 1 )
+        continue;
+
+      memcpy ( hdr, src, sizeof *hdr );
+
+      size_t len = hdr->off_strings + hdr->len_strings;
+      bool fit = hdr->magic == SNAPSHOT_MAGIC && len >= sizeof *hdr &&
+                 len <= mapped && len <= size;
+
+      if ( fit )
+        memcpy ( ( char * ) buf + sizeof *hdr,
+                 ( const char * ) base + sizeof *hdr,
+                 len - sizeof *hdr );
+
+      __atomic_thread_fence ( __ATOMIC_ACQUIRE );
+      if ( __atomic_load_n ( &src->seq, __ATOMIC_RELAXED ) != seq )
+        continue;
+
+      return ( fit ) ? len : 0;
+    }
+
+  return 0;
+}
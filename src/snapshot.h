@@ -0,0 +1,128 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+#include <stdint.h>
+
+#include "processes.h"
+#include "config.h"
+
+/* snapshot of each refresh in a segment of POSIX shared memory
+   (shm_open), to consumers in other processes read the statistics without
+   syscalls and without parse of text.
+   the segment is the header, the array of processes, the array of
+   connections and the table of strings, in offsets of header. all fields
+   have fixed size, in byte order of host, rates are in bytes by second.
+
+   reader of a consistent snapshot (seqlock):
+     1. read 'seq' (acquire), if odd the snapshot is being written, retry
+     2. copy what is need of segment
+     3. read 'seq' again (after a acquire fence), if changed, retry
+   if 'size' is bigger than the mapped, the segment grew and must be
+   mapped again. snapshot_copy do it to a buffer */
+
+#define SNAPSHOT_MAGIC 0x4e50534e  // "NSPN"
+#define SNAPSHOT_VERSION 1
+
+struct snapshot_header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t seq;   // odd while snapshot is written
+  uint64_t size;  // bytes of segment
+
+  uint64_t time;     // unix time of snapshot
+  uint64_t running;  // milliseconds of netproc running
+  uint64_t packets;  // packets read by sockets of capture since start
+  uint64_t drops;    // packets dropped by kernel since start
+  uint32_t refresh;  // interval of refresh, milliseconds
+  uint32_t sample;   // 1 in N packets captured, above 1 values are estimates
+  uint32_t reserved;
+
+  uint32_t total_processes;
+  uint32_t total_connections;
+  uint32_t len_strings;
+
+  uint64_t off_processes;    // struct snapshot_process[total_processes]
+  uint64_t off_connections;  // struct snapshot_connection[...]
+  uint64_t off_strings;      // names, terminated by '\0'
+};
+
+struct snapshot_stats
+{
+  uint64_t rx;  // bytes by second in window of rate
+  uint64_t tx;
+  uint64_t pps_rx;
+  uint64_t pps_tx;
+  uint64_t total_rx;  // bytes since start
+  uint64_t total_tx;
+};
+
+struct snapshot_process
+{
+  struct snapshot_stats stats;
+  uint32_t pid;
+  uint32_t name;  // offset of name in table of strings
+};
+
+struct snapshot_connection
+{
+  struct snapshot_stats stats;
+  uint8_t local[16];  // address ipv4 in first 4 bytes, network order
+  uint8_t remote[16];
+  uint16_t local_port;
+  uint16_t remote_port;
+  uint8_t family;    // AF_INET or AF_INET6
+  uint8_t protocol;  // IPPROTO_TCP or IPPROTO_UDP
+  uint8_t state;     // state tcp
+  uint8_t pad;
+  int32_t if_index;
+  uint32_t process;  // index in array of processes
+};
+
+// create segment 'name' (as "/netproc"), removed by snapshot_free
+bool
+snapshot_init ( const struct config_op *co );
+
+// write snapshot of this refresh, after rate_calc
+void
+snapshot_update ( process_t **processes,
+                  size_t total,
+                  const struct config_op *co );
+
+void
+snapshot_free ( void );
+
+/* to consumers, copy a consistent snapshot of segment mapped in 'base'
+   ('mapped' bytes) to 'buf', trying up to 'tries' times while it is being
+   written. return size of snapshot copied, or 0 and only the header is in
+   'buf': if 'size' of header is bigger than 'mapped' the segment must be
+   mapped again, other else 'buf' is small to the snapshot */
+size_t
+snapshot_copy ( const void *base,
+                size_t mapped,
+                void *buf,
+                size_t size,
+                unsigned int tries );
+
+#endif  // SNAPSHOT_H
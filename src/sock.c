@@ -21,10 +21,13 @@
 #include <stdlib.h>           // malloc
 #include <arpa/inet.h>        // htons
 #include <errno.h>            // variable errno
+#include <net/if_arp.h>       // ARPHRD_*
 #include <linux/if_ether.h>   // defined ETH_P_ALL
 #include <linux/if_packet.h>  // struct sockaddr_ll
 #include <net/if.h>           // if_nametoindex
+#include <netdb.h>            // getaddrinfo
 #include <string.h>           // strerror
+#include <sys/ioctl.h>        // SIOCGIFHWADDR
 #include <sys/socket.h>       // socket
 #include <sys/types.h>        // socket
 #include <fcntl.h>            // fcntl
@@ -33,6 +36,14 @@
 #include "sock.h"
 #include "m_error.h"
 
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+#ifndef ARPHRD_RAWIP
+#define ARPHRD_RAWIP 519
+#endif
+
 static int
 socket_setnonblocking ( int sock )
 {
@@ -81,12 +92,75 @@ bind_interface ( int sock, const char *iface )
   return 1;
 }
 
+// type of hardware of interface, or -1
+static int
+iface_hw_type ( const char *iface )
+{
+  struct ifreq ifr = { 0 };
+  int type = -1;
+
+  if ( strlen ( iface ) >= sizeof ( ifr.ifr_name ) )
+    return -1;
+
+  strcpy ( ifr.ifr_name, iface );
+
+  int sock = socket ( AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0 );
+  if ( sock == -1 )
+    return -1;
+
+  if ( ioctl ( sock, SIOCGIFHWADDR, &ifr ) != -1 )
+    type = ifr.ifr_hwaddr.sa_family;
+
+  close ( sock );
+  return type;
+}
+
+// link type of frames of interface and the type of socket to it
+static int
+link_of_iface ( const char *iface, enum link_type *link )
+{
+  switch ( ( iface ) ? iface_hw_type ( iface ) : -1 )
+    {
+      // all interfaces, or type unknown
+      case -1:
+        *link = LINK_ANY;
+        return SOCK_RAW;
+      case ARPHRD_ETHER:
+      case ARPHRD_LOOPBACK:
+        *link = LINK_ETHER;
+        return SOCK_RAW;
+      // without header of link
+      case ARPHRD_NONE:
+      case ARPHRD_PPP:
+      case ARPHRD_RAWIP:
+        *link = LINK_RAW;
+        return SOCK_RAW;
+      // header of link removed by kernel
+      default:
+        *link = LINK_RAW;
+        return SOCK_DGRAM;
+    }
+}
+
+enum link_type
+socket_link ( const char *iface )
+{
+  enum link_type link;
+
+  // header of link removed only in sockets SOCK_DGRAM
+  if ( link_of_iface ( iface, &link ) != SOCK_RAW )
+    return LINK_ANY;
+
+  return link;
+}
+
 int
-socket_init ( const char *iface )
+socket_init ( const char *iface, enum link_type *link )
 {
   int sock;
+  int type = link_of_iface ( iface, link );
 
-  if ( ( sock = socket ( AF_PACKET, SOCK_RAW, htons ( ETH_P_ALL ) ) ) == -1 )
+  if ( ( sock = socket ( AF_PACKET, type, htons ( ETH_P_ALL ) ) ) == -1 )
     {
       ERROR_DEBUG ( "Error create socket: %s", strerror ( errno ) );
       return -1;
@@ -106,6 +180,122 @@ ERROR_EXIT:
   return -1;
 }
 
+int
+socket_fanout ( int sock, const uint16_t group_id )
+{
+  // hash mode keeps all packets of a flow on the same socket,
+  // defrag makes sure that fragments are hashed as the whole datagram
+  int fanout = group_id | ( ( PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG )
+                            << 16 );
+
+  if ( setsockopt ( sock,
+                    SOL_PACKET,
+                    PACKET_FANOUT,
+                    &fanout,
+                    sizeof ( fanout ) ) == -1 )
+    {
+      ERROR_DEBUG ( "Error join fanout group: %s", strerror ( errno ) );
+      return 0;
+    }
+
+  return 1;
+}
+
+int
+socket_busy_poll ( int sock, const unsigned int usec )
+{
+  if ( setsockopt ( sock, SOL_SOCKET, SO_BUSY_POLL, &usec, sizeof ( usec ) ) ==
+       -1 )
+    {
+      ERROR_DEBUG ( "Error set busy poll: %s", strerror ( errno ) );
+      return 0;
+    }
+
+  // prefer busy poll over the interrupts of device, only if suported
+  // by kernel (5.11)
+  int on = 1;
+  if ( setsockopt (
+               sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof ( on ) ) ==
+       -1 )
+    {
+      ERROR_DEBUG ( "Error set prefer busy poll: %s", strerror ( errno ) );
+    }
+
+  return 1;
+}
+
+int
+socket_stats ( int sock, struct sock_stats *stats )
+{
+  // without TPACKET_V3 the kernel copy only struct tpacket_stats,
+  // so tp_freeze_q_cnt stay zero
+  struct tpacket_stats_v3 st = { 0 };
+  socklen_t len = sizeof ( st );
+
+  if ( getsockopt ( sock, SOL_PACKET, PACKET_STATISTICS, &st, &len ) == -1 )
+    {
+      ERROR_DEBUG ( "Error get statistics of socket: %s", strerror ( errno ) );
+      return 0;
+    }
+
+  stats->packets += st.tp_packets;
+  stats->drops += st.tp_drops;
+  stats->freeze_q += st.tp_freeze_q_cnt;
+
+  return 1;
+}
+
+bool
+socket_resolve ( const char *value,
+                 int socktype,
+                 struct sockaddr_storage *addr,
+                 socklen_t *addr_len )
+{
+  char name[NI_MAXHOST];
+  const char *port;
+  size_t len;
+
+  if ( *value == '[' )
+    {
+      const char *end = strchr ( ++value, ']' );
+      if ( !end || end[1] != ':' )
+        return false;
+
+      len = end - value;
+      port = end + 2;
+    }
+  else
+    {
+      port = strchr ( value, ':' );
+      if ( !port || strchr ( port + 1, ':' ) )
+        return false;
+
+      len = port++ - value;
+    }
+
+  if ( !len || len >= sizeof name || !*port )
+    return false;
+
+  memcpy ( name, value, len );
+  name[len] = '\0';
+
+  struct addrinfo hints = { .ai_socktype = socktype };
+  struct addrinfo *res;
+
+  int ret = getaddrinfo ( name, port, &hints, &res );
+  if ( ret )
+    {
+      ERROR_DEBUG ( "Error resolve '%s': %s", name, gai_strerror ( ret ) );
+      return false;
+    }
+
+  memcpy ( addr, res->ai_addr, res->ai_addrlen );
+  *addr_len = res->ai_addrlen;
+  freeaddrinfo ( res );
+
+  return true;
+}
+
 void
 socket_free ( int sock )
 {
@@ -21,10 +21,66 @@
 #ifndef SOCK_SNIFF_H
 #define SOCK_SNIFF_H
 
-#include "config.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/socket.h>  // struct sockaddr_storage
 
+// counters of kernel about packets of capture socket
+struct sock_stats
+{
+  uint64_t packets;   // packets received, include the dropped
+  uint64_t drops;     // packets dropped, ring full
+  uint64_t freeze_q;  // times that queue was freezed, ring full
+};
+
+/* link layer of frames of socket, known on bind, so the parser and the
+   filter of socket are of the link, without test of link on each packet */
+enum link_type
+{
+  LINK_ANY,    // all interfaces, frames of ethernet or started by ip
+  LINK_ETHER,  // ethernet and loopback, with tags of vlan in frame
+  LINK_RAW,    // started by header ip, as tun and ppp, or cooked
+  TOTAL_LINKS
+};
+
+// tags of vlan followed in frames of ethernet, 802.1Q and QinQ (802.1ad)
+#define MAX_VLAN_TAGS 2
+
+/* socket of interface 'iface', or of all interfaces with NULL, 'link'
+   receive the link type of frames. interfaces of other types of hardware are
+   opened in cooked mode (SOCK_DGRAM), the kernel remove the header of link.
+   return the socket or -1 on error */
+int
+socket_init ( const char *iface, enum link_type *link );
+
+/* link type of frames of interface as in the head of device, LINK_ANY
+   if the kernel would remove the header of link (cooked mode) */
+enum link_type
+socket_link ( const char *iface );
+
+/* join socket to fanout group 'group_id', all sockets that be in the same
+   group share the traffic of interface, return 1 on sucess or 0 */
 int
-socket_init ( const char *iface );
+socket_fanout ( int sock, const uint16_t group_id );
+
+/* wait packets in socket with busy poll of device queue for up to 'usec'
+   microseconds, before sleep. return 1 on sucess or 0 */
+int
+socket_busy_poll ( int sock, const unsigned int usec );
+
+/* add to 'stats' the counters of socket since the last call, kernel
+   reset the counters on each read. return 1 on sucess or 0 */
+int
+socket_stats ( int sock, struct sock_stats *stats );
+
+/* resolve 'value' as "host:port" or "[ipv6]:port" to a address of sockets
+   of 'socktype', resolved once, to connect to a collector.
+   return false if 'value' is malformed or not resolved */
+bool
+socket_resolve ( const char *value,
+                 int socktype,
+                 struct sockaddr_storage *addr,
+                 socklen_t *addr_len );
 
 void
 socket_free ( int sock );
@@ -0,0 +1,366 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// references
+// man 7 sock_diag
+
+#include <errno.h>       // variable errno
+#include <arpa/inet.h>   // htons
+#include <string.h>      // strerror
+#include <sys/socket.h>  // socket
+#include <unistd.h>      // close
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>  // SOCK_DIAG_BY_FAMILY
+#include <linux/rtnetlink.h>  // RTA_OK
+#include <linux/tcp.h>        // struct tcp_info
+
+#include "sock_diag.h"
+#include "m_error.h"
+#include "macro_util.h"  // MIN
+
+// big buffer, less syscalls in hosts with many sockets
+#define BUFFER_SIZE ( 32 * 1024 )
+
+// aligned to struct nlmsghdr
+static uint32_t buf[BUFFER_SIZE / sizeof ( uint32_t )];
+
+static uint32_t seq = 0;
+
+int
+sock_diag_init ( void )
+{
+  int sock =
+          socket ( AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG );
+
+  if ( sock == -1 )
+    {
+      ERROR_DEBUG ( "Error create socket netlink: %s", strerror ( errno ) );
+    }
+
+  return sock;
+}
+
+struct request
+{
+  struct nlmsghdr nlh;
+  struct inet_diag_req_v2 req;
+};
+
+static int
+send_request ( int sock, struct request *msg )
+{
+  struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+
+  if ( sendto ( sock,
+                msg,
+                sizeof ( *msg ),
+                0,
+                ( struct sockaddr * ) &nladdr,
+                sizeof ( nladdr ) ) == -1 )
+    {
+      ERROR_DEBUG ( "Error send request sock_diag: %s", strerror ( errno ) );
+      return 0;
+    }
+
+  return 1;
+}
+
+/* return 1 to continue reading, 0 on error and -1 when dump is done */
+static int
+read_messages ( const void *buf,
+                ssize_t len,
+                uint32_t seq,
+                sock_diag_cb cb,
+                void *user_data )
+{
+  const struct nlmsghdr *nlh = buf;
+
+  for ( ; NLMSG_OK ( nlh, len ); nlh = NLMSG_NEXT ( nlh, len ) )
+    {
+      if ( nlh->nlmsg_seq != seq )
+        continue;
+
+      if ( nlh->nlmsg_type == NLMSG_DONE )
+        return -1;
+
+      if ( nlh->nlmsg_type == NLMSG_ERROR )
+        {
+          const struct nlmsgerr *err = NLMSG_DATA ( nlh );
+
+          errno = -err->error;
+          return 0;
+        }
+
+      if ( nlh->nlmsg_type != SOCK_DIAG_BY_FAMILY ||
+           nlh->nlmsg_len < NLMSG_LENGTH ( sizeof ( struct inet_diag_msg ) ) )
+        continue;
+
+      if ( !cb ( NLMSG_DATA ( nlh ), user_data ) )
+        return 0;
+    }
+
+  return 1;
+}
+
+int
+sock_diag_dump ( int sock,
+                 uint8_t family,
+                 uint8_t protocol,
+                 uint32_t states,
+                 sock_diag_cb cb,
+                 void *user_data )
+{
+  // aligned to struct nlmsghdr
+  struct request msg = { .nlh = { .nlmsg_len = sizeof ( msg ),
+                                  .nlmsg_type = SOCK_DIAG_BY_FAMILY,
+                                  .nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+                                  .nlmsg_seq = ++seq },
+                         .req = { .sdiag_family = family,
+                                  .sdiag_protocol = protocol,
+                                  .idiag_states = states } };
+
+  if ( !send_request ( sock, &msg ) )
+    return 0;
+
+  while ( 1 )
+    {
+      ssize_t len = recv ( sock, buf, sizeof ( buf ), 0 );
+
+      if ( len == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "Error read sock_diag: %s", strerror ( errno ) );
+          return 0;
+        }
+
+      // end of socket without NLMSG_DONE
+      if ( len == 0 )
+        return 0;
+
+      int ret = read_messages ( buf, len, seq, cb, user_data );
+      if ( ret != 1 )
+        return ret == -1;
+    }
+}
+
+// exact lookup of socket of 'tuple', 'cookie' 0 if unknown
+static void
+request_id ( struct inet_diag_req_v2 *req,
+             const struct tuple *tuple,
+             uint64_t cookie )
+{
+  req->sdiag_family = tuple->family;
+  req->sdiag_protocol = tuple->l4.protocol;
+  req->idiag_states = ~0U;
+
+  req->id.idiag_cookie[0] = ( cookie ) ? cookie & 0xffffffff
+                                       : INET_DIAG_NOCOOKIE;
+  req->id.idiag_cookie[1] = ( cookie ) ? cookie >> 32 : INET_DIAG_NOCOOKIE;
+
+  const union inet_all *src = &tuple->l3.local;
+  const union inet_all *dst = &tuple->l3.remote;
+  uint16_t sport = tuple->l4.local_port;
+  uint16_t dport = tuple->l4.remote_port;
+
+  // udp_diag look up as a packet received, source is the remote side
+  if ( tuple->l4.protocol == IPPROTO_UDP )
+    {
+      src = &tuple->l3.remote;
+      dst = &tuple->l3.local;
+      sport = tuple->l4.remote_port;
+      dport = tuple->l4.local_port;
+    }
+
+  req->id.idiag_sport = htons ( sport );
+  req->id.idiag_dport = htons ( dport );
+  memcpy ( req->id.idiag_src, src, sizeof ( req->id.idiag_src ) );
+  memcpy ( req->id.idiag_dst, dst, sizeof ( req->id.idiag_dst ) );
+}
+
+static bool
+copy_msg ( const struct inet_diag_msg *diag, void *user_data )
+{
+  *( struct inet_diag_msg * ) user_data = *diag;
+
+  // only one answer
+  return false;
+}
+
+int
+sock_diag_find ( int sock,
+                 const struct tuple *tuple,
+                 struct inet_diag_msg *msg )
+{
+  struct request req = { .nlh = { .nlmsg_len = sizeof ( req ),
+                                  .nlmsg_type = SOCK_DIAG_BY_FAMILY,
+                                  .nlmsg_flags = NLM_F_REQUEST,
+                                  .nlmsg_seq = ++seq } };
+
+  request_id ( &req.req, tuple, 0 );
+
+  if ( !send_request ( sock, &req ) )
+    return 0;
+
+  while ( 1 )
+    {
+      ssize_t len = recv ( sock, buf, sizeof ( buf ), 0 );
+
+      if ( len == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "Error read sock_diag: %s", strerror ( errno ) );
+          return 0;
+        }
+
+      if ( len == 0 )
+        return 0;
+
+      /* the answer is the socket or a error, messages of others
+         sequences (dumps stopped) are ignored */
+      errno = 0;
+      int ret = read_messages ( buf, len, seq, copy_msg, msg );
+      if ( ret != 1 )
+        return ret == 0 && !errno;
+    }
+}
+
+// TCP_INFO of attributes of answer, kernels older send a part of struct
+static void
+parse_tcp_info ( const struct nlmsghdr *nlh, struct sock_diag_tcp_info *info )
+{
+  const struct inet_diag_msg *msg = NLMSG_DATA ( nlh );
+  const struct rtattr *rta = ( const struct rtattr * ) ( msg + 1 );
+  int len = nlh->nlmsg_len - NLMSG_LENGTH ( sizeof ( *msg ) );
+
+  for ( ; RTA_OK ( rta, len ); rta = RTA_NEXT ( rta, len ) )
+    {
+      if ( rta->rta_type != INET_DIAG_INFO )
+        continue;
+
+      struct tcp_info ti = { 0 };
+      size_t size = MIN ( RTA_PAYLOAD ( rta ), sizeof ( ti ) );
+      memcpy ( &ti, RTA_DATA ( rta ), size );
+
+      *info = ( struct sock_diag_tcp_info ){ .rtt_us = ti.tcpi_rtt,
+                                             .rttvar_us = ti.tcpi_rttvar,
+                                             .retrans = ti.tcpi_total_retrans,
+                                             .snd_cwnd = ti.tcpi_snd_cwnd,
+                                             .found = true };
+      return;
+    }
+}
+
+int
+sock_diag_tcp_info ( int sock,
+                     const struct tuple *const *tuples,
+                     const uint64_t *cookies,
+                     size_t total,
+                     struct sock_diag_tcp_info *info )
+{
+  struct request reqs[SOCK_DIAG_BATCH];
+
+  total = MIN ( total, SOCK_DIAG_BATCH );
+  if ( !total )
+    return 1;
+
+  // answer of each request is known by your sequence
+  uint32_t first = seq + 1;
+  seq += total;
+
+  memset ( reqs, 0, total * sizeof ( *reqs ) );
+  for ( size_t i = 0; i < total; i++ )
+    {
+      reqs[i].nlh = ( struct nlmsghdr ){ .nlmsg_len = sizeof ( reqs[i] ),
+                                         .nlmsg_type = SOCK_DIAG_BY_FAMILY,
+                                         .nlmsg_flags = NLM_F_REQUEST,
+                                         .nlmsg_seq = first + i };
+
+      request_id ( &reqs[i].req, tuples[i], cookies[i] );
+      reqs[i].req.idiag_ext = 1 << ( INET_DIAG_INFO - 1 );
+
+      info[i].found = false;
+    }
+
+  struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+
+  // kernel handle all messages of datagram, each one has one answer
+  if ( sendto ( sock,
+                reqs,
+                total * sizeof ( *reqs ),
+                0,
+                ( struct sockaddr * ) &nladdr,
+                sizeof ( nladdr ) ) == -1 )
+    {
+      ERROR_DEBUG ( "Error send request sock_diag: %s", strerror ( errno ) );
+      return 0;
+    }
+
+  size_t answers = 0;
+  while ( answers < total )
+    {
+      ssize_t len = recv ( sock, buf, sizeof ( buf ), 0 );
+
+      if ( len == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "Error read sock_diag: %s", strerror ( errno ) );
+          return 0;
+        }
+
+      if ( len == 0 )
+        return 0;
+
+      const struct nlmsghdr *nlh = ( const struct nlmsghdr * ) buf;
+
+      // messages of others sequences (dumps stopped) are ignored
+      for ( ; NLMSG_OK ( nlh, len ); nlh = NLMSG_NEXT ( nlh, len ) )
+        {
+          uint32_t i = nlh->nlmsg_seq - first;
+          if ( i >= total )
+            continue;
+
+          // error of socket not found, ENOENT
+          if ( nlh->nlmsg_type == NLMSG_ERROR )
+            answers++;
+          else if ( nlh->nlmsg_type == SOCK_DIAG_BY_FAMILY &&
+                    nlh->nlmsg_len >=
+                            NLMSG_LENGTH ( sizeof ( struct inet_diag_msg ) ) )
+            {
+              parse_tcp_info ( nlh, &info[i] );
+              answers++;
+            }
+        }
+    }
+
+  return 1;
+}
+
+void
+sock_diag_free ( int sock )
+{
+  if ( sock != -1 )
+    close ( sock );
+}
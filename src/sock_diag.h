@@ -0,0 +1,93 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOCK_DIAG_H
+#define SOCK_DIAG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <linux/inet_diag.h>  // struct inet_diag_msg
+
+#include "sockaddr.h"  // struct tuple
+
+/* dump of sockets tcp/udp by netlink NETLINK_SOCK_DIAG (inet_diag), the
+   kernel send the sockets in binary form and already filtered by state,
+   faster than parse the text of /proc/net/{tcp,udp}{,6} */
+
+// mask of states to 'states' of sock_diag_dump
+#define SOCK_DIAG_STATE( state ) ( 1U << ( state ) )
+
+// called to each socket dumped, return false to stop the dump
+typedef bool ( *sock_diag_cb ) ( const struct inet_diag_msg *msg,
+                                 void *user_data );
+
+// return socket netlink or -1 on error
+int
+sock_diag_init ( void );
+
+/* dump sockets of 'family' (AF_INET/AF_INET6) and 'protocol'
+   (IPPROTO_TCP/IPPROTO_UDP) with state in mask 'states'.
+   return 1 on sucess or 0 on error, errno ENOENT or EPROTONOSUPPORT means
+   that kernel not support the dump of this family/protocol */
+int
+sock_diag_dump ( int sock,
+                 uint8_t family,
+                 uint8_t protocol,
+                 uint32_t states,
+                 sock_diag_cb cb,
+                 void *user_data );
+
+/* exact lookup of socket of 'tuple', without dump of all sockets.
+   return 1 and fill 'msg' if found or 0 on error, errno ENOENT means that
+   socket not exist (or kernel not support this family/protocol) */
+int
+sock_diag_find ( int sock,
+                 const struct tuple *tuple,
+                 struct inet_diag_msg *msg );
+
+// max of sockets of sock_diag_tcp_info
+#define SOCK_DIAG_BATCH 64
+
+// subset of TCP_INFO of a socket (struct tcp_info of linux/tcp.h)
+struct sock_diag_tcp_info
+{
+  uint32_t rtt_us;     // smoothed round trip time
+  uint32_t rttvar_us;  // variation of round trip time
+  uint32_t retrans;    // total of segments retransmitted
+  uint32_t snd_cwnd;   // congestion window, in segments
+  bool found;          // false if socket not exist
+};
+
+/* TCP_INFO of 'total' tcp sockets of 'tuples' (up to SOCK_DIAG_BATCH).
+   the exact lookups of all sockets are sent in a single message to kernel,
+   so the cost is by 'total' and not by sockets of host. 'cookies' are the
+   cookies of sockets (0 if unknown), a socket other with same tuple is not
+   found. return 1 on sucess or 0 on error */
+int
+sock_diag_tcp_info ( int sock,
+                     const struct tuple *const *tuples,
+                     const uint64_t *cookies,
+                     size_t total,
+                     struct sock_diag_tcp_info *info );
+
+void
+sock_diag_free ( int sock );
+
+#endif  // SOCK_DIAG_H
@@ -18,98 +18,208 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#define _GNU_SOURCE  // qsort_r
-#include <stdlib.h>
-#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>  // qsort
+#include <stdint.h>  // uintptr_t
 
 #include "processes.h"
 #include "connection.h"
 #include "sort.h"
+#include "macro_util.h"
 
-static int
-compare_process ( const void *restrict p1,
-                  const void *restrict p2,
-                  void *restrict mode )
+/* above of this, the first 'k' are sorted by qsort, insertion of each
+   element in top 'k' costs O(k) */
+#define PARTIAL_MAX 512
+
+// entries with same value keep the order of last refresh
+static inline int
+compare_address ( const void *p1, const void *p2 )
 {
-  process_t *proc1 = *( process_t ** ) p1;
-  process_t *proc2 = *( process_t ** ) p2;
-
-  int64_t r;
-  switch ( *( int * ) mode )
-    {
-      case RATE_RX:
-        r = proc2->net_stat.avg_Bps_rx - proc1->net_stat.avg_Bps_rx;
-        break;
-      case RATE_TX:
-        r = proc2->net_stat.avg_Bps_tx - proc1->net_stat.avg_Bps_tx;
-        break;
-      case TOT_RX:
-        r = proc2->net_stat.tot_Bps_rx - proc1->net_stat.tot_Bps_rx;
-        break;
-      case TOT_TX:
-        r = proc2->net_stat.tot_Bps_tx - proc1->net_stat.tot_Bps_tx;
-        break;
-      case PPS_RX:
-        r = proc2->net_stat.avg_pps_rx - proc1->net_stat.avg_pps_rx;
-        break;
-      case PPS_TX:
-        r = proc2->net_stat.avg_pps_tx - proc1->net_stat.avg_pps_tx;
-        break;
-
-      // PID
-      default:
-        r = proc1->pid - proc2->pid;
-    }
-
-  return ( r > 0 ) - ( r < 0 );
+  return ( ( uintptr_t ) p1 > ( uintptr_t ) p2 ) -
+         ( ( uintptr_t ) p1 < ( uintptr_t ) p2 );
 }
 
-static int
-compare_connection ( const void *restrict p1,
-                     const void *restrict p2,
-                     void *restrict mode )
+static inline int
+compare_pid ( const process_t *proc1, const process_t *proc2 )
 {
-  connection_t *con1 = *( connection_t ** ) p1;
-  connection_t *con2 = *( connection_t ** ) p2;
-
-  int64_t r;
-  switch ( *( int * ) mode )
-    {
-      case RATE_TX:
-        r = con2->net_stat.avg_Bps_tx - con1->net_stat.avg_Bps_tx;
-        break;
-      case PPS_RX:
-        r = con2->net_stat.avg_pps_rx - con1->net_stat.avg_pps_rx;
-        break;
-      case PPS_TX:
-        r = con2->net_stat.avg_pps_tx - con1->net_stat.avg_pps_tx;
-        break;
-
-      // RATE RX
-      default:
-        r = con2->net_stat.avg_Bps_rx - con1->net_stat.avg_Bps_rx;
-    }
-
-  return ( r > 0 ) - ( r < 0 );
+  if ( proc1->pid != proc2->pid )
+    return ( proc1->pid > proc2->pid ) - ( proc1->pid < proc2->pid );
+
+  return compare_address ( proc1, proc2 );
 }
 
-void
+static inline int
+compare_inode ( const connection_t *con1, const connection_t *con2 )
+{
+  if ( con1->inode != con2->inode )
+    return ( con1->inode > con2->inode ) - ( con1->inode < con2->inode );
+
+  return compare_address ( con1, con2 );
+}
+
+// decreasing by 'field' of net_stat, on tie by 'tie'
+#define COMPARE_DESC( name, type, field, tie )                   \
+  static inline int name ( const type *e1, const type *e2 )      \
+  {                                                              \
+    if ( e1->net_stat.field != e2->net_stat.field )              \
+      return ( e1->net_stat.field < e2->net_stat.field ) -       \
+             ( e1->net_stat.field > e2->net_stat.field );        \
+                                                                 \
+    return tie ( e1, e2 );                                       \
+  }
+
+/* sort only the first 'k' elements of 'v', the rest stay in any order.
+   each element is compared with the last of top 'k', so a array already
+   sorted in last refresh costs O(n) */
+#define DEFINE_SORT( name, type, cmp )                                     \
+  static int name##_qsort ( const void *p1, const void *p2 )               \
+  {                                                                        \
+    return cmp ( *( type *const * ) p1, *( type *const * ) p2 );           \
+  }                                                                        \
+                                                                           \
+  static void name ( type **v, size_t n, size_t k )                        \
+  {                                                                        \
+    if ( k > n )                                                           \
+      k = n;                                                               \
+                                                                           \
+    if ( k > PARTIAL_MAX )                                                 \
+      {                                                                    \
+        qsort ( v, n, sizeof ( *v ), name##_qsort );                       \
+        return;                                                            \
+      }                                                                    \
+                                                                           \
+    for ( size_t i = 1; k && i < n; i++ )                                  \
+      {                                                                    \
+        type *e = v[i];                                                    \
+        size_t j = i;                                                      \
+                                                                           \
+        if ( i >= k )                                                      \
+          {                                                                \
+            if ( cmp ( e, v[k - 1] ) >= 0 )                                \
+              continue;                                                    \
+                                                                           \
+            /* the last of top is out */                                   \
+            v[i] = v[k - 1];                                               \
+            j = k - 1;                                                     \
+          }                                                                \
+                                                                           \
+        for ( ; j > 0 && cmp ( e, v[j - 1] ) < 0; j-- )                    \
+          v[j] = v[j - 1];                                                 \
+                                                                           \
+        v[j] = e;                                                          \
+      }                                                                    \
+  }
+
+// clang-format off
+COMPARE_DESC ( cmp_proc_pps_tx, process_t, avg_pps_tx, compare_pid )
+COMPARE_DESC ( cmp_proc_pps_rx, process_t, avg_pps_rx, compare_pid )
+COMPARE_DESC ( cmp_proc_rate_tx, process_t, avg_Bps_tx, compare_pid )
+COMPARE_DESC ( cmp_proc_rate_rx, process_t, avg_Bps_rx, compare_pid )
+COMPARE_DESC ( cmp_proc_tot_tx, process_t, tot_Bps_tx, compare_pid )
+COMPARE_DESC ( cmp_proc_tot_rx, process_t, tot_Bps_rx, compare_pid )
+
+COMPARE_DESC ( cmp_con_pps_tx, connection_t, avg_pps_tx, compare_inode )
+COMPARE_DESC ( cmp_con_pps_rx, connection_t, avg_pps_rx, compare_inode )
+COMPARE_DESC ( cmp_con_rate_tx, connection_t, avg_Bps_tx, compare_inode )
+COMPARE_DESC ( cmp_con_rate_rx, connection_t, avg_Bps_rx, compare_inode )
+
+DEFINE_SORT ( sort_proc_pid, process_t, compare_pid )
+DEFINE_SORT ( sort_proc_pps_tx, process_t, cmp_proc_pps_tx )
+DEFINE_SORT ( sort_proc_pps_rx, process_t, cmp_proc_pps_rx )
+DEFINE_SORT ( sort_proc_rate_tx, process_t, cmp_proc_rate_tx )
+DEFINE_SORT ( sort_proc_rate_rx, process_t, cmp_proc_rate_rx )
+DEFINE_SORT ( sort_proc_tot_tx, process_t, cmp_proc_tot_tx )
+DEFINE_SORT ( sort_proc_tot_rx, process_t, cmp_proc_tot_rx )
+
+DEFINE_SORT ( sort_con_pps_tx, connection_t, cmp_con_pps_tx )
+DEFINE_SORT ( sort_con_pps_rx, connection_t, cmp_con_pps_rx )
+DEFINE_SORT ( sort_con_rate_tx, connection_t, cmp_con_rate_tx )
+DEFINE_SORT ( sort_con_rate_rx, connection_t, cmp_con_rate_rx )
+// clang-format on
+
+// the column is chosen once by sort, not in each comparison
+static void ( *const sort_proc[COLS_TO_SORT] ) ( process_t **,
+                                                 size_t,
+                                                 size_t ) = {
+  [S_PID] = sort_proc_pid,       [PPS_TX] = sort_proc_pps_tx,
+  [PPS_RX] = sort_proc_pps_rx,   [RATE_TX] = sort_proc_rate_tx,
+  [RATE_RX] = sort_proc_rate_rx, [TOT_TX] = sort_proc_tot_tx,
+  [TOT_RX] = sort_proc_tot_rx
+};
+
+// connections not have pid and totals, are sorted by rate rx
+static void ( *const sort_con[COLS_TO_SORT] ) ( connection_t **,
+                                                size_t,
+                                                size_t ) = {
+  [S_PID] = sort_con_rate_rx,   [PPS_TX] = sort_con_pps_tx,
+  [PPS_RX] = sort_con_pps_rx,   [RATE_TX] = sort_con_rate_tx,
+  [RATE_RX] = sort_con_rate_rx, [TOT_TX] = sort_con_rate_rx,
+  [TOT_RX] = sort_con_rate_rx
+};
+
+/* move to front the elements that 'keep' returns true, keeping the order
+   between them. return total of elements keeped */
+#define DEFINE_PARTITION( name, type, keep )                               \
+  static size_t name ( type **v, size_t n )                                \
+  {                                                                        \
+    size_t total = 0;                                                      \
+                                                                           \
+    for ( size_t i = 0; i < n; i++ )                                       \
+      {                                                                    \
+        if ( !keep ( v[i] ) )                                              \
+          continue;                                                        \
+                                                                           \
+        type *tmp = v[total];                                              \
+        v[total++] = v[i];                                                 \
+        v[i] = tmp;                                                        \
+      }                                                                    \
+                                                                           \
+    return total;                                                          \
+  }
+
+static inline bool
+process_showed ( const process_t *proc )
+{
+  return proc->net_stat.tot_Bps_rx || proc->net_stat.tot_Bps_tx;
+}
+
+static inline bool
+connection_traffic ( const connection_t *con )
+{
+  return con->net_stat.avg_Bps_rx || con->net_stat.avg_Bps_tx;
+}
+
+DEFINE_PARTITION ( partition_proc, process_t, process_showed )
+DEFINE_PARTITION ( partition_con, connection_t, connection_traffic )
+
+size_t
 sort ( process_t **proc,
        size_t tot_process,
        int mode,
+       size_t k,
        const struct config_op *co )
 {
-  qsort_r ( proc,
-            tot_process,
-            sizeof ( process_t * ),
-            compare_process,
-            ( void * ) &mode );
-
-  if ( co->view_conections )
-    for ( size_t i = 0; i < tot_process; i++ )
-      qsort_r ( proc[i]->conections,
-                proc[i]->total_conections,
-                sizeof ( connection_t * ),
-                compare_connection,
-                ( void * ) &mode );
+  // with verbose all processes are showed
+  size_t total = ( co->verbose ) ? tot_process
+                                 : partition_proc ( proc, tot_process );
+
+  sort_proc[mode]( proc, total, k );
+
+  return total;
+}
+
+size_t
+sort_connections_active ( process_t *process )
+{
+  size_t total =
+          partition_con ( process->conections, process->total_conections );
+
+  // the first connection always is showed
+  return ( total ) ? total : MIN ( 1, process->total_conections );
+}
+
+void
+sort_connections ( process_t *process, size_t total, int mode, size_t k )
+{
+  sort_con[mode]( process->conections, total, k );
 }
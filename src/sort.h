@@ -37,10 +37,24 @@ enum cols_sort
   COLS_TO_SORT  // total elements in enum
 };
 
-void
+/* the processes showed (with traffic or all with verbose) are moved
+   before of others, only the first 'k' of them are sorted by column 'mode'.
+   return total of processes showed */
+size_t
 sort ( process_t **proc,
        size_t tot_process,
        int mode,
+       size_t k,
        const struct config_op *co );
 
+/* the connections with traffic in window are moved before of others.
+   return total of connections to show, at least one if there is */
+size_t
+sort_connections_active ( process_t *process );
+
+/* sort only the first 'k' of 'total' first connections of 'process',
+   connections are sorted by rate rx if 'mode' is not of connections */
+void
+sort_connections ( process_t *process, size_t total, int mode, size_t k );
+
 #endif  // SORT_H
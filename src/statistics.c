@@ -19,6 +19,7 @@
  */
 
 #include <stdbool.h>
+#include <string.h>  // memcmp
 #include <net/if.h>
 #include <netinet/in.h>   // IPPROTO_TCP, IPPROTO_UDP
 #include <netinet/tcp.h>  // TCP_ESTABLISHED, TCP_TIME_WAIT...
@@ -27,70 +28,263 @@
 #include "packet.h"
 #include "rate.h"
 #include "processes.h"
+#include "statistics.h"
+#include "topk.h"
+#include "pktsize.h"
+#include "networks.h"
+#include "probe.h"
+#include "macro_util.h"
 
-// static bool
-// conection_match_packet ( connection_t *conection, const struct packet *pkt )
-// {
-//   if ( conection->protocol != pkt->protocol )
-//     return false;
-//
-//   // TCP must correspond exactly with the packet, if not, skip
-//   if ( pkt->protocol == IPPROTO_TCP &&
-//        ( conection->local_port != pkt->local_port ||
-//          conection->remote_port != pkt->remote_port ||
-//          conection->remote_address != pkt->remote_address ) )
-//     {
-//       return false;
-//     }
-//
-//   if ( pkt->protocol == IPPROTO_UDP )
-//     {
-//       // the local port is the only parameter that the kernel exports
-//       // in certain UDP situations (like a torrent),
-//       // if that is different, skip
-//       if ( conection->local_port != pkt->local_port )
-//         return false;
-//
-//       // UDP connections with state TCP_ESTABLISHED must
-//       // correspond exactly with the packet, if not, skip
-//       else if ( conection->state == TCP_ESTABLISHED &&
-//                 ( conection->remote_port != pkt->remote_port ||
-//                   conection->remote_address != pkt->remote_address ) )
-//         return false;
-//
-//       // udp connections have no state, however the kernel tries
-//       // to correlate udp packets into connections, when it is able
-//       // to assign the virtual state TCP_ESTABLISHED, when it is
-//       // unable to assign the state TCP_CLOSE, and it ends up not
-//       // exporting some data in /proc/net/udp, but we can "retrieve"
-//       // that information from the captured packet
-//       if ( conection->state == TCP_CLOSE )
-//         {
-//           conection->local_address = pkt->local_address;
-//           conection->remote_address = pkt->remote_address;
-//           conection->remote_port = pkt->remote_port;
-//         }
-//     }
-//
-//   return true;
-// }
-
-// static bool
-// check_udp( struct tuple *tp1, struct tuple *tp2 )
-// {
-//   if ( ( tp1->l4.remote_port != tp2->l4.remote_port ||
-//          tp1->l3.remote.ip != tp2->l3.remote.ip ) )
-//     return false;
-//
-// }
+// load factor of 0.5, power-of-two
+#define UNKNOWN_SLOTS ( STATISTICS_UNKNOWN * 2 )
 
-bool
-statistics_add ( const struct packet *pkt, bool view_conections )
+// traffic of a tuple missed, credited after update of processes
+struct pending
+{
+  uint64_t bytes[2];  // by direction, PKT_DOWN - 1 and PKT_UPL - 1
+  uint64_t packets[2];
+  uint32_t tstamp;  // tick of last packet
+  int if_index;
+};
+
+/* set of tuples missed, slots has index + 1 of tuple, 0 is free.
+   fixed size, no allocation by packet */
+static struct
+{
+  struct tuple tuples[STATISTICS_UNKNOWN];
+  struct pending pending[STATISTICS_UNKNOWN];
+  uint16_t slots[UNKNOWN_SLOTS];
+  size_t total;
+} unknown;
+
+/* options read in path of each packet, each combination has a variant of
+   statistics_add_batch and statistics_add_n where the options are constants,
+   so variant has no branches of options disabled (see select_variants) */
+#define OPT_CONNS 1     // view of connections
+#define OPT_SAMPLE 2    // traffic scaled by 'sample'
+#define OPT_LOOPBACK 4  // traffic of loopback counted
+#define OPT_REMOTES 8   // top remotes of processes
+#define TOTAL_VARIANTS 16
+
+// tuples that recently could not be associated, direct mapped, power-of-two
+#define NEGATIVE_CACHE 1024
+
+// max of seconds between tries to associate a tuple
+#define BACKOFF_MAX 64
+
+struct negative
+{
+  struct tuple tuple;
+  uint32_t retry_at;  // tick that tuple can be tried again
+  uint8_t backoff;    // seconds until next try, doubled on each fail
+  bool used;
+};
+
+static struct negative negative[NEGATIVE_CACHE];
+
+// traffic of each packet captured is of 'sample' packets, by estimate
+static unsigned int sample = 1;
+
+// ifindex of loopback with traffic counted, 0 is not counted
+static int loopback;
+
+// key of remotes of processes, TOP_REMOTES_*, 0 is off
+static int top_remotes;
+
+// totals by interface, in order of first packet
+static struct iface_total ifaces[STATISTICS_IFACES];
+static size_t total_ifaces;
+
+/* all traffic of interface, also of packets without process. consecutive
+   packets are of same interface, so the last found is tried first */
+static ALWAYS_INLINE void
+iface_add ( const struct packet *pkt,
+            uint64_t bytes,
+            size_t packets,
+            const unsigned int opts )
+{
+  static size_t last;
+
+  if ( last >= total_ifaces || ifaces[last].if_index != pkt->if_index )
+    {
+      for ( last = 0; last < total_ifaces; last++ )
+        {
+          if ( ifaces[last].if_index == pkt->if_index )
+            break;
+        }
+
+      if ( last == total_ifaces )
+        {
+          // interfaces beyond of table are not totalized
+          if ( total_ifaces == STATISTICS_IFACES )
+            return;
+
+          ifaces[total_ifaces++] =
+                  ( struct iface_total ){ .if_index = pkt->if_index };
+        }
+    }
+
+  if ( opts & OPT_SAMPLE )
+    {
+      bytes *= sample;
+      packets *= sample;
+    }
+
+  ifaces[last].bytes[pkt->direction - 1] += bytes;
+  ifaces[last].packets[pkt->direction - 1] += packets;
+}
+
+/* keep the traffic of packet until next update of processes,
+   return false if set is full, tuples beyond of STATISTICS_UNKNOWN are tried
+   only in next update */
+static bool
+unknown_add ( const struct packet *pkt,
+              uint64_t bytes,
+              size_t packets,
+              hash_t hash )
+{
+  size_t idx = hash & ( UNKNOWN_SLOTS - 1 );
+  struct pending *pending = NULL;
+
+  while ( unknown.slots[idx] )
+    {
+      if ( 0 == memcmp ( &unknown.tuples[unknown.slots[idx] - 1],
+                         &pkt->tuple,
+                         sizeof ( pkt->tuple ) ) )
+        {
+          pending = &unknown.pending[unknown.slots[idx] - 1];
+          break;
+        }
+
+      idx = ( idx + 1 ) & ( UNKNOWN_SLOTS - 1 );
+    }
+
+  if ( !pending )
+    {
+      if ( unknown.total == STATISTICS_UNKNOWN )
+        return false;
+
+      unknown.tuples[unknown.total] = pkt->tuple;
+      pending = &unknown.pending[unknown.total++];
+      *pending = ( struct pending ){ 0 };
+      unknown.slots[idx] = unknown.total;
+    }
+
+  pending->bytes[pkt->direction - 1] += bytes;
+  pending->packets[pkt->direction - 1] += packets;
+  pending->tstamp = pkt->tstamp;
+  pending->if_index = pkt->if_index;
+
+  return true;
+}
+
+static inline struct negative *
+negative_get ( const struct tuple *tuple, hash_t hash )
+{
+  struct negative *neg = &negative[hash & ( NEGATIVE_CACHE - 1 )];
+
+  if ( neg->used && 0 == memcmp ( &neg->tuple, tuple, sizeof ( *tuple ) ) )
+    return neg;
+
+  return NULL;
+}
+
+static ALWAYS_INLINE void
+add_to_stat ( struct net_stat *ns,
+              const struct packet *pkt,
+              uint64_t bytes,
+              size_t packets,
+              const unsigned int opts )
+{
+  if ( opts & OPT_SAMPLE )
+    {
+      bytes *= sample;
+      packets *= sample;
+    }
+
+  switch ( pkt->direction )
+    {
+      case PKT_DOWN:
+        rate_add_rx_n ( ns, bytes, packets, pkt->tstamp );
+        break;
+      case PKT_UPL:
+        rate_add_tx_n ( ns, bytes, packets, pkt->tstamp );
+    }
+}
+
+// sketch is allocated in first packet, without memory remote is not kept
+static void
+add_to_remotes ( process_t *proc, const struct topk_key *key, uint64_t bytes )
+{
+  if ( !proc->remotes && !( proc->remotes = topk_new () ) )
+    return;
+
+  topk_add ( proc->remotes, key, bytes * sample );
+}
+
+// histogram is allocated in first packet, without memory sizes are not kept
+static ALWAYS_INLINE void
+add_to_sizes ( process_t *proc,
+               const struct packet *pkt,
+               unsigned int bucket,
+               size_t packets )
 {
-  connection_t *conn;
+  if ( !proc->sizes && !( proc->sizes = pktsize_new () ) )
+    return;
+
+  pktsize_add ( proc->sizes,
+                ( pkt->direction == PKT_UPL ) ? PKTSIZE_TX : PKTSIZE_RX,
+                bucket,
+                packets );
+}
+
+// traffic of process is also of your row in aggregated view
+static ALWAYS_INLINE void
+add_to_proc ( process_t *proc,
+              const struct packet *pkt,
+              uint64_t bytes,
+              size_t packets,
+              const unsigned int opts )
+{
+  add_to_stat ( &proc->net_stat, pkt, bytes, packets, opts );
+
+  if ( proc->group )
+    add_to_stat ( &proc->group->net_stat, pkt, bytes, packets, opts );
+
+  // packets of a run are of same bucket (see add_batch and flow_acc.h)
+  unsigned int bucket = pktsize_bucket ( bytes, packets );
+  size_t scaled = ( opts & OPT_SAMPLE ) ? packets * sample : packets;
+
+  add_to_sizes ( proc, pkt, bucket, scaled );
+
+  if ( proc->group )
+    add_to_sizes ( proc->group, pkt, bucket, scaled );
+
+  if ( opts & OPT_REMOTES )
+    {
+      struct topk_key key;
+
+      // keys are compared with memcmp, padding zeroed
+      memset ( &key, 0, sizeof ( key ) );
+      key.addr = pkt->tuple.l3.remote;
+      key.family = pkt->tuple.family;
+      if ( top_remotes == TOP_REMOTES_PORT )
+        key.port = pkt->tuple.l4.remote_port;
+
+      add_to_remotes ( proc, &key, bytes );
 
-  conn = connection_get_by_tuple ( ( struct tuple * ) &pkt->tuple );
+      if ( proc->group )
+        add_to_remotes ( proc->group, &key, bytes );
+    }
+}
 
+static ALWAYS_INLINE bool
+add_to_conn ( connection_t *conn,
+              const struct packet *pkt,
+              uint64_t bytes,
+              size_t packets,
+              const unsigned int opts )
+{
   if ( conn )
     {
       process_t *proc = conn->proc;
@@ -102,20 +296,17 @@ statistics_add ( const struct packet *pkt, bool view_conections )
 
       conn->if_index = pkt->if_index;
 
-      switch ( pkt->direction )
-        {
-          case PKT_DOWN:
-            rate_add_rx ( &proc->net_stat, pkt->lenght );
+      add_to_proc ( proc, pkt, bytes, packets, opts );
 
-            if ( view_conections )
-              rate_add_rx ( &conn->net_stat, pkt->lenght );
+      // network of remote already classified (option --networks)
+      process_t *network = networks_row ( conn->network );
+      if ( network )
+        add_to_stat ( &network->net_stat, pkt, bytes, packets, opts );
 
-            break;
-          case PKT_UPL:
-            rate_add_tx ( &proc->net_stat, pkt->lenght );
-
-            if ( view_conections )
-              rate_add_tx ( &conn->net_stat, pkt->lenght );
+      if ( opts & OPT_CONNS )
+        {
+          add_to_stat ( &conn->net_stat, pkt, bytes, packets, opts );
+          conn->referenced = true;
         }
 
       return true;
@@ -123,3 +314,396 @@ statistics_add ( const struct packet *pkt, bool view_conections )
 
   return false;
 }
+
+/* after a miss by tuple, the packet can be of a unconnected udp socket.
+   with view of connections each peer is a sub-flow, so the next packets
+   match by tuple */
+static ALWAYS_INLINE connection_t *
+match_local ( const struct tuple *tuple, bool view_conections )
+{
+  connection_t *parent = connection_get_by_local ( tuple );
+
+  if ( !parent || !parent->proc || !view_conections )
+    return parent;
+
+  connection_t *conn = connection_new_subflow ( parent, tuple );
+  if ( !conn )
+    return parent;
+
+  processes_add_connection ( parent->proc, conn );
+
+  return conn;
+}
+
+/* traffic without process is not lost, is kept by tuple and credited to
+   the process found in next update (see statistics_unknown_done).
+   tuples that recently failed, retried only after of the backoff, and tuples
+   beyond of the set are accounted to the row 'unattributed'.
+   return true if is need update of processes */
+static bool
+add_to_unattributed ( const struct packet *pkt,
+                      uint64_t bytes,
+                      size_t packets,
+                      hash_t hash,
+                      const unsigned int opts )
+{
+  PROBE3 ( attribution_miss,
+           pkt->tuple.family,
+           pkt->tuple.l4.protocol,
+           pkt->tuple.l4.local_port );
+
+  struct negative *neg = negative_get ( &pkt->tuple, hash );
+
+  if ( ( !neg || pkt->tstamp >= neg->retry_at ) &&
+       unknown_add ( pkt, bytes, packets, hash ) )
+    return true;
+
+  add_to_proc ( processes_unattributed (), pkt, bytes, packets, opts );
+
+  return false;
+}
+
+// credit traffic kept of tuple to connection or to row 'unattributed'
+static void
+replay_pending ( connection_t *conn,
+                 const struct tuple *tuple,
+                 const struct pending *pending,
+                 const unsigned int opts )
+{
+  static const uint8_t directions[] = { PKT_DOWN, PKT_UPL };
+
+  for ( size_t i = 0; i < ARRAY_SIZE ( directions ); i++ )
+    {
+      if ( !pending->packets[i] )
+        continue;
+
+      struct packet pkt = { .tuple = *tuple,
+                            .tstamp = pending->tstamp,
+                            .if_index = pending->if_index,
+                            .direction = directions[i] };
+
+      if ( !add_to_conn ( conn,
+                          &pkt,
+                          pending->bytes[i],
+                          pending->packets[i],
+                          opts ) )
+        add_to_proc ( processes_unattributed (),
+                      &pkt,
+                      pending->bytes[i],
+                      pending->packets[i],
+                      opts );
+    }
+}
+
+/* credit packet to your connection or keep it to next update of processes,
+   return false if is need update of processes */
+static ALWAYS_INLINE bool
+add_packet ( const struct packet *pkt,
+             uint64_t bytes,
+             size_t packets,
+             hash_t hash,
+             const unsigned int opts )
+{
+  connection_t *conn = connection_get_by_tuple_hash ( &pkt->tuple, hash );
+
+  if ( !conn )
+    conn = match_local ( &pkt->tuple, opts & OPT_CONNS );
+
+  if ( add_to_conn ( conn, pkt, bytes, packets, opts ) )
+    return true;
+
+  return !add_to_unattributed ( pkt, bytes, packets, hash, opts );
+}
+
+/* in loopback only the copy sent is captured (see filter.h), the receiver
+   is also a local process, credited as download of the reverse tuple.
+   return false if is need update of processes */
+static ALWAYS_INLINE bool
+add_to_receiver ( const struct packet *pkt,
+                  uint64_t bytes,
+                  size_t packets,
+                  const unsigned int opts )
+{
+  struct packet rx;
+
+  // tuples are compared with memcmp, padding zeroed
+  memset ( &rx, 0, sizeof ( rx ) );
+  rx.tuple.l3.local = pkt->tuple.l3.remote;
+  rx.tuple.l3.remote = pkt->tuple.l3.local;
+  rx.tuple.l4.local_port = pkt->tuple.l4.remote_port;
+  rx.tuple.l4.remote_port = pkt->tuple.l4.local_port;
+  rx.tuple.l4.protocol = pkt->tuple.l4.protocol;
+  rx.tuple.family = pkt->tuple.family;
+  rx.tstamp = pkt->tstamp;
+  rx.if_index = pkt->if_index;
+  rx.direction = PKT_DOWN;
+
+  return add_packet ( &rx,
+                      bytes,
+                      packets,
+                      connection_hash_tuple ( &rx.tuple ),
+                      opts );
+}
+
+static ALWAYS_INLINE bool
+is_loopback ( const struct packet *pkt, const unsigned int opts )
+{
+  return ( opts & OPT_LOOPBACK ) && pkt->if_index == loopback &&
+         pkt->direction == PKT_UPL;
+}
+
+// options of current configuration, without OPT_CONNS
+static unsigned int options;
+
+const struct tuple *
+statistics_unknown ( size_t *total )
+{
+  *total = unknown.total;
+
+  return unknown.tuples;
+}
+
+void
+statistics_unknown_done ( uint32_t now, bool view_conections )
+{
+  for ( size_t i = 0; i < unknown.total; i++ )
+    {
+      const struct tuple *tuple = &unknown.tuples[i];
+      hash_t hash = connection_hash_tuple ( tuple );
+      connection_t *conn = connection_get_by_tuple_hash ( tuple, hash );
+      struct negative *neg = negative_get ( tuple, hash );
+
+      if ( !conn )
+        conn = match_local ( tuple, view_conections );
+
+      replay_pending ( conn,
+                       tuple,
+                       &unknown.pending[i],
+                       options | ( ( view_conections ) ? OPT_CONNS : 0 ) );
+
+      if ( conn && conn->proc )
+        {
+          if ( neg )
+            neg->used = false;
+
+          continue;
+        }
+
+      // a colision replace the old tuple
+      uint8_t backoff = neg ? MIN ( neg->backoff * 2, BACKOFF_MAX ) : 1;
+      negative[hash & ( NEGATIVE_CACHE - 1 )] =
+              ( struct negative ){ .tuple = *tuple,
+                                   .retry_at = now + rate_ticks ( backoff ),
+                                   .backoff = backoff,
+                                   .used = true };
+    }
+
+  memset ( unknown.slots, 0, sizeof ( unknown.slots ) );
+  unknown.total = 0;
+}
+
+static ALWAYS_INLINE bool
+add_n ( const struct packet *pkt,
+        uint64_t bytes,
+        size_t packets,
+        const unsigned int opts )
+{
+  iface_add ( pkt, bytes, packets, opts );
+
+  bool found = add_packet (
+          pkt, bytes, packets, connection_hash_tuple ( &pkt->tuple ), opts );
+
+  if ( is_loopback ( pkt, opts ) &&
+       !add_to_receiver ( pkt, bytes, packets, opts ) )
+    found = false;
+
+  return found;
+}
+
+const struct iface_total *
+statistics_ifaces ( size_t *total )
+{
+  *total = total_ifaces;
+
+  return ifaces;
+}
+
+static inline bool
+same_flow ( const struct packet *p1, const struct packet *p2 )
+{
+  return p1->direction == p2->direction && p1->tstamp == p2->tstamp &&
+         0 == memcmp ( &p1->tuple, &p2->tuple, sizeof ( p1->tuple ) );
+}
+
+// sequence of packets of same flow and of same bucket of size
+struct flow_run
+{
+  const struct packet *pkt;  // first packet of sequence
+  uint64_t bytes;
+  size_t packets;
+  hash_t hash;
+  unsigned int size_bucket;
+};
+
+static ALWAYS_INLINE bool
+add_batch ( const struct packet *pkts, size_t total, const unsigned int opts )
+{
+  struct flow_run runs[STATISTICS_BATCH];
+  size_t total_runs = 0;
+
+  // coalesce, bulk transfers arrive in long sequences of same flow
+  for ( size_t i = 0; i < total; i++ )
+    {
+      unsigned int size_bucket =
+              pktsize_bucket ( pkts[i].lenght, pkts[i].segments );
+
+      if ( total_runs && runs[total_runs - 1].size_bucket == size_bucket &&
+           same_flow ( runs[total_runs - 1].pkt, &pkts[i] ) )
+        {
+          runs[total_runs - 1].bytes += pkts[i].lenght;
+          runs[total_runs - 1].packets += pkts[i].segments;
+          continue;
+        }
+
+      runs[total_runs++] =
+              ( struct flow_run ){ .pkt = &pkts[i],
+                                   .bytes = pkts[i].lenght,
+                                   .packets = pkts[i].segments,
+                                   .size_bucket = size_bucket };
+    }
+
+  // hash all tuples and prefetch, so the misses of cache of each lookup
+  // are in parallel and not dependents
+  for ( size_t i = 0; i < total_runs; i++ )
+    {
+      iface_add ( runs[i].pkt, runs[i].bytes, runs[i].packets, opts );
+
+      runs[i].hash = connection_hash_tuple ( &runs[i].pkt->tuple );
+      connection_prefetch_bucket ( runs[i].hash );
+    }
+
+  for ( size_t i = 0; i < total_runs; i++ )
+    connection_prefetch_entry ( runs[i].hash );
+
+  bool found_all = true;
+  for ( size_t i = 0; i < total_runs; i++ )
+    {
+      if ( !add_packet ( runs[i].pkt,
+                         runs[i].bytes,
+                         runs[i].packets,
+                         runs[i].hash,
+                         opts ) )
+        found_all = false;
+
+      if ( is_loopback ( runs[i].pkt, opts ) &&
+           !add_to_receiver (
+                   runs[i].pkt, runs[i].bytes, runs[i].packets, opts ) )
+        found_all = false;
+    }
+
+  return found_all;
+}
+
+struct variant
+{
+  bool ( *add_batch ) ( const struct packet *pkts, size_t total );
+  bool ( *add_n ) ( const struct packet *pkt, uint64_t bytes, size_t packets );
+};
+
+#define DEFINE_VARIANT( opts )                                                 \
+  static bool add_batch_##opts ( const struct packet *pkts, size_t total )     \
+  {                                                                            \
+    return add_batch ( pkts, total, opts );                                    \
+  }                                                                            \
+                                                                               \
+  static bool add_n_##opts (                                                   \
+          const struct packet *pkt, uint64_t bytes, size_t packets )           \
+  {                                                                            \
+    return add_n ( pkt, bytes, packets, opts );                                \
+  }
+
+DEFINE_VARIANT ( 0 )
+DEFINE_VARIANT ( 1 )
+DEFINE_VARIANT ( 2 )
+DEFINE_VARIANT ( 3 )
+DEFINE_VARIANT ( 4 )
+DEFINE_VARIANT ( 5 )
+DEFINE_VARIANT ( 6 )
+DEFINE_VARIANT ( 7 )
+DEFINE_VARIANT ( 8 )
+DEFINE_VARIANT ( 9 )
+DEFINE_VARIANT ( 10 )
+DEFINE_VARIANT ( 11 )
+DEFINE_VARIANT ( 12 )
+DEFINE_VARIANT ( 13 )
+DEFINE_VARIANT ( 14 )
+DEFINE_VARIANT ( 15 )
+
+#define VARIANT( opts ) [opts] = { add_batch_##opts, add_n_##opts }
+
+static const struct variant variants[TOTAL_VARIANTS] = {
+  VARIANT ( 0 ),  VARIANT ( 1 ),  VARIANT ( 2 ),  VARIANT ( 3 ),
+  VARIANT ( 4 ),  VARIANT ( 5 ),  VARIANT ( 6 ),  VARIANT ( 7 ),
+  VARIANT ( 8 ),  VARIANT ( 9 ),  VARIANT ( 10 ), VARIANT ( 11 ),
+  VARIANT ( 12 ), VARIANT ( 13 ), VARIANT ( 14 ), VARIANT ( 15 )
+};
+
+// variants of current configuration, without and with view of connections
+static const struct variant *current[2] = { &variants[0],
+                                            &variants[OPT_CONNS] };
+
+// chosen only when a option change, never by packet
+static void
+select_variants ( void )
+{
+  options = ( ( sample > 1 ) ? OPT_SAMPLE : 0 ) |
+            ( ( loopback ) ? OPT_LOOPBACK : 0 ) |
+            ( ( top_remotes ) ? OPT_REMOTES : 0 );
+
+  current[0] = &variants[options];
+  current[1] = &variants[options | OPT_CONNS];
+}
+
+void
+statistics_loopback ( int if_index )
+{
+  loopback = if_index;
+  select_variants ();
+}
+
+void
+statistics_top_remotes ( int mode )
+{
+  top_remotes = mode;
+  select_variants ();
+}
+
+void
+statistics_sample ( unsigned int n )
+{
+  sample = ( n ) ? n : 1;
+  select_variants ();
+}
+
+bool
+statistics_add_batch ( const struct packet *pkts,
+                       size_t total,
+                       bool view_conections )
+{
+  return current[view_conections]->add_batch ( pkts, total );
+}
+
+bool
+statistics_add_n ( const struct packet *pkt,
+                   uint64_t bytes,
+                   size_t packets,
+                   bool view_conections )
+{
+  return current[view_conections]->add_n ( pkt, bytes, packets );
+}
+
+bool
+statistics_add ( const struct packet *pkt, bool view_conections )
+{
+  return statistics_add_n ( pkt, pkt->lenght, pkt->segments, view_conections );
+}
@@ -22,12 +22,89 @@
 #define STATISTICS_PROC_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "config.h"
+#include "packet.h"
 #include "processes.h"
 
-/* find process that belongs the connection and update statistics of network */
+/* find process that belongs the connection and update statistics of network,
+   in the second pkt->tstamp. traffic without process is kept until
+   statistics_unknown_done and false is returned if is need update
+   the processes. the size of packet is also counted in histogram of
+   process (see pktsize.h) */
 bool
 statistics_add ( const struct packet *pkt, bool view_conections );
 
+/* same that statistics_add, but 'pkt' represent 'packets' packets of same flow
+   with sum of lenght in 'bytes', pkt->lenght is ignored */
+bool
+statistics_add_n ( const struct packet *pkt,
+                   uint64_t bytes,
+                   size_t packets,
+                   bool view_conections );
+
+/* traffic of loopback 'if_index' is counted (see co->loopback), each packet
+   sent is also credited as received by the process of the other end, the
+   copy received is dropped by filter. 0 is not counted */
+void
+statistics_loopback ( int if_index );
+
+/* remotes with most bytes of each process are kept in process->remotes,
+   by 'mode' TOP_REMOTES_HOST or TOP_REMOTES_PORT (see co->top_remotes).
+   0 is not kept */
+void
+statistics_top_remotes ( int mode );
+
+// max of interfaces with totals, of statistics_ifaces
+#define STATISTICS_IFACES 64
+
+// traffic of an interface since start, of connection->if_index
+struct iface_total
+{
+  uint64_t bytes[2];  // by direction, PKT_DOWN - 1 and PKT_UPL - 1
+  uint64_t packets[2];
+  int if_index;
+};
+
+/* totals of all traffic captured by interface, also of packets without
+   process, in order of first packet */
+const struct iface_total *
+statistics_ifaces ( size_t *total );
+
+/* in sample mode only 1 in 'sample' packets is captured (see filter.h),
+   so traffic of each flow is scaled by 'sample' when accounted */
+void
+statistics_sample ( unsigned int sample );
+
+// max packets to statistics_add_batch
+#define STATISTICS_BATCH 64
+
+/* same that statistics_add to 'total' packets (up to STATISTICS_BATCH),
+   consecutive packets of same flow (and of same bucket of size) are added
+   at once and the connections are looked up after prefetched. return false
+   if any packet not was associated with a process.
+   the loop is of a variant without tests of options disabled (sample,
+   loopback, top remotes), chosen when they are set */
+bool
+statistics_add_batch ( const struct packet *pkts,
+                       size_t total,
+                       bool view_conections );
+
+// max of tuples without process remembered until statistics_unknown_done
+#define STATISTICS_UNKNOWN 256
+
+/* tuples of packets that not were associated with a process since last
+   statistics_unknown_done, each one once */
+const struct tuple *
+statistics_unknown ( size_t *total );
+
+/* called after update of processes, the traffic of tuples missed is
+   credited to the processes found, or to processes_unattributed.
+   the tuples still without process are not tried again (don't need update)
+   until a backoff, doubled on each fail, and the set is cleared.
+   'now' is the tick of time (see rate_now) */
+void
+statistics_unknown_done ( uint32_t now, bool view_conections );
+
 #endif  // STATISTICS_PROC_H
@@ -0,0 +1,437 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>   // variable errno
+#include <fcntl.h>   // fcntl
+#include <stdint.h>
+#include <stdlib.h>  // malloc
+#include <string.h>  // strlen, memcpy
+#include <time.h>    // time
+#include <unistd.h>  // write, close
+#include <arpa/inet.h>  // inet_ntop
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "stream.h"
+#include "sockaddr.h"
+#include "m_error.h"
+#include "macro_util.h"
+
+// initial size of buffer of records, grows if a refresh not fit
+#define STREAM_BUFFER ( 64 * 1024 )
+
+// space of a record, without the name of process
+#define RECORD_SPACE 512
+
+static const char csv_header[] =
+        "time,type,pid,name,proto,local,remote,"
+        "rx,tx,pps_rx,pps_tx,total_rx,total_tx,sample\n";
+
+// records of a refresh, 'sent' is less than 'len' while not written all
+static struct
+{
+  char *data;
+  size_t len;
+  size_t sent;
+  size_t size;
+} buf;
+
+static const char *path_socket;
+static unsigned long dropped;
+static int stdout_flags = -1;  // restored on exit
+static int format;
+static int fd = -1;
+static bool header;  // csv header already written in this descriptor
+
+static inline void
+put_raw ( const char *s, size_t len )
+{
+  memcpy ( buf.data + buf.len, s, len );
+  buf.len += len;
+}
+
+#define put_literal( s ) put_raw ( s, sizeof ( s ) - 1 )
+
+static inline void
+put_char ( char c )
+{
+  buf.data[buf.len++] = c;
+}
+
+static void
+put_u64 ( uint64_t value )
+{
+  char digits[20];
+  size_t i = sizeof digits;
+
+  do
+    {
+      digits[--i] = '0' + value % 10;
+      value /= 10;
+    }
+  while ( value );
+
+  put_raw ( digits + i, sizeof digits - i );
+}
+
+static void
+put_string ( const char *s )
+{
+  static const char hex[] = "0123456789abcdef";
+
+  if ( format == STREAM_CSV )
+    {
+      // quoted only if need, quote is doubled
+      if ( !s[strcspn ( s, ",\"\r\n" )] )
+        {
+          put_raw ( s, strlen ( s ) );
+          return;
+        }
+
+      put_char ( '"' );
+      for ( ; *s; s++ )
+        {
+          if ( *s == '"' )
+            put_char ( '"' );
+          put_char ( *s );
+        }
+      put_char ( '"' );
+      return;
+    }
+
+  put_char ( '"' );
+  for ( ; *s; s++ )
+    {
+      unsigned char c = *s;
+
+      if ( c == '"' || c == '\\' )
+        {
+          put_char ( '\\' );
+          put_char ( c );
+        }
+      else if ( c < 0x20 )
+        {
+          put_literal ( "\\u00" );
+          put_char ( hex[c >> 4] );
+          put_char ( hex[c & 0xf] );
+        }
+      else
+        put_char ( c );
+    }
+  put_char ( '"' );
+}
+
+// ip:port, ipv6 in brackets
+static void
+put_address ( const union inet_all *addr, uint16_t port, uint8_t family )
+{
+  char ip[INET6_ADDRSTRLEN];
+
+  if ( !inet_ntop ( family, addr, ip, sizeof ip ) )
+    ip[0] = '\0';
+
+  if ( format == STREAM_NDJSON )
+    put_char ( '"' );
+
+  if ( family == AF_INET6 )
+    put_char ( '[' );
+
+  put_raw ( ip, strlen ( ip ) );
+
+  if ( family == AF_INET6 )
+    put_char ( ']' );
+
+  put_char ( ':' );
+  put_u64 ( port );
+
+  if ( format == STREAM_NDJSON )
+    put_char ( '"' );
+}
+
+static bool
+reserve ( size_t len )
+{
+  if ( buf.len + len <= buf.size )
+    return true;
+
+  size_t size = MAX ( buf.size * 2, buf.len + len );
+  char *data = realloc ( buf.data, size );
+  if ( !data )
+    return false;
+
+  buf.data = data;
+  buf.size = size;
+  return true;
+}
+
+// field separator and name of field, in csv only the separator
+#define FIELD( name ) \
+  ( ( format == STREAM_NDJSON ) ? put_literal ( ",\"" name "\":" ) \
+                                : put_char ( ',' ) )
+
+static bool
+put_record ( uint64_t now,
+             const char *type,
+             const process_t *proc,
+             const connection_t *conn,
+             const struct config_op *co )
+{
+  if ( !reserve ( RECORD_SPACE + strlen ( proc->name ) * 6 ) )
+    return false;
+
+  const struct net_stat *ns = ( conn ) ? &conn->net_stat : &proc->net_stat;
+
+  // rates are in bits without option '-B'
+  unsigned int div = ( co->view_bytes ) ? 1 : 8;
+
+  if ( format == STREAM_NDJSON )
+    put_literal ( "{\"time\":" );
+
+  put_u64 ( now );
+  FIELD ( "type" );
+  put_string ( type );
+  FIELD ( "pid" );
+  put_u64 ( proc->pid );
+  FIELD ( "name" );
+  put_string ( proc->name );
+
+  if ( conn )
+    {
+      const struct tuple *t = &conn->tuple;
+
+      FIELD ( "proto" );
+      put_string ( ( t->l4.protocol == IPPROTO_UDP ) ? "udp" : "tcp" );
+      FIELD ( "local" );
+      put_address ( &t->l3.local, t->l4.local_port, t->family );
+      FIELD ( "remote" );
+      put_address ( &t->l3.remote, t->l4.remote_port, t->family );
+    }
+  else if ( format == STREAM_CSV )
+    put_literal ( ",,," );
+
+  FIELD ( "rx" );
+  put_u64 ( ns->avg_Bps_rx / div );
+  FIELD ( "tx" );
+  put_u64 ( ns->avg_Bps_tx / div );
+  FIELD ( "pps_rx" );
+  put_u64 ( ns->avg_pps_rx );
+  FIELD ( "pps_tx" );
+  put_u64 ( ns->avg_pps_tx );
+  FIELD ( "total_rx" );
+  put_u64 ( ns->tot_Bps_rx );
+  FIELD ( "total_tx" );
+  put_u64 ( ns->tot_Bps_tx );
+
+  // above 1 the values are estimates
+  FIELD ( "sample" );
+  put_u64 ( co->sample );
+
+  if ( format == STREAM_NDJSON )
+    put_char ( '}' );
+
+  put_char ( '\n' );
+
+  return true;
+}
+
+static void
+stream_close ( void )
+{
+  if ( path_socket && fd != -1 )
+    close ( fd );
+
+  fd = -1;
+  buf.len = buf.sent = 0;
+}
+
+static bool
+stream_connect ( void )
+{
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+  if ( strlen ( path_socket ) >= sizeof addr.sun_path )
+    return false;
+
+  strcpy ( addr.sun_path, path_socket );
+
+  fd = socket ( AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+  if ( fd == -1 )
+    return false;
+
+  if ( connect ( fd, ( struct sockaddr * ) &addr, sizeof addr ) == -1 )
+    {
+      close ( fd );
+      fd = -1;
+      return false;
+    }
+
+  header = false;
+  return true;
+}
+
+// write what is pending of buffer, false on error of descriptor
+static bool
+stream_flush ( void )
+{
+  while ( buf.sent < buf.len )
+    {
+      ssize_t n;
+      size_t len = buf.len - buf.sent;
+
+      // socket closed by consumer not kill the process with SIGPIPE
+      if ( path_socket )
+        n = send ( fd, buf.data + buf.sent, len, MSG_NOSIGNAL );
+      else
+        n = write ( fd, buf.data + buf.sent, len );
+
+      if ( n == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          if ( errno == EAGAIN || errno == EWOULDBLOCK )
+            return true;
+
+          return false;
+        }
+
+      buf.sent += n;
+    }
+
+  return true;
+}
+
+bool
+stream_init ( const struct config_op *co )
+{
+  format = co->stream;
+  path_socket = co->stream_socket;
+
+  buf.data = malloc ( STREAM_BUFFER );
+  if ( !buf.data )
+    return false;
+
+  buf.size = STREAM_BUFFER;
+
+  if ( path_socket )
+    return stream_connect ();
+
+  int flags = fcntl ( STDOUT_FILENO, F_GETFL );
+  if ( flags == -1 ||
+       fcntl ( STDOUT_FILENO, F_SETFL, flags | O_NONBLOCK ) == -1 )
+    return false;
+
+  stdout_flags = flags;
+  fd = STDOUT_FILENO;
+
+  return true;
+}
+
+void
+stream_tick ( process_t **processes,
+              size_t total,
+              const struct config_op *co )
+{
+  if ( !buf.data )
+    return;
+
+  // consumer of socket closed, is connected again in next refreshes
+  if ( fd == -1 && ( !path_socket || !stream_connect () ) )
+    return;
+
+  // refresh previous not was read yet, this is dropped
+  if ( buf.sent < buf.len )
+    {
+      if ( !stream_flush () )
+        goto ERROR;
+
+      if ( buf.sent < buf.len )
+        {
+          dropped++;
+          return;
+        }
+    }
+
+  buf.len = buf.sent = 0;
+
+  // if refresh is dropped, header is written with the next
+  if ( format == STREAM_CSV && !header )
+    put_literal ( csv_header );
+
+  uint64_t now = time ( NULL );
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      const process_t *proc = processes[i];
+      const struct net_stat *ns = &proc->net_stat;
+
+      if ( !ns->avg_Bps_rx && !ns->avg_Bps_tx )
+        continue;
+
+      if ( !put_record ( now, "process", proc, NULL, co ) )
+        goto ERROR_ALLOC;
+
+      if ( !co->view_conections )
+        continue;
+
+      for ( size_t c = 0; c < proc->total_conections; c++ )
+        {
+          const connection_t *conn = proc->conections[c];
+
+          if ( !conn->net_stat.avg_Bps_rx && !conn->net_stat.avg_Bps_tx )
+            continue;
+
+          if ( !put_record ( now, "connection", proc, conn, co ) )
+            goto ERROR_ALLOC;
+        }
+    }
+
+  header = true;
+
+  if ( stream_flush () )
+    return;
+
+ERROR:
+  ERROR_DEBUG ( "Error write stream: %s", strerror ( errno ) );
+  stream_close ();
+  return;
+
+ERROR_ALLOC:
+  // records of this refresh are dropped
+  ERROR_DEBUG ( "%s", "Error alloc buffer of stream" );
+  buf.len = buf.sent = 0;
+  dropped++;
+}
+
+void
+stream_free ( void )
+{
+  if ( dropped )
+    {
+      ERROR_DEBUG ( "Refreshes dropped by stream: %lu", dropped );
+    }
+
+  if ( stdout_flags != -1 )
+    fcntl ( STDOUT_FILENO, F_SETFL, stdout_flags );
+
+  stream_close ();
+  free ( buf.data );
+  buf.data = NULL;
+}
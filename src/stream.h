@@ -0,0 +1,48 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>  // size_t
+
+#include "processes.h"
+#include "config.h"
+
+/* records of processes and connections with traffic, one by line in each
+   refresh, as NDJSON or CSV, to stdout or to a Unix socket.
+   the records of a refresh are formatted in one buffer and written with
+   one write, the descriptor is non blocking, so while the consumer not
+   read the refresh previous the new refreshes are dropped and the capture
+   never waits for it */
+
+bool
+stream_init ( const struct config_op *co );
+
+// write records of this refresh, after rate_calc
+void
+stream_tick ( process_t **processes,
+              size_t total,
+              const struct config_op *co );
+
+void
+stream_free ( void );
+
+#endif  // STREAM_H
@@ -18,10 +18,17 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
-#include <time.h>  // struct timespec
+#include <time.h>         // struct timespec
+#include <errno.h>
+#include <unistd.h>        // read
+#include <sys/timerfd.h>  // timerfd_create
+
+#include "timer.h"
+#include "m_error.h"
 
 // return current time in milliseconds
 uint64_t
@@ -42,6 +49,53 @@ get_time ( void )
   return ts.tv_sec * 1000U + ts.tv_nsec / 1000000UL;
 }
 
+int
+timer_periodic ( uint32_t msec )
+{
+  int fd = timerfd_create ( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+  if ( fd == -1 )
+    {
+      ERROR_DEBUG ( "Error create timer: %s", strerror ( errno ) );
+      return -1;
+    }
+
+  if ( !timer_set ( fd, msec ) )
+    {
+      close ( fd );
+      return -1;
+    }
+
+  return fd;
+}
+
+bool
+timer_set ( int fd, uint32_t msec )
+{
+  struct timespec ts = { .tv_sec = msec / 1000U,
+                         .tv_nsec = ( msec % 1000U ) * 1000000UL };
+
+  struct itimerspec its = { .it_interval = ts, .it_value = ts };
+
+  if ( timerfd_settime ( fd, 0, &its, NULL ) == -1 )
+    {
+      ERROR_DEBUG ( "Error start timer: %s", strerror ( errno ) );
+      return false;
+    }
+
+  return true;
+}
+
+uint64_t
+timer_expirations ( int fd )
+{
+  uint64_t exp;
+
+  if ( read ( fd, &exp, sizeof ( exp ) ) != sizeof ( exp ) )
+    return 0;  // EAGAIN, not expired yet
+
+  return exp;
+}
+
 // hh:mm:ss
 #define LEN_BUFF_CLOCK 14
 
@@ -21,6 +21,7 @@
 #ifndef M_TIME_H
 #define M_TIME_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <time.h>  // struct timespec
 
@@ -28,6 +29,20 @@
 uint64_t
 get_time ( void );
 
+/* create a timer that expire each 'msec' milliseconds, the intervals are
+   kept by kernel so the ticks not drift with the time of processing.
+   return a file descriptor (non blocking) to poll or -1 on failure */
+int
+timer_periodic ( uint32_t msec );
+
+// change interval of timer, first expiration after 'msec'
+bool
+timer_set ( int fd, uint32_t msec );
+
+// return the number of expirations since last call, 0 if none
+uint64_t
+timer_expirations ( int fd );
+
 // transform milliseconds in format hh:mm:ss
 char *
 msec2clock ( uint64_t milliseconds );
@@ -0,0 +1,124 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>      // snprintf
+#include <string.h>     // memcmp
+#include <arpa/inet.h>  // inet_ntop
+
+#include "topk.h"
+#include "pool.h"
+
+static struct pool topk_pool;
+
+struct topk *
+topk_new ( void )
+{
+  if ( !topk_pool.obj_size )
+    pool_init ( &topk_pool, "remotes", sizeof ( struct topk ), 0 );
+
+  return pool_calloc ( &topk_pool );
+}
+
+void
+topk_free ( struct topk *tk )
+{
+  if ( tk )
+    pool_free ( &topk_pool, tk );
+}
+
+void
+topk_add ( struct topk *tk, const struct topk_key *key, uint64_t bytes )
+{
+  struct topk_entry *min = NULL;
+
+  for ( unsigned int i = 0; i < tk->total; i++ )
+    {
+      struct topk_entry *e = &tk->entries[i];
+
+      if ( 0 == memcmp ( &e->key, key, sizeof ( *key ) ) )
+        {
+          e->bytes += bytes;
+          return;
+        }
+
+      if ( !min || e->bytes < min->bytes )
+        min = e;
+    }
+
+  if ( tk->total < TOPK_ENTRIES )
+    {
+      tk->entries[tk->total++] =
+              ( struct topk_entry ){ .key = *key, .bytes = bytes };
+      return;
+    }
+
+  // key with less traffic is replaced, your count is the error of new key
+  min->key = *key;
+  min->error = min->bytes;
+  min->bytes += bytes;
+}
+
+void
+topk_merge ( struct topk *dst, const struct topk *src )
+{
+  for ( unsigned int i = 0; i < src->total; i++ )
+    topk_add ( dst, &src->entries[i].key, src->entries[i].bytes );
+}
+
+void
+topk_sort ( struct topk *tk )
+{
+  // insertion sort, few entries and almost always already sorted
+  for ( unsigned int i = 1; i < tk->total; i++ )
+    {
+      struct topk_entry e = tk->entries[i];
+      unsigned int j = i;
+
+      while ( j && tk->entries[j - 1].bytes < e.bytes )
+        {
+          tk->entries[j] = tk->entries[j - 1];
+          j--;
+        }
+
+      tk->entries[j] = e;
+    }
+}
+
+void
+topk_key_str ( const struct topk_key *key, char *buf, size_t len )
+{
+  char ip[INET6_ADDRSTRLEN];
+
+  if ( !inet_ntop ( key->family, &key->addr, ip, sizeof ip ) )
+    snprintf ( ip, sizeof ip, "%s", "?" );
+
+  if ( !key->port )
+    snprintf ( buf, len, "%s", ip );
+  else if ( key->family == AF_INET6 )
+    snprintf ( buf, len, "[%s]:%u", ip, key->port );
+  else
+    snprintf ( buf, len, "%s:%u", ip, key->port );
+}
+
+size_t
+topk_memory ( void )
+{
+  return topk_pool.used * topk_pool.obj_size;
+}
@@ -0,0 +1,91 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOPK_H
+#define TOPK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>  // INET6_ADDRSTRLEN
+
+#include "sockaddr.h"  // union inet_all
+
+/* heavy hitters of traffic by Space-Saving, with a fixed number of counters.
+   a key not tracked replace the counter with less bytes and inherit your
+   count as error, so 'bytes' is a upper bound and 'bytes - error' a lower
+   bound of real traffic of key. any key with more than 1 / TOPK_ENTRIES of
+   all traffic is always tracked */
+
+#define TOPK_ENTRIES 8
+
+// "[ipv6]:port"
+#define TOPK_KEY_STRLEN ( INET6_ADDRSTRLEN + 8 )
+
+// compared with memcmp, padding must be zeroed
+struct topk_key
+{
+  union inet_all addr;
+  uint16_t port;  // 0 if only by host
+  uint8_t family;
+};
+
+struct topk_entry
+{
+  struct topk_key key;
+  uint64_t bytes;  // estimate, never less than real
+  uint64_t error;  // max of overestimate
+};
+
+struct topk
+{
+  struct topk_entry entries[TOPK_ENTRIES];
+  unsigned int total;
+};
+
+// return NULL if no memory, objects are of a pool (not thread safe)
+struct topk *
+topk_new ( void );
+
+void
+topk_free ( struct topk *tk );
+
+// add 'bytes' to 'key', constant time (at most TOPK_ENTRIES compares)
+void
+topk_add ( struct topk *tk, const struct topk_key *key, uint64_t bytes );
+
+/* add entries of 'src' to 'dst', as aggregated rows. 'bytes' stay a upper
+   bound, but the error of 'src' is not kept */
+void
+topk_merge ( struct topk *dst, const struct topk *src );
+
+/* sort entries by bytes, decreasing. the keys with more traffic stay first,
+   so they are also found first in next topk_add */
+void
+topk_sort ( struct topk *tk );
+
+// key as text, as "10.0.0.1", "10.0.0.1:443" or "[fd00::1]:443"
+void
+topk_key_str ( const struct topk_key *key, char *buf, size_t len );
+
+// bytes in use by sketches
+size_t
+topk_memory ( void );
+
+#endif  // TOPK_H
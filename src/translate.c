@@ -18,8 +18,9 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <stdio.h>  // snprintf
-#include <string.h>
+#include <stdio.h>   // snprintf
+#include <stdlib.h>  // free
+#include <string.h>  // strdup
 #include <stdbool.h>
 #include <netdb.h>      // NI_MAXHOST, NI_MAXSERV
 #include <arpa/inet.h>  // htons
@@ -29,32 +30,101 @@
 #include "sockaddr.h"
 #include "resolver/sock_util.h"
 #include "resolver/resolver.h"
+#include "m_error.h"
 
 #define LEN_TUPLE ( ( NI_MAXHOST + NI_MAXSERV ) * 2 ) + 7 + 10
 
-char *
-translate ( const connection_t *con, const struct config_op *co )
+// sin_port and sin6_port are in the same offset
+static void
+to_sockaddr ( union sockaddr_all *sock,
+              const union inet_all *addr,
+              uint16_t port,
+              uint8_t family )
 {
+  memset ( sock, 0, sizeof ( *sock ) );
+
+  if ( family == AF_INET6 )
+    {
+      sock->in6.sin6_family = AF_INET6;
+      sock->in6.sin6_port = port;
+      sock->in6.sin6_addr = addr->in6;
+    }
+  else
+    {
+      sock->in.sin_family = AF_INET;
+      sock->in.sin_port = port;
+      sock->in.sin_addr.s_addr = addr->ip;
+    }
+}
+
+// resolver is started in first name requested, not in start of netproc
+static int resolver_state;  // 0 not started, 1 started, -1 failed
+
+static bool
+resolver_start ( const struct config_op *co )
+{
+  if ( !resolver_state )
+    {
+      resolver_state =
+              resolver_init ( co->dns_cache * 1024UL, co->dns_cache_file, 0 )
+                      ? 1
+                      : -1;
+
+      // without resolver, hosts are numeric
+      if ( resolver_state == -1 )
+        {
+          ERROR_DEBUG ( "%s", "Error resolver_init" );
+        }
+    }
+
+  return resolver_state == 1;
+}
+
+// with load, text already formatted is kept and new hosts are numeric
+static bool paused;
+
+void
+translate_pause ( bool pause )
+{
+  paused = pause;
+}
+
+const char *
+translate ( connection_t *con,
+            const struct config_op *co,
+            unsigned int priority )
+{
+  if ( paused && con->display )
+    return con->display;
+
+  bool hosts = !paused && co->translate_host && resolver_start ( co );
+
+  // read before of format, a name resolved meanwhile is seen in next call
+  uint32_t gen = ( ( hosts ) ? domain_generation () : 0 ) +
+                 ( ( co->translate_service ) ? service_generation () : 0 );
+
+  if ( con->display && con->display_gen == gen )
+    return con->display;
+
   // NOTE: structs members should be zered
+  union sockaddr_all l_sock, r_sock;
 
-  // local_socket
-  union sockaddr_all l_sock = { .in = { .sin_family = AF_INET,
-                                        .sin_port = con->tuple.l4.local_port,
-                                        .sin_addr.s_addr =
-                                                con->tuple.l3.local.ip } };
+  to_sockaddr ( &l_sock,
+                &con->tuple.l3.local,
+                con->tuple.l4.local_port,
+                con->tuple.family );
 
-  // remote_socket
-  union sockaddr_all r_sock = { .in = { .sin_family = AF_INET,
-                                        .sin_port = con->tuple.l4.remote_port,
-                                        .sin_addr.s_addr =
-                                                con->tuple.l3.remote.ip } };
+  to_sockaddr ( &r_sock,
+                &con->tuple.l3.remote,
+                con->tuple.l4.remote_port,
+                con->tuple.family );
 
   char l_host[NI_MAXHOST], r_host[NI_MAXHOST];
 
-  if ( co->translate_host )
+  if ( hosts )
     {
-      ip2domain ( &l_sock, l_host, sizeof ( l_host ) );
-      ip2domain ( &r_sock, r_host, sizeof ( r_host ) );
+      ip2domain ( &l_sock, priority, l_host, sizeof ( l_host ) );
+      ip2domain ( &r_sock, priority, r_host, sizeof ( r_host ) );
     }
   else
     {
@@ -102,13 +172,31 @@ translate ( const connection_t *con, const struct config_op *co )
   // tuple ip:port <-> ip:port
   static char tuple[LEN_TUPLE];
 
+  // ipv6 numeric in brackets, to not confuse with port
+  bool brackets = con->tuple.family == AF_INET6 && !hosts;
+  const char *br_open = ( brackets ) ? "[" : "";
+  const char *br_close = ( brackets ) ? "]" : "";
+
   snprintf ( tuple,
              sizeof ( tuple ),
-             "%s:%s <-> %s:%s",
+             "%s%s%s:%s <-> %s%s%s:%s",
+             br_open,
              l_host,
+             br_close,
              l_service,
+             br_open,
              r_host,
+             br_close,
              r_service );
 
-  return tuple;
+  // without memory, text is formatted in each call
+  char *display = strdup ( tuple );
+  if ( !display )
+    return tuple;
+
+  free ( con->display );
+  con->display = display;
+  con->display_gen = gen;
+
+  return display;
 }
@@ -24,7 +24,16 @@
 #include "connection.h"
 #include "config.h"
 
-char *
-translate ( const connection_t *con, const struct config_op *co );
+/* tuple of connection as text, with names of hosts and services if enabled.
+   the text is kept in connection and formatted again only when the resolver
+   has new names. 'priority' of lookups of names, see DOMAIN_PRIO_* */
+const char *
+translate ( connection_t *con,
+            const struct config_op *co,
+            unsigned int priority );
+
+// while paused names are not looked up, see OVERLOAD_NAMES
+void
+translate_pause ( bool pause );
 
 #endif  // TRANSLETE_H
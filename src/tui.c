@@ -20,16 +20,19 @@
 
 #include <stdbool.h>
 #include <string.h>  // strlen
-#include <net/if.h>  // if_indextoname, IF_NAMESIZE
+#include <inttypes.h>  // PRIu64
+#include <net/if.h>  // IF_NAMESIZE
 #include <ncurses.h>
 
-#include "str.h"
 #include "timer.h"
 #include "processes.h"
 #include "connection.h"
+#include "sock_diag.h"  // struct sock_diag_tcp_info
+#include "iface.h"
 #include "color.h"
 #include "m_error.h"
 #include "translate.h"
+#include "resolver/domain.h"  // DOMAIN_PRIO_*
 #include "tui.h"
 #include "usage.h"
 #include "sort.h"
@@ -37,6 +40,17 @@
 #include "human_readable.h"
 #include "pid.h"
 #include "macro_util.h"
+#include "profile.h"
+#include "lag.h"
+#include "pool.h"
+#include "hugemem.h"
+#include "intern.h"
+#include "ring.h"  // ring_locked
+#include "aggregate.h"
+#include "memory.h"
+#include "topk.h"
+#include "pktsize.h"
+#include "overload.h"
 
 #define PORTLEN 5  // strlen("65535")
 
@@ -60,6 +74,8 @@
 
 #define MIN_COLS_PAD PROGRAM + START_NAME_PROGRAM
 
+static WINDOW *stats_win = NULL;  // line of --self-stats
+static WINDOW *sizes_win = NULL;  // pane of sizes of packets, key 'z'
 static WINDOW *pad = NULL;
 static int *color_scheme;
 
@@ -67,12 +83,27 @@ static int *color_scheme;
 static chtype *line_original = NULL;  // size is equal cur_cols
 
 static int sort_by = RATE_RX;  // ordenação padrão
+static int aggregate = AGG_NONE;  // rows by process or aggregated
 static int scroll_x = 0;
 static int scroll_y = LINE_START + 1;
 static int selected = LINE_START + 1;  // posição de linha do item selecionado
 
 static int tot_rows;  // total linhas exibidas
 
+/* rows of tcp connections in screen of last refresh, the TCP_INFO of all
+   them is read in a single batch and shown at end of row */
+static struct tcp_row
+{
+  const connection_t *conn;
+  int row;
+  int col;  // after the tuple
+} tcp_rows[SOCK_DIAG_BATCH];
+static size_t total_tcp_rows;
+
+// process with row selected, or rows of your connections or remotes
+static const process_t *selected_proc;
+static bool show_sizes;
+
 static int tot_proc_act = 0;  // total de processos com conexão ativa
 
 // statistics total in current time
@@ -85,6 +116,12 @@ static int cur_lines;
 
 static int max_digits_pid;
 
+// width of largest row formatted
+static int tot_cols = 0;
+
+// rows of pad formatted in last tui_show, the others are blank
+static int render_first, render_last;
+
 static void
 paint_selected ( void )
 {
@@ -100,6 +137,115 @@ paint_selected ( void )
                      color_scheme[SELECTED_L] );
 }
 
+// show backend of capture, to ring buffer show your geometry
+// (per capture thread)
+static void
+show_capture ( const struct config_op *co )
+{
+  if ( co->replay )
+    {
+      mvwprintw ( pad, 0, 25, "replay: " );
+      wattrset ( pad, color_scheme[RESUME_VALUE] );
+      wprintw ( pad, "%ux\n", co->replay_speed );
+      wattrset ( pad, color_scheme[RESUME] );
+      return;
+    }
+
+  if ( co->ebpf )
+    {
+      mvwprintw ( pad, 0, 25, "capture: " );
+      wattrset ( pad, color_scheme[RESUME_VALUE] );
+      wprintw ( pad, "ebpf\n" );
+      wattrset ( pad, color_scheme[RESUME] );
+      return;
+    }
+
+  // blocks of ring of each interface, as '4/16'
+  mvwprintw ( pad, 0, 25, "ring: " );
+  wattrset ( pad, color_scheme[RESUME_VALUE] );
+  for ( unsigned int i = 0; i < co->total_ifaces; i++ )
+    wprintw ( pad, ( i ) ? "/%u" : "%u", co->iface_blocks[i] );
+  wprintw ( pad, " x %u KiB", co->ring_block_size / 1024 );
+  if ( co->capture_threads > 1 )
+    wprintw ( pad, " x %u threads", co->capture_threads );
+  if ( ring_locked () )
+    wprintw ( pad, " locked" );
+  wattrset ( pad, color_scheme[RESUME] );
+  wprintw ( pad, " timeout: " );
+  wattrset ( pad, color_scheme[RESUME_VALUE] );
+  if ( co->ring_timeout )
+    wprintw ( pad, "%u ms", co->ring_timeout );
+  else
+    wprintw ( pad, "auto" );
+
+  // tables really in huge pages, grow with traffic
+  if ( co->hugepages )
+    {
+      wattrset ( pad, color_scheme[RESUME] );
+      wprintw ( pad, " huge: " );
+      wattrset ( pad, color_scheme[RESUME_VALUE] );
+      wprintw ( pad, "%zu MiB", hugemem_bytes () >> 20 );
+    }
+
+  wprintw ( pad, "\n" );
+  wattrset ( pad, color_scheme[RESUME] );
+}
+
+// work shed by load, of '--overload-auto'
+static void
+show_overload ( void )
+{
+  if ( overload_level () == OVERLOAD_NONE )
+    return;
+
+  wprintw ( pad, " overload: " );
+  wattrset ( pad, color_scheme[RESUME_VALUE] );
+  wprintw ( pad, "%s", overload_name ( overload_level () ) );
+  wattrset ( pad, color_scheme[RESUME] );
+}
+
+// percentage of packets dropped by kernel in last refresh and totals,
+// without ring (eBPF) nothing is dropped in the socket
+static void
+show_drops ( const struct config_op *co )
+{
+  wmove ( pad, 1, 25 );
+  wclrtoeol ( pad );
+
+  if ( co->ebpf )
+    {
+      show_overload ();
+      return;
+    }
+
+  const struct sock_stats *last = &co->stats_last;
+  double rate = last->packets ? last->drops * 100.0 / last->packets : 0.0;
+
+  wprintw ( pad, "drops: " );
+  wattrset ( pad, color_scheme[RESUME_VALUE] );
+  wprintw ( pad, "%.2f%%", rate );
+  wattrset ( pad, color_scheme[RESUME] );
+  wprintw ( pad, " total: " );
+  wattrset ( pad, color_scheme[RESUME_VALUE] );
+  wprintw ( pad, "%" PRIu64, co->stats_total.drops );
+  wattrset ( pad, color_scheme[RESUME] );
+  wprintw ( pad, " freeze: " );
+  wattrset ( pad, color_scheme[RESUME_VALUE] );
+  wprintw ( pad, "%" PRIu64, co->stats_total.freeze_q );
+  wattrset ( pad, color_scheme[RESUME] );
+
+  // values of sample mode are estimates
+  if ( co->sample > 1 )
+    {
+      wprintw ( pad, " sample: " );
+      wattrset ( pad, color_scheme[RESUME_VALUE] );
+      wprintw ( pad, "1/%u estimated", co->sample );
+      wattrset ( pad, color_scheme[RESUME] );
+    }
+
+  show_overload ();
+}
+
 static void
 show_resume ( const struct config_op *co )
 {
@@ -109,7 +255,10 @@ show_resume ( const struct config_op *co )
   human_readable ( rate_rx, LEN_STR_RATE, cur_rate_rx, RATE );
 
   wattrset ( pad, color_scheme[RESUME] );
-  mvwprintw ( pad, 0, 1, PROG_NAME " - " PROG_VERSION "\n" );
+  mvwprintw ( pad, 0, 1, PROG_NAME " - " PROG_VERSION );
+
+  show_capture ( co );
+  show_drops ( co );
 
   wmove ( pad, 2, 1 );
   wclrtoeol ( pad );  // erase the current line
@@ -126,6 +275,17 @@ show_resume ( const struct config_op *co )
   wattrset ( pad, color_scheme[RESUME_VALUE] );
   wprintw ( pad, "%s", rate_tx );
 
+  // only when there is more of a window to choose
+  unsigned int total_windows;
+  const unsigned int *windows = rate_windows ( &total_windows );
+  if ( total_windows > 1 )
+    {
+      wattrset ( pad, color_scheme[RESUME] );
+      mvwprintw ( pad, 2, 65, "window: " );
+      wattrset ( pad, color_scheme[RESUME_VALUE] );
+      wprintw ( pad, "%us", windows[rate_selected_window ()] );
+    }
+
   wattrset ( pad, color_scheme[RESUME] );
   wmove ( pad, 3, 1 );
   wprintw ( pad, "Processes: " );
@@ -142,6 +302,21 @@ show_resume ( const struct config_op *co )
   wattrset ( pad, color_scheme[RESUME_VALUE] );
   wprintw ( pad, "%s", rate_rx );
 
+  // read of blocks of ring behind of capture, in last refresh
+  if ( !co->ebpf )
+    {
+      const struct lag_stats *lag = lag_last ( LAG_CAPTURE );
+
+      wattrset ( pad, color_scheme[RESUME] );
+      mvwprintw ( pad, 3, 65, "lag p50/p99/max: " );
+      wattrset ( pad, color_scheme[RESUME_VALUE] );
+      wprintw ( pad,
+                "%.1f/%.1f/%.1f ms",
+                lag->p50_us / 1e3,
+                lag->p99_us / 1e3,
+                lag->max_us / 1e3 );
+    }
+
   wattrset ( pad, color_scheme[RESET] );
 
   // update all resume
@@ -158,7 +333,13 @@ show_header ( const struct config_op *co )
   wattrset ( pad,
              ( sort_by == S_PID ) ? color_scheme[SELECTED_H]
                                   : color_scheme[HEADER] );
-  wprintw ( pad, "%*s ", max_digits_pid, "PID" );
+  // rows aggregated show the total of processes, or of connections
+  wprintw ( pad,
+            "%*s ",
+            max_digits_pid,
+            ( aggregate == AGG_NONE )      ? "PID"
+            : ( aggregate == AGG_NETWORK ) ? "CONNS"
+                                           : "PROCS" );
 
   wattrset ( pad,
              ( sort_by == PPS_TX ) ? color_scheme[SELECTED_H]
@@ -246,25 +427,67 @@ resize_pad ( const int l, const int c )
   line_original = tmp;
 }
 
+/* only the rows in screen, and a screen before and after it to scroll
+   until the next refresh, are formatted */
+static inline bool
+row_visible ( int row )
+{
+  return row >= render_first && row <= render_last;
+}
+
+// rows in screen, below the header
+static inline bool
+row_in_screen ( int row )
+{
+  return row >= scroll_y && row < scroll_y + LINES - LINE_START - 1;
+}
+
+// clear rows formatted in last refresh that now are out of range
 static void
-show_connections ( const process_t *process, const struct config_op *co )
+render_range ( void )
 {
-  resize_pad ( process->total_conections + tot_rows, 0 );
+  int first = MAX ( LINE_START + 1, scroll_y - LINES );
+  int last = scroll_y + LINES * 2;
 
-  for ( size_t i = 0; i < process->total_conections; i++ )
+  for ( int row = render_first; row && row <= render_last; row++ )
     {
-      bool last_con = false;
-      tot_rows++;
+      if ( row < first || row > last )
+        {
+          wmove ( pad, row, 0 );
+          wclrtoeol ( pad );
+        }
+    }
+
+  render_first = first;
+  render_last = last;
+
+  resize_pad ( last + 1, 0 );
+}
+
+// the rows of connections start in 'row', only rows visibles are formatted
+static void
+show_connections ( const process_t *process,
+                   const struct config_op *co,
+                   int row,
+                   size_t rows )
+{
+  for ( size_t i = 0; i < rows; i++, row++ )
+    {
+      if ( !row_visible ( row ) )
+        continue;
 
-      // se a proxima conexão estiver com estatisticas zeradas, essa é a ultima
-      // conexão, as conexões são ordenadas de forma decrescente previamente
-      if ( ( i < process->total_conections - 1 &&
-             process->conections[i + 1]->net_stat.avg_Bps_rx == 0 &&
-             process->conections[i + 1]->net_stat.avg_Bps_tx == 0 ) ||
-           i == process->total_conections - 1 )
-        last_con = true;
+      // a conexão é a ultima quando a proxima está com estatisticas
+      // zeradas, as conexões são ordenadas de forma decrescente previamente
+      bool last_con = ( i == rows - 1 );
 
-      char *tuple = translate ( process->conections[i], co );
+      wmove ( pad, row, 0 );
+
+      // names of rows in screen are resolved first
+      const char *tuple =
+              translate ( process->conections[i],
+                          co,
+                          ( row_in_screen ( row ) ) ? DOMAIN_PRIO_VISIBLE
+                                                    : DOMAIN_PRIO_NEAR );
 
       char tx_rate[LEN_STR_RATE], rx_rate[LEN_STR_RATE];
 
@@ -292,12 +515,8 @@ show_connections ( const process_t *process, const struct config_op *co )
                 J_RATE,
                 rx_rate );
 
-      char iface_buff[IF_NAMESIZE];
-      char *iface;
-
-      if ( if_indextoname ( process->conections[i]->if_index, iface_buff ) )
-        iface = iface_buff;
-      else
+      const char *iface = iface_name ( process->conections[i]->if_index );
+      if ( !iface )
         iface = "";
 
       wprintw ( pad,
@@ -325,19 +544,328 @@ show_connections ( const process_t *process, const struct config_op *co )
         }
 
       wattrset ( pad, color_scheme[CONECTIONS] );
-      wprintw ( pad, " %s\n", tuple );
+      wprintw ( pad, " %s", tuple );
+
+      if ( process->conections[i]->tuple.l4.protocol == IPPROTO_TCP &&
+           row_in_screen ( row ) && total_tcp_rows < SOCK_DIAG_BATCH )
+        tcp_rows[total_tcp_rows++] =
+                ( struct tcp_row ){ .conn = process->conections[i],
+                                    .row = row,
+                                    .col = getcurx ( pad ) };
+
+      waddch ( pad, '\n' );
+    }
+
+  // blank line after connections
+  if ( row_visible ( row ) )
+    {
+      wmove ( pad, row, 0 );
+      wclrtoeol ( pad );
+    }
+
+  wattrset ( pad, color_scheme[RESET] );
+}
+
+// "  rtt 1000.00/1000.00 ms  retrans 4294967295  cwnd 4294967295"
+#define LEN_TCP_INFO 64
+
+/* RTT, retransmissions and congestion window of tcp connections in screen,
+   the cost is by rows in screen and not by connections of host */
+static void
+show_tcp_info ( void )
+{
+  const connection_t *conns[SOCK_DIAG_BATCH];
+  struct sock_diag_tcp_info info[SOCK_DIAG_BATCH];
+
+  for ( size_t i = 0; i < total_tcp_rows; i++ )
+    conns[i] = tcp_rows[i].conn;
+
+  if ( !connection_tcp_info ( conns, total_tcp_rows, info ) )
+    return;
+
+  wattrset ( pad, color_scheme[CONECTIONS] );
+
+  for ( size_t i = 0; i < total_tcp_rows; i++ )
+    {
+      // socket closed or of other network namespace
+      if ( !info[i].found )
+        continue;
+
+      // text beyond of pad would be wrapped to next row
+      tot_cols = MAX ( tot_cols, tcp_rows[i].col + LEN_TCP_INFO + 1 );
+      resize_pad ( 0, tot_cols );
+
+      mvwprintw ( pad,
+                  tcp_rows[i].row,
+                  tcp_rows[i].col,
+                  "  rtt %.2f/%.2f ms  retrans %u  cwnd %u",
+                  info[i].rtt_us / 1000.0,
+                  info[i].rttvar_us / 1000.0,
+                  info[i].retrans,
+                  info[i].snd_cwnd );
+    }
+
+  wattrset ( pad, color_scheme[RESET] );
+}
+
+/* the rows of remotes with most traffic (option --top-remotes) start in
+   'row', bytes are totals since start, estimated by sketch (see topk.h) */
+static void
+show_remotes ( const process_t *process, int row )
+{
+  const struct topk *tk = process->remotes;
+
+  for ( unsigned int i = 0; i < tk->total; i++, row++ )
+    {
+      if ( !row_visible ( row ) )
+        continue;
+
+      const struct topk_entry *e = &tk->entries[i];
+      char remote[TOPK_KEY_STRLEN];
+      char bytes[LEN_STR_TOTAL], error[LEN_STR_TOTAL];
+
+      topk_key_str ( &e->key, remote, sizeof remote );
+      human_readable ( bytes, sizeof bytes, e->bytes, TOTAL );
+
+      wmove ( pad, row, 0 );
+
+      // columns of rates and totals are empty, as of process are by pid
+      wprintw ( pad,
+                "%*s",
+                max_digits_pid + PPS * 2 + J_RATE * 4 + 7,
+                "" );
+
+      wattrset ( pad, color_scheme[TREE] );
+      waddch ( pad, ( i < tk->total - 1 ) ? ACS_LTEE : ACS_LLCORNER );
+      waddch ( pad, ACS_HLINE );
+
+      wattrset ( pad, color_scheme[CONECTIONS] );
+      wprintw ( pad, " %-*s %s", TOPK_KEY_STRLEN / 2, remote, bytes );
 
-      if ( last_con )
+      // key replaced other, its traffic is known only until 'error'
+      if ( e->error )
         {
-          tot_rows++;
-          waddch ( pad, '\n' );
-          break;
+          human_readable ( error, sizeof error, e->error, TOTAL );
+          wprintw ( pad, " (error %s)", error );
         }
+
+      waddch ( pad, '\n' );
+    }
+
+  // blank line after remotes
+  if ( row_visible ( row ) )
+    {
+      wmove ( pad, row, 0 );
+      wclrtoeol ( pad );
     }
 
   wattrset ( pad, color_scheme[RESET] );
 }
 
+// last line of screen with costs of netproc (option --self-stats)
+static void
+show_self_stats ( void )
+{
+  werase ( stats_win );
+  wattrset ( stats_win, color_scheme[HEADER] );
+  wprintw ( stats_win,
+            "self-stats: %" PRIu64 " %s/pkt",
+            profile_cycles_packet ( false ),
+            profile_cycles_unit () );
+
+  for ( int i = 0; i < TOTAL_PHASES; i++ )
+    wprintw ( stats_win,
+              "  %s %.2f ms",
+              profile_phase_name ( i ),
+              profile_phase ( i )->last_ns / 1e6 );
+
+  wprintw ( stats_win, "  first frame %.0f ms", profile_first_frame_ms () );
+
+  wprintw ( stats_win, "  pools %.1f KiB", pool_memory_total () / 1024.0 );
+
+  struct memory_usage mu;
+  memory_usage ( &mu );
+
+  wprintw ( stats_win, "  memory %.1f MiB", mu.total / 1048576.0 );
+  for ( int i = 0; i < TOTAL_MEMORY_TABLES; i++ )
+    wprintw ( stats_win,
+              " %s %.1f",
+              memory_table_name ( i ),
+              mu.bytes[i] / 1048576.0 );
+
+  wattrset ( stats_win, color_scheme[RESET] );
+
+  // pad can have painted over this line
+  touchwin ( stats_win );
+  wnoutrefresh ( stats_win );
+}
+
+// lines of pane of sizes, title, lower bounds of buckets, tx and rx
+#define SIZES_LINES 4
+
+// width of column of bucket
+#define SIZES_COL 5
+
+static void
+show_sizes_row ( const struct pktsize *ps, enum pktsize_dir dir )
+{
+  uint64_t total = pktsize_total ( ps, dir );
+
+  wprintw ( sizes_win, "\n%-3s", ( dir == PKTSIZE_TX ) ? "tx" : "rx" );
+
+  for ( unsigned int i = 0; i < PKTSIZE_BUCKETS; i++ )
+    {
+      if ( !ps->packets[dir][i] )
+        wprintw ( sizes_win, "%*s", SIZES_COL, "." );
+      else
+        wprintw ( sizes_win,
+                  "%*.0f%%",
+                  SIZES_COL - 1,
+                  ps->packets[dir][i] * 100.0 / total );
+    }
+}
+
+/* pane in bottom of screen with histogram of sizes of packets of process
+   selected, in percent of packets of each direction (see pktsize.h) */
+static void
+show_sizes_pane ( void )
+{
+  const process_t *proc = selected_proc;
+
+  werase ( sizes_win );
+  wattrset ( sizes_win, color_scheme[HEADER] );
+
+  if ( !proc || !proc->sizes )
+    {
+      wprintw ( sizes_win, "packet sizes: no packets of process selected" );
+      wattrset ( sizes_win, color_scheme[RESET] );
+      touchwin ( sizes_win );
+      wnoutrefresh ( sizes_win );
+      return;
+    }
+
+  // "program-name"
+  size_t start_name = intern_base ( proc->name );
+  int len_name = intern_prog_len ( proc->name ) - start_name;
+
+  wprintw ( sizes_win,
+            "packet sizes of %d %.*s, %% of packets by size in bytes\n",
+            proc->pid,
+            len_name,
+            proc->name + start_name );
+
+  wprintw ( sizes_win, "%3s", "" );
+  for ( unsigned int i = 0; i < PKTSIZE_BUCKETS; i++ )
+    {
+      char label[PKTSIZE_LABEL_STRLEN];
+
+      pktsize_label ( i, label, sizeof label );
+      wprintw ( sizes_win, "%*s", SIZES_COL, label );
+    }
+
+  wattrset ( sizes_win, color_scheme[RESET] );
+
+  show_sizes_row ( proc->sizes, PKTSIZE_TX );
+  show_sizes_row ( proc->sizes, PKTSIZE_RX );
+
+  // pad can have painted over this lines
+  touchwin ( sizes_win );
+  wnoutrefresh ( sizes_win );
+}
+
+// pane is created in first use, without space it is not showed
+static void
+toggle_sizes ( void )
+{
+  int line = LINES - SIZES_LINES - ( ( stats_win ) ? 1 : 0 );
+
+  if ( !sizes_win && line > LINE_START + 1 )
+    sizes_win = newwin ( SIZES_LINES, COLS, line, 0 );
+
+  if ( !sizes_win )
+    {
+      beep ();
+      return;
+    }
+
+  show_sizes = !show_sizes;
+
+  // lines of pad below of pane hidden are painted again in next refresh
+  if ( !show_sizes )
+    touchwin ( pad );
+}
+
+// format the row of process in 'row' of pad
+static void
+show_process ( const process_t *process, int row )
+{
+  wmove ( pad, row, 0 );
+
+  // "/usr/bin/program-name --any_parameters"
+  size_t len_full_name = intern_len ( process->name );
+
+  // +1 because'\n'
+  tot_cols = MAX ( ( size_t ) tot_cols,
+                   len_full_name + PROGRAM + max_digits_pid + 1 );
+
+  resize_pad ( 0, tot_cols );
+
+  char tx_rate[LEN_STR_RATE], rx_rate[LEN_STR_RATE];
+  char tx_tot[LEN_STR_TOTAL], rx_tot[LEN_STR_TOTAL];
+  human_readable ( tx_rate,
+                   sizeof tx_rate,
+                   process->net_stat.avg_Bps_tx,
+                   RATE );
+
+  human_readable ( rx_rate,
+                   sizeof rx_rate,
+                   process->net_stat.avg_Bps_rx,
+                   RATE );
+
+  human_readable ( tx_tot, sizeof tx_tot, process->net_stat.tot_Bps_tx, TOTAL );
+
+  human_readable ( rx_tot, sizeof rx_tot, process->net_stat.tot_Bps_rx, TOTAL );
+
+  wprintw ( pad,
+            "%*d %*ld %*ld %*s %*s %*s %*s ",
+            max_digits_pid,
+            process->pid,
+            PPS,
+            process->net_stat.avg_pps_tx,
+            PPS,
+            process->net_stat.avg_pps_rx,
+            J_RATE,
+            tx_rate,
+            J_RATE,
+            rx_rate,
+            J_RATE,
+            tx_tot,
+            J_RATE,
+            rx_tot );
+
+  // "/usr/bin/program-name", lengths are precomputed in name interned
+  size_t len_path_name = intern_prog_len ( process->name );
+
+  // "program-name"
+  size_t start_name = intern_base ( process->name );
+
+  for ( size_t j = 0; j < len_full_name; j++ )
+    {
+      chtype ch = process->name[j];
+
+      if ( j < start_name )
+        ch |= color_scheme[PATH_PROG];
+      else if ( j < len_path_name )
+        ch |= color_scheme[NAME_PROG];
+      else
+        ch |= color_scheme[PARAM_PROG];
+
+      waddch ( pad, ch );
+    }
+
+  waddch ( pad, '\n' );
+}
+
 static void
 set_lines_cols ( void )
 {
@@ -365,6 +893,9 @@ tui_init ( const struct config_op *co )
   color_scheme = get_color_scheme ( co->color_scheme );
   max_digits_pid = get_max_digits_pid ();
 
+  if ( profile_enabled () && !( stats_win = newwin ( 1, COLS, LINES - 1, 0 ) ) )
+    return 0;
+
   show_header ( co );
   doupdate ();
 
@@ -378,24 +909,30 @@ tui_show ( const struct processes *processes, const struct config_op *co )
   tot_proc_act = 0;
   cur_rate_tx = cur_rate_rx = cur_pps_tx = cur_pps_rx = 0;
 
-  static int tot_cols = 0;
+  render_range ();
 
-  sort ( processes->proc, processes->total, sort_by, co );
+  selected_proc = NULL;
+  total_tcp_rows = 0;
 
-  wmove ( pad, LINE_START + 1, 0 );  // move second line after header
+  // each process showed has at least one row, so the processes of rows
+  // until last formatted are in first ones
+  uint64_t start = profile_start ();
+  size_t total = sort ( processes->proc,
+                        processes->total,
+                        sort_by,
+                        render_last - LINE_START,
+                        co );
+  profile_end ( PHASE_SORT, start );
 
-  for ( size_t i = 0; i < processes->total; i++ )
+  for ( size_t i = 0; i < total; i++ )
     {
-      // process_t *process = *proc;
       process_t *process = processes->proc[i];
-      //
-      if ( !( process->net_stat.tot_Bps_rx || process->net_stat.tot_Bps_tx ) &&
-           !co->verbose )
-        continue;
 
       tot_rows++;
       tot_proc_act++;
 
+      int first_row = tot_rows;
+
       // update total show in resume
       cur_rate_tx += process->net_stat.avg_Bps_tx;
       cur_rate_rx += process->net_stat.avg_Bps_rx;
@@ -403,99 +940,58 @@ tui_show ( const struct processes *processes, const struct config_op *co )
       cur_pps_tx += process->net_stat.avg_pps_tx;
       cur_pps_rx += process->net_stat.avg_pps_rx;
 
-      // "/usr/bin/program-name --any_parameters"
-      size_t len_full_name = strlen ( process->name );
-
-      // +1 because'\n'
-      tot_cols = MAX ( ( size_t ) tot_cols,
-                       len_full_name + PROGRAM + max_digits_pid + 1 );
-
-      resize_pad ( 0, tot_cols );
-
-      char tx_rate[LEN_STR_RATE], rx_rate[LEN_STR_RATE];
-      char tx_tot[LEN_STR_TOTAL], rx_tot[LEN_STR_TOTAL];
-      human_readable ( tx_rate,
-                       sizeof tx_rate,
-                       process->net_stat.avg_Bps_tx,
-                       RATE );
-
-      human_readable ( rx_rate,
-                       sizeof rx_rate,
-                       process->net_stat.avg_Bps_rx,
-                       RATE );
-
-      human_readable ( tx_tot,
-                       sizeof tx_tot,
-                       process->net_stat.tot_Bps_tx,
-                       TOTAL );
-
-      human_readable ( rx_tot,
-                       sizeof rx_tot,
-                       process->net_stat.tot_Bps_rx,
-                       TOTAL );
+      if ( row_visible ( tot_rows ) )
+        show_process ( process, tot_rows );
 
-      wprintw ( pad,
-                "%*d %*ld %*ld %*s %*s %*s %*s ",
-                max_digits_pid,
-                process->pid,
-                PPS,
-                process->net_stat.avg_pps_tx,
-                PPS,
-                process->net_stat.avg_pps_rx,
-                J_RATE,
-                tx_rate,
-                J_RATE,
-                rx_rate,
-                J_RATE,
-                tx_tot,
-                J_RATE,
-                rx_tot );
-
-      // "/usr/bin/program-name"
-      size_t len_path_name = strlen_space ( process->name );
-
-      // simulate end of string to index_last_char
-      char tmp = process->name[len_path_name];
-      process->name[len_path_name] = '\0';
-
-      // "program-name"
-      ssize_t start_name = index_last_char ( process->name, '/' );
-
-      process->name[len_path_name] = tmp;
+      // option -c and process with traffic at the moment
+      if ( co->view_conections && process->total_conections &&
+           ( process->net_stat.avg_Bps_rx || process->net_stat.avg_Bps_tx ) )
+        {
+          size_t rows = sort_connections_active ( process );
+          int row = tot_rows + 1;
 
-      // if start_name == -1, name program starting in 0 position, else skip '/'
-      start_name++;
+          // connections sorted only if formatted
+          if ( row <= render_last && row + ( int ) rows > render_first )
+            sort_connections ( process, rows, sort_by, render_last - row + 1 );
 
-      for ( size_t j = 0; j < len_full_name; j++ )
+          show_connections ( process, co, row, rows );
+          tot_rows += rows + 1;
+        }
+      else if ( co->top_remotes && process->remotes &&
+                ( process->net_stat.avg_Bps_rx ||
+                  process->net_stat.avg_Bps_tx ) )
         {
-          chtype ch = process->name[j];
+          topk_sort ( process->remotes );
+          show_remotes ( process, tot_rows + 1 );
+          tot_rows += process->remotes->total + 1;
+        }
 
-          if ( j < ( size_t ) start_name )
-            ch |= color_scheme[PATH_PROG];
-          else if ( j < len_path_name )
-            ch |= color_scheme[NAME_PROG];
-          else
-            ch |= color_scheme[PARAM_PROG];
+      if ( selected >= first_row && selected <= tot_rows )
+        selected_proc = process;
+    }
 
-          waddch ( pad, ch );
-        }
+  if ( total_tcp_rows )
+    show_tcp_info ();
 
-      waddch ( pad, '\n' );
+  // pad can be scrolled until last row
+  resize_pad ( tot_rows + 1, 0 );
 
-      // option -c and process with traffic at the moment
-      if ( co->view_conections &&
-           ( process->net_stat.avg_Bps_rx || process->net_stat.avg_Bps_tx ) )
-        show_connections ( process, co );
+  // clear lines after last row, "replace" wclear()
+  int row_clear = MAX ( tot_rows + 1, render_first );
+  if ( row_visible ( row_clear ) )
+    {
+      wmove ( pad, row_clear, 0 );
+      wclrtobot ( pad );
     }
 
-  // clear lines begin cursor end screen, "replace" wclear()
-  wclrtobot ( pad );
-
   // paint item selected
   if ( tot_rows > LINE_START + 1 )
     {
       if ( selected > tot_rows )
-        selected = tot_rows;
+        {
+          selected = tot_rows;
+          selected_proc = processes->proc[total - 1];
+        }
 
       paint_selected ();
     }
@@ -510,6 +1006,12 @@ tui_show ( const struct processes *processes, const struct config_op *co )
                  LINES - 1,
                  COLS - 1 );
 
+  if ( stats_win )
+    show_self_stats ();
+
+  if ( show_sizes )
+    show_sizes_pane ();
+
   // full refresh
   doupdate ();
 }
@@ -651,12 +1153,34 @@ tui_handle_input ( const struct config_op *co )
               }
 
             break;
+          case 'a':
+          case 'A':
+            aggregate = ( aggregate + 1 ) % AGG_MODES;
+
+            // view by network only with prefixes of '--networks'
+            if ( aggregate == AGG_NETWORK && !co->networks )
+              aggregate = AGG_NONE;
+            break;
+          case 'w':
+          case 'W':
+            {
+              unsigned int total;
+              rate_windows ( &total );
+              rate_select_window ( ( rate_selected_window () + 1 ) % total );
+              show_header ( co );
+              doupdate ();
+            }
+            break;
           case 's':
           case 'S':
             sort_by = ( sort_by + 1 ) % COLS_TO_SORT;
             show_header ( co );
             doupdate ();
             break;
+          case 'z':
+          case 'Z':
+            toggle_sizes ();
+            break;
           case 'q':
           case 'Q':
             return P_EXIT;
@@ -666,12 +1190,24 @@ tui_handle_input ( const struct config_op *co )
   return P_CONTINE;
 }
 
+int
+tui_aggregate ( void )
+{
+  return aggregate;
+}
+
 void
 tui_free ( void )
 {
   if ( pad )
     delwin ( pad );
 
+  if ( stats_win )
+    delwin ( stats_win );
+
+  if ( sizes_win )
+    delwin ( sizes_win );
+
   curs_set ( 1 );  // restore cursor
   endwin ();
   free ( line_original );
@@ -38,6 +38,10 @@ tui_show ( const struct processes *processes, const struct config_op *co );
 int
 tui_handle_input ( const struct config_op *co );
 
+// view of rows chosen by user (see aggregate.h)
+int
+tui_aggregate ( void );
+
 void
 tui_free ( void );
 
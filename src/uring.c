@@ -0,0 +1,297 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>        // AT_FDCWD, O_*
+#include <stdint.h>       // uintptr_t
+#include <string.h>       // memset
+#include <sys/mman.h>     // mmap
+#include <sys/syscall.h>  // __NR_io_uring_*
+#include <unistd.h>       // syscall
+
+#include "uring.h"
+#include "macro_util.h"
+#include "m_error.h"
+
+static int
+sys_setup ( unsigned int entries, struct io_uring_params *p )
+{
+  return syscall ( __NR_io_uring_setup, entries, p );
+}
+
+static int
+sys_enter ( int fd, unsigned int submit, unsigned int wait )
+{
+  return syscall ( __NR_io_uring_enter,
+                   fd,
+                   submit,
+                   wait,
+                   ( wait ) ? IORING_ENTER_GETEVENTS : 0,
+                   NULL,
+                   0 );
+}
+
+static void *
+map_ring ( int fd, size_t size, off_t offset )
+{
+  void *p = mmap ( NULL,
+                   size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE,
+                   fd,
+                   offset );
+
+  return ( p == MAP_FAILED ) ? NULL : p;
+}
+
+bool
+uring_init ( struct uring *ring, unsigned int entries )
+{
+  struct io_uring_params p;
+
+  memset ( ring, 0, sizeof ( *ring ) );
+  memset ( &p, 0, sizeof ( p ) );
+
+  ring->fd = sys_setup ( entries, &p );
+  if ( ring->fd == -1 )
+    {
+      ERROR_DEBUG ( "io_uring_setup: \"%s\"", strerror ( errno ) );
+      return false;
+    }
+
+  ring->entries = p.sq_entries;
+  ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof ( unsigned int );
+  ring->cq_ring_size =
+          p.cq_off.cqes + p.cq_entries * sizeof ( struct io_uring_cqe );
+  ring->sqes_size = p.sq_entries * sizeof ( struct io_uring_sqe );
+
+  // kernels since 5.4 map both queues at once
+  if ( p.features & IORING_FEAT_SINGLE_MMAP )
+    ring->sq_ring_size = ring->cq_ring_size =
+            MAX ( ring->sq_ring_size, ring->cq_ring_size );
+
+  ring->sq_ring = map_ring ( ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING );
+  if ( !ring->sq_ring )
+    goto ERROR_EXIT;
+
+  if ( p.features & IORING_FEAT_SINGLE_MMAP )
+    ring->cq_ring = ring->sq_ring;
+  else if ( !( ring->cq_ring = map_ring (
+                       ring->fd, ring->cq_ring_size, IORING_OFF_CQ_RING ) ) )
+    goto ERROR_EXIT;
+
+  ring->sqes = map_ring ( ring->fd, ring->sqes_size, IORING_OFF_SQES );
+  if ( !ring->sqes )
+    goto ERROR_EXIT;
+
+  char *sq = ring->sq_ring;
+  ring->sq_head = ( unsigned int * ) ( sq + p.sq_off.head );
+  ring->sq_tail = ( unsigned int * ) ( sq + p.sq_off.tail );
+  ring->sq_mask = ( unsigned int * ) ( sq + p.sq_off.ring_mask );
+  ring->sq_array = ( unsigned int * ) ( sq + p.sq_off.array );
+
+  char *cq = ring->cq_ring;
+  ring->cq_head = ( unsigned int * ) ( cq + p.cq_off.head );
+  ring->cq_tail = ( unsigned int * ) ( cq + p.cq_off.tail );
+  ring->cq_mask = ( unsigned int * ) ( cq + p.cq_off.ring_mask );
+  ring->cqes = ( struct io_uring_cqe * ) ( cq + p.cq_off.cqes );
+
+  return true;
+
+ERROR_EXIT:
+  ERROR_DEBUG ( "mmap of io_uring: \"%s\"", strerror ( errno ) );
+  uring_free ( ring );
+  return false;
+}
+
+// entry of submission queue, zeroed, the queue is empty between stages
+static struct io_uring_sqe *
+get_sqe ( struct uring *ring, unsigned int *tail )
+{
+  unsigned int idx = *tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+  memset ( sqe, 0, sizeof ( *sqe ) );
+  ring->sq_array[idx] = idx;
+  ( *tail )++;
+
+  return sqe;
+}
+
+/* submit 'count' entries and wait all completions, res of each one is
+   stored in results[user_data] as are reaped */
+static bool
+submit_wait ( struct uring *ring,
+              unsigned int tail,
+              unsigned int count,
+              ssize_t *results )
+{
+  __atomic_store_n ( ring->sq_tail, tail, __ATOMIC_RELEASE );
+
+  unsigned int done = 0;
+  unsigned int submit = count;
+
+  while ( done < count )
+    {
+      int ret = sys_enter ( ring->fd, submit, 1 );
+      if ( ret == -1 )
+        {
+          if ( errno == EINTR )
+            continue;
+
+          ERROR_DEBUG ( "io_uring_enter: \"%s\"", strerror ( errno ) );
+          return false;
+        }
+
+      submit -= MIN ( ( unsigned int ) ret, submit );
+
+      unsigned int head = *ring->cq_head;
+      unsigned int cq_tail =
+              __atomic_load_n ( ring->cq_tail, __ATOMIC_ACQUIRE );
+
+      for ( ; head != cq_tail; head++, done++ )
+        {
+          struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+
+          if ( results )
+            results[cqe->user_data] = cqe->res;
+        }
+
+      __atomic_store_n ( ring->cq_head, head, __ATOMIC_RELEASE );
+    }
+
+  return true;
+}
+
+// files 'first' to 'last' of uring_read_files, 'last' - 'first' <= entries
+static bool
+read_batch ( struct uring *ring,
+             const char *const *paths,
+             char *const *bufs,
+             size_t size,
+             ssize_t *lens,
+             unsigned int first,
+             unsigned int last )
+{
+  unsigned int tail = *ring->sq_tail;
+  unsigned int count = 0;
+
+  for ( unsigned int i = first; i < last; i++, count++ )
+    {
+      struct io_uring_sqe *sqe = get_sqe ( ring, &tail );
+
+      sqe->opcode = IORING_OP_OPENAT;
+      sqe->fd = AT_FDCWD;
+      sqe->addr = ( uintptr_t ) paths[i];
+      sqe->open_flags = O_RDONLY | O_CLOEXEC;
+      sqe->user_data = i;
+    }
+
+  // fds of files are in lens until read
+  if ( !submit_wait ( ring, tail, count, lens ) )
+    return false;
+
+  count = 0;
+  for ( unsigned int i = first; i < last; i++ )
+    {
+      if ( lens[i] < 0 )
+        continue;
+
+      struct io_uring_sqe *sqe = get_sqe ( ring, &tail );
+
+      sqe->opcode = IORING_OP_READ;
+      sqe->fd = lens[i];
+      sqe->addr = ( uintptr_t ) bufs[i];
+      sqe->len = size;
+      sqe->user_data = i;
+      count++;
+    }
+
+  // results of reads take the place of fds, kept to be closed
+  int fds[last - first];
+  for ( unsigned int i = first; i < last; i++ )
+    fds[i - first] = lens[i];
+
+  if ( !submit_wait ( ring, tail, count, lens ) )
+    {
+      for ( unsigned int i = 0; i < last - first; i++ )
+        if ( fds[i] >= 0 )
+          close ( fds[i] );
+
+      return false;
+    }
+
+  count = 0;
+  for ( unsigned int i = 0; i < last - first; i++ )
+    {
+      if ( fds[i] < 0 )
+        continue;
+
+      struct io_uring_sqe *sqe = get_sqe ( ring, &tail );
+
+      sqe->opcode = IORING_OP_CLOSE;
+      sqe->fd = fds[i];
+      count++;
+    }
+
+  return submit_wait ( ring, tail, count, NULL );
+}
+
+bool
+uring_read_files ( struct uring *ring,
+                   const char *const *paths,
+                   char *const *bufs,
+                   size_t size,
+                   ssize_t *lens,
+                   unsigned int total )
+{
+  for ( unsigned int i = 0; i < total; i += ring->entries )
+    {
+      if ( !read_batch ( ring,
+                         paths,
+                         bufs,
+                         size,
+                         lens,
+                         i,
+                         MIN ( i + ring->entries, total ) ) )
+        return false;
+    }
+
+  return true;
+}
+
+void
+uring_free ( struct uring *ring )
+{
+  if ( ring->sqes )
+    munmap ( ring->sqes, ring->sqes_size );
+
+  if ( ring->cq_ring && ring->cq_ring != ring->sq_ring )
+    munmap ( ring->cq_ring, ring->cq_ring_size );
+
+  if ( ring->sq_ring )
+    munmap ( ring->sq_ring, ring->sq_ring_size );
+
+  if ( ring->fd != -1 )
+    close ( ring->fd );
+
+  memset ( ring, 0, sizeof ( *ring ) );
+  ring->fd = -1;
+}
@@ -0,0 +1,76 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <stdbool.h>
+#include <sys/types.h>  // ssize_t
+#include <linux/io_uring.h>
+
+/* io_uring by syscalls, without liburing, only what the reads of /proc in
+   batch need. a ring is used only by one thread */
+struct uring
+{
+  int fd;
+  unsigned int entries;
+
+  // submission queue, shared with kernel
+  unsigned int *sq_head;
+  unsigned int *sq_tail;
+  unsigned int *sq_mask;
+  unsigned int *sq_array;
+  struct io_uring_sqe *sqes;
+
+  // completion queue, shared with kernel
+  unsigned int *cq_head;
+  unsigned int *cq_tail;
+  unsigned int *cq_mask;
+  struct io_uring_cqe *cqes;
+
+  void *sq_ring;
+  void *cq_ring;  // same of sq_ring with IORING_FEAT_SINGLE_MMAP
+  size_t sq_ring_size;
+  size_t cq_ring_size;
+  size_t sqes_size;
+};
+
+#define URING_INITIALIZER { .fd = -1 }
+
+/* ring with at least 'entries' submissions by batch, false if the kernel
+   not support io_uring (or it is disabled) */
+bool
+uring_init ( struct uring *ring, unsigned int entries );
+
+/* read of 'total' small files in batch, each file is opened, read until
+   'size' bytes in bufs[i] and closed, each stage with a syscall by batch
+   of ring. lens[i] are bytes read or -errno. false if the ring failed */
+bool
+uring_read_files ( struct uring *ring,
+                   const char *const *paths,
+                   char *const *bufs,
+                   size_t size,
+                   ssize_t *lens,
+                   unsigned int total );
+
+void
+uring_free ( struct uring *ring );
+
+#endif  // URING_H
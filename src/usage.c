@@ -35,25 +35,131 @@ usage ( void )
   fputs ( "Usage: " PROG_NAME " [options]\n"
          "\n"
          "Options:\n"
+         " --agent host:port       send traffic of processes of each refresh to a\n"
+         "                         collector of '--collector', as deltas compact\n"
          " -B, --bytes             view in bytes, default in bits\n"
+         " --busy-poll us          busy poll of device queue for up to 'us'\n"
+         "                         microseconds before sleep, less latency\n"
          " -c                      visualization each active connection of the process\n"
+         "                         tcp in screen with rtt, retransmissions and cwnd\n"
          " --color 1|2|3           color scheme, 1 is default\n"
+         " --capture-cpus list     pin threads of capture to CPUs, as '0-3,8', or 'auto'\n"
+         "                         to CPUs of NUMA node of interface, threads of\n"
+         "                         resolver run in the other CPUs\n"
+         " --capture-threads N     read packets with N threads (0 to 64), default is 1,\n"
+         "                         with 0 packets are read in main thread, between refreshes\n"
+         " --collector [addr:]port receive traffic of agents of '--agent' in 'port' of\n"
+         "                         'addr', default is 127.0.0.1, view of processes of\n"
+         "                         all hosts, as 'host name'. agents are not\n"
+         "                         authenticated, other address only in trusted network\n"
+         " --control path          unix socket of commands applied in next refresh,\n"
+         "                         as 'protocol tcp', 'connections on', 'resolve off',\n"
+         "                         'refresh 500', 'sample 4' or 'snapshot'\n"
+         " --dns-cache KiB         memory of cache of names of hosts (64 to 1048576),\n"
+         "                         default is 2048, names expire by TTL of DNS\n"
+         " --dns-cache-file file   save names of cache in file on exit and read them\n"
+         "                         on start, not resolved again until expire\n"
+         " --ebpf                  count traffic in kernel with eBPF, less CPU usage,\n"
+         "                         if not supported by kernel use ring buffer\n"
+         " --ebpf-files            find sockets of all processes with eBPF, avoid\n"
+         "                         read /proc/<pid>/fd/ in update of processes\n"
+         " --ebpf-sockets          find owner of new sockets with eBPF, avoid scan\n"
+         "                         of all processes in each new connection\n"
+         " --exclude-file file     exclusions of file, one by line as 'net 10.0.0.0/8',\n"
+         "                         'port 873' or 'iface eth1', file is re-read on SIGHUP\n"
+         " --exclude-iface iface   drop still in kernel the traffic of interface\n"
+         " --exclude-net net       drop still in kernel the traffic of network ipv4 or\n"
+         "                         ipv6, as 10.0.0.0/8 or fd00::/8\n"
+         " --exclude-port port     drop still in kernel the traffic of tcp/udp port\n"
          " -f, --file \"filename\"   save statistics in file, filename is optional,\n"
          "                         default is '" PROG_NAME_LOG "'\n"
+         " --flow-export host:port send record of each connection closed, with pid and\n"
+         "                         name of process, by UDP, format in src/flow_export.h\n"
+         " --flow-file file        write records of '--flow-export' in file, with or\n"
+         "                         without '--flow-export', messages one after other\n"
          " -h, --help              show this message\n"
-         " -i, --interface iface   specifies an interface, default is all\n"
-         "                         (except interface with network 127.0.0.0/8)\n"
+         " --header-only           copy only headers of packets from kernel, less CPU\n"
+         "                         usage in hosts with high traffic\n"
+         " --headless              without terminal user interface, to run as service,\n"
+         "                         statistics are saved only in file of '-f'\n"
+         " --hugepages             tables of flows and pools in huge pages of 2 MiB,\n"
+         "                         reserved or transparent, less misses of TLB\n"
+         , stderr);
+  // string split, C99 limit of length is 4095
+  fputs ( " -i, --interface iface   specifies an interface, default is all\n"
+         "                         (except interface with network 127.0.0.0/8),\n"
+         "                         or up to 16 as 'bond0,eth1:64', each one with\n"
+         "                         ring of its own, ':N' are blocks of ring\n"
+         " --log-summary s         seconds between summaries of totals in file of '-f',\n"
+         "                         default is 60, with 0 only on exit\n"
+         " --loopback              count traffic of loopback, each packet once, credited\n"
+         "                         to process that send and to process that receive\n"
+         " --max-fragments N       max of IP packets fragmented simultaneously\n"
+         "                         (1 to 65536), default is 256\n"
+         " --max-memory MiB        budget of memory of tables (1 to 1048576), caches are\n"
+         "                         trimmed above of it, the ring is out of budget\n"
+         " --max-subflows N        max of sub-flows of '-c' (1024 to 16777216), peers\n"
+         "                         of sockets udp, idle are evicted above it\n"
+         " --metrics-port port     serve metrics of processes to Prometheus in HTTP\n"
+         "                         'port', as 'curl localhost:port/metrics'\n"
+         " --networks file         rows by network of remotes, of prefixes of file,\n"
+         "                         one by line as '10.0.0.0/8 internal', key 'a'\n"
          " -n                      numeric host and service, implicit '-c', try '-nh' to no\n"
          "                         translate only host or '-np' to not translate only service\n"
+         " --overload-auto         shed work by load (drops or refresh late) in stages:\n"
+         "                         traffic of connections, redraws, names and sample\n"
          " -p, --protocol tcp|udp  specifies a protocol, the default is tcp and udp\n"
+         " --rate-windows s,...    seconds of windows of rates, up to 4 (1 to 3600),\n"
+         "                         as '1,10,60', default is 5, the first is shown\n"
+         " --read file             read packets of file pcap or pcapng in place of\n"
+         "                         capture, at speed of capture, root is not needed\n"
+         " --read-fast             read all packets of '--read' at once, to benchmark\n"
+         " --record file           record traffic of processes in file, in binary\n"
+         "                         compact format, to see later with '--replay'\n"
+         " --refresh ms            interval of refresh in milliseconds (50 to 10000),\n"
+         "                         default is 1000, rates are always by second\n"
+         " --replay file           show traffic of record of '--record' in place of\n"
+         "                         capture, connections are not recorded\n"
+         " --replay-speed N        ticks of record by interval of refresh (1 to 1000),\n"
+         "                         default is 1\n"
+         , stderr);
+  fputs ( " --ring-auto             size ring buffer based on link speed\n"
+         " --ring-blocks N         number of blocks of ring buffer (2 to 4096)\n"
+         " --ring-block-size N     size in KiB of each block of ring buffer (4 to 65536)\n"
+         " --ring-lock             pre-fault and lock ring buffer in memory, needs\n"
+         "                         CAP_IPC_LOCK or RLIMIT_MEMLOCK of size of ring\n"
+         " --ring-timeout ms       timeout of block of ring buffer (0 to 10000),\n"
+         "                         default 0, calculated by kernel\n"
+         " --sample N              capture 1 in N packets (1 to 65536), filtered in\n"
+         "                         kernel, traffic is scaled by N and is estimated\n"
+         " --sample-auto           double N of '--sample' when ring drops packets and\n"
+         "                         halve it after 10 refreshes without drops\n"
+         " --self-stats            show cost of netproc, cycles per packet and time\n"
+         "                         of each phase, memory of pools, summary on exit\n"
+         " --shm /name             publish snapshot of each refresh in POSIX shared\n"
+         "                         memory, layout of records in src/snapshot.h\n"
          " --si                    show SI format, with powers of 10, default is IEC,\n"
          "                         with powers of 2\n"
+         " --stream ndjson|csv     records of processes with traffic (and connections\n"
+         "                         with '-c') in each refresh, to stdout, implicit\n"
+         "                         '--headless'\n"
+         " --stream-socket path    write records of '--stream' in unix socket 'path'\n"
+         "                         in place of stdout, with terminal user interface\n"
+         " --top-remotes host|port remotes with most bytes of each process, by host or\n"
+         "                         by host and port, in rows below of process and in\n"
+         "                         metrics, up to 8 by process, without '-c'\n"
          " -v, --verbose           verbose mode, also show process without traffic\n"
          " -V, --version           show version\n"
+         " --xdp                   read ingress of interfaces of '-i' with XDP,\n"
+         "                         only headers to user, egress by ring, kernel 5.9+\n"
          "\n"
          "when running press:\n"
          " arrow keys    scroll\n"
          " s             change column-based sort\n"
+         " w             change window of rates, of '--rate-windows'\n"
+         " a             change rows, by process, program, user, cgroup or\n"
+         "               network of '--networks'\n"
+         " z             show sizes of packets of process selected, in percent\n"
          " q             exit\n"
          , stderr);
   // clang-format on
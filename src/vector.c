@@ -21,11 +21,14 @@
 #include <stdlib.h>  // realloc, free
 #include <string.h>  // memcpy
 
+#include "vector.h"
+
 struct vector
 {
   size_t elements_allocated;
   size_t elements_used;
   size_t element_size;
+  struct arena *arena;  // memory of arena, NULL is of malloc
 };
 
 /* CHUNK is header, MEM is user memory */
@@ -34,32 +37,56 @@ struct vector
 #define MEM_TO_CHUNK( pos ) \
   ( ( struct vector * ) ( ( char * ) ( pos ) - sizeof ( struct vector ) ) )
 
-static void *
-vector_alloc ( struct vector *v, size_t size )
+#define LEN_INIT_VECTOR 16
+
+// bytes of all vectors not of arena, to vector_memory
+static size_t vectors_memory = 0;
+
+static inline void
+account ( const struct vector *vt, size_t add, size_t sub )
 {
-  return realloc ( v, size + sizeof ( struct vector ) );
+  if ( !vt->arena )
+    __atomic_add_fetch ( &vectors_memory, add - sub, __ATOMIC_RELAXED );
 }
 
-static void
-vector_copy ( struct vector *restrict v, void *restrict data )
+// change space of vector to 'elements', update pointer of user
+static int
+vector_resize ( void **mem, size_t elements )
 {
-  char *ptr = CHUNCK_TO_MEM ( v ) + ( v->elements_used * v->element_size );
+  struct vector *vt = MEM_TO_CHUNK ( *mem );
+  size_t old_size =
+          sizeof ( struct vector ) + vt->elements_allocated * vt->element_size;
+  size_t new_size = sizeof ( struct vector ) + elements * vt->element_size;
 
-  memcpy ( ptr, data, v->element_size );
-}
+  struct vector *temp;
+  if ( vt->arena )
+    temp = arena_realloc ( vt->arena, vt, old_size, new_size );
+  else
+    temp = realloc ( vt, new_size );
 
-#define LEN_INIT_VECTOR 16
+  if ( !temp )
+    return 0;
 
-void *
-vector_new ( size_t size_member )
+  temp->elements_allocated = elements;
+  *mem = CHUNCK_TO_MEM ( temp );
+  account ( temp, new_size, old_size );
+
+  return 1;
+}
+
+static void *
+vector_create ( size_t size_member, struct arena *arena )
 {
-  struct vector *vt = vector_alloc ( NULL, LEN_INIT_VECTOR * size_member );
+  size_t size = sizeof ( struct vector ) + LEN_INIT_VECTOR * size_member;
+  struct vector *vt = ( arena ) ? arena_alloc ( arena, size ) : malloc ( size );
 
   if ( vt )
     {
       vt->elements_allocated = LEN_INIT_VECTOR;
       vt->elements_used = 0;
       vt->element_size = size_member;
+      vt->arena = arena;
+      account ( vt, size, 0 );
 
       return CHUNCK_TO_MEM ( vt );
     }
@@ -67,6 +94,18 @@ vector_new ( size_t size_member )
   return vt;
 }
 
+void *
+vector_new ( size_t size_member )
+{
+  return vector_create ( size_member, NULL );
+}
+
+void *
+vector_new_arena ( size_t size_member, struct arena *arena )
+{
+  return vector_create ( size_member, arena );
+}
+
 int
 vector_push_ ( void **restrict mem, void *restrict data )
 {
@@ -74,30 +113,78 @@ vector_push_ ( void **restrict mem, void *restrict data )
 
   if ( vt->elements_used == vt->elements_allocated )
     {
-      vt->elements_allocated <<= 1;
-      size_t new_size = vt->elements_allocated * vt->element_size;
-      void *temp = vector_alloc ( vt, new_size );
-
-      if ( !temp )
-        {
-          vt->elements_allocated >>= 1;
-          return 0;
-        }
-
-      if ( vt != temp )
-        {
-          vt = temp;
-          *mem = CHUNCK_TO_MEM ( vt );
-        }
+      if ( !vector_resize ( mem, vt->elements_allocated << 1 ) )
+        return 0;
+
+      vt = MEM_TO_CHUNK ( *mem );
     }
 
-  vector_copy ( vt, data );
+  char *ptr = ( char * ) *mem + ( vt->elements_used * vt->element_size );
+
+  // most of vectors are of pointers, copy without call to memcpy
+  if ( vt->element_size == sizeof ( void * ) )
+    memcpy ( ptr, data, sizeof ( void * ) );
+  else
+    memcpy ( ptr, data, vt->element_size );
 
   vt->elements_used++;
 
   return 1;
 }
 
+int
+vector_reserve_ ( void **mem, size_t total )
+{
+  struct vector *vt = MEM_TO_CHUNK ( *mem );
+
+  if ( total <= vt->elements_allocated )
+    return 1;
+
+  // keep growth geometric, reserves in sequence not realloc each one
+  size_t elements = vt->elements_allocated;
+  while ( elements < total )
+    elements <<= 1;
+
+  return vector_resize ( mem, elements );
+}
+
+int
+vector_push_n_ ( void **restrict mem,
+                 const void *restrict data,
+                 size_t total )
+{
+  struct vector *vt = MEM_TO_CHUNK ( *mem );
+
+  if ( !vector_reserve_ ( mem, vt->elements_used + total ) )
+    return 0;
+
+  vt = MEM_TO_CHUNK ( *mem );
+  memcpy ( ( char * ) *mem + ( vt->elements_used * vt->element_size ),
+           data,
+           total * vt->element_size );
+
+  vt->elements_used += total;
+
+  return 1;
+}
+
+void
+vector_shrink_ ( void **mem )
+{
+  struct vector *vt = MEM_TO_CHUNK ( *mem );
+
+  size_t elements = vt->elements_used;
+  if ( elements < LEN_INIT_VECTOR )
+    elements = LEN_INIT_VECTOR;
+
+  // memory of arena is released only by reset
+  if ( vt->arena || elements >= vt->elements_allocated )
+    return;
+
+  // on failure the vector keep the space
+  vector_resize ( mem, elements );
+}
+
 void *
 vector_pop ( void *mem )
 {
@@ -124,8 +211,30 @@ vector_size ( void *mem )
   return vt->elements_used;
 }
 
+size_t
+vector_capacity ( void *mem )
+{
+  struct vector *vt = MEM_TO_CHUNK ( mem );
+
+  return vt->elements_allocated;
+}
+
 void
 vector_free ( void *mem )
 {
-  free ( MEM_TO_CHUNK ( mem ) );
+  struct vector *vt = MEM_TO_CHUNK ( mem );
+
+  account ( vt,
+            0,
+            sizeof ( struct vector ) +
+                    vt->elements_allocated * vt->element_size );
+
+  if ( !vt->arena )
+    free ( vt );
+}
+
+size_t
+vector_memory ( void )
+{
+  return __atomic_load_n ( &vectors_memory, __ATOMIC_RELAXED );
 }
@@ -23,6 +23,8 @@
 
 #include <stddef.h>
 
+#include "arena.h"
+
 /*
  create new vector
  @param nmeb, number of member initial in vector, if 0 default is 16
@@ -33,6 +35,17 @@
 void *
 vector_new ( size_t size_member );
 
+/*
+ create new vector with memory of arena, the memory is released with
+ arena_reset, vector_free is not necessary
+ @param size, size of one member in array
+ @param arena, arena of memory
+
+ @return memory to user or null on error
+*/
+void *
+vector_new_arena ( size_t size_member, struct arena *arena );
+
 /*
  copy user data into vector
  @oaram mem, pointer returned from vector_new
@@ -45,6 +58,41 @@ vector_push_ ( void **mem, void *data );
 
 #define vector_push( mem, data ) vector_push_ ( ( void ** ) ( &mem ), ( data ) )
 
+/*
+ copy 'total' elements of user data into vector, with one memcpy
+ @oaram mem, pointer returned from vector_new
+ @param data, pointer to array of user data
+
+ @return 1 if success or 0 on error
+*/
+int
+vector_push_n_ ( void **mem, const void *data, size_t total );
+
+#define vector_push_n( mem, data, total ) \
+  vector_push_n_ ( ( void ** ) ( &mem ), ( data ), ( total ) )
+
+/*
+ alloc space to at least 'total' elements, so next pushes until 'total'
+ not realloc
+ @oaram mem, pointer returned from vector_new
+
+ @return 1 if success or 0 on error
+*/
+int
+vector_reserve_ ( void **mem, size_t total );
+
+#define vector_reserve( mem, total ) \
+  vector_reserve_ ( ( void ** ) ( &mem ), ( total ) )
+
+/*
+ release the space not used, keep space to default of vector_new
+ @oaram mem, pointer returned from vector_new
+*/
+void
+vector_shrink_ ( void **mem );
+
+#define vector_shrink( mem ) vector_shrink_ ( ( void ** ) ( &mem ) )
+
 /*
   remove last element from vector
   @oaram mem, pointer returned from vector_new
@@ -68,6 +116,13 @@ vector_clear ( void *mem );
 size_t
 vector_size ( void *mem );
 
+/*
+  return number of elements allocated in vector
+  @oaram mem, pointer returned from vector_new
+*/
+size_t
+vector_capacity ( void *mem );
+
 /*
   free vector
   @oaram mem, pointer returned from vector_new
@@ -75,4 +130,10 @@ vector_size ( void *mem );
 void
 vector_free ( void *mem );
 
+/*
+  bytes allocated by all vectors, vectors of arena are not included
+*/
+size_t
+vector_memory ( void );
+
 #endif  // VECTOR_H
@@ -0,0 +1,1074 @@
+// microbenchmarks of hot paths, built and run by 'make bench' in root dir
+//
+// usage: netproc-bench [--json] [--max N] [--procs N] [--fds N] [name]
+//   --json     one object JSON by line, to compare runs with scripts
+//   --max N    max of entries of tables (connections, flows...), default 1M
+//   --procs N  processes of tree of /proc of benchmarks scan_*, default 1000
+//   --fds N    fds of each process of tree, default 16
+//   name       run only benchmarks with name started by 'name'
+//
+// benchmarks scan_* read a synthetic /proc (in TMPDIR) with net/tcp of 10k
+// to 2M lines, and report also allocations of netproc and peak of RSS
+
+#define _GNU_SOURCE  // nftw
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/udp.h>
+#include <net/ethernet.h>
+
+// to create connections without /proc/net/
+#include "../src/connection.c"
+
+#include "../src/packet.h"
+#include "../src/statistics.h"
+#include "../src/rate.h"
+#include "../src/sort.h"
+#include "../src/processes.h"
+#include "../src/translate.h"
+#include "../src/hashtable.h"
+#include "../src/resolver/service.h"
+
+#include "cycle_counting.h"
+
+// in arm are ticks of virtual counter, not cycles of CPU
+#if defined( __x86_64__ )
+#define TSC_END( cnt ) ( cnt ) = END_TSC ( ( cnt ) )
+#else
+#define TSC_END( cnt ) END_TSC ( &( cnt ) )
+#endif
+
+// operations of benchmarks of constant cost
+#define OPS 2000000
+
+// frames with distinct tuples used by benchmarks of parse_packet
+#define FRAMES 256
+#define FRAME_SIZE 256
+
+// rows visible in a terminal, the 'k' of sort
+#define SORT_TOP 50
+
+static const size_t sizes[] = { 1000, 100000, 1000000 };
+
+static bool json;
+static size_t max_entries = 1000000;
+static const char *only;
+
+// results are written in it, so the compiler not remove the loops
+static volatile uint64_t sink;
+
+static struct config_op co = { .refresh = REFRESH_DEFAULT,
+                               .rate_windows = { RATE_WINDOW_DEFAULT },
+                               .total_rate_windows = 1 };
+
+struct timing
+{
+  struct timespec ts;
+  counter_T cycles;
+};
+
+static void
+timing_start ( struct timing *t )
+{
+  clock_gettime ( CLOCK_MONOTONIC, &t->ts );
+  t->cycles = BEGIN_TSC ();
+}
+
+// accumulate in 'cycles' and 'ns' the time since timing_start
+static void
+timing_stop ( struct timing *t, uint64_t *cycles, uint64_t *ns )
+{
+  struct timespec end;
+
+  TSC_END ( t->cycles );
+  clock_gettime ( CLOCK_MONOTONIC, &end );
+
+  *cycles += t->cycles;
+  *ns += ( end.tv_sec - t->ts.tv_sec ) * 1000000000ULL + end.tv_nsec -
+         t->ts.tv_nsec;
+}
+
+static bool
+selected ( const char *name )
+{
+  return !only || !strncmp ( name, only, strlen ( only ) );
+}
+
+static void
+report ( const char *name, size_t ops, uint64_t cycles, uint64_t ns )
+{
+  double cpo = ( double ) cycles / ops;
+  double npo = ( double ) ns / ops;
+
+  if ( json )
+    printf ( "{\"name\":\"%s\",\"ops\":%zu,\"cycles_per_op\":%.2f,"
+             "\"ns_per_op\":%.2f}\n",
+             name,
+             ops,
+             cpo,
+             npo );
+  else
+    printf ( "%-32s %10zu %12.2f %12.2f\n", name, ops, cpo, npo );
+
+  fflush ( stdout );
+}
+
+/* parse_packet */
+
+enum frame_type
+{
+  FRAME_ETH,  // ethernet header before of ip
+  FRAME_TUN,  // ip in start of frame, as in tun devices
+  FRAME_IPV6,
+  FRAME_FRAG  // pairs of first and last fragment of same packet
+};
+
+static uint8_t frames[FRAMES][FRAME_SIZE] __attribute__ ( ( aligned ( 64 ) ) );
+
+// data of link layer starts aligned, as in ring buffer
+#define FRAME_MAC TPACKET_ALIGN ( TPACKET3_HDRLEN )
+
+static void
+frame_init ( uint8_t *frame, enum frame_type type, unsigned int i )
+{
+  struct tpacket3_hdr *ppd = ( struct tpacket3_hdr * ) frame;
+  struct sockaddr_ll *ll;
+  void *l3;
+
+  memset ( frame, 0, FRAME_SIZE );
+
+  ll = ( struct sockaddr_ll * ) ( frame + TPACKET3_HDRLEN -
+                                  sizeof ( struct sockaddr_ll ) );
+  ll->sll_pkttype = ( i & 1 ) ? PACKET_OUTGOING : PACKET_HOST;
+  ll->sll_ifindex = 2;
+
+  ppd->tp_sec = 1000;
+  ppd->tp_mac = FRAME_MAC;
+  ppd->tp_net = FRAME_MAC;
+  if ( type != FRAME_TUN )
+    {
+      struct ether_header *eth = ( void * ) ( frame + FRAME_MAC );
+      eth->ether_type = htons ( ( type == FRAME_IPV6 ) ? ETHERTYPE_IPV6
+                                                       : ETHERTYPE_IP );
+      ppd->tp_net += sizeof ( *eth );
+    }
+
+  l3 = frame + ppd->tp_net;
+  ppd->tp_len = ppd->tp_snaplen = 1500;
+
+  struct udphdr *udp;
+  if ( type == FRAME_IPV6 )
+    {
+      struct ip6_hdr *ip6 = l3;
+      ip6->ip6_vfc = 6 << 4;
+      ip6->ip6_nxt = IPPROTO_UDP;
+      ip6->ip6_src.s6_addr[0] = 0xfd;
+      ip6->ip6_src.s6_addr[15] = i & 0xff;
+      ip6->ip6_dst.s6_addr[0] = 0xfd;
+      ip6->ip6_dst.s6_addr[15] = 1;
+      udp = ( struct udphdr * ) ( ip6 + 1 );
+    }
+  else
+    {
+      struct iphdr *ip = l3;
+      ip->version = 4;
+      ip->ihl = 5;
+      ip->protocol = IPPROTO_UDP;
+      ip->saddr = htonl ( 0x0a000000 | i );
+      ip->daddr = htonl ( 0x0a000001 );
+      ip->frag_off = htons ( IP_DF );
+
+      if ( type == FRAME_FRAG )
+        {
+          // the two fragments of a packet are in sequence
+          ip->saddr = htonl ( 0x0a000000 | ( i / 2 ) );
+          ip->id = htons ( i / 2 );
+          ip->frag_off = htons ( ( i & 1 ) ? 185 : IP_MF );
+          ll->sll_pkttype = PACKET_HOST;
+        }
+
+      udp = ( struct udphdr * ) ( ip + 1 );
+    }
+
+  udp->source = htons ( 1024 + i );
+  udp->dest = htons ( 53 );
+}
+
+static void
+bench_parse ( const char *name, enum frame_type type )
+{
+  if ( !selected ( name ) )
+    return;
+
+  for ( unsigned int i = 0; i < FRAMES; i++ )
+    frame_init ( frames[i], type, i );
+
+  uint64_t cycles = 0, ns = 0, ok = 0;
+  struct timing t;
+
+  timing_start ( &t );
+  for ( size_t i = 0; i < OPS; i++ )
+    {
+      struct packet pkt;
+      ok += parse_packet (
+              &pkt, ( struct tpacket3_hdr * ) frames[i % FRAMES] );
+    }
+  timing_stop ( &t, &cycles, &ns );
+
+  sink += ok;
+  report ( name, OPS, cycles, ns );
+}
+
+/* connections */
+
+static process_t fake_proc;
+static connection_t **conns;
+static struct tuple *tuples;
+
+static void
+shuffle ( struct tuple *array, size_t total )
+{
+  for ( size_t i = total - 1; i > 0; i-- )
+    {
+      size_t j = ( ( size_t ) rand () << 16 ^ rand () ) % ( i + 1 );
+      struct tuple tmp = array[i];
+      array[i] = array[j];
+      array[j] = tmp;
+    }
+}
+
+// 'total' connections of fake_proc in indexes, tuples in random order
+static bool
+conns_fill ( size_t total )
+{
+  conns = calloc ( total, sizeof ( *conns ) );
+  tuples = malloc ( total * sizeof ( *tuples ) );
+  if ( !conns || !tuples || !connection_init () )
+    return false;
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      struct tuple tuple = { 0 };
+
+      tuple.family = AF_INET;
+      tuple.l4.protocol = IPPROTO_TCP;
+      tuple.l3.local.ip = htonl ( 0x0a000001 );
+      tuple.l3.remote.ip = htonl ( 0x0b000000 + ( i >> 8 ) );
+      tuple.l4.local_port = 1024 + ( i & 0xff );
+      tuple.l4.remote_port = 443;
+
+      conns[i] = create_new_conn ( i + 1, 0, &tuple, 1 );
+      if ( !conns[i] || !connection_insert ( conns[i] ) )
+        return false;
+
+      conns[i]->proc = &fake_proc;
+      tuples[i] = conns[i]->tuple;
+    }
+
+  shuffle ( tuples, total );
+
+  return true;
+}
+
+static void
+conns_clear ( size_t total )
+{
+  if ( conns )
+    {
+      for ( size_t i = 0; i < total && conns[i]; i++ )
+        rate_net_stat_free ( &conns[i]->net_stat );
+    }
+
+  rate_net_stat_free ( &fake_proc.net_stat );
+  fake_proc = ( process_t ){ 0 };
+
+  connection_free ();
+  free ( conns );
+  free ( tuples );
+  conns = NULL;
+  tuples = NULL;
+}
+
+static void
+bench_lookup ( const char *name, size_t total )
+{
+  uint64_t cycles = 0, ns = 0, found = 0;
+  size_t ops = MAX ( total, OPS );
+  struct timing t;
+
+  timing_start ( &t );
+  for ( size_t i = 0; i < ops; i++ )
+    found += !!connection_get_by_tuple ( &tuples[i % total] );
+  timing_stop ( &t, &cycles, &ns );
+
+  sink += found;
+  report ( name, ops, cycles, ns );
+}
+
+static void
+bench_statistics ( const char *name, size_t total, bool view_conections )
+{
+  uint64_t cycles = 0, ns = 0, attributed = 0;
+  size_t ops = MAX ( total, OPS );
+  struct timing t;
+
+  struct packet pkt = {
+          .lenght = 1500, .tstamp = 1000, .if_index = 2, .segments = 1 };
+
+  timing_start ( &t );
+  for ( size_t i = 0; i < ops; i++ )
+    {
+      pkt.tuple = tuples[i % total];
+      pkt.direction = ( i & 1 ) ? PKT_UPL : PKT_DOWN;
+      attributed += statistics_add ( &pkt, view_conections );
+    }
+  timing_stop ( &t, &cycles, &ns );
+
+  sink += attributed;
+  report ( name, ops, cycles, ns );
+}
+
+static void
+bench_connections ( size_t total )
+{
+  char lookup[64], stats[64], stats_conn[64];
+
+  snprintf ( lookup, sizeof lookup, "conn_get_by_tuple/%zu", total );
+  snprintf ( stats, sizeof stats, "statistics_add/%zu", total );
+  snprintf ( stats_conn, sizeof stats_conn, "statistics_add_conn/%zu", total );
+
+  if ( !selected ( lookup ) && !selected ( stats ) && !selected ( stats_conn ) )
+    return;
+
+  if ( !conns_fill ( total ) )
+    {
+      fprintf ( stderr, "error on create %zu connections\n", total );
+      conns_clear ( total );
+      return;
+    }
+
+  if ( selected ( lookup ) )
+    bench_lookup ( lookup, total );
+
+  if ( selected ( stats ) )
+    bench_statistics ( stats, total, false );
+
+  if ( selected ( stats_conn ) )
+    bench_statistics ( stats_conn, total, true );
+
+  conns_clear ( total );
+}
+
+/* rates */
+
+// ticks with traffic before of measure, all flows with history
+#define RATE_WARMUP SAMPLE_SLOTS
+#define RATE_ROUNDS 8
+
+static void
+bench_rate ( size_t total )
+{
+  char calc[64], update[64];
+
+  snprintf ( calc, sizeof calc, "rate_calc/%zu", total );
+  snprintf ( update, sizeof update, "rate_update/%zu", total );
+
+  if ( !selected ( calc ) && !selected ( update ) )
+    return;
+
+  struct net_stat *ns = aligned_alloc ( alignof ( struct net_stat ),
+                                        total * sizeof ( *ns ) );
+  if ( !ns )
+    {
+      fprintf ( stderr, "error on alloc %zu flows\n", total );
+      return;
+    }
+
+  memset ( ns, 0, total * sizeof ( *ns ) );
+
+  // flows enter in actives in order of traffic, not of memory
+  size_t *order = malloc ( total * sizeof ( *order ) );
+  if ( !order )
+    {
+      fprintf ( stderr, "error on alloc %zu flows\n", total );
+      free ( ns );
+      return;
+    }
+
+  for ( size_t i = 0; i < total; i++ )
+    {
+      size_t j = ( ( size_t ) rand () << 16 ^ rand () ) % ( i + 1 );
+
+      order[i] = order[j];
+      order[j] = i;
+    }
+
+  uint64_t calc_cycles = 0, calc_ns = 0;
+  uint64_t update_cycles = 0, update_ns = 0;
+  struct timing t;
+
+  for ( uint32_t tick = 1; tick <= RATE_WARMUP + RATE_ROUNDS; tick++ )
+    {
+      for ( size_t i = 0; i < total; i++ )
+        rate_add_rx ( &ns[order[i]], 1500, tick );
+
+      if ( tick <= RATE_WARMUP )
+        {
+          rate_calc ( &co, tick + 1 );
+          rate_update ();
+          continue;
+        }
+
+      timing_start ( &t );
+      rate_calc ( &co, tick + 1 );
+      timing_stop ( &t, &calc_cycles, &calc_ns );
+
+      timing_start ( &t );
+      rate_update ();
+      timing_stop ( &t, &update_cycles, &update_ns );
+    }
+
+  if ( selected ( calc ) )
+    report ( calc, total * RATE_ROUNDS, calc_cycles, calc_ns );
+
+  if ( selected ( update ) )
+    report ( update, total * RATE_ROUNDS, update_cycles, update_ns );
+
+  for ( size_t i = 0; i < total; i++ )
+    rate_net_stat_free ( &ns[i] );
+
+  free ( ns );
+  free ( order );
+}
+
+/* hashtable */
+
+static bool
+key_compare ( const void *key1, const void *key2 )
+{
+  return key1 == key2;
+}
+
+static hash_t
+key_hash ( const void *key )
+{
+  return hash_u64 ( ( uintptr_t ) key );
+}
+
+// inserts in a table of minimal size, so the cost of rehash is included
+static void
+bench_hashtable ( size_t total )
+{
+  char set[64], get[64];
+
+  snprintf ( set, sizeof set, "hashtable_set/%zu", total );
+  snprintf ( get, sizeof get, "hashtable_get/%zu", total );
+
+  if ( !selected ( set ) && !selected ( get ) )
+    return;
+
+  hashtable_t *ht = hashtable_new ( key_hash, key_compare, NULL );
+  if ( !ht )
+    return;
+
+  uint64_t cycles = 0, ns = 0, found = 0;
+  struct timing t;
+
+  timing_start ( &t );
+  for ( uintptr_t key = 1; key <= total; key++ )
+    hashtable_set ( ht, ( void * ) key, ( void * ) key );
+  timing_stop ( &t, &cycles, &ns );
+
+  if ( selected ( set ) )
+    report ( set, total, cycles, ns );
+
+  size_t ops = MAX ( total, OPS );
+
+  cycles = ns = 0;
+  timing_start ( &t );
+  for ( size_t i = 0; i < ops; i++ )
+    found += !!hashtable_get ( ht, ( void * ) ( i % total + 1 ) );
+  timing_stop ( &t, &cycles, &ns );
+
+  sink += found;
+  if ( selected ( get ) )
+    report ( get, ops, cycles, ns );
+
+  hashtable_destroy ( ht );
+}
+
+/* sort */
+
+#define SORT_ROUNDS 16
+
+static void
+bench_sort ( size_t total )
+{
+  char name[64];
+
+  snprintf ( name, sizeof name, "sort/%zu", total );
+  if ( !selected ( name ) )
+    return;
+
+  process_t *procs = calloc ( total, sizeof ( *procs ) );
+  process_t **proc = malloc ( total * sizeof ( *proc ) );
+  if ( !procs || !proc )
+    goto END;
+
+  uint64_t cycles = 0, ns = 0, showed = 0;
+  struct timing t;
+
+  for ( int round = 0; round < SORT_ROUNDS; round++ )
+    {
+      // new rates in each refresh, a process of each four without traffic
+      for ( size_t i = 0; i < total; i++ )
+        {
+          procs[i].pid = i + 1;
+          procs[i].net_stat.avg_Bps_rx = ( i % 4 ) ? rand () : 0;
+          procs[i].net_stat.tot_Bps_rx = procs[i].net_stat.avg_Bps_rx;
+          proc[i] = &procs[i];
+        }
+
+      timing_start ( &t );
+      showed += sort ( proc, total, RATE_RX, SORT_TOP, &co );
+      timing_stop ( &t, &cycles, &ns );
+    }
+
+  sink += showed;
+  report ( name, SORT_ROUNDS, cycles, ns );
+
+END:
+  free ( procs );
+  free ( proc );
+}
+
+/* scans of /proc, in a synthetic tree of processes and sockets */
+
+#define SCAN_ROUNDS 4
+
+// lines of /proc/net/tcp, up to --max
+static const size_t scan_sizes[] = { 10000, 100000, 1000000, 2000000 };
+
+static unsigned int scan_procs = 1000;
+static unsigned int scan_fds = 16;
+
+static char scan_root[PROC_ROOT_MAX + 1];
+
+/* allocations of netproc, counted by -Wl,--wrap of Makefile. memory
+   allocated inside of libc (as by opendir) not is counted */
+static uint64_t allocs;
+
+void *
+__real_malloc ( size_t size );
+void *
+__real_calloc ( size_t nmemb, size_t size );
+void *
+__real_realloc ( void *ptr, size_t size );
+void *
+__real_aligned_alloc ( size_t alignment, size_t size );
+
+void *
+__wrap_malloc ( size_t size )
+{
+  __atomic_add_fetch ( &allocs, 1, __ATOMIC_RELAXED );
+  return __real_malloc ( size );
+}
+
+void *
+__wrap_calloc ( size_t nmemb, size_t size )
+{
+  __atomic_add_fetch ( &allocs, 1, __ATOMIC_RELAXED );
+  return __real_calloc ( nmemb, size );
+}
+
+void *
+__wrap_realloc ( void *ptr, size_t size )
+{
+  __atomic_add_fetch ( &allocs, 1, __ATOMIC_RELAXED );
+  return __real_realloc ( ptr, size );
+}
+
+void *
+__wrap_aligned_alloc ( size_t alignment, size_t size )
+{
+  __atomic_add_fetch ( &allocs, 1, __ATOMIC_RELAXED );
+  return __real_aligned_alloc ( alignment, size );
+}
+
+// field in KiB of /proc/self/status (of real procfs), -1 on error
+static long
+status_kb ( const char *field )
+{
+  FILE *file = fopen ( "/proc/self/status", "r" );
+  if ( !file )
+    return -1;
+
+  char line[128];
+  long kb = -1;
+  size_t len = strlen ( field );
+
+  while ( fgets ( line, sizeof line, file ) )
+    {
+      if ( !strncmp ( line, field, len ) && line[len] == ':' )
+        {
+          kb = strtol ( line + len + 1, NULL, 10 );
+          break;
+        }
+    }
+
+  fclose ( file );
+
+  return kb;
+}
+
+// VmHWM is the current RSS, so the peak of a scan can be measured
+static bool
+peak_reset ( void )
+{
+  FILE *file = fopen ( "/proc/self/clear_refs", "w" );
+  if ( !file )
+    return false;
+
+  bool ok = fputs ( "5", file ) >= 0;
+
+  return !fclose ( file ) && ok;
+}
+
+struct scan_stats
+{
+  uint64_t cycles;
+  uint64_t ns;
+  uint64_t allocs;
+  long peak_kb;  // max of growth of RSS in a scan, 0 if unknown
+  size_t rounds;
+};
+
+static void
+scan_start ( struct scan_stats *st, struct timing *t, long *rss )
+{
+  *rss = ( peak_reset () ) ? status_kb ( "VmRSS" ) : -1;
+  st->allocs -= __atomic_load_n ( &allocs, __ATOMIC_RELAXED );
+  timing_start ( t );
+}
+
+static void
+scan_stop ( struct scan_stats *st, struct timing *t, long rss )
+{
+  timing_stop ( t, &st->cycles, &st->ns );
+  st->allocs += __atomic_load_n ( &allocs, __ATOMIC_RELAXED );
+  st->rounds++;
+
+  long hwm = ( rss != -1 ) ? status_kb ( "VmHWM" ) : -1;
+  if ( hwm != -1 && hwm - rss > st->peak_kb )
+    st->peak_kb = hwm - rss;
+}
+
+static void
+report_scan ( const char *name, const struct scan_stats *st )
+{
+  double apo = ( double ) st->allocs / st->rounds;
+
+  if ( json )
+    {
+      printf ( "{\"name\":\"%s\",\"ops\":%zu,\"cycles_per_op\":%.2f,"
+               "\"ns_per_op\":%.2f,\"allocs_per_op\":%.1f,\"peak_kb\":%ld}\n",
+               name,
+               st->rounds,
+               ( double ) st->cycles / st->rounds,
+               ( double ) st->ns / st->rounds,
+               apo,
+               st->peak_kb );
+      fflush ( stdout );
+      return;
+    }
+
+  report ( name, st->rounds, st->cycles, st->ns );
+  printf ( "%-32s %10s %12.1f allocs/op %8ld KiB peak\n",
+           "",
+           "",
+           apo,
+           st->peak_kb );
+  fflush ( stdout );
+}
+
+static int
+remove_entry ( const char *path,
+               UNUSED const struct stat *st,
+               UNUSED int flag,
+               UNUSED struct FTW *ftw )
+{
+  return remove ( path );
+}
+
+static void
+tree_remove ( void )
+{
+  if ( *scan_root )
+    nftw ( scan_root, remove_entry, 16, FTW_DEPTH | FTW_PHYS );
+
+  *scan_root = '\0';
+  proc_root_set ( "/proc" );
+}
+
+static bool
+write_file ( const char *path, const char *data, size_t len )
+{
+  int fd = open ( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+  if ( fd == -1 )
+    return false;
+
+  bool ok = write ( fd, data, len ) == ( ssize_t ) len;
+
+  return !close ( fd ) && ok;
+}
+
+#define HEADER_TCP                                                        \
+  "  sl  local_address rem_address   st tx_queue rx_queue tr tm->when " \
+  "retrnsmt   uid  timeout inode\n"
+
+#define HEADER_TCP6                                                         \
+  "  sl  local_address                         remote_address"            \
+  "                        st tx_queue rx_queue tr tm->when retrnsmt   uid" \
+  "  timeout inode\n"
+
+/* <root>/<pid>/cmdline and <root>/<pid>/fd/ of 'scan_procs' processes,
+   with 'scan_fds' fds, 0 to 2 are not sockets. the sockets are of lines
+   of net/tcp, in turns, so with lines more than sockets some connections
+   are without process */
+static bool
+tree_create ( void )
+{
+  const char *tmp = getenv ( "TMPDIR" );
+  char path[PROC_ROOT_MAX + 64];
+
+  snprintf ( scan_root,
+             sizeof scan_root,
+             "%s/netproc-bench-XXXXXX",
+             ( tmp ) ? tmp : "/tmp" );
+  if ( !mkdtemp ( scan_root ) )
+    {
+      *scan_root = '\0';
+      return false;
+    }
+
+  snprintf ( path, sizeof path, "%s/net", scan_root );
+  if ( mkdir ( path, 0755 ) )
+    return false;
+
+  static const char *const files[] = { "tcp6", "udp6" };
+  static const char *const files4[] = { "tcp", "udp" };
+  for ( size_t i = 0; i < ARRAY_SIZE ( files ); i++ )
+    {
+      snprintf ( path, sizeof path, "%s/net/%s", scan_root, files[i] );
+      if ( !write_file ( path, HEADER_TCP6, sizeof ( HEADER_TCP6 ) - 1 ) )
+        return false;
+
+      snprintf ( path, sizeof path, "%s/net/%s", scan_root, files4[i] );
+      if ( !write_file ( path, HEADER_TCP, sizeof ( HEADER_TCP ) - 1 ) )
+        return false;
+    }
+
+  for ( unsigned int p = 0; p < scan_procs; p++ )
+    {
+      pid_t pid = 100 + p;
+      char cmdline[64], target[32];
+
+      snprintf ( path, sizeof path, "%s/%d", scan_root, pid );
+      if ( mkdir ( path, 0755 ) )
+        return false;
+
+      int len = snprintf ( cmdline, sizeof cmdline, "bench-%u", p % 64 );
+      snprintf ( path, sizeof path, "%s/%d/cmdline", scan_root, pid );
+      if ( !write_file ( path, cmdline, len + 1 ) )
+        return false;
+
+      snprintf ( path, sizeof path, "%s/%d/fd", scan_root, pid );
+      if ( mkdir ( path, 0755 ) )
+        return false;
+
+      for ( unsigned int fd = 0; fd < scan_fds; fd++ )
+        {
+          if ( fd < 3 )
+            snprintf ( target, sizeof target, "/dev/null" );
+          else
+            snprintf ( target,
+                       sizeof target,
+                       "socket:[%u]",
+                       p * scan_fds + fd + 1 );
+
+          snprintf ( path, sizeof path, "%s/%d/fd/%u", scan_root, pid, fd );
+          if ( symlink ( target, path ) )
+            return false;
+        }
+    }
+
+  return proc_root_set ( scan_root );
+}
+
+// 'total' connections established in net/tcp, inodes from 1
+static bool
+tree_connections ( size_t total )
+{
+  char path[PROC_ROOT_MAX + 16];
+
+  snprintf ( path, sizeof path, "%s/net/tcp", scan_root );
+  FILE *file = fopen ( path, "w" );
+  if ( !file )
+    return false;
+
+  fputs ( HEADER_TCP, file );
+
+  for ( size_t i = 0; i < total; i++ )
+    fprintf ( file,
+              "%4zu: %08X:%04zX %08X:01BB 01 00000000:00000000 "
+              "00:00000000 00000000  1000        0 %zu 1 "
+              "0000000000000000 20 4 30 10 -1\n",
+              i,
+              htonl ( 0x0a000001 ),
+              1024 + ( i & 0xff ),
+              htonl ( 0x0b000000 + ( i >> 8 ) ),
+              i + 1 );
+
+  return !fclose ( file );
+}
+
+static void
+bench_scan_connections ( const char *name, const char *cold )
+{
+  struct scan_stats st = { 0 }, st_cold = { 0 };
+  struct timing t;
+  long rss;
+
+  if ( !connection_init () )
+    goto END;
+
+  // the tree is read by fallback of /proc/net/, not by sock_diag
+  diag_unsupported = ~0U;
+
+  for ( int round = 0; round <= SCAN_ROUNDS; round++ )
+    {
+      struct scan_stats *s = ( round ) ? &st : &st_cold;
+
+      scan_start ( s, &t, &rss );
+      bool ok = connection_update ( TCP );
+      scan_stop ( s, &t, rss );
+
+      if ( !ok )
+        {
+          fprintf ( stderr, "error on scan of connections\n" );
+          goto END;
+        }
+    }
+
+  if ( selected ( cold ) )
+    report_scan ( cold, &st_cold );
+
+  if ( selected ( name ) )
+    report_scan ( name, &st );
+
+END:
+  connection_free ();
+}
+
+static void
+bench_scan_processes ( const char *name, const char *cold )
+{
+  struct config_op scan_co = co;
+  struct scan_stats st = { 0 }, st_cold = { 0 };
+  struct processes *procs = NULL;
+  struct timing t;
+  long rss;
+
+  scan_co.proto = TCP;
+
+  if ( !connection_init () || !( procs = processes_init () ) )
+    goto END;
+
+  diag_unsupported = ~0U;
+
+  for ( int round = 0; round <= SCAN_ROUNDS; round++ )
+    {
+      struct scan_stats *s = ( round ) ? &st : &st_cold;
+
+      scan_start ( s, &t, &rss );
+      int ok = processes_update ( procs, &scan_co );
+      scan_stop ( s, &t, rss );
+
+      if ( !ok )
+        {
+          fprintf ( stderr, "error on scan of processes\n" );
+          goto END;
+        }
+    }
+
+  sink += procs->total;
+
+  if ( selected ( cold ) )
+    report_scan ( cold, &st_cold );
+
+  if ( selected ( name ) )
+    report_scan ( name, &st );
+
+END:
+  processes_free ( procs );
+  connection_free ();
+}
+
+/* the first scan (cold) create all connections and processes, the others
+   are the cost of each refresh */
+static void
+bench_scan ( size_t lines )
+{
+  char conns[64], conns_cold[64], procs[64], procs_cold[64];
+
+  snprintf ( conns, sizeof conns, "scan_connections/%zu", lines );
+  snprintf ( conns_cold, sizeof conns_cold, "scan_connections_cold/%zu",
+             lines );
+  snprintf ( procs, sizeof procs, "scan_processes/%zu", lines );
+  snprintf ( procs_cold, sizeof procs_cold, "scan_processes_cold/%zu",
+             lines );
+
+  if ( !selected ( conns ) && !selected ( conns_cold ) &&
+       !selected ( procs ) && !selected ( procs_cold ) )
+    return;
+
+  if ( !*scan_root && !tree_create () )
+    {
+      fprintf ( stderr, "error on create tree of /proc\n" );
+      tree_remove ();
+      return;
+    }
+
+  if ( !tree_connections ( lines ) )
+    {
+      fprintf ( stderr, "error on write %zu connections\n", lines );
+      return;
+    }
+
+  if ( selected ( conns ) || selected ( conns_cold ) )
+    bench_scan_connections ( conns, conns_cold );
+
+  if ( selected ( procs ) || selected ( procs_cold ) )
+    bench_scan_processes ( procs, procs_cold );
+}
+
+/* translate */
+
+#define TRANSLATE_OPS 200000
+
+static void
+bench_translate ( const char *name, bool cached, bool service )
+{
+  if ( !selected ( name ) )
+    return;
+
+  struct config_op op = co;
+  op.translate_service = service;
+
+  connection_t conn = { 0 };
+  conn.tuple.family = AF_INET;
+  conn.tuple.l4.protocol = IPPROTO_TCP;
+  conn.tuple.l3.local.ip = htonl ( 0xc0a80002 );
+  conn.tuple.l3.remote.ip = htonl ( 0x08080808 );
+  conn.tuple.l4.local_port = 51234;
+  conn.tuple.l4.remote_port = 443;
+
+  uint64_t cycles = 0, ns = 0, len = 0;
+  struct timing t;
+
+  timing_start ( &t );
+  for ( size_t i = 0; i < TRANSLATE_OPS; i++ )
+    {
+      // without cache the tuple is formatted again, as after a resolve
+      if ( !cached )
+        conn.display_gen = ~0U;
+
+      len += strlen ( translate ( &conn, &op, 0 ) );
+    }
+  timing_stop ( &t, &cycles, &ns );
+
+  free ( conn.display );
+
+  sink += len;
+  report ( name, TRANSLATE_OPS, cycles, ns );
+}
+
+static void
+usage ( const char *prog )
+{
+  fprintf ( stderr,
+            "usage: %s [--json] [--max N] [--procs N] [--fds N] [name]\n",
+            prog );
+  exit ( EXIT_FAILURE );
+}
+
+int
+main ( int argc, char **argv )
+{
+  for ( int i = 1; i < argc; i++ )
+    {
+      if ( !strcmp ( argv[i], "--json" ) )
+        json = true;
+      else if ( !strcmp ( argv[i], "--max" ) && i + 1 < argc )
+        max_entries = strtoul ( argv[++i], NULL, 10 );
+      else if ( !strcmp ( argv[i], "--procs" ) && i + 1 < argc )
+        scan_procs = strtoul ( argv[++i], NULL, 10 );
+      else if ( !strcmp ( argv[i], "--fds" ) && i + 1 < argc )
+        scan_fds = strtoul ( argv[++i], NULL, 10 );
+      else if ( argv[i][0] != '-' && !only )
+        only = argv[i];
+      else
+        usage ( argv[0] );
+    }
+
+  srand ( 1 );
+  hash_init ();
+  rate_init ( &co );
+
+  if ( !packet_init ( FRAGMENTS_DEFAULT ) )
+    {
+      fprintf ( stderr, "error on alloc table of fragments\n" );
+      return EXIT_FAILURE;
+    }
+
+  if ( !json )
+    printf ( "%-32s %10s %12s %12s\n", "name", "ops", "cycles/op", "ns/op" );
+
+  bench_parse ( "parse_packet/eth", FRAME_ETH );
+  bench_parse ( "parse_packet/tun", FRAME_TUN );
+  bench_parse ( "parse_packet/ipv6", FRAME_IPV6 );
+  bench_parse ( "parse_packet/frag", FRAME_FRAG );
+
+  for ( size_t i = 0; i < ARRAY_SIZE ( sizes ) && sizes[i] <= max_entries;
+        i++ )
+    {
+      bench_connections ( sizes[i] );
+      bench_rate ( sizes[i] );
+      bench_hashtable ( sizes[i] );
+      bench_sort ( sizes[i] );
+    }
+
+  for ( size_t i = 0;
+        i < ARRAY_SIZE ( scan_sizes ) && scan_sizes[i] <= max_entries;
+        i++ )
+    bench_scan ( scan_sizes[i] );
+
+  tree_remove ();
+
+  bench_translate ( "translate/cached", true, false );
+  bench_translate ( "translate/numeric", false, false );
+  if ( service_init ( NULL ) )
+    bench_translate ( "translate/service", false, true );
+
+  packet_free ();
+  rate_free ();
+
+  return EXIT_SUCCESS;
+}
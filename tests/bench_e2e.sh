@@ -0,0 +1,175 @@
+#!/bin/sh
+
+# end-to-end benchmark, the max rate in packets per second that netproc
+# capture without drops in ring (tp_drops), needs root.
+# traffic of netproc-traffic (tests/traffic_gen.c) goes out by a veth pair,
+# the peer is in a network namespace of its own.
+#
+# Example:
+#   $ make bench-e2e BENCH_ARGS="-m mice -- --capture-threads 2"
+#
+# usage: bench_e2e.sh [-m mix] [-d seconds] [-l pps] [-h pps] [-p procs]
+#                     [-- options of netproc]
+#   -m  elephants, mice, fanout or frag (see tests/traffic_gen.c)
+#   -d  seconds of each run, default 10
+#   -l  lower rate of search, default 10000
+#   -h  upper rate of search, default 4000000
+#
+# each run is printed, and at end the result as
+#   mix=<mix> pps=<pps> cpu=<% of a CPU> cpu_mpps=<CPUs by Mpps>
+#   tick_avg_us=<us> tick_max_us=<us> rss_kb=<KiB>
+# where tick_avg_us is the average time of refresh (update of processes,
+# rates, sort), tick_max_us the slowest phase of a refresh and rss_kb the
+# peak of memory of netproc.
+
+NETPROC=${NETPROC:-./bin/netproc}
+TRAFFIC=${TRAFFIC:-./bin/netproc-traffic}
+
+IFACE=nbench0
+PEER=nbench1
+NETNS=nbench
+PORT=9188
+
+MIX=elephants
+SECONDS_RUN=10
+LOW=10000
+HIGH=4000000
+PROCS=4
+
+# search stop when the interval is less than 5%
+PRECISION=20
+
+while getopts "m:d:l:h:p:" opt; do
+  case $opt in
+    m) MIX=$OPTARG ;;
+    d) SECONDS_RUN=$OPTARG ;;
+    l) LOW=$OPTARG ;;
+    h) HIGH=$OPTARG ;;
+    p) PROCS=$OPTARG ;;
+    *) exit 1 ;;
+  esac
+done
+shift $((OPTIND - 1))
+
+TMP=
+NETPROC_PID=
+
+cleanup()
+{
+  [ -n "$NETPROC_PID" ] && kill "$NETPROC_PID" 2> /dev/null
+  ip link del $IFACE 2> /dev/null
+  ip netns del $NETNS 2> /dev/null
+  [ -n "$TMP" ] && rm -rf "$TMP"
+}
+
+setup()
+{
+  ip netns add $NETNS || exit 1
+  ip link add $IFACE type veth peer name $PEER || exit 1
+  ip link set $PEER netns $NETNS
+  ip addr add 10.201.0.1/30 dev $IFACE
+  ip link set $IFACE up
+  ip -n $NETNS addr add 10.201.0.2/30 dev $PEER
+  ip -n $NETNS link set $PEER up
+  # destinations of traffic, discarded by peer (without forwarding)
+  ip route add 10.202.0.0/16 via 10.201.0.2
+}
+
+metric()
+{
+  curl -s "localhost:$PORT/metrics" |
+    awk -v m="netproc_$1" '$1 == m { print $2 }'
+}
+
+# ticks of CPU of process, user and system
+cpu_ticks()
+{
+  awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+# run at rate $1, set PASS, SENT_PPS and the measures of run
+run()
+{
+  "$NETPROC" --headless -f "$TMP/netproc.log" -i $IFACE \
+    --metrics-port $PORT --self-stats "$@" 2> "$TMP/stderr" &
+  NETPROC_PID=$!
+
+  # start of capture and first update of processes
+  sleep 2
+  if ! kill -0 $NETPROC_PID 2> /dev/null; then
+    cat "$TMP/stderr" >&2
+    exit 1
+  fi
+
+  drops=$(metric drops_total)
+  ticks=$(cpu_ticks $NETPROC_PID)
+
+  set -- $("$TRAFFIC" -m "$MIX" -r "$RATE" -d "$SECONDS_RUN" -p "$PROCS")
+  sent=$2 elapsed=$3 SENT_PPS=$4
+
+  # counters of workers are merged in the refresh
+  sleep 2
+
+  drops=$(( $(metric drops_total) - drops ))
+  ticks=$(( $(cpu_ticks $NETPROC_PID) - ticks ))
+  RSS=$(awk '/^VmHWM/ { print $2 }' "/proc/$NETPROC_PID/status")
+
+  kill $NETPROC_PID
+  wait $NETPROC_PID
+  NETPROC_PID=
+
+  CPU=$(awk -v t=$ticks -v hz="$(getconf CLK_TCK)" -v s="$elapsed" \
+        'BEGIN { printf "%.1f", t * 100 / hz / ( s + 2 ) }')
+  CPU_MPPS=$(awk -v c="$CPU" -v p="$SENT_PPS" \
+             'BEGIN { printf "%.3f", ( p ) ? c / 100 / ( p / 1e6 ) : 0 }')
+
+  # time of refresh, phases of --self-stats
+  TICK=$(awk '$2 ~ /^[0-9]+$/ && NF == 5 { avg += $3; if ( $4 > max ) max = $4 }
+              END { printf "tick_avg_us=%.1f tick_max_us=%.1f", avg, max }' \
+         "$TMP/stderr")
+
+  # generator not reached the rate, the limit is of kernel or of generator
+  if [ "$SENT_PPS" -lt $((RATE * 95 / 100)) ]; then
+    LIMITED=1
+  fi
+
+  PASS=0
+  [ "$drops" -eq 0 ] && PASS=1
+
+  echo "rate=$RATE sent=$sent sent_pps=$SENT_PPS drops=$drops cpu=$CPU" >&2
+}
+
+if [ ! -x "$NETPROC" ] || [ ! -x "$TRAFFIC" ]; then
+  echo "build first with 'make $NETPROC $TRAFFIC'" >&2
+  exit 1
+fi
+
+trap cleanup EXIT
+trap 'exit 1' INT TERM
+
+cleanup
+TMP=$(mktemp -d)
+setup
+
+BEST=
+while [ $((HIGH - LOW)) -gt $((LOW / PRECISION)) ]; do
+  RATE=$(( (LOW + HIGH) / 2 ))
+  LIMITED=0
+  run "$@"
+
+  if [ $PASS -eq 1 ]; then
+    LOW=$SENT_PPS
+    BEST="mix=$MIX pps=$SENT_PPS cpu=$CPU cpu_mpps=$CPU_MPPS $TICK rss_kb=$RSS"
+    # rate sent is the max of generator
+    [ $LIMITED -eq 1 ] && HIGH=$SENT_PPS
+  else
+    HIGH=$RATE
+  fi
+done
+
+if [ -z "$BEST" ]; then
+  echo "mix=$MIX drops already in $LOW pps" >&2
+  exit 1
+fi
+
+echo "$BEST"
@@ -0,0 +1,72 @@
+// example of libnetproc (src/netproc.h), print each second the traffic of
+// processes in interfaces of argument, needs root
+//
+// usage: netproc-lib-example [interfaces] [seconds]
+//   interfaces as "eth0,eth1", default is all
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "../src/netproc.h"
+
+static void
+print_records ( const struct netproc_record *records,
+                size_t total,
+                void *user_data )
+{
+  unsigned int *tick = user_data;
+
+  for ( size_t i = 0; i < total; i++ )
+    printf ( "%u %d %s tx %" PRIu64 " %" PRIu64 " rx %" PRIu64 " %" PRIu64
+             "\n",
+             *tick,
+             ( int ) records[i].pid,
+             records[i].name,
+             records[i].tx_bytes,
+             records[i].tx_packets,
+             records[i].rx_bytes,
+             records[i].rx_packets );
+
+  fflush ( stdout );
+}
+
+int
+main ( int argc, char **argv )
+{
+  struct netproc_options op = { .interfaces = ( argc > 1 ) ? argv[1] : NULL };
+  unsigned int seconds = ( argc > 2 ) ? strtoul ( argv[2], NULL, 10 ) : 10;
+
+  if ( netproc_init ( &op ) == -1 )
+    {
+      fprintf ( stderr, "Error netproc_init\n" );
+      return EXIT_FAILURE;
+    }
+
+  time_t last = time ( NULL );
+
+  for ( unsigned int tick = 0; tick < seconds; )
+    {
+      // rings are read as packets arrive, between ticks
+      if ( netproc_read ( 100 ) == -1 )
+        {
+          fprintf ( stderr, "Error netproc_read\n" );
+          break;
+        }
+
+      time_t now = time ( NULL );
+      if ( now == last )
+        continue;
+
+      last = now;
+      tick++;
+      if ( netproc_tick ( print_records, &tick ) == -1 )
+        fprintf ( stderr, "Error netproc_tick\n" );
+    }
+
+  netproc_close ();
+
+  return EXIT_SUCCESS;
+}
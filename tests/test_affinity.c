@@ -0,0 +1,51 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+
+#include "affinity.h"
+#include "unity.h"
+
+void
+test_affinity ( void )
+{
+  cpu_set_t all;
+  TEST_ASSERT_EQUAL_INT ( 0, sched_getaffinity ( 0, sizeof all, &all ) );
+
+  int cpu = 0;
+  while ( !CPU_ISSET ( cpu, &all ) )
+    cpu++;
+
+  TEST_ASSERT_FALSE ( affinity_capture_init ( "1-x", NULL, 0 ) );
+  TEST_ASSERT_FALSE ( affinity_capture_init ( "3-1", NULL, 0 ) );
+  TEST_ASSERT_FALSE ( affinity_capture_init ( "", NULL, 0 ) );
+  TEST_ASSERT_FALSE ( affinity_capture_init ( "0,,1", NULL, 0 ) );
+
+  // CPUs where process can not run are ignored
+  TEST_ASSERT_TRUE ( affinity_capture_init ( "1023", NULL, 0 ) );
+  TEST_ASSERT_EQUAL_UINT ( CPU_ISSET ( 1023, &all ),
+                           affinity_capture_count () );
+
+  char list[32];
+  snprintf ( list, sizeof list, "%d", cpu );
+  TEST_ASSERT_TRUE ( affinity_capture_init ( list, NULL, 0 ) );
+  TEST_ASSERT_EQUAL_UINT ( 1, affinity_capture_count () );
+
+  // round robin in CPUs of capture
+  TEST_ASSERT_TRUE ( affinity_pin_capture ( 3 ) );
+
+  cpu_set_t set;
+  sched_getaffinity ( 0, sizeof set, &set );
+  TEST_ASSERT_EQUAL_INT ( 1, CPU_COUNT ( &set ) );
+  TEST_ASSERT_TRUE ( CPU_ISSET ( cpu, &set ) );
+
+  affinity_unpin ();
+  sched_getaffinity ( 0, sizeof set, &set );
+  TEST_ASSERT_TRUE ( CPU_EQUAL ( &set, &all ) );
+
+  // out of CPU of capture, without effect if it is the only CPU
+  affinity_avoid_capture ();
+  sched_getaffinity ( 0, sizeof set, &set );
+  TEST_ASSERT_EQUAL_INT ( CPU_COUNT ( &all ) == 1 ? 1 : CPU_COUNT ( &all ) - 1,
+                          CPU_COUNT ( &set ) );
+  sched_setaffinity ( 0, sizeof all, &all );
+}
@@ -0,0 +1,53 @@
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unity.h"
+#include "arena.h"
+
+void
+test_arena ( void )
+{
+  struct arena arena = ARENA_INITIALIZER;
+
+  char *a = arena_alloc ( &arena, 10 );
+  TEST_ASSERT_NOT_NULL ( a );
+  TEST_ASSERT_EQUAL_UINT ( 0, ( uintptr_t ) a % alignof ( max_align_t ) );
+  memcpy ( a, "012345678", 10 );
+
+  // last allocation grow in place
+  char *b = arena_realloc ( &arena, a, 10, 100 );
+  TEST_ASSERT_EQUAL_PTR ( a, b );
+
+  // others are copied
+  char *c = arena_alloc ( &arena, 10 );
+  TEST_ASSERT_NOT_NULL ( c );
+  TEST_ASSERT_TRUE ( c >= a + 100 );
+
+  b = arena_realloc ( &arena, a, 100, 200 );
+  TEST_ASSERT_NOT_NULL ( b );
+  TEST_ASSERT_NOT_EQUAL ( a, b );
+  TEST_ASSERT_EQUAL_STRING ( "012345678", b );
+
+  // more of a chunk
+  for ( int i = 0; i < 100; i++ )
+    TEST_ASSERT_NOT_NULL ( arena_alloc ( &arena, 4096 ) );
+
+  size_t used = arena.used;
+  TEST_ASSERT_GREATER_OR_EQUAL ( 100 * 4096, used );
+
+  // after reset, all memory of scan in one chunk
+  arena_reset ( &arena );
+  TEST_ASSERT_EQUAL_UINT ( 0, arena.used );
+
+  char *first = arena_alloc ( &arena, 4096 );
+  TEST_ASSERT_NOT_NULL ( first );
+  for ( int i = 1; i < 100; i++ )
+    {
+      char *p = arena_alloc ( &arena, 4096 );
+      TEST_ASSERT_EQUAL_PTR ( first + i * 4096, p );
+    }
+
+  arena_free ( &arena );
+  TEST_ASSERT_NULL ( arena.chunks );
+}
@@ -0,0 +1,168 @@
+#include <stdlib.h>
+
+#include "unity.h"
+#include "conn_index.h"
+#include "connection.h"
+
+#define TOTAL 5000
+
+static connection_t conns[TOTAL];
+
+// few different hashes, long sequences of probe and slots moved on deletion
+static hash_t
+bad_hash ( size_t i )
+{
+  return i % 61;
+}
+
+static void
+test_tuple ( void )
+{
+  struct tuple_index ti;
+
+  TEST_ASSERT_TRUE ( tuple_index_init ( &ti ) );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    {
+      conns[i].tuple.family = AF_INET;
+      conns[i].tuple.l3.local.ip = i;
+      conns[i].tuple.l4.local_port = i & 0xffff;
+      TEST_ASSERT_TRUE ( tuple_index_set ( &ti, &conns[i], bad_hash ( i ) ) );
+    }
+
+  TEST_ASSERT_EQUAL_UINT ( TOTAL, ti.used );
+  TEST_ASSERT_GREATER_OR_EQUAL ( TOTAL, tuple_index_size ( &ti ) );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    TEST_ASSERT_EQUAL_PTR (
+            &conns[i],
+            tuple_index_get ( &ti, &conns[i].tuple, bad_hash ( i ) ) );
+
+  // hash of a slot near of end, sequence turn to start of index
+  size_t last = tuple_index_size ( &ti ) - 1;
+  struct tuple tuple = { .family = AF_INET6 };
+  TEST_ASSERT_NULL ( tuple_index_get ( &ti, &tuple, last ) );
+
+  for ( size_t i = 0; i < TOTAL; i += 2 )
+    tuple_index_del ( &ti, &conns[i], bad_hash ( i ) );
+
+  TEST_ASSERT_EQUAL_UINT ( TOTAL / 2, ti.used );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    {
+      connection_t *conn =
+              tuple_index_get ( &ti, &conns[i].tuple, bad_hash ( i ) );
+
+      TEST_ASSERT_EQUAL_PTR ( ( i % 2 ) ? &conns[i] : NULL, conn );
+    }
+
+  // same key more than one time, deletion by value
+  connection_t dup = conns[1];
+  TEST_ASSERT_TRUE ( tuple_index_set ( &ti, &dup, bad_hash ( 1 ) ) );
+  tuple_index_del ( &ti, &conns[1], bad_hash ( 1 ) );
+  TEST_ASSERT_EQUAL_PTR ( &dup,
+                          tuple_index_get ( &ti, &dup.tuple, bad_hash ( 1 ) ) );
+
+  tuple_index_free ( &ti );
+}
+
+static void
+test_inode ( void )
+{
+  struct inode_index ii;
+
+  TEST_ASSERT_TRUE ( inode_index_init ( &ii ) );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    {
+      conns[i].inode = 1000 + i;
+      TEST_ASSERT_TRUE ( inode_index_set ( &ii, &conns[i] ) );
+    }
+
+  TEST_ASSERT_EQUAL_UINT ( TOTAL, ii.used );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    TEST_ASSERT_EQUAL_PTR ( &conns[i],
+                            inode_index_get ( &ii, conns[i].inode ) );
+
+  TEST_ASSERT_NULL ( inode_index_get ( &ii, 1 ) );
+
+  for ( size_t i = 1; i < TOTAL; i += 2 )
+    inode_index_del ( &ii, &conns[i] );
+
+  TEST_ASSERT_EQUAL_UINT ( TOTAL / 2, ii.used );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    TEST_ASSERT_EQUAL_PTR ( ( i % 2 ) ? NULL : &conns[i],
+                            inode_index_get ( &ii, conns[i].inode ) );
+
+  inode_index_free ( &ii );
+}
+
+// lookup and deletion while slots of old array are being moved
+static void
+test_tuple_grow ( void )
+{
+  struct tuple_index ti;
+
+  TEST_ASSERT_TRUE ( tuple_index_init ( &ti ) );
+
+  // first grow is with 768 entries, stop before of move all slots
+  const size_t total = 800;
+  for ( size_t i = 0; i < total; i++ )
+    {
+      conns[i].tuple.family = AF_INET;
+      conns[i].tuple.l3.local.ip = i;
+      conns[i].tuple.l4.local_port = i & 0xffff;
+      TEST_ASSERT_TRUE ( tuple_index_set ( &ti, &conns[i], i ) );
+    }
+
+  TEST_ASSERT_NOT_NULL ( ti.old_slots );
+  TEST_ASSERT_EQUAL_UINT ( total, ti.used );
+
+  for ( size_t i = 0; i < total; i++ )
+    TEST_ASSERT_EQUAL_PTR ( &conns[i],
+                            tuple_index_get ( &ti, &conns[i].tuple, i ) );
+
+  // as remove_inactives_conns, deletion not advance the slot
+  size_t size = tuple_index_size ( &ti );
+  for ( size_t i = 0; i < size; )
+    {
+      connection_t *conn = tuple_index_at ( &ti, i );
+
+      if ( !conn || ( conn - conns ) % 2 )
+        {
+          i++;
+          continue;
+        }
+
+      tuple_index_del_at ( &ti, i );
+    }
+
+  TEST_ASSERT_EQUAL_UINT ( total / 2, ti.used );
+
+  for ( size_t i = 0; i < total; i++ )
+    TEST_ASSERT_EQUAL_PTR ( ( i % 2 ) ? &conns[i] : NULL,
+                            tuple_index_get ( &ti, &conns[i].tuple, i ) );
+
+  // inserts finish the move and free old array
+  for ( size_t i = 0; i < total; i += 2 )
+    TEST_ASSERT_TRUE ( tuple_index_set ( &ti, &conns[i], i ) );
+
+  TEST_ASSERT_NULL ( ti.old_slots );
+  TEST_ASSERT_EQUAL_UINT ( total, ti.used );
+
+  for ( size_t i = 0; i < total; i++ )
+    TEST_ASSERT_EQUAL_PTR ( &conns[i],
+                            tuple_index_get ( &ti, &conns[i].tuple, i ) );
+
+  tuple_index_free ( &ti );
+}
+
+void
+test_conn_index ( void )
+{
+  test_tuple ();
+  test_tuple_grow ();
+  test_inode ();
+}
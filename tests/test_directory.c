@@ -0,0 +1,93 @@
+#include <stdbool.h>
+#include <stdlib.h>  // mkdtemp
+#include <stdio.h>   // snprintf
+#include <fcntl.h>   // open
+#include <unistd.h>  // close
+
+#include "unity.h"
+#include "directory.h"
+
+static void
+create_file ( const char *dir, const char *name )
+{
+  char path[256];
+  snprintf ( path, sizeof path, "%s/%s", dir, name );
+
+  int fd = open ( path, O_CREAT | O_WRONLY, 0600 );
+  TEST_ASSERT ( fd != -1 );
+  close ( fd );
+}
+
+static void
+remove_file ( const char *dir, const char *name )
+{
+  char path[256];
+  snprintf ( path, sizeof path, "%s/%s", dir, name );
+  unlink ( path );
+}
+
+static bool
+has_value ( const struct numeric_dir *nd, int total, uint32_t value )
+{
+  for ( int i = 0; i < total; i++ )
+    {
+      if ( nd->values[i] == value )
+        return true;
+    }
+
+  return false;
+}
+
+void
+test_directory ( void )
+{
+  char dir[] = "/tmp/netproc_test_XXXXXX";
+  TEST_ASSERT_NOT_NULL ( mkdtemp ( dir ) );
+
+  const char *names[] = { "1",   "22",  "4294967295", "4294967296",
+                          "abc", "12a", "-1" };
+  size_t total_names = sizeof names / sizeof names[0];
+
+  for ( size_t i = 0; i < total_names; i++ )
+    create_file ( dir, names[i] );
+
+  struct numeric_dir nd = { 0 };
+
+  int total = get_numeric_directory ( &nd, dir );
+  TEST_ASSERT_EQUAL_INT ( 3, total );
+  TEST_ASSERT_TRUE ( has_value ( &nd, total, 1 ) );
+  TEST_ASSERT_TRUE ( has_value ( &nd, total, 22 ) );
+  TEST_ASSERT_TRUE ( has_value ( &nd, total, 4294967295U ) );
+
+  // buffers are reused in next read
+  uint32_t *values = nd.values;
+  TEST_ASSERT_EQUAL_INT ( 3, get_numeric_directory ( &nd, dir ) );
+  TEST_ASSERT_EQUAL_PTR ( values, nd.values );
+
+  // more entries than initial size of buffer
+  char name[16];
+  for ( int i = 100; i < 400; i++ )
+    {
+      snprintf ( name, sizeof name, "%d", i );
+      create_file ( dir, name );
+    }
+
+  total = get_numeric_directory ( &nd, dir );
+  TEST_ASSERT_EQUAL_INT ( 303, total );
+  TEST_ASSERT_TRUE ( has_value ( &nd, total, 399 ) );
+
+  TEST_ASSERT_EQUAL_INT ( -1, get_numeric_directory ( &nd, "/nonexistent" ) );
+
+  for ( int i = 100; i < 400; i++ )
+    {
+      snprintf ( name, sizeof name, "%d", i );
+      remove_file ( dir, name );
+    }
+
+  for ( size_t i = 0; i < total_names; i++ )
+    remove_file ( dir, names[i] );
+
+  rmdir ( dir );
+  numeric_dir_free ( &nd );
+  TEST_ASSERT_NULL ( nd.values );
+}
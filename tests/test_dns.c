@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "dns.h"
+#include "unity.h"
+
+struct result
+{
+  char name[256];
+  unsigned int ttl;
+  int done;
+};
+
+static void
+cb_done ( void *arg, const char *name, unsigned int ttl )
+{
+  struct result *r = arg;
+
+  r->ttl = ttl;
+  snprintf ( r->name, sizeof r->name, "%s", name ? name : "" );
+  __atomic_store_n ( &r->done, 1, __ATOMIC_RELEASE );
+}
+
+// query again in callback, as cache of names when a name expires
+static struct result r_again;
+static union sockaddr_all addr_again;
+
+static void
+cb_requery ( void *arg, const char *name, unsigned int ttl )
+{
+  TEST_ASSERT_EQUAL_INT ( 1, dns_query ( &addr_again, 0, cb_done, &r_again ) );
+  cb_done ( arg, name, ttl );
+}
+
+static void
+write_file ( char *path, const char *content )
+{
+  int fd = mkstemp ( path );
+  TEST_ASSERT_NOT_EQUAL ( -1, fd );
+  TEST_ASSERT_EQUAL_INT ( strlen ( content ),
+                          write ( fd, content, strlen ( content ) ) );
+  close ( fd );
+}
+
+static void
+wait_result ( struct result *r )
+{
+  // timeout of test is 1 second by attempt
+  for ( int i = 0; i < 400 && !__atomic_load_n ( &r->done, __ATOMIC_ACQUIRE );
+        i++ )
+    usleep ( 10000 );
+
+  TEST_ASSERT_EQUAL_INT ( 1, r->done );
+}
+
+void
+test_dns ( void )
+{
+  char conf[] = "/tmp/netproc_resolv_XXXXXX";
+  char hosts[] = "/tmp/netproc_hosts_XXXXXX";
+  char empty[] = "/tmp/netproc_empty_XXXXXX";
+
+  // without nameservers client is not started
+  write_file ( empty, "# nothing\noptions timeout:1\n" );
+  TEST_ASSERT_EQUAL_INT ( 0, dns_init ( empty, empty ) );
+
+  union sockaddr_all addr = { 0 };
+  struct result r = { 0 };
+  TEST_ASSERT_EQUAL_INT ( 0, dns_query ( &addr, 0, cb_done, &r ) );
+
+  write_file ( conf,
+               "nameserver 127.0.0.1\n"
+               "options timeout:1 attempts:1\n" );
+  write_file ( hosts,
+               "# comment\n"
+               "10.1.2.3  first alias\n"
+               "10.1.2.3  second\n"
+               "fd00::1   six\n" );
+
+  TEST_ASSERT_EQUAL_INT ( 1, dns_init ( conf, hosts ) );
+
+  // names of hosts file
+  addr.in.sin_family = AF_INET;
+  inet_pton ( AF_INET, "10.1.2.3", &addr.in.sin_addr );
+  TEST_ASSERT_EQUAL_INT ( 1, dns_query ( &addr, 0, cb_done, &r ) );
+  wait_result ( &r );
+  TEST_ASSERT_EQUAL_STRING ( "first", r.name );
+
+  struct result r6 = { 0 };
+  union sockaddr_all addr6 = { 0 };
+  addr6.in6.sin6_family = AF_INET6;
+  inet_pton ( AF_INET6, "fd00::1", &addr6.in6.sin6_addr );
+  TEST_ASSERT_EQUAL_INT ( 1, dns_query ( &addr6, 1, cb_done, &r6 ) );
+  wait_result ( &r6 );
+  TEST_ASSERT_EQUAL_STRING ( "six", r6.name );
+
+  // callback of hosts file is called without lock of pending
+  struct result r_first = { 0 };
+  addr_again = addr6;
+  inet_pton ( AF_INET, "10.1.2.3", &addr.in.sin_addr );
+  TEST_ASSERT_EQUAL_INT ( 1, dns_query ( &addr, 0, cb_requery, &r_first ) );
+  wait_result ( &r_first );
+  wait_result ( &r_again );
+  TEST_ASSERT_EQUAL_STRING ( "first", r_first.name );
+  TEST_ASSERT_EQUAL_STRING ( "six", r_again.name );
+
+  /* address of documentation (TEST-NET-2) without name, answered with error
+     or timeout, in both cases without name */
+  struct result r_none = { 0 };
+  inet_pton ( AF_INET, "198.51.100.77", &addr.in.sin_addr );
+  TEST_ASSERT_EQUAL_INT ( 1, dns_query ( &addr, 2, cb_done, &r_none ) );
+  wait_result ( &r_none );
+  TEST_ASSERT_EQUAL_STRING ( "", r_none.name );
+
+  dns_free ();
+
+  unlink ( conf );
+  unlink ( hosts );
+  unlink ( empty );
+}
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include "domain.h"
+#include "unity.h"
+
+static void
+set_addr ( union sockaddr_all *addr, const char *ip )
+{
+  memset ( addr, 0, sizeof *addr );
+  addr->in.sin_family = AF_INET;
+  inet_pton ( AF_INET, ip, &addr->in.sin_addr );
+}
+
+static int
+lookup ( union sockaddr_all *addr, char *buff )
+{
+  return ip2domain ( addr, DOMAIN_PRIO_VISIBLE, buff, 256 );
+}
+
+static int
+read_entry ( FILE *file, char *ip, long long *expire, char *name )
+{
+  return fscanf ( file, "%63s %lld %63s", ip, expire, name );
+}
+
+void
+test_domain ( void )
+{
+  char path[] = "/tmp/netproc_domain_XXXXXX";
+  int fd = mkstemp ( path );
+  TEST_ASSERT_NOT_EQUAL ( -1, fd );
+
+  FILE *file = fdopen ( fd, "w" );
+  long long now = time ( NULL );
+  fprintf ( file,
+            "# netproc cache of domain\n"
+            "192.0.2.10 %lld ten.example\n"
+            "192.0.2.11 %lld old.example\n"
+            "192.0.2.12 %lld -\n",
+            now + 600,
+            now - 10,
+            now + 600 );
+  fclose ( file );
+
+  union sockaddr_all addr;
+  char buff[256];
+
+  // without memory to a entry nothing is loaded nor resolved
+  TEST_ASSERT_EQUAL_INT ( 1, cache_domain_init ( 1, NULL ) );
+  set_addr ( &addr, "192.0.2.10" );
+  TEST_ASSERT_EQUAL_INT ( 0, lookup ( &addr, buff ) );
+  TEST_ASSERT_EQUAL_STRING ( "192.0.2.10", buff );
+  cache_domain_free ();
+
+  // warm start, names of file are in cache, without query
+  TEST_ASSERT_EQUAL_INT ( 1, cache_domain_init ( 0, path ) );
+
+  uint32_t gen = domain_generation ();
+
+  TEST_ASSERT_EQUAL_INT ( 1, lookup ( &addr, buff ) );
+  TEST_ASSERT_EQUAL_STRING ( "ten.example", buff );
+
+  // negative cache, address without name
+  set_addr ( &addr, "192.0.2.12" );
+  TEST_ASSERT_EQUAL_INT ( 1, lookup ( &addr, buff ) );
+  TEST_ASSERT_EQUAL_STRING ( "192.0.2.12", buff );
+
+  TEST_ASSERT_EQUAL_UINT32 ( gen, domain_generation () );
+
+  // saved on exit, most recent first and without expired
+  cache_domain_free ();
+
+  file = fopen ( path, "r" );
+  TEST_ASSERT_NOT_NULL ( file );
+
+  char line[256];
+  char ip[64], name[64];
+  long long expire;
+
+  TEST_ASSERT_NOT_NULL ( fgets ( line, sizeof line, file ) );
+  TEST_ASSERT_EQUAL_INT ( '#', line[0] );
+
+  TEST_ASSERT_EQUAL_INT ( 3, read_entry ( file, ip, &expire, name ) );
+  TEST_ASSERT_EQUAL_STRING ( "192.0.2.12", ip );
+  TEST_ASSERT_EQUAL_STRING ( "-", name );
+  TEST_ASSERT_TRUE ( expire > now && expire <= now + 601 );
+
+  TEST_ASSERT_EQUAL_INT ( 3, read_entry ( file, ip, &expire, name ) );
+  TEST_ASSERT_EQUAL_STRING ( "192.0.2.10", ip );
+  TEST_ASSERT_EQUAL_STRING ( "ten.example", name );
+
+  TEST_ASSERT_EQUAL_INT ( EOF, fscanf ( file, "%63s", ip ) );
+
+  fclose ( file );
+  unlink ( path );
+}
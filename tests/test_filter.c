@@ -0,0 +1,513 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>  // unlink
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+
+#include "unity.h"
+#include "../src/filter.c"
+
+// value of extension random, incremented on each load
+static uint32_t random_next;
+
+// value of extension pkttype, PACKET_HOST (0) by default
+static uint32_t pkttype;
+
+// minimal interpreter of instructions generated by builder
+static uint32_t
+run ( const struct sock_fprog *fprog,
+      const uint8_t *pkt,
+      size_t len,
+      uint32_t ifindex )
+{
+  uint32_t A = 0, X = 0;
+
+  for ( unsigned int pc = 0; pc < fprog->len; pc++ )
+    {
+      const struct sock_filter *f = &fprog->filter[pc];
+      uint32_t off = f->k;
+      uint32_t size;
+
+      switch ( f->code )
+        {
+          case BPF_LD | BPF_W | BPF_ABS:
+            if ( off == ( uint32_t ) ( SKF_AD_OFF + SKF_AD_IFINDEX ) )
+              {
+                A = ifindex;
+                continue;
+              }
+            if ( off == ( uint32_t ) ( SKF_AD_OFF + SKF_AD_RANDOM ) )
+              {
+                A = random_next++;
+                continue;
+              }
+            if ( off == ( uint32_t ) ( SKF_AD_OFF + SKF_AD_PKTTYPE ) )
+              {
+                A = pkttype;
+                continue;
+              }
+            size = 4;
+            break;
+          case BPF_LD | BPF_H | BPF_ABS:
+            size = 2;
+            break;
+          case BPF_LD | BPF_B | BPF_ABS:
+            size = 1;
+            break;
+          case BPF_LD | BPF_W | BPF_IND:
+            size = 4;
+            off += X;
+            break;
+          case BPF_LD | BPF_H | BPF_IND:
+            size = 2;
+            off += X;
+            break;
+          case BPF_LD | BPF_B | BPF_IND:
+            size = 1;
+            off += X;
+            break;
+          case BPF_LDX | BPF_W | BPF_IMM:
+            X = f->k;
+            continue;
+          case BPF_MISC | BPF_TAX:
+            X = A;
+            continue;
+          case BPF_ALU | BPF_LSH | BPF_K:
+            A <<= f->k;
+            continue;
+          case BPF_ALU | BPF_ADD | BPF_X:
+            A += X;
+            continue;
+          case BPF_LDX | BPF_B | BPF_MSH:
+            if ( off >= len )
+              return 0;
+            X = ( pkt[off] & 0xf ) * 4;
+            continue;
+          case BPF_ALU | BPF_AND | BPF_K:
+            A &= f->k;
+            continue;
+          case BPF_ALU | BPF_MOD | BPF_K:
+            A %= f->k;
+            continue;
+          case BPF_JMP | BPF_JA:
+            pc += f->k;
+            continue;
+          case BPF_JMP | BPF_JEQ | BPF_K:
+            pc += ( A == f->k ) ? f->jt : f->jf;
+            continue;
+          case BPF_JMP | BPF_JSET | BPF_K:
+            pc += ( A & f->k ) ? f->jt : f->jf;
+            continue;
+          case BPF_RET | BPF_K:
+            return f->k;
+          default:
+            TEST_FAIL_MESSAGE ( "instruction unknown" );
+            return 0;
+        }
+
+      // load out of packet abort program
+      if ( off + size > len )
+        return 0;
+
+      A = 0;
+      for ( uint32_t i = 0; i < size; i++ )
+        A = ( A << 8 ) | pkt[off + i];
+    }
+
+  TEST_FAIL_MESSAGE ( "end of program without return" );
+  return 0;
+}
+
+// packed, header ipv4 and ipv6 start just after header ethernet
+struct __attribute__ ( ( packed ) ) frame4
+{
+  uint8_t eth[14];
+  struct iphdr l3;
+  uint16_t ports[2];
+};
+
+struct __attribute__ ( ( packed ) ) frame6
+{
+  uint8_t eth[14];
+  struct ip6_hdr l3;
+  uint16_t ports[2];
+};
+
+static struct frame4
+frame4 ( const char *src, const char *dst, uint8_t proto, uint16_t dport )
+{
+  struct frame4 f = { .eth = { [12] = 0x08, [13] = 0x00 } };
+
+  f.l3.version = 4;
+  f.l3.ihl = 5;
+  f.l3.protocol = proto;
+  inet_pton ( AF_INET, src, &f.l3.saddr );
+  inet_pton ( AF_INET, dst, &f.l3.daddr );
+  f.ports[0] = htons ( 40000 );
+  f.ports[1] = htons ( dport );
+
+  return f;
+}
+
+static struct frame6
+frame6 ( const char *src, const char *dst, uint16_t dport )
+{
+  struct frame6 f = { .eth = { [12] = 0x86, [13] = 0xdd } };
+
+  f.l3.ip6_vfc = 0x60;
+  f.l3.ip6_nxt = IPPROTO_UDP;
+  inet_pton ( AF_INET6, src, &f.l3.ip6_src );
+  inet_pton ( AF_INET6, dst, &f.l3.ip6_dst );
+  f.ports[0] = htons ( 40000 );
+  f.ports[1] = htons ( dport );
+
+  return f;
+}
+
+#define RUN( fprog, frame ) \
+  run ( ( fprog ), ( const uint8_t * ) &( frame ), sizeof ( frame ), 2 )
+
+// frame of ethernet with 'tags' tags of vlan before the ethertype, in 'buff'
+static size_t
+tagged ( uint8_t *buff, const void *frame, size_t len, unsigned int tags )
+{
+  static const uint8_t tag[] = { 0x81, 0x00, 0x00, 0x0a };
+  static const uint8_t tag_ad[] = { 0x88, 0xa8, 0x00, 0x64 };
+
+  memcpy ( buff, frame, 12 );
+  for ( unsigned int i = 0; i < tags; i++ )
+    memcpy ( buff + 12 + i * 4, ( i + 1 < tags ) ? tag_ad : tag, 4 );
+
+  memcpy ( buff + 12 + tags * 4, ( const uint8_t * ) frame + 12, len - 12 );
+
+  return len + tags * 4;
+}
+
+static void
+test_filter_default ( void )
+{
+  struct config_op co = { .proto = TCP | UDP };
+  struct sock_fprog fprog;
+
+  TEST_ASSERT_TRUE ( filter_build ( &fprog, &co, LINK_ANY ) );
+
+  struct frame4 f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, RUN ( &fprog, f4 ) );
+
+  // tun has not header of link
+  TEST_ASSERT_EQUAL_UINT32 (
+          SNAPLEN_ALL,
+          run ( &fprog, ( uint8_t * ) &f4.l3, sizeof ( f4 ) - 14, 2 ) );
+
+  f4 = frame4 ( "127.0.0.1", "127.0.0.1", IPPROTO_UDP, 53 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f4 ) );
+
+  f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_ICMP, 0 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f4 ) );
+
+  struct frame6 f6 = frame6 ( "fd00::2", "2001:db8::1", 53 );
+  TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, RUN ( &fprog, f6 ) );
+
+  f6 = frame6 ( "::1", "::1", 53 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f6 ) );
+
+  filter_free ( &fprog );
+
+  // only tcp, with snaplen
+  co.proto = TCP;
+  co.snaplen = 128;
+  TEST_ASSERT_TRUE ( filter_build ( &fprog, &co, LINK_ANY ) );
+
+  f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  TEST_ASSERT_EQUAL_UINT32 ( 128, RUN ( &fprog, f4 ) );
+
+  f6 = frame6 ( "fd00::2", "2001:db8::1", 53 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f6 ) );
+
+  filter_free ( &fprog );
+}
+
+static void
+test_filter_excludes ( void )
+{
+  struct config_op co = { .proto = TCP | UDP };
+  struct sock_fprog fprog;
+
+  TEST_ASSERT_TRUE (
+          filter_exclude_add ( &co.excludes, EXCLUDE_NET, "10.1.2.3/16" ) );
+  TEST_ASSERT_TRUE (
+          filter_exclude_add ( &co.excludes, EXCLUDE_NET, "2001:db8:ab::/40" ) );
+  TEST_ASSERT_TRUE ( filter_exclude_add ( &co.excludes, EXCLUDE_PORT, "873" ) );
+  TEST_ASSERT_FALSE ( filter_exclude_add ( &co.excludes, EXCLUDE_NET, "x/8" ) );
+  TEST_ASSERT_FALSE (
+          filter_exclude_add ( &co.excludes, EXCLUDE_NET, "10.0.0.0/33" ) );
+  TEST_ASSERT_FALSE (
+          filter_exclude_add ( &co.excludes, EXCLUDE_PORT, "65536" ) );
+
+  // bits of host are cleared
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( 0x0a010000 ), co.excludes.nets[0].addr.ip );
+
+  // interface with index 2
+  co.excludes.ifindex[0] = 2;
+  co.excludes.total_ifaces = 1;
+
+  TEST_ASSERT_TRUE ( filter_build ( &fprog, &co, LINK_ANY ) );
+
+  struct frame4 f4 = frame4 ( "192.168.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f4 ) );
+  TEST_ASSERT_EQUAL_UINT32 (
+          SNAPLEN_ALL, run ( &fprog, ( uint8_t * ) &f4, sizeof ( f4 ), 3 ) );
+
+  co.excludes.total_ifaces = 0;
+  filter_free ( &fprog );
+  TEST_ASSERT_TRUE ( filter_build ( &fprog, &co, LINK_ANY ) );
+
+  f4 = frame4 ( "192.168.0.1", "10.1.200.1", IPPROTO_TCP, 443 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f4 ) );
+
+  f4 = frame4 ( "192.168.0.1", "10.2.0.1", IPPROTO_TCP, 443 );
+  TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, RUN ( &fprog, f4 ) );
+
+  f4 = frame4 ( "192.168.0.1", "10.2.0.1", IPPROTO_UDP, 873 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f4 ) );
+
+  // fragment not first has no ports, pass
+  f4.l3.frag_off = htons ( 10 );
+  TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, RUN ( &fprog, f4 ) );
+
+  struct frame6 f6 = frame6 ( "2001:db8:ff::1", "fd00::2", 53 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f6 ) );
+
+  f6 = frame6 ( "2001:db8:100::1", "fd00::2", 53 );
+  TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, RUN ( &fprog, f6 ) );
+
+  f6 = frame6 ( "2001:db8:100::1", "fd00::2", 873 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f6 ) );
+
+  filter_free ( &fprog );
+}
+
+static void
+test_filter_file ( void )
+{
+  struct filter_excludes ex = { 0 };
+  char path[] = "/tmp/netproc_filter_XXXXXX";
+
+  int fd = mkstemp ( path );
+  TEST_ASSERT_TRUE ( fd != -1 );
+
+  FILE *file = fdopen ( fd, "w" );
+  fputs ( "# backup\n"
+          "net 172.16.0.0/12\n"
+          "\n"
+          "  port 873\n"
+          "net fe80::/10\n",
+          file );
+  fclose ( file );
+
+  TEST_ASSERT_TRUE ( filter_exclude_load ( &ex, path ) );
+  TEST_ASSERT_EQUAL_UINT ( 2, ex.total_nets );
+  TEST_ASSERT_EQUAL_UINT ( 1, ex.total_ports );
+  TEST_ASSERT_EQUAL_UINT16 ( 873, ex.ports[0] );
+  TEST_ASSERT_EQUAL_INT ( AF_INET6, ex.nets[1].family );
+
+  file = fopen ( path, "a" );
+  fputs ( "host 10.0.0.1\n", file );
+  fclose ( file );
+
+  TEST_ASSERT_FALSE ( filter_exclude_load ( &ex, path ) );
+
+  unlink ( path );
+}
+
+static void
+test_filter_sample ( void )
+{
+  struct config_op co = { .proto = TCP | UDP, .sample = 4 };
+  struct sock_fprog fprog;
+
+  co.excludes.total_ports = 1;
+  co.excludes.ports[0] = 873;
+
+  TEST_ASSERT_TRUE ( filter_build ( &fprog, &co, LINK_ANY ) );
+
+  // 1 in 4 packets accepted, of ipv4 and of ipv6
+  unsigned int accepted = 0;
+  struct frame4 f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  struct frame6 f6 = frame6 ( "fd00::2", "2001:db8::1", 53 );
+
+  random_next = 0;
+  for ( unsigned int i = 0; i < 8; i++ )
+    {
+      accepted += RUN ( &fprog, f4 ) == SNAPLEN_ALL;
+      accepted += RUN ( &fprog, f6 ) == SNAPLEN_ALL;
+    }
+
+  TEST_ASSERT_EQUAL_UINT ( 4, accepted );
+
+  // exclusions are dropped before of sample
+  f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 873 );
+  for ( unsigned int i = 0; i < 4; i++ )
+    TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f4 ) );
+
+  filter_free ( &fprog );
+}
+
+static void
+test_filter_loopback ( void )
+{
+  struct config_op co = { .proto = TCP | UDP, .loopback = true };
+  struct sock_fprog fprog;
+  uint32_t lo = if_nametoindex ( "lo" );
+
+  TEST_ASSERT_TRUE ( filter_build ( &fprog, &co, LINK_ANY ) );
+
+  // only the copy sent is passed
+  struct frame4 f4 = frame4 ( "127.0.0.1", "127.0.0.1", IPPROTO_TCP, 15001 );
+  pkttype = PACKET_OUTGOING;
+  TEST_ASSERT_EQUAL_UINT32 (
+          SNAPLEN_ALL, run ( &fprog, ( uint8_t * ) &f4, sizeof ( f4 ), lo ) );
+
+  pkttype = PACKET_HOST;
+  TEST_ASSERT_EQUAL_UINT32 (
+          0, run ( &fprog, ( uint8_t * ) &f4, sizeof ( f4 ), lo ) );
+
+  struct frame6 f6 = frame6 ( "::1", "::1", 53 );
+  pkttype = PACKET_OUTGOING;
+  TEST_ASSERT_EQUAL_UINT32 (
+          SNAPLEN_ALL, run ( &fprog, ( uint8_t * ) &f6, sizeof ( f6 ), lo ) );
+
+  // received of others interfaces are passed
+  pkttype = PACKET_HOST;
+  f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, RUN ( &fprog, f4 ) );
+
+  filter_free ( &fprog );
+}
+
+static void
+test_filter_outgoing ( void )
+{
+  struct config_op co = { .proto = TCP | UDP, .xdp = true };
+  struct sock_fprog fprog;
+
+  TEST_ASSERT_TRUE ( filter_build ( &fprog, &co, LINK_ETHER ) );
+
+  // received are read by XDP
+  struct frame4 f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  pkttype = PACKET_OUTGOING;
+  TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, RUN ( &fprog, f4 ) );
+
+  pkttype = PACKET_HOST;
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &fprog, f4 ) );
+
+  filter_free ( &fprog );
+
+  // same exclusions of program, to records of XDP
+  struct filter_excludes ex = { 0 };
+  struct tuple tuple = { .family = AF_INET, .l4.local_port = 443 };
+
+  TEST_ASSERT_TRUE ( filter_exclude_add ( &ex, EXCLUDE_NET, "10.1.0.0/16" ) );
+  TEST_ASSERT_TRUE ( filter_exclude_add ( &ex, EXCLUDE_NET, "fd00::/8" ) );
+  TEST_ASSERT_TRUE ( filter_exclude_add ( &ex, EXCLUDE_PORT, "873" ) );
+  ex.ifindex[ex.total_ifaces++] = 7;
+
+  inet_pton ( AF_INET, "192.168.0.1", &tuple.l3.local );
+  inet_pton ( AF_INET, "10.2.0.1", &tuple.l3.remote );
+  TEST_ASSERT_FALSE ( filter_excluded ( &ex, &tuple, 2 ) );
+  TEST_ASSERT_TRUE ( filter_excluded ( &ex, &tuple, 7 ) );
+
+  inet_pton ( AF_INET, "10.1.200.1", &tuple.l3.remote );
+  TEST_ASSERT_TRUE ( filter_excluded ( &ex, &tuple, 2 ) );
+
+  inet_pton ( AF_INET, "10.2.0.1", &tuple.l3.remote );
+  tuple.l4.remote_port = 873;
+  TEST_ASSERT_TRUE ( filter_excluded ( &ex, &tuple, 2 ) );
+
+  tuple = ( struct tuple ){ .family = AF_INET6 };
+  inet_pton ( AF_INET6, "fd00::2", &tuple.l3.local );
+  inet_pton ( AF_INET6, "2001:db8::1", &tuple.l3.remote );
+  TEST_ASSERT_TRUE ( filter_excluded ( &ex, &tuple, 2 ) );
+
+  inet_pton ( AF_INET6, "fe00::2", &tuple.l3.local );
+  TEST_ASSERT_FALSE ( filter_excluded ( &ex, &tuple, 2 ) );
+}
+
+static void
+test_filter_links ( void )
+{
+  struct config_op co = { .proto = TCP | UDP };
+  struct sock_fprog ether, raw, any;
+  uint8_t buff[128];
+  size_t len;
+
+  TEST_ASSERT_TRUE ( filter_exclude_add ( &co.excludes, EXCLUDE_PORT, "873" ) );
+  TEST_ASSERT_TRUE (
+          filter_exclude_add ( &co.excludes, EXCLUDE_NET, "10.1.0.0/16" ) );
+
+  TEST_ASSERT_TRUE ( filter_build ( &ether, &co, LINK_ETHER ) );
+  TEST_ASSERT_TRUE ( filter_build ( &raw, &co, LINK_RAW ) );
+  TEST_ASSERT_TRUE ( filter_build ( &any, &co, LINK_ANY ) );
+
+  struct frame4 f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  struct frame6 f6 = frame6 ( "fd00::2", "2001:db8::1", 53 );
+
+  // 802.1Q and QinQ, in ethernet and in all interfaces
+  for ( unsigned int tags = 0; tags <= MAX_VLAN_TAGS; tags++ )
+    {
+      len = tagged ( buff, &f4, sizeof ( f4 ), tags );
+      TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, run ( &ether, buff, len, 2 ) );
+      TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, run ( &any, buff, len, 2 ) );
+
+      len = tagged ( buff, &f6, sizeof ( f6 ), tags );
+      TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, run ( &ether, buff, len, 2 ) );
+      TEST_ASSERT_EQUAL_UINT32 ( SNAPLEN_ALL, run ( &any, buff, len, 2 ) );
+    }
+
+  // exclusions by offset of tags
+  f4 = frame4 ( "10.0.0.1", "10.1.0.9", IPPROTO_TCP, 443 );
+  len = tagged ( buff, &f4, sizeof ( f4 ), 2 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, run ( &ether, buff, len, 2 ) );
+
+  f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_UDP, 873 );
+  len = tagged ( buff, &f4, sizeof ( f4 ), 1 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, run ( &ether, buff, len, 2 ) );
+
+  f6 = frame6 ( "fd00::2", "2001:db8::1", 873 );
+  len = tagged ( buff, &f6, sizeof ( f6 ), 2 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, run ( &ether, buff, len, 2 ) );
+
+  // a third tag is not followed
+  f4 = frame4 ( "10.0.0.1", "8.8.8.8", IPPROTO_TCP, 443 );
+  len = tagged ( buff, &f4, sizeof ( f4 ), 3 );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, run ( &ether, buff, len, 2 ) );
+
+  // frames started by ip, without the ethernet in 'raw'
+  const uint8_t *l3 = ( const uint8_t * ) &f4 + OFF_ETH;
+  TEST_ASSERT_EQUAL_UINT32 (
+          SNAPLEN_ALL, run ( &raw, l3, sizeof ( f4 ) - OFF_ETH, 2 ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, RUN ( &raw, f4 ) );
+  TEST_ASSERT_EQUAL_UINT32 (
+          0, run ( &ether, l3, sizeof ( f4 ) - OFF_ETH, 2 ) );
+
+  // program of a link is smaller that of all links
+  TEST_ASSERT_LESS_THAN_UINT ( any.len, ether.len );
+  TEST_ASSERT_LESS_THAN_UINT ( any.len, raw.len );
+
+  filter_free ( &ether );
+  filter_free ( &raw );
+  filter_free ( &any );
+}
+
+void
+test_filter ( void )
+{
+  test_filter_default ();
+  test_filter_excludes ();
+  test_filter_sample ();
+  test_filter_loopback ();
+  test_filter_outgoing ();
+  test_filter_links ();
+  test_filter_file ();
+}
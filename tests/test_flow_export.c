@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "unity.h"
+#include "config.h"
+#include "connection.h"
+#include "processes.h"
+#include "intern.h"
+#include "rate.h"
+#include "flow_export.h"
+
+#define PATH_FLOWS "/tmp/netproc_test.flows"
+
+static const uint8_t *
+get_varint ( const uint8_t *p, uint64_t *value )
+{
+  unsigned int shift = 0;
+
+  *value = 0;
+  do
+    {
+      *value |= ( uint64_t ) ( *p & 0x7f ) << shift;
+      shift += 7;
+    }
+  while ( *p++ & 0x80 );
+
+  return p;
+}
+
+void
+test_flow_export ( void )
+{
+  struct config_op co = { .refresh = 1000,
+                          .rate_windows = { 5 },
+                          .total_rate_windows = 1,
+                          .flow_file = PATH_FLOWS };
+  rate_init ( &co );
+
+  const char *name = intern ( "curl", 4 );
+  process_t proc = { .pid = 42, .name = name };
+  connection_t conn = { .tuple = { .family = AF_INET,
+                                   .l4 = { .local_port = 40000,
+                                           .remote_port = 443,
+                                           .protocol = IPPROTO_TCP } },
+                        .start = 1000,
+                        .if_index = 2 };
+  conn.tuple.l3.local.ip = htonl ( 0x0a000001 );
+  conn.tuple.l3.remote.ip = htonl ( 0x0a000002 );
+
+  TEST_ASSERT_TRUE ( flow_export_init ( &co ) );
+
+  // without traffic, not exported
+  flow_export_add ( &conn );
+
+  rate_add_rx_n ( &conn.net_stat, 3000, 3, 1001 );
+  rate_add_tx_n ( &conn.net_stat, 500, 1, 1002 );
+
+  // process closed, the owner is kept by connection
+  conn.owner_name = name;
+  conn.owner_pid = proc.pid;
+  flow_export_add ( &conn );
+  flow_export_free ();
+
+  uint8_t buf[FLOW_MESSAGE_MAX];
+  FILE *file = fopen ( PATH_FLOWS, "r" );
+  TEST_ASSERT_NOT_NULL ( file );
+  size_t len = fread ( buf, 1, sizeof buf, file );
+  fclose ( file );
+
+  TEST_ASSERT_GREATER_THAN ( FLOW_HEADER_SIZE, len );
+  TEST_ASSERT_EQUAL_MEMORY ( FLOW_MAGIC, buf, FLOW_MAGIC_SIZE );
+  TEST_ASSERT_EQUAL_UINT8 ( 1, buf[FLOW_MAGIC_SIZE + 5] );  // records
+
+  const uint8_t *p = buf + FLOW_HEADER_SIZE;
+  TEST_ASSERT_EQUAL_UINT8 ( 4, p[0] );
+  TEST_ASSERT_EQUAL_UINT8 ( IPPROTO_TCP, p[1] );
+  TEST_ASSERT_EQUAL_MEMORY ( &conn.tuple.l3.local.ip, p + 2, 4 );
+  TEST_ASSERT_EQUAL_UINT8 ( 443 & 0xff, p[2 + 4 + 2 + 4 + 1] );
+  p += 2 + 2 * ( 4 + 2 );
+
+  uint64_t v[4];
+  p = get_varint ( p, &v[0] );  // interface
+  p = get_varint ( p, &v[1] );  // pid
+  p = get_varint ( p, &v[2] );  // length of name
+  TEST_ASSERT_EQUAL_UINT ( 2, v[0] );
+  TEST_ASSERT_EQUAL_UINT ( 42, v[1] );
+  TEST_ASSERT_EQUAL_UINT ( 4, v[2] );
+  TEST_ASSERT_EQUAL_MEMORY ( "curl", p, 4 );
+  p += 4;
+
+  p = get_varint ( p, &v[0] );
+  p = get_varint ( p, &v[1] );
+  TEST_ASSERT_EQUAL_UINT ( 1000 * 1000, v[0] );
+  TEST_ASSERT_EQUAL_UINT ( 1002 * 1000, v[1] );
+
+  for ( unsigned int i = 0; i < 4; i++ )
+    p = get_varint ( p, &v[i] );
+
+  TEST_ASSERT_EQUAL_UINT ( 3000, v[0] );
+  TEST_ASSERT_EQUAL_UINT ( 500, v[1] );
+  TEST_ASSERT_EQUAL_UINT ( 3, v[2] );
+  TEST_ASSERT_EQUAL_UINT ( 1, v[3] );
+  TEST_ASSERT_EQUAL_PTR ( buf + len, p );
+
+  rate_net_stat_free ( &conn.net_stat );
+  intern_put ( name );
+  rate_free ();
+  remove ( PATH_FLOWS );
+}
@@ -3,7 +3,8 @@
 #include <sys/types.h>  // open
 #include <sys/stat.h>
 #include <fcntl.h>
-#include <unistd.h>  // close
+#include <string.h>  // memset
+#include <unistd.h>  // close, pipe
 
 #include "unity.h"
 #include "full_read.h"
@@ -31,3 +32,27 @@ test_full_read ( void )
 
   free ( buff );
 }
+
+// long as cmdline of java with classpath, read in a arena
+void
+test_full_read_arena ( void )
+{
+  static char data[40000];
+  memset ( data, 'j', sizeof data );
+
+  int fds[2];
+  TEST_ASSERT_EQUAL_INT ( 0, pipe ( fds ) );
+  TEST_ASSERT_EQUAL_INT ( sizeof data, write ( fds[1], data, sizeof data ) );
+  close ( fds[1] );
+
+  struct arena arena = ARENA_INITIALIZER;
+  char *buff;
+  TEST_ASSERT_EQUAL_INT ( sizeof data,
+                          full_read_arena ( fds[0], &buff, &arena ) );
+  close ( fds[0] );
+
+  TEST_ASSERT_EQUAL_MEMORY ( data, buff, sizeof data );
+  TEST_ASSERT_EQUAL_CHAR ( '\0', buff[sizeof data] );
+
+  arena_free ( &arena );
+}
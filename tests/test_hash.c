@@ -0,0 +1,61 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "unity.h"
+#include "hash.h"
+
+#define BUCKETS 1024
+#define TOTAL ( BUCKETS * 4 )
+
+// keys sequential, as inodes, fall in buckets nearly uniform
+static void
+check_spread ( void )
+{
+  static unsigned int buckets[BUCKETS];
+  memset ( buckets, 0, sizeof ( buckets ) );
+
+  for ( uint64_t i = 0; i < TOTAL; i++ )
+    buckets[hash_u64 ( 1000 + i ) & ( BUCKETS - 1 )]++;
+
+  unsigned int max = 0;
+  for ( size_t i = 0; i < BUCKETS; i++ )
+    if ( buckets[i] > max )
+      max = buckets[i];
+
+  TEST_ASSERT_LESS_THAN ( 16, max );
+
+  // ipv4 tuple with only one port different
+  memset ( buckets, 0, sizeof ( buckets ) );
+  for ( uint64_t port = 0; port < TOTAL; port++ )
+    {
+      const uint64_t key[] = { 0x0a0000010a000002ULL, port << 48 | 6 };
+      buckets[hash_words ( key, 2 ) & ( BUCKETS - 1 )]++;
+    }
+
+  max = 0;
+  for ( size_t i = 0; i < BUCKETS; i++ )
+    if ( buckets[i] > max )
+      max = buckets[i];
+
+  TEST_ASSERT_LESS_THAN ( 16, max );
+
+  const uint64_t key1[] = { 1, 2 };
+  const uint64_t key2[] = { 2, 1 };
+  TEST_ASSERT_EQUAL_UINT32 ( hash_words ( key1, 2 ), hash_words ( key1, 2 ) );
+  TEST_ASSERT_NOT_EQUAL ( hash_words ( key1, 2 ), hash_words ( key2, 2 ) );
+}
+
+void
+test_hash ( void )
+{
+  // portable implementation
+  hash_crc32c = false;
+  check_spread ();
+
+  // CRC32C in hardware, if supported
+  hash_init ();
+  if ( hash_crc32c )
+    check_spread ();
+
+  hash_crc32c = false;
+}
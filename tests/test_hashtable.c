@@ -123,9 +123,57 @@ test_hashtable_foreach_safe ( void )
   hashtable_destroy ( ht );
 }
 
+// entries keep reachable while buckets are moved between arrays
+static void
+test_hashtable_incremental_rehash ( void )
+{
+  hashtable_t *ht = hashtable_new ( cb_hash, cb_compare, NULL );
+  TEST_ASSERT_NOT_NULL ( ht );
+
+  hashtable_set_min_size ( ht, 100 );
+
+  const int total = 5000;
+  int i, j;
+  for ( i = 1; i <= total; i++ )
+    {
+      TEST_ASSERT_NOT_NULL ( hashtable_set ( ht, TO_PTR ( i ), TO_PTR ( i ) ) );
+
+      // each insert only move some buckets, check all in the middle of resize
+      if ( i % 97 == 0 )
+        for ( j = 1; j <= i; j++ )
+          TEST_ASSERT_EQUAL_PTR ( TO_PTR ( j ),
+                                  hashtable_get ( ht, TO_PTR ( j ) ) );
+    }
+
+  TEST_ASSERT_EQUAL_INT ( total, hashtable_get_nentries ( ht ) );
+
+  int count = 0;
+  TEST_ASSERT_EQUAL_INT ( 0, hashtable_foreach ( ht, cb_func, &count ) );
+  TEST_ASSERT_EQUAL_INT ( total, count );
+
+  for ( i = 1; i <= total; i++ )
+    {
+      TEST_ASSERT_EQUAL_PTR ( TO_PTR ( i ),
+                              hashtable_remove ( ht, TO_PTR ( i ) ) );
+
+      if ( i % 89 == 0 )
+        for ( j = i + 1; j <= total; j++ )
+          TEST_ASSERT_EQUAL_PTR ( TO_PTR ( j ),
+                                  hashtable_get ( ht, TO_PTR ( j ) ) );
+    }
+
+  TEST_ASSERT_EQUAL_INT ( 0, hashtable_get_nentries ( ht ) );
+
+  // shrink stop in floor, power of 2 above of 100
+  TEST_ASSERT_EQUAL_INT ( 128, hashtable_get_size ( ht ) );
+
+  hashtable_destroy ( ht );
+}
+
 void
 test_hashtable ( void )
 {
   test1 ();
   test_hashtable_foreach_safe ();
+  test_hashtable_incremental_rehash ();
 }
@@ -7,11 +7,20 @@
 //
 #include <stdlib.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// each connection is in both indexes
+static size_t
+entries ( void )
+{
+  return by_tuple.used + by_inode.used;
+}
 
 static connection_t *
 create_conn_fake ( void )
 {
-  connection_t *conn = calloc ( 1, sizeof *conn );
+  connection_t *conn = pool_calloc ( &conn_pool );
 
   if ( conn )
     {
@@ -20,7 +29,7 @@ create_conn_fake ( void )
       conn->tuple.l3.remote.ip = rand ();
       conn->tuple.l4.local_port = rand () % 0xffff;
       conn->tuple.l4.remote_port = rand () % 0xffff;
-      conn->refs_active = 3;
+      MARK_ACTIVE_CON ( conn );
     }
 
   return conn;
@@ -36,9 +45,9 @@ test_insert ( void )
       connection_t *conn = create_conn_fake ();
       TEST_ASSERT_NOT_NULL ( conn );
 
-      connection_insert ( conn );
+      TEST_ASSERT_TRUE ( connection_insert ( conn ) );
       TEST_ASSERT_EQUAL_INT ( 2 * ( i + 1 ),
-                              hashtable_get_nentries ( ht_connections ) );
+                              entries () );
     }
 }
 
@@ -54,7 +63,7 @@ test_search ( void )
   connection_insert ( conn );
 
   TEST_ASSERT_EQUAL ( 2 * ( NUM_CONN + 1 ),
-                      hashtable_get_nentries ( ht_connections ) );
+                      entries () );
 
   connection_t *tmp;
 
@@ -68,13 +77,13 @@ test_search ( void )
 static void
 test_delete ( void )
 {
-  hashtable_foreach_remove ( ht_connections, remove_inactives_conns, NULL );
+  remove_inactives_conns ();
   TEST_ASSERT_EQUAL ( NUM_CONN * 2 + 2,
-                      hashtable_get_nentries ( ht_connections ) );
+                      entries () );
 
   // removed conns only next update
-  hashtable_foreach_remove ( ht_connections, remove_inactives_conns, NULL );
-  TEST_ASSERT_EQUAL ( 0, hashtable_get_nentries ( ht_connections ) );
+  remove_inactives_conns ();
+  TEST_ASSERT_EQUAL ( 0, entries () );
 }
 
 static void
@@ -83,6 +92,347 @@ test_conn_update ( void )
   TEST_ASSERT_TRUE ( connection_update ( TCP | UDP ) );
 }
 
+static void
+test_parse_address ( void )
+{
+  union inet_all addr = { 0 };
+
+  TEST_ASSERT_TRUE ( parse_address ( "0100007F", 1, &addr ) );
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( 0x7f000001 ), addr.ip );
+
+  // ::1
+  TEST_ASSERT_TRUE (
+          parse_address ( "00000000000000000000000001000000", 4, &addr ) );
+  TEST_ASSERT_TRUE ( IN6_IS_ADDR_LOOPBACK ( &addr.in6 ) );
+
+  TEST_ASSERT_FALSE ( parse_address ( "0100007:", 1, &addr ) );
+  TEST_ASSERT_FALSE ( parse_address ( "0100007g", 1, &addr ) );
+
+  // socket ipv6 with traffic ipv4 (::ffff:10.0.0.1 <-> ::ffff:10.0.0.2)
+  struct tuple tuple = { .family = AF_INET6,
+                         .l4.local_port = 80,
+                         .l4.remote_port = 1025,
+                         .l4.protocol = IPPROTO_TCP };
+  parse_address ( "0000000000000000FFFF00000100000A", 4, &tuple.l3.local );
+  parse_address ( "0000000000000000FFFF00000200000A", 4, &tuple.l3.remote );
+
+  connection_t *conn = create_new_conn ( 1, 0, &tuple, TCP_ESTABLISHED );
+  TEST_ASSERT_NOT_NULL ( conn );
+  TEST_ASSERT_EQUAL_INT ( AF_INET, conn->tuple.family );
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( 0x0a000001 ), conn->tuple.l3.local.ip );
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( 0x0a000002 ), conn->tuple.l3.remote.ip );
+  TEST_ASSERT_EQUAL_HEX32 ( 0, conn->tuple.l3.local.ip6[3] );
+  pool_free ( &conn_pool, conn );
+}
+
+// file of /proc/net/ with lines ignored, uid wide and last line without '\n'
+static void
+test_parse_file ( void )
+{
+  static const char tcp[] =
+          "  sl  local_address rem_address   st tx_queue rx_queue tr "
+          "tm->when retrnsmt   uid  timeout inode\n"
+          "   0: 0100007F:0035 00000000:0000 0A 00000000:00000000 00:00000000 "
+          "00000000     0        0 9001 1 0000000000000000 100 0 0 10 0\n"
+          "   1: 0100000A:0050 0200000A:D431 01 00000000:00000000 00:00000000 "
+          "00000000 4294967294        0 9002 1 0000000000000000 20 4 1 10 -1\n"
+          "   2: 0100000A:0050 0300000A:D432 06 00000000:00000000 03:00000F16 "
+          "00000000     0        0 0 3 0000000000000000\n"
+          "  10: 0100000A:0051 0400000A:01BB 01 00000000:00000000 00:00000000 "
+          "00000000  1000        0 9003 1 0000000000000000 20 4 1 10 -1";
+
+  static const char tcp6[] =
+          "  sl  local_address                         remote_address"
+          "                        st tx_queue rx_queue tr tm->when retrnsmt"
+          "   uid  timeout inode\n"
+          "   0: 000080FE00000000FF005450B6AD1DFE:0016 "
+          "000080FE00000000FF005450B6AD1DFF:C001 01 00000000:00000000 "
+          "00:00000000 00000000     0        0 9004 1 0000000000000000\n";
+
+  char path[] = "/tmp/netproc_tcpXXXXXX";
+
+  int fd = mkstemp ( path );
+  TEST_ASSERT_NOT_EQUAL ( -1, fd );
+  TEST_ASSERT_EQUAL_INT ( sizeof tcp - 1, write ( fd, tcp, sizeof tcp - 1 ) );
+  TEST_ASSERT_EQUAL_INT ( 1, connection_update_ ( path, IPPROTO_TCP, false ) );
+
+  // listen and time wait are ignored
+  TEST_ASSERT_NULL ( connection_get_by_inode ( 9001 ) );
+  TEST_ASSERT_NULL ( connection_get_by_inode ( 0 ) );
+
+  connection_t *conn = connection_get_by_inode ( 9002 );
+  TEST_ASSERT_NOT_NULL ( conn );
+  TEST_ASSERT_EQUAL_INT ( AF_INET, conn->tuple.family );
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( 0x0a000001 ), conn->tuple.l3.local.ip );
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( 0x0a000002 ), conn->tuple.l3.remote.ip );
+  TEST_ASSERT_EQUAL_UINT16 ( 80, conn->tuple.l4.local_port );
+  TEST_ASSERT_EQUAL_UINT16 ( 0xd431, conn->tuple.l4.remote_port );
+
+  conn = connection_get_by_inode ( 9003 );
+  TEST_ASSERT_NOT_NULL ( conn );
+  TEST_ASSERT_EQUAL_UINT16 ( 443, conn->tuple.l4.remote_port );
+
+  TEST_ASSERT_EQUAL_INT ( 0, ftruncate ( fd, 0 ) );
+  TEST_ASSERT_EQUAL_INT ( sizeof tcp6 - 1,
+                          pwrite ( fd, tcp6, sizeof tcp6 - 1, 0 ) );
+  TEST_ASSERT_EQUAL_INT ( 1, connection_update_ ( path, IPPROTO_TCP, false ) );
+
+  conn = connection_get_by_inode ( 9004 );
+  TEST_ASSERT_NOT_NULL ( conn );
+  TEST_ASSERT_EQUAL_INT ( AF_INET6, conn->tuple.family );
+  TEST_ASSERT_EQUAL_UINT16 ( 22, conn->tuple.l4.local_port );
+  TEST_ASSERT_EQUAL_HEX32 ( 0xfe1dadb6, ntohl ( conn->tuple.l3.local.ip6[3] ) );
+  TEST_ASSERT_EQUAL_HEX32 ( 0xff1dadb6,
+                            ntohl ( conn->tuple.l3.remote.ip6[3] ) );
+
+  // line truncated is an error
+  static const char bad[] = "  sl  local_address\n"
+                            "   0: 0100000A:0050 0200000A:D4";
+  TEST_ASSERT_EQUAL_INT ( 0, ftruncate ( fd, 0 ) );
+  TEST_ASSERT_EQUAL_INT ( sizeof bad - 1,
+                          pwrite ( fd, bad, sizeof bad - 1, 0 ) );
+  TEST_ASSERT_EQUAL_INT ( 0, connection_update_ ( path, IPPROTO_TCP, false ) );
+
+  close ( fd );
+  unlink ( path );
+}
+
+static unsigned long
+sock_inode ( int sock )
+{
+  struct stat st;
+
+  TEST_ASSERT_EQUAL_INT ( 0, fstat ( sock, &st ) );
+
+  return st.st_ino;
+}
+
+static uint16_t
+sock_port ( int sock )
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof ( addr );
+
+  TEST_ASSERT_EQUAL_INT (
+          0, getsockname ( sock, ( struct sockaddr * ) &addr, &len ) );
+
+  return ntohs ( addr.sin_port );
+}
+
+/* connection in loopback must be found with the same tuple of packets,
+   the listen socket is ignored */
+static void
+check_loopback ( void )
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET,
+                              .sin_addr.s_addr = htonl ( INADDR_LOOPBACK ) };
+  socklen_t len = sizeof ( addr );
+
+  int server = socket ( AF_INET, SOCK_STREAM, 0 );
+  TEST_ASSERT_NOT_EQUAL ( -1, server );
+  TEST_ASSERT_EQUAL_INT (
+          0, bind ( server, ( struct sockaddr * ) &addr, sizeof ( addr ) ) );
+  TEST_ASSERT_EQUAL_INT ( 0, listen ( server, 1 ) );
+  TEST_ASSERT_EQUAL_INT (
+          0, getsockname ( server, ( struct sockaddr * ) &addr, &len ) );
+
+  int client = socket ( AF_INET, SOCK_STREAM, 0 );
+  TEST_ASSERT_NOT_EQUAL ( -1, client );
+  TEST_ASSERT_EQUAL_INT (
+          0, connect ( client, ( struct sockaddr * ) &addr, sizeof ( addr ) ) );
+
+  TEST_ASSERT_TRUE ( connection_update ( TCP ) );
+
+  TEST_ASSERT_NULL ( connection_get_by_inode ( sock_inode ( server ) ) );
+
+  connection_t *conn = connection_get_by_inode ( sock_inode ( client ) );
+  TEST_ASSERT_NOT_NULL ( conn );
+  TEST_ASSERT_EQUAL_INT ( AF_INET, conn->tuple.family );
+  TEST_ASSERT_EQUAL_INT ( IPPROTO_TCP, conn->tuple.l4.protocol );
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( INADDR_LOOPBACK ),
+                            conn->tuple.l3.local.ip );
+  TEST_ASSERT_EQUAL_HEX32 ( htonl ( INADDR_LOOPBACK ),
+                            conn->tuple.l3.remote.ip );
+  TEST_ASSERT_EQUAL_UINT16 ( sock_port ( client ), conn->tuple.l4.local_port );
+  TEST_ASSERT_EQUAL_UINT16 ( sock_port ( server ),
+                             conn->tuple.l4.remote_port );
+  TEST_ASSERT_EQUAL_PTR ( conn, connection_get_by_tuple ( &conn->tuple ) );
+
+  // exact lookup answer the same socket
+  if ( connection_can_lookup ( &conn->tuple ) )
+    TEST_ASSERT_EQUAL_PTR ( conn, connection_lookup ( &conn->tuple ) );
+
+  close ( client );
+  close ( server );
+}
+
+// same result by sock_diag and by files of /proc
+static void
+test_sources ( void )
+{
+  check_loopback ();
+
+  diag_unsupported = ~0U;
+  check_loopback ();
+  diag_unsupported = 0;
+}
+
+// only the socket of tuple is added, without update of connections
+static void
+test_lookup ( void )
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET,
+                              .sin_addr.s_addr = htonl ( INADDR_LOOPBACK ) };
+  socklen_t len = sizeof ( addr );
+
+  int server = socket ( AF_INET, SOCK_DGRAM, 0 );
+  TEST_ASSERT_NOT_EQUAL ( -1, server );
+  TEST_ASSERT_EQUAL_INT (
+          0, bind ( server, ( struct sockaddr * ) &addr, sizeof ( addr ) ) );
+  TEST_ASSERT_EQUAL_INT (
+          0, getsockname ( server, ( struct sockaddr * ) &addr, &len ) );
+
+  int client = socket ( AF_INET, SOCK_DGRAM, 0 );
+  TEST_ASSERT_NOT_EQUAL ( -1, client );
+  TEST_ASSERT_EQUAL_INT (
+          0, connect ( client, ( struct sockaddr * ) &addr, sizeof ( addr ) ) );
+
+  struct tuple tuple = { .family = AF_INET,
+                         .l3.local.ip = htonl ( INADDR_LOOPBACK ),
+                         .l3.remote.ip = htonl ( INADDR_LOOPBACK ),
+                         .l4.local_port = sock_port ( client ),
+                         .l4.remote_port = sock_port ( server ),
+                         .l4.protocol = IPPROTO_UDP };
+
+  if ( !connection_can_lookup ( &tuple ) )
+    TEST_IGNORE_MESSAGE ( "sock_diag of udp not supported" );
+
+  TEST_ASSERT_NULL ( connection_get_by_tuple ( &tuple ) );
+
+  connection_t *conn = connection_lookup ( &tuple );
+  TEST_ASSERT_NOT_NULL ( conn );
+  TEST_ASSERT_EQUAL_UINT64 ( sock_inode ( client ), conn->inode );
+  TEST_ASSERT_EQUAL_PTR ( conn, connection_get_by_tuple ( &tuple ) );
+
+  close ( client );
+  close ( server );
+
+  TEST_ASSERT_NULL ( connection_lookup ( &tuple ) );
+}
+
+/* unconnected socket is found by local address of packets of any peer,
+   each peer is a sub-flow of socket */
+static void
+test_unconnected ( void )
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET,
+                              .sin_addr.s_addr = htonl ( INADDR_LOOPBACK ) };
+
+  int sock = socket ( AF_INET, SOCK_DGRAM, 0 );
+  TEST_ASSERT_NOT_EQUAL ( -1, sock );
+  TEST_ASSERT_EQUAL_INT (
+          0, bind ( sock, ( struct sockaddr * ) &addr, sizeof ( addr ) ) );
+
+  TEST_ASSERT_TRUE ( connection_update ( UDP ) );
+
+  struct tuple tuple = { .family = AF_INET,
+                         .l3.local.ip = htonl ( INADDR_LOOPBACK ),
+                         .l3.remote.ip = htonl ( 0x0a000001 ),
+                         .l4.local_port = sock_port ( sock ),
+                         .l4.remote_port = 53,
+                         .l4.protocol = IPPROTO_UDP };
+
+  TEST_ASSERT_NULL ( connection_get_by_tuple ( &tuple ) );
+
+  connection_t *parent = connection_get_by_local ( &tuple );
+  TEST_ASSERT_NOT_NULL ( parent );
+  TEST_ASSERT_EQUAL_UINT64 ( sock_inode ( sock ), parent->inode );
+  TEST_ASSERT_NULL ( connection_parent ( parent ) );
+
+  connection_t *sub = connection_new_subflow ( parent, &tuple );
+  TEST_ASSERT_NOT_NULL ( sub );
+  TEST_ASSERT_EQUAL_PTR ( sub, connection_get_by_tuple ( &tuple ) );
+  TEST_ASSERT_EQUAL_PTR ( parent, connection_parent ( sub ) );
+
+  // other port is not of socket
+  tuple.l4.local_port++;
+  TEST_ASSERT_NULL ( connection_get_by_local ( &tuple ) );
+
+  close ( sock );
+}
+
+/* inode of socket closed reused by kernel: other cookie or other tuple is
+   a new connection, the old one not receive traffic of new socket */
+static void
+test_recycled ( void )
+{
+  struct tuple tuple = { .family = AF_INET,
+                         .l3.local.ip = htonl ( 0x0a000001 ),
+                         .l3.remote.ip = htonl ( 0x0a000002 ),
+                         .l4.local_port = 40000,
+                         .l4.remote_port = 443,
+                         .l4.protocol = IPPROTO_TCP };
+
+  TEST_ASSERT_EQUAL_INT (
+          1, connection_seen ( 7001, 1, &tuple, TCP_ESTABLISHED ) );
+  connection_t *first = connection_get_by_inode ( 7001 );
+  TEST_ASSERT_NOT_NULL ( first );
+  TEST_ASSERT_EQUAL_UINT64 ( 1, first->cookie );
+
+  // socket retired while in connections of a process
+  process_t proc = { .conections = vector_new ( sizeof ( connection_t * ) ) };
+  TEST_ASSERT_NOT_NULL ( proc.conections );
+  processes_add_connection ( &proc, first );
+  TEST_ASSERT_EQUAL_PTR ( &proc, first->proc );
+  TEST_ASSERT_EQUAL_UINT32 ( 1, proc.total_members );
+
+  // same socket
+  TEST_ASSERT_EQUAL_INT (
+          1, connection_seen ( 7001, 1, &tuple, TCP_ESTABLISHED ) );
+  TEST_ASSERT_EQUAL_PTR ( first, connection_get_by_inode ( 7001 ) );
+
+  // same inode and tuple, other cookie
+  TEST_ASSERT_EQUAL_INT (
+          1, connection_seen ( 7001, 2, &tuple, TCP_ESTABLISHED ) );
+  connection_t *second = connection_get_by_inode ( 7001 );
+  TEST_ASSERT_NOT_NULL ( second );
+  TEST_ASSERT_NOT_EQUAL ( first, second );
+  TEST_ASSERT_EQUAL_PTR ( second, connection_get_by_tuple ( &tuple ) );
+  TEST_ASSERT_FALSE ( connection_active ( first ) );
+  TEST_ASSERT_EQUAL ( 1, vector_size ( retired ) );
+
+  // without cookie (read of /proc), other tuple
+  tuple.l4.local_port++;
+  TEST_ASSERT_EQUAL_INT (
+          1, connection_seen ( 7001, 0, &tuple, TCP_ESTABLISHED ) );
+  connection_t *third = connection_get_by_inode ( 7001 );
+  TEST_ASSERT_NOT_EQUAL ( second, third );
+  TEST_ASSERT_EQUAL_PTR ( third, connection_get_by_tuple ( &tuple ) );
+
+  // tuple of a socket closed not yet removed, with other inode
+  TEST_ASSERT_EQUAL_INT (
+          1, connection_seen ( 7002, 3, &tuple, TCP_ESTABLISHED ) );
+  connection_t *fourth = connection_get_by_inode ( 7002 );
+  TEST_ASSERT_NOT_NULL ( fourth );
+  TEST_ASSERT_EQUAL_PTR ( fourth, connection_get_by_tuple ( &tuple ) );
+  TEST_ASSERT_NULL ( connection_get_by_inode ( 7001 ) );
+  TEST_ASSERT_EQUAL ( 3, vector_size ( retired ) );
+
+  // retired are freed in next update
+  remove_inactives_conns ();
+  TEST_ASSERT_EQUAL ( 0, vector_size ( retired ) );
+
+  // and leave your process
+  TEST_ASSERT_NULL ( proc.conns );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, proc.total_members );
+  TEST_ASSERT_TRUE ( proc.conns_changed );
+  vector_free ( proc.conections );
+  TEST_ASSERT_EQUAL_PTR ( fourth, connection_get_by_inode ( 7002 ) );
+
+  remove_inactives_conns ();
+  TEST_ASSERT_NULL ( connection_get_by_inode ( 7002 ) );
+}
+
 void
 test_ht_conn ( void )
 {
@@ -95,12 +445,19 @@ test_ht_conn ( void )
   test_delete ();
 
   test_conn_update ();
-  size_t hold = hashtable_get_nentries ( ht_connections );
-  hashtable_foreach_remove ( ht_connections, remove_inactives_conns, NULL );
-  TEST_ASSERT_EQUAL ( hold, hashtable_get_nentries ( ht_connections ) );
+  test_parse_address ();
+  test_parse_file ();
+  size_t hold = entries ();
+  remove_inactives_conns ();
+  TEST_ASSERT_EQUAL ( hold, entries () );
+
+  remove_inactives_conns ();
+  TEST_ASSERT_EQUAL ( 0, entries () );
 
-  hashtable_foreach_remove ( ht_connections, remove_inactives_conns, NULL );
-  TEST_ASSERT_EQUAL ( 0, hashtable_get_nentries ( ht_connections ) );
+  test_sources ();
+  test_lookup ();
+  test_unconnected ();
+  test_recycled ();
 
   connection_free ();
 }
@@ -0,0 +1,72 @@
+
+/*
+ *  Copyright (C) 2025 Mayco S. Berghetti
+ *
+ *  This file is part of Netproc.
+ *
+ *  Netproc is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include "unity.h"
+#include "hugemem.h"
+#include "pool.h"
+
+#define TOTAL 100000
+
+void
+test_hugemem ( void )
+{
+  // disabled, all of malloc
+  TEST_ASSERT_FALSE ( hugemem_enabled () );
+  TEST_ASSERT_FALSE ( hugemem_is_huge ( 3 * HUGEMEM_PAGE ) );
+
+  hugemem_init ( true );
+
+  // small blocks not worth a huge page
+  uint8_t *small = hugemem_calloc ( 1024, 4 );
+  TEST_ASSERT_NOT_NULL ( small );
+  TEST_ASSERT_EQUAL_UINT ( 0, hugemem_bytes () );
+
+  // rounded to huge pages, aligned and zeroed
+  size_t size = HUGEMEM_PAGE + HUGEMEM_PAGE / 2;
+  uint8_t *big = hugemem_calloc ( size, 1 );
+  TEST_ASSERT_NOT_NULL ( big );
+  TEST_ASSERT_EQUAL_UINT ( 0, ( uintptr_t ) big % HUGEMEM_PAGE );
+  TEST_ASSERT_EQUAL_UINT ( 2 * HUGEMEM_PAGE, hugemem_bytes () );
+  TEST_ASSERT_EQUAL_UINT8 ( 0, big[0] | big[size - 1] );
+  big[0] = big[size - 1] = 1;
+
+  hugemem_free ( small, 1024, 4 );
+  hugemem_free ( big, size, 1 );
+  TEST_ASSERT_EQUAL_UINT ( 0, hugemem_bytes () );
+
+  // slabs of pool double up to a huge page
+  struct pool pool;
+  pool_init ( &pool, "test", 64, 64 );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    TEST_ASSERT_NOT_NULL ( pool_alloc ( &pool ) );
+
+  TEST_ASSERT_LESS_THAN_UINT ( 16, pool.total_slabs );
+  TEST_ASSERT_GREATER_OR_EQUAL ( TOTAL * 64, pool_memory ( &pool ) );
+  TEST_ASSERT_GREATER_THAN_UINT ( 0, hugemem_bytes () );
+
+  pool_destroy ( &pool );
+  TEST_ASSERT_EQUAL_UINT ( 0, pool_memory ( &pool ) );
+  TEST_ASSERT_EQUAL_UINT ( 0, hugemem_bytes () );
+
+  hugemem_init ( false );
+}
@@ -0,0 +1,51 @@
+#include <string.h>
+
+#include "unity.h"
+#include "intern.h"
+
+void
+test_intern ( void )
+{
+  const char cmd[] = "/usr/sbin/php-fpm --nodaemonize";
+
+  const char *a = intern ( cmd, strlen ( cmd ) );
+  TEST_ASSERT_NOT_NULL ( a );
+  TEST_ASSERT_EQUAL_STRING ( cmd, a );
+  TEST_ASSERT_EQUAL_UINT ( 1, intern_total () );
+
+  // same string is the same pointer
+  char copy[sizeof cmd];
+  memcpy ( copy, cmd, sizeof cmd );
+  const char *b = intern ( copy, strlen ( copy ) );
+  TEST_ASSERT_EQUAL_PTR ( a, b );
+  TEST_ASSERT_EQUAL_UINT ( 1, intern_total () );
+
+  TEST_ASSERT_EQUAL_UINT ( strlen ( cmd ), intern_len ( a ) );
+  TEST_ASSERT_EQUAL_UINT ( strlen ( "/usr/sbin/php-fpm" ),
+                           intern_prog_len ( a ) );
+  TEST_ASSERT_EQUAL_STRING ( "php-fpm --nodaemonize", a + intern_base ( a ) );
+
+  // prefix of other string is other string
+  const char *prog = intern ( cmd, intern_prog_len ( a ) );
+  TEST_ASSERT_NOT_EQUAL ( a, prog );
+  TEST_ASSERT_EQUAL_STRING ( "/usr/sbin/php-fpm", prog );
+  TEST_ASSERT_EQUAL_UINT ( 2, intern_total () );
+
+  // without '/', program start in 0
+  const char *bare = intern ( "bash", 4 );
+  TEST_ASSERT_EQUAL_UINT ( 0, intern_base ( bare ) );
+  TEST_ASSERT_EQUAL_UINT ( 4, intern_prog_len ( bare ) );
+  TEST_ASSERT_EQUAL_PTR ( bare, intern_ref ( bare ) );
+
+  intern_put ( bare );
+  TEST_ASSERT_EQUAL_UINT ( 3, intern_total () );
+  intern_put ( bare );
+  TEST_ASSERT_EQUAL_UINT ( 2, intern_total () );
+
+  // freed only with last reference
+  intern_put ( a );
+  TEST_ASSERT_EQUAL_STRING ( cmd, b );
+  intern_put ( b );
+  intern_put ( prog );
+  TEST_ASSERT_EQUAL_UINT ( 0, intern_total () );
+}
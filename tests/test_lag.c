@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <time.h>
+
+#include "unity.h"
+#include "lag.h"
+
+static void
+test_percentile ( void )
+{
+  struct lag_histogram hist = { 0 };
+
+  TEST_ASSERT_EQUAL_UINT64 ( 0, lag_percentile ( &hist, 50 ) );
+
+  // 90 values below of 2^2 us, 10 below of 2^10 us
+  hist.counts[2] = 90;
+  hist.counts[10] = 10;
+  hist.max_us = 700;
+
+  TEST_ASSERT_EQUAL_UINT64 ( 4, lag_percentile ( &hist, 50 ) );
+  TEST_ASSERT_EQUAL_UINT64 ( 4, lag_percentile ( &hist, 90 ) );
+
+  // bound of bucket limited by max
+  TEST_ASSERT_EQUAL_UINT64 ( 700, lag_percentile ( &hist, 99 ) );
+
+  // last bucket is of values above of all bounds
+  hist.counts[LAG_BUCKETS - 1] = 100;
+  hist.max_us = 1ULL << 40;
+  TEST_ASSERT_EQUAL_UINT64 ( 1ULL << 40, lag_percentile ( &hist, 99 ) );
+}
+
+static void
+test_block ( void )
+{
+  struct timespec ts;
+  clock_gettime ( CLOCK_REALTIME, &ts );
+
+  struct lag_histogram before;
+  lag_histogram ( LAG_CAPTURE, &before );
+
+  // block of 2 seconds ago and of future (clock changed back)
+  lag_block ( ts.tv_sec - 2, ts.tv_nsec );
+  lag_block ( ts.tv_sec + 60, 0 );
+
+  struct lag_histogram after;
+  lag_histogram ( LAG_CAPTURE, &after );
+
+  TEST_ASSERT_EQUAL_UINT64 ( before.count + 2, after.count );
+  TEST_ASSERT_EQUAL_UINT64 ( before.counts[0] + 1, after.counts[0] );
+  TEST_ASSERT_EQUAL_UINT64 ( before.counts[21] + 1, after.counts[21] );
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT64 ( 2000000, after.max_us );
+
+  lag_refresh ();
+  const struct lag_stats *last = lag_last ( LAG_CAPTURE );
+  TEST_ASSERT_EQUAL_UINT64 ( 2, last->count );
+  TEST_ASSERT_EQUAL_UINT64 ( 1, last->p50_us );
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT64 ( 2000000, last->p99_us );
+  TEST_ASSERT_EQUAL_UINT64 ( last->p99_us, last->max_us );
+
+  // interval without blocks
+  lag_refresh ();
+  TEST_ASSERT_EQUAL_UINT64 ( 0, last->count );
+  TEST_ASSERT_EQUAL_UINT64 ( 0, last->max_us );
+}
+
+void
+test_lag ( void )
+{
+  test_percentile ();
+  test_block ();
+}
@@ -0,0 +1,69 @@
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#include "unity.h"
+#include "lpm.h"
+
+static void
+add ( struct lpm *lpm, int family, const char *addr, unsigned bits, uint32_t v )
+{
+  uint8_t buf[16] = { 0 };
+
+  TEST_ASSERT_EQUAL_INT ( 1, inet_pton ( family, addr, buf ) );
+  TEST_ASSERT_TRUE ( lpm_add ( lpm, buf, bits, v ) );
+}
+
+static uint32_t
+lookup ( const struct lpm *lpm, int family, const char *addr )
+{
+  uint8_t buf[16] = { 0 };
+
+  TEST_ASSERT_EQUAL_INT ( 1, inet_pton ( family, addr, buf ) );
+  return lpm_lookup ( lpm, buf, ( family == AF_INET ) ? 4 : 16 );
+}
+
+void
+test_lpm ( void )
+{
+  struct lpm lpm4, lpm6;
+
+  TEST_ASSERT_TRUE ( lpm_init ( &lpm4 ) );
+  TEST_ASSERT_TRUE ( lpm_init ( &lpm6 ) );
+
+  TEST_ASSERT_EQUAL_UINT32 ( 0, lookup ( &lpm4, AF_INET, "10.1.2.3" ) );
+
+  // from shortest to longest
+  add ( &lpm4, AF_INET, "0.0.0.0", 0, 1 );
+  add ( &lpm4, AF_INET, "10.0.0.0", 8, 2 );
+  add ( &lpm4, AF_INET, "10.1.0.0", 15, 3 );
+  add ( &lpm4, AF_INET, "10.1.2.0", 24, 4 );
+  add ( &lpm4, AF_INET, "10.1.2.128", 25, 5 );
+  add ( &lpm4, AF_INET, "10.1.2.200", 32, 6 );
+
+  TEST_ASSERT_EQUAL_UINT32 ( 1, lookup ( &lpm4, AF_INET, "192.0.2.1" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 2, lookup ( &lpm4, AF_INET, "10.200.0.1" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 3, lookup ( &lpm4, AF_INET, "10.1.9.9" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 4, lookup ( &lpm4, AF_INET, "10.1.2.3" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 5, lookup ( &lpm4, AF_INET, "10.1.2.129" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 6, lookup ( &lpm4, AF_INET, "10.1.2.200" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 5, lookup ( &lpm4, AF_INET, "10.1.2.201" ) );
+
+  // /15 takes 10.0.0.0/15 too, outside of 10.1.0.0, is of /8
+  TEST_ASSERT_EQUAL_UINT32 ( 3, lookup ( &lpm4, AF_INET, "10.0.0.1" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 2, lookup ( &lpm4, AF_INET, "10.2.0.1" ) );
+
+  add ( &lpm6, AF_INET6, "2001:db8::", 32, 7 );
+  add ( &lpm6, AF_INET6, "2001:db8:1::", 48, 8 );
+  add ( &lpm6, AF_INET6, "2001:db8:1::1", 128, 9 );
+
+  TEST_ASSERT_EQUAL_UINT32 ( 0, lookup ( &lpm6, AF_INET6, "fd00::1" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 7, lookup ( &lpm6, AF_INET6, "2001:db8:2::1" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 8, lookup ( &lpm6, AF_INET6, "2001:db8:1::2" ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 9, lookup ( &lpm6, AF_INET6, "2001:db8:1::1" ) );
+
+  TEST_ASSERT_GREATER_THAN ( 0, lpm_memory ( &lpm4 ) );
+
+  lpm_free ( &lpm4 );
+  lpm_free ( &lpm6 );
+  TEST_ASSERT_EQUAL_UINT ( 0, lpm_memory ( &lpm4 ) );
+}
@@ -0,0 +1,62 @@
+#include <stdbool.h>
+
+#include "unity.h"
+#include "overload.h"
+
+static void
+calm ( unsigned int refreshes, bool hold )
+{
+  while ( refreshes-- )
+    overload_update ( 0, false, hold );
+}
+
+void
+test_overload ( void )
+{
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_NONE, overload_update ( 0, false, false ) );
+  TEST_ASSERT_TRUE ( overload_redraw () );
+
+  // a level by refresh with pressure, drops or late
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_CONNECTIONS,
+                          overload_update ( 10, false, false ) );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_REDRAW, overload_update ( 0, true, false ) );
+  TEST_ASSERT_EQUAL_STRING ( "redraw", overload_name ( overload_level () ) );
+
+  // screen redrawn once by OVERLOAD_REDRAW_EVERY refreshes
+  unsigned int redraws = 0;
+  for ( int i = 0; i < OVERLOAD_REDRAW_EVERY * 3; i++ )
+    redraws += overload_redraw ();
+  TEST_ASSERT_EQUAL_UINT ( 3, redraws );
+
+  overload_update ( 1, false, false );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_SAMPLE, overload_update ( 1, false, false ) );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_SAMPLE, overload_update ( 1, true, false ) );
+
+  // with sample above of user, the level is kept
+  calm ( OVERLOAD_CALM * 2, true );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_SAMPLE, overload_level () );
+
+  // a level restored after OVERLOAD_CALM refreshes without pressure
+  calm ( OVERLOAD_CALM - 1, false );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_SAMPLE, overload_level () );
+  calm ( 1, false );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_NAMES, overload_level () );
+
+  // pressure restart the count
+  calm ( OVERLOAD_CALM - 1, false );
+  overload_update ( 1, false, false );
+  calm ( OVERLOAD_CALM - 1, false );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_SAMPLE, overload_level () );
+
+  // without ring, sample is not reached
+  overload_limit ( OVERLOAD_NAMES );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_NAMES, overload_level () );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_NAMES, overload_update ( 1, true, false ) );
+
+  calm ( OVERLOAD_CALM * 3, false );
+  TEST_ASSERT_EQUAL_INT ( OVERLOAD_NONE, overload_level () );
+  TEST_ASSERT_TRUE ( overload_redraw () );
+  TEST_ASSERT_EQUAL_STRING ( "", overload_name ( overload_level () ) );
+
+  overload_limit ( OVERLOAD_SAMPLE );
+}
@@ -1,16 +1,20 @@
 
 #include <stdio.h>
 #include <unistd.h>  // sleep
+#include <stddef.h>  // offsetof
 
 #include "unity.h"
 #include "../src/packet.c"
 
+// capacity of table of fragments
+#define FRAGMENTS_TEST 8
+
 static void
 test_dont_fragment ( void )
 {
   struct iphdr ip = { .frag_off = htons ( IP_DF ) };
 
-  TEST_ASSERT_EQUAL_INT ( -1, get_fragment ( &ip, NULL ) );
+  TEST_ASSERT_EQUAL_INT ( 0, get_fragment ( &ip, NULL, NULL, NULL ) );
 }
 
 struct pkt
@@ -22,89 +26,324 @@ struct pkt
 static void
 test_more_fragment ( void )
 {
+  uint16_t source = 0, dest = 0;
   int ret;
 
   struct pkt pkt_1 = { .l3 = { .frag_off = htons ( IP_MF ),
                                .id = 1,
+                               .protocol = IPPROTO_UDP,
                                .saddr = 0x01010101,
                                .daddr = 0x02020202 },
                        .l4 = { .source = 1025, .dest = 80 } };
 
-  ret = get_fragment ( &pkt_1.l3, &pkt_1.l4 );  // should be first frag
-  TEST_ASSERT_EQUAL_INT ( 0, ret );  // first position array pkt_ip_frag
-
-  // test else if in get_fragment
-  pkt_1.l3.frag_off |= 1;
-  ret = get_fragment (
-          &pkt_1.l3,
-          &pkt_1.l4 );  // now shold be different -1 because is one fragment
-  TEST_ASSERT_EQUAL_INT ( 0, ret );  // first position of array pkt_ip_frag
+  ret = get_fragment ( &pkt_1.l3, &pkt_1.l4, &source, &dest );
+  TEST_ASSERT_EQUAL_INT ( 1, ret );  // first fragment, stored
+  TEST_ASSERT_EQUAL_UINT ( 1, frags.used );
 
-  TEST_ASSERT_EQUAL_INT ( pkt_1.l4.source, pkt_ip_frag[ret].source_port );
-  TEST_ASSERT_EQUAL_INT ( pkt_1.l4.dest, pkt_ip_frag[ret].dest_port );
-  TEST_ASSERT_EQUAL_INT ( pkt_1.l3.id, pkt_ip_frag[ret].id );
+  // fragment with offset, ports are of first fragment
+  struct layer_4 payload = { .source = 0xffff, .dest = 0xffff };
+  pkt_1.l3.frag_off |= htons ( 1 );
+  source = dest = 0;
+  ret = get_fragment ( &pkt_1.l3, &payload, &source, &dest );
+  TEST_ASSERT_EQUAL_INT ( 1, ret );
+  TEST_ASSERT_EQUAL_INT ( pkt_1.l4.source, source );
+  TEST_ASSERT_EQUAL_INT ( pkt_1.l4.dest, dest );
 
   struct pkt pkt_2 = {
     .l3 = { .frag_off = htons ( IP_MF ),
             .id = 1,  // same id pkt_1, but address differents
+            .protocol = IPPROTO_UDP,
             .saddr = 0x05050505,
             .daddr = 0x06060606 },
     .l4 = { .source = 1030, .dest = 443 }
   };
 
-  ret = get_fragment ( &pkt_2.l3, &pkt_2.l4 );
-  TEST_ASSERT_EQUAL_INT ( 1, ret );  // second position of array pkt_ip_frag
+  ret = get_fragment ( &pkt_2.l3, &pkt_2.l4, &source, &dest );
+  TEST_ASSERT_EQUAL_INT ( 1, ret );
+  TEST_ASSERT_EQUAL_UINT ( 2, frags.used );
 
-  pkt_2.l3.frag_off |= 1;
-  ret = get_fragment ( &pkt_2.l3, &pkt_1.l4 );
+  // last fragment (without MF) release the entry
+  pkt_2.l3.frag_off = htons ( 1 );
+  ret = get_fragment ( &pkt_2.l3, &payload, &source, &dest );
   TEST_ASSERT_EQUAL_INT ( 1, ret );
+  TEST_ASSERT_EQUAL_INT ( pkt_2.l4.source, source );
+  TEST_ASSERT_EQUAL_INT ( pkt_2.l4.dest, dest );
+  TEST_ASSERT_EQUAL_UINT ( 1, frags.used );
+  TEST_ASSERT_EQUAL_INT ( ERR_FRAGMENT,
+                          get_fragment ( &pkt_2.l3, &payload, &source, &dest ) );
 
-  TEST_ASSERT_EQUAL_INT ( pkt_2.l4.source, pkt_ip_frag[ret].source_port );
-  TEST_ASSERT_EQUAL_INT ( pkt_2.l4.dest, pkt_ip_frag[ret].dest_port );
-  TEST_ASSERT_EQUAL_INT ( pkt_2.l3.id, pkt_ip_frag[ret].id );
+  // same packet of pkt_1 but other protocol
+  pkt_1.l3.protocol = IPPROTO_TCP;
+  TEST_ASSERT_EQUAL_INT ( ERR_FRAGMENT,
+                          get_fragment ( &pkt_1.l3, &payload, &source, &dest ) );
 }
 
 static void
 test_clear_frag ( void )
 {
+  uint16_t source, dest;
   struct pkt pkt = { .l3 = { .frag_off = htons ( IP_MF ),
                              .id = 3,
                              .saddr = 0x01010101,
                              .daddr = 0x02020202 },
                      .l4 = { .source = 1025, .dest = 80 } };
 
-  int ret = get_fragment ( &pkt.l3, &pkt.l4 );
-  TEST_ASSERT_NOT_EQUAL_INT ( -1, ret );  // should be a fragment
+  packet_tick ( 1000 );
+  TEST_ASSERT_EQUAL_INT ( 1, get_fragment ( &pkt.l3, &pkt.l4, &source, &dest ) );
 
   // make a fragment
-  pkt.l3.frag_off |= 1;
-  pkt_ip_frag[ret].ttl -= LIFETIME_FRAG;
-  clear_frag ();  // should remove packet of array of fragments
+  pkt.l3.frag_off |= htons ( 1 );
+
+  // lifetime not expired
+  packet_tick ( 1000 + LIFETIME_FRAG - 1 );
+  TEST_ASSERT_EQUAL_INT ( 1, get_fragment ( &pkt.l3, &pkt.l4, &source, &dest ) );
+
+  // should remove packet of table of fragments
+  packet_tick ( 1000 + LIFETIME_FRAG );
+  TEST_ASSERT_EQUAL_INT ( ERR_FRAGMENT,
+                          get_fragment ( &pkt.l3, &pkt.l4, &source, &dest ) );
+
+  // jump of time greater than the wheel clean all
+  packet_tick ( 5000 );
+  TEST_ASSERT_EQUAL_UINT ( 0, frags.used );
 
   pkt.l3.frag_off = 0;
-  TEST_ASSERT_EQUAL_INT ( -1, get_fragment ( &pkt.l3, &pkt.l4 ) );
+  TEST_ASSERT_EQUAL_INT ( 0, get_fragment ( &pkt.l3, &pkt.l4, &source, &dest ) );
 }
 
 static void
 test_err_fragment ( void )
 {
+  uint16_t source, dest;
   struct pkt pkt = { .l3 = { .frag_off = htons ( IP_MF ),
                              .id = 3,
                              .saddr = 0x01010101,
                              .daddr = 0x02020202 },
                      .l4 = { .source = 1025, .dest = 80 } };
 
-  pkt.l3.frag_off |= 1;  // make this a fragment whith offset diferente de 0
+  pkt.l3.frag_off |= htons ( 1 );  // make this a fragment whith offset != 0
+
+  // is a fragment, but as offset is not 0, not was stored in table
+  TEST_ASSERT_EQUAL_INT ( ERR_FRAGMENT,
+                          get_fragment ( &pkt.l3, &pkt.l4, &source, &dest ) );
+
+  // table full
+  pkt.l3.frag_off = htons ( IP_MF );
+  for ( unsigned int i = frags.used; i < FRAGMENTS_TEST; i++, pkt.l3.id++ )
+    TEST_ASSERT_EQUAL_INT (
+            1, get_fragment ( &pkt.l3, &pkt.l4, &source, &dest ) );
+
+  TEST_ASSERT_EQUAL_INT ( ERR_FRAGMENT,
+                          get_fragment ( &pkt.l3, &pkt.l4, &source, &dest ) );
+}
+
+// frame of ring with a packet ipv6 udp sent by this host
+struct frame6
+{
+  union
+  {
+    struct tpacket3_hdr hdr;
+    uint8_t hdr_space[TPACKET_ALIGN ( TPACKET3_HDRLEN )];
+  };
+  struct ip6_hdr l3;
+  struct layer_4 l4;
+};
+
+static void
+test_parse_ipv6 ( void )
+{
+  struct frame6 frame;
+  memset ( &frame, 0, sizeof ( frame ) );
+
+  struct sockaddr_ll *ll;
+  ll = ( struct sockaddr_ll * ) ( ( uint8_t * ) &frame + TPACKET3_HDRLEN -
+                                  sizeof ( struct sockaddr_ll ) );
+  ll->sll_pkttype = PACKET_OUTGOING;
+  ll->sll_ifindex = 2;
+
+  frame.hdr.tp_net = offsetof ( struct frame6, l3 );
+  frame.hdr.tp_len = 1000;
+  frame.l3.ip6_vfc = 0x60;
+  frame.l3.ip6_nxt = IPPROTO_UDP;
+  frame.l3.ip6_src.s6_addr[0] = 0xfd;
+  frame.l3.ip6_src.s6_addr[15] = 2;
+  frame.l3.ip6_dst.s6_addr[0] = 0x20;
+  frame.l3.ip6_dst.s6_addr[15] = 1;
+  frame.l4.source = htons ( 50000 );
+  frame.l4.dest = htons ( 53 );
+
+  struct packet pkt = { 0 };
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_INT ( AF_INET6, pkt.tuple.family );
+  TEST_ASSERT_EQUAL_INT ( PKT_UPL, pkt.direction );
+  TEST_ASSERT_EQUAL_INT ( 1000, pkt.lenght );
+  TEST_ASSERT_EQUAL_INT ( 50000, pkt.tuple.l4.local_port );
+  TEST_ASSERT_EQUAL_INT ( 53, pkt.tuple.l4.remote_port );
+  TEST_ASSERT_EQUAL_MEMORY (
+          &frame.l3.ip6_src, &pkt.tuple.l3.local, sizeof ( frame.l3.ip6_src ) );
+  TEST_ASSERT_EQUAL_MEMORY ( &frame.l3.ip6_dst,
+                             &pkt.tuple.l3.remote,
+                             sizeof ( frame.l3.ip6_dst ) );
+
+  // received, local and remote are swapped
+  ll->sll_pkttype = PACKET_HOST;
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_INT ( PKT_DOWN, pkt.direction );
+  TEST_ASSERT_EQUAL_INT ( 53, pkt.tuple.l4.local_port );
+  TEST_ASSERT_EQUAL_MEMORY ( &frame.l3.ip6_dst,
+                             &pkt.tuple.l3.local,
+                             sizeof ( frame.l3.ip6_dst ) );
+
+  // extension header is not followed
+  frame.l3.ip6_nxt = IPPROTO_FRAGMENT;
+  TEST_ASSERT_EQUAL_INT ( 0, parse_packet ( &pkt, &frame.hdr ) );
+}
+
+// frame of ring with a packet ipv4 tcp merged by GRO
+struct frame4
+{
+  union
+  {
+    struct tpacket3_hdr hdr;
+    uint8_t hdr_space[TPACKET_ALIGN ( TPACKET3_HDRLEN )];
+  };
+  uint8_t l2[16];  // header of frame, aligned to header ip
+  struct iphdr l3;
+  struct layer_4 l4;
+  uint8_t tcp[28];  // rest of header tcp with options, 32 bytes
+};
+
+static void
+test_segments ( void )
+{
+  struct frame4 frame;
+  memset ( &frame, 0, sizeof ( frame ) );
+
+  struct sockaddr_ll *ll;
+  ll = ( struct sockaddr_ll * ) ( ( uint8_t * ) &frame + TPACKET3_HDRLEN -
+                                  sizeof ( struct sockaddr_ll ) );
+  ll->sll_pkttype = PACKET_HOST;
+  ll->sll_ifindex = 7;
+
+  // MTU of interface without ioctl
+  mtus[7 % MTU_CACHE] = ( struct mtu_entry ){ .if_index = 7, .mtu = 1500 };
+
+  frame.hdr.tp_mac = offsetof ( struct frame4, l2 );
+  frame.hdr.tp_net = offsetof ( struct frame4, l3 );
+  frame.l3.version = 4;
+  frame.l3.ihl = 5;
+  frame.l3.frag_off = htons ( IP_DF );
+  frame.l3.protocol = IPPROTO_TCP;
+  frame.tcp[8] = 8 << 4;  // data offset
+
+  // headers of 52 bytes, mss 1448, 3 segments
+  frame.hdr.tp_len = 16 + 52 + 3 * 1448;
+
+  struct packet pkt = { 0 };
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_UINT ( 3, pkt.segments );
+  TEST_ASSERT_EQUAL_UINT ( 16 + 52 + 3 * 1448 + 2 * ( 16 + 52 ), pkt.lenght );
 
-  // is a fragment, but as offset is not 0, not was stored in buffer
-  TEST_ASSERT_EQUAL_INT ( ERR_FRAGMENT, get_fragment ( &pkt.l3, &pkt.l4 ) );
+  // the last segment is smaller
+  frame.hdr.tp_len = 16 + 52 + 2 * 1448 + 100;
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_UINT ( 3, pkt.segments );
+
+  // up to MTU is a packet of wire
+  frame.hdr.tp_len = 16 + 1500;
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_UINT ( 1, pkt.segments );
+  TEST_ASSERT_EQUAL_UINT ( 16 + 1500, pkt.lenght );
+}
+
+// frame of ring with a packet ipv4 udp with tags 802.1ad and 802.1Q
+struct frame_vlan
+{
+  union
+  {
+    struct tpacket3_hdr hdr;
+    uint8_t hdr_space[TPACKET_ALIGN ( TPACKET3_HDRLEN )];
+  };
+  uint8_t l2[24];  // 2 of padding, macs, 2 tags and ethertype
+  struct iphdr l3;
+  struct layer_4 l4;
+};
+
+static void
+test_parse_links ( void )
+{
+  struct frame_vlan frame;
+  memset ( &frame, 0, sizeof ( frame ) );
+
+  struct sockaddr_ll *ll;
+  ll = ( struct sockaddr_ll * ) ( ( uint8_t * ) &frame + TPACKET3_HDRLEN -
+                                  sizeof ( struct sockaddr_ll ) );
+  ll->sll_pkttype = PACKET_HOST;
+  ll->sll_hatype = ARPHRD_ETHER;
+  ll->sll_protocol = htons ( ETH_P_8021AD );
+
+  frame.l2[14] = 0x88;
+  frame.l2[15] = 0xa8;
+  frame.l2[18] = 0x81;
+  frame.l2[19] = 0x00;
+  frame.l2[22] = 0x08;
+  frame.l2[23] = 0x00;
+  frame.l3.version = 4;
+  frame.l3.ihl = 5;
+  frame.l3.protocol = IPPROTO_UDP;
+  frame.l4.source = htons ( 53 );
+  frame.l4.dest = htons ( 50000 );
+
+  // QinQ, kernel set tp_net in first tag
+  frame.hdr.tp_mac = offsetof ( struct frame_vlan, l2 ) + 2;
+  frame.hdr.tp_net = frame.hdr.tp_mac + 14;
+  frame.hdr.tp_len = 22 + 20 + 8;
+
+  struct packet pkt = { 0 };
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet_ether ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_INT ( 50000, pkt.tuple.l4.local_port );
+  TEST_ASSERT_EQUAL_INT ( 22 + 20 + 8, pkt.lenght );
+
+  // in all interfaces too
+  memset ( &pkt, 0, sizeof ( pkt ) );
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_INT ( 50000, pkt.tuple.l4.local_port );
+
+  // 802.1Q
+  frame.hdr.tp_mac += 4;
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet_ether ( &pkt, &frame.hdr ) );
+
+  // without tags
+  frame.hdr.tp_mac += 4;
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet_ether ( &pkt, &frame.hdr ) );
+
+  // not ip
+  frame.l2[23] = 0x06;
+  TEST_ASSERT_EQUAL_INT ( 0, parse_packet_ether ( &pkt, &frame.hdr ) );
+
+  // tun and cooked, frame started by header ip
+  frame.hdr.tp_mac = frame.hdr.tp_net = offsetof ( struct frame_vlan, l3 );
+  frame.hdr.tp_len = 20 + 8;
+  TEST_ASSERT_EQUAL_INT ( 1, parse_packet_raw ( &pkt, &frame.hdr ) );
+  TEST_ASSERT_EQUAL_INT ( 50000, pkt.tuple.l4.local_port );
+
+  TEST_ASSERT_EQUAL_PTR ( parse_packet_ether, packet_parser ( LINK_ETHER ) );
+  TEST_ASSERT_EQUAL_PTR ( parse_packet_raw, packet_parser ( LINK_RAW ) );
+  TEST_ASSERT_EQUAL_PTR ( parse_packet, packet_parser ( LINK_ANY ) );
 }
 
 void
 test_packet ( void )
 {
+  TEST_ASSERT_TRUE ( packet_init ( FRAGMENTS_TEST ) );
+
   test_dont_fragment ();
   test_more_fragment ();
   test_clear_frag ();
   test_err_fragment ();
+  test_parse_ipv6 ();
+  test_segments ();
+  test_parse_links ();
+
+  packet_free ();
 }
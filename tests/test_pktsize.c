@@ -0,0 +1,60 @@
+#include "unity.h"
+#include "pktsize.h"
+
+void
+test_pktsize ( void )
+{
+  // floor of log2 of size, sizes 0 and 1 in first bucket
+  TEST_ASSERT_EQUAL_UINT ( 0, pktsize_bucket ( 0, 1 ) );
+  TEST_ASSERT_EQUAL_UINT ( 0, pktsize_bucket ( 1, 1 ) );
+  TEST_ASSERT_EQUAL_UINT ( 1, pktsize_bucket ( 3, 1 ) );
+  TEST_ASSERT_EQUAL_UINT ( 6, pktsize_bucket ( 64, 1 ) );
+  TEST_ASSERT_EQUAL_UINT ( 6, pktsize_bucket ( 127, 1 ) );
+  TEST_ASSERT_EQUAL_UINT ( 10, pktsize_bucket ( 1514, 1 ) );
+
+  // sizes above are of last bucket
+  TEST_ASSERT_EQUAL_UINT ( PKTSIZE_BUCKETS - 1, pktsize_bucket ( 32768, 1 ) );
+  TEST_ASSERT_EQUAL_UINT ( PKTSIZE_BUCKETS - 1, pktsize_bucket ( 65535, 1 ) );
+
+  // segments of GRO by average size, 10 x 1448 bytes
+  TEST_ASSERT_EQUAL_UINT ( 10, pktsize_bucket ( 14480, 10 ) );
+
+  struct pktsize *ps = pktsize_new ();
+  TEST_ASSERT_NOT_NULL ( ps );
+  TEST_ASSERT_EQUAL_UINT64 ( 0, pktsize_total ( ps, PKTSIZE_TX ) );
+
+  pktsize_add ( ps, PKTSIZE_TX, pktsize_bucket ( 1514, 1 ), 3 );
+  pktsize_add ( ps, PKTSIZE_TX, pktsize_bucket ( 66, 1 ), 1 );
+  pktsize_add ( ps, PKTSIZE_RX, pktsize_bucket ( 66, 1 ), 2 );
+
+  TEST_ASSERT_EQUAL_UINT64 ( 3, ps->packets[PKTSIZE_TX][10] );
+  TEST_ASSERT_EQUAL_UINT64 ( 1, ps->packets[PKTSIZE_TX][6] );
+  TEST_ASSERT_EQUAL_UINT64 ( 4, pktsize_total ( ps, PKTSIZE_TX ) );
+  TEST_ASSERT_EQUAL_UINT64 ( 2, pktsize_total ( ps, PKTSIZE_RX ) );
+
+  // row of aggregated view
+  struct pktsize *row = pktsize_new ();
+  TEST_ASSERT_NOT_NULL ( row );
+
+  pktsize_merge ( row, ps );
+  pktsize_merge ( row, ps );
+  TEST_ASSERT_EQUAL_UINT64 ( 6, row->packets[PKTSIZE_TX][10] );
+  TEST_ASSERT_EQUAL_UINT64 ( 4, pktsize_total ( row, PKTSIZE_RX ) );
+
+  TEST_ASSERT_EQUAL_size_t ( 2 * sizeof ( struct pktsize ), pktsize_memory () );
+
+  char label[PKTSIZE_LABEL_STRLEN];
+
+  pktsize_label ( 0, label, sizeof label );
+  TEST_ASSERT_EQUAL_STRING ( "1", label );
+  pktsize_label ( 9, label, sizeof label );
+  TEST_ASSERT_EQUAL_STRING ( "512", label );
+  pktsize_label ( 10, label, sizeof label );
+  TEST_ASSERT_EQUAL_STRING ( "1K", label );
+  pktsize_label ( PKTSIZE_BUCKETS - 1, label, sizeof label );
+  TEST_ASSERT_EQUAL_STRING ( "32K+", label );
+
+  pktsize_free ( ps );
+  pktsize_free ( row );
+  TEST_ASSERT_EQUAL_size_t ( 0, pktsize_memory () );
+}
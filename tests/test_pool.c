@@ -0,0 +1,58 @@
+#include <stdint.h>
+
+#include "unity.h"
+#include "pool.h"
+
+#define TOTAL 1000
+
+struct obj
+{
+  uint64_t a, b, c;
+};
+
+void
+test_pool ( void )
+{
+  struct pool pool;
+  struct obj *objs[TOTAL];
+
+  // few objects by slab, alloc more than one slab
+  pool_init ( &pool, "test", sizeof ( struct obj ), 64 );
+  TEST_ASSERT_EQUAL_UINT ( 0, pool_memory ( &pool ) );
+
+  for ( size_t i = 0; i < TOTAL; i++ )
+    {
+      objs[i] = pool_calloc ( &pool );
+      TEST_ASSERT_NOT_NULL ( objs[i] );
+      TEST_ASSERT_EQUAL_UINT64 ( 0, objs[i]->a | objs[i]->b | objs[i]->c );
+      TEST_ASSERT_EQUAL_UINT ( 0, ( uintptr_t ) objs[i] % sizeof ( void * ) );
+
+      objs[i]->a = objs[i]->b = objs[i]->c = i;
+    }
+
+  TEST_ASSERT_EQUAL_UINT ( TOTAL, pool.used );
+
+  size_t memory = pool_memory ( &pool );
+  TEST_ASSERT_GREATER_OR_EQUAL ( TOTAL * sizeof ( struct obj ), memory );
+  TEST_ASSERT_EQUAL_UINT ( memory, pool_memory_total () );
+
+  // objects not overlap
+  for ( size_t i = 0; i < TOTAL; i++ )
+    TEST_ASSERT_EQUAL_UINT64 ( i, objs[i]->a & objs[i]->b & objs[i]->c );
+
+  for ( size_t i = 0; i < TOTAL; i += 2 )
+    pool_free ( &pool, objs[i] );
+
+  TEST_ASSERT_EQUAL_UINT ( TOTAL / 2, pool.used );
+
+  // objects freed are reused before of new slabs
+  for ( size_t i = 0; i < TOTAL; i += 2 )
+    TEST_ASSERT_NOT_NULL ( objs[i] = pool_alloc ( &pool ) );
+
+  TEST_ASSERT_EQUAL_UINT ( memory, pool_memory ( &pool ) );
+  TEST_ASSERT_EQUAL_UINT ( TOTAL, pool.used );
+
+  pool_destroy ( &pool );
+  TEST_ASSERT_EQUAL_UINT ( 0, pool_memory ( &pool ) );
+  TEST_ASSERT_EQUAL_UINT ( 0, pool_memory_total () );
+}
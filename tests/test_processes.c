@@ -0,0 +1,263 @@
+#define _GNU_SOURCE  // nftw
+
+#include "unity.h"
+
+#include "../src/processes.c"
+
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+
+// processes of a tree as /proc, with sockets of loopback in your fds
+static char root[] = "/tmp/netproc_procXXXXXX";
+
+static void
+proc_add ( pid_t pid, const char *name )
+{
+  char path[128];
+
+  snprintf ( path, sizeof path, "%s/%d", root, pid );
+  TEST_ASSERT_EQUAL_INT ( 0, mkdir ( path, 0755 ) );
+
+  snprintf ( path, sizeof path, "%s/%d/fd", root, pid );
+  TEST_ASSERT_EQUAL_INT ( 0, mkdir ( path, 0755 ) );
+
+  snprintf ( path, sizeof path, "%s/%d/cmdline", root, pid );
+  FILE *file = fopen ( path, "w" );
+  TEST_ASSERT_NOT_NULL ( file );
+  fwrite ( name, 1, strlen ( name ) + 1, file );
+  fclose ( file );
+}
+
+static void
+fd_add ( pid_t pid, unsigned int fd, int sock )
+{
+  char path[128], target[32];
+  struct stat st;
+
+  TEST_ASSERT_EQUAL_INT ( 0, fstat ( sock, &st ) );
+  snprintf ( target,
+             sizeof target,
+             "socket:[%lu]",
+             ( unsigned long ) st.st_ino );
+  snprintf ( path, sizeof path, "%s/%d/fd/%u", root, pid, fd );
+  TEST_ASSERT_EQUAL_INT ( 0, symlink ( target, path ) );
+}
+
+static void
+fd_del ( pid_t pid, unsigned int fd )
+{
+  char path[128];
+
+  snprintf ( path, sizeof path, "%s/%d/fd/%u", root, pid, fd );
+  TEST_ASSERT_EQUAL_INT ( 0, unlink ( path ) );
+}
+
+static int
+remove_entry ( const char *path,
+               UNUSED const struct stat *st,
+               UNUSED int flag,
+               UNUSED struct FTW *ftw )
+{
+  return remove ( path );
+}
+
+static void
+proc_del ( pid_t pid )
+{
+  char path[128];
+
+  snprintf ( path, sizeof path, "%s/%d", root, pid );
+  TEST_ASSERT_EQUAL_INT (
+          0, nftw ( path, remove_entry, 8, FTW_DEPTH | FTW_PHYS ) );
+}
+
+static connection_t *
+sock_conn ( int sock )
+{
+  struct stat st;
+
+  TEST_ASSERT_EQUAL_INT ( 0, fstat ( sock, &st ) );
+
+  return connection_get_by_inode ( st.st_ino );
+}
+
+// client and server of a tcp connection in loopback
+static void
+tcp_pair ( int listener, int *client, int *server )
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof ( addr );
+
+  TEST_ASSERT_EQUAL_INT (
+          0, getsockname ( listener, ( struct sockaddr * ) &addr, &len ) );
+
+  *client = socket ( AF_INET, SOCK_STREAM, 0 );
+  TEST_ASSERT_NOT_EQUAL ( -1, *client );
+  TEST_ASSERT_EQUAL_INT (
+          0,
+          connect ( *client, ( struct sockaddr * ) &addr, sizeof ( addr ) ) );
+
+  *server = accept ( listener, NULL, NULL );
+  TEST_ASSERT_NOT_EQUAL ( -1, *server );
+}
+
+static int
+tcp_listener ( void )
+{
+  struct sockaddr_in addr = { .sin_family = AF_INET,
+                              .sin_addr.s_addr = htonl ( INADDR_LOOPBACK ) };
+
+  int sock = socket ( AF_INET, SOCK_STREAM, 0 );
+  TEST_ASSERT_NOT_EQUAL ( -1, sock );
+  TEST_ASSERT_EQUAL_INT (
+          0, bind ( sock, ( struct sockaddr * ) &addr, sizeof ( addr ) ) );
+  TEST_ASSERT_EQUAL_INT ( 0, listen ( sock, 4 ) );
+
+  return sock;
+}
+
+static process_t *
+get_proc ( pid_t pid )
+{
+  return hashtable_get ( ht_process, &pid );
+}
+
+// connections of array of 'proc' are the connections of your list
+static void
+check_conections ( const process_t *proc )
+{
+  uint32_t total = 0;
+
+  TEST_ASSERT_FALSE ( proc->conns_changed );
+
+  for ( const connection_t *conn = proc->conns; conn; conn = conn->proc_next )
+    {
+      TEST_ASSERT_EQUAL_PTR ( proc, conn->proc );
+      total++;
+    }
+
+  TEST_ASSERT_EQUAL_UINT32 ( total, proc->total_members );
+  TEST_ASSERT_EQUAL_UINT32 ( total, proc->total_conections );
+
+  for ( uint32_t i = 0; i < proc->total_conections; i++ )
+    TEST_ASSERT_EQUAL_PTR ( proc, proc->conections[i]->proc );
+}
+
+void
+test_processes ( void )
+{
+  struct config_op co = { .proto = TCP };
+  int listener, sock[4];
+
+  TEST_ASSERT_NOT_NULL ( mkdtemp ( root ) );
+  TEST_ASSERT_TRUE ( proc_root_set ( root ) );
+
+  TEST_ASSERT_TRUE ( connection_init () );
+  struct processes *procs = processes_init ();
+  TEST_ASSERT_NOT_NULL ( procs );
+
+  listener = tcp_listener ();
+  tcp_pair ( listener, &sock[0], &sock[1] );
+  tcp_pair ( listener, &sock[2], &sock[3] );
+
+  proc_add ( 100, "a" );
+  proc_add ( 200, "b" );
+  proc_add ( 300, "c" );
+  fd_add ( 100, 3, sock[0] );
+  fd_add ( 200, 3, sock[1] );
+  fd_add ( 300, 3, sock[2] );
+  fd_add ( 300, 4, sock[3] );
+
+  TEST_ASSERT_EQUAL_INT ( 1, processes_update ( procs, &co ) );
+  TEST_ASSERT_EQUAL ( 4, procs->total );
+  TEST_ASSERT_EQUAL_PTR ( &unattributed, procs->proc[0] );
+
+  process_t *a = get_proc ( 100 );
+  process_t *b = get_proc ( 200 );
+  process_t *c = get_proc ( 300 );
+  TEST_ASSERT_NOT_NULL ( a );
+  TEST_ASSERT_NOT_NULL ( b );
+  TEST_ASSERT_NOT_NULL ( c );
+  TEST_ASSERT_EQUAL_UINT32 ( 2, c->total_conections );
+  check_conections ( c );
+
+  connection_t *conn[4];
+  for ( int i = 0; i < 4; i++ )
+    {
+      conn[i] = sock_conn ( sock[i] );
+      TEST_ASSERT_NOT_NULL ( conn[i] );
+    }
+
+  // order of sort is kept in next updates
+  procs->proc[1] = c;
+  procs->proc[2] = b;
+  procs->proc[3] = a;
+
+  // socket passed to other process
+  fd_del ( 300, 4 );
+  fd_add ( 100, 4, sock[3] );
+
+  TEST_ASSERT_EQUAL_INT ( 1, processes_update ( procs, &co ) );
+  TEST_ASSERT_EQUAL ( 4, procs->total );
+  TEST_ASSERT_EQUAL_PTR ( c, procs->proc[1] );
+  TEST_ASSERT_EQUAL_PTR ( b, procs->proc[2] );
+  TEST_ASSERT_EQUAL_PTR ( a, procs->proc[3] );
+
+  TEST_ASSERT_EQUAL_PTR ( a, conn[3]->proc );
+  TEST_ASSERT_EQUAL_UINT32 ( 1, c->total_conections );
+  TEST_ASSERT_EQUAL_PTR ( conn[2], c->conections[0] );
+  TEST_ASSERT_EQUAL_UINT32 ( 2, a->total_conections );
+  check_conections ( a );
+  check_conections ( c );
+
+  // process closed leave the list, the others keep the order
+  proc_del ( 200 );
+
+  TEST_ASSERT_EQUAL_INT ( 1, processes_update ( procs, &co ) );
+  TEST_ASSERT_EQUAL ( 3, procs->total );
+  TEST_ASSERT_EQUAL_PTR ( c, procs->proc[1] );
+  TEST_ASSERT_EQUAL_PTR ( a, procs->proc[2] );
+  TEST_ASSERT_FALSE ( b->listed );
+  TEST_ASSERT_NULL ( conn[1]->proc );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, b->total_conections );
+
+  // socket without process is of new process, at end of list
+  proc_add ( 400, "d" );
+  fd_add ( 400, 3, sock[1] );
+
+  struct process_event event = { .pid = 400, .type = PROCESS_NEW };
+  processes_update_events ( procs, &event, 1 );
+
+  process_t *d = get_proc ( 400 );
+  TEST_ASSERT_NOT_NULL ( d );
+  TEST_ASSERT_EQUAL ( 4, procs->total );
+  TEST_ASSERT_EQUAL_PTR ( d, procs->proc[3] );
+  TEST_ASSERT_EQUAL_PTR ( d, conn[1]->proc );
+  check_conections ( d );
+
+  // socket closed leave your process
+  close ( sock[2] );
+  close ( sock[3] );
+  fd_del ( 100, 4 );
+  fd_del ( 300, 3 );
+
+  TEST_ASSERT_EQUAL_INT ( 1, processes_update ( procs, &co ) );
+  TEST_ASSERT_EQUAL_UINT32 ( 0, c->total_conections );
+  TEST_ASSERT_EQUAL_UINT32 ( 1, a->total_conections );
+  TEST_ASSERT_EQUAL_PTR ( conn[0], a->conections[0] );
+  check_conections ( a );
+  check_conections ( c );
+
+  processes_free ( procs );
+  connection_free ();
+
+  close ( sock[0] );
+  close ( sock[1] );
+  close ( listener );
+
+  nftw ( root, remove_entry, 8, FTW_DEPTH | FTW_PHYS );
+  proc_root_set ( "/proc" );
+}
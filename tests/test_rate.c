@@ -1,5 +1,8 @@
 
+#include <stdalign.h>
+#include <stddef.h>  // offsetof
 #include <stdint.h>
+#include <string.h>
 
 #include "unity.h"
 #include "processes.h"
@@ -7,53 +10,270 @@
 
 #include "rate.h"
 
+#define MIN( a, b ) ( ( a ) < ( b ) ? ( a ) : ( b ) )
+
 void
-exec ( struct processes *processes )
+exec ( process_t *proc )
 {
-  process_t *proc = *( processes->proc );
-
   struct config_op co = { .view_bytes = 1 };
 
   uint64_t expected_rx = 0, expected_tx = 0;
+  uint32_t sec = 1000;
 
-  // simulate 5 seconds of test
-  int times = 5;
-  while ( times-- )
+  // simulate 10 seconds of test
+  for ( int times = 0; times < 10; times++, sec++ )
     {
-      for ( int i = 0; i < SAMPLE_SPACE_SIZE; i++ )
+      // until fill all samples are needed increase of value expected
+      if ( times < SAMPLE_SPACE_SIZE )
         {
-          // first time is needed increase of value expected
-          if ( times == 4 )
-            {
-              expected_rx += 1000;  // exact value to avoid rounding
-              expected_tx += 500;
-            }
-
-          // max value after first time must be always 5000 / SAMPLE_SPACE_SIZE
-          rate_add_rx ( &proc->net_stat, 1000 );
-          rate_add_tx ( &proc->net_stat, 500 );
-
-          rate_calc ( processes, &co );
-
-          TEST_ASSERT_EQUAL_INT ( expected_rx / SAMPLE_SPACE_SIZE,
-                                  proc->net_stat.avg_Bps_rx );
-          TEST_ASSERT_EQUAL_INT ( expected_tx / SAMPLE_SPACE_SIZE,
-                                  proc->net_stat.avg_Bps_tx );
-
-          // rotate e clean slot
-          rate_update ( processes, &co );
+          expected_rx += 1000;  // exact value to avoid rounding
+          expected_tx += 500;
         }
+
+      // max value after fill samples must be always 5000 / SAMPLE_SPACE_SIZE
+      rate_add_rx ( &proc->net_stat, 1000, sec );
+      rate_add_tx ( &proc->net_stat, 500, sec );
+
+      // second in progress is not computed
+      uint64_t closed = MIN ( times, SAMPLE_SPACE_SIZE );
+      rate_calc ( &co, sec );
+      TEST_ASSERT_EQUAL_INT ( closed * 1000 / SAMPLE_SPACE_SIZE,
+                              proc->net_stat.avg_Bps_rx );
+
+      rate_calc ( &co, sec + 1 );
+
+      TEST_ASSERT_EQUAL_INT ( expected_rx / SAMPLE_SPACE_SIZE,
+                              proc->net_stat.avg_Bps_rx );
+      TEST_ASSERT_EQUAL_INT ( expected_tx / SAMPLE_SPACE_SIZE,
+                              proc->net_stat.avg_Bps_tx );
+
+      rate_update ();
+    }
+
+  // packets read late are computed in your second
+  rate_add_rx ( &proc->net_stat, 5000, sec - 2 );
+  rate_calc ( &co, sec );
+  TEST_ASSERT_EQUAL_INT ( 10000 / SAMPLE_SPACE_SIZE,
+                          proc->net_stat.avg_Bps_rx );
+
+  // older than samples, only in total
+  nstats_t total = proc->net_stat.tot_Bps_rx;
+  rate_add_rx ( &proc->net_stat, 5000, sec - SAMPLE_SLOTS - 1 );
+  rate_calc ( &co, sec );
+  TEST_ASSERT_EQUAL_INT ( 10000 / SAMPLE_SPACE_SIZE,
+                          proc->net_stat.avg_Bps_rx );
+  TEST_ASSERT_EQUAL_INT ( total + 5000, proc->net_stat.tot_Bps_rx );
+
+  // without traffic, samples expire
+  rate_calc ( &co, sec + SAMPLE_SPACE_SIZE );
+  TEST_ASSERT_EQUAL_INT ( 0, proc->net_stat.avg_Bps_rx );
+  TEST_ASSERT_NOT_NULL ( proc->net_stat.history );
+}
+
+// only the first cache line is touched by packet, history only with traffic
+static void
+test_layout ( void )
+{
+  TEST_ASSERT_EQUAL_UINT ( 0, offsetof ( struct net_stat, sec ) );
+  TEST_ASSERT_LESS_OR_EQUAL ( CACHE_LINE_SIZE,
+                              offsetof ( struct net_stat, avg_Bps_rx ) );
+
+  struct net_stat ns = { 0 };
+
+  // second in progress still without history
+  rate_add_tx ( &ns, 100, 1000 );
+  TEST_ASSERT_NULL ( ns.history );
+  TEST_ASSERT_EQUAL_UINT ( 100, ns.tot_Bps_tx );
+
+  rate_add_tx ( &ns, 100, 1001 );
+  TEST_ASSERT_NOT_NULL ( ns.history );
+  rate_net_stat_free ( &ns );
+}
+
+// row of aggregated view receive the traffic already accounted
+static void
+test_merge ( void )
+{
+  struct net_stat src = { 0 }, dst = { 0 };
+  struct config_op co = { .view_bytes = 1 };
+
+  rate_add_rx ( &src, 1000, 1000 );
+  rate_add_rx ( &src, 2000, 1001 );  // second in progress
+  rate_add_rx ( &dst, 500, 1001 );
+
+  rate_net_stat_merge ( &dst, &src );
+  TEST_ASSERT_EQUAL_UINT ( 3500, dst.tot_Bps_rx );
+
+  nstats_t rx, tx;
+  rate_packets ( &dst, &rx, &tx );
+  TEST_ASSERT_EQUAL_UINT ( 3, rx );
+  TEST_ASSERT_EQUAL_UINT ( 0, tx );
+
+  rate_calc ( &co, 1002 );
+  TEST_ASSERT_EQUAL_INT ( 3500 / SAMPLE_SPACE_SIZE, dst.avg_Bps_rx );
+
+  rate_net_stat_free ( &src );
+  rate_net_stat_free ( &dst );
+}
+
+// only net_stat with traffic in window are visited by tick
+static void
+test_active ( void )
+{
+  struct net_stat a = { 0 }, b = { 0 };
+  struct config_op co = { .view_bytes = 1 };
+
+  rate_add_tx ( &a, 100, 1000 );
+  rate_add_tx ( &b, 100, 1000 );
+  rate_add_tx ( &a, 100, 1001 );
+  TEST_ASSERT_NOT_EQUAL ( 0, a.active );
+  TEST_ASSERT_NOT_EQUAL ( 0, b.active );
+
+  for ( uint32_t now = 1002; now <= 1000 + SAMPLE_SPACE_SIZE; now++ )
+    {
+      rate_calc ( &co, now );
+      rate_update ();
     }
+
+  TEST_ASSERT_EQUAL_INT ( 200 / SAMPLE_SPACE_SIZE, a.avg_Bps_tx );
+  TEST_ASSERT_EQUAL_UINT ( 200, a.tot_Bps_tx_prev );
+
+  // sample of b left the window
+  rate_calc ( &co, 1001 + SAMPLE_SPACE_SIZE );
+  rate_update ();
+  TEST_ASSERT_EQUAL_INT ( 0, b.avg_Bps_tx );
+  TEST_ASSERT_EQUAL_UINT ( 0, b.active );
+  TEST_ASSERT_NOT_EQUAL ( 0, a.active );
+  TEST_ASSERT_EQUAL_UINT ( 100, b.tot_Bps_tx_prev );
+
+  rate_calc ( &co, 1002 + SAMPLE_SPACE_SIZE );
+  rate_update ();
+  TEST_ASSERT_EQUAL_UINT ( 0, a.active );
+
+  // back to list with traffic
+  rate_add_tx ( &b, 500, 1002 + SAMPLE_SPACE_SIZE );
+  rate_calc ( &co, 1003 + SAMPLE_SPACE_SIZE );
+  TEST_ASSERT_EQUAL_INT ( 500 / SAMPLE_SPACE_SIZE, b.avg_Bps_tx );
+
+  rate_net_stat_free ( &a );
+  rate_net_stat_free ( &b );
+  TEST_ASSERT_EQUAL_UINT ( 0, b.active );
+}
+
+// each window has your own sum, updated while the time advances
+static void
+test_windows ( void )
+{
+  struct config_op co = { .view_bytes = 1,
+                          .refresh = REFRESH_DEFAULT,
+                          .rate_windows = { 2, 10 },
+                          .total_rate_windows = 2 };
+  struct net_stat ns = { 0 };
+
+  rate_init ( &co );
+
+  unsigned int total;
+  const unsigned int *windows = rate_windows ( &total );
+  TEST_ASSERT_EQUAL_UINT ( 2, total );
+  TEST_ASSERT_EQUAL_UINT ( 10, windows[1] );
+
+  rate_add_rx ( &ns, 1000, 2000 );
+  rate_add_rx ( &ns, 3000, 2001 );
+
+  // window of 2 seconds
+  rate_calc ( &co, 2002 );
+  TEST_ASSERT_EQUAL_INT ( 2000, ns.avg_Bps_rx );
+  rate_calc ( &co, 2003 );
+  TEST_ASSERT_EQUAL_INT ( 1500, ns.avg_Bps_rx );
+  rate_calc ( &co, 2004 );
+  TEST_ASSERT_EQUAL_INT ( 0, ns.avg_Bps_rx );
+
+  // window of 10 seconds
+  rate_select_window ( 1 );
+  TEST_ASSERT_EQUAL_UINT ( 1, rate_selected_window () );
+  rate_calc ( &co, 2010 );
+  TEST_ASSERT_EQUAL_INT ( 400, ns.avg_Bps_rx );
+
+  // traffic read late, in window only
+  rate_add_rx ( &ns, 1000, 2005 );
+  rate_calc ( &co, 2011 );
+  TEST_ASSERT_EQUAL_INT ( 400, ns.avg_Bps_rx );
+  rate_calc ( &co, 2012 );
+  TEST_ASSERT_EQUAL_INT ( 100, ns.avg_Bps_rx );
+
+  // after long time without rate_calc
+  rate_calc ( &co, 3000 );
+  TEST_ASSERT_EQUAL_INT ( 0, ns.avg_Bps_rx );
+
+  // invalid window is ignored
+  rate_select_window ( 2 );
+  TEST_ASSERT_EQUAL_UINT ( 1, rate_selected_window () );
+
+  rate_net_stat_free ( &ns );
+  rate_free ();
+
+  // back to default
+  struct config_op co_default = { .refresh = REFRESH_DEFAULT,
+                                  .rate_windows = { RATE_WINDOW_DEFAULT },
+                                  .total_rate_windows = 1 };
+  rate_init ( &co_default );
+}
+
+// with refresh of less of a second, samples are of ticks and rates by second
+static void
+test_interval ( void )
+{
+  struct config_op co = { .view_bytes = 1,
+                          .refresh = 250,
+                          .rate_windows = { 1 },
+                          .total_rate_windows = 1 };
+  struct net_stat ns = { 0 };
+
+  rate_init ( &co );
+
+  TEST_ASSERT_EQUAL_UINT ( 4002, rate_tick ( 1000, 500000000 ) );
+  TEST_ASSERT_EQUAL_UINT ( 120, rate_ticks ( 30 ) );
+
+  rate_add_rx ( &ns, 1000, 4000 );
+  rate_add_rx ( &ns, 1000, 4001 );
+
+  rate_calc ( &co, 4002 );
+  TEST_ASSERT_EQUAL_INT ( 2000, ns.avg_Bps_rx );
+  TEST_ASSERT_EQUAL_INT ( 2, ns.avg_pps_rx );
+
+  // window of one second has four ticks
+  rate_calc ( &co, 4005 );
+  TEST_ASSERT_EQUAL_INT ( 1000, ns.avg_Bps_rx );
+  rate_calc ( &co, 4006 );
+  TEST_ASSERT_EQUAL_INT ( 0, ns.avg_Bps_rx );
+
+  rate_net_stat_free ( &ns );
+  rate_free ();
+
+  struct config_op co_default = { .refresh = REFRESH_DEFAULT,
+                                  .rate_windows = { RATE_WINDOW_DEFAULT },
+                                  .total_rate_windows = 1 };
+  rate_init ( &co_default );
+  TEST_ASSERT_EQUAL_UINT ( 1000, rate_tick ( 1000, 500000000 ) );
 }
 
 void
 test_rate ( void )
 {
-  process_t *proc = calloc ( 1, sizeof *proc );
-  process_t *pp_procs[] = { proc, NULL };
-  struct processes processes = { .proc = pp_procs, .total = 1 };
+  // counters of net_stat are aligned to cache line
+  process_t *proc = aligned_alloc ( alignof ( process_t ), sizeof *proc );
+  TEST_ASSERT_NOT_NULL ( proc );
+  memset ( proc, 0, sizeof *proc );
 
-  exec ( &processes );
+  exec ( proc );
+  test_layout ();
+  test_merge ();
+  test_active ();
 
+  rate_net_stat_free ( &proc->net_stat );
   free ( proc );
+  rate_free ();
+
+  test_windows ();
+  test_interval ();
 }
@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "unity.h"
+#include "config.h"
+#include "processes.h"
+#include "rate.h"
+#include "vector.h"
+#include "record.h"
+#include "replay.h"
+
+#define PATH_RECORD "/tmp/netproc_test.rec"
+
+void
+test_record ( void )
+{
+  struct config_op co = { .refresh = 1000,
+                          .rate_windows = { 5 },
+                          .total_rate_windows = 1 };
+  rate_init ( &co );
+
+  char name1[] = "prog1";
+  char name2[] = "prog2";
+  process_t procs[2] = { { .pid = 10, .name = name1 },
+                         { .pid = 20, .name = name2 } };
+  process_t *list[2] = { &procs[0], &procs[1] };
+
+  TEST_ASSERT_TRUE ( record_init ( PATH_RECORD, &co ) );
+
+  uint32_t tick = 1000;
+
+  // traffic of process 1 in two ticks, of process 2 in the second
+  rate_add_rx_n ( &procs[0].net_stat, 3000, 3, tick );
+  rate_calc ( &co, tick + 1 );
+  record_tick ( list, 2, tick );
+  rate_update ();
+
+  rate_add_tx_n ( &procs[0].net_stat, 500, 1, tick + 1 );
+  rate_add_tx_n ( &procs[1].net_stat, 700, 2, tick + 1 );
+  rate_calc ( &co, tick + 2 );
+  record_tick ( list, 2, tick + 1 );
+  rate_update ();
+
+  // process 2 closed
+  record_tick ( list, 1, tick + 2 );
+  record_free ();
+
+  rate_net_stat_free ( &procs[0].net_stat );
+  rate_net_stat_free ( &procs[1].net_stat );
+
+  struct processes view = { .proc = vector_new ( sizeof ( process_t * ) ) };
+  unsigned int refresh;
+  uint32_t first;
+
+  TEST_ASSERT_TRUE ( replay_init ( PATH_RECORD, &refresh, &first ) );
+  TEST_ASSERT_EQUAL_UINT ( 1000, refresh );
+  TEST_ASSERT_EQUAL_UINT ( tick, first );
+
+  TEST_ASSERT_TRUE ( replay_tick ( &view, tick ) );
+  TEST_ASSERT_EQUAL_INT ( 1, view.total );
+  TEST_ASSERT_EQUAL_STRING ( "prog1", view.proc[0]->name );
+  TEST_ASSERT_EQUAL_INT ( 10, view.proc[0]->pid );
+  TEST_ASSERT_EQUAL_INT ( 3000, view.proc[0]->net_stat.tot_Bps_rx );
+
+  TEST_ASSERT_TRUE ( replay_tick ( &view, tick + 1 ) );
+  TEST_ASSERT_EQUAL_INT ( 2, view.total );
+  TEST_ASSERT_EQUAL_INT ( 500, view.proc[0]->net_stat.tot_Bps_tx );
+  TEST_ASSERT_EQUAL_INT ( 700, view.proc[1]->net_stat.tot_Bps_tx );
+  TEST_ASSERT_EQUAL_INT ( 2, view.proc[1]->net_stat.cur_pps_tx );
+
+  // exit of process 2, after end of file
+  replay_tick ( &view, tick + 2 );
+  TEST_ASSERT_EQUAL_INT ( 1, view.total );
+  TEST_ASSERT_FALSE ( replay_tick ( &view, tick + 3 ) );
+
+  replay_free ( &view );
+  vector_free ( view.proc );
+  rate_free ();
+  remove ( PATH_RECORD );
+}
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "service.h"
+#include "unity.h"
+
+static void
+write_services ( const char *path, const char *content )
+{
+  FILE *file = fopen ( path, "w" );
+  TEST_ASSERT_NOT_NULL ( file );
+  fputs ( content, file );
+  fclose ( file );
+}
+
+void
+test_service ( void )
+{
+  char path[] = "/tmp/netproc_services_XXXXXX";
+  int fd = mkstemp ( path );
+  TEST_ASSERT_NOT_EQUAL ( -1, fd );
+  close ( fd );
+
+  write_services ( path,
+                   "# comment\n"
+                   "ssh\t\t22/tcp\t\t\t# SSH\n"
+                   "domain\t\t53/tcp\n"
+                   "domain\t\t53/udp\n"
+                   "other\t\t53/udp\t\talias\n"
+                   "sctp\t\t99/sctp\n"
+                   "bad\t\t70000/tcp\n"
+                   "high\t\t65535/udp\n" );
+
+  TEST_ASSERT_EQUAL_INT ( 1, service_init ( path ) );
+
+  char buf[32];
+  TEST_ASSERT_EQUAL_INT ( 1, port2serv ( 22, "tcp", buf, sizeof buf ) );
+  TEST_ASSERT_EQUAL_STRING ( "ssh", buf );
+
+  TEST_ASSERT_EQUAL_INT ( 0, port2serv ( 22, "udp", buf, sizeof buf ) );
+
+  // first name of port
+  TEST_ASSERT_EQUAL_INT ( 1, port2serv ( 53, "udp", buf, sizeof buf ) );
+  TEST_ASSERT_EQUAL_STRING ( "domain", buf );
+
+  TEST_ASSERT_EQUAL_INT ( 0, port2serv ( 99, "tcp", buf, sizeof buf ) );
+  TEST_ASSERT_EQUAL_INT ( 1, port2serv ( 65535, "udp", buf, sizeof buf ) );
+  TEST_ASSERT_EQUAL_STRING ( "high", buf );
+
+  // reload see changes of file
+  uint32_t gen = service_generation ();
+  write_services ( path, "secure\t22/tcp\n" );
+  service_reload ();
+
+  TEST_ASSERT_NOT_EQUAL ( gen, service_generation () );
+  TEST_ASSERT_EQUAL_INT ( 1, port2serv ( 22, "tcp", buf, sizeof buf ) );
+  TEST_ASSERT_EQUAL_STRING ( "secure", buf );
+  TEST_ASSERT_EQUAL_INT ( 0, port2serv ( 53, "tcp", buf, sizeof buf ) );
+
+  // file invalid, table is kept
+  unlink ( path );
+  service_reload ();
+  TEST_ASSERT_EQUAL_INT ( 1, port2serv ( 22, "tcp", buf, sizeof buf ) );
+
+  service_free ();
+}
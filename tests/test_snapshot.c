@@ -0,0 +1,94 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+
+#include "unity.h"
+#include "config.h"
+#include "processes.h"
+#include "snapshot.h"
+
+#define SHM_NAME "/netproc_test"
+
+void
+test_snapshot ( void )
+{
+  struct config_op co = { .shm = SHM_NAME,
+                          .refresh = 1000,
+                          .view_conections = true,
+                          .view_bytes = true };
+
+  TEST_ASSERT_TRUE ( snapshot_init ( &co ) );
+
+  connection_t conn = { .tuple = { .l4 = { .local_port = 1234,
+                                           .remote_port = 53,
+                                           .protocol = IPPROTO_UDP },
+                                   .family = AF_INET },
+                        .if_index = 2 };
+  conn.tuple.l3.local.ip = htonl ( 0x0a000001 );
+  conn.net_stat.tot_Bps_tx = 100;
+
+  connection_t *conns[] = { &conn };
+
+  char name1[] = "idle";
+  char name2[] = "dig";
+  process_t procs[2] = { { .pid = 10, .name = name1 },
+                         { .pid = 20,
+                           .name = name2,
+                           .conections = conns,
+                           .total_conections = 1 } };
+  procs[1].net_stat.tot_Bps_tx = 100;
+  procs[1].net_stat.avg_Bps_tx = 100;
+
+  process_t *list[] = { &procs[0], &procs[1] };
+
+  snapshot_update ( list, 2, &co );
+
+  int fd = shm_open ( SHM_NAME, O_RDONLY, 0 );
+  TEST_ASSERT_NOT_EQUAL_INT ( -1, fd );
+
+  size_t mapped = 4096;
+  void *base = mmap ( NULL, mapped, PROT_READ, MAP_SHARED, fd, 0 );
+  TEST_ASSERT_NOT_EQUAL ( MAP_FAILED, base );
+
+  // buffer small, only header
+  char small[sizeof ( struct snapshot_header ) + 8];
+  TEST_ASSERT_EQUAL_UINT (
+          0, snapshot_copy ( base, mapped, small, sizeof small, 4 ) );
+
+  uint64_t buf[512];
+  size_t len = snapshot_copy ( base, mapped, buf, sizeof buf, 4 );
+  TEST_ASSERT_NOT_EQUAL_UINT ( 0, len );
+
+  const struct snapshot_header *hdr = ( void * ) buf;
+  TEST_ASSERT_EQUAL_HEX32 ( SNAPSHOT_MAGIC, hdr->magic );
+  TEST_ASSERT_EQUAL_UINT64 ( 2, hdr->seq );
+  TEST_ASSERT_EQUAL_UINT32 ( 1, hdr->total_processes );
+  TEST_ASSERT_EQUAL_UINT32 ( 1, hdr->total_connections );
+
+  const char *base_buf = ( const char * ) buf;
+  const struct snapshot_process *sp =
+          ( const void * ) ( base_buf + hdr->off_processes );
+  const struct snapshot_connection *sc =
+          ( const void * ) ( base_buf + hdr->off_connections );
+  const char *strings = base_buf + hdr->off_strings;
+
+  TEST_ASSERT_EQUAL_UINT32 ( 20, sp->pid );
+  TEST_ASSERT_EQUAL_STRING ( "dig", strings + sp->name );
+  TEST_ASSERT_EQUAL_UINT64 ( 100, sp->stats.tx );
+
+  TEST_ASSERT_EQUAL_UINT32 ( 0, sc->process );
+  TEST_ASSERT_EQUAL_UINT16 ( 1234, sc->local_port );
+  TEST_ASSERT_EQUAL_UINT8 ( IPPROTO_UDP, sc->protocol );
+  TEST_ASSERT_EQUAL_UINT8 ( 10, sc->local[0] );
+  TEST_ASSERT_EQUAL_UINT64 ( 100, sc->stats.total_tx );
+
+  munmap ( base, mapped );
+  close ( fd );
+  snapshot_free ();
+
+  // segment is removed on exit
+  TEST_ASSERT_EQUAL_INT ( -1, shm_open ( SHM_NAME, O_RDONLY, 0 ) );
+}
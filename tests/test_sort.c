@@ -0,0 +1,121 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "unity.h"
+#include "config.h"
+#include "processes.h"
+#include "connection.h"
+#include "sort.h"
+
+#define TOTAL 100
+
+static process_t procs[TOTAL];
+static process_t *proc[TOTAL];
+
+static void
+init_procs ( void )
+{
+  for ( int i = 0; i < TOTAL; i++ )
+    {
+      procs[i] = ( process_t ){ .pid = i + 1 };
+
+      // a process of each ten without traffic
+      if ( i % 10 )
+        {
+          // values repeated, on tie the order is by pid
+          procs[i].net_stat.avg_Bps_rx = ( i * 37 ) % 20;
+          procs[i].net_stat.tot_Bps_rx = 1000 + i;
+        }
+
+      proc[i] = &procs[i];
+    }
+}
+
+static void
+check_sorted ( size_t k )
+{
+  for ( size_t i = 1; i < k; i++ )
+    {
+      nstats_t prev = proc[i - 1]->net_stat.avg_Bps_rx;
+      nstats_t cur = proc[i]->net_stat.avg_Bps_rx;
+
+      TEST_ASSERT_TRUE ( prev >= cur );
+      if ( prev == cur )
+        TEST_ASSERT_TRUE ( proc[i - 1]->pid < proc[i]->pid );
+    }
+}
+
+void
+test_sort_top ( void )
+{
+  struct config_op co = { 0 };
+  size_t k = 15;
+
+  init_procs ();
+
+  size_t total = sort ( proc, TOTAL, RATE_RX, k, &co );
+  TEST_ASSERT_EQUAL_INT ( TOTAL - TOTAL / 10, total );
+
+  // processes without traffic after of showed
+  for ( size_t i = 0; i < TOTAL; i++ )
+    TEST_ASSERT_EQUAL_INT ( i < total, proc[i]->net_stat.tot_Bps_rx != 0 );
+
+  check_sorted ( k );
+
+  // none of rest is greater than last of top
+  for ( size_t i = k; i < total; i++ )
+    TEST_ASSERT_TRUE ( proc[i]->net_stat.avg_Bps_rx <=
+                       proc[k - 1]->net_stat.avg_Bps_rx );
+
+  // same result with already sorted
+  process_t *top[TOTAL];
+  for ( size_t i = 0; i < k; i++ )
+    top[i] = proc[i];
+
+  sort ( proc, TOTAL, RATE_RX, k, &co );
+  for ( size_t i = 0; i < k; i++ )
+    TEST_ASSERT_EQUAL_PTR ( top[i], proc[i] );
+
+  // all sorted, verbose show processes without traffic
+  co.verbose = true;
+  total = sort ( proc, TOTAL, S_PID, TOTAL, &co );
+  TEST_ASSERT_EQUAL_INT ( TOTAL, total );
+  for ( size_t i = 0; i < TOTAL; i++ )
+    TEST_ASSERT_EQUAL_INT ( i + 1, proc[i]->pid );
+}
+
+void
+test_sort_connections ( void )
+{
+  connection_t cons[10] = { 0 };
+  connection_t *con[10];
+  process_t process = { .conections = con, .total_conections = 10 };
+
+  for ( int i = 0; i < 10; i++ )
+    {
+      cons[i].inode = i;
+      cons[i].net_stat.avg_Bps_tx = ( i % 3 ) ? i : 0;
+      con[i] = &cons[i];
+    }
+
+  size_t total = sort_connections_active ( &process );
+  TEST_ASSERT_EQUAL_INT ( 6, total );
+
+  sort_connections ( &process, total, RATE_TX, total );
+  for ( size_t i = 1; i < total; i++ )
+    TEST_ASSERT_TRUE ( con[i - 1]->net_stat.avg_Bps_tx >
+                       con[i]->net_stat.avg_Bps_tx );
+
+  // without traffic, the first is showed
+  for ( int i = 0; i < 10; i++ )
+    cons[i].net_stat.avg_Bps_tx = 0;
+
+  TEST_ASSERT_EQUAL_INT ( 1, sort_connections_active ( &process ) );
+}
+
+void
+test_sort ( void )
+{
+  test_sort_top ();
+  test_sort_connections ();
+}
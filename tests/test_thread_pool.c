@@ -0,0 +1,70 @@
+#include <sched.h>  // sched_yield
+
+#include "thread_pool.h"
+#include "unity.h"
+
+#define WORKERS 2
+
+// same of thread_pool.c
+#define RING_SIZE 1024
+
+static unsigned int started;
+static unsigned int done;
+static int release;
+
+static void
+block_task ( void *arg )
+{
+  ( void ) arg;
+
+  __atomic_add_fetch ( &started, 1, __ATOMIC_SEQ_CST );
+  while ( !__atomic_load_n ( &release, __ATOMIC_SEQ_CST ) )
+    sched_yield ();
+}
+
+static void
+count_task ( void *arg )
+{
+  __atomic_add_fetch ( ( unsigned int * ) arg, 1, __ATOMIC_SEQ_CST );
+}
+
+static void
+wait_value ( unsigned int *value, unsigned int expected )
+{
+  while ( __atomic_load_n ( value, __ATOMIC_SEQ_CST ) != expected )
+    sched_yield ();
+}
+
+void
+test_thread_pool ( void )
+{
+  TEST_ASSERT_EQUAL_INT ( 1, thpool_init ( WORKERS ) );
+
+  // all tasks are executed
+  for ( int i = 0; i < 5000; i++ )
+    {
+      while ( !add_task ( count_task, &done ) )
+        sched_yield ();
+    }
+  wait_value ( &done, 5000 );
+
+  // with all workers busy, ring accept only RING_SIZE tasks
+  for ( int i = 0; i < WORKERS; i++ )
+    TEST_ASSERT_EQUAL_INT ( 1, add_task ( block_task, NULL ) );
+  wait_value ( &started, WORKERS );
+
+  done = 0;
+  unsigned int accepted = 0;
+  while ( add_task ( count_task, &done ) )
+    accepted++;
+
+  TEST_ASSERT_EQUAL_UINT ( RING_SIZE, accepted );
+
+  __atomic_store_n ( &release, 1, __ATOMIC_SEQ_CST );
+  wait_value ( &done, RING_SIZE );
+
+  TEST_ASSERT_EQUAL_INT ( 1, add_task ( count_task, &done ) );
+  wait_value ( &done, RING_SIZE + 1 );
+
+  thpool_free ();
+}
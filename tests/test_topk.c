@@ -0,0 +1,98 @@
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "unity.h"
+#include "topk.h"
+
+static struct topk_key
+key_ipv4 ( uint32_t ip, uint16_t port )
+{
+  struct topk_key key;
+
+  memset ( &key, 0, sizeof ( key ) );
+  key.addr.ip = htonl ( ip );
+  key.port = port;
+  key.family = AF_INET;
+
+  return key;
+}
+
+void
+test_topk ( void )
+{
+  struct topk *tk = topk_new ();
+  TEST_ASSERT_NOT_NULL ( tk );
+  TEST_ASSERT_EQUAL_UINT ( 0, tk->total );
+
+  // heavy hitters, more than 1 / TOPK_ENTRIES of traffic
+  struct topk_key heavy1 = key_ipv4 ( 0x0a000001, 0 );
+  struct topk_key heavy2 = key_ipv4 ( 0x0a000002, 443 );
+
+  uint64_t total = 0;
+  for ( uint32_t i = 0; i < 1000; i++ )
+    {
+      topk_add ( tk, &heavy1, 100 );
+      topk_add ( tk, &heavy2, 50 );
+
+      // many keys with little traffic
+      struct topk_key mouse = key_ipv4 ( 0x0b000000 + i, 0 );
+      topk_add ( tk, &mouse, 10 );
+      total += 160;
+    }
+
+  TEST_ASSERT_EQUAL_UINT ( TOPK_ENTRIES, tk->total );
+
+  topk_sort ( tk );
+
+  uint64_t sum = 0;
+  for ( unsigned int i = 0; i < tk->total; i++ )
+    {
+      sum += tk->entries[i].bytes;
+      if ( i )
+        TEST_ASSERT_GREATER_OR_EQUAL ( tk->entries[i].bytes,
+                                       tk->entries[i - 1].bytes );
+    }
+
+  // counters of Space-Saving always sum all traffic
+  TEST_ASSERT_EQUAL_UINT64 ( total, sum );
+
+  // bytes is upper bound, and bytes - error lower bound
+  TEST_ASSERT_EQUAL_MEMORY ( &heavy1, &tk->entries[0].key, sizeof heavy1 );
+  TEST_ASSERT_GREATER_OR_EQUAL ( 100000, tk->entries[0].bytes );
+  TEST_ASSERT_LESS_OR_EQUAL ( 100000,
+                              tk->entries[0].bytes - tk->entries[0].error );
+
+  TEST_ASSERT_EQUAL_MEMORY ( &heavy2, &tk->entries[1].key, sizeof heavy2 );
+  TEST_ASSERT_GREATER_OR_EQUAL ( 50000, tk->entries[1].bytes );
+  TEST_ASSERT_LESS_OR_EQUAL ( 50000,
+                              tk->entries[1].bytes - tk->entries[1].error );
+
+  // merge in empty sketch keep the keys
+  struct topk *dst = topk_new ();
+  TEST_ASSERT_NOT_NULL ( dst );
+  topk_merge ( dst, tk );
+  topk_sort ( dst );
+  TEST_ASSERT_EQUAL_UINT ( tk->total, dst->total );
+  TEST_ASSERT_EQUAL_MEMORY ( &heavy1, &dst->entries[0].key, sizeof heavy1 );
+  TEST_ASSERT_EQUAL_UINT64 ( tk->entries[0].bytes, dst->entries[0].bytes );
+
+  char buf[TOPK_KEY_STRLEN];
+  topk_key_str ( &heavy1, buf, sizeof buf );
+  TEST_ASSERT_EQUAL_STRING ( "10.0.0.1", buf );
+  topk_key_str ( &heavy2, buf, sizeof buf );
+  TEST_ASSERT_EQUAL_STRING ( "10.0.0.2:443", buf );
+
+  struct topk_key ipv6;
+  memset ( &ipv6, 0, sizeof ( ipv6 ) );
+  inet_pton ( AF_INET6, "fd00::1", &ipv6.addr );
+  ipv6.family = AF_INET6;
+  ipv6.port = 53;
+  topk_key_str ( &ipv6, buf, sizeof buf );
+  TEST_ASSERT_EQUAL_STRING ( "[fd00::1]:53", buf );
+
+  TEST_ASSERT_GREATER_OR_EQUAL ( 2 * sizeof ( *tk ), topk_memory () );
+
+  topk_free ( tk );
+  topk_free ( dst );
+  TEST_ASSERT_EQUAL_UINT ( 0, topk_memory () );
+}
@@ -99,10 +99,87 @@ test_heap ( void )
   vector_free ( v );
 }
 
+void
+test_reserve ( void )
+{
+  int *v = vector_new ( sizeof ( int ) );
+  TEST_ASSERT_NOT_NULL ( v );
+
+  TEST_ASSERT_TRUE ( vector_reserve ( v, 1000 ) );
+  TEST_ASSERT_GREATER_OR_EQUAL ( 1000, vector_capacity ( v ) );
+
+  // pushes until reserved not move the vector
+  int *before = v;
+  int data[1000];
+  for ( int i = 0; i < 1000; i++ )
+    data[i] = i;
+
+  TEST_ASSERT_TRUE ( vector_push_n ( v, data, 600 ) );
+  TEST_ASSERT_TRUE ( vector_push_n ( v, data + 600, 400 ) );
+  TEST_ASSERT_EQUAL_PTR ( before, v );
+  TEST_ASSERT_EQUAL_UINT ( 1000, vector_size ( v ) );
+  TEST_ASSERT_EQUAL_INT_ARRAY ( data, v, 1000 );
+
+  // space not used is released, elements are kept
+  for ( int i = 0; i < 990; i++ )
+    vector_pop ( v );
+
+  vector_shrink ( v );
+  TEST_ASSERT_EQUAL_UINT ( 16, vector_capacity ( v ) );
+  TEST_ASSERT_EQUAL_INT_ARRAY ( data, v, 10 );
+
+  vector_free ( v );
+}
+
+void
+test_vector_memory ( void )
+{
+  size_t before = vector_memory ();
+
+  int *v = vector_new ( sizeof ( int ) );
+  TEST_ASSERT_NOT_NULL ( v );
+  TEST_ASSERT_TRUE ( vector_reserve ( v, 1000 ) );
+  TEST_ASSERT_GREATER_OR_EQUAL ( before + 1000 * sizeof ( int ),
+                                 vector_memory () );
+
+  // space released by shrink is discounted
+  size_t reserved = vector_memory ();
+  vector_shrink ( v );
+  TEST_ASSERT_LESS_THAN ( reserved, vector_memory () );
+
+  vector_free ( v );
+  TEST_ASSERT_EQUAL_UINT ( before, vector_memory () );
+}
+
+void
+test_vector_arena ( void )
+{
+  struct arena arena = ARENA_INITIALIZER;
+
+  int *v = vector_new_arena ( sizeof ( int ), &arena );
+  TEST_ASSERT_NOT_NULL ( v );
+
+  for ( int i = 0; i < 100; i++ )
+    TEST_ASSERT_TRUE ( vector_push ( v, &i ) );
+
+  for ( int i = 0; i < 100; i++ )
+    TEST_ASSERT_EQUAL_INT ( i, v[i] );
+
+  // memory is of arena
+  vector_shrink ( v );
+  vector_free ( v );
+  TEST_ASSERT_GREATER_OR_EQUAL ( 100 * sizeof ( int ), arena.used );
+
+  arena_free ( &arena );
+}
+
 void
 test_vector ( void )
 {
   test_vector_int ();
   test_vector_my_data ();
   test_heap ();
+  test_reserve ();
+  test_vector_memory ();
+  test_vector_arena ();
 }
@@ -5,7 +5,9 @@
 // include here test functions definition
 void test_hashtable ( void );
 void test_full_read ( void );
-void test_queue ( void );
+void test_full_read_arena ( void );
+void test_arena ( void );
+void test_intern ( void );
 void test_str ( void );
 void test_rate ( void );
 void test_human_readable ( void );
@@ -13,6 +15,27 @@ void test_packet ( void );
 void test_vector ( void );
 void test_sec2clock ( void );
 void test_ht_conn( void );
+void test_filter ( void );
+void test_conn_index ( void );
+void test_pool ( void );
+void test_hash ( void );
+void test_directory ( void );
+void test_sort ( void );
+void test_record ( void );
+void test_snapshot ( void );
+void test_thread_pool ( void );
+void test_dns ( void );
+void test_domain ( void );
+void test_service ( void );
+void test_affinity ( void );
+void test_hugemem ( void );
+void test_topk ( void );
+void test_lpm ( void );
+void test_overload ( void );
+void test_flow_export ( void );
+void test_lag ( void );
+void test_pktsize ( void );
+void test_processes ( void );
 
 // need to unity
 void setUp ( void ) { /* set stuff up here */ }
@@ -25,7 +48,9 @@ main ( void )
   UNITY_BEGIN ();
   RUN_TEST ( test_hashtable );
   RUN_TEST ( test_full_read );
-  RUN_TEST ( test_queue );
+  RUN_TEST ( test_full_read_arena );
+  RUN_TEST ( test_arena );
+  RUN_TEST ( test_intern );
   RUN_TEST ( test_str );
   RUN_TEST ( test_rate );
   RUN_TEST ( test_human_readable );
@@ -33,6 +58,27 @@ main ( void )
   RUN_TEST ( test_vector );
   RUN_TEST ( test_sec2clock );
   RUN_TEST ( test_ht_conn );
+  RUN_TEST ( test_filter );
+  RUN_TEST ( test_conn_index );
+  RUN_TEST ( test_pool );
+  RUN_TEST ( test_hash );
+  RUN_TEST ( test_directory );
+  RUN_TEST ( test_sort );
+  RUN_TEST ( test_record );
+  RUN_TEST ( test_snapshot );
+  RUN_TEST ( test_thread_pool );
+  RUN_TEST ( test_dns );
+  RUN_TEST ( test_domain );
+  RUN_TEST ( test_service );
+  RUN_TEST ( test_affinity );
+  RUN_TEST ( test_hugemem );
+  RUN_TEST ( test_topk );
+  RUN_TEST ( test_lpm );
+  RUN_TEST ( test_overload );
+  RUN_TEST ( test_flow_export );
+  RUN_TEST ( test_lag );
+  RUN_TEST ( test_pktsize );
+  RUN_TEST ( test_processes );
 
   return UNITY_END ();
 }
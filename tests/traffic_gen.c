@@ -0,0 +1,342 @@
+// traffic generator of end-to-end benchmark (bench_e2e.sh), UDP at a fixed
+// rate by 'procs' processes, so netproc find owners of sockets in /proc
+//
+// usage: netproc-traffic [-m mix] [-r pps] [-d seconds] [-f flows]
+//                        [-s size] [-p procs] [-t ipv4]
+//   mix elephants  few connected sockets, default 4 flows
+//       mice       one socket by process to many peers, default 1M flows
+//       fanout     one socket by process to many hosts, default 4096 flows
+//       frag       as elephants, datagrams fragmented by size of 3000 bytes
+//   -t  first address of destinations, default 10.202.0.1, flows are spread
+//       in the next addresses and ports
+//
+// at end is printed 'sent <packets> <seconds> <pps>', packets are datagrams
+
+#define _GNU_SOURCE  // sendmmsg
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// datagrams by sendmmsg
+#define BATCH 32
+
+// ports of destinations, some below are used by well know services
+#define PORT_FIRST 1024
+#define PORTS ( 65536 - PORT_FIRST )
+
+#define MAX_PROCS 256
+#define MAX_SIZE 65000
+
+enum mix
+{
+  MIX_ELEPHANTS,
+  MIX_MICE,
+  MIX_FANOUT,
+  MIX_FRAG
+};
+
+static const char *const mixes[] = { [MIX_ELEPHANTS] = "elephants",
+                                     [MIX_MICE] = "mice",
+                                     [MIX_FANOUT] = "fanout",
+                                     [MIX_FRAG] = "frag" };
+
+#define TOTAL_MIXES ( sizeof ( mixes ) / sizeof ( mixes[0] ) )
+
+static const unsigned long default_flows[] = { [MIX_ELEPHANTS] = 4,
+                                               [MIX_MICE] = 1000000,
+                                               [MIX_FANOUT] = 4096,
+                                               [MIX_FRAG] = 4 };
+
+struct options
+{
+  enum mix mix;
+  unsigned long pps;
+  unsigned long flows;
+  unsigned int seconds;
+  unsigned int size;
+  unsigned int procs;
+  uint32_t dst;  // host order
+};
+
+static uint64_t
+now_ns ( void )
+{
+  struct timespec ts;
+
+  clock_gettime ( CLOCK_MONOTONIC, &ts );
+
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// destination of flow 'flow', the port change first
+static void
+flow_addr ( const struct options *op,
+            unsigned long flow,
+            struct sockaddr_in *addr )
+{
+  memset ( addr, 0, sizeof ( *addr ) );
+  addr->sin_family = AF_INET;
+
+  if ( op->mix == MIX_FANOUT )
+    {
+      addr->sin_addr.s_addr = htonl ( op->dst + flow );
+      addr->sin_port = htons ( 9 );
+    }
+  else
+    {
+      addr->sin_addr.s_addr = htonl ( op->dst + flow / PORTS );
+      addr->sin_port = htons ( PORT_FIRST + flow % PORTS );
+    }
+}
+
+static int
+socket_new ( const struct sockaddr_in *peer )
+{
+  int sock = socket ( AF_INET, SOCK_DGRAM, 0 );
+  if ( sock == -1 )
+    return -1;
+
+  // let the kernel fragment datagrams larger than MTU
+  int pmtu = IP_PMTUDISC_DONT;
+  setsockopt ( sock, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof ( pmtu ) );
+
+  // a socket by flow, to the flow be a connection of process
+  if ( peer &&
+       connect ( sock, ( const struct sockaddr * ) peer, sizeof ( *peer ) ) )
+    {
+      close ( sock );
+      return -1;
+    }
+
+  return sock;
+}
+
+/* process 'id' send the flows id, id + procs, id + 2 * procs ... at
+   rate pps / procs, the total sent is stored in 'sent' */
+static void
+sender ( const struct options *op, unsigned int id, volatile uint64_t *sent )
+{
+  static char payload[MAX_SIZE];
+  bool connected = op->mix == MIX_ELEPHANTS || op->mix == MIX_FRAG;
+
+  unsigned long my_flows = op->flows / op->procs +
+                           ( id < op->flows % op->procs );
+  if ( !my_flows )
+    return;
+
+  int *socks = calloc ( ( connected ) ? my_flows : 1, sizeof ( *socks ) );
+  if ( !socks )
+    return;
+
+  struct sockaddr_in peer;
+  for ( unsigned long i = 0; i < ( ( connected ) ? my_flows : 1 ); i++ )
+    {
+      flow_addr ( op, id + i * op->procs, &peer );
+      socks[i] = socket_new ( ( connected ) ? &peer : NULL );
+      if ( socks[i] == -1 )
+        {
+          perror ( "socket" );
+          return;
+        }
+    }
+
+  struct mmsghdr msgs[BATCH];
+  struct iovec iov = { .iov_base = payload, .iov_len = op->size };
+  struct sockaddr_in addrs[BATCH];
+
+  memset ( msgs, 0, sizeof ( msgs ) );
+  for ( int i = 0; i < BATCH; i++ )
+    {
+      msgs[i].msg_hdr.msg_iov = &iov;
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+  double rate = ( double ) op->pps / op->procs;
+  uint64_t start = now_ns ();
+  uint64_t end = start + op->seconds * 1000000000ULL;
+  uint64_t total = 0;
+  unsigned long flow = 0;
+
+  for ( uint64_t now = start; now < end; now = now_ns () )
+    {
+      // datagrams that should have been sent until now
+      uint64_t due = ( now - start ) * rate / 1e9;
+      if ( total >= due )
+        {
+          uint64_t next = start + ( total + BATCH ) * 1e9 / rate;
+          struct timespec ts = { .tv_sec = next / 1000000000ULL,
+                                 .tv_nsec = next % 1000000000ULL };
+          clock_nanosleep ( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL );
+          continue;
+        }
+
+      unsigned int batch = ( due - total < BATCH ) ? due - total : BATCH;
+      int sock = socks[0];
+
+      if ( connected )
+        {
+          // a batch by flow, in turns
+          sock = socks[flow++ % my_flows];
+          for ( unsigned int i = 0; i < batch; i++ )
+            msgs[i].msg_hdr.msg_name = NULL;
+        }
+      else
+        {
+          for ( unsigned int i = 0; i < batch; i++ )
+            {
+              unsigned long f = id + ( flow++ % my_flows ) * op->procs;
+
+              flow_addr ( op, f, &addrs[i] );
+              msgs[i].msg_hdr.msg_name = &addrs[i];
+              msgs[i].msg_hdr.msg_namelen = sizeof ( addrs[i] );
+            }
+        }
+
+      // with queue of device full the datagrams are tried again
+      int ret = sendmmsg ( sock, msgs, batch, 0 );
+      if ( ret > 0 )
+        total += ret;
+      else if ( errno != ENOBUFS && errno != EAGAIN )
+        {
+          perror ( "sendmmsg" );
+          break;
+        }
+    }
+
+  *sent = total;
+}
+
+static void
+usage ( const char *prog )
+{
+  fprintf ( stderr,
+            "usage: %s [-m elephants|mice|fanout|frag] [-r pps] "
+            "[-d seconds]\n"
+            "          [-f flows] [-s size] [-p procs] [-t ipv4]\n",
+            prog );
+  exit ( EXIT_FAILURE );
+}
+
+static void
+parse_options ( int argc, char **argv, struct options *op )
+{
+  bool flows = false, size = false;
+  struct in_addr dst;
+  int opt;
+
+  while ( ( opt = getopt ( argc, argv, "m:r:d:f:s:p:t:" ) ) != -1 )
+    {
+      switch ( opt )
+        {
+          case 'm':
+            op->mix = TOTAL_MIXES;
+            for ( unsigned int i = 0; i < TOTAL_MIXES; i++ )
+              if ( !strcasecmp ( optarg, mixes[i] ) )
+                op->mix = i;
+            if ( op->mix == TOTAL_MIXES )
+              usage ( argv[0] );
+            break;
+          case 'r':
+            op->pps = strtoul ( optarg, NULL, 10 );
+            break;
+          case 'd':
+            op->seconds = strtoul ( optarg, NULL, 10 );
+            break;
+          case 'f':
+            op->flows = strtoul ( optarg, NULL, 10 );
+            flows = true;
+            break;
+          case 's':
+            op->size = strtoul ( optarg, NULL, 10 );
+            size = true;
+            break;
+          case 'p':
+            op->procs = strtoul ( optarg, NULL, 10 );
+            break;
+          case 't':
+            if ( !inet_pton ( AF_INET, optarg, &dst ) )
+              usage ( argv[0] );
+            op->dst = ntohl ( dst.s_addr );
+            break;
+          default:
+            usage ( argv[0] );
+        }
+    }
+
+  if ( !flows )
+    op->flows = default_flows[op->mix];
+
+  if ( !size )
+    op->size = ( op->mix == MIX_FRAG ) ? 3000 : 64;
+
+  if ( !op->pps || !op->seconds || !op->flows || !op->procs ||
+       op->procs > MAX_PROCS || op->size > MAX_SIZE )
+    usage ( argv[0] );
+}
+
+int
+main ( int argc, char **argv )
+{
+  struct options op = { .mix = MIX_ELEPHANTS,
+                        .pps = 100000,
+                        .seconds = 10,
+                        .procs = 4,
+                        .dst = 0x0aca0001 };  // 10.202.0.1
+
+  parse_options ( argc, argv, &op );
+
+  // counters of children
+  volatile uint64_t *sent = mmap ( NULL,
+                                   MAX_PROCS * sizeof ( *sent ),
+                                   PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS,
+                                   -1,
+                                   0 );
+  if ( sent == MAP_FAILED )
+    {
+      perror ( "mmap" );
+      return EXIT_FAILURE;
+    }
+
+  uint64_t start = now_ns ();
+
+  for ( unsigned int i = 0; i < op.procs; i++ )
+    {
+      pid_t pid = fork ();
+      if ( pid == -1 )
+        {
+          perror ( "fork" );
+          return EXIT_FAILURE;
+        }
+
+      if ( !pid )
+        {
+          sender ( &op, i, &sent[i] );
+          _exit ( EXIT_SUCCESS );
+        }
+    }
+
+  while ( wait ( NULL ) > 0 )
+    ;
+
+  double seconds = ( now_ns () - start ) / 1e9;
+  uint64_t total = 0;
+
+  for ( unsigned int i = 0; i < op.procs; i++ )
+    total += sent[i];
+
+  printf ( "sent %lu %.3f %.0f\n", total, seconds, total / seconds );
+
+  return EXIT_SUCCESS;
+}